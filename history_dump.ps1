@@ -0,0 +1,27 @@
+$ErrorActionPreference = "Continue"
+
+$env:IDF_PATH = "C:\Espressif\frameworks\esp-idf-v5.5.2"
+$env:IDF_TOOLS_PATH = "C:\Espressif"
+$env:PYTHONNOUSERSITE = "True"
+$env:PYTHONHOME = ""
+$env:PYTHONPATH = ""
+$env:MSYSTEM = ""
+$env:IDF_PYTHON_ENV_PATH = "C:\Espressif\python_env\idf5.5_py3.11_env"
+
+$IDF_PYTHON = "C:\Espressif\python_env\idf5.5_py3.11_env\Scripts\python.exe"
+
+$toolPaths = @(
+    "C:\Espressif\python_env\idf5.5_py3.11_env\Scripts"
+    "$env:IDF_PATH\tools"
+)
+$env:PATH = ($toolPaths -join ";") + ";" + $env:PATH
+
+Set-Location "D:\00Projects\ESP32\pet-toilet-monitor_v2"
+
+# Reads the "history" partition (CONFIG_LITTERBOX_HISTORY_LOG) over the ROM
+# bootloader at 921600 baud: 768 KB in ~10 s. The device resets afterwards.
+# Decode with host/tools/history_decode history.bin, or detector_bench --history history.bin
+$out = if ($args.Count -gt 0) { $args[0] } else { "history_$(Get-Date -Format yyyyMMdd_HHmmss).bin" }
+
+"=== Reading history partition from COM3 -> $out ==="
+& $IDF_PYTHON "$env:IDF_PATH\components\partition_table\parttool.py" -p COM3 -b 921600 read_partition --partition-name history --output $out 2>&1
@@ -0,0 +1,369 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * backend_bench.c — Sensor backends and the start/poll split (air_sensor_driver.h)
+ *
+ * 1. MQ-135: the firmware's tick order (poll the conversion in flight,
+ *    then start the next) yields exactly what blocking air_sensor_read()
+ *    does on the same input, warmup included
+ * 2. Simulated backend: a synthetic week saved as CSV and replayed through
+ *    air_sensor_sim drives the detector to the same per-tick states and
+ *    events as the trace itself; a raw-only CSV reads as the MQ-135
+ *    backend converts it
+ * 3. Asynchronous conversions: with the conversion shorter than a tick no
+ *    tick misses a reading; with it longer, ticks go without one instead of
+ *    waiting, and no row is lost or reordered
+ * 4. Runtime selection: switching is refused while a conversion is in
+ *    flight; end of trace and looping
+ * 5. Cost of one tick's poll + start per backend (host)
+ *
+ * Exits non-zero on any mismatch.
+ */
+#include "air_sensor_driver.h"
+#include "air_sensor_sim.h"
+#include "bench_clock.h"
+#include "esp_adc/adc_oneshot.h"
+#include "esp_timer.h"
+#include "event_detector.h"
+#include "trace.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define TICK_US     ((int64_t)TRACE_TICK_MS * 1000)
+
+static volatile uint32_t s_sink;
+
+static int synth_raw(int t)
+{
+    return 1400 + (int)(80.0 * sin(t / 37.0)) + (t < 40 ? 25 * (40 - t) : 0) + ((t * 7919) % 23);
+}
+
+/* One firmware tick: collect the conversion in flight, start the next */
+static esp_err_t tick(air_sensor_data_t *out, bool *got)
+{
+    esp_err_t err = air_sensor_poll(out);
+    *got = err != ESP_ERR_NOT_FINISHED && err != ESP_ERR_INVALID_STATE;
+    if (err != ESP_ERR_NOT_FINISHED) {
+        air_sensor_start();
+    }
+    return err;
+}
+
+/* Collect what is still in flight, so the next check may switch backends */
+static void finish(void)
+{
+    air_sensor_data_t d[AIR_SENSOR_MAX_CHANNELS];
+    while (air_sensor_poll(d) == ESP_ERR_NOT_FINISHED) {
+        host_timer_advance_us(TICK_US);
+    }
+}
+
+/* ── 1. MQ-135: tick order vs blocking read ─────────────────────────── */
+
+static bool check_mq135(void)
+{
+    const int n = 2000;
+    air_sensor_data_t *ref = calloc(n, sizeof(*ref));
+    unsigned differ = 0, missed = 0;
+
+    air_sensor_select(&air_sensor_mq135);
+    host_timer_set_time_us(0);
+    air_sensor_init();
+    for (int t = 0; t < n; t++) {
+        host_adc_set_raw(ADC_CHANNEL_0, synth_raw(t));
+        air_sensor_read(&ref[t]);
+        host_timer_advance_us(TICK_US);
+    }
+
+    host_timer_set_time_us(0);
+    air_sensor_init();
+    air_sensor_start();
+    for (int t = 0; t < n; t++) {
+        air_sensor_data_t d = {0};
+        bool got;
+        host_adc_set_raw(ADC_CHANNEL_0, synth_raw(t));
+        tick(&d, &got);
+        missed += !got;
+        differ += d.nh3_ppm_f != ref[t].nh3_ppm_f || d.nh3_ppm_q != ref[t].nh3_ppm_q
+                || d.raw_adc != ref[t].raw_adc || d.is_warming_up != ref[t].is_warming_up;
+        host_timer_advance_us(TICK_US);
+    }
+    finish();
+    free(ref);
+
+    bool ok = differ == 0 && missed == 0;
+    printf("== MQ-135: poll-then-start ticks vs air_sensor_read(), %d ticks ==\n", n);
+    printf("  %u tick(s) differ, %u without a reading  %s\n", differ, missed, ok ? "PASS" : "FAIL");
+    return ok;
+}
+
+/* ── 2. Simulated backend ───────────────────────────────────────────── */
+
+static bool check_sim_replay(const trace_t *week, const char *csv)
+{
+    trace_t loaded;
+    trace_init(&loaded, "loaded");
+    if (!trace_save_csv(week, csv) || !trace_load_csv(&loaded, csv)) {
+        printf("  cannot round-trip %s  FAIL\n", csv);
+        return false;
+    }
+
+    /* Reference: the detector straight on the CSV's ppm, quantized as a backend hands it over */
+    event_detector_t ref, det;
+    event_detector_init(&ref);
+    event_detector_init(&det);
+
+    air_sensor_sim_reset();
+    if (!air_sensor_sim_load_csv(0, csv) || air_sensor_select(&air_sensor_sim) != ESP_OK
+            || air_sensor_init() != ESP_OK) {
+        printf("  cannot load %s into air_sensor_sim  FAIL\n", csv);
+        trace_free(&loaded);
+        return false;
+    }
+    air_sensor_start();
+
+    size_t differ = 0, events = 0;      /* Ticks with an event out */
+    for (size_t i = 0; i < loaded.count; i++) {
+        air_sensor_data_t d = {0};
+        bool got;
+        tick(&d, &got);
+        litter_event_t e_ref = event_detector_update(&ref, loaded.samples[i].ppm);
+        litter_event_t e_sim = event_detector_update(&det, d.nh3_ppm_f);
+        differ += !got || e_ref != e_sim || ref.state != det.state || ref.baseline_ppm != det.baseline_ppm;
+        events += e_sim != LITTER_EVENT_NONE;
+    }
+    finish();
+
+    bool ok = differ == 0;
+    printf("== Simulated backend: %zu-tick CSV replay vs detector on the trace ==\n", loaded.count);
+    printf("  %zu tick(s) differ in state / baseline / event (%zu event ticks)  %s\n", differ, events,
+           ok ? "PASS" : "FAIL");
+    trace_free(&loaded);
+    return ok;
+}
+
+static bool check_sim_raw(const char *csv)
+{
+    FILE *f = fopen(csv, "w");
+    if (!f) {
+        return false;
+    }
+    fprintf(f, "# raw-only capture\nt_ms,raw_adc\n");
+    for (int t = 0; t < 4096; t++) {
+        fprintf(f, "%d,%d\n", t * TRACE_TICK_MS, t);
+    }
+    fclose(f);
+
+    air_sensor_sim_reset();
+    host_timer_set_time_us(12345);
+    bool loaded = air_sensor_sim_load_csv(0, csv);
+    bool clock_kept = esp_timer_get_time() == 12345;
+    air_sensor_select(&air_sensor_sim);
+    air_sensor_init();
+    air_sensor_mq135.init();
+
+    unsigned differ = 0;
+    for (int raw = 0; loaded && raw < 4096; raw++) {
+        air_sensor_data_t sim, mq;
+        host_adc_set_raw(ADC_CHANNEL_0, raw);
+        air_sensor_read(&sim);
+        air_sensor_backend_read(&air_sensor_mq135, &mq);
+        differ += sim.nh3_ppm_f != mq.nh3_ppm_f || sim.nh3_ppm_q != mq.nh3_ppm_q || sim.raw_adc != mq.raw_adc;
+    }
+
+    bool ok = loaded && clock_kept && differ == 0;
+    printf("== Simulated backend: raw-only CSV, all 4096 codes vs MQ-135 backend ==\n");
+    printf("  loaded %s, clock untouched %s, %u code(s) differ  %s\n", loaded ? "yes" : "no",
+           clock_kept ? "yes" : "no", differ, ok ? "PASS" : "FAIL");
+    return ok;
+}
+
+/* ── 3. Asynchronous conversions ────────────────────────────────────── */
+
+static bool run_latency(trace_t *ramp, int64_t latency_us, size_t ticks, size_t *missed, size_t *out_of_order)
+{
+    air_sensor_sim_cfg_t cfg = AIR_SENSOR_SIM_CFG_DEFAULT();
+    cfg.latency_us = latency_us;
+    air_sensor_sim_reset();
+    air_sensor_sim_set_trace(0, ramp);
+    air_sensor_sim_configure(&cfg);
+    air_sensor_select(&air_sensor_sim);
+    host_timer_set_time_us(0);
+    if (air_sensor_init() != ESP_OK) {
+        return false;
+    }
+    air_sensor_start();     /* As the firmware does one interval before the first tick */
+
+    uint32_t expect = 0;
+    *missed = *out_of_order = 0;
+    for (size_t i = 0; i < ticks; i++) {
+        air_sensor_data_t d = {0};
+        bool got;
+        host_timer_advance_us(TICK_US);
+        tick(&d, &got);
+        if (!got) {
+            (*missed)++;
+        } else {
+            *out_of_order += d.raw_adc != expect;
+            expect = d.raw_adc + 1;
+        }
+    }
+    finish();
+    return true;
+}
+
+static bool check_async(void)
+{
+    const size_t ticks = 1000;
+    trace_t ramp;
+    trace_init(&ramp, "ramp");
+    ramp.has_raw = ramp.has_ppm = true;
+    for (uint32_t i = 0; i < ticks; i++) {
+        trace_sample_t s = { .t_ms = i * TRACE_TICK_MS, .raw_adc = (uint16_t)i, .ppm = 5.0f + i * 0.01f };
+        trace_push(&ramp, &s);
+    }
+
+    static const int64_t latencies_us[] = { 0, 150000, 1900000, 3000000 };
+    bool ok = true;
+    printf("== Asynchronous conversions: %zu ticks of %d ms ==\n", ticks, TRACE_TICK_MS);
+    for (size_t k = 0; k < sizeof(latencies_us) / sizeof(latencies_us[0]); k++) {
+        size_t missed, disorder;
+        int64_t lat = latencies_us[k];
+        if (!run_latency(&ramp, lat, ticks, &missed, &disorder)) {
+            ok = false;
+            continue;
+        }
+        /* Shorter than a tick: every tick has one; longer: every other tick waits for it */
+        size_t expect_missed = lat < TICK_US ? 0 : ticks / 2;
+        bool pass = missed == expect_missed && disorder == 0;
+        printf("  latency %5lld ms: %4zu tick(s) without a reading (expect %zu), %zu out of order  %s\n",
+               (long long)(lat / 1000), missed, expect_missed, disorder, pass ? "PASS" : "FAIL");
+        ok &= pass;
+    }
+    trace_free(&ramp);
+    return ok;
+}
+
+/* ── 4. Runtime selection, end of trace ─────────────────────────────── */
+
+static bool check_selection(void)
+{
+    trace_t t;
+    trace_init(&t, "short");
+    t.has_ppm = true;
+    for (uint32_t i = 0; i < 5; i++) {
+        trace_sample_t s = { .t_ms = i * TRACE_TICK_MS, .ppm = 10.0f + i };
+        trace_push(&t, &s);
+    }
+    air_sensor_data_t d;
+    air_sensor_sim_cfg_t cfg = AIR_SENSOR_SIM_CFG_DEFAULT();
+    cfg.latency_us = 500000;
+    cfg.warmup_rows = 2;
+
+    air_sensor_sim_reset();
+    air_sensor_sim_set_trace(0, &t);
+    air_sensor_sim_configure(&cfg);
+    air_sensor_select(&air_sensor_sim);
+    host_timer_set_time_us(0);
+    air_sensor_init();
+    air_sensor_start();
+    bool refused   = air_sensor_select(&air_sensor_mq135) == ESP_ERR_INVALID_STATE;
+    bool not_done  = air_sensor_poll(&d) == ESP_ERR_NOT_FINISHED;
+    bool read_busy = air_sensor_read(&d) == ESP_ERR_INVALID_STATE;
+    host_timer_advance_us(cfg.latency_us);
+    bool done      = air_sensor_poll(&d) == ESP_OK && d.is_valid && d.nh3_ppm == 10 && d.is_warming_up;
+    bool switched  = air_sensor_select(&air_sensor_mq135) == ESP_OK && air_sensor_backend() == &air_sensor_mq135;
+    bool no_start  = air_sensor_poll(&d) == ESP_ERR_INVALID_STATE;
+
+    /* Blocking read waits on the clock (vTaskDelay); init rewinds: rows 0..4, then past the end */
+    air_sensor_select(&air_sensor_sim);
+    air_sensor_init();
+    int64_t t0 = esp_timer_get_time();
+    bool rows = true;
+    for (int i = 0; i < 5; i++) {
+        rows &= air_sensor_read(&d) == ESP_OK && d.nh3_ppm == 10 + i && d.is_warming_up == (i < 2);
+    }
+    bool waited = esp_timer_get_time() - t0 >= 5 * cfg.latency_us;
+    bool ended  = air_sensor_read(&d) == ESP_ERR_NOT_FOUND && !d.is_valid;
+    cfg.loop = true;
+    air_sensor_sim_configure(&cfg);
+    bool looped = air_sensor_read(&d) == ESP_OK && d.nh3_ppm == 10 + (6 % 5);
+
+    bool ok = refused && not_done && read_busy && done && switched && no_start && rows && waited && ended && looped;
+    printf("== Runtime selection and end of trace ==\n");
+    printf("  switch refused in flight %d, NOT_FINISHED %d, read refused %d, result %d, switched %d, poll idle %d\n"
+           "  blocking reads %d (waited %d), end of trace %d, loop %d  %s\n",
+           refused, not_done, read_busy, done, switched, no_start, rows, waited, ended, looped, ok ? "PASS" : "FAIL");
+    air_sensor_sim_reset();
+    trace_free(&t);
+    return ok;
+}
+
+/* ── 5. Cost ────────────────────────────────────────────────────────── */
+
+static double cost_tick(const air_sensor_backend_t *b, int repeat)
+{
+    air_sensor_data_t d;
+    bool got;
+    air_sensor_select(b);
+    air_sensor_init();
+    air_sensor_start();
+    uint64_t t0 = bench_now_ns();
+    for (int i = 0; i < repeat; i++) {
+        host_adc_set_raw(ADC_CHANNEL_0, i & 4095);
+        tick(&d, &got);
+        s_sink += d.nh3_ppm_q;
+    }
+    double ns = (double)(bench_now_ns() - t0) / repeat;
+    finish();
+    return ns;
+}
+
+static void report_cost(const trace_t *week)
+{
+    air_sensor_sim_cfg_t cfg = AIR_SENSOR_SIM_CFG_DEFAULT();
+    cfg.loop = true;
+    air_sensor_sim_reset();
+    air_sensor_sim_set_trace(0, (trace_t *)week);
+    air_sensor_sim_configure(&cfg);
+    double mq  = cost_tick(&air_sensor_mq135, 1 << 20);
+    double sim = cost_tick(&air_sensor_sim, 1 << 20);
+    printf("== Cost of one tick's poll + start (host) ==\n");
+    printf("  %-8s %7.2f ns\n  %-8s %7.2f ns\n", air_sensor_mq135.name, mq, air_sensor_sim.name, sim);
+    air_sensor_sim_reset();
+    air_sensor_select(&air_sensor_mq135);
+}
+
+int main(int argc, char **argv)
+{
+    char csv[] = "/tmp/backend_bench_XXXXXX";
+    int fd = mkstemp(csv);
+    if (fd < 0) {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+
+    trace_t week;
+    trace_synth_cfg_t cfg = trace_synth_default();
+    cfg.hours = 24.0 * 7;
+    if (!trace_synthesize(&week, &cfg)) {
+        return 1;
+    }
+
+    bool ok = check_mq135();
+    ok &= check_sim_replay(&week, csv);
+    ok &= check_sim_raw(csv);
+    ok &= check_async();
+    ok &= check_selection();
+    report_cost(&week);
+
+    trace_free(&week);
+    unlink(csv);
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
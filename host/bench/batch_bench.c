@@ -0,0 +1,175 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * batch_bench.c — Throughput of event_detector_update_batch() vs scalar
+ *
+ * Steps N detectors (default 1k / 100k / 1M) through phase-shifted copies
+ * of synthetic 7-day traces, once with N scalar event_detector_t and once
+ * with the SoA batch engine. Every tick's outputs and the final per-lane
+ * state are compared bit for bit. The first STARTUP_TICKS (start-up
+ * baseline averaging, scalar path for every lane) are checked but not timed.
+ *
+ * Usage: batch_bench [--updates U] [N ...]
+ *   U: approximate updates per engine per size (default 2e7)
+ */
+#include "bench_clock.h"
+#include "event_detector.h"
+#include "event_detector_batch.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BASE_TRACES     8
+#define STARTUP_TICKS   32      /* Untimed: every lane is still averaging its baseline (scalar path) */
+
+typedef struct {
+    const float *ppm[BASE_TRACES];
+    size_t       len;
+} trace_pool_t;
+
+static void fill_tick(const trace_pool_t *pool, size_t tick, size_t n, float *out)
+{
+    for (size_t i = 0; i < n; i++) {
+        size_t off = (i * 7919u) % pool->len;       /* Spread lanes across the trace */
+        out[i] = pool->ppm[i % BASE_TRACES][(tick + off) % pool->len];
+    }
+}
+
+static bool lanes_equal(const event_detector_t *a, const event_detector_t *b)
+{
+    return memcmp(&a->baseline_ppm, &b->baseline_ppm, sizeof(float)) == 0
+        && memcmp(&a->peak_ppm, &b->peak_ppm, sizeof(float)) == 0
+        && a->state == b->state && a->current_event == b->current_event
+        && a->event_ticks == b->event_ticks && a->peak_ticks == b->peak_ticks
+        && a->below_thresh_count == b->below_thresh_count
+        && a->cooldown_ticks == b->cooldown_ticks && a->initialized == b->initialized
+        && a->baseline_n == b->baseline_n
+        && memcmp(&a->prev_ppm, &b->prev_ppm, sizeof(float)) == 0
+        && memcmp(&a->features, &b->features, sizeof(event_features_t)) == 0
+        && memcmp(&a->baseline_dev2, &b->baseline_dev2, sizeof(float)) == 0;
+}
+
+static bool run_size(const trace_pool_t *pool, size_t n, double updates)
+{
+    size_t ticks = (size_t)(updates / n);
+    if (ticks < 50) {
+        ticks = 50;
+    }
+
+    event_detector_t    *aos = malloc(n * sizeof(*aos));
+    event_detector_soa_t soa;
+    float   *ppm     = malloc(n * sizeof(float));
+    uint8_t *out_aos = malloc(n);
+    uint8_t *out_soa = malloc(n);
+    if (!aos || !ppm || !out_aos || !out_soa || event_detector_soa_init(&soa, n) != ESP_OK) {
+        fprintf(stderr, "Out of memory for %zu detectors\n", n);
+        return false;
+    }
+    for (size_t i = 0; i < n; i++) {
+        event_detector_init(&aos[i]);
+    }
+
+    uint64_t ns_scalar = 0, ns_batch = 0;
+    size_t   out_mismatch = 0;
+    for (size_t t = 0; t < ticks + STARTUP_TICKS; t++) {
+        fill_tick(pool, t, n, ppm);
+
+        uint64_t t0 = bench_now_ns();
+        for (size_t i = 0; i < n; i++) {
+            out_aos[i] = (uint8_t)event_detector_update(&aos[i], ppm[i]);
+        }
+        uint64_t t1 = bench_now_ns();
+        event_detector_update_batch(&soa, ppm, out_soa, n);
+        uint64_t t2 = bench_now_ns();
+
+        if (t >= STARTUP_TICKS) {
+            ns_scalar += t1 - t0;
+            ns_batch  += t2 - t1;
+        }
+        if (memcmp(out_aos, out_soa, n) != 0) {
+            out_mismatch++;
+        }
+    }
+
+    size_t lane_mismatch = 0;
+    for (size_t i = 0; i < n; i++) {
+        event_detector_t lane;
+        event_detector_soa_get(&soa, i, &lane);
+        lane_mismatch += !lanes_equal(&aos[i], &lane);
+    }
+
+    double calls = (double)n * ticks;
+    bool   ok    = out_mismatch == 0 && lane_mismatch == 0;
+    printf("  %8zu %7zu  %8.2f %8.2f  %7.1f %7.1f  %5.2fx  %s\n",
+           n, ticks, ns_scalar / calls, ns_batch / calls,
+           calls * 1e3 / ns_scalar, calls * 1e3 / ns_batch,
+           (double)ns_scalar / ns_batch, ok ? "identical" : "MISMATCH");
+    if (!ok) {
+        printf("    ticks with differing outputs=%zu  lanes with differing state=%zu\n",
+               out_mismatch, lane_mismatch);
+    }
+
+    event_detector_soa_free(&soa);
+    free(aos);
+    free(ppm);
+    free(out_aos);
+    free(out_soa);
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    size_t sizes[16] = { 1000, 100000, 1000000 };
+    size_t n_sizes   = 3;
+    double updates   = 2e7;
+    bool   custom    = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--updates") == 0 && i + 1 < argc) {
+            updates = atof(argv[++i]);
+        } else if (n_sizes < 16 || !custom) {
+            if (!custom) {
+                n_sizes = 0;
+                custom  = true;
+            }
+            sizes[n_sizes++] = strtoul(argv[i], NULL, 0);
+        }
+    }
+
+    trace_t      traces[BASE_TRACES];
+    trace_pool_t pool = {0};
+    trace_synth_cfg_t cfg = trace_synth_default();
+    cfg.hours = 24.0 * 7;
+    for (int k = 0; k < BASE_TRACES; k++) {
+        cfg.seed = 100 + k;
+        if (!trace_synthesize(&traces[k], &cfg)) {
+            return 1;
+        }
+        float *p = malloc(traces[k].count * sizeof(float));
+        for (size_t i = 0; i < traces[k].count; i++) {
+            p[i] = traces[k].samples[i].ppm;
+        }
+        pool.ppm[k] = p;
+        pool.len    = traces[k].count;
+    }
+
+    printf("== event_detector_update_batch() vs scalar ==\n");
+    printf("  %8s %7s  %8s %8s  %7s %7s  %6s\n",
+           "N", "ticks", "ns/upd", "ns/upd", "M upd/s", "M upd/s", "");
+    printf("  %8s %7s  %8s %8s  %7s %7s  %6s\n",
+           "", "", "scalar", "batch", "scalar", "batch", "speedup");
+
+    bool ok = true;
+    for (size_t s = 0; s < n_sizes; s++) {
+        ok &= run_size(&pool, sizes[s], updates);
+    }
+
+    for (int k = 0; k < BASE_TRACES; k++) {
+        free((void *)pool.ppm[k]);
+        trace_free(&traces[k]);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,215 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * decimator_bench.c — Host check and benchmark for adc_decimator (CIC)
+ *
+ * Feeds a raw ADC stream (recorded, or synthetic 1 kHz with noise and
+ * spikes) through adc_decimator and:
+ *  - verifies every output against a direct convolution with the CIC
+ *    impulse response (exact match expected — integer arithmetic)
+ *  - reports noise before/after decimation and ns per input sample
+ *
+ * Usage: decimator_bench [--raw FILE] [--order N] [--ratio R]
+ *                        [--seconds S] [--out FILE]
+ * FILE: one raw ADC code per line ('#' lines ignored), e.g. a capture of
+ * the continuous-mode DMA stream at CONFIG_LITTERBOX_ADC_SAMPLE_FREQ_HZ.
+ */
+#include "adc_decimator.h"
+#include "bench_clock.h"
+#include "trace.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    uint16_t *v;
+    size_t    n;
+    size_t    cap;
+} stream_t;
+
+static bool stream_push(stream_t *s, uint16_t v)
+{
+    if (s->n == s->cap) {
+        size_t cap = s->cap ? s->cap * 2 : 65536;
+        uint16_t *p = realloc(s->v, cap * sizeof(*p));
+        if (!p) {
+            return false;
+        }
+        s->v   = p;
+        s->cap = cap;
+    }
+    s->v[s->n++] = v;
+    return true;
+}
+
+static bool stream_load(stream_t *s, const char *path)
+{
+    char line[64];
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        char *end;
+        long v = strtol(line, &end, 10);
+        if (line[0] == '#' || end == line) {
+            continue;
+        }
+        if (!stream_push(s, (uint16_t)(v < 0 ? 0 : v > 4095 ? 4095 : v))) {
+            fclose(f);
+            return false;
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+/* Clean-air level (raw≈953) plus 6-code white noise and rare ±200-code spikes */
+static bool stream_synthesize(stream_t *s, double seconds)
+{
+    uint64_t rng = 7;
+    size_t   n   = (size_t)(seconds * 1000.0);
+    for (size_t i = 0; i < n; i++) {
+        double v = 953.0 + 6.0 * trace_rng_normal(&rng);
+        if (trace_rng_uniform(&rng) < 0.001) {
+            v += trace_rng_uniform(&rng) < 0.5 ? -200.0 : 200.0;
+        }
+        if (!stream_push(s, (uint16_t)(v < 0 ? 0 : v > 4095 ? 4095 : v + 0.5))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void stats(const uint16_t *v, size_t n, double *mean, double *sd)
+{
+    double sum = 0.0, sq = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        sum += v[i];
+    }
+    *mean = n ? sum / n : 0.0;
+    for (size_t i = 0; i < n; i++) {
+        sq += (v[i] - *mean) * (v[i] - *mean);
+    }
+    *sd = n > 1 ? sqrt(sq / (n - 1)) : 0.0;
+}
+
+/* CIC impulse response: N-fold convolution of a length-R boxcar */
+static uint32_t *cic_impulse(uint8_t order, uint16_t ratio, size_t *len)
+{
+    size_t    n = (size_t)order * (ratio - 1) + 1;
+    uint32_t *h = calloc(n, sizeof(*h));
+    uint32_t *t = calloc(n, sizeof(*t));
+    size_t    cur = 1;
+
+    h[0] = 1;
+    for (uint8_t k = 0; k < order; k++) {
+        memset(t, 0, n * sizeof(*t));
+        for (size_t i = 0; i < cur; i++) {
+            for (uint16_t j = 0; j < ratio; j++) {
+                t[i + j] += h[i];
+            }
+        }
+        cur += ratio - 1;
+        memcpy(h, t, n * sizeof(*h));
+    }
+    free(t);
+    *len = n;
+    return h;
+}
+
+int main(int argc, char **argv)
+{
+    const char *raw_path = NULL, *out_path = NULL;
+    int    order   = 2;
+    int    ratio   = 256;
+    double seconds = 600.0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--raw") == 0 && i + 1 < argc) {
+            raw_path = argv[++i];
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (strcmp(argv[i], "--order") == 0 && i + 1 < argc) {
+            order = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--ratio") == 0 && i + 1 < argc) {
+            ratio = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--raw FILE] [--order N] [--ratio R] [--seconds S] [--out FILE]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    adc_decimator_t d;
+    if (ratio < 1 || ratio > UINT16_MAX || adc_decimator_init(&d, (uint8_t)order, (uint16_t)ratio) != ESP_OK) {
+        fprintf(stderr, "Invalid order %d / ratio %d (12 + N·⌈log2 R⌉ must be ≤ 32)\n", order, ratio);
+        return 2;
+    }
+
+    stream_t in = {0};
+    if (!(raw_path ? stream_load(&in, raw_path) : stream_synthesize(&in, seconds))) {
+        return 1;
+    }
+
+    /* Decimate (timed) */
+    uint16_t *out = malloc((in.n / ratio + 1) * sizeof(*out));
+    size_t    n_out = 0;
+    uint64_t  t0 = bench_now_ns();
+    for (size_t i = 0; i < in.n; i++) {
+        if (adc_decimator_push(&d, in.v[i], &out[n_out])) {
+            n_out++;
+        }
+    }
+    uint64_t dt = bench_now_ns() - t0;
+
+    /* Reference: direct convolution at each decimation instant */
+    size_t    h_len;
+    uint32_t *h = cic_impulse((uint8_t)order, (uint16_t)ratio, &h_len);
+    uint64_t  gain = h_len ? 0 : 1;
+    for (size_t j = 0; j < h_len; j++) {
+        gain += h[j];
+    }
+    size_t mismatches = 0;
+    for (size_t k = 0; k < n_out; k++) {
+        size_t   end = (k + (size_t)order) * ratio - 1;     /* First N−1 outputs were discarded */
+        uint64_t acc = 0;
+        for (size_t j = 0; j < h_len && j <= end; j++) {
+            acc += (uint64_t)h[j] * in.v[end - j];
+        }
+        mismatches += (out[k] != (uint16_t)((acc + gain / 2) / gain));
+    }
+    free(h);
+
+    double in_mean, in_sd, out_mean, out_sd;
+    stats(in.v, in.n, &in_mean, &in_sd);
+    stats(out, n_out, &out_mean, &out_sd);
+
+    printf("== CIC decimator: order %d, ratio %d — %s ==\n", order, ratio, raw_path ? raw_path : "synthetic 1 kHz");
+    printf("  input  %zu samples  mean=%.2f  sd=%.2f codes\n", in.n, in_mean, in_sd);
+    printf("  output %zu samples  mean=%.2f  sd=%.2f codes  (noise ÷%.1f)\n",
+           n_out, out_mean, out_sd, out_sd > 0 ? in_sd / out_sd : INFINITY);
+    printf("  %.2f ns/input sample\n", in.n ? (double)dt / in.n : 0.0);
+    printf("  reference mismatches: %zu  %s\n", mismatches, mismatches ? "FAIL" : "PASS");
+
+    if (out_path) {
+        FILE *f = fopen(out_path, "w");
+        if (!f) {
+            perror(out_path);
+            return 1;
+        }
+        for (size_t k = 0; k < n_out; k++) {
+            fprintf(f, "%u\n", out[k]);
+        }
+        fclose(f);
+    }
+    free(out);
+    free(in.v);
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,215 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * detector_bench.c — Host benchmark for the LitterBox.v1 sensing hot path
+ *
+ * Reports:
+ *  - event_detector_update(): ns per call and updates/sec
+ *  - air_sensor_read() raw→ppm conversion: ns per call (ADC stubbed)
+ *  - Detection latency per event type against labelled traces
+ *  - Onset engines side by side: median trigger latency and false positives
+ *    per day of the threshold and CUSUM engines on each labelled trace
+ *
+ * --history FILE replays a dumped history partition (history_dump.ps1).
+ * It has no labels; the events the detector raises on it are counted instead.
+ *
+ * Usage: detector_bench [--trace FILE]... [--history FILE]... [--hours H]
+ *                       [--seed N] [--repeat N] [--save-synth FILE] [-v]
+ */
+#include "air_sensor_driver.h"
+#include "bench_clock.h"
+#include "esp_adc/adc_oneshot.h"
+#include "esp_log.h"
+#include "event_detector.h"
+#include "history_reader.h"
+#include "replay.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_TRACES  16
+
+static volatile uint32_t s_sink;    /* Keeps results observable to the optimizer */
+
+static void bench_detector(const trace_t *t, int repeat)
+{
+    event_detector_t det;
+    uint64_t calls = 0;
+    uint64_t t0 = bench_now_ns();
+
+    for (int r = 0; r < repeat; r++) {
+        event_detector_init(&det);
+        for (size_t i = 0; i < t->count; i++) {
+            s_sink += event_detector_update(&det, t->samples[i].ppm);
+        }
+        calls += t->count;
+    }
+
+    uint64_t dt = bench_now_ns() - t0;
+    printf("== event_detector_update() ==\n");
+    printf("  calls=%llu  %.2f ns/call  %.1f M updates/s\n",
+           (unsigned long long)calls, (double)dt / calls, calls * 1e3 / dt);
+}
+
+static void bench_conversion(int repeat)
+{
+    air_sensor_data_t data;
+    uint64_t calls = 0;
+
+    if (air_sensor_init() != ESP_OK) {
+        return;
+    }
+    uint64_t t0 = bench_now_ns();
+    for (int r = 0; r < repeat; r++) {
+        for (int raw = 0; raw < 4096; raw++) {
+            host_adc_set_raw(ADC_CHANNEL_0, raw);
+            air_sensor_read(&data);
+            s_sink += data.nh3_ppm;
+        }
+        calls += 4096;
+    }
+    uint64_t dt = bench_now_ns() - t0;
+    printf("== air_sensor_read() raw→ppm ==\n");
+    printf("  calls=%llu  %.2f ns/call\n", (unsigned long long)calls, (double)dt / calls);
+}
+
+static void report_detection(const trace_t *t)
+{
+    static const event_detector_config_t threshold = EVENT_DETECTOR_CONFIG_DEFAULT();
+    event_detector_config_t cusum = threshold;
+    replay_score_t   score;
+    replay_summary_t summary[2];
+
+    if (!t->has_label) {
+        printf("== Detection: %s — no label column, skipped ==\n", t->name);
+        return;
+    }
+    cusum.engine = EVENT_ENGINE_CUSUM;
+    const event_detector_config_t *engines[2] = { &threshold, &cusum };
+    for (int e = 0; e < 2; e++) {
+        replay_score_init(&score);
+        replay_event_detector_config(t, engines[e], &score);
+        replay_summarize(&score, TRACE_TICK_MS, &summary[e]);
+        replay_score_free(&score);
+    }
+    replay_print_summary(stdout, t->name, &summary[0]);
+    char title[160];
+    snprintf(title, sizeof(title), "%s, CUSUM onset", t->name);
+    replay_print_summary(stdout, title, &summary[1]);
+
+    /* Onset engines: latency gained against false positives paid */
+    static const char *names[2] = { "threshold", "cusum" };
+    printf("== Onset engines: %s ==\n", t->name);
+    printf("  %-10s %-22s %-22s %8s %9s %7s\n", "engine", "urination med/max (s)",
+           "defecation med/max (s)", "detected", "FP/day", "recall");
+    for (int e = 0; e < 2; e++) {
+        const replay_summary_t *s = &summary[e];
+        printf("  %-10s %8.0f / %-11.0f %8.0f / %-11.0f %4u/%-3u %9.2f %7.3f\n", names[e],
+               s->type[LITTER_EVENT_URINATION].trigger_median_s, s->type[LITTER_EVENT_URINATION].trigger_max_s,
+               s->type[LITTER_EVENT_DEFECATION].trigger_median_s, s->type[LITTER_EVENT_DEFECATION].trigger_max_s,
+               s->type[0].detected, s->type[0].events,
+               s->hours > 0 ? s->false_positives * 24.0 / s->hours : 0.0, s->recall);
+    }
+}
+
+/* Unlabelled data (history dumps): what the detector would have reported */
+static void report_events(const trace_t *t)
+{
+    event_detector_t det;
+    uint32_t n[3] = {0};
+    litter_event_t last = LITTER_EVENT_NONE;
+
+    event_detector_init(&det);
+    for (size_t i = 0; i < t->count; i++) {
+        litter_event_t ev = event_detector_update(&det, t->samples[i].ppm);
+        if (ev != last && ev != LITTER_EVENT_NONE) {
+            n[ev]++;
+        }
+        last = ev;
+    }
+    double days = (double)t->count * TRACE_TICK_MS / 86400000.0;
+    printf("== Events raised: %s (%.1f days) ==\n", t->name, days);
+    printf("  URINATION %u (%.1f/day)  DEFECATION %u (%.1f/day)\n", n[LITTER_EVENT_URINATION],
+           days > 0 ? n[LITTER_EVENT_URINATION] / days : 0.0, n[LITTER_EVENT_DEFECATION],
+           days > 0 ? n[LITTER_EVENT_DEFECATION] / days : 0.0);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [--trace FILE]... [--history FILE]... [--hours H] [--seed N]\n"
+            "          [--repeat N] [--save-synth FILE] [-v]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *trace_paths[MAX_TRACES];
+    const char *history_paths[MAX_TRACES];
+    const char *save_path = NULL;
+    int n_paths = 0, n_history = 0;
+    int repeat  = 20;
+    trace_synth_cfg_t synth = trace_synth_default();
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc && n_paths < MAX_TRACES) {
+            trace_paths[n_paths++] = argv[++i];
+        } else if (strcmp(argv[i], "--history") == 0 && i + 1 < argc && n_history < MAX_TRACES) {
+            history_paths[n_history++] = argv[++i];
+        } else if (strcmp(argv[i], "--hours") == 0 && i + 1 < argc) {
+            synth.hours = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            synth.seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--save-synth") == 0 && i + 1 < argc) {
+            save_path = argv[++i];
+        } else if (strcmp(argv[i], "-v") == 0) {
+            host_log_set_level(ESP_LOG_INFO);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    trace_t synthetic;
+    if (!trace_synthesize(&synthetic, &synth)) {
+        fprintf(stderr, "Failed to generate synthetic trace\n");
+        return 1;
+    }
+    if (save_path && !trace_save_csv(&synthetic, save_path)) {
+        return 1;
+    }
+
+    bench_detector(&synthetic, repeat);
+    bench_conversion(repeat);
+    report_detection(&synthetic);
+    trace_free(&synthetic);
+
+    for (int i = 0; i < n_paths; i++) {
+        trace_t recorded;
+        if (!trace_load_csv(&recorded, trace_paths[i]) || !replay_convert_raw(&recorded)) {
+            trace_free(&recorded);
+            return 1;
+        }
+        bench_detector(&recorded, repeat);
+        report_detection(&recorded);
+        trace_free(&recorded);
+    }
+
+    for (int i = 0; i < n_history; i++) {
+        trace_t logged;
+        history_load_stats_t st;
+        if (!history_load_trace(&logged, history_paths[i], &st)) {
+            trace_free(&logged);
+            return 1;
+        }
+        history_print_stats(stdout, logged.name, &st);
+        bench_detector(&logged, repeat);
+        report_events(&logged);
+        trace_free(&logged);
+    }
+    return 0;
+}
@@ -0,0 +1,359 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * features_bench.c — Streaming event features against the stored waveform
+ *
+ * Replays labelled traces (default: four 7-day synthetic ones) through the
+ * detector with the CUSUM onset engine (the threshold one misses most slow
+ * defecation rises, leaving nothing to compare τ on) and, for each
+ * detection, keeps the ACTIVE waveform on the bench side only to check
+ * what event_detector_t computed without it:
+ *  - exact:    the Q15.16 back-end's features equal a recomputation from the
+ *              stored waveform (explicit least-squares fit over the buffer)
+ *  - parity:   float and Q15.16 back-ends give the same features within
+ *              rounding (same detections, area and τ within PARITY_REL,
+ *              rise within PARITY_RISE_CPPM, time to peak within a tick)
+ *  - decay:    the median fitted τ per labelled type lies inside the
+ *              generator's τ range (synthetic traces only)
+ *  - long:     a 12 h ACTIVE event (step, slow rise, decay with a known τ)
+ *              — same detector size, τ recovered within LONG_TAU_REL
+ * and prints the median of each feature per classified type.
+ *
+ * Exits non-zero if any check fails.
+ *
+ * Usage: features_bench [--trace FILE]... [--hours H] [--seed N]
+ */
+#include "air_sensor_driver.h"
+#include "esp_log.h"
+#include "event_detector.h"
+#include "replay.h"
+#include "trace.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_TRACES          16
+#define MAX_EVENTS          4096
+#define WAVE_MAX            65536       /* Bench-side waveform buffer, ticks */
+#define PARITY_REL          0.01
+#define PARITY_RISE_CPPM    2
+#define PARITY_MIN          0.98        /* Share of detections agreeing */
+#define LONG_HOURS          12.0
+#define LONG_TAU_TICKS      120.0
+#define LONG_TAU_REL        0.05
+
+/* Generator τ ranges in ticks (trace.c: urination 2.5–4.5 min, defecation 4–6 min) */
+static const double k_tau_lo[3] = { 0, 75, 120 };
+static const double k_tau_hi[3] = { 0, 135, 180 };
+static const char  *k_names[3]  = { "none", "urination", "defecation" };
+
+typedef struct {
+    uint8_t          type;          /* Classified */
+    uint8_t          label;         /* Matched labelled onset, NONE if unmatched */
+    event_features_t f;
+} detection_t;
+
+typedef struct {
+    detection_t det[MAX_EVENTS];
+    size_t      n;
+} detections_t;
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double median(double *v, size_t n)
+{
+    if (n == 0) {
+        return 0.0;
+    }
+    qsort(v, n, sizeof(*v), cmp_double);
+    return (n & 1) ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+}
+
+/* What the detector should report, recomputed from the buffered ACTIVE
+ * waveform: excess[k] = ppm − baseline, rise[k] = ppm − previous reading.
+ * τ is an explicit least-squares fit of Δx against the tick midpoint. */
+static event_features_t features_from_wave(const int32_t *ppm, const int32_t *excess, const int32_t *rise,
+                                           size_t n)
+{
+    int64_t auc = 0;
+    int32_t max_rise = rise[0];
+    size_t  peak = 0;
+    for (size_t k = 0; k < n; k++) {
+        auc += excess[k] > 0 ? excess[k] : 0;
+        max_rise = rise[k] > max_rise ? rise[k] : max_rise;
+        peak = ppm[k] > ppm[peak] ? k : peak;
+    }
+    const int shift = EVENT_PPM_Q_SHIFT - EVENT_DECAY_FIT_SHIFT;
+    int64_t m = 0, sy = 0, syy = 0, syd = 0, sd = 0;
+    for (size_t k = peak + 1; k < n; k++) {
+        int64_t a = excess[k - 1] >> shift, b = excess[k] >> shift;
+        m++;
+        sy  += a + b;
+        syy += (a + b) * (a + b);
+        syd += (a + b) * (b - a);
+        sd  += b - a;
+    }
+    int64_t tau = 0;
+    int64_t fall = (excess[peak] >> shift) - (excess[n - 1] >> shift);
+    if (m >= 2 && fall >= (int64_t)(EVENT_DECAY_FIT_MIN_PPM * (1 << EVENT_DECAY_FIT_SHIFT))) {
+        int64_t sxx = m * syy - sy * sy;
+        int64_t sxd = 2 * m * syd - 2 * sy * sd;
+        tau = sxd < 0 ? sxx / -sxd : 0;
+    }
+    int64_t auc_d  = (auc * 10) >> EVENT_PPM_Q_SHIFT;
+    int64_t rise_c = ((int64_t)max_rise * 100) >> EVENT_PPM_Q_SHIFT;
+    return (event_features_t) {
+        .auc_dppm_ticks     = auc_d > UINT32_MAX ? UINT32_MAX : (uint32_t)auc_d,
+        .max_rise_cppm      = rise_c < 0 ? 0 : rise_c > UINT16_MAX ? UINT16_MAX : (uint16_t)rise_c,
+        .time_to_peak_ticks = (uint16_t)peak,
+        .decay_tau_ticks    = tau < 0 ? 0 : tau > UINT16_MAX ? UINT16_MAX : (uint16_t)tau,
+        .duration_ticks     = (uint16_t)n,
+    };
+}
+
+static bool rel_close(double a, double b, double rel, double abs_tol)
+{
+    return fabs(a - b) <= fmax(abs_tol, rel * fmax(fabs(a), fabs(b)));
+}
+
+static bool features_close(const event_features_t *a, const event_features_t *b)
+{
+    return rel_close(a->auc_dppm_ticks, b->auc_dppm_ticks, PARITY_REL, 10)
+        && abs(a->max_rise_cppm - b->max_rise_cppm) <= PARITY_RISE_CPPM
+        && abs(a->time_to_peak_ticks - b->time_to_peak_ticks) <= 1
+        && rel_close(a->decay_tau_ticks, b->decay_tau_ticks, PARITY_REL, 1)
+        && a->duration_ticks == b->duration_ticks;
+}
+
+/* One trace: float and Q15.16 side by side; detections of both appended */
+static void run(const trace_t *t, const event_detector_config_t *cfg, detections_t *df, detections_t *dq,
+                uint32_t *exact, uint32_t *checked)
+{
+    static int32_t wave[WAVE_MAX], excess[WAVE_MAX], rise[WAVE_MAX];
+    event_detector_t det, det_q;
+    event_detector_init_with_config(&det, cfg);
+    event_detector_init_with_config(&det_q, cfg);
+
+    long    onset = -1;
+    uint8_t label = LITTER_EVENT_NONE, ev_label = LITTER_EVENT_NONE, ev_label_q = LITTER_EVENT_NONE;
+    size_t  n_wave = 0;
+
+    for (size_t i = 0; i < t->count; i++) {
+        /* Both back-ends see the Q10.6 reading air_sensor_read() hands to main.c */
+        uint16_t q6 = (uint16_t)(t->samples[i].ppm * (1 << AIR_SENSOR_PPM_Q_SHIFT) + 0.5f);
+        int32_t  ppm_q = (int32_t)q6 << (EVENT_PPM_Q_SHIFT - AIR_SENSOR_PPM_Q_SHIFT);
+        detector_state_t before = det.state, before_q = det_q.state;
+        int32_t prev_q = det_q.prev_q;
+        event_detector_update(&det, q6 / (float)(1 << AIR_SENSOR_PPM_Q_SHIFT));
+        event_detector_update_q(&det_q, ppm_q);
+
+        if (t->samples[i].label != LITTER_EVENT_NONE) {
+            onset = (long)i;
+            label = t->samples[i].label;
+        }
+        bool matched = onset >= 0 && i - (size_t)onset <= REPLAY_MATCH_WINDOW_TICKS;
+
+        if (before == DETECTOR_IDLE && det.state == DETECTOR_ACTIVE) {
+            ev_label = matched ? label : LITTER_EVENT_NONE;
+        }
+        if (before == DETECTOR_ACTIVE && det.state != DETECTOR_ACTIVE && df->n < MAX_EVENTS) {
+            df->det[df->n++] = (detection_t) { det.current_event, ev_label, det.features };
+        }
+
+        /* Q15.16: buffer the waveform the detector never stores */
+        if (before_q == DETECTOR_IDLE && det_q.state == DETECTOR_ACTIVE) {
+            ev_label_q = matched ? label : LITTER_EVENT_NONE;
+            n_wave = 0;
+        }
+        if ((det_q.state == DETECTOR_ACTIVE || before_q == DETECTOR_ACTIVE) && n_wave < WAVE_MAX) {
+            wave[n_wave]   = ppm_q;
+            excess[n_wave] = ppm_q - det_q.baseline_q;
+            rise[n_wave]   = ppm_q - prev_q;
+            n_wave++;
+        }
+        if (before_q == DETECTOR_ACTIVE && det_q.state != DETECTOR_ACTIVE) {
+            event_features_t ref = features_from_wave(wave, excess, rise, n_wave);
+            (*checked)++;
+            *exact += memcmp(&ref, &det_q.features, sizeof(ref)) == 0;
+            if (dq->n < MAX_EVENTS) {
+                dq->det[dq->n++] = (detection_t) { det_q.current_event, ev_label_q, det_q.features };
+            }
+        }
+    }
+}
+
+/* Median of each feature per classified type */
+static void print_medians(const detections_t *d)
+{
+    static double v[5][MAX_EVENTS];
+    printf("  %-11s %5s %14s %14s %12s %10s %10s\n", "type", "n", "area ppm·min", "rise ppm/min",
+           "to peak min", "tau min", "dur min");
+    for (int type = LITTER_EVENT_URINATION; type <= LITTER_EVENT_DEFECATION; type++) {
+        size_t n = 0;
+        for (size_t k = 0; k < d->n; k++) {
+            const event_features_t *f = &d->det[k].f;
+            if (d->det[k].type != type) {
+                continue;
+            }
+            v[0][n] = f->auc_dppm_ticks / 10.0 / 30.0;
+            v[1][n] = f->max_rise_cppm / 100.0 * 30.0;
+            v[2][n] = f->time_to_peak_ticks / 30.0;
+            v[3][n] = f->decay_tau_ticks / 30.0;
+            v[4][n] = f->duration_ticks / 30.0;
+            n++;
+        }
+        printf("  %-11s %5zu %14.1f %14.2f %12.1f %10.1f %10.1f\n", k_names[type], n, median(v[0], n),
+               median(v[1], n), median(v[2], n), median(v[3], n), median(v[4], n));
+    }
+}
+
+/* τ per labelled type against the generator's range */
+static bool check_decay(const detections_t *d)
+{
+    static double tau[MAX_EVENTS];
+    bool ok = true;
+    for (int type = LITTER_EVENT_URINATION; type <= LITTER_EVENT_DEFECATION; type++) {
+        size_t n = 0, fitted = 0, labelled = 0;
+        for (size_t k = 0; k < d->n; k++) {
+            if (d->det[k].label != type) {
+                continue;
+            }
+            labelled++;
+            if (d->det[k].f.decay_tau_ticks) {
+                tau[n++] = d->det[k].f.decay_tau_ticks;
+            }
+        }
+        fitted = n;
+        double med = median(tau, n);
+        bool in = n > 0 && med >= k_tau_lo[type] && med <= k_tau_hi[type];
+        printf("  %-11s τ fitted %zu/%zu, median %.0f ticks (%.1f min), generator %.0f–%.0f ticks%s\n",
+               k_names[type], fitted, labelled, med, med / 30.0, k_tau_lo[type], k_tau_hi[type],
+               in ? "" : "  FAIL");
+        ok &= in;
+    }
+    return ok;
+}
+
+/* A step, a 12 h rise, then an exponential decay with a known τ, through the Q back-end */
+static bool check_long(void)
+{
+    event_detector_t det;
+    event_detector_init(&det);
+    const double base = 5.0, step = 40.0;
+    const size_t warm = 600, ramp = (size_t)(LONG_HOURS * 3600 * 1000 / TRACE_TICK_MS);
+    size_t sz_before = sizeof(det);
+
+    for (size_t i = 0; det.state != DETECTOR_COOLDOWN && i < warm + ramp + 20 * LONG_TAU_TICKS; i++) {
+        double ppm = base;
+        if (i >= warm + ramp) {
+            ppm += step * exp(-(double)(i - warm - ramp) / LONG_TAU_TICKS);
+        } else if (i >= warm) {
+            ppm += step * (0.4 + 0.6 * (double)(i - warm + 1) / ramp);     /* Triggers on the first tick */
+        }
+        event_detector_update_q(&det, EVENT_PPM_TO_Q((float)ppm));
+    }
+    const event_features_t *f = &det.features;
+    double tau = f->decay_tau_ticks;
+    bool ok = det.state == DETECTOR_COOLDOWN && f->duration_ticks > ramp
+           && fabs(tau - LONG_TAU_TICKS) <= LONG_TAU_REL * LONG_TAU_TICKS && sizeof(det) == sz_before;
+    printf("long: %.0f h ACTIVE (%u ticks) in the same %zu B event_detector_t, τ %.0f ticks (set %.0f), "
+           "area %.0f ppm·min%s\n",
+           f->duration_ticks * TRACE_TICK_MS / 3600000.0, f->duration_ticks, sizeof(det), tau, LONG_TAU_TICKS,
+           f->auc_dppm_ticks / 10.0 / 30.0, ok ? "" : "  FAIL");
+    return ok;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "Usage: %s [--trace FILE]... [--hours H] [--seed N]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *trace_paths[MAX_TRACES];
+    int n_paths = 0;
+    trace_synth_cfg_t synth = trace_synth_default();
+    synth.hours = 24.0 * 7;
+    bool seed_set = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc && n_paths < MAX_TRACES) {
+            trace_paths[n_paths++] = argv[++i];
+        } else if (strcmp(argv[i], "--hours") == 0 && i + 1 < argc) {
+            synth.hours = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            synth.seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+            seed_set = true;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    host_log_set_level(ESP_LOG_WARN);
+
+    /* Traces: the given ones, else one synthetic (--seed) or seeds 1–4 */
+    trace_t traces[MAX_TRACES];
+    int n_traces = 0;
+    for (int i = 0; i < n_paths; i++) {
+        if (!trace_load_csv(&traces[n_traces], trace_paths[i]) || !replay_convert_raw(&traces[n_traces])) {
+            return 1;
+        }
+        n_traces++;
+    }
+    for (uint32_t seed = 1; n_paths == 0 && seed <= (seed_set ? 1u : 4u); seed++) {
+        if (!seed_set) {
+            synth.seed = seed;
+        }
+        if (!trace_synthesize(&traces[n_traces++], &synth)) {
+            fprintf(stderr, "Failed to generate synthetic trace\n");
+            return 1;
+        }
+    }
+
+    static const event_detector_config_t threshold = EVENT_DETECTOR_CONFIG_DEFAULT();
+    event_detector_config_t cusum = threshold;
+    cusum.engine = EVENT_ENGINE_CUSUM;
+    static detections_t df, dq;
+    uint32_t exact = 0, checked = 0;
+    for (int i = 0; i < n_traces; i++) {
+        run(&traces[i], &cusum, &df, &dq, &exact, &checked);
+    }
+
+    bool ok = true;
+    printf("== Event features, %d trace(s) ==\n", n_traces);
+    bool exact_ok = checked > 0 && exact == checked;
+    printf("exact:  %u/%u detections equal the recomputation from the stored waveform%s\n",
+           exact, checked, exact_ok ? "" : "  FAIL");
+    ok &= exact_ok;
+
+    size_t agree = 0;
+    bool same_n = df.n == dq.n;
+    for (size_t k = 0; same_n && k < df.n; k++) {
+        agree += df.det[k].type == dq.det[k].type && features_close(&df.det[k].f, &dq.det[k].f);
+    }
+    bool parity_ok = same_n && agree >= PARITY_MIN * df.n;
+    printf("parity: float and Q15.16 agree on %zu/%zu detections (%zu vs %zu)%s\n",
+           agree, df.n, df.n, dq.n, parity_ok ? "" : "  FAIL");
+    ok &= parity_ok;
+
+    printf("medians by classified type (float back-end):\n");
+    print_medians(&df);
+    if (n_paths == 0) {
+        printf("decay constant vs labels:\n");
+        ok &= check_decay(&df);
+    }
+    ok &= check_long();
+
+    for (int i = 0; i < n_traces; i++) {
+        trace_free(&traces[i]);
+    }
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,503 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * firmware_sim_bench.c — main.c on a mocked Zigbee stack, a month of virtual time
+ *
+ * Runs the firmware's own control flow (app_main → esp_zb_task → signal
+ * handler → sensor_sample_timer_cb → sensor_report → report_flush) against
+ * host/stubs/esp_zigbee.c, fed by air_sensor_sim replaying a synthetic
+ * trace on the virtual esp_timer clock:
+ *
+ * 1. Month: first start and steering fail a few times before the join, so
+ *    the retry alarms run; the hub acknowledges reports after 100 ms, loses
+ *    2 % of frames each way, drops out for 6 h on day 10 (the device then
+ *    rejoins), switches the LED on and reconfigures NH₃ reporting on day 1.
+ *    Every frame is decoded hub-side: attribute reports, event types,
+ *    journal entries de-duplicated by sequence number.
+ * 2. Reboot: a day on a saved network (DEVICE_REBOOT, no steering).
+ *
+ * Every run is a forked child, so main.c's statics start fresh; the month
+ * runs twice and both runs must match exactly. Checks: commissioning
+ * attempts and join time, one sample per 2 s from the join on, one lock
+ * per tick and channel (balanced), one report frame at most per tick and
+ * channel, no attribute set the stack would refuse, every event type change
+ * also delivered through the journal with no sequence gap and no
+ * more events than the trace has labelled onsets, the hub's
+ * configuration acknowledged and the LED on.
+ *
+ * Prints radio frames, attribute sets, lock acquisitions and events per
+ * day, the speed-up over real time and a fingerprint (hash of every frame
+ * and attribute set with its time). --expect compares the fingerprint, so
+ * a CI job notices any change in what the device sends.
+ *
+ *   firmware_sim_bench [--days N] [--seed N] [--loss P] [--outage H] [--expect HEX] [-v]
+ *
+ * Exits non-zero on any failed check.
+ */
+#include "main.h"
+#include "air_sensor_sim.h"
+#include "bench_clock.h"
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "event_journal.h"
+#include "report_mgr.h"
+#include "trace.h"
+#include "zboss_api.h"
+#include "zcl_reporting.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define DAY_US          (86400LL * 1000000)
+#define TICK_US         ((int64_t)SENSOR_SAMPLE_INTERVAL_MS * 1000)
+#define RETRY_US        1000000LL       /* main.c: commissioning retried after 1 s */
+
+/* Defined in main.c */
+void app_main(void);
+
+typedef struct {
+    double   days;
+    bool     factory_new;
+    uint32_t init_failures;
+    uint32_t steering_failures;
+    uint16_t loss_permille;
+    double   outage_h;                  /* From day 10 (or a third of the run) */
+    bool     hub_actions;               /* LED on, NH₃ reporting reconfigured */
+    bool     verbose;
+} scenario_t;
+
+/* What the hub saw */
+typedef struct {
+    uint32_t reports;                   /* Report Attributes frames received */
+    uint32_t records;
+    uint32_t nh3;
+    uint32_t blocks;
+    uint32_t snippets;
+    uint32_t provisional;
+    uint32_t events[3];                 /* Changes of 0x0003 to each litter_event_t */
+    uint8_t  last_event;
+    uint32_t journal;                   /* Entries, each sequence number once */
+    uint32_t journal_dups;
+    uint32_t journal_gaps;
+    uint16_t journal_next;
+    bool     journal_seen;
+    uint32_t malformed;
+    uint32_t cfg_resps;
+    uint8_t  cfg_status;
+    uint32_t burst_max;                 /* Frames from one endpoint at one instant */
+    uint32_t burst;
+    int64_t  burst_t_us;
+    uint8_t  burst_ep;
+} hub_t;
+
+typedef struct {
+    host_zb_stats_t zb;
+    hub_t    hub;
+    size_t   rows;                      /* Sensor rows consumed */
+    uint32_t labelled;                  /* Labelled events in them */
+    int      led;                       /* LED GPIO level at the end */
+    uint32_t usage_refreshes;           /* Sets of 0x0009 */
+    double   wall_s;
+} sim_result_t;
+
+static const scenario_t *s_scn;
+static const trace_t    *s_trace;
+static hub_t             s_hub;
+
+static size_t zcl_value_len(uint8_t type, const uint8_t *p, size_t avail)
+{
+    switch (type) {
+    case ESP_ZB_ZCL_ATTR_TYPE_BOOL:
+    case ESP_ZB_ZCL_ATTR_TYPE_U8:           return 1;
+    case ESP_ZB_ZCL_ATTR_TYPE_U16:          return 2;
+    case ESP_ZB_ZCL_ATTR_TYPE_U32:          return 4;
+    case ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING:
+    case ESP_ZB_ZCL_ATTR_TYPE_CHAR_STRING:  return avail ? 1u + p[0] : 0;
+    default:                                return 0;
+    }
+}
+
+static void hub_journal(hub_t *h, const uint8_t *p, size_t len)
+{
+    event_journal_hdr_t hdr;
+    event_journal_entry_t e[EVENT_JOURNAL_BURST];
+    int n = event_journal_decode(p, len, &hdr, e, EVENT_JOURNAL_BURST);
+    if (n < 0) {
+        h->malformed++;
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        if (h->journal_seen && (int16_t)(e[i].seq - h->journal_next) < 0) {
+            h->journal_dups++;
+            continue;
+        }
+        if (h->journal_seen && e[i].seq != h->journal_next) {
+            h->journal_gaps++;
+        }
+        h->journal_seen = true;
+        h->journal_next = (uint16_t)(e[i].seq + 1);
+        h->journal++;
+    }
+}
+
+static void hub_report(hub_t *h, const uint8_t *p, size_t len)
+{
+    size_t pos = 0;
+    h->reports++;
+    while (pos < len) {
+        if (len - pos < 3) {
+            h->malformed++;
+            return;
+        }
+        uint16_t id = (uint16_t)(p[pos] | p[pos + 1] << 8);
+        uint8_t type = p[pos + 2];
+        pos += 3;
+        size_t vlen = zcl_value_len(type, &p[pos], len - pos);
+        if (vlen == 0 || vlen > len - pos) {
+            h->malformed++;
+            return;
+        }
+        const uint8_t *v = &p[pos];
+        pos += vlen;
+        h->records++;
+
+        switch (id) {
+        case NH3_ATTR_MEASURED_VALUE_ID:
+            h->nh3++;
+            break;
+        case NH3_ATTR_EVENT_TYPE_ID:
+            if (v[0] != h->last_event && v[0] < 3) {
+                h->events[v[0]]++;
+            }
+            h->last_event = v[0];
+            break;
+        case NH3_ATTR_SAMPLE_BLOCK_ID:
+            h->blocks++;
+            break;
+        case NH3_ATTR_EVENT_JOURNAL_ID:
+            hub_journal(h, v + 1, vlen - 1);
+            break;
+        case NH3_ATTR_SNIPPET_INFO_ID:
+            h->snippets++;
+            break;
+        case NH3_ATTR_PROVISIONAL_EVENT_ID:
+            h->provisional++;
+            break;
+        }
+    }
+}
+
+static void on_frame(const host_zb_frame_t *f, void *ctx)
+{
+    hub_t *h = ctx;
+
+    if (f->cluster_id != NH3_CUSTOM_CLUSTER_ID) {
+        return;
+    }
+    size_t hdr = (f->len && (f->data[0] & 0x04)) ? 5 : 3;
+    if (f->len < hdr) {
+        h->malformed++;
+        return;
+    }
+    bool common = (f->data[0] & 0x03) == ZB_ZCL_FRAME_TYPE_COMMON;
+    uint8_t cmd = f->data[hdr - 1];
+    if (common && cmd == ZCL_CMD_CONFIGURE_REPORTING_RESP) {
+        /* What the device answered, delivered or not */
+        h->cfg_resps++;
+        h->cfg_status = f->len > hdr ? f->data[hdr] : 0xFF;
+    } else if (common && cmd == ZCL_CMD_REPORT_ATTRIBUTES) {
+        /* Sent at one instant from one endpoint: the reports of one tick */
+        if (f->t_us == h->burst_t_us && f->src_ep == h->burst_ep) {
+            h->burst++;
+        } else {
+            h->burst = 1;
+            h->burst_t_us = f->t_us;
+            h->burst_ep = f->src_ep;
+        }
+        if (h->burst > h->burst_max) {
+            h->burst_max = h->burst;
+        }
+        if (!f->lost) {
+            hub_report(h, f->data + hdr, f->len - hdr);
+        }
+    }
+}
+
+/* ── Hub actions ────────────────────────────────────────────────────── */
+
+static void hub_led_on(void *ctx)
+{
+    bool on = true;
+    host_zb_hub_write_attr(HA_LITTERBOX_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ON_OFF, ESP_ZB_ZCL_ATTR_ON_OFF_ON_OFF_ID,
+                           ESP_ZB_ZCL_ATTR_TYPE_BOOL, &on, 1);
+}
+
+/* NH₃: 30–600 s, ±5 ppm */
+static void hub_configure(void *ctx)
+{
+    static const uint8_t payload[] = {
+        ZCL_REPORT_DIRECTION_REPORTED, (uint8_t)NH3_ATTR_MEASURED_VALUE_ID, NH3_ATTR_MEASURED_VALUE_ID >> 8,
+        ZCL_TYPE_U16, 30, 0, (uint8_t)600, 600 >> 8, 5, 0,
+    };
+    host_zb_hub_command(HA_LITTERBOX_ENDPOINT, NH3_CUSTOM_CLUSTER_ID, true, ZCL_CMD_CONFIGURE_REPORTING,
+                        payload, sizeof(payload));
+}
+
+/* ── One run ────────────────────────────────────────────────────────── */
+
+static host_zb_cfg_t scenario_cfg(const scenario_t *scn)
+{
+    host_zb_cfg_t cfg = HOST_ZB_CFG_DEFAULT();
+    cfg.run_us            = (int64_t)(scn->days * DAY_US);
+    cfg.factory_new       = scn->factory_new;
+    cfg.init_failures     = scn->init_failures;
+    cfg.steering_failures = scn->steering_failures;
+    cfg.loss_permille     = scn->loss_permille;
+    cfg.seed              = 0x5eed;
+    if (scn->outage_h > 0) {
+        cfg.outage_at_us = scn->days >= 30 ? 10 * DAY_US : cfg.run_us / 3;
+        cfg.outage_us    = (int64_t)(scn->outage_h * 3600e6);
+    }
+    return cfg;
+}
+
+static void sim_run(sim_result_t *r)
+{
+    const scenario_t *scn = s_scn;
+    host_log_set_level(scn->verbose ? ESP_LOG_INFO : ESP_LOG_ERROR);
+    host_timer_set_time_us(0);
+
+    host_zb_cfg_t cfg = scenario_cfg(scn);
+    host_zb_configure(&cfg);
+    host_zb_set_frame_hook(on_frame, &s_hub);
+    if (scn->hub_actions) {
+        host_zb_at(10 * 60 * 1000000LL, hub_led_on, NULL);
+        host_zb_at(DAY_US, hub_configure, NULL);
+    }
+
+    air_sensor_sim_reset();
+    air_sensor_sim_set_trace(0, (trace_t *)s_trace);
+    for (int ch = 1; ch < AIR_SENSOR_CHANNELS; ch++) {
+        air_sensor_sim_set_trace(ch, (trace_t *)s_trace);
+    }
+    air_sensor_select(&air_sensor_sim);
+
+    uint64_t t0 = bench_now_ns();
+    app_main();         /* Returns when the mocked main loop reaches cfg.run_us */
+    r->wall_s = (bench_now_ns() - t0) / 1e9;
+
+    r->zb   = *host_zb_stats();
+    r->hub  = s_hub;
+    r->rows = air_sensor_sim_position();
+    for (size_t i = 0; i < r->rows && i < s_trace->count; i++) {
+        r->labelled += s_trace->samples[i].label != LITTER_EVENT_NONE;
+    }
+    r->led = host_gpio_get_level(LIGHT_LED_GPIO);
+    host_zb_attr_t a;
+    if (host_zb_attr_get(HA_LITTERBOX_ENDPOINT, NH3_CUSTOM_CLUSTER_ID, NH3_ATTR_USAGE_DAYS_ID, &a)) {
+        r->usage_refreshes = a.sets;
+    }
+}
+
+/* Run in a child process: main.c's statics only initialize once */
+static bool sim_fork(const scenario_t *scn, sim_result_t *r)
+{
+    int fd[2];
+    if (pipe(fd) != 0) {
+        perror("pipe");
+        return false;
+    }
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return false;
+    }
+    if (pid == 0) {
+        close(fd[0]);
+        sim_result_t res = {0};
+        s_scn = scn;
+        sim_run(&res);
+        ssize_t n = write(fd[1], &res, sizeof(res));
+        _exit(n == (ssize_t)sizeof(res) ? 0 : 1);
+    }
+    close(fd[1]);
+    size_t got = 0;
+    ssize_t n;
+    memset(r, 0, sizeof(*r));
+    while (got < sizeof(*r) && (n = read(fd[0], (uint8_t *)r + got, sizeof(*r) - got)) > 0) {
+        got += (size_t)n;
+    }
+    close(fd[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (got != sizeof(*r) || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "simulation child failed (status %d)\n", status);
+        return false;
+    }
+    return true;
+}
+
+static uint64_t fingerprint(const sim_result_t *r)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    const uint64_t v[2] = { r->zb.frame_hash, r->zb.attr_hash };
+    const uint8_t *p = (const uint8_t *)v;
+    for (size_t i = 0; i < sizeof(v); i++) {
+        h = (h ^ p[i]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/* ── Checks ─────────────────────────────────────────────────────────── */
+
+static bool check(bool ok, const char *what)
+{
+    if (!ok) {
+        printf("  FAIL: %s\n", what);
+    }
+    return ok;
+}
+
+static bool check_run(const scenario_t *scn, const sim_result_t *r)
+{
+    const host_zb_stats_t *zb = &r->zb;
+    int64_t run_us = (int64_t)(scn->days * DAY_US);
+    uint32_t retries = scn->init_failures + (scn->factory_new ? scn->steering_failures : 0);
+
+    /* SKIP_STARTUP → initialization (retried every 1 s) → steering (each attempt
+     * takes steering_ms, retried 1 s after a failure) */
+    int64_t join_us = scn->init_failures * RETRY_US;
+    if (scn->factory_new) {
+        host_zb_cfg_t dflt = HOST_ZB_CFG_DEFAULT();
+        int64_t steer_us = (int64_t)dflt.steering_ms * 1000;
+        join_us += scn->steering_failures * (steer_us + RETRY_US) + steer_us;
+    }
+    uint32_t ticks = (uint32_t)((run_us - join_us) / TICK_US);
+
+    bool ok = true;
+    ok &= check(zb->commissioning == 1 + retries + (scn->factory_new ? 1 : 0), "commissioning attempts");
+    ok &= check(zb->joined_us == join_us, "join time");
+    ok &= check(r->rows == (size_t)ticks + 1, "one sensor conversion per tick from the join on");
+    ok &= check(zb->alarms_run == ticks + retries, "alarms run: ticks + commissioning retries");
+    ok &= check(zb->lock_acquires == ticks * AIR_SENSOR_CHANNELS, "one Zigbee lock per tick and channel");
+    ok &= check(zb->lock_releases == zb->lock_acquires && zb->lock_depth_max == 1, "lock balanced, never nested");
+    ok &= check(r->hub.burst_max <= 1, "one report frame at most per tick and channel");
+    ok &= check(zb->attr_set_errors == 0, "no attribute set refused by the stack");
+    ok &= check(zb->buf_exhausted == 0, "no buffer exhaustion");
+    ok &= check(r->hub.malformed == 0, "every frame decodes");
+
+    uint32_t events = r->hub.events[LITTER_EVENT_URINATION] + r->hub.events[LITTER_EVENT_DEFECATION];
+    /* Event type is a last value: a change superseded during an outage never
+     * arrives, its journal entry does. The last entry may still be in flight. */
+    ok &= check(events > 0 && r->hub.journal + 1 >= events, "every event type change also journaled");
+    ok &= check(events <= r->labelled, "no more events than labelled onsets");
+    ok &= check(r->hub.journal_gaps == 0, "journal sequence without gaps");
+    ok &= check(r->usage_refreshes > 0, "usage statistics refreshed");
+    if (scn->hub_actions) {
+        ok &= check(r->hub.cfg_resps == 1 && r->hub.cfg_status == ZCL_STATUS_SUCCESS, "Configure Reporting accepted");
+        ok &= check(r->led == 0, "LED on (active low)");
+    }
+    return ok;
+}
+
+static void print_run(const char *title, const scenario_t *scn, const sim_result_t *r)
+{
+    const host_zb_stats_t *zb = &r->zb;
+    double days = scn->days;
+    printf("%s: %.0f day(s) in %.2f s wall (%.0f× real time)\n", title, days, r->wall_s,
+           days * 86400.0 / (r->wall_s > 0 ? r->wall_s : 1e-9));
+    printf("  commissioning %"PRIu32" (joined at %.1f s), signals %"PRIu32", alarms %"PRIu32" run / %"PRIu32" set\n",
+           zb->commissioning, zb->joined_us / 1e6, zb->signals, zb->alarms_run, zb->alarms);
+    printf("  radio frames %"PRIu32" (%.0f/day): %"PRIu32" reports, %"PRIu32" lost; acks %"PRIu32" (%"PRIu32" lost)\n",
+           zb->frames, zb->frames / days, zb->frames_report, zb->frames_lost, zb->acks, zb->acks_lost);
+    printf("  attribute sets %"PRIu32" (%.0f/day), lock acquisitions %"PRIu32" (%.0f/day), sensor rows %zu\n",
+           zb->attr_sets, zb->attr_sets / days, zb->lock_acquires, zb->lock_acquires / days, r->rows);
+    printf("  hub: %"PRIu32" reports / %"PRIu32" records — NH3 %"PRIu32", blocks %"PRIu32", snippets %"PRIu32
+           ", provisional %"PRIu32"\n", r->hub.reports, r->hub.records, r->hub.nh3, r->hub.blocks, r->hub.snippets,
+           r->hub.provisional);
+    printf("  events: urination %"PRIu32", defecation %"PRIu32" (%.1f/day; %"PRIu32" labelled), journal %"PRIu32
+           " (+%"PRIu32" duplicates)\n", r->hub.events[LITTER_EVENT_URINATION], r->hub.events[LITTER_EVENT_DEFECATION],
+           (r->hub.events[1] + r->hub.events[2]) / days, r->labelled, r->hub.journal, r->hub.journal_dups);
+    printf("  fingerprint %016"PRIx64"\n", fingerprint(r));
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [--days N] [--seed N] [--loss P] [--outage H] [--expect HEX] [-v]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    scenario_t month = {
+        .days = 30, .factory_new = true, .init_failures = 2, .steering_failures = 3,
+        .loss_permille = 20, .outage_h = 6, .hub_actions = true,
+    };
+    trace_synth_cfg_t synth = trace_synth_default();
+    const char *expect = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--days") == 0 && i + 1 < argc) {
+            month.days = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            synth.seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--loss") == 0 && i + 1 < argc) {
+            month.loss_permille = (uint16_t)(atof(argv[++i]) * 1000 + 0.5);
+        } else if (strcmp(argv[i], "--outage") == 0 && i + 1 < argc) {
+            month.outage_h = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--expect") == 0 && i + 1 < argc) {
+            expect = argv[++i];
+        } else if (strcmp(argv[i], "-v") == 0) {
+            month.verbose = true;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (month.days < 2) {
+        fprintf(stderr, "--days must be at least 2 (the hub reconfigures reporting on day 1)\n");
+        return 2;
+    }
+
+    /* One trace for every run, a few hours longer than the longest */
+    trace_t trace;
+    synth.hours = month.days * 24 + 1;
+    if (!trace_synthesize(&trace, &synth)) {
+        fprintf(stderr, "Failed to generate synthetic trace\n");
+        return 1;
+    }
+    s_trace = &trace;
+
+    bool ok = true;
+    sim_result_t a, b, boot;
+    if (!sim_fork(&month, &a) || !sim_fork(&month, &b)) {
+        trace_free(&trace);
+        return 1;
+    }
+    print_run("Month", &month, &a);
+    ok &= check_run(&month, &a);
+    a.wall_s = b.wall_s = 0;
+    ok &= check(memcmp(&a, &b, sizeof(a)) == 0, "second run identical");
+    if (expect) {
+        uint64_t want = strtoull(expect, NULL, 16);
+        ok &= check(fingerprint(&a) == want, "fingerprint matches --expect");
+    }
+
+    scenario_t reboot = { .days = 1, .factory_new = false, .init_failures = 1 };
+    if (!sim_fork(&reboot, &boot)) {
+        trace_free(&trace);
+        return 1;
+    }
+    print_run("Reboot", &reboot, &boot);
+    ok &= check_run(&reboot, &boot);
+
+    trace_free(&trace);
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,232 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * fixedpoint_bench.c — Float vs fixed-point pipeline (CONFIG_LITTERBOX_FIXED_POINT)
+ *
+ * 1. raw→ppm: generated lookup table vs the float powf() path, all 4096 codes
+ * 2. Detector: event_detector_update() vs event_detector_update_q() on the
+ *    same Q10.6-quantized input (what air_sensor_read() hands to main.c),
+ *    with each onset engine
+ * 3. Cost of each path, in ns and cycles
+ *
+ * Exits non-zero when a tolerance below is exceeded.
+ *
+ * The host has an FPU, so the float/fixed gap here understates the gain on
+ * the FPU-less ESP32-C6, where powf() and every float op are library calls.
+ */
+#include "air_sensor_driver.h"
+#include "bench_clock.h"
+#include "esp_adc/adc_oneshot.h"
+#include "event_detector.h"
+#include "mq135_lut.h"
+#include "trace.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Stated tolerances
+ *  - Conversion: half a Q10.6 LSB (1/128 ppm) plus float32 rounding of the powf() path.
+ *  - Baseline: Q15.16 EMA rounding settles within ~0.5 LSB / alpha ≈ 1.5e-4 ppm.
+ *  - State: a sample landing within that error of a threshold may flip a
+ *    transition by a tick or two; the sequence of classified events must
+ *    still match exactly. Baseline is compared only once RESYNC_TICKS have
+ *    passed since the last state difference (EMA time constant is 20 ticks).
+ */
+#define CONVERSION_TOL_PPM      0.01f
+#define BASELINE_TOL_PPM        0.001f
+#define STATE_MISMATCH_TOL      0.001   /* Fraction of ticks whose state may differ */
+#define RESYNC_TICKS            300
+#define EVENT_SEQ_MAX           1024
+
+/* Fixed-point build of the MQ-135 backend, renamed at compile time (CMakeLists.txt) */
+extern const air_sensor_backend_t air_sensor_mq135_fx;
+
+static esp_err_t air_sensor_fx_init(void)
+{
+    return air_sensor_mq135_fx.init();
+}
+
+static esp_err_t air_sensor_fx_read(air_sensor_data_t *out)
+{
+    return air_sensor_backend_read(&air_sensor_mq135_fx, out);
+}
+
+static volatile uint32_t s_sink;
+
+/* ── 1. Conversion accuracy ─────────────────────────────────────────── */
+
+static bool check_conversion(void)
+{
+    air_sensor_data_t ref, fx;
+    float    max_err = 0.0f;
+    int      max_err_raw = 0;
+    unsigned int_mismatch = 0;
+
+    air_sensor_init();
+    air_sensor_fx_init();
+    for (int raw = 0; raw < MQ135_LUT_SIZE; raw++) {
+        host_adc_set_raw(ADC_CHANNEL_0, raw);
+        air_sensor_read(&ref);
+        air_sensor_fx_read(&fx);
+
+        float err = fabsf(ref.nh3_ppm_f - fx.nh3_ppm_q / (float)(1 << AIR_SENSOR_PPM_Q_SHIFT));
+        if (err > max_err) {
+            max_err     = err;
+            max_err_raw = raw;
+        }
+        int_mismatch += (ref.nh3_ppm != fx.nh3_ppm);
+    }
+
+    bool ok = max_err <= CONVERSION_TOL_PPM;
+    printf("== raw→ppm: LUT (%u entries, Q10.6) vs float ==\n", MQ135_LUT_SIZE);
+    printf("  max |Δ| = %.5f ppm @ raw=%d (tol %.3f)  uint16 ppm differs on %u/%u codes  %s\n",
+           (double)max_err, max_err_raw, (double)CONVERSION_TOL_PPM,
+           int_mismatch, MQ135_LUT_SIZE, ok ? "PASS" : "FAIL");
+    return ok;
+}
+
+/* ── 2. Detector agreement ──────────────────────────────────────────── */
+
+static bool check_detector(const trace_t *t, const event_detector_config_t *cfg, const char *engine)
+{
+    event_detector_t flt, fx;
+    float    max_err = 0.0f;
+    size_t   state_mismatch = 0;
+    size_t   last_mismatch  = 0;
+    bool     ever_mismatch  = false;
+    uint8_t  seq_flt[EVENT_SEQ_MAX], seq_fx[EVENT_SEQ_MAX];
+    unsigned n_flt = 0, n_fx = 0;
+    litter_event_t last_flt = LITTER_EVENT_NONE, last_fx = LITTER_EVENT_NONE;
+
+    event_detector_init_with_config(&flt, cfg);
+    event_detector_init_with_config(&fx, cfg);
+    for (size_t i = 0; i < t->count; i++) {
+        uint16_t q6 = (uint16_t)(t->samples[i].ppm * (1 << AIR_SENSOR_PPM_Q_SHIFT) + 0.5f);
+        litter_event_t ef = event_detector_update(&flt, q6 / (float)(1 << AIR_SENSOR_PPM_Q_SHIFT));
+        litter_event_t eq = event_detector_update_q(&fx, (int32_t)q6 << (EVENT_PPM_Q_SHIFT - AIR_SENSOR_PPM_Q_SHIFT));
+
+        if (flt.state != fx.state) {
+            state_mismatch++;
+            last_mismatch = i;
+            ever_mismatch = true;
+        } else if (!ever_mismatch || i - last_mismatch > RESYNC_TICKS) {
+            float err = fabsf(flt.baseline_ppm - fx.baseline_q / (float)(1 << EVENT_PPM_Q_SHIFT));
+            if (err > max_err) {
+                max_err = err;
+            }
+        }
+        if (ef != LITTER_EVENT_NONE && last_flt == LITTER_EVENT_NONE && n_flt < EVENT_SEQ_MAX) {
+            seq_flt[n_flt++] = (uint8_t)ef;
+        }
+        if (eq != LITTER_EVENT_NONE && last_fx == LITTER_EVENT_NONE && n_fx < EVENT_SEQ_MAX) {
+            seq_fx[n_fx++] = (uint8_t)eq;
+        }
+        last_flt = ef;
+        last_fx  = eq;
+    }
+
+    double frac = t->count ? (double)state_mismatch / t->count : 0.0;
+    bool same_seq = (n_flt == n_fx) && memcmp(seq_flt, seq_fx, n_flt) == 0;
+    bool ok = max_err <= BASELINE_TOL_PPM && frac <= STATE_MISMATCH_TOL && same_seq;
+    printf("== Detector Q15.16 vs float, %s onset: %s ==\n", engine, t->name);
+    printf("  max |Δbaseline| = %.5f ppm (tol %.3f)  state differs on %zu/%zu ticks (tol %.1f%%)\n",
+           (double)max_err, (double)BASELINE_TOL_PPM, state_mismatch, t->count, STATE_MISMATCH_TOL * 100);
+    printf("  events float=%u fixed=%u  sequence %s  %s\n",
+           n_flt, n_fx, same_seq ? "identical" : "DIFFERS", ok ? "PASS" : "FAIL");
+    return ok;
+}
+
+/* ── 3. Cost ────────────────────────────────────────────────────────── */
+
+typedef struct {
+    double ns;
+    double cycles;
+} cost_t;
+
+static cost_t cost_conversion(esp_err_t (*read)(air_sensor_data_t *), int repeat)
+{
+    air_sensor_data_t d;
+    uint64_t n  = (uint64_t)repeat * MQ135_LUT_SIZE;
+    uint64_t t0 = bench_now_ns(), c0 = bench_cycles();
+
+    for (int r = 0; r < repeat; r++) {
+        for (int raw = 0; raw < MQ135_LUT_SIZE; raw++) {
+            host_adc_set_raw(ADC_CHANNEL_0, raw);
+            read(&d);
+            s_sink += d.nh3_ppm_q;
+        }
+    }
+    return (cost_t){ (double)(bench_now_ns() - t0) / n, (double)(bench_cycles() - c0) / n };
+}
+
+static cost_t cost_detector(const trace_t *t, bool fixed, int repeat)
+{
+    event_detector_t det;
+    int32_t *q = malloc(t->count * sizeof(*q));
+    float   *f = malloc(t->count * sizeof(*f));
+    for (size_t i = 0; i < t->count; i++) {
+        q[i] = EVENT_PPM_TO_Q(t->samples[i].ppm);
+        f[i] = t->samples[i].ppm;
+    }
+
+    uint64_t n  = (uint64_t)repeat * t->count;
+    uint64_t t0 = bench_now_ns(), c0 = bench_cycles();
+    for (int r = 0; r < repeat; r++) {
+        event_detector_init(&det);
+        if (fixed) {
+            for (size_t i = 0; i < t->count; i++) {
+                s_sink += event_detector_update_q(&det, q[i]);
+            }
+        } else {
+            for (size_t i = 0; i < t->count; i++) {
+                s_sink += event_detector_update(&det, f[i]);
+            }
+        }
+    }
+    cost_t c = { (double)(bench_now_ns() - t0) / n, (double)(bench_cycles() - c0) / n };
+    free(q);
+    free(f);
+    return c;
+}
+
+int main(int argc, char **argv)
+{
+    int  repeat = argc > 1 ? atoi(argv[1]) : 20;
+    bool ok = check_conversion();
+    static const event_detector_config_t threshold = EVENT_DETECTOR_CONFIG_DEFAULT();
+    event_detector_config_t cusum = threshold;
+    cusum.engine = EVENT_ENGINE_CUSUM;
+
+    trace_t t;
+    trace_synth_cfg_t cfg = trace_synth_default();
+    cfg.hours = 24.0 * 7;
+    for (uint32_t seed = 1; seed <= 4; seed++) {
+        cfg.seed = seed;
+        if (!trace_synthesize(&t, &cfg)) {
+            return 1;
+        }
+        ok &= check_detector(&t, &threshold, "threshold");
+        ok &= check_detector(&t, &cusum, "CUSUM");
+        if (seed < 4) {
+            trace_free(&t);
+        }
+    }
+
+    cost_t conv_f = cost_conversion(air_sensor_read, repeat);
+    cost_t conv_q = cost_conversion(air_sensor_fx_read, repeat);
+    cost_t det_f  = cost_detector(&t, false, repeat);
+    cost_t det_q  = cost_detector(&t, true, repeat);
+    trace_free(&t);
+
+    printf("== Cost per call (host; ns / cycles) ==\n");
+    printf("  %-32s %8.2f ns %8.1f cyc\n", "air_sensor_read() float+powf", conv_f.ns, conv_f.cycles);
+    printf("  %-32s %8.2f ns %8.1f cyc\n", "air_sensor_read() LUT", conv_q.ns, conv_q.cycles);
+    printf("  %-32s %8.2f ns %8.1f cyc\n", "event_detector_update()", det_f.ns, det_f.cycles);
+    printf("  %-32s %8.2f ns %8.1f cyc\n", "event_detector_update_q()", det_q.ns, det_q.cycles);
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,425 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * history_bench.c — Weeks of samples through the flash history log
+ *
+ * Synthesizes --days of 2 s samples (raw ADC via the inverse of the driver
+ * model, ppm and detector state as main.c's fixed-point path produces them,
+ * a warmup after every boot and the odd failed read) and writes them with
+ * history_log's encoder and sector store to a simulated NOR flash of --kb:
+ * erase sets 0xFF, programming can only clear bits. Every few days the
+ * device restarts; half of those are power cuts in the middle of a flash
+ * write or erase, leaving a torn block, header or sector behind.
+ *
+ * The image is then read back as history_dump.ps1 would fetch it:
+ *  - history_read() must return exactly the newest committed blocks,
+ *    sample for sample (tick, raw, state, event, boot, stored ppm/baseline)
+ *  - history_load_trace() on the saved image must yield the replay trace
+ *    with every block's stored ppm matching the driver's conversion
+ * Prints bits/sample, days retained, per-sector erase counts and ns/sample
+ * for encoding and decoding. Exits non-zero unless the round trip is exact,
+ * at least MIN_DAYS fit the partition and erases stay within one of each
+ * other across sectors.
+ *
+ * Usage: history_bench [--days D] [--kb N] [--seed N] [--reboot-days D] [--save FILE]
+ */
+#include "air_sensor_driver.h"
+#include "bench_clock.h"
+#include "esp_log.h"
+#include "event_detector.h"
+#include "history_log.h"
+#include "history_reader.h"
+#include "replay.h"
+#include "trace.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MIN_DAYS            30.0
+#define WARMUP_TICKS        90          /* ~3 min heater settling after each boot */
+#define INVALID_PER_TICK    (1.0 / 20000)
+#define DOWNTIME_TICKS      30          /* Power cut → next boot */
+#define ERASE_COST          64          /* Power-cut budget units an erase takes */
+#define CUT_BUDGET_MAX      1200
+
+static uint64_t g_rng;
+
+/* ── Simulated NOR flash ────────────────────────────────────────────── */
+
+typedef struct {
+    uint8_t  *mem;
+    uint32_t  size;
+    uint32_t *erases;           /* Per sector */
+    long      budget;           /* Bytes (erase = ERASE_COST) until the power cut, −1 = none armed */
+    bool      dead;
+    uint64_t  programmed;
+} nor_t;
+
+static esp_err_t nor_read(void *ctx, uint32_t off, void *dst, size_t len)
+{
+    nor_t *f = ctx;
+    if ((uint64_t)off + len > f->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(dst, f->mem + off, len);
+    return ESP_OK;
+}
+
+static esp_err_t nor_write(void *ctx, uint32_t off, const void *src, size_t len)
+{
+    nor_t *f = ctx;
+    const uint8_t *s = src;
+    if (f->dead || (uint64_t)off + len > f->size) {
+        return ESP_FAIL;
+    }
+    size_t n = len;
+    if (f->budget >= 0 && (long)len > f->budget) {
+        n = (size_t)f->budget;
+        f->dead = true;
+    }
+    for (size_t i = 0; i < n; i++) {
+        f->mem[off + i] &= s[i];        /* NOR: programming only clears bits */
+    }
+    if (f->dead) {
+        f->mem[off + n] &= (uint8_t)(0xF0 | s[n]);     /* Byte in flight: half programmed */
+    }
+    f->programmed += n;
+    if (f->budget >= 0) {
+        f->budget -= (long)n;
+    }
+    return f->dead ? ESP_FAIL : ESP_OK;
+}
+
+static esp_err_t nor_erase(void *ctx, uint32_t off, size_t len)
+{
+    nor_t *f = ctx;
+    if (f->dead || off % HISTORY_SECTOR_BYTES || len % HISTORY_SECTOR_BYTES || (uint64_t)off + len > f->size) {
+        return ESP_FAIL;
+    }
+    if (f->budget >= 0 && f->budget < ERASE_COST) {
+        /* Cut mid-erase: the sector is left neither old nor blank */
+        for (size_t i = 0; i < len; i++) {
+            f->mem[off + i] &= (uint8_t)(trace_rng_uniform(&g_rng) * 256.0);
+        }
+        f->dead = true;
+        return ESP_FAIL;
+    }
+    memset(f->mem + off, 0xFF, len);
+    for (size_t s = off / HISTORY_SECTOR_BYTES; s < (off + len) / HISTORY_SECTOR_BYTES; s++) {
+        f->erases[s]++;
+    }
+    if (f->budget >= 0) {
+        f->budget -= ERASE_COST;
+    }
+    return ESP_OK;
+}
+
+/* ── Device ─────────────────────────────────────────────────────────── */
+
+typedef struct {
+    trace_record_t rec;
+    uint8_t        boot;
+} fed_t;
+
+typedef struct {
+    size_t  first;              /* Index into fed[] */
+    uint16_t count;
+} committed_t;
+
+typedef struct {
+    fed_t       *fed;
+    size_t       n_fed;
+    committed_t *blocks;
+    size_t       n_blocks;
+    size_t       block_start;   /* fed[] index of the open block's first sample */
+    uint8_t      tol;           /* Raw tolerance (0 = lossless) */
+    uint32_t     boots, cuts, lost_ticks;
+    uint64_t     enc_ns;
+    uint32_t     max_err;       /* Largest |decoded − raw| seen on read-back */
+} run_t;
+
+typedef struct {
+    run_t       *run;
+    size_t       next;          /* Expected committed block */
+    size_t       mismatches;
+    size_t       decoded;
+    size_t       held;
+} verify_t;
+
+static void verify_block(void *arg, const history_block_info_t *info, const history_sample_t *samples)
+{
+    verify_t *v = arg;
+    run_t *r = v->run;
+    if (v->next >= r->n_blocks) {
+        v->mismatches++;
+        return;
+    }
+    const committed_t *c = &r->blocks[v->next++];
+    const fed_t *f = &r->fed[c->first];
+    if (info->count != c->count || info->boot != f->boot || info->tick0 != f->rec.tick
+        || info->ppm_q0 != f->rec.ppm_q || info->baseline_q0 != f->rec.baseline_q) {
+        v->mismatches++;
+        return;
+    }
+    for (uint16_t i = 0; i < info->count; i++) {
+        const trace_record_t *e = &f[i].rec;
+        uint16_t raw = (e->state & TRACE_FLAG_INVALID) ? 0 : e->raw;
+        uint32_t err = (uint32_t)abs((int)samples[i].raw - (int)raw);
+        if (samples[i].tick != e->tick || err > r->tol || samples[i].state != e->state
+            || samples[i].event != e->event || info->tolerance != r->tol) {
+            v->mismatches++;
+            return;
+        }
+        r->max_err = err > r->max_err ? err : r->max_err;
+        v->held += (e->state & (TRACE_FLAG_WARMUP | TRACE_FLAG_INVALID)) ? 1 : 0;
+    }
+    v->decoded += info->count;
+}
+
+static void count_block(void *arg, const history_block_info_t *info, const history_sample_t *samples)
+{
+}
+
+static bool grow(void **p, size_t *cap, size_t need, size_t elem)
+{
+    if (need <= *cap) {
+        return true;
+    }
+    size_t n = *cap ? *cap * 2 : 4096;
+    void *q = realloc(*p, n * elem);
+    if (!q) {
+        return false;
+    }
+    *p = q;
+    *cap = n;
+    return true;
+}
+
+/* Write the trace through the log with restarts and power cuts */
+static bool run_device(const trace_t *t, nor_t *nor, const history_flash_t *flash, double reboot_days, run_t *r)
+{
+    size_t cap_fed = 0, cap_blocks = 0;
+    history_store_t store;
+    history_enc_t   enc;
+    history_block_t blk;
+    event_detector_t det;
+    uint32_t tick = 0, warmup = 0, down = 0;
+    double   mean_gap = reboot_days * 86400000.0 / TRACE_TICK_MS;
+    size_t   next_restart = (size_t)(-log(1.0 - trace_rng_uniform(&g_rng)) * mean_gap);
+    bool     up = false;
+
+    for (size_t i = 0; i < t->count; i++) {
+        if (!up) {
+            if (down && --down) {
+                r->lost_ticks++;
+                continue;
+            }
+            nor->dead = false;
+            nor->budget = -1;
+            if (history_store_open(&store, flash, TRACE_TICK_MS / 100) != ESP_OK) {
+                return false;
+            }
+            history_enc_init(&enc, store.boot, r->tol);
+            event_detector_init(&det);
+            tick = 0;
+            warmup = WARMUP_TICKS;
+            r->block_start = r->n_fed;
+            r->boots++;
+            up = true;
+        }
+
+        /* Sample as main.c's fixed-point path does */
+        const trace_sample_t *s = &t->samples[i];
+        bool invalid = trace_rng_uniform(&g_rng) < INVALID_PER_TICK;
+        double q6 = (double)s->ppm * (1 << AIR_SENSOR_PPM_Q_SHIFT) + 0.5;
+        int32_t ppm_q = invalid ? 0 : (int32_t)(q6 > 65535.0 ? 65535.0 : q6) << (EVENT_PPM_Q_SHIFT - AIR_SENSOR_PPM_Q_SHIFT);
+        litter_event_t ev = det.current_event;
+        if (!invalid && !warmup) {
+            ev = event_detector_update_q(&det, ppm_q);
+        }
+        trace_record_t rec = {
+            .tick       = tick++,
+            .raw        = invalid ? 0 : s->raw_adc,
+            .ppm_q      = ppm_q,
+            .baseline_q = event_detector_get_baseline_q(&det),
+            .state      = (uint8_t)det.state | (warmup ? TRACE_FLAG_WARMUP : 0) | (invalid ? TRACE_FLAG_INVALID : 0),
+            .event      = (uint8_t)ev,
+        };
+        if (warmup) {
+            warmup--;
+        }
+
+        uint64_t t0 = bench_now_ns();
+        bool closed = history_enc_add(&enc, &rec, &blk);
+        r->enc_ns += bench_now_ns() - t0;
+        if (closed) {
+            if (history_store_append(&store, &blk) == ESP_OK) {
+                if (!grow((void **)&r->blocks, &cap_blocks, r->n_blocks + 1, sizeof(*r->blocks))) {
+                    return false;
+                }
+                r->blocks[r->n_blocks++] = (committed_t) {
+                    .first = r->block_start,
+                    .count = (uint16_t)(r->n_fed - r->block_start),
+                };
+            }
+            r->block_start = r->n_fed;
+        }
+        if (!grow((void **)&r->fed, &cap_fed, r->n_fed + 1, sizeof(*r->fed))) {
+            return false;
+        }
+        r->fed[r->n_fed++] = (fed_t) { .rec = rec, .boot = enc.boot };
+
+        if (nor->dead) {
+            /* Power cut during that write: the open block and this sample's successors are gone */
+            up = false;
+            down = DOWNTIME_TICKS;
+            r->cuts++;
+            continue;
+        }
+        if (i == next_restart) {
+            next_restart += 1 + (size_t)(-log(1.0 - trace_rng_uniform(&g_rng)) * mean_gap);
+            if (trace_rng_uniform(&g_rng) < 0.5) {
+                up = false;     /* Reset: RAM (the open block) lost, flash intact */
+            } else {
+                nor->budget = (long)(trace_rng_uniform(&g_rng) * CUT_BUDGET_MAX);     /* Cut in a later write */
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    double   days = 35.0, reboot_days = 3.0;
+    unsigned tol = CONFIG_LITTERBOX_HISTORY_TOLERANCE;
+    unsigned kb = 768;     /* partitions.csv */
+    const char *save_path = NULL;
+    trace_synth_cfg_t synth = trace_synth_default();
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--days") == 0 && i + 1 < argc) {
+            days = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--kb") == 0 && i + 1 < argc) {
+            kb = (unsigned)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            synth.seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--tol") == 0 && i + 1 < argc) {
+            tol = (unsigned)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--reboot-days") == 0 && i + 1 < argc) {
+            reboot_days = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--save") == 0 && i + 1 < argc) {
+            save_path = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--days D] [--kb N] [--seed N] [--tol N] [--reboot-days D]\n"
+                    "          [--save FILE]\n", argv[0]);
+            return 2;
+        }
+    }
+    host_log_set_level(ESP_LOG_NONE);      /* Power cuts make the store log its failed writes */
+    g_rng = synth.seed * 0x9E3779B97F4A7C15ULL + 1;
+
+    trace_t t;
+    synth.hours = days * 24.0;
+    if (!trace_synthesize(&t, &synth)) {
+        fprintf(stderr, "Failed to generate synthetic trace\n");
+        return 1;
+    }
+    for (size_t i = 0; i < t.count; i++) {
+        t.samples[i].raw_adc = trace_ppm_to_raw(t.samples[i].ppm);
+    }
+    t.has_raw = true;
+    if (!replay_convert_raw(&t)) {      /* ppm as the driver sees those codes */
+        return 1;
+    }
+
+    uint32_t sectors = kb * 1024u / HISTORY_SECTOR_BYTES;
+    nor_t nor = {
+        .mem    = malloc((size_t)sectors * HISTORY_SECTOR_BYTES),
+        .size   = sectors * HISTORY_SECTOR_BYTES,
+        .erases = calloc(sectors, sizeof(uint32_t)),
+        .budget = -1,
+    };
+    if (!nor.mem || !nor.erases) {
+        return 1;
+    }
+    memset(nor.mem, 0xFF, nor.size);
+    history_flash_t flash = { .ctx = &nor, .size = nor.size, .read = nor_read, .write = nor_write, .erase = nor_erase };
+
+    run_t run = { .tol = (uint8_t)tol };
+    bool ok = run_device(&t, &nor, &flash, reboot_days, &run);
+    if (!ok) {
+        fprintf(stderr, "Simulation failed\n");
+        return 1;
+    }
+
+    /* Read back everything still in flash: the newest committed blocks, oldest first */
+    history_read_stats_t st;
+    uint64_t t0 = bench_now_ns();
+    esp_err_t err = history_read(&flash, count_block, NULL, &st);
+    uint64_t dec_ns = bench_now_ns() - t0;
+    size_t first_kept = st.blocks <= run.n_blocks ? run.n_blocks - st.blocks : 0;
+    verify_t v = { .run = &run, .next = first_kept };
+    history_read(&flash, verify_block, &v, &st);
+    ok = err == ESP_OK && st.bad_blocks == 0 && v.mismatches == 0 && v.next == run.n_blocks;
+    double kept_days = (double)st.samples * TRACE_TICK_MS / 86400000.0;
+
+    uint32_t e_min = UINT32_MAX, e_max = 0;
+    for (uint32_t s = 0; s < sectors; s++) {
+        e_min = nor.erases[s] < e_min ? nor.erases[s] : e_min;
+        e_max = nor.erases[s] > e_max ? nor.erases[s] : e_max;
+    }
+
+    printf("history log: %.1f days of %d ms samples into %u KB (%u sectors)\n", days, TRACE_TICK_MS, kb, sectors);
+    printf("device: %u boots (%u power cuts mid-write, %u ticks powered off), %zu blocks committed\n",
+           run.boots, run.cuts, run.lost_ticks, run.n_blocks);
+    printf("read back: %u blocks, %llu samples = %.1f days, %u boot change(s), %u torn sector(s), %u bad block(s)\n",
+           st.blocks, (unsigned long long)st.samples, kept_days, st.boots, st.torn_sectors, st.bad_blocks);
+    printf("size: %.2f bits/sample incl. headers (%.1f B/block), %.1f days would fit %u KB\n",
+           st.bytes_used * 8.0 / (double)st.samples, (double)st.bytes_used / st.blocks,
+           (double)nor.size / st.bytes_used * kept_days, kb);
+    printf("wear: %u..%u erases per sector, %llu bytes programmed\n",
+           e_min, e_max, (unsigned long long)nor.programmed);
+    printf("time: encode %.1f ns/sample, decode %.1f ns/sample\n",
+           (double)run.enc_ns / run.n_fed, (double)dec_ns / (double)st.samples);
+    printf("round trip: blocks %zu..%zu of %zu, %s (max raw error %u, tolerance %u)\n", first_kept, run.n_blocks,
+           run.n_blocks, v.mismatches ? "MISMATCH" : tol ? "within tolerance" : "exact", run.max_err, tol);
+
+    /* Through a dump file, as history_decode / detector_bench --history read it */
+    char path[] = "/tmp/history_bench_XXXXXX";
+    int fd = save_path ? -1 : mkstemp(path);
+    const char *img_path = save_path ? save_path : path;
+    FILE *f = save_path ? fopen(save_path, "wb") : fdopen(fd, "wb");
+    if (!f || fwrite(nor.mem, 1, nor.size, f) != nor.size) {
+        perror(img_path);
+        return 1;
+    }
+    fclose(f);
+    trace_t loaded;
+    history_load_stats_t ls;
+    bool loaded_ok = history_load_trace(&loaded, img_path, &ls);
+    if (!save_path) {
+        unlink(path);
+    }
+    bool load_ok = loaded_ok && loaded.count == v.decoded - v.held && ls.held == v.held
+                   && ls.ppm_mismatch == 0 && ls.ppm_checked > 0;
+    history_print_stats(stdout, "dump", &ls);
+    printf("replay trace: %zu samples, ppm check %zu/%zu blocks%s\n", loaded.count,
+           ls.ppm_checked - ls.ppm_mismatch, ls.ppm_checked, load_ok ? "" : "  FAIL");
+
+    bool days_ok = kept_days >= MIN_DAYS;
+    bool wear_ok = e_max - e_min <= 1;
+    ok = ok && load_ok && days_ok && wear_ok;
+    printf("%s\n", ok ? "PASS" : "FAIL");
+
+    trace_free(&loaded);
+    trace_free(&t);
+    free(run.fed);
+    free(run.blocks);
+    free(nor.mem);
+    free(nor.erases);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,528 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * journal_bench.c — Event delivery across a coordinator outage and a reboot
+ *
+ * Replays a trace (default: 72 h synthetic) through the detector and sends
+ * classified events to a hub model over a link that loses --loss of frames
+ * in each direction and is down completely for --outage hours starting at
+ * --outage-at. The device reboots --reboot hours into the outage (RAM lost,
+ * NVS kept; the in-memory stub survives). Two ways:
+ *  - once:    the event reported once when it is classified, as the event
+ *             attribute was before the journal
+ *  - journal: main.c with CONFIG_LITTERBOX_EVENT_JOURNAL — event_journal
+ *             records through report_mgr, acknowledged by Default Response,
+ *             rebuilt after a drop, resumed on rejoin
+ * The hub de-duplicates journal entries by sequence number and checks their
+ * fields against what was journaled.
+ *
+ * Then an outage long enough to overflow the journal checks the bound: the
+ * oldest entries are overwritten, the newest EVENT_JOURNAL_LEN arrive in
+ * order, and RAM and the NVS blob stay at their fixed size. Last, a journal
+ * saved by the version 1 layout must come back with its entries, boot
+ * number and sequence numbers, and be delivered.
+ *
+ * Prints events delivered, duplicates at the hub, drain time after rejoin,
+ * frames and NVS writes. Exits non-zero unless the journal delivers every
+ * event exactly once with the right fields, drains within DRAIN_MAX_S, and
+ * the overflow and migration cases behave as above.
+ *
+ * Usage: journal_bench [--trace FILE] [--hours H] [--seed N] [--loss F]
+ *                      [--outage-at H] [--outage H] [--reboot H]
+ */
+#include "esp_log.h"
+#include "event_detector.h"
+#include "event_journal.h"
+#include "nvs.h"
+#include "replay.h"
+#include "report_mgr.h"
+#include "trace.h"
+#include "zcl_reporting.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_EVENTS          1024
+#define RETRY_MS            600000      /* EVENT_JOURNAL_RETRY_MS in main.h */
+#define ACK_DELAY_MIN_MS    50
+#define ACK_DELAY_MAX_MS    1500
+#define DRAIN_MAX_S         120         /* Rejoin → journal empty, for the journal sizes here */
+#define MAX_ACKS            8
+
+static uint64_t g_rng;
+
+/* ── Link ───────────────────────────────────────────────────────────── */
+
+typedef struct {
+    double   loss;
+    uint32_t down_from_ms, down_to_ms;
+} link_t;
+
+static bool link_up(const link_t *l, uint32_t now_ms)
+{
+    return now_ms < l->down_from_ms || now_ms >= l->down_to_ms;
+}
+
+static bool link_pass(const link_t *l, uint32_t now_ms)
+{
+    return link_up(l, now_ms) && trace_rng_uniform(&g_rng) >= l->loss;
+}
+
+/* ── Hub ────────────────────────────────────────────────────────────── */
+
+typedef struct {
+    event_journal_entry_t got[MAX_EVENTS];  /* Distinct entries, in arrival order */
+    size_t   n_got;
+    uint32_t duplicates;
+    uint32_t bad_records;
+} hub_t;
+
+static void hub_record(hub_t *h, const uint8_t *p, size_t len)
+{
+    event_journal_hdr_t hdr;
+    event_journal_entry_t e[EVENT_JOURNAL_BURST];
+    int n = event_journal_decode(p, len, &hdr, e, EVENT_JOURNAL_BURST);
+    if (n <= 0) {
+        h->bad_records++;
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        bool seen = false;
+        for (size_t k = 0; k < h->n_got && !seen; k++) {
+            seen = h->got[k].seq == e[i].seq && h->got[k].boot == e[i].boot && h->got[k].start_s == e[i].start_s;
+        }
+        if (seen) {
+            h->duplicates++;
+        } else if (h->n_got < MAX_EVENTS) {
+            h->got[h->n_got++] = e[i];
+        }
+    }
+}
+
+/* Report Attributes payload: pick out the journal record (attr 0x0005) */
+static void hub_frame(hub_t *h, const uint8_t *p, size_t len)
+{
+    size_t pos = 0;
+    while (pos + 4 <= len) {
+        uint16_t id = (uint16_t)(p[pos] | (p[pos + 1] << 8));
+        uint8_t  vlen = p[pos + 3];
+        if (id == 0x0005 && pos + 4 + vlen <= len) {
+            hub_record(h, &p[pos + 4], vlen);
+        }
+        pos += 4u + vlen;
+    }
+}
+
+/* ── Device: journal path, as main.c ────────────────────────────────── */
+
+typedef struct {
+    bool     pending;
+    uint8_t  tsn;
+    uint32_t at_ms;
+} ack_t;
+
+typedef struct {
+    event_journal_t journal;
+    report_mgr_t    mgr;
+    uint8_t         attr[1 + EVENT_JOURNAL_MAX_BYTES];
+    uint32_t        retry_at_ms;
+    uint8_t         prev_event;
+    uint8_t         tsn;
+    ack_t           acks[MAX_ACKS];
+    uint64_t        frames;
+} device_t;
+
+static const report_mgr_attr_cfg_t k_attrs[] = {
+    { 0x0005, ZCL_TYPE_OCTET_STR, false },
+};
+
+static uint16_t dppm(float ppm)
+{
+    long v = lround(ppm * 10.0);
+    return (uint16_t)(v < 0 ? 0 : v >= 0xFFFF ? 0xFFFE : v);
+}
+
+static void device_boot(device_t *d)
+{
+    event_journal_open(&d->journal, EVENT_JOURNAL_KEY);
+    report_mgr_init(&d->mgr, k_attrs, 1);
+    memset(d->acks, 0, sizeof(d->acks));
+    d->retry_at_ms = 0;
+    d->prev_event  = LITTER_EVENT_NONE;
+}
+
+/* event_journal_record(); returns true if an event was journaled */
+static bool device_record(device_t *d, uint32_t now_ms, const event_detector_t *det, event_journal_entry_t *out)
+{
+    uint8_t prev = d->prev_event;
+    d->prev_event = (uint8_t)det->current_event;
+    if (det->current_event == LITTER_EVENT_NONE || det->current_event == prev) {
+        return false;
+    }
+    uint32_t active_ms = (uint32_t)det->event_ticks * TRACE_TICK_MS;
+    *out = (event_journal_entry_t) {
+        .type            = (uint8_t)det->current_event,
+        .start_s         = (now_ms - active_ms) / 1000,
+        .duration_s      = (uint16_t)(active_ms / 1000),
+        .peak_dppm       = dppm(det->peak_ppm),
+        .baseline_dppm   = dppm(det->baseline_ppm),
+        .area_ppm_s      = (uint16_t)(det->features.auc_dppm_ticks * TRACE_TICK_MS / 10000),
+        .max_rise_cppm_s = (uint16_t)(det->features.max_rise_cppm * 1000u / TRACE_TICK_MS),
+        .time_to_peak_s  = (uint16_t)(det->features.time_to_peak_ticks * TRACE_TICK_MS / 1000),
+        .decay_tau_s     = (uint16_t)(det->features.decay_tau_ticks * TRACE_TICK_MS / 1000),
+    };
+    event_journal_append(&d->journal, out);
+    out->seq  = (uint16_t)(d->journal.next_seq - 1);
+    out->boot = d->journal.boot;
+    return true;
+}
+
+/* event_journal_service() */
+static void device_service(device_t *d, uint32_t now_ms)
+{
+    switch (report_mgr_status(&d->mgr, 0)) {
+    case REPORT_MGR_PENDING:
+        return;
+    case REPORT_MGR_ACKED:
+        event_journal_commit(&d->journal);
+        break;
+    case REPORT_MGR_DROPPED:
+        if (d->journal.sending && (int32_t)(now_ms - d->retry_at_ms) < 0) {
+            return;
+        }
+        break;
+    case REPORT_MGR_IDLE:
+        break;
+    }
+    size_t len = event_journal_encode(&d->journal, now_ms / 1000, &d->attr[1]);
+    if (len == 0) {
+        return;
+    }
+    d->attr[0] = (uint8_t)len;
+    report_mgr_set(&d->mgr, 0, d->attr, 1u + len);
+    d->retry_at_ms = now_ms + RETRY_MS;
+}
+
+/* Deliver due acks, then report_flush() over the link */
+static void device_flush(device_t *d, hub_t *h, const link_t *l, uint32_t now_ms)
+{
+    for (int a = 0; a < MAX_ACKS; a++) {
+        if (d->acks[a].pending && d->acks[a].at_ms <= now_ms) {
+            report_mgr_ack(&d->mgr, d->acks[a].at_ms, d->acks[a].tsn, 0);
+            d->acks[a].pending = false;
+        }
+    }
+    report_mgr_poll(&d->mgr, now_ms);
+    uint8_t payload[REPORT_MGR_FRAME_MAX];
+    size_t len = report_mgr_flush(&d->mgr, now_ms, d->tsn, payload, sizeof(payload));
+    if (len == 0) {
+        return;
+    }
+    d->frames++;
+    if (link_pass(l, now_ms)) {
+        hub_frame(h, payload, len);
+        if (link_pass(l, now_ms)) {
+            for (int a = 0; a < MAX_ACKS; a++) {
+                if (!d->acks[a].pending) {
+                    double delay = ACK_DELAY_MIN_MS + trace_rng_uniform(&g_rng) * (ACK_DELAY_MAX_MS - ACK_DELAY_MIN_MS);
+                    d->acks[a] = (ack_t){ true, d->tsn, now_ms + (uint32_t)delay };
+                    break;
+                }
+            }
+        }
+    }
+    d->tsn++;
+}
+
+static bool entry_eq(const event_journal_entry_t *a, const event_journal_entry_t *b)
+{
+    return a->seq == b->seq && a->type == b->type && a->boot == b->boot && a->start_s == b->start_s
+        && a->duration_s == b->duration_s && a->peak_dppm == b->peak_dppm && a->baseline_dppm == b->baseline_dppm
+        && a->area_ppm_s == b->area_ppm_s && a->max_rise_cppm_s == b->max_rise_cppm_s
+        && a->time_to_peak_s == b->time_to_peak_s && a->decay_tau_s == b->decay_tau_s;
+}
+
+/* Every journaled event arrived exactly once, unchanged */
+static bool all_delivered(const event_journal_entry_t *sent, size_t n_sent, const hub_t *h)
+{
+    if (h->n_got != n_sent || h->bad_records) {
+        return false;
+    }
+    for (size_t i = 0; i < n_sent; i++) {
+        bool found = false;
+        for (size_t k = 0; k < h->n_got && !found; k++) {
+            found = entry_eq(&sent[i], &h->got[k]);
+        }
+        if (!found) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* ── Trace run ──────────────────────────────────────────────────────── */
+
+static bool trace_run(const trace_t *t, const link_t *l, uint32_t reboot_ms)
+{
+    static device_t d;
+    static hub_t hub;
+    static event_journal_entry_t sent[MAX_EVENTS];
+    size_t n_sent = 0;
+    size_t once_sent = 0, once_got = 0;
+    size_t in_outage = 0;
+
+    host_nvs_erase_all();
+    memset(&hub, 0, sizeof(hub));
+    memset(&d, 0, sizeof(d));
+    device_boot(&d);
+    event_detector_t det;
+    event_detector_init(&det);
+
+    bool was_up = true;
+    long rejoin_tick = -1, drained_tick = -1;
+    uint32_t nvs_before = host_nvs_write_count();
+    size_t max_count = 0;
+
+    for (size_t i = 0; i < t->count; i++) {
+        uint32_t now_ms = (uint32_t)(i * TRACE_TICK_MS);
+        if (reboot_ms && now_ms == reboot_ms) {
+            device_boot(&d);
+        }
+        bool up = link_up(l, now_ms);
+        if (up && !was_up) {
+            /* reports_resume() on the rejoin signal */
+            report_mgr_resume(&d.mgr, now_ms);
+            d.retry_at_ms = now_ms;
+            rejoin_tick = (long)i;
+        }
+        was_up = up;
+
+        event_detector_update(&det, t->samples[i].ppm);
+        event_journal_entry_t e;
+        if (device_record(&d, now_ms, &det, &e) && n_sent < MAX_EVENTS) {
+            sent[n_sent++] = e;
+            in_outage += !up;
+            /* Before the journal: reported once, lost if that frame is */
+            once_sent++;
+            once_got += link_pass(l, now_ms);
+        }
+        device_service(&d, now_ms);
+        device_flush(&d, &hub, l, now_ms);
+
+        max_count = d.journal.count > max_count ? d.journal.count : max_count;
+        if (rejoin_tick >= 0 && drained_tick < 0 && d.journal.count == 0) {
+            drained_tick = (long)i;
+        }
+    }
+    /* Let the last record settle */
+    for (uint32_t k = 1; k < 3600 && d.journal.count; k++) {
+        uint32_t now_ms = (uint32_t)((t->count + k) * TRACE_TICK_MS);
+        device_service(&d, now_ms);
+        device_flush(&d, &hub, l, now_ms);
+    }
+
+    bool ok_once = once_got == once_sent;
+    bool ok = all_delivered(sent, n_sent, &hub);
+    double drain_s = drained_tick >= rejoin_tick && rejoin_tick >= 0
+                   ? (drained_tick - rejoin_tick) * TRACE_TICK_MS / 1000.0 : 0.0;
+    double days = (double)t->count * TRACE_TICK_MS / 86400000.0;
+
+    printf("%zu events, %zu during the outage, reboot %s\n", n_sent, in_outage,
+           reboot_ms ? "during the outage" : "none");
+    printf("  %-8s %zu/%zu delivered%s\n", "once", once_got, once_sent, ok_once ? "" : " (lost while down or to loss)");
+    printf("  %-8s %zu/%zu delivered %s, %u duplicate(s) dropped by the hub, drain %.0f s after rejoin\n",
+           "journal", hub.n_got, n_sent, ok ? "exactly once, fields ok" : "MISMATCH", hub.duplicates, drain_s);
+    printf("  %-8s %.0f frames/d, %.1f NVS writes/d, up to %zu entries held\n", "",
+           d.frames / days, (host_nvs_write_count() - nvs_before) / days, max_count);
+    return ok && drain_s <= DRAIN_MAX_S && d.journal.count == 0;
+}
+
+/* ── Overflow ───────────────────────────────────────────────────────── */
+
+static bool overflow_run(void)
+{
+    static device_t d;
+    static hub_t hub;
+    const int extra = 10;
+    link_t l = { 0.0, 0, 0 };
+
+    host_nvs_erase_all();
+    memset(&hub, 0, sizeof(hub));
+    memset(&d, 0, sizeof(d));
+    device_boot(&d);
+
+    /* First record goes out and is lost; the journal then fills while down */
+    event_journal_entry_t e = { .type = LITTER_EVENT_URINATION, .start_s = 10, .duration_s = 20,
+                                .peak_dppm = 150, .baseline_dppm = 50 };
+    event_journal_append(&d.journal, &e);
+    device_service(&d, 0);
+    bool ok = d.journal.sending == 1;
+    e = (event_journal_entry_t) { .type = LITTER_EVENT_DEFECATION, .duration_s = 30, .peak_dppm = 250,
+                                  .baseline_dppm = 50 };
+    for (int i = 1; i < EVENT_JOURNAL_LEN + extra; i++) {
+        e.start_s = 100u + (uint32_t)i;
+        ok &= event_journal_append(&d.journal, &e) == (i < EVENT_JOURNAL_LEN);
+    }
+    ok &= d.journal.count == EVENT_JOURNAL_LEN && d.journal.overwritten == (uint32_t)extra;
+    /* Ack of the overwritten entry must not drop a newer one */
+    event_journal_commit(&d.journal);
+    ok &= d.journal.count == EVENT_JOURNAL_LEN;
+
+    /* Reboot, then drain on a clean link */
+    device_boot(&d);
+    ok &= d.journal.count == EVENT_JOURNAL_LEN;
+    uint32_t now_ms = 0;
+    for (int k = 0; k < 1000 && d.journal.count; k++, now_ms += TRACE_TICK_MS) {
+        device_service(&d, now_ms);
+        device_flush(&d, &hub, &l, now_ms);
+    }
+    ok &= hub.n_got == EVENT_JOURNAL_LEN && hub.duplicates == 0;
+    for (size_t k = 0; k < hub.n_got; k++) {
+        ok &= hub.got[k].seq == (uint16_t)(extra + k);
+    }
+    double drain_s = now_ms / 1000.0;
+    ok &= drain_s <= DRAIN_MAX_S;
+
+    printf("overflow: %d events while down, %u overwritten, newest %zu delivered in order in %.0f s%s\n",
+           EVENT_JOURNAL_LEN + extra, (unsigned)extra, hub.n_got, drain_s, ok ? "" : "  FAIL");
+    printf("bounds: RAM %zu B (event_journal_t), NVS blob ≤ %zu B, record ≤ %d B\n",
+           sizeof(event_journal_t), (size_t)EVENT_JOURNAL_NVS_MAX, EVENT_JOURNAL_MAX_BYTES);
+    return ok;
+}
+
+/* ── Migration ──────────────────────────────────────────────────────── */
+
+/* A journal saved by the version 1 firmware: 8-byte header, then 16-byte
+ * entries (seq, type, boot, start, duration, peak, baseline, padding) */
+static bool migration_run(void)
+{
+    static device_t d;
+    static hub_t hub;
+    link_t l = { 0.0, 0, 0 };
+    const uint16_t next_seq = 40;
+    const int n = 3;
+
+    host_nvs_erase_all();
+    memset(&hub, 0, sizeof(hub));
+    memset(&d, 0, sizeof(d));
+
+    uint8_t v1[8 + 3 * 16] = { 1, 5, (uint8_t)next_seq, 0, (uint8_t)n, 0, 0, 0 };
+    for (int i = 0; i < n; i++) {
+        uint8_t *p = &v1[8 + i * 16];
+        uint16_t seq = (uint16_t)(next_seq - n + i);
+        p[0] = (uint8_t)seq;  p[1] = (uint8_t)(seq >> 8);
+        p[2] = LITTER_EVENT_URINATION;
+        p[3] = 5;
+        p[4] = (uint8_t)(100 + i);                  /* start_s */
+        p[8] = 20;                                  /* duration_s */
+        p[10] = 150;                                /* peak_dppm */
+        p[12] = 50;                                 /* baseline_dppm */
+        memset(&p[14], 0xA5, 2);                    /* Padding: never read */
+    }
+    nvs_handle_t h;
+    nvs_open(EVENT_JOURNAL_NAMESPACE, NVS_READWRITE, &h);
+    nvs_set_blob(h, EVENT_JOURNAL_KEY, v1, sizeof(v1));
+    nvs_commit(h);
+    nvs_close(h);
+
+    device_boot(&d);
+    bool ok = d.journal.count == (uint16_t)n && d.journal.next_seq == next_seq && d.journal.boot == 6;
+
+    /* A new event continues the sequence, and the journal is saved as v2 */
+    event_journal_entry_t e = { .type = LITTER_EVENT_DEFECATION, .start_s = 200, .duration_s = 30,
+                                .peak_dppm = 250, .baseline_dppm = 50, .area_ppm_s = 900 };
+    event_journal_append(&d.journal, &e);
+    device_boot(&d);
+    ok &= d.journal.count == (uint16_t)(n + 1) && d.journal.next_seq == next_seq + 1;
+
+    uint32_t now_ms = 0;
+    for (int k = 0; k < 1000 && d.journal.count; k++, now_ms += TRACE_TICK_MS) {
+        device_service(&d, now_ms);
+        device_flush(&d, &hub, &l, now_ms);
+    }
+    ok &= hub.n_got == (size_t)(n + 1) && hub.duplicates == 0;
+    for (size_t k = 0; ok && k < hub.n_got; k++) {
+        const event_journal_entry_t *g = &hub.got[k];
+        ok &= g->seq == (uint16_t)(next_seq - n + k);
+        if (k < (size_t)n) {
+            ok &= g->boot == 5 && g->start_s == 100 + k && g->duration_s == 20 && g->peak_dppm == 150
+               && g->baseline_dppm == 50 && g->area_ppm_s == 0 && g->max_rise_cppm_s == 0
+               && g->time_to_peak_s == 0 && g->decay_tau_s == 0;
+        } else {
+            ok &= g->boot == 6 && g->area_ppm_s == 900;
+        }
+    }
+
+    printf("migration: %d v1 entries kept with seq %u–%u, next seq %u, %zu delivered%s\n",
+           n, (unsigned)(next_seq - n), (unsigned)(next_seq - 1), (unsigned)next_seq, hub.n_got, ok ? "" : "  FAIL");
+    return ok;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [--trace FILE] [--hours H] [--seed N] [--loss F]\n"
+            "          [--outage-at H] [--outage H] [--reboot H]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *trace_path = NULL;
+    trace_synth_cfg_t synth = trace_synth_default();
+    double loss = 0.05, outage_at_h = 12.0, outage_h = 24.0, reboot_h = 6.0;
+
+    synth.hours = 72.0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (strcmp(argv[i], "--hours") == 0 && i + 1 < argc) {
+            synth.hours = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            synth.seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--loss") == 0 && i + 1 < argc) {
+            loss = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--outage-at") == 0 && i + 1 < argc) {
+            outage_at_h = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--outage") == 0 && i + 1 < argc) {
+            outage_h = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--reboot") == 0 && i + 1 < argc) {
+            reboot_h = atof(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    trace_t t;
+    bool loaded = trace_path ? (trace_load_csv(&t, trace_path) && replay_convert_raw(&t))
+                             : trace_synthesize(&t, &synth);
+    if (!loaded || t.count < 2) {
+        fprintf(stderr, "No trace\n");
+        return 1;
+    }
+    host_log_set_level(ESP_LOG_ERROR);
+    g_rng = synth.seed ? synth.seed : 1;
+
+    link_t l = {
+        .loss         = loss,
+        .down_from_ms = (uint32_t)(outage_at_h * 3600000.0),
+        .down_to_ms   = (uint32_t)((outage_at_h + outage_h) * 3600000.0),
+    };
+    /* Reboot on a tick boundary */
+    uint32_t reboot_ms = reboot_h > 0 ? (uint32_t)((outage_at_h + reboot_h) * 3600000.0) / TRACE_TICK_MS * TRACE_TICK_MS : 0;
+
+    printf("%s: %.1f h, %.0f%% loss each way, down %.1f–%.1f h, journal %d entries\n",
+           trace_path ? trace_path : "synthetic", t.count * TRACE_TICK_MS / 3600000.0, 100.0 * loss,
+           outage_at_h, outage_at_h + outage_h, EVENT_JOURNAL_LEN);
+
+    bool ok = trace_run(&t, &l, reboot_ms);
+    ok &= overflow_run();
+    ok &= migration_run();
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    trace_free(&t);
+    return ok ? 0 : 1;
+}
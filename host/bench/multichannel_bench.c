@@ -0,0 +1,264 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * multichannel_bench.c — Several MQ-135 channels in one scan (CONFIG_LITTERBOX_SENSOR_CHANNELS)
+ *
+ * The driver is built here a second time with three channels and distinct
+ * per-channel R0 (CMakeLists.txt: mq135_mc / mq135_mc_fx), next to the
+ * single-channel builds the other tools use.
+ *
+ * 1. Per-channel R0: every raw code on every channel vs the float model
+ *    evaluated with that channel's R0 — float build exactly, fixed-point
+ *    build (one table scaled per channel) within the table's rounding
+ *    times the channel's factor plus the rescale rounding, up to where the
+ *    table saturates
+ * 2. Independence: channel 0 of the 3-channel build is identical to the
+ *    single-channel build (value and warmup) on the same input; a drifting
+ *    channel warms up on its own schedule; a failing channel does not
+ *    invalidate the others
+ * 3. Scan cost per channel, 1 vs 3 channels (best of several runs)
+ *
+ * Exits non-zero when a tolerance below is exceeded.
+ */
+#include "air_sensor_driver.h"
+#include "bench_clock.h"
+#include "esp_adc/adc_oneshot.h"
+#include "esp_timer.h"
+#include "mq135_params.h"
+#include "warmup_estimator.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MC_CHANNELS         3
+#define FLOAT_TOL_PPM       1e-3f   /* Same float math, different R0 source (Ω int vs kΩ float) */
+#define LUT_TOL_Q6          0.5f    /* Half a Q10.6 LSB per rounding: table entry (×k) and rescale */
+#define LUT_TOL_MODEL       2e-3f   /* Generator (double) vs powf model */
+#define COST_RATIO_MAX      1.25    /* Per-channel scan cost, 3 channels vs 1 */
+#define TICK_US             2000000
+
+/* R0 of the three-channel builds, Ω — must match CMakeLists.txt */
+static const int k_r0_ohm[MC_CHANNELS] = { 6300, 4500, 9000 };
+
+/* Renamed backend builds (CMakeLists.txt) */
+extern const air_sensor_backend_t air_sensor_mq135_fx;      /* 1 channel, fixed point */
+extern const air_sensor_backend_t air_sensor_mq135_mc;      /* 3 channels, float */
+extern const air_sensor_backend_t air_sensor_mq135_mc_fx;   /* 3 channels, fixed point */
+
+static esp_err_t air_sensor_fx_init(void)    { return air_sensor_mq135_fx.init(); }
+static esp_err_t air_sensor_mc_init(void)    { return air_sensor_mq135_mc.init(); }
+static esp_err_t air_sensor_mc_fx_init(void) { return air_sensor_mq135_mc_fx.init(); }
+
+static esp_err_t air_sensor_fx_read(air_sensor_data_t *out)
+{
+    return air_sensor_backend_read(&air_sensor_mq135_fx, out);
+}
+
+static esp_err_t air_sensor_mc_read(air_sensor_data_t *out)
+{
+    return air_sensor_backend_read(&air_sensor_mq135_mc, out);
+}
+
+static esp_err_t air_sensor_mc_fx_read(air_sensor_data_t *out)
+{
+    return air_sensor_backend_read(&air_sensor_mq135_mc_fx, out);
+}
+
+static volatile uint32_t s_sink;
+
+/* The driver's float model, with an explicit R0 */
+static float model_ppm(int raw, float r0_kohm)
+{
+    float v_adc = (raw / 4095.0f) * MQ135_ADC_VREF;
+    if (v_adc < 0.001f) v_adc = 0.001f;
+    float voltage = v_adc * MQ135_DIVIDER_RATIO;
+    if (voltage >= MQ135_VCC) voltage = MQ135_VCC - 0.01f;
+    float rs_kohm = MQ135_LOAD_RESISTANCE_KOHM * (MQ135_VCC - voltage) / voltage;
+    if (rs_kohm <= 0.0f) rs_kohm = 0.01f;
+    float ppm = MQ135_NH3_CURVE_A * powf(rs_kohm / r0_kohm, MQ135_NH3_CURVE_B);
+    if (ppm < 0.0f)          ppm = 0.0f;
+    if (ppm > MQ135_PPM_MAX) ppm = (float)MQ135_PPM_MAX;
+    return ppm;
+}
+
+static void set_all_raw(int raw)
+{
+    for (int ch = 0; ch < MC_CHANNELS; ch++) {
+        host_adc_set_raw((adc_channel_t)(ADC_CHANNEL_0 + ch), raw);
+    }
+}
+
+/* ── 1. Per-channel R0 ──────────────────────────────────────────────── */
+
+static bool check_r0(void)
+{
+    air_sensor_data_t flt[MC_CHANNELS], fx[MC_CHANNELS];
+    float    max_flt[MC_CHANNELS] = {0}, max_fx[MC_CHANNELS] = {0};
+    unsigned saturated[MC_CHANNELS] = {0};
+    bool     ok = true;
+
+    air_sensor_mc_init();
+    air_sensor_mc_fx_init();
+    for (int raw = 0; raw < 4096; raw++) {
+        set_all_raw(raw);
+        air_sensor_mc_read(flt);
+        air_sensor_mc_fx_read(fx);
+        for (int ch = 0; ch < MC_CHANNELS; ch++) {
+            float r0  = k_r0_ohm[ch] / 1000.0f;
+            float ref = model_ppm(raw, r0);
+            float k   = powf(r0 / MQ135_R0_KOHM, -MQ135_NH3_CURVE_B);
+            float e   = fabsf(flt[ch].nh3_ppm_f - ref);
+            if (e > max_flt[ch]) max_flt[ch] = e;
+
+            /* The table saturates at MQ135_PPM_MAX for R0 = MQ135_R0_KOHM,
+             * i.e. at MQ135_PPM_MAX × k on this channel */
+            if (k < 1.0f && ref >= MQ135_PPM_MAX * k) {
+                saturated[ch]++;
+                continue;
+            }
+            e = fabsf(fx[ch].nh3_ppm_q / (float)(1 << AIR_SENSOR_PPM_Q_SHIFT) - ref);
+            if (e > max_fx[ch]) max_fx[ch] = e;
+        }
+    }
+
+    printf("== Per-channel R0: all 4096 codes vs float model ==\n");
+    for (int ch = 0; ch < MC_CHANNELS; ch++) {
+        float r0  = k_r0_ohm[ch] / 1000.0f;
+        float k   = powf(r0 / MQ135_R0_KOHM, -MQ135_NH3_CURVE_B);
+        float tol = LUT_TOL_Q6 / (1 << AIR_SENSOR_PPM_Q_SHIFT) * (k + 1.0f) + LUT_TOL_MODEL;
+        bool  pass = max_flt[ch] <= FLOAT_TOL_PPM && max_fx[ch] <= tol;
+        printf("  ch%d R0=%.1f kΩ (×%.3f)  float max |Δ| %.5f (tol %.3f)  LUT max |Δ| %.5f (tol %.4f)"
+               "  %u saturated codes  %s\n", ch, (double)r0, (double)k, (double)max_flt[ch],
+               (double)FLOAT_TOL_PPM, (double)max_fx[ch], (double)tol, saturated[ch], pass ? "PASS" : "FAIL");
+        ok &= pass;
+    }
+    return ok;
+}
+
+/* ── 2. Independence ────────────────────────────────────────────────── */
+
+/* Channel 0 against the single-channel build, channels 1/2 with their own input */
+static bool check_channel0(void)
+{
+    air_sensor_data_t one, mc[MC_CHANNELS];
+    unsigned differ = 0;
+    int      warm_one = -1, warm_mc = -1;
+
+    host_timer_set_time_us(0);
+    air_sensor_init();
+    air_sensor_mc_init();
+    for (int t = 0; t < 600; t++) {
+        host_adc_set_raw(ADC_CHANNEL_0, 1400 + (int)(60.0 * sin(t / 40.0)) + (t < 30 ? 30 * (30 - t) : 0));
+        host_adc_set_raw(ADC_CHANNEL_1, 900 + (t * 7) % 300);
+        host_adc_set_raw(ADC_CHANNEL_2, 2600 - t);
+        air_sensor_read(&one);
+        air_sensor_mc_read(mc);
+        differ += one.nh3_ppm_f != mc[0].nh3_ppm_f || one.is_warming_up != mc[0].is_warming_up
+                || one.raw_adc != mc[0].raw_adc;
+        if (warm_one < 0 && !one.is_warming_up) warm_one = t;
+        if (warm_mc < 0 && !mc[0].is_warming_up) warm_mc = t;
+        host_timer_advance_us(TICK_US);
+    }
+    bool ok = differ == 0;
+    printf("== Channel 0 of 3 vs single-channel build, 600 ticks ==\n");
+    printf("  %u tick(s) differ, warm at tick %d / %d  %s\n", differ, warm_one, warm_mc, ok ? "PASS" : "FAIL");
+    return ok;
+}
+
+/* Channel 1 drifts for the first minutes while 0 and 2 are steady */
+static bool check_warmup(void)
+{
+    air_sensor_data_t mc[MC_CHANNELS];
+    int warm[MC_CHANNELS] = { -1, -1, -1 };
+    const int drift_ticks = 60;
+
+    host_timer_set_time_us(0);
+    air_sensor_mc_init();
+    for (int t = 0; t < WARMUP_MAX_MS / 2000 + 10; t++) {
+        host_adc_set_raw(ADC_CHANNEL_0, 1500 + (t & 1));
+        host_adc_set_raw(ADC_CHANNEL_1, t < drift_ticks ? 2800 - 20 * t : 1600 + (t & 1));
+        host_adc_set_raw(ADC_CHANNEL_2, 1200 + (t & 1));
+        air_sensor_mc_read(mc);
+        for (int ch = 0; ch < MC_CHANNELS; ch++) {
+            if (warm[ch] < 0 && !mc[ch].is_warming_up) warm[ch] = t;
+        }
+        host_timer_advance_us(TICK_US);
+    }
+    bool ok = warm[0] >= 0 && warm[0] < WARMUP_WINDOW + 2 && warm[2] == warm[0]
+           && warm[1] >= drift_ticks && warm[1] < drift_ticks + WARMUP_WINDOW + 2;
+    printf("== Warmup per channel (channel 1 drifts for %d ticks) ==\n", drift_ticks);
+    printf("  warm at tick ch0=%d ch1=%d ch2=%d  %s\n", warm[0], warm[1], warm[2], ok ? "PASS" : "FAIL");
+    return ok;
+}
+
+static bool check_failure(void)
+{
+    air_sensor_data_t mc[MC_CHANNELS];
+
+    air_sensor_mc_init();
+    set_all_raw(1500);
+    host_adc_set_chan_error(ADC_CHANNEL_1, ESP_ERR_TIMEOUT);
+    esp_err_t err = air_sensor_mc_read(mc);
+    host_adc_set_chan_error(ADC_CHANNEL_1, ESP_OK);
+
+    bool ok = err == ESP_ERR_TIMEOUT && mc[0].is_valid && !mc[1].is_valid && mc[2].is_valid
+           && mc[0].nh3_ppm_q > 0 && mc[2].nh3_ppm_q > 0;
+    printf("== One channel failing ==\n");
+    printf("  read → %s, valid ch0=%d ch1=%d ch2=%d  %s\n", esp_err_to_name(err),
+           mc[0].is_valid, mc[1].is_valid, mc[2].is_valid, ok ? "PASS" : "FAIL");
+    return ok;
+}
+
+/* ── 3. Scan cost ───────────────────────────────────────────────────── */
+
+/* Best-of-runs ns per channel for one read() over all 4096 codes */
+static double cost_per_channel(esp_err_t (*read)(air_sensor_data_t *), int channels, int runs)
+{
+    air_sensor_data_t d[MC_CHANNELS];
+    double best = 1e30;
+
+    for (int r = 0; r < runs; r++) {
+        uint64_t t0 = bench_now_ns();
+        for (int raw = 0; raw < 4096; raw++) {
+            set_all_raw(raw);
+            read(d);
+            s_sink += d[0].nh3_ppm_q + d[channels - 1].nh3_ppm_q;
+        }
+        double ns = (double)(bench_now_ns() - t0) / (4096.0 * channels);
+        if (ns < best) best = ns;
+    }
+    return best;
+}
+
+static bool check_cost(int runs)
+{
+    air_sensor_init();
+    air_sensor_fx_init();
+    air_sensor_mc_init();
+    air_sensor_mc_fx_init();
+    double f1 = cost_per_channel(air_sensor_read, 1, runs);
+    double f3 = cost_per_channel(air_sensor_mc_read, MC_CHANNELS, runs);
+    double q1 = cost_per_channel(air_sensor_fx_read, 1, runs);
+    double q3 = cost_per_channel(air_sensor_mc_fx_read, MC_CHANNELS, runs);
+
+    bool ok = f3 <= f1 * COST_RATIO_MAX && q3 <= q1 * COST_RATIO_MAX;
+    printf("== Scan cost per channel (host, best of %d) ==\n", runs);
+    printf("  float+powf  1 ch %7.2f ns  3 ch %7.2f ns  (×%.2f)\n", f1, f3, f3 / f1);
+    printf("  LUT         1 ch %7.2f ns  3 ch %7.2f ns  (×%.2f)\n", q1, q3, q3 / q1);
+    printf("  3-channel scan within ×%.2f of one channel per channel  %s\n", COST_RATIO_MAX, ok ? "PASS" : "FAIL");
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    int  runs = argc > 1 ? atoi(argv[1]) : 15;
+    bool ok = check_r0();
+    ok &= check_channel0();
+    ok &= check_warmup();
+    ok &= check_failure();
+    ok &= check_cost(runs);
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
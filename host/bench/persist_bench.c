@@ -0,0 +1,270 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * persist_bench.c — Reboot recovery with and without the NVS baseline snapshot
+ *
+ * Replays a labelled trace through three detectors:
+ *  - reference: never reboots
+ *  - cold:      reboots periodically and re-learns the baseline from the
+ *               first reading, as the firmware did before detector_persist
+ *  - restore:   reboots at the same points and follows main.c with
+ *               CONFIG_LITTERBOX_BASELINE_PERSIST (hold through warmup,
+ *               detector_persist_restore(), detector_persist_tick())
+ * NVS is the in-memory stub, so snapshots survive the simulated reboots.
+ *
+ * After each reboot the sensor reads high by a decaying heater-settling
+ * offset (--settle PPM, --tau S; docs/MQ-135.md: 3–5 min re-warm).
+ *
+ * Reports time-to-valid: seconds after boot until the detector is IDLE with
+ * a baseline within VALID_TOL_PPM of the reference; the error of each
+ * restored baseline against the reference at the moment it is applied; and
+ * detection scores and NVS writes per day. Exits non-zero if restore is not
+ * faster than a cold start at the median and at p90, if p90 of the restore
+ * error exceeds VALID_TOL_PPM, or if the write rate exceeds the SAVE_MIN
+ * bound.
+ *
+ * Usage: persist_bench [--trace FILE] [--hours H] [--seed N]
+ *                      [--reboot-every MIN] [--down S] [--settle PPM] [--tau S] [-v]
+ */
+#include "air_sensor_driver.h"
+#include "detector_persist.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "event_detector.h"
+#include "nvs.h"
+#include "replay.h"
+#include "trace.h"
+#include "warmup_estimator.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define VALID_TOL_PPM   0.5f
+#define WARMUP_TICKS    WARMUP_WINDOW   /* Earliest readiness from the warmup estimator */
+
+typedef struct {
+    const char      *name;
+    event_detector_t det;
+    replay_score_t   score;
+    double          *ttv_s;         /* Time-to-valid per reboot */
+    size_t           n_ttv;
+    size_t           unconverged;   /* Next reboot came first */
+    long             boot;          /* Tick of last boot, −1 while converged */
+} dut_t;
+
+static void dut_boot(dut_t *d, long tick)
+{
+    event_detector_init(&d->det);
+    d->boot = tick;
+}
+
+static void dut_check_valid(dut_t *d, const event_detector_t *ref, long tick)
+{
+    if (d->boot < 0 || tick - d->boot < WARMUP_TICKS) {
+        return;
+    }
+    if (d->det.initialized && d->det.state == DETECTOR_IDLE && ref->state == DETECTOR_IDLE
+        && fabsf(d->det.baseline_ppm - ref->baseline_ppm) <= VALID_TOL_PPM) {
+        d->ttv_s[d->n_ttv++] = (tick - d->boot) * (TRACE_TICK_MS / 1000.0);
+        d->boot = -1;
+    }
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(double *v, size_t n, double p)
+{
+    if (n == 0) {
+        return 0.0;
+    }
+    qsort(v, n, sizeof(double), cmp_double);
+    return v[(size_t)(p * (n - 1) + 0.5)];
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [--trace FILE] [--hours H] [--seed N] [--reboot-every MIN]\n"
+            "          [--down S] [--settle PPM] [--tau S] [-v]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *trace_path = NULL;
+    double reboot_min = 97.0;     /* Co-prime-ish with the event spacing */
+    double down_s     = 10.0;
+    double settle_ppm = 5.0;
+    double tau_s      = 90.0;
+    trace_synth_cfg_t synth = trace_synth_default();
+
+    synth.hours = 168.0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (strcmp(argv[i], "--hours") == 0 && i + 1 < argc) {
+            synth.hours = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            synth.seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--reboot-every") == 0 && i + 1 < argc) {
+            reboot_min = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--down") == 0 && i + 1 < argc) {
+            down_s = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--settle") == 0 && i + 1 < argc) {
+            settle_ppm = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--tau") == 0 && i + 1 < argc) {
+            tau_s = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-v") == 0) {
+            host_log_set_level(ESP_LOG_INFO);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    trace_t t;
+    bool loaded = trace_path ? (trace_load_csv(&t, trace_path) && replay_convert_raw(&t))
+                             : trace_synthesize(&t, &synth);
+    if (!loaded || !t.has_label) {
+        fprintf(stderr, "Need a labelled trace\n");
+        return 1;
+    }
+
+    long every = (long)(reboot_min * 60000.0 / TRACE_TICK_MS);
+    long down  = (long)(down_s * 1000.0 / TRACE_TICK_MS);
+    if (every <= down + WARMUP_TICKS) {
+        fprintf(stderr, "--reboot-every must exceed downtime + warmup\n");
+        return 2;
+    }
+    size_t max_boots = t.count / every + 2;
+
+    event_detector_t ref;
+    dut_t cold = { .name = "cold" }, warm = { .name = "restore" };
+    dut_t *duts[2] = { &cold, &warm };
+    event_detector_init(&ref);
+    for (int k = 0; k < 2; k++) {
+        replay_score_init(&duts[k]->score);
+        duts[k]->ttv_s = calloc(max_boots, sizeof(double));
+        dut_boot(duts[k], 0);
+        duts[k]->boot = -1;         /* First power-on is not a reboot */
+    }
+    detector_persist_t persist;
+    host_nvs_erase_all();
+    host_timer_set_time_us(0);
+    detector_persist_init(&persist, DETECTOR_PERSIST_KEY);
+
+    double *restore_err = calloc(max_boots, sizeof(double));
+    size_t reboots = 0, restored = 0, rejected = 0;
+    long   boot = 0;
+    for (long i = 0; i < (long)t.count; i++) {
+        const trace_sample_t *s = &t.samples[i];
+        event_detector_update(&ref, s->ppm);
+
+        /* Power loss at each multiple of "every"; back up "down" ticks later */
+        long phase = i % every;
+        if (i > 0 && phase < down) {
+            for (int k = 0; k < 2; k++) {
+                replay_score_tick(&duts[k]->score, s->label, false, LITTER_EVENT_NONE);
+            }
+            continue;
+        }
+        if (i > 0 && phase == down) {
+            for (int k = 0; k < 2; k++) {
+                if (duts[k]->boot >= 0) {
+                    duts[k]->unconverged++;
+                }
+                dut_boot(duts[k], i);
+            }
+            host_timer_set_time_us(0);
+            detector_persist_init(&persist, DETECTOR_PERSIST_KEY);
+            boot = i;
+            reboots++;
+        }
+
+        float ppm = s->ppm;
+        if (boot > 0) {
+            ppm += (float)(settle_ppm * exp(-(i - boot) * (TRACE_TICK_MS / 1000.0) / tau_s));
+        }
+        int32_t ppm_q = EVENT_PPM_TO_Q(ppm);
+        bool warming  = (i - boot) < WARMUP_TICKS;
+
+        /* Cold start: the pre-persistence firmware fed every reading */
+        detector_state_t before = cold.det.state;
+        litter_event_t   out    = event_detector_update(&cold.det, ppm);
+        replay_score_tick(&cold.score, s->label,
+                          before == DETECTOR_IDLE && cold.det.state == DETECTOR_ACTIVE, out);
+
+        /* Restore: same sequence as sensor_sample_timer_cb() */
+        before = warm.det.state;
+        out    = LITTER_EVENT_NONE;
+        bool hold = warming;
+        if (!hold && detector_persist_pending(&persist)) {
+            if (detector_persist_restore(&persist, &warm.det, ppm_q)) {
+                restore_err[restored++] = fabs(event_detector_get_baseline(&warm.det) - ref.baseline_ppm);
+            } else if (!detector_persist_pending(&persist)) {
+                rejected++;
+            }
+            hold = detector_persist_pending(&persist);
+        }
+        if (!hold) {
+            out = event_detector_update(&warm.det, ppm);
+            detector_persist_tick(&persist, &warm.det);
+        }
+        replay_score_tick(&warm.score, s->label,
+                          before == DETECTOR_IDLE && warm.det.state == DETECTOR_ACTIVE, out);
+
+        dut_check_valid(&cold, &ref, i);
+        dut_check_valid(&warm, &ref, i);
+        host_timer_advance_us(TRACE_TICK_MS * 1000LL);
+    }
+
+    printf("== Reboot recovery: %s, %zu reboots every %.0f min, down %.0f s, settle +%.1f ppm τ %.0f s ==\n",
+           t.name, reboots, reboot_min, down_s, settle_ppm, tau_s);
+    printf("  %-8s %28s %12s\n", "", "time-to-valid med/p90/max (s)", "unconverged");
+    double med[2], p90[2];
+    for (int k = 0; k < 2; k++) {
+        dut_t *d = duts[k];
+        med[k] = percentile(d->ttv_s, d->n_ttv, 0.5);
+        p90[k] = percentile(d->ttv_s, d->n_ttv, 0.9);
+        printf("  %-8s %10.0f / %5.0f / %6.0f %12zu\n", d->name,
+               med[k], p90[k], d->n_ttv ? d->ttv_s[d->n_ttv - 1] : 0.0, d->unconverged);
+    }
+    printf("  snapshots restored=%zu rejected=%zu (settled readings off by > %.1f ppm)\n",
+           restored, rejected, CONFIG_LITTERBOX_BASELINE_RESTORE_TOL_DPPM / 10.0);
+    double err_med = percentile(restore_err, restored, 0.5);
+    double err_p90 = percentile(restore_err, restored, 0.9);
+    printf("  restored baseline vs reference: |error| med %.2f / p90 %.2f / max %.2f ppm "
+           "(save delta %.1f ppm, min %d s)\n", err_med, err_p90, restored ? restore_err[restored - 1] : 0.0,
+           CONFIG_LITTERBOX_BASELINE_SAVE_DELTA_DPPM / 10.0, CONFIG_LITTERBOX_BASELINE_SAVE_MIN_S);
+
+    replay_summary_t sum[2];
+    for (int k = 0; k < 2; k++) {
+        char title[96];
+        replay_summarize(&duts[k]->score, TRACE_TICK_MS, &sum[k]);
+        snprintf(title, sizeof(title), "%s, %s", t.name, duts[k]->name);
+        replay_print_summary(stdout, title, &sum[k]);
+    }
+
+    double days       = t.count * (TRACE_TICK_MS / 1000.0) / 86400.0;
+    double writes_day = host_nvs_write_count() / days;
+    double bound      = 86400.0 / CONFIG_LITTERBOX_BASELINE_SAVE_MIN_S;
+    printf("== NVS ==\n  snapshot writes=%u  %.1f/day (bound %.0f/day)\n",
+           host_nvs_write_count(), writes_day, bound);
+
+    bool ok = med[1] <= med[0] && p90[1] < p90[0] && err_p90 <= VALID_TOL_PPM && writes_day <= bound;
+    printf("%s\n", ok ? "PASS" : "FAIL");
+
+    for (int k = 0; k < 2; k++) {
+        replay_score_free(&duts[k]->score);
+        free(duts[k]->ttv_s);
+    }
+    free(restore_err);
+    trace_free(&t);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,318 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * provisional_bench.c — How early, and how reliably, the provisional type arrives
+ *
+ * Replays labelled traces (default: four 7-day synthetic ones) through both
+ * onset engines and follows each detection from trigger to classification:
+ *  - coverage: detections that published a provisional type before the end
+ *  - lead:     provisional → final classification, the time the hub gains
+ *  - confirmed: first provisional type equal to the final one (else corrected)
+ *  - accuracy of the first provisional and the final type against the
+ *    labels, and of the provisional per confidence band
+ * The Q15.16 back-end must publish the same sequence of provisional types
+ * as the float one, with confidences within CONFIDENCE_TOL (rounding of the
+ * peak and baseline may move one by a point).
+ *
+ * Exits non-zero unless, for each engine, coverage ≥ COVERAGE_MIN, the
+ * median lead ≥ LEAD_MIN_S, the first provisional is confirmed ≥
+ * CONFIRMED_MIN of the time, the high-confidence band is not less accurate
+ * than the low one, and both back-ends agree.
+ *
+ * Usage: provisional_bench [--trace FILE]... [--hours H] [--seed N]
+ */
+#include "air_sensor_driver.h"
+#include "esp_log.h"
+#include "event_detector.h"
+#include "replay.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_TRACES      16
+#define COVERAGE_MIN    0.90
+#define LEAD_MIN_S      60.0
+#define CONFIRMED_MIN   0.90
+#define CONFIDENCE_TOL  2
+#define SEQ_MAX         4096
+#define BANDS           3           /* Confidence < 60 %, 60–79 %, ≥ 80 % */
+
+static const char *k_band_names[BANDS] = { "< 60 %", "60-79 %", ">= 80 %" };
+
+typedef struct {
+    uint32_t classified;            /* Detections that reached a final type */
+    uint32_t provisional;           /* ... with a provisional one before it */
+    uint32_t confirmed;             /* ... whose first provisional was the final type */
+    uint32_t revised;               /* Provisional re-evaluated after a higher peak */
+    uint32_t labelled;              /* Detections matched to a labelled onset */
+    uint32_t final_ok;              /* ... final type equal to the label */
+    uint32_t prov_labelled;         /* ... with a provisional */
+    uint32_t prov_ok;               /* ... first provisional equal to the label */
+    uint32_t band_n[BANDS], band_ok[BANDS];
+    double  *lead_s;
+    double  *onset_s;               /* Labelled onset → first provisional */
+    size_t   n_lead, n_onset;
+    size_t   cap_lead, cap_onset;
+    bool     parity;                /* Q15.16 back-end published the same provisionals */
+} prov_stats_t;
+
+static int band_of(uint8_t confidence)
+{
+    return confidence < 60 ? 0 : confidence < 80 ? 1 : 2;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double median(double *v, size_t n)
+{
+    if (n == 0) {
+        return 0.0;
+    }
+    qsort(v, n, sizeof(*v), cmp_double);
+    return (n & 1) ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+}
+
+static bool push(double **v, size_t *n, size_t *cap, double x)
+{
+    if (*n == *cap) {
+        size_t c = *cap ? *cap * 2 : 256;
+        double *p = realloc(*v, c * sizeof(*p));
+        if (!p) {
+            return false;
+        }
+        *v = p;
+        *cap = c;
+    }
+    (*v)[(*n)++] = x;
+    return true;
+}
+
+/* Provisional types and confidences as a back-end publishes them */
+typedef struct {
+    uint8_t  type[SEQ_MAX], conf[SEQ_MAX];
+    size_t   n;
+    uint16_t decided_on;
+} prov_seq_t;
+
+static void seq_track(prov_seq_t *q, const event_detector_t *det)
+{
+    if (det->state != DETECTOR_ACTIVE || det->provisional_event == LITTER_EVENT_NONE) {
+        q->decided_on = 0;
+    } else if (det->provisional_peak_ticks != q->decided_on && q->n < SEQ_MAX) {
+        q->type[q->n] = det->provisional_event;
+        q->conf[q->n++] = det->provisional_confidence;
+        q->decided_on = det->provisional_peak_ticks;
+    }
+}
+
+static bool seq_match(const prov_seq_t *a, const prov_seq_t *b)
+{
+    if (a->n != b->n) {
+        return false;
+    }
+    for (size_t i = 0; i < a->n; i++) {
+        if (a->type[i] != b->type[i] || abs(a->conf[i] - b->conf[i]) > CONFIDENCE_TOL) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* One trace through one engine, float and Q15.16 side by side */
+static bool run(const trace_t *t, const event_detector_config_t *cfg, prov_stats_t *st)
+{
+    event_detector_t det, det_q;
+    static prov_seq_t seq_f, seq_q;
+    double tick_s = TRACE_TICK_MS / 1000.0;
+
+    event_detector_init_with_config(&det, cfg);
+    event_detector_init_with_config(&det_q, cfg);
+
+    long    onset = -1;                 /* Latest labelled onset not yet matched */
+    uint8_t label = LITTER_EVENT_NONE;
+    long    trigger = -1, first_at = -1;
+    uint8_t ev_label = LITTER_EVENT_NONE, first_type = LITTER_EVENT_NONE, first_conf = 0;
+    uint16_t decided_on = 0;
+    bool    ok = true;
+    seq_f.n = seq_q.n = 0;
+    seq_f.decided_on = seq_q.decided_on = 0;
+
+    for (size_t i = 0; i < t->count; i++) {
+        /* Both back-ends see the Q10.6 reading air_sensor_read() hands to main.c */
+        uint16_t q6 = (uint16_t)(t->samples[i].ppm * (1 << AIR_SENSOR_PPM_Q_SHIFT) + 0.5f);
+        detector_state_t before = det.state;
+        litter_event_t out = event_detector_update(&det, q6 / (float)(1 << AIR_SENSOR_PPM_Q_SHIFT));
+        event_detector_update_q(&det_q, (int32_t)q6 << (EVENT_PPM_Q_SHIFT - AIR_SENSOR_PPM_Q_SHIFT));
+        seq_track(&seq_f, &det);
+        seq_track(&seq_q, &det_q);
+
+        if (t->samples[i].label != LITTER_EVENT_NONE) {
+            onset = (long)i;
+            label = t->samples[i].label;
+        }
+        if (before == DETECTOR_IDLE && det.state == DETECTOR_ACTIVE) {
+            trigger = (long)i;
+            first_at = -1;
+            decided_on = 0;
+            ev_label = LITTER_EVENT_NONE;
+            if (onset >= 0 && i - (size_t)onset <= REPLAY_MATCH_WINDOW_TICKS) {
+                ev_label = label;
+            }
+        }
+        if (trigger < 0) {
+            continue;
+        }
+
+        if (det.state == DETECTOR_ACTIVE && det.provisional_event != LITTER_EVENT_NONE
+            && det.provisional_peak_ticks != decided_on) {
+            if (first_at < 0) {
+                first_at   = (long)i;
+                first_type = det.provisional_event;
+                first_conf = det.provisional_confidence;
+                if (ev_label != LITTER_EVENT_NONE) {
+                    ok &= push(&st->onset_s, &st->n_onset, &st->cap_onset, (i - (size_t)onset) * tick_s);
+                }
+            } else {
+                st->revised++;
+            }
+            decided_on = det.provisional_peak_ticks;
+        }
+
+        if (before == DETECTOR_ACTIVE && det.state != DETECTOR_ACTIVE) {
+            if (out != LITTER_EVENT_NONE) {
+                st->classified++;
+                if (first_at >= 0) {
+                    st->provisional++;
+                    st->confirmed += first_type == out;
+                    ok &= push(&st->lead_s, &st->n_lead, &st->cap_lead, (i - (size_t)first_at) * tick_s);
+                }
+                if (ev_label != LITTER_EVENT_NONE) {
+                    st->labelled++;
+                    st->final_ok += out == ev_label;
+                    if (first_at >= 0) {
+                        int b = band_of(first_conf);
+                        st->prov_labelled++;
+                        st->prov_ok += first_type == ev_label;
+                        st->band_n[b]++;
+                        st->band_ok[b] += first_type == ev_label;
+                    }
+                    onset = -1;
+                }
+            }
+            trigger = -1;
+        }
+    }
+    st->parity &= seq_match(&seq_f, &seq_q);
+    return ok;
+}
+
+static bool report(const char *engine, prov_stats_t *st)
+{
+    double coverage  = st->classified ? (double)st->provisional / st->classified : 0.0;
+    double confirmed = st->provisional ? (double)st->confirmed / st->provisional : 0.0;
+    double lead      = median(st->lead_s, st->n_lead);
+    double onset     = median(st->onset_s, st->n_onset);
+
+    printf("== Provisional classification, %s onset ==\n", engine);
+    printf("  detections classified %u, with a provisional type %u (%.1f%%), re-evaluated %u time(s)\n",
+           st->classified, st->provisional, coverage * 100, st->revised);
+    printf("  lead over the final type: median %.0f s   labelled onset → provisional: median %.0f s\n",
+           lead, onset);
+    printf("  first provisional confirmed %u/%u (%.1f%%), corrected %u\n",
+           st->confirmed, st->provisional, confirmed * 100, st->provisional - st->confirmed);
+    printf("  accuracy vs labels: provisional %u/%u  final %u/%u\n",
+           st->prov_ok, st->prov_labelled, st->final_ok, st->labelled);
+    double acc[BANDS];
+    for (int b = 0; b < BANDS; b++) {
+        acc[b] = st->band_n[b] ? (double)st->band_ok[b] / st->band_n[b] : 0.0;
+        printf("    confidence %-8s %4u  accuracy %5.1f%%\n", k_band_names[b], st->band_n[b], acc[b] * 100);
+    }
+    bool calibrated = !st->band_n[0] || !st->band_n[BANDS - 1] || acc[BANDS - 1] >= acc[0];
+    printf("  Q15.16 back-end %s\n", st->parity ? "agrees (same types, confidence ±2)" : "DIFFERS");
+
+    bool ok = coverage >= COVERAGE_MIN && lead >= LEAD_MIN_S && confirmed >= CONFIRMED_MIN
+           && calibrated && st->parity;
+    printf("  coverage ≥ %.0f%%, lead ≥ %.0f s, confirmed ≥ %.0f%%, high band ≥ low band: %s\n",
+           COVERAGE_MIN * 100, LEAD_MIN_S, CONFIRMED_MIN * 100, ok ? "PASS" : "FAIL");
+    return ok;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "Usage: %s [--trace FILE]... [--hours H] [--seed N]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *trace_paths[MAX_TRACES];
+    int n_paths = 0;
+    trace_synth_cfg_t synth = trace_synth_default();
+    synth.hours = 24.0 * 7;
+    bool seed_set = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc && n_paths < MAX_TRACES) {
+            trace_paths[n_paths++] = argv[++i];
+        } else if (strcmp(argv[i], "--hours") == 0 && i + 1 < argc) {
+            synth.hours = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            synth.seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+            seed_set = true;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    /* Traces: the given ones, else one synthetic (--seed) or seeds 1–4 */
+    trace_t traces[MAX_TRACES];
+    int n_traces = 0;
+    for (int i = 0; i < n_paths; i++) {
+        if (!trace_load_csv(&traces[n_traces], trace_paths[i]) || !replay_convert_raw(&traces[n_traces])) {
+            return 1;
+        }
+        if (!traces[n_traces].has_label) {
+            fprintf(stderr, "%s: no label column\n", trace_paths[i]);
+            return 1;
+        }
+        n_traces++;
+    }
+    for (uint32_t seed = 1; n_paths == 0 && seed <= (seed_set ? 1u : 4u); seed++) {
+        if (!seed_set) {
+            synth.seed = seed;
+        }
+        if (!trace_synthesize(&traces[n_traces++], &synth)) {
+            fprintf(stderr, "Failed to generate synthetic trace\n");
+            return 1;
+        }
+    }
+
+    static const event_detector_config_t threshold = EVENT_DETECTOR_CONFIG_DEFAULT();
+    event_detector_config_t cusum = threshold;
+    cusum.engine = EVENT_ENGINE_CUSUM;
+    const event_detector_config_t *engines[2] = { &threshold, &cusum };
+    static const char *names[2] = { "threshold", "CUSUM" };
+
+    bool ok = true;
+    for (int e = 0; e < 2; e++) {
+        prov_stats_t st = { .parity = true };
+        for (int i = 0; i < n_traces; i++) {
+            ok &= run(&traces[i], engines[e], &st);
+        }
+        ok &= report(names[e], &st);
+        free(st.lead_s);
+        free(st.onset_s);
+    }
+    for (int i = 0; i < n_traces; i++) {
+        trace_free(&traces[i]);
+    }
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,434 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * queue_bench.c — Sensor task hand-off: SPSC queue stress + tick jitter
+ *
+ * 1. Stress: a producer and a consumer thread push/pop millions of
+ *    sample_msg_t through sample_queue_t. Both sides stall at random (spin,
+ *    yield, sleep) so the queue runs empty, full and overflowing. Every field
+ *    of every message is derived from its tick, so a torn or reordered copy
+ *    shows up. Ticks must arrive in order, each gap must equal the message's
+ *    dropped count, and received + dropped must equal produced.
+ *
+ * 2. Jitter: the two firmware sampling modes on real threads with time
+ *    scaled down (--scale, default 100× so a 2 s tick is 20 ms). A "Zigbee"
+ *    thread alternates idle gaps with busy bursts (stack work, mean 3 ms,
+ *    2 % of bursts 100–400 ms, device time), during which it can't dispatch
+ *    anything.
+ *     - scheduler: sampling is an alarm callback on the Zigbee thread that
+ *       re-arms itself SENSOR_SAMPLE_INTERVAL_MS after it finishes (the
+ *       pre-CONFIG_LITTERBOX_SENSOR_TASK code)
+ *     - task: a sampler thread wakes at absolute multiples of the period
+ *       (vTaskDelayUntil) and pushes into the queue; the Zigbee thread polls
+ *       it every SAMPLE_QUEUE_POLL_MS
+ *    Each sample runs the real driver + detector. Reported in device time:
+ *    period error p50/p99/max, drift per hour, and what EVENT_END_TICKS
+ *    (nominally EVENT_END_TICKS × 2 s) really spans at the p99 period.
+ *
+ * Exits non-zero if the stress check fails or the task mode drifts more
+ * than the scheduler mode.
+ *
+ * Usage: queue_bench [--messages N] [--ticks N] [--scale N] [--seed N]
+ */
+#include "air_sensor_driver.h"
+#include "bench_clock.h"
+#include "esp_adc/adc_oneshot.h"
+#include "event_detector.h"
+#include "sample_queue.h"
+#include "trace.h"
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SAMPLE_INTERVAL_MS  2000    /* SENSOR_SAMPLE_INTERVAL_MS in main.h */
+#define REPORT_COST_US      1500    /* Device time for set_attribute + report_attr_cmd_req */
+#define SLEEP_SPIN_NS       3000000
+
+/* ── Helpers ────────────────────────────────────────────────────────── */
+
+static void spin_ns(uint64_t ns)
+{
+    uint64_t end = bench_now_ns() + ns;
+    while (bench_now_ns() < end) {
+    }
+}
+
+/* Sleep, then spin the last SLEEP_SPIN_NS: host wake-up latency (often
+ * hundreds of µs in a VM) would otherwise dominate at 100× time scaling */
+static void sleep_until_ns(uint64_t t)
+{
+    if (t > bench_now_ns() + SLEEP_SPIN_NS) {
+        uint64_t w = t - SLEEP_SPIN_NS;
+        struct timespec ts = { .tv_sec = (time_t)(w / 1000000000ULL), .tv_nsec = (long)(w % 1000000000ULL) };
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {
+        }
+    }
+    spin_ns(t > bench_now_ns() ? t - bench_now_ns() : 0);
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static uint32_t xorshift32(uint32_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+/* ── 1. Stress ──────────────────────────────────────────────────────── */
+
+static void fill_msg(sample_msg_t *m, uint32_t tick)
+{
+    memset(m, 0, sizeof(*m));
+    m->tick       = tick;
+    m->t_us       = (int64_t)tick * 2000003;
+    m->raw_adc    = tick * 2654435761u;
+    m->ppm_q      = (int32_t)~tick;
+    m->baseline_q = (int32_t)(tick ^ 0x5A5A5A5Au);
+    m->nh3_ppm    = (uint16_t)(tick * 31u);
+    m->event      = (uint8_t)(tick % 3);
+    m->flags      = (uint8_t)(tick & 3);
+}
+
+static bool msg_intact(const sample_msg_t *m)
+{
+    sample_msg_t ref;
+    fill_msg(&ref, m->tick);
+    ref.dropped = m->dropped;
+    return memcmp(&ref, m, sizeof(ref)) == 0;
+}
+
+typedef struct {
+    sample_queue_t q;
+    uint32_t       n;
+    atomic_bool    done;
+    /* Consumer results */
+    uint64_t       received;
+    uint64_t       dropped_reported;
+    uint64_t       bad_order;
+    uint64_t       bad_payload;
+    uint64_t       pushes_failed;
+} stress_t;
+
+static void random_stall(uint32_t *rng)
+{
+    volatile uint32_t sink = 0;
+    uint32_t r = xorshift32(rng) % 10000;
+    if (r < 1000) {
+        sched_yield();      /* Hand over the core (single-CPU hosts interleave only here) */
+    } else if (r < 3000) {
+        for (uint32_t i = 0; i < r; i++) {
+            sink += i;
+        }
+    }
+}
+
+static void *stress_producer(void *arg)
+{
+    stress_t *st = arg;
+    uint32_t rng = 0x12345678u;
+    for (uint32_t i = 0; i < st->n; i++) {
+        sample_msg_t m;
+        fill_msg(&m, i);
+        if (!sample_queue_push(&st->q, &m)) {
+            st->pushes_failed++;
+        }
+        random_stall(&rng);
+    }
+    atomic_store(&st->done, true);
+    return NULL;
+}
+
+static void stress_check(stress_t *st, const sample_msg_t *m, int64_t *last)
+{
+    st->received++;
+    st->dropped_reported += m->dropped;
+    if ((int64_t)m->tick != *last + 1 + (int64_t)m->dropped) {
+        st->bad_order++;
+    }
+    if (!msg_intact(m)) {
+        st->bad_payload++;
+    }
+    *last = m->tick;
+}
+
+static void *stress_consumer(void *arg)
+{
+    stress_t *st = arg;
+    uint32_t rng = 0x9E3779B9u;
+    int64_t last = -1;
+    sample_msg_t m;
+    for (;;) {
+        if (sample_queue_pop(&st->q, &m)) {
+            stress_check(st, &m, &last);
+            random_stall(&rng);
+        } else if (atomic_load(&st->done)) {
+            /* The producer may have pushed between the failed pop and the flag */
+            while (sample_queue_pop(&st->q, &m)) {
+                stress_check(st, &m, &last);
+            }
+            break;
+        } else {
+            sched_yield();      /* Empty: the firmware consumer waits for its next poll */
+        }
+    }
+    return NULL;
+}
+
+static bool run_stress(uint32_t n)
+{
+    static stress_t st;
+    memset(&st, 0, sizeof(st));
+    sample_queue_init(&st.q);
+    st.n = n;
+    atomic_init(&st.done, false);
+
+    uint64_t t0 = bench_now_ns();
+    pthread_t prod, cons;
+    pthread_create(&cons, NULL, stress_consumer, &st);
+    pthread_create(&prod, NULL, stress_producer, &st);
+    pthread_join(prod, NULL);
+    pthread_join(cons, NULL);
+    double secs = (double)(bench_now_ns() - t0) / 1e9;
+
+    /* Drops after the last successful push are still pending in the producer count */
+    uint64_t accounted = st.received + st.dropped_reported + st.q.dropped;
+    bool ok = st.bad_order == 0 && st.bad_payload == 0 && accounted == n
+           && st.pushes_failed == st.dropped_reported + st.q.dropped;
+
+    printf("Stress: %u messages in %.2f s, queue depth %d\n", n, secs, SAMPLE_QUEUE_LEN);
+    printf("  received %llu, dropped %llu (%.2f%%), out of order %llu, corrupted %llu, unaccounted %lld → %s\n",
+           (unsigned long long)st.received, (unsigned long long)(st.dropped_reported + st.q.dropped),
+           100.0 * (double)(st.dropped_reported + st.q.dropped) / n,
+           (unsigned long long)st.bad_order, (unsigned long long)st.bad_payload,
+           (long long)n - (long long)accounted, ok ? "ok" : "FAIL");
+    return ok;
+}
+
+/* ── 2. Jitter ──────────────────────────────────────────────────────── */
+
+typedef enum { MODE_SCHEDULER, MODE_TASK } mode_t_;
+
+typedef struct {
+    mode_t_          mode;
+    uint32_t         ticks;
+    uint64_t         period_ns;     /* Scaled SAMPLE_INTERVAL_MS */
+    double           scale;         /* Device time / host time */
+    uint32_t         seed;
+    trace_t          trace;
+    event_detector_t det;
+    uint64_t        *starts;        /* Host ns at each ADC read */
+    uint32_t         sampled;       /* Written by the sampling side only */
+    atomic_bool      stop;
+    sample_queue_t   q;
+    uint32_t         reported;
+} jitter_t;
+
+static void sample_once(jitter_t *j)
+{
+    const trace_sample_t *s = &j->trace.samples[j->sampled % j->trace.count];
+    host_adc_set_raw(ADC_CHANNEL_0, s->raw_adc);
+    j->starts[j->sampled] = bench_now_ns();
+    air_sensor_data_t sensor;
+    air_sensor_read(&sensor);
+    event_detector_update(&j->det, sensor.nh3_ppm_f);
+    j->sampled++;
+}
+
+static uint64_t dev_us_to_host_ns(const jitter_t *j, double us)
+{
+    return (uint64_t)(us * 1000.0 / j->scale);
+}
+
+/* Stack work model (device time): idle gap, then a busy burst */
+static void draw_stack_work(jitter_t *j, uint32_t *rng, uint64_t *gap_ns, uint64_t *busy_ns)
+{
+    double u = (xorshift32(rng) + 1.0) / 4294967297.0;
+    *gap_ns = dev_us_to_host_ns(j, -log(u) * 30000.0);                      /* mean 30 ms idle */
+    u = (xorshift32(rng) + 1.0) / 4294967297.0;
+    double busy_us = (xorshift32(rng) % 100) < 2 ? 100000.0 + 300000.0 * u  /* 100–400 ms */
+                                                 : -log(u) * 3000.0;        /* mean 3 ms */
+    *busy_ns = dev_us_to_host_ns(j, busy_us);
+}
+
+/* The sensor task outranks the Zigbee task; model that with SCHED_FIFO where allowed */
+static bool s_fifo;
+
+static void *sampler_thread(void *arg)
+{
+    jitter_t *j = arg;
+    struct sched_param sp = { .sched_priority = 10 };
+    s_fifo = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp) == 0;
+    uint64_t wake = bench_now_ns();
+    while (j->sampled < j->ticks) {
+        wake += j->period_ns;
+        sleep_until_ns(wake);
+        sample_once(j);
+        sample_msg_t m = { .tick = j->sampled - 1 };
+        sample_queue_push(&j->q, &m);
+    }
+    atomic_store(&j->stop, true);
+    return NULL;
+}
+
+/* The Zigbee task: stack work, plus either the sample alarm or the queue poll */
+static void zigbee_loop(jitter_t *j)
+{
+    uint32_t rng = j->seed | 1;
+    uint64_t gap, busy;
+    draw_stack_work(j, &rng, &gap, &busy);
+    uint64_t now = bench_now_ns();
+    uint64_t next_work = now + gap;
+    uint64_t poll_ns = dev_us_to_host_ns(j, SAMPLE_QUEUE_POLL_MS * 1000.0);
+    uint64_t next_alarm = now + (j->mode == MODE_SCHEDULER ? j->period_ns : poll_ns);
+
+    while (j->mode == MODE_SCHEDULER ? j->sampled < j->ticks : !atomic_load(&j->stop)) {
+        now = bench_now_ns();
+        if (now >= next_alarm) {
+            if (j->mode == MODE_SCHEDULER) {
+                sample_once(j);
+                spin_ns(dev_us_to_host_ns(j, REPORT_COST_US));
+                next_alarm = bench_now_ns() + j->period_ns;     /* Re-armed after the callback */
+            } else {
+                sample_msg_t m;
+                while (sample_queue_pop(&j->q, &m)) {
+                    spin_ns(dev_us_to_host_ns(j, REPORT_COST_US));
+                    j->reported++;
+                }
+                next_alarm = bench_now_ns() + poll_ns;
+            }
+        } else if (now >= next_work) {
+            spin_ns(busy);      /* Nothing else runs on this task meanwhile */
+            draw_stack_work(j, &rng, &gap, &busy);
+            next_work = bench_now_ns() + gap;
+        } else {
+            sleep_until_ns(next_alarm < next_work ? next_alarm : next_work);
+        }
+    }
+}
+
+typedef struct {
+    double p50_ms, p99_ms, max_ms, drift_s_per_h, end_window_s;
+} jitter_result_t;
+
+static jitter_result_t run_jitter(mode_t_ mode, uint32_t ticks, double scale, uint32_t seed)
+{
+    static jitter_t j;
+    memset(&j, 0, sizeof(j));
+    j.mode      = mode;
+    j.ticks     = ticks;
+    j.scale     = scale;
+    j.seed      = seed;
+    j.period_ns = (uint64_t)(SAMPLE_INTERVAL_MS * 1e6 / scale);
+    j.starts    = calloc(ticks, sizeof(*j.starts));
+    atomic_init(&j.stop, false);
+    sample_queue_init(&j.q);
+
+    trace_synth_cfg_t cfg = trace_synth_default();
+    cfg.seed  = seed;
+    cfg.hours = 1.0;
+    trace_init(&j.trace, "synthetic");
+    trace_synthesize(&j.trace, &cfg);
+    for (size_t i = 0; i < j.trace.count; i++) {
+        /* Any plausible code will do; the detector cost is what matters here */
+        j.trace.samples[i].raw_adc = (uint16_t)(900 + j.trace.samples[i].ppm * 4.0f);
+    }
+    air_sensor_init();
+    event_detector_init(&j.det);
+
+    if (mode == MODE_TASK) {
+        pthread_t th;
+        pthread_create(&th, NULL, sampler_thread, &j);
+        zigbee_loop(&j);
+        pthread_join(th, NULL);
+    } else {
+        zigbee_loop(&j);
+    }
+
+    /* Period errors in device time */
+    uint32_t n = j.sampled - 1;
+    uint64_t *err = malloc(n * sizeof(*err));
+    for (uint32_t i = 0; i < n; i++) {
+        int64_t d = (int64_t)(j.starts[i + 1] - j.starts[i]) - (int64_t)j.period_ns;
+        err[i] = (uint64_t)(d < 0 ? -d : d);
+    }
+    qsort(err, n, sizeof(*err), cmp_u64);
+    double k = scale / 1e6;     /* host ns → device ms */
+    jitter_result_t r = {
+        .p50_ms = err[n / 2] * k,
+        .p99_ms = err[(size_t)(n * 0.99)] * k,
+        .max_ms = err[n - 1] * k,
+    };
+    double span_dev_s = (double)(j.starts[j.sampled - 1] - j.starts[0]) * scale / 1e9;
+    double nominal_s  = (double)n * SAMPLE_INTERVAL_MS / 1000.0;
+    r.drift_s_per_h   = (span_dev_s - nominal_s) / nominal_s * 3600.0;
+    r.end_window_s    = EVENT_END_TICKS * (SAMPLE_INTERVAL_MS + r.p99_ms) / 1000.0;
+
+    free(err);
+    free(j.starts);
+    trace_free(&j.trace);
+    return r;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t messages = 2000000, ticks = 600, seed = 3;
+    double scale = 100.0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--messages") == 0 && i + 1 < argc) {
+            messages = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) {
+            ticks = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+            scale = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else {
+            fprintf(stderr, "Usage: %s [--messages N] [--ticks N] [--scale N] [--seed N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (ticks < 10) {
+        ticks = 10;
+    }
+    if (scale < 1.0) {
+        scale = 1.0;
+    }
+
+    bool ok = run_stress(messages);
+
+    printf("\nJitter: %u ticks per mode, time scaled %.0f× (device time below)\n", ticks, scale);
+    printf("%-10s %10s %10s %10s %12s %16s\n", "mode", "p50 ms", "p99 ms", "max ms", "drift s/h",
+           "END window s");
+    jitter_result_t r[2];
+    static const char *names[2] = { "scheduler", "task" };
+    for (int m = 0; m < 2; m++) {
+        r[m] = run_jitter((mode_t_)m, ticks, scale, seed);
+        printf("%-10s %10.2f %10.2f %10.2f %12.1f %16.2f\n", names[m], r[m].p50_ms, r[m].p99_ms,
+               r[m].max_ms, r[m].drift_s_per_h, r[m].end_window_s);
+    }
+    printf("(EVENT_END_TICKS = %d → nominal %.0f s)\n", EVENT_END_TICKS, EVENT_END_TICKS * SAMPLE_INTERVAL_MS / 1000.0);
+    if (!s_fifo) {
+        printf("(no SCHED_FIFO: task-mode jitter includes host scheduler preemption latency)\n");
+    }
+    if (fabs(r[MODE_TASK].drift_s_per_h) > fabs(r[MODE_SCHEDULER].drift_s_per_h)) {
+        printf("FAIL: task mode drifts more than scheduler mode\n");
+        ok = false;
+    }
+
+    printf("\n%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,192 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * report_bench.c — NH₃ report traffic: fixed 10 s vs report_policy
+ *
+ * Replays a trace (default: 24 h synthetic) through the detector and feeds
+ * the same integer ppm stream main.c reports to both schedulers:
+ *  - fixed:  one report every 5 ticks, as before report_policy
+ *  - policy: report_policy_update() with the Kconfig defaults (or --min,
+ *            --max, --change, --active-min, --active-max)
+ * Per scheduler it prints frames per day and estimated airtime, split into
+ * idle (steady state) and ACTIVE ticks. It also shows how well the hub's
+ * last reported value tracks the device: mean/max error and the longest
+ * time without a report during ACTIVE, plus the delay from entering
+ * ACTIVE to the first report.
+ *
+ * Exits non-zero unless the policy sends ≥10× fewer idle frames and is
+ * no slower than the fixed schedule during events.
+ *
+ * Usage: report_bench [--trace FILE] [--hours H] [--seed N] [--min S] [--max S]
+ *                     [--change PPM] [--active-min S] [--active-max S]
+ */
+#include "event_detector.h"
+#include "replay.h"
+#include "report_policy.h"
+#include "trace.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FIXED_REPORT_TICKS  5
+#define FRAME_AIR_US        1900    /* ~50 B report at 250 kbit/s + MAC ack + turnaround */
+
+typedef struct {
+    const char *name;
+    uint64_t frames_idle, frames_active;
+    uint64_t ticks_idle, ticks_active;
+    double   err_sum_idle, err_sum_active;
+    unsigned err_max_idle, err_max_active;
+    uint32_t stale_max_active;      /* Ticks since last report, max over ACTIVE ticks */
+    uint64_t onset_delay_sum;       /* Ticks from ACTIVE entry to the first report */
+    uint32_t onset_delay_max;
+    uint32_t onsets;
+    /* Running state */
+    uint16_t hub_value;
+    uint32_t since_report;
+    int32_t  onset_wait;            /* −1: not waiting */
+} sched_stats_t;
+
+static void account(sched_stats_t *s, bool sent, uint16_t value, bool active, bool entered_active)
+{
+    if (entered_active) {
+        s->onsets++;
+        s->onset_wait = 0;
+    }
+    if (sent) {
+        s->hub_value = value;
+        s->since_report = 0;
+        if (s->onset_wait >= 0) {
+            s->onset_delay_sum += (uint32_t)s->onset_wait;
+            if ((uint32_t)s->onset_wait > s->onset_delay_max) {
+                s->onset_delay_max = (uint32_t)s->onset_wait;
+            }
+            s->onset_wait = -1;
+        }
+    } else {
+        s->since_report++;
+        if (s->onset_wait >= 0) {
+            s->onset_wait++;
+        }
+    }
+
+    unsigned err = (unsigned)abs((int)value - (int)s->hub_value);
+    if (active) {
+        s->ticks_active++;
+        s->frames_active += sent;
+        s->err_sum_active += err;
+        s->err_max_active = err > s->err_max_active ? err : s->err_max_active;
+        s->stale_max_active = s->since_report > s->stale_max_active ? s->since_report : s->stale_max_active;
+    } else {
+        s->ticks_idle++;
+        s->frames_idle += sent;
+        s->err_sum_idle += err;
+        s->err_max_idle = err > s->err_max_idle ? err : s->err_max_idle;
+    }
+}
+
+static void print_stats(const sched_stats_t *s, double days)
+{
+    double frames = (double)(s->frames_idle + s->frames_active);
+    printf("%-7s %9.0f %9.0f %9.0f %8.1f  %6.2f/%-4u %6.2f/%-4u %8.0f %5.1f/%-4.0f\n", s->name,
+           frames / days, s->frames_idle / days, s->frames_active / days,
+           frames * FRAME_AIR_US / 1000.0 / days,
+           s->ticks_idle ? s->err_sum_idle / s->ticks_idle : 0.0, s->err_max_idle,
+           s->ticks_active ? s->err_sum_active / s->ticks_active : 0.0, s->err_max_active,
+           s->stale_max_active * TRACE_TICK_MS / 1000.0,
+           s->onsets ? (double)s->onset_delay_sum / s->onsets * TRACE_TICK_MS / 1000.0 : 0.0,
+           s->onset_delay_max * TRACE_TICK_MS / 1000.0);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [--trace FILE] [--hours H] [--seed N] [--min S] [--max S]\n"
+            "          [--change PPM] [--active-min S] [--active-max S]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *trace_path = NULL;
+    trace_synth_cfg_t synth = trace_synth_default();
+    report_policy_cfg_t cfg = REPORT_POLICY_CFG_DEFAULT();
+
+    synth.hours = 24.0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (strcmp(argv[i], "--hours") == 0 && i + 1 < argc) {
+            synth.hours = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            synth.seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--min") == 0 && i + 1 < argc) {
+            cfg.min_interval_s = (uint16_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max") == 0 && i + 1 < argc) {
+            cfg.max_interval_s = (uint16_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--change") == 0 && i + 1 < argc) {
+            cfg.reportable_change = (uint16_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--active-min") == 0 && i + 1 < argc) {
+            cfg.active_min_interval_s = (uint16_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--active-max") == 0 && i + 1 < argc) {
+            cfg.active_max_interval_s = (uint16_t)atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    trace_t t;
+    bool loaded = trace_path ? (trace_load_csv(&t, trace_path) && replay_convert_raw(&t))
+                             : trace_synthesize(&t, &synth);
+    if (!loaded || t.count < 2) {
+        fprintf(stderr, "No trace\n");
+        return 1;
+    }
+
+    event_detector_t det;
+    event_detector_init(&det);
+    report_policy_t policy;
+    report_policy_init(&policy, &cfg);
+    sched_stats_t fixed = { .name = "fixed", .onset_wait = -1 };
+    sched_stats_t adapt = { .name = "policy", .onset_wait = -1 };
+    bool was_active = false;
+
+    for (size_t i = 0; i < t.count; i++) {
+        event_detector_update(&det, t.samples[i].ppm);
+        float ppm = t.samples[i].ppm;
+        uint16_t value = (uint16_t)(ppm < 0.0f ? 0.0f : ppm);    /* Driver truncates to whole ppm */
+        bool active = det.state == DETECTOR_ACTIVE;
+        bool entered = active && !was_active;
+        was_active = active;
+
+        bool fixed_sent = ((i + 1) % FIXED_REPORT_TICKS) == 0;
+        bool adapt_sent = report_policy_update(&policy, (uint32_t)(i * TRACE_TICK_MS), value, active);
+        account(&fixed, fixed_sent, value, active, entered);
+        account(&adapt, adapt_sent, value, active, entered);
+    }
+
+    double days = (double)t.count * TRACE_TICK_MS / 86400000.0;
+    printf("%s: %.1f h, %zu ticks (%.1f%% ACTIVE, %u events)\n", trace_path ? trace_path : "synthetic",
+           days * 24.0, t.count, 100.0 * fixed.ticks_active / t.count, fixed.onsets);
+    printf("policy: idle %u–%u s ±%u ppm, active %u–%u s\n\n", cfg.min_interval_s, cfg.max_interval_s,
+           cfg.reportable_change, cfg.active_min_interval_s, cfg.active_max_interval_s);
+    printf("%-7s %9s %9s %9s %8s  %11s %11s %8s %10s\n", "", "frames/d", "idle/d", "active/d", "air ms/d",
+           "idle err", "active err", "stale s", "onset s");
+    printf("%-7s %9s %9s %9s %8s  %11s %11s %8s %10s\n", "", "", "", "", "", "mean/max", "mean/max",
+           "(active)", "mean/max");
+    print_stats(&fixed, days);
+    print_stats(&adapt, days);
+
+    double idle_ratio = adapt.frames_idle ? (double)fixed.frames_idle / adapt.frames_idle : INFINITY;
+    printf("\nidle frames: %.1f× fewer, total: %.1f× fewer\n", idle_ratio,
+           (double)(fixed.frames_idle + fixed.frames_active) / (adapt.frames_idle + adapt.frames_active));
+
+    bool ok = idle_ratio >= 10.0 && adapt.stale_max_active <= fixed.stale_max_active
+           && adapt.onset_delay_max <= fixed.onset_delay_max;
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    trace_free(&t);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,416 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * report_mgr_bench.c — Coalesced, acknowledged reports over a lossy link
+ *
+ * Replays a trace (default: 24 h synthetic) through the detector and the
+ * report decisions main.c makes each tick (NH₃ report_policy, event
+ * report_policy, sample blocks of the default period), and sends them two
+ * ways over a link that loses --loss of all frames in each direction:
+ *  - separate: one Report Attributes frame per attribute, no
+ *              acknowledgement, blocks on their period only, as before
+ *              report_mgr
+ *  - report_mgr: one coalesced frame per tick, Default Response acks,
+ *              retries with backoff. As in sensor_report(), a block due
+ *              within the NH₃ min interval goes out with an NH₃ or event
+ *              report, and a block sent alone carries the NH₃ value
+ *              (restarting its report policy)
+ * A hub model parses every frame that arrives, applies the records and
+ * keeps the sequence of event types it saw.
+ *
+ * Prints frames per day, most frames sent in one tick (sends under the
+ * Zigbee lock), event transitions delivered in order, sample blocks
+ * delivered, the separate frames without the blocks (the cost of NH₃ and
+ * event reports alone), and report_mgr's retry counters, for --loss and a sweep of
+ * loss rates. Exits non-zero unless report_mgr sends at most 85 % of the
+ * separate frames on a clean link and fewer at 10 % loss, never more than
+ * one per tick, delivers at least as many sample blocks, and delivers every
+ * event transition in order at each loss rate up to 30 %.
+ *
+ * Usage: report_mgr_bench [--trace FILE] [--hours H] [--seed N] [--loss F]
+ */
+#include "event_detector.h"
+#include "replay.h"
+#include "report_mgr.h"
+#include "report_policy.h"
+#include "sample_block.h"
+#include "trace.h"
+#include "zcl_reporting.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_EVENTS      4096
+#define ACK_DELAY_MIN_MS 50     /* Default Response arrives at the next parent poll */
+#define ACK_DELAY_MAX_MS 1500
+
+enum { ATTR_NH3, ATTR_EVENT, ATTR_BLOCK, ATTR_NUM };
+static const report_mgr_attr_cfg_t k_attrs[ATTR_NUM] = {
+    [ATTR_NH3]   = { 0x0000, ZCL_TYPE_U16,       false },
+    [ATTR_EVENT] = { 0x0003, ZCL_TYPE_U8,        true  },
+    [ATTR_BLOCK] = { 0x0004, ZCL_TYPE_OCTET_STR, false },
+};
+
+typedef struct {
+    uint8_t  events[MAX_EVENTS];    /* Event types received, consecutive duplicates collapsed */
+    size_t   n_events;
+    uint32_t blocks;        /* Distinct blocks (a resend whose ack was lost arrives twice) */
+    bool     have_block;
+    uint8_t  block_seq;
+    uint16_t nh3;
+} hub_t;
+
+typedef struct {
+    const char *name;
+    uint64_t frames;
+    uint32_t max_frames_tick;
+    hub_t    hub;
+} mode_stats_t;
+
+typedef struct {
+    bool     pending;
+    uint8_t  tsn;
+    uint32_t at_ms;
+} ack_t;
+
+static uint64_t g_rng;
+
+static bool lost(double loss)
+{
+    return trace_rng_uniform(&g_rng) < loss;
+}
+
+static void hub_event(hub_t *h, uint8_t ev)
+{
+    if ((h->n_events == 0 || h->events[h->n_events - 1] != ev) && h->n_events < MAX_EVENTS) {
+        h->events[h->n_events++] = ev;
+    }
+}
+
+/* Parse a Report Attributes payload (attr id, type, value)* */
+static void hub_receive(hub_t *h, const uint8_t *p, size_t len)
+{
+    size_t pos = 0;
+    while (pos + 3 <= len) {
+        uint16_t id = (uint16_t)(p[pos] | (p[pos + 1] << 8));
+        uint8_t type = p[pos + 2];
+        pos += 3;
+        size_t vlen = type == ZCL_TYPE_U8 ? 1 : type == ZCL_TYPE_U16 ? 2 : 1u + p[pos];
+        if (id == 0x0000) {
+            h->nh3 = (uint16_t)(p[pos] | (p[pos + 1] << 8));
+        } else if (id == 0x0003) {
+            hub_event(h, p[pos]);
+        } else if (id == 0x0004) {
+            sample_block_hdr_t hdr;
+            uint16_t values[SAMPLE_BLOCK_MAX_SAMPLES];
+            if (sample_block_decode(&p[pos + 1], p[pos], &hdr, values, SAMPLE_BLOCK_MAX_SAMPLES) > 0
+                && (!h->have_block || hdr.seq != h->block_seq)) {
+                h->blocks++;
+                h->have_block = true;
+                h->block_seq = hdr.seq;
+            }
+        }
+        pos += vlen;
+    }
+}
+
+static bool events_match(const uint8_t *sent, size_t n_sent, const hub_t *h)
+{
+    return n_sent == h->n_events && memcmp(sent, h->events, n_sent) == 0;
+}
+
+/* Checks of the manager alone: record layout, supersede, ack, backoff, queue order */
+static bool unit_checks(void)
+{
+    report_mgr_t m;
+    report_mgr_init(&m, k_attrs, ATTR_NUM);
+    uint8_t out[REPORT_MGR_FRAME_MAX];
+    bool ok = true;
+
+    report_mgr_set(&m, ATTR_NH3, (uint8_t[]){ 0x34, 0x12 }, 2);
+    report_mgr_set(&m, ATTR_NH3, (uint8_t[]){ 0x35, 0x12 }, 2);     /* Supersedes */
+    report_mgr_set(&m, ATTR_EVENT, (uint8_t[]){ 1 }, 1);
+    report_mgr_set(&m, ATTR_EVENT, (uint8_t[]){ 0 }, 1);            /* Queued behind 1 */
+    size_t n = report_mgr_flush(&m, 0, 7, out, sizeof(out));
+    static const uint8_t expect[] = { 0x00, 0x00, ZCL_TYPE_U16, 0x35, 0x12, 0x03, 0x00, ZCL_TYPE_U8, 1 };
+    ok &= n == sizeof(expect) && memcmp(out, expect, n) == 0;
+    ok &= report_mgr_flush(&m, 100, 8, out, sizeof(out)) == 0;     /* Event 0 waits for the ack of 1 */
+    ok &= report_mgr_ack(&m, 200, 7, 0) && !report_mgr_ack(&m, 200, 7, 0);
+    n = report_mgr_flush(&m, 300, 9, out, sizeof(out));
+    ok &= n == 4 && out[3] == 0;
+
+    /* No ack: resent after timeout + backoff, not before */
+    report_mgr_poll(&m, 300 + REPORT_MGR_ACK_TIMEOUT_MS);
+    ok &= report_mgr_flush(&m, 300 + REPORT_MGR_ACK_TIMEOUT_MS, 10, out, sizeof(out)) == 0;
+    ok &= report_mgr_flush(&m, 300 + REPORT_MGR_ACK_TIMEOUT_MS + REPORT_MGR_BACKOFF_BASE_MS, 10, out, sizeof(out)) == 4;
+    ok &= report_mgr_ack(&m, 9000, 10, 0) && report_mgr_idle(&m);
+
+    /* Latest-value class gives up after REPORT_MGR_RETRY_MAX */
+    report_mgr_set(&m, ATTR_NH3, (uint8_t[]){ 1, 0 }, 2);
+    uint32_t t = 10000;
+    for (int i = 0; i <= REPORT_MGR_RETRY_MAX + 2; i++) {
+        report_mgr_flush(&m, t, (uint8_t)(20 + i), out, sizeof(out));
+        report_mgr_poll(&m, t + REPORT_MGR_ACK_TIMEOUT_MS);
+        t += REPORT_MGR_ACK_TIMEOUT_MS + REPORT_MGR_BACKOFF_MAX_MS;
+    }
+    ok &= report_mgr_idle(&m) && m.stats.dropped == 1;
+
+    printf("unit checks: %s\n", ok ? "ok" : "FAIL");
+    return ok;
+}
+
+typedef struct {
+    double   days;
+    size_t   n_events_sent;
+    uint32_t sep_blocks_sent, blocks_sent;
+    mode_stats_t sep, mgr;
+    report_mgr_stats_t mgr_stats;
+} run_result_t;
+
+static void run(const trace_t *t, double loss, uint8_t *events_sent, run_result_t *r)
+{
+    memset(r, 0, sizeof(*r));
+    r->sep.name = "separate";
+    r->mgr.name = "report_mgr";
+
+    event_detector_t det;
+    event_detector_init(&det);
+    report_policy_cfg_t cfg = REPORT_POLICY_CFG_DEFAULT();
+    report_policy_t nh3_sep, nh3_policy, event_policy;
+    report_policy_init(&nh3_sep, &cfg);
+    report_policy_init(&nh3_policy, &cfg);
+    report_policy_cfg_t ecfg = { 0, 0, 1, 0, 0 };
+    report_policy_init(&event_policy, &ecfg);
+    sample_block_t blk_sep, blk;
+    sample_block_init(&blk_sep, TRACE_TICK_MS);
+    sample_block_init(&blk, TRACE_TICK_MS);
+    uint32_t block_samples = CONFIG_LITTERBOX_SAMPLE_BLOCK_S * 1000u / TRACE_TICK_MS;
+    if (block_samples > SAMPLE_BLOCK_MAX_SAMPLES) {
+        block_samples = SAMPLE_BLOCK_MAX_SAMPLES;
+    }
+    uint32_t hold = cfg.min_interval_s * 1000u / TRACE_TICK_MS;
+    uint32_t block_early = block_samples - (hold < block_samples / 2 ? hold : block_samples / 2);
+
+    report_mgr_t m;
+    report_mgr_init(&m, k_attrs, ATTR_NUM);
+    ack_t acks[REPORT_MGR_INFLIGHT * 2] = {0};
+    uint8_t tsn = 0;
+
+    for (size_t i = 0; i < t->count; i++) {
+        uint32_t now_ms = (uint32_t)(i * TRACE_TICK_MS);
+        float ppm = t->samples[i].ppm;
+        event_detector_update(&det, ppm);
+
+        /* Acks that arrived since the last tick */
+        for (size_t a = 0; a < sizeof(acks) / sizeof(acks[0]); a++) {
+            if (acks[a].pending && acks[a].at_ms <= now_ms) {
+                report_mgr_ack(&m, acks[a].at_ms, acks[a].tsn, 0);
+                acks[a].pending = false;
+            }
+        }
+
+        /* Producers, as sensor_report() */
+        uint16_t nh3 = (uint16_t)(ppm < 0.0f ? 0.0f : ppm);
+        uint8_t ev = (uint8_t)det.current_event;
+        bool active = det.state == DETECTOR_ACTIVE;
+        bool sep_nh3 = report_policy_update(&nh3_sep, now_ms, nh3, active);
+        bool do_nh3 = report_policy_update(&nh3_policy, now_ms, nh3, active);
+        bool do_event = report_policy_update(&event_policy, now_ms, ev, false);
+        uint8_t nh3_v[2] = { (uint8_t)nh3, (uint8_t)(nh3 >> 8) };
+        uint8_t rec[3 + REPORT_MGR_VALUE_MAX];
+        uint32_t sep_frames = 0;
+
+        if (do_nh3) {
+            report_mgr_set(&m, ATTR_NH3, nh3_v, 2);
+        }
+        if (sep_nh3) {
+            rec[0] = 0x00; rec[1] = 0x00; rec[2] = ZCL_TYPE_U16; memcpy(&rec[3], nh3_v, 2);
+            sep_frames++;
+            if (!lost(loss)) {
+                hub_receive(&r->sep.hub, rec, 5);
+            }
+        }
+        if (do_event) {
+            if (r->n_events_sent == 0 || events_sent[r->n_events_sent - 1] != ev) {
+                events_sent[r->n_events_sent++] = ev;
+            }
+            report_mgr_set(&m, ATTR_EVENT, &ev, 1);
+            rec[0] = 0x03; rec[1] = 0x00; rec[2] = ZCL_TYPE_U8; rec[3] = ev;
+            sep_frames++;
+            if (!lost(loss)) {
+                hub_receive(&r->sep.hub, rec, 4);
+            }
+        }
+        long dppm = lround(ppm * 10.0);
+        uint16_t value = dppm < 0 ? 0 : dppm >= SAMPLE_BLOCK_INVALID ? SAMPLE_BLOCK_INVALID - 1 : (uint16_t)dppm;
+        bool sep_full = !sample_block_add(&blk_sep, (uint32_t)i, value);
+        if (sep_full || blk_sep.count >= block_samples) {
+            rec[0] = 0x04; rec[1] = 0x00; rec[2] = ZCL_TYPE_OCTET_STR; rec[3] = blk_sep.len;
+            memcpy(&rec[4], blk_sep.buf, blk_sep.len);
+            sep_frames++;
+            r->sep_blocks_sent++;
+            if (!lost(loss)) {
+                hub_receive(&r->sep.hub, rec, 4u + blk_sep.len);
+            }
+            sample_block_reset(&blk_sep);
+            if (sep_full) {
+                sample_block_add(&blk_sep, (uint32_t)i, value);   /* Always fits an empty block */
+            }
+        }
+
+        /* sample_block_append() */
+        bool block_full = !sample_block_add(&blk, (uint32_t)i, value);
+        if (block_full || blk.count >= block_samples || ((do_nh3 || do_event) && blk.count >= block_early)) {
+            uint8_t v[1 + SAMPLE_BLOCK_MAX_BYTES];
+            v[0] = blk.len;
+            memcpy(&v[1], blk.buf, blk.len);
+            report_mgr_set(&m, ATTR_BLOCK, v, 1u + blk.len);
+            r->blocks_sent++;
+            sample_block_reset(&blk);
+            if (block_full) {
+                sample_block_add(&blk, (uint32_t)i, value);   /* Always fits an empty block */
+            }
+            if (!do_nh3) {
+                report_mgr_set(&m, ATTR_NH3, nh3_v, 2);
+                report_policy_mark_sent(&nh3_policy, now_ms, nh3);
+            }
+        }
+        r->sep.frames += sep_frames;
+        r->sep.max_frames_tick = sep_frames > r->sep.max_frames_tick ? sep_frames : r->sep.max_frames_tick;
+
+        /* report_flush() */
+        report_mgr_poll(&m, now_ms);
+        uint8_t payload[REPORT_MGR_FRAME_MAX];
+        size_t len = report_mgr_flush(&m, now_ms, tsn, payload, sizeof(payload));
+        if (len) {
+            r->mgr.frames++;
+            r->mgr.max_frames_tick = r->mgr.max_frames_tick ? r->mgr.max_frames_tick : 1;
+            if (!lost(loss)) {
+                hub_receive(&r->mgr.hub, payload, len);
+                if (!lost(loss)) {
+                    for (size_t a = 0; a < sizeof(acks) / sizeof(acks[0]); a++) {
+                        if (!acks[a].pending) {
+                            double d = ACK_DELAY_MIN_MS + trace_rng_uniform(&g_rng) * (ACK_DELAY_MAX_MS - ACK_DELAY_MIN_MS);
+                            acks[a] = (ack_t){ true, tsn, now_ms + (uint32_t)d };
+                            break;
+                        }
+                    }
+                }
+            }
+            tsn++;
+        }
+    }
+
+    /* Let outstanding retries finish (link stays lossy) */
+    for (uint32_t k = 1; !report_mgr_idle(&m) && k < 100000; k++) {
+        uint32_t now_ms = (uint32_t)(t->count * TRACE_TICK_MS) + k * TRACE_TICK_MS;
+        for (size_t a = 0; a < sizeof(acks) / sizeof(acks[0]); a++) {
+            if (acks[a].pending && acks[a].at_ms <= now_ms) {
+                report_mgr_ack(&m, acks[a].at_ms, acks[a].tsn, 0);
+                acks[a].pending = false;
+            }
+        }
+        report_mgr_poll(&m, now_ms);
+        uint8_t payload[REPORT_MGR_FRAME_MAX];
+        size_t len = report_mgr_flush(&m, now_ms, tsn, payload, sizeof(payload));
+        if (len) {
+            r->mgr.frames++;
+            if (!lost(loss)) {
+                hub_receive(&r->mgr.hub, payload, len);
+                if (!lost(loss)) {
+                    for (size_t a = 0; a < sizeof(acks) / sizeof(acks[0]); a++) {
+                        if (!acks[a].pending) {
+                            acks[a] = (ack_t){ true, tsn, now_ms + ACK_DELAY_MIN_MS };
+                            break;
+                        }
+                    }
+                }
+            }
+            tsn++;
+        }
+    }
+
+    r->days = (double)t->count * TRACE_TICK_MS / 86400000.0;
+    r->mgr_stats = m.stats;
+}
+
+static void print_mode(const mode_stats_t *s, const run_result_t *r, uint32_t blocks_sent, const uint8_t *events_sent)
+{
+    printf("  %-11s %9.0f %6u   %5zu/%-5zu %-8s %6u/%-6u\n", s->name, s->frames / r->days, s->max_frames_tick,
+           s->hub.n_events, r->n_events_sent, events_match(events_sent, r->n_events_sent, &s->hub) ? "in order" : "MISSING",
+           s->hub.blocks, blocks_sent);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "Usage: %s [--trace FILE] [--hours H] [--seed N] [--loss F]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *trace_path = NULL;
+    trace_synth_cfg_t synth = trace_synth_default();
+    double loss = 0.1;
+
+    synth.hours = 24.0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (strcmp(argv[i], "--hours") == 0 && i + 1 < argc) {
+            synth.hours = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            synth.seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--loss") == 0 && i + 1 < argc) {
+            loss = atof(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    trace_t t;
+    bool loaded = trace_path ? (trace_load_csv(&t, trace_path) && replay_convert_raw(&t))
+                             : trace_synthesize(&t, &synth);
+    if (!loaded || t.count < 2) {
+        fprintf(stderr, "No trace\n");
+        return 1;
+    }
+    g_rng = synth.seed ? synth.seed : 1;
+
+    bool ok = unit_checks();
+    printf("%s: %.1f h, ack timeout %d ms, backoff %d–%d ms\n", trace_path ? trace_path : "synthetic",
+           t.count * TRACE_TICK_MS / 3600000.0, REPORT_MGR_ACK_TIMEOUT_MS, REPORT_MGR_BACKOFF_BASE_MS,
+           REPORT_MGR_BACKOFF_MAX_MS);
+
+    static uint8_t events_sent[MAX_EVENTS];
+    double losses[] = { loss, 0.0, 0.05, 0.3 };
+    for (size_t k = 0; k < sizeof(losses) / sizeof(losses[0]); k++) {
+        if (k > 0 && losses[k] == loss) {
+            continue;
+        }
+        run_result_t r;
+        run(&t, losses[k], events_sent, &r);
+        printf("\nloss %.0f%% each way\n", 100.0 * losses[k]);
+        printf("  %-11s %9s %6s   %11s %-8s %13s\n", "", "frames/d", "max/tk", "events", "", "blocks");
+        print_mode(&r.sep, &r, r.sep_blocks_sent, events_sent);
+        print_mode(&r.mgr, &r, r.blocks_sent, events_sent);
+        printf("  without blocks (separate): %.0f frames/d\n", (r.sep.frames - r.sep_blocks_sent) / r.days);
+        const report_mgr_stats_t *st = &r.mgr_stats;
+        printf("  report_mgr: %.2f attrs/frame, %u acked (max %u ms), %u lost, %u resent, %u dropped\n",
+               (double)st->attrs / st->frames, st->acked, st->ack_ms_max, st->timeouts, st->retries, st->dropped);
+
+        /* Retries cost frames under loss; coalescing has to pay for them up to 10 % */
+        ok &= r.mgr.max_frames_tick <= 1;
+        ok &= losses[k] > 0.1 || r.mgr.frames < r.sep.frames;
+        ok &= losses[k] > 0 || r.mgr.frames <= 0.85 * r.sep.frames;
+        ok &= r.mgr.hub.blocks >= r.sep.hub.blocks;
+        ok &= losses[k] > 0.3 || events_match(events_sent, r.n_events_sent, &r.mgr.hub);
+    }
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    trace_free(&t);
+    return ok ? 0 : 1;
+}
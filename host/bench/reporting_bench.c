@@ -0,0 +1,279 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * reporting_bench.c — Configure Reporting codec, NVS round trip and fuzz
+ *
+ * Feeds hand-built ZCL Configure Reporting / Read Reporting Configuration
+ * payloads through zcl_reporting.c with the attribute table main.c uses and
+ * compares the response bytes and resulting table with the expected ones:
+ * success, wrong type, min > max, unknown and unreportable attributes,
+ * server-to-client direction, truncated records, the discrete octet-string
+ * attribute (no reportable change field). Then checks the NVS
+ * round trip and that report_policy honours max = 0xFFFF (off). Last, it
+ * throws random payloads at both parsers and checks the response never
+ * exceeds the buffer and the table stays valid.
+ *
+ * Exits non-zero on any mismatch.
+ *
+ * Usage: reporting_bench [--fuzz N] [--seed N]
+ */
+#include "nvs.h"
+#include "report_policy.h"
+#include "trace.h"
+#include "zcl_reporting.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Same layout as g_reporting in main.c */
+static const zcl_report_attr_t k_default[] = {
+    { 0x0000, ZCL_TYPE_U16, true,  10, 300, 2 },
+    { 0x0003, ZCL_TYPE_U8,  true,  0,   0,  1 },
+    { 0x0004, ZCL_TYPE_OCTET_STR, true, 10, 0, 0 },
+    { 0x0001, ZCL_TYPE_U16, false, 0, 0, 0 },
+    { 0x0002, ZCL_TYPE_U16, false, 0, 0, 0 },
+};
+#define N_ATTRS (sizeof(k_default) / sizeof(k_default[0]))
+
+typedef struct {
+    const char   *name;
+    uint8_t       in[32];
+    size_t        in_len;
+    uint8_t       resp[16];
+    size_t        resp_len;
+    bool          changed;
+    uint16_t      nh3[3];       /* Expected NH3 min, max, change afterwards */
+} configure_case_t;
+
+static const configure_case_t k_cases[] = {
+    { "nh3 60/3600/5",
+      { 0x00, 0x00, 0x00, ZCL_TYPE_U16, 60, 0, 0x10, 0x0E, 5, 0 }, 10,
+      { ZCL_STATUS_SUCCESS }, 1, true, { 60, 3600, 5 } },
+    { "same again (no change)",
+      { 0x00, 0x00, 0x00, ZCL_TYPE_U16, 60, 0, 0x10, 0x0E, 5, 0 }, 10,
+      { ZCL_STATUS_SUCCESS }, 1, false, { 60, 3600, 5 } },
+    { "nh3 + event in one frame",
+      { 0x00, 0x00, 0x00, ZCL_TYPE_U16, 5, 0, 120, 0, 1, 0,
+        0x00, 0x03, 0x00, ZCL_TYPE_U8, 1, 0, 0, 0, 1 }, 19,
+      { ZCL_STATUS_SUCCESS }, 1, true, { 5, 120, 1 } },
+    { "wrong type",
+      { 0x00, 0x00, 0x00, ZCL_TYPE_U8, 60, 0, 0x10, 0x0E, 5 }, 9,
+      { ZCL_STATUS_INVALID_DATA_TYPE, 0x00, 0x00, 0x00 }, 4, false, { 5, 120, 1 } },
+    { "min > max",
+      { 0x00, 0x00, 0x00, ZCL_TYPE_U16, 200, 0, 100, 0, 5, 0 }, 10,
+      { ZCL_STATUS_INVALID_VALUE, 0x00, 0x00, 0x00 }, 4, false, { 5, 120, 1 } },
+    { "min > max=0 (no heartbeat)",
+      { 0x00, 0x00, 0x00, ZCL_TYPE_U16, 200, 0, 0, 0, 5, 0 }, 10,
+      { ZCL_STATUS_SUCCESS }, 1, true, { 200, 0, 5 } },
+    { "unknown attr + good record",
+      { 0x00, 0x42, 0x00, ZCL_TYPE_U16, 1, 0, 2, 0, 3, 0,
+        0x00, 0x00, 0x00, ZCL_TYPE_U16, 30, 0, 0xFF, 0xFF, 0, 0 }, 20,
+      { ZCL_STATUS_UNSUPPORTED_ATTRIBUTE, 0x00, 0x42, 0x00 }, 4, true, { 30, 0xFFFF, 0 } },
+    { "unreportable attr",
+      { 0x00, 0x01, 0x00, ZCL_TYPE_U16, 1, 0, 2, 0, 3, 0 }, 10,
+      { ZCL_STATUS_UNREPORTABLE_ATTRIBUTE, 0x00, 0x01, 0x00 }, 4, false, { 30, 0xFFFF, 0 } },
+    { "direction 1 (received)",
+      { 0x01, 0x00, 0x00, 0x3C, 0x00 }, 5,
+      { ZCL_STATUS_UNSUPPORTED_ATTRIBUTE, 0x01, 0x00, 0x00 }, 4, false, { 30, 0xFFFF, 0 } },
+    { "truncated after good record",
+      { 0x00, 0x00, 0x00, ZCL_TYPE_U16, 10, 0, 60, 0, 2, 0,
+        0x00, 0x03, 0x00, ZCL_TYPE_U8, 1 }, 15,
+      { ZCL_STATUS_MALFORMED_COMMAND }, 1, true, { 10, 60, 2 } },
+    { "block off (octet string)",
+      { 0x00, 0x04, 0x00, ZCL_TYPE_OCTET_STR, 60, 0, 0xFF, 0xFF }, 8,
+      { ZCL_STATUS_SUCCESS }, 1, true, { 10, 60, 2 } },
+    { "empty",
+      { 0 }, 0,
+      { ZCL_STATUS_SUCCESS }, 1, false, { 10, 60, 2 } },
+};
+
+static bool table_valid(const zcl_report_attr_t *attrs)
+{
+    for (size_t i = 0; i < N_ATTRS; i++) {
+        const zcl_report_attr_t *a = &attrs[i];
+        if (a->attr_id != k_default[i].attr_id || a->type != k_default[i].type
+            || a->reportable != k_default[i].reportable) {
+            return false;
+        }
+        if (!a->reportable && (a->min_interval_s || a->max_interval_s || a->reportable_change)) {
+            return false;
+        }
+        if (a->max_interval_s != ZCL_REPORT_MAX_OFF && a->max_interval_s != 0 && a->min_interval_s > a->max_interval_s) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void hex(const uint8_t *p, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        printf("%02x ", p[i]);
+    }
+}
+
+static int run_configure_cases(zcl_report_attr_t *attrs)
+{
+    int failures = 0;
+    printf("Configure Reporting\n");
+    for (size_t c = 0; c < sizeof(k_cases) / sizeof(k_cases[0]); c++) {
+        const configure_case_t *tc = &k_cases[c];
+        uint8_t out[ZCL_REPORTING_RESP_MAX];
+        bool changed;
+        size_t n = zcl_reporting_configure(attrs, N_ATTRS, tc->in, tc->in_len, out, sizeof(out), &changed);
+        bool ok = n == tc->resp_len && memcmp(out, tc->resp, n) == 0 && changed == tc->changed
+               && attrs[0].min_interval_s == tc->nh3[0] && attrs[0].max_interval_s == tc->nh3[1]
+               && attrs[0].reportable_change == tc->nh3[2] && table_valid(attrs);
+        printf("  %-30s %s  resp: ", tc->name, ok ? "ok  " : "FAIL");
+        hex(out, n);
+        printf("\n");
+        failures += !ok;
+    }
+    return failures;
+}
+
+static int run_read_config(const zcl_report_attr_t *attrs)
+{
+    static const uint8_t in[] = { 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x01, 0x00, 0x00, 0x42, 0x00 };
+    uint8_t expect[64], *p = expect;
+    /* 0x0000: u16 10/60/2 */
+    *p++ = 0x00; *p++ = 0x00; *p++ = 0x00; *p++ = 0x00;
+    *p++ = ZCL_TYPE_U16; *p++ = 10; *p++ = 0; *p++ = 60; *p++ = 0; *p++ = 2; *p++ = 0;
+    /* 0x0003: u8 1/0/1 (from the "nh3 + event" case) */
+    *p++ = 0x00; *p++ = 0x00; *p++ = 0x03; *p++ = 0x00;
+    *p++ = ZCL_TYPE_U8; *p++ = 1; *p++ = 0; *p++ = 0; *p++ = 0; *p++ = 1;
+    /* 0x0001: unreportable, 0x0042: unsupported */
+    *p++ = ZCL_STATUS_UNREPORTABLE_ATTRIBUTE; *p++ = 0x00; *p++ = 0x01; *p++ = 0x00;
+    *p++ = ZCL_STATUS_UNSUPPORTED_ATTRIBUTE; *p++ = 0x00; *p++ = 0x42; *p++ = 0x00;
+    size_t expect_len = (size_t)(p - expect);
+
+    uint8_t out[ZCL_REPORTING_RESP_MAX];
+    size_t n = zcl_reporting_read_config(attrs, N_ATTRS, in, sizeof(in), out, sizeof(out));
+    bool ok = n == expect_len && memcmp(out, expect, n) == 0;
+
+    /* A short buffer keeps whole records only */
+    size_t n_short = zcl_reporting_read_config(attrs, N_ATTRS, in, sizeof(in), out, 15);
+    ok = ok && n_short == 11;
+
+    printf("\nRead Reporting Configuration     %s  resp: ", ok ? "ok  " : "FAIL");
+    hex(out, n_short);
+    printf("(cap 15)\n");
+    return !ok;
+}
+
+static int run_nvs(const zcl_report_attr_t *attrs)
+{
+    zcl_report_attr_t loaded[N_ATTRS];
+    memcpy(loaded, k_default, sizeof(loaded));
+
+    host_nvs_erase_all();
+    bool ok = zcl_reporting_load(loaded, N_ATTRS) == ESP_ERR_NVS_NOT_FOUND
+           && memcmp(loaded, k_default, sizeof(loaded)) == 0;
+    ok = ok && zcl_reporting_save(attrs, N_ATTRS) == ESP_OK;
+    ok = ok && zcl_reporting_load(loaded, N_ATTRS) == ESP_OK && memcmp(loaded, attrs, sizeof(loaded)) == 0;
+
+    /* A firmware whose table lacks the event attribute still picks up the NH3 entry */
+    zcl_report_attr_t nh3_only = k_default[0];
+    ok = ok && zcl_reporting_load(&nh3_only, 1) == ESP_OK && nh3_only.min_interval_s == attrs[0].min_interval_s;
+
+    printf("NVS save / load                  %s  (%u write)\n", ok ? "ok  " : "FAIL", host_nvs_write_count());
+    return !ok;
+}
+
+static int run_policy_off(void)
+{
+    report_policy_cfg_t cfg = REPORT_POLICY_CFG_DEFAULT();
+    cfg.max_interval_s = REPORT_POLICY_MAX_OFF;
+    cfg.active_max_interval_s = REPORT_POLICY_MAX_OFF;
+    report_policy_t p;
+    report_policy_init(&p, &cfg);
+
+    unsigned sent = 0;
+    for (uint32_t i = 0; i < 3600; i++) {
+        sent += report_policy_update(&p, i * TRACE_TICK_MS, (uint16_t)(i % 97), (i / 300) % 2);
+    }
+    bool ok = sent == 0;
+    printf("report_policy max=0xFFFF (off)   %s  (%u reports in 2 h)\n", ok ? "ok  " : "FAIL", sent);
+    return !ok;
+}
+
+static uint32_t rnd(uint64_t *state)
+{
+    return (uint32_t)(trace_rng_uniform(state) * 4294967296.0);
+}
+
+static int run_fuzz(unsigned iters, uint32_t seed)
+{
+    uint64_t rng = seed;
+    unsigned failures = 0;
+
+    for (unsigned it = 0; it < iters; it++) {
+        zcl_report_attr_t attrs[N_ATTRS];
+        memcpy(attrs, k_default, sizeof(attrs));
+
+        /* Mostly well-formed records with random fields, sometimes plain noise */
+        uint8_t in[96];
+        size_t len = rnd(&rng) % sizeof(in);
+        for (size_t i = 0; i < len; i++) {
+            in[i] = (uint8_t)rnd(&rng);
+        }
+        if (rnd(&rng) & 1) {
+            for (size_t i = 0; i + 10 <= len; i += 10) {
+                in[i] = 0x00;
+                in[i + 1] = (uint8_t)(rnd(&rng) % 5);
+                in[i + 2] = 0x00;
+                in[i + 3] = (rnd(&rng) & 1) ? ZCL_TYPE_U16 : ZCL_TYPE_U8;
+            }
+        }
+
+        size_t cap = 1 + rnd(&rng) % ZCL_REPORTING_RESP_MAX;
+        uint8_t out[ZCL_REPORTING_RESP_MAX + 8];
+        memset(out, 0xA5, sizeof(out));
+        bool changed;
+        size_t n = zcl_reporting_configure(attrs, N_ATTRS, in, len, out, cap, &changed);
+        bool ok = n >= 1 && n <= cap && out[cap] == 0xA5 && table_valid(attrs);
+
+        memset(out, 0xA5, sizeof(out));
+        n = zcl_reporting_read_config(attrs, N_ATTRS, in, len, out, cap);
+        ok = ok && n <= cap && out[cap] == 0xA5;
+        failures += !ok;
+    }
+    printf("fuzz                             %s  (%u payloads, %u bad)\n", failures ? "FAIL" : "ok  ",
+           iters, failures);
+    return failures != 0;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "Usage: %s [--fuzz N] [--seed N]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned fuzz = 200000;
+    uint32_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--fuzz") == 0 && i + 1 < argc) {
+            fuzz = (unsigned)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    zcl_report_attr_t attrs[N_ATTRS];
+    memcpy(attrs, k_default, sizeof(attrs));
+
+    int failures = run_configure_cases(attrs);
+    failures += run_read_config(attrs);
+    failures += run_nvs(attrs);
+    failures += run_policy_off();
+    failures += run_fuzz(fuzz, seed);
+
+    printf("%s\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,254 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * sample_block_bench.c — Sample block round trip, size and airtime
+ *
+ * Streams a trace (default: 24 h synthetic) through sample_block.c the way
+ * main.c does (block closed after --period seconds, on a tick gap or when
+ * full), decodes every block with sample_block_decode() and checks the
+ * reconstructed 2 s series matches the input exactly, including failed
+ * reads (--invalid fraction) and dropped queue messages (--drop fraction).
+ * A second pass with worst-case input (full-scale swings every tick) checks
+ * blocks never exceed SAMPLE_BLOCK_MAX_BYTES, and the decoder is fuzzed
+ * with corrupted blocks.
+ *
+ * Prints blocks per day, bytes per block and per sample, and estimated
+ * airtime against one uint16 report per sample. Exits non-zero on any
+ * mismatch, or if blocks of the default period cost more than a tenth of
+ * the airtime of one report per sample.
+ *
+ * Usage: sample_block_bench [--trace FILE] [--hours H] [--seed N] [--period S]
+ *                           [--invalid F] [--drop F]
+ */
+#include "replay.h"
+#include "sample_block.h"
+#include "trace.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAME_AIR_US        1900    /* uint16 attribute report (~50 B on air), as report_bench */
+#define BYTE_AIR_US         32      /* 250 kbit/s */
+
+typedef struct {
+    uint32_t tick;
+    uint16_t value;
+} sample_t;
+
+typedef struct {
+    /* Expected series (what was handed to the encoder) and decoded series */
+    sample_t *sent, *got;
+    size_t    n_sent, n_got;
+    uint64_t  blocks, block_bytes, max_block_bytes;
+    uint32_t  seq_errors, decode_errors;
+    bool      have_seq;
+    uint8_t   next_seq;
+} run_t;
+
+static void emit(run_t *r, sample_block_t *b)
+{
+    sample_block_hdr_t hdr;
+    uint16_t values[SAMPLE_BLOCK_MAX_SAMPLES];
+    int n = sample_block_decode(b->buf, b->len, &hdr, values, SAMPLE_BLOCK_MAX_SAMPLES);
+    if (n <= 0) {
+        r->decode_errors++;
+    } else {
+        if (r->have_seq && hdr.seq != r->next_seq) {
+            r->seq_errors++;
+        }
+        r->have_seq = true;
+        r->next_seq = (uint8_t)(hdr.seq + 1);
+        for (int i = 0; i < n; i++) {
+            r->got[r->n_got++] = (sample_t){ hdr.base_tick + (uint32_t)i, values[i] };
+        }
+    }
+    r->blocks++;
+    r->block_bytes += b->len;
+    r->max_block_bytes = b->len > r->max_block_bytes ? b->len : r->max_block_bytes;
+    sample_block_reset(b);
+}
+
+/* Same control flow as sample_block_append() in main.c */
+static void append(run_t *r, sample_block_t *b, uint32_t period_samples, uint32_t tick, uint16_t value)
+{
+    r->sent[r->n_sent++] = (sample_t){ tick, value };
+    if (!sample_block_add(b, tick, value)) {
+        emit(r, b);
+        sample_block_add(b, tick, value);
+    }
+    if (b->count >= period_samples || b->count >= SAMPLE_BLOCK_MAX_SAMPLES) {
+        emit(r, b);
+    }
+}
+
+static bool finish(run_t *r, sample_block_t *b, const char *name)
+{
+    if (b->len) {
+        emit(r, b);
+    }
+    bool ok = r->n_got == r->n_sent && memcmp(r->got, r->sent, r->n_sent * sizeof(sample_t)) == 0
+           && r->decode_errors == 0 && r->seq_errors == 0 && r->max_block_bytes <= SAMPLE_BLOCK_MAX_BYTES;
+    printf("%-10s %8zu samples %7llu blocks  %5.1f B/block (max %llu)  %5.2f B/sample  round trip %s\n",
+           name, r->n_sent, (unsigned long long)r->blocks, (double)r->block_bytes / r->blocks,
+           (unsigned long long)r->max_block_bytes, (double)r->block_bytes / r->n_sent, ok ? "ok" : "FAIL");
+    return ok;
+}
+
+static void run_alloc(run_t *r, size_t n)
+{
+    memset(r, 0, sizeof(*r));
+    r->sent = calloc(n, sizeof(sample_t));
+    r->got  = calloc(n, sizeof(sample_t));
+}
+
+static void run_free(run_t *r)
+{
+    free(r->sent);
+    free(r->got);
+}
+
+/* Flip, truncate and extend real blocks; the decoder must reject or stay in bounds */
+static bool fuzz_decoder(uint64_t *rng, unsigned iters)
+{
+    sample_block_t b;
+    sample_block_init(&b, TRACE_TICK_MS);
+    uint16_t values[SAMPLE_BLOCK_MAX_SAMPLES];
+    sample_block_hdr_t hdr;
+    unsigned accepted = 0;
+
+    for (unsigned it = 0; it < iters; it++) {
+        sample_block_reset(&b);
+        uint32_t n = 1 + (uint32_t)(trace_rng_uniform(rng) * SAMPLE_BLOCK_MAX_SAMPLES);
+        uint16_t v = (uint16_t)(trace_rng_uniform(rng) * 65536);
+        for (uint32_t i = 0; i < n; i++) {
+            v = (uint16_t)(v + (int)(trace_rng_normal(rng) * 40));
+            if (!sample_block_add(&b, 100 + i, v)) {
+                break;
+            }
+        }
+        uint8_t buf[SAMPLE_BLOCK_MAX_BYTES + 8];
+        size_t len = b.len;
+        memcpy(buf, b.buf, len);
+        int flips = (int)(trace_rng_uniform(rng) * 4);
+        for (int f = 0; f < flips; f++) {
+            buf[(size_t)(trace_rng_uniform(rng) * len)] ^= (uint8_t)(1u << (int)(trace_rng_uniform(rng) * 8));
+        }
+        double cut = trace_rng_uniform(rng);
+        if (cut < 0.2) {
+            len = (size_t)(trace_rng_uniform(rng) * len);
+        } else if (cut < 0.3) {
+            buf[len++] = (uint8_t)(trace_rng_uniform(rng) * 256);
+        }
+
+        size_t cap = 1 + (size_t)(trace_rng_uniform(rng) * SAMPLE_BLOCK_MAX_SAMPLES);
+        int got = sample_block_decode(buf, len, &hdr, values, cap);
+        if (got > (int)cap || got == 0) {
+            printf("fuzz: decoder returned %d for cap %zu\n", got, cap);
+            return false;
+        }
+        accepted += got > 0;
+    }
+    printf("fuzz       %u corrupted blocks, %u decoded in bounds, rest rejected  ok\n", iters, accepted);
+    return true;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [--trace FILE] [--hours H] [--seed N] [--period S]\n"
+            "          [--invalid F] [--drop F]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *trace_path = NULL;
+    trace_synth_cfg_t synth = trace_synth_default();
+    uint32_t period_s = CONFIG_LITTERBOX_SAMPLE_BLOCK_S;
+    double invalid_frac = 0.001, drop_frac = 0.001;
+
+    synth.hours = 24.0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (strcmp(argv[i], "--hours") == 0 && i + 1 < argc) {
+            synth.hours = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            synth.seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--period") == 0 && i + 1 < argc) {
+            period_s = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--invalid") == 0 && i + 1 < argc) {
+            invalid_frac = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--drop") == 0 && i + 1 < argc) {
+            drop_frac = atof(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    trace_t t;
+    bool loaded = trace_path ? (trace_load_csv(&t, trace_path) && replay_convert_raw(&t))
+                             : trace_synthesize(&t, &synth);
+    if (!loaded || t.count < 2) {
+        fprintf(stderr, "No trace\n");
+        return 1;
+    }
+
+    uint32_t period_samples = period_s * 1000u / TRACE_TICK_MS;
+    uint64_t rng = synth.seed ? synth.seed : 1;
+    bool ok = true;
+
+    /* Trace pass: 0.1 ppm, as main.c rounds ppm_q */
+    run_t r;
+    run_alloc(&r, t.count);
+    sample_block_t b;
+    sample_block_init(&b, TRACE_TICK_MS);
+    for (size_t i = 0; i < t.count; i++) {
+        if (trace_rng_uniform(&rng) < drop_frac) {
+            continue;       /* Queue overflow: the tick never reaches the Zigbee side */
+        }
+        long dppm = lround(t.samples[i].ppm * 10.0);
+        uint16_t value = dppm < 0 ? 0 : dppm >= SAMPLE_BLOCK_INVALID ? SAMPLE_BLOCK_INVALID - 1 : (uint16_t)dppm;
+        if (trace_rng_uniform(&rng) < invalid_frac) {
+            value = SAMPLE_BLOCK_INVALID;
+        }
+        append(&r, &b, period_samples, (uint32_t)i, value);
+    }
+    printf("%s: %.1f h, block period %u s (%u samples), %.2f%% invalid, %.2f%% dropped\n\n",
+           trace_path ? trace_path : "synthetic", t.count * TRACE_TICK_MS / 3600000.0, period_s, period_samples,
+           100.0 * invalid_frac, 100.0 * drop_frac);
+    ok &= finish(&r, &b, "trace");
+
+    double days = (double)t.count * TRACE_TICK_MS / 86400000.0;
+    double block_air = r.blocks * (double)FRAME_AIR_US + (r.block_bytes + r.blocks - 2.0 * r.blocks) * BYTE_AIR_US;
+    double per_sample_air = (double)r.n_sent * FRAME_AIR_US;
+    double air_per_block = block_air / r.blocks;
+    printf("\n%-22s %10s %12s\n", "", "frames/d", "air ms/d");
+    printf("%-22s %10.0f %12.0f\n", "one report per sample", r.n_sent / days, per_sample_air / 1000.0 / days);
+    printf("%-22s %10.0f %12.0f\n", "sample blocks", r.blocks / days, block_air / 1000.0 / days);
+    printf("airtime per block: %.0f us = %.2f× one single-sample report, for %.1f samples\n\n",
+           air_per_block, air_per_block / FRAME_AIR_US, (double)r.n_sent / r.blocks);
+    if (period_s == CONFIG_LITTERBOX_SAMPLE_BLOCK_S && block_air > 0.1 * per_sample_air) {
+        ok = false;
+    }
+    size_t n_trace = r.n_sent;
+    run_free(&r);
+
+    /* Worst case: full-scale swing every tick (3-byte deltas) */
+    run_alloc(&r, n_trace);
+    sample_block_init(&b, TRACE_TICK_MS);
+    for (uint32_t i = 0; i < n_trace; i++) {
+        append(&r, &b, SAMPLE_BLOCK_MAX_SAMPLES, i, (i & 1) ? SAMPLE_BLOCK_INVALID : 0);
+    }
+    ok &= finish(&r, &b, "worst case");
+    run_free(&r);
+
+    ok &= fuzz_decoder(&rng, 200000);
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    trace_free(&t);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,410 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * snippet_bench.c — Pre-trigger event snippets: capture, transfer, bounds
+ *
+ * Replays a trace (default: 72 h synthetic) through the detector and feeds
+ * every sample to event_snippet.c the way main.c does, with failed reads
+ * (--invalid fraction) and sample queue messages lost before the Zigbee
+ * task (--drop fraction). A hub model learns of each finished snippet from
+ * its info record and pulls it with Get Snippet Fragment requests over a
+ * link that loses --loss of frames each way, FETCH_PER_TICK attempts per
+ * 2 s tick, while sampling goes on. Every snippet is decoded and checked
+ * against the sample series: pre-trigger length, values, trigger tick,
+ * end on the first non-ACTIVE sample and the event type it carried.
+ *
+ * Then a 12 h ACTIVE phase checks the bound (RAM fixed, snippet truncated
+ * and flagged, event type still recorded) and that a transfer survives
+ * the next event's onset, and the decoder is fuzzed.
+ *
+ * Prints snippets per day, bytes per snippet and per sample, fragments and
+ * time to fetch, RAM and the cost per sample. Exits non-zero on any
+ * mismatch or a snippet the hub could not fetch.
+ *
+ * Usage: snippet_bench [--trace FILE] [--hours H] [--seed N] [--loss F]
+ *                      [--invalid F] [--drop F]
+ */
+#include "bench_clock.h"
+#include "esp_log.h"
+#include "event_detector.h"
+#include "event_snippet.h"
+#include "replay.h"
+#include "trace.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FETCH_PER_TICK      4           /* Request attempts per 2 s tick (500 ms timeout) */
+#define HUB_QUEUE           8
+#define SNIPPET_VALUES_MAX  (EVENT_SNIPPET_MAX_BYTES)   /* ≥ 1 byte per delta */
+
+static uint64_t g_rng;
+
+static uint16_t dppm(float ppm)
+{
+    long v = lround(ppm * 10.0);
+    return (uint16_t)(v < 0 ? 0 : v >= 0xFFFF ? 0xFFFE : v);
+}
+
+/* ── Hub ────────────────────────────────────────────────────────────── */
+
+typedef struct {
+    event_snippet_info_t queue[HUB_QUEUE];  /* Announced, not yet fetched */
+    size_t   n_queue;
+    uint8_t  buf[EVENT_SNIPPET_MAX_BYTES];
+    uint16_t got;                           /* Bytes of queue[0] fetched */
+    uint32_t started_tick;
+    uint64_t requests, responses, fetched, lost, bad;
+    uint64_t fetch_ticks, fetch_ticks_max;
+    uint64_t bytes, samples;
+} hub_t;
+
+typedef struct {
+    const uint16_t *series;     /* Value the Zigbee task saw per tick (INVALID if dropped) */
+    const uint8_t  *state;      /* Detector state after each tick */
+    const uint8_t  *event;
+    uint16_t        pre_len;
+    uint32_t        mismatches;
+} oracle_t;
+
+/* The snippet against the series it was cut from */
+static bool snippet_check(oracle_t *o, const uint8_t *p, size_t len)
+{
+    static uint16_t values[SNIPPET_VALUES_MAX];
+    event_snippet_hdr_t hdr;
+    int n = event_snippet_decode(p, len, &hdr, values, SNIPPET_VALUES_MAX);
+    if (n <= 0) {
+        return false;
+    }
+    uint32_t t0 = hdr.trigger_tick;
+    uint32_t pre = t0 < o->pre_len ? t0 : o->pre_len;
+    bool ok = hdr.pre_count == pre && (uint32_t)n > pre && o->state[t0] == DETECTOR_ACTIVE
+           && (t0 == 0 || o->state[t0 - 1] != DETECTOR_ACTIVE || o->series[t0 - 1] == EVENT_SNIPPET_INVALID);
+    for (int i = 0; i < n && ok; i++) {
+        ok = values[i] == o->series[t0 - pre + (uint32_t)i];
+    }
+    uint32_t end = t0 - pre + (uint32_t)n - 1;
+    if (ok && !(hdr.flags & EVENT_SNIPPET_FLAG_TRUNCATED)) {
+        /* ACTIVE throughout (missing ticks aside), ends on the first sample after it */
+        for (uint32_t t = t0; t < end && ok; t++) {
+            ok = o->state[t] == DETECTOR_ACTIVE || o->series[t] == EVENT_SNIPPET_INVALID;
+        }
+        ok = ok && o->state[end] != DETECTOR_ACTIVE && hdr.event == o->event[end];
+    }
+    o->mismatches += !ok;
+    return ok;
+}
+
+static void hub_announce(hub_t *h, const event_snippet_info_t *info, uint32_t tick)
+{
+    if (h->n_queue == HUB_QUEUE) {
+        h->lost++;
+        return;
+    }
+    if (h->n_queue == 0) {
+        h->got = 0;
+        h->started_tick = tick;
+    }
+    h->queue[h->n_queue++] = *info;
+}
+
+static void hub_next(hub_t *h, uint32_t tick)
+{
+    memmove(&h->queue[0], &h->queue[1], --h->n_queue * sizeof(h->queue[0]));
+    h->got = 0;
+    h->started_tick = tick;
+}
+
+/* Up to FETCH_PER_TICK request/response exchanges with the device */
+static void hub_fetch(hub_t *h, const event_snippet_t *dev, oracle_t *o, double loss, uint32_t tick)
+{
+    for (int k = 0; k < FETCH_PER_TICK && h->n_queue; k++) {
+        const event_snippet_info_t *want = &h->queue[0];
+        uint8_t req[4] = { (uint8_t)want->seq, (uint8_t)(want->seq >> 8), (uint8_t)h->got, (uint8_t)(h->got >> 8) };
+        h->requests++;
+        if (trace_rng_uniform(&g_rng) < loss) {
+            continue;
+        }
+        uint8_t resp[EVENT_SNIPPET_FRAGMENT_HDR + EVENT_SNIPPET_FRAGMENT_BYTES];
+        size_t n = event_snippet_fragment(dev, req, sizeof(req), resp);
+        if (n == 0 || trace_rng_uniform(&g_rng) < loss) {
+            continue;
+        }
+        h->responses++;
+        uint16_t seq = (uint16_t)(resp[1] | (resp[2] << 8));
+        uint16_t off = (uint16_t)(resp[3] | (resp[4] << 8));
+        uint16_t len = (uint16_t)(resp[5] | (resp[6] << 8));
+        if (resp[0] != EVENT_SNIPPET_STATUS_OK || seq != want->seq || len != want->len) {
+            h->lost++;          /* Overwritten before the hub got to it */
+            hub_next(h, tick);
+            continue;
+        }
+        if (off != h->got) {
+            continue;
+        }
+        memcpy(&h->buf[off], &resp[EVENT_SNIPPET_FRAGMENT_HDR], n - EVENT_SNIPPET_FRAGMENT_HDR);
+        h->got = (uint16_t)(h->got + n - EVENT_SNIPPET_FRAGMENT_HDR);
+        if (h->got == len) {
+            if (snippet_check(o, h->buf, len)) {
+                h->fetched++;
+                h->bytes += len;
+                h->samples += want->count;
+            } else {
+                h->bad++;
+            }
+            uint64_t took = tick - h->started_tick + 1;
+            h->fetch_ticks += took;
+            h->fetch_ticks_max = took > h->fetch_ticks_max ? took : h->fetch_ticks_max;
+            hub_next(h, tick);
+        }
+    }
+}
+
+/* ── Trace run ──────────────────────────────────────────────────────── */
+
+static bool trace_run(const trace_t *t, double loss, double invalid, double drop)
+{
+    static event_snippet_t snip;
+    static hub_t hub;
+    uint16_t *series = malloc(t->count * sizeof(*series));
+    uint8_t  *state  = malloc(t->count);
+    uint8_t  *event  = malloc(t->count);
+    if (!series || !state || !event) {
+        free(series);
+        free(state);
+        free(event);
+        return false;
+    }
+
+    event_snippet_init(&snip, TRACE_TICK_MS);
+    memset(&hub, 0, sizeof(hub));
+    oracle_t o = { series, state, event, snip.pre_len, 0 };
+    event_detector_t det;
+    event_detector_init(&det);
+
+    uint64_t events = 0, add_ns = 0, delivered = 0;
+    uint8_t prev_state = DETECTOR_IDLE;
+    for (size_t i = 0; i < t->count; i++) {
+        /* Sampling side: failed reads hold the detector, as sensor_sample() */
+        bool valid = trace_rng_uniform(&g_rng) >= invalid;
+        if (valid) {
+            event_detector_update(&det, t->samples[i].ppm);
+        }
+        uint16_t value = valid ? dppm(t->samples[i].ppm) : EVENT_SNIPPET_INVALID;
+        state[i] = (uint8_t)det.state;
+        event[i] = (uint8_t)det.current_event;
+        events += prev_state == DETECTOR_ACTIVE && det.state != DETECTOR_ACTIVE;
+        prev_state = (uint8_t)det.state;
+
+        /* Zigbee side: the queue message may not arrive */
+        bool dropped = trace_rng_uniform(&g_rng) < drop;
+        series[i] = dropped ? EVENT_SNIPPET_INVALID : value;
+        if (!dropped) {
+            uint64_t t0 = bench_now_ns();
+            bool done = event_snippet_add(&snip, (uint32_t)i, value, state[i], event[i], dppm(det.baseline_ppm));
+            add_ns += bench_now_ns() - t0;
+            delivered++;
+            if (done) {
+                /* The hub works from the info record as reported (attribute 0x0006) */
+                uint8_t rec[EVENT_SNIPPET_INFO_BYTES];
+                event_snippet_info_t info;
+                size_t len = event_snippet_info_encode(&snip, rec);
+                if (event_snippet_info_decode(rec, len, &info)) {
+                    hub_announce(&hub, &info, (uint32_t)i);
+                } else {
+                    hub.bad++;
+                }
+            }
+        }
+        hub_fetch(&hub, &snip, &o, loss, (uint32_t)i);
+    }
+    for (uint32_t k = 0; k < 1000 && hub.n_queue; k++) {
+        hub_fetch(&hub, &snip, &o, loss, (uint32_t)(t->count + k));
+    }
+
+    /* Cost of serving a fragment */
+    uint8_t req[4] = { 0xFF, 0xFF, 0, 0 }, resp[EVENT_SNIPPET_FRAGMENT_HDR + EVENT_SNIPPET_FRAGMENT_BYTES];
+    uint64_t t0 = bench_now_ns();
+    const int reps = 100000;
+    volatile size_t sink = 0;
+    for (int r = 0; r < reps; r++) {
+        req[2] = (uint8_t)(r % 3 * EVENT_SNIPPET_FRAGMENT_BYTES);     /* Within the smallest snippet */
+        sink += event_snippet_fragment(&snip, req, sizeof(req), resp);
+    }
+    double frag_ns = (double)(bench_now_ns() - t0) / reps;
+
+    double days = (double)t->count * TRACE_TICK_MS / 86400000.0;
+    bool ok = hub.fetched == snip.captured && hub.lost == 0 && hub.bad == 0 && o.mismatches == 0
+           && snip.captured > 0 && snip.captured <= events && snip.captured + 2 >= events;
+    printf("%llu events, %u snippets (%.1f/d), %u truncated, pre-trigger %u samples (%d s)\n",
+           (unsigned long long)events, snip.captured, snip.captured / days, snip.truncated, snip.pre_len,
+           snip.pre_len * TRACE_TICK_MS / 1000);
+    printf("  fetched %llu/%u %s, %llu lost, %.0f B/snippet (%.2f B/sample), max %d B\n",
+           (unsigned long long)hub.fetched, snip.captured, hub.bad || o.mismatches ? "MISMATCH" : "exact",
+           (unsigned long long)hub.lost, hub.fetched ? (double)hub.bytes / hub.fetched : 0.0,
+           hub.samples ? (double)hub.bytes / hub.samples : 0.0, EVENT_SNIPPET_MAX_BYTES);
+    printf("  %llu requests, %llu responses, fetch %.1f s avg / %.0f s max while sampling\n",
+           (unsigned long long)hub.requests, (unsigned long long)hub.responses,
+           hub.fetched ? (double)hub.fetch_ticks / hub.fetched * TRACE_TICK_MS / 1000.0 : 0.0,
+           (double)hub.fetch_ticks_max * TRACE_TICK_MS / 1000.0);
+    printf("  %.0f ns/sample (add), %.0f ns/fragment\n", delivered ? (double)add_ns / delivered : 0.0, frag_ns);
+    free(series);
+    free(state);
+    free(event);
+    return ok;
+}
+
+/* ── Bound ──────────────────────────────────────────────────────────── */
+
+static bool long_event_run(void)
+{
+    static event_snippet_t s;
+    static uint16_t values[SNIPPET_VALUES_MAX];
+    event_snippet_init(&s, TRACE_TICK_MS);
+    const uint32_t idle = 100, active = 12 * 3600 * 1000 / TRACE_TICK_MS;
+    uint32_t tick = 0;
+    uint16_t v = 50;
+    bool ok = true;
+
+    for (; tick < idle; tick++) {
+        ok &= !event_snippet_add(&s, tick, v, DETECTOR_IDLE, LITTER_EVENT_NONE, 50);
+    }
+    for (; tick < idle + active; tick++) {
+        v = (uint16_t)(300 + (int)(trace_rng_normal(&g_rng) * 40));     /* ~2 B per delta */
+        ok &= !event_snippet_add(&s, tick, v, DETECTOR_ACTIVE, LITTER_EVENT_NONE, 50);
+    }
+    ok &= event_snippet_add(&s, tick++, 60, DETECTOR_COOLDOWN, LITTER_EVENT_DEFECATION, 50);
+
+    event_snippet_info_t info;
+    ok &= event_snippet_latest(&s, &info);
+    const event_snippet_slot_t *slot = &s.slot[s.latest];
+    event_snippet_hdr_t hdr;
+    int n = event_snippet_decode(slot->buf, slot->len, &hdr, values, SNIPPET_VALUES_MAX);
+    ok &= n > 0 && (hdr.flags & EVENT_SNIPPET_FLAG_TRUNCATED) && hdr.event == LITTER_EVENT_DEFECATION
+       && slot->len <= EVENT_SNIPPET_MAX_BYTES && hdr.pre_count == s.pre_len && s.truncated == 1;
+    uint16_t kept = slot->len;
+
+    /* The next onset must not touch the finished snippet being fetched */
+    uint8_t req[4] = { (uint8_t)info.seq, (uint8_t)(info.seq >> 8), 0, 0 };
+    uint8_t resp[EVENT_SNIPPET_FRAGMENT_HDR + EVENT_SNIPPET_FRAGMENT_BYTES];
+    for (uint32_t k = 0; k < 500; k++, tick++) {
+        event_snippet_add(&s, tick, 400, DETECTOR_ACTIVE, LITTER_EVENT_NONE, 50);
+        uint16_t off = (uint16_t)(k % 8 * EVENT_SNIPPET_FRAGMENT_BYTES);
+        req[2] = (uint8_t)off;
+        req[3] = (uint8_t)(off >> 8);
+        ok &= event_snippet_fragment(&s, req, sizeof(req), resp) > EVENT_SNIPPET_FRAGMENT_HDR
+           && resp[0] == EVENT_SNIPPET_STATUS_OK
+           && memcmp(&resp[EVENT_SNIPPET_FRAGMENT_HDR], &slot->buf[off], EVENT_SNIPPET_FRAGMENT_BYTES) == 0;
+    }
+    /* Once that one has finished, the onset after it reuses the old slot */
+    event_snippet_add(&s, tick++, 60, DETECTOR_COOLDOWN, LITTER_EVENT_URINATION, 50);
+    event_snippet_add(&s, tick++, 400, DETECTOR_ACTIVE, LITTER_EVENT_NONE, 50);
+    req[2] = req[3] = 0;
+    ok &= event_snippet_fragment(&s, req, sizeof(req), resp) == EVENT_SNIPPET_FRAGMENT_HDR
+       && resp[0] == EVENT_SNIPPET_STATUS_NOT_FOUND;
+
+    printf("long event: %u h ACTIVE → %d of %u samples kept in %u B, truncated %s, event %u%s\n",
+           active * TRACE_TICK_MS / 3600000, n, idle < s.pre_len ? idle + active : s.pre_len + active,
+           kept, (hdr.flags & EVENT_SNIPPET_FLAG_TRUNCATED) ? "yes" : "no", hdr.event, ok ? "" : "  FAIL");
+    printf("bounds: RAM %zu B (event_snippet_t: ring %zu B + %d × %d B), fragment ≤ %d B\n",
+           sizeof(event_snippet_t), sizeof(s.pre), EVENT_SNIPPET_SLOTS, EVENT_SNIPPET_MAX_BYTES,
+           EVENT_SNIPPET_FRAGMENT_HDR + EVENT_SNIPPET_FRAGMENT_BYTES);
+    return ok;
+}
+
+static bool fuzz_decoder(unsigned iters)
+{
+    static event_snippet_t s;
+    static uint16_t values[SNIPPET_VALUES_MAX];
+    unsigned rejected_cuts = 0, cuts = 0;
+    bool ok = true;
+
+    for (unsigned it = 0; it < iters && ok; it++) {
+        event_snippet_init(&s, TRACE_TICK_MS);
+        uint32_t n = 2 + (uint32_t)(trace_rng_uniform(&g_rng) * 200);
+        uint16_t v = (uint16_t)(trace_rng_uniform(&g_rng) * 65536);
+        uint32_t tick = 0;
+        for (; tick < 40; tick++) {
+            event_snippet_add(&s, tick, v, DETECTOR_IDLE, 0, 0);
+        }
+        for (uint32_t i = 0; i < n; i++, tick++) {
+            v = (uint16_t)(v + (int)(trace_rng_normal(&g_rng) * 400));
+            event_snippet_add(&s, tick, v, DETECTOR_ACTIVE, 0, 0);
+        }
+        event_snippet_add(&s, tick, v, DETECTOR_COOLDOWN, 1, 0);
+        const event_snippet_slot_t *slot = &s.slot[s.latest];
+        event_snippet_hdr_t hdr;
+        ok &= event_snippet_decode(slot->buf, slot->len, &hdr, values, SNIPPET_VALUES_MAX) > 0;
+
+        /* Every cut is rejected; random corruption must not crash */
+        uint8_t buf[EVENT_SNIPPET_MAX_BYTES];
+        size_t cut = (size_t)(trace_rng_uniform(&g_rng) * slot->len);
+        cuts++;
+        rejected_cuts += event_snippet_decode(slot->buf, cut, &hdr, values, SNIPPET_VALUES_MAX) < 0;
+        memcpy(buf, slot->buf, slot->len);
+        buf[(size_t)(trace_rng_uniform(&g_rng) * slot->len)] ^= (uint8_t)(1 + trace_rng_uniform(&g_rng) * 255);
+        event_snippet_decode(buf, slot->len, &hdr, values, SNIPPET_VALUES_MAX);
+    }
+    ok &= rejected_cuts == cuts;
+    printf("fuzz: %u snippets, %u/%u truncated copies rejected%s\n", iters, rejected_cuts, cuts, ok ? "" : "  FAIL");
+    return ok;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [--trace FILE] [--hours H] [--seed N] [--loss F]\n"
+            "          [--invalid F] [--drop F]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *trace_path = NULL;
+    trace_synth_cfg_t synth = trace_synth_default();
+    double loss = 0.1, invalid = 0.001, drop = 0.001;
+
+    synth.hours = 72.0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (strcmp(argv[i], "--hours") == 0 && i + 1 < argc) {
+            synth.hours = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            synth.seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--loss") == 0 && i + 1 < argc) {
+            loss = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--invalid") == 0 && i + 1 < argc) {
+            invalid = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--drop") == 0 && i + 1 < argc) {
+            drop = atof(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    trace_t t;
+    bool loaded = trace_path ? (trace_load_csv(&t, trace_path) && replay_convert_raw(&t))
+                             : trace_synthesize(&t, &synth);
+    if (!loaded || t.count < 2) {
+        fprintf(stderr, "No trace\n");
+        return 1;
+    }
+    host_log_set_level(ESP_LOG_ERROR);
+    g_rng = synth.seed ? synth.seed : 1;
+
+    printf("%s: %.1f h, %.0f%% loss each way, %.2f%% invalid, %.2f%% dropped, snippet ≤ %d B\n",
+           trace_path ? trace_path : "synthetic", t.count * TRACE_TICK_MS / 3600000.0, 100.0 * loss,
+           100.0 * invalid, 100.0 * drop, EVENT_SNIPPET_MAX_BYTES);
+
+    bool ok = trace_run(&t, loss, invalid, drop);
+    ok &= long_event_run();
+    ok &= fuzz_decoder(20000);
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    trace_free(&t);
+    return ok ? 0 : 1;
+}
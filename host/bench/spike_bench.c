@@ -0,0 +1,343 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * spike_bench.c — Host check and benchmark for spike_filter (streaming Hampel)
+ *
+ *  - verifies every output against a brute-force Hampel (sort the window,
+ *    median, sort the deviations, MAD) for windows 3..SPIKE_FILTER_MAX_WINDOW
+ *    (exact match expected — integer arithmetic)
+ *  - reports ns and cycles per sample for each window
+ *  - replays labelled traces (default: four 7-day synthetic ones) with
+ *    injected bad readings — 1–2 tick bursts of heater current spikes
+ *    (+50..500 ppm) and v_adc floor clamps (≈0 ppm) — through both onset
+ *    engines, without and with the filter, next to the clean trace
+ *
+ * Exits non-zero unless the filter matches the reference, removes at least
+ * FP_REMOVED_MIN of the false triggers the spikes add, keeps recall within
+ * RECALL_TOL of the clean trace, adds no more than (N−1)/2 ticks to the
+ * median trigger latency and never fires on the clean trace.
+ *
+ * Usage: spike_bench [--trace FILE]... [--hours H] [--seed N]
+ *                    [--spikes-per-day R] [--window N]
+ */
+#include "air_sensor_driver.h"
+#include "bench_clock.h"
+#include "event_detector.h"
+#include "replay.h"
+#include "spike_filter.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_TRACES      16
+#define FP_REMOVED_MIN  0.90
+#define RECALL_TOL      0.02
+#define TIMING_SAMPLES  2000000
+#define CHECK_SAMPLES   200000
+
+#define MIN_DEV_Q       ((int32_t)SPIKE_FILTER_MIN_DEV_PPM << EVENT_PPM_Q_SHIFT)
+
+/* ── Reference ──────────────────────────────────────────────────────── */
+
+static int cmp_i32(const void *a, const void *b)
+{
+    int32_t x = *(const int32_t *)a, y = *(const int32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* Brute-force Hampel on the newest `n` readings ending at v[i] */
+static bool reference(const int32_t *v, size_t i, int n, int32_t *out)
+{
+    int32_t w[SPIKE_FILTER_MAX_WINDOW], d[SPIKE_FILTER_MAX_WINDOW];
+    memcpy(w, &v[i + 1 - n], n * sizeof(*w));
+    qsort(w, n, sizeof(*w), cmp_i32);
+    int32_t med = w[n / 2];
+    for (int k = 0; k < n; k++) {
+        d[k] = w[k] > med ? w[k] - med : med - w[k];
+    }
+    qsort(d, n, sizeof(*d), cmp_i32);
+    int64_t thr = (int64_t)d[n / 2] * SPIKE_FILTER_K_TENTHS * 14826 / 100000;
+    if (thr < MIN_DEV_Q) {
+        thr = MIN_DEV_Q;
+    }
+    int64_t dev = (int64_t)v[i] - med;
+    *out = (dev > thr || -dev > thr) ? med : v[i];
+    return *out != v[i];
+}
+
+/* Noisy baseline with frequent bursts and ties (quantised to 1/64 ppm) */
+static int32_t *test_stream(size_t n)
+{
+    int32_t *v = malloc(n * sizeof(*v));
+    uint64_t rng = 11;
+    for (size_t i = 0; v && i < n; i++) {
+        double ppm = 5.0 + 0.3 * trace_rng_normal(&rng);
+        double u = trace_rng_uniform(&rng);
+        if (u < 0.02) {
+            ppm += 50.0 + 450.0 * trace_rng_uniform(&rng);
+        } else if (u < 0.03) {
+            ppm = 0.0;
+        } else if (u < 0.05) {
+            ppm += 8.0 * trace_rng_normal(&rng);
+        }
+        v[i] = (int32_t)(ppm * 64.0 + 0.5) << (EVENT_PPM_Q_SHIFT - 6);
+    }
+    return v;
+}
+
+static bool check_reference(const int32_t *v, size_t n)
+{
+    bool ok = true;
+    for (int w = 3; w <= SPIKE_FILTER_MAX_WINDOW; w += 2) {
+        spike_filter_t f;
+        spike_filter_init(&f, (uint8_t)w, SPIKE_FILTER_K_TENTHS, MIN_DEV_Q);
+        size_t mismatches = 0, rejected = 0;
+        for (size_t i = 0; i < n; i++) {
+            int32_t out, ref = v[i];
+            bool r = spike_filter_push(&f, v[i], &out);
+            bool rr = i + 1 >= (size_t)w ? reference(v, i, w, &ref) : false;
+            mismatches += (r != rr || out != ref);
+            rejected += r;
+        }
+        printf("  N=%d  %zu samples, %zu rejected, mismatches vs brute force: %zu\n", w, n, rejected, mismatches);
+        ok &= mismatches == 0;
+    }
+    return ok;
+}
+
+static void bench_timing(const int32_t *v, size_t n)
+{
+    for (int w = 3; w <= SPIKE_FILTER_MAX_WINDOW; w += 2) {
+        spike_filter_t f;
+        spike_filter_init(&f, (uint8_t)w, SPIKE_FILTER_K_TENTHS, MIN_DEV_Q);
+        volatile int32_t sink = 0;
+        int32_t out;
+        uint64_t t0 = bench_now_ns(), c0 = bench_cycles();
+        for (size_t i = 0; i < n; i++) {
+            spike_filter_push(&f, v[i], &out);
+            sink += out;
+        }
+        uint64_t c1 = bench_cycles(), t1 = bench_now_ns();
+        (void)sink;
+        printf("  N=%d  %6.1f ns/sample  %6.1f cycles/sample  (%zu B state)\n", w,
+               (double)(t1 - t0) / n, (double)(c1 - c0) / n, sizeof(f));
+    }
+}
+
+/* ── Replay ─────────────────────────────────────────────────────────── */
+
+/* Copy of t with bad readings injected at `per_day` bursts per day */
+static bool inject_spikes(const trace_t *t, trace_t *out, double per_day, uint32_t seed, size_t *bursts)
+{
+    uint64_t rng = 0x9E3779B97F4A7C15ull ^ seed;
+    double p = per_day * TRACE_TICK_MS / 86400000.0;
+    trace_init(out, t->name);
+    out->has_ppm   = true;
+    out->has_label = t->has_label;
+    *bursts = 0;
+    size_t left = 0;
+    float  bad  = 0.0f;
+    for (size_t i = 0; i < t->count; i++) {
+        trace_sample_t s = t->samples[i];
+        if (left == 0 && trace_rng_uniform(&rng) < p) {
+            left = trace_rng_uniform(&rng) < 0.8 ? 1 : 2;
+            bad  = trace_rng_uniform(&rng) < 0.6 ? (float)(50.0 + 450.0 * trace_rng_uniform(&rng)) : 0.0f;
+            (*bursts)++;
+        }
+        if (left) {
+            s.ppm = bad > 0.0f ? s.ppm + bad : 0.0f;
+            left--;
+        }
+        if (!trace_push(out, &s)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+typedef struct {
+    replay_score_t score;
+    uint32_t       rejected;
+} run_t;
+
+/* Float back-end on the Q10.6 reading air_sensor_read() hands to main.c, through the filter if `window` */
+static void run(const trace_t *t, const event_detector_config_t *cfg, int window, run_t *r)
+{
+    event_detector_t det;
+    spike_filter_t   f;
+    event_detector_init_with_config(&det, cfg);
+    if (window) {
+        spike_filter_init(&f, (uint8_t)window, SPIKE_FILTER_K_TENTHS, MIN_DEV_Q);
+    }
+    for (size_t i = 0; i < t->count; i++) {
+        uint16_t q6    = (uint16_t)(t->samples[i].ppm * (1 << AIR_SENSOR_PPM_Q_SHIFT) + 0.5f);
+        float    ppm   = q6 / (float)(1 << AIR_SENSOR_PPM_Q_SHIFT);
+        int32_t  ppm_q = (int32_t)q6 << (EVENT_PPM_Q_SHIFT - AIR_SENSOR_PPM_Q_SHIFT);
+        if (window && spike_filter_push(&f, ppm_q, &ppm_q)) {
+            ppm = (float)ppm_q / (1 << EVENT_PPM_Q_SHIFT);
+            r->rejected++;
+        }
+        detector_state_t before = det.state;
+        litter_event_t   out    = event_detector_update(&det, ppm);
+        replay_score_tick(&r->score, t->samples[i].label, before == DETECTOR_IDLE && det.state == DETECTOR_ACTIVE, out);
+    }
+}
+
+typedef struct {
+    const char *name;
+    const trace_t *traces;
+    int         window;
+} case_t;
+
+static void summarize(const case_t *c, int n_traces, const event_detector_config_t *cfg, replay_summary_t *sum,
+                      uint32_t *rejected)
+{
+    run_t r = {0};
+    replay_score_init(&r.score);
+    for (int i = 0; i < n_traces; i++) {
+        run(&c->traces[i], cfg, c->window, &r);
+    }
+    replay_summarize(&r.score, TRACE_TICK_MS, sum);
+    replay_score_free(&r.score);
+    *rejected = r.rejected;
+}
+
+static bool replay_engine(const char *engine, const event_detector_config_t *cfg, const trace_t *clean,
+                          const trace_t *spiky, int n_traces, int window)
+{
+    const case_t cases[4] = {
+        { "clean",            clean, 0 },
+        { "clean + filter",   clean, window },
+        { "spikes",           spiky, 0 },
+        { "spikes + filter",  spiky, window },
+    };
+    replay_summary_t s[4];
+    uint32_t rejected[4];
+    printf("== %s onset engine ==\n", engine);
+    printf("  %-16s %8s %8s %8s %9s %9s %9s\n", "", "FP/day", "recall", "correct", "trig med", "trig max", "rejected");
+    for (int k = 0; k < 4; k++) {
+        summarize(&cases[k], n_traces, cfg, &s[k], &rejected[k]);
+        double days = s[k].hours / 24.0;
+        printf("  %-16s %8.2f %7.1f%% %4u/%-3u %7.0f s %7.0f s %9u\n", cases[k].name,
+               days > 0 ? s[k].false_positives / days : 0.0, s[k].recall * 100.0,
+               s[k].type[0].correct, s[k].type[0].events,
+               s[k].type[0].trigger_median_s, s[k].type[0].trigger_max_s, rejected[k]);
+    }
+
+    uint32_t added   = s[2].false_positives > s[0].false_positives ? s[2].false_positives - s[0].false_positives : 0;
+    uint32_t left    = s[3].false_positives > s[0].false_positives ? s[3].false_positives - s[0].false_positives : 0;
+    double   removed = added ? 1.0 - (double)left / added : 1.0;
+    double   delay_s = s[3].type[0].trigger_median_s - s[0].type[0].trigger_median_s;
+    double   delay_max_s = (window - 1) / 2 * TRACE_TICK_MS / 1000.0;
+    bool ok = removed >= FP_REMOVED_MIN && s[3].recall >= s[0].recall - RECALL_TOL
+           && delay_s <= delay_max_s && rejected[1] == 0;
+    printf("  false triggers from spikes: %u, left with the filter: %u (%.0f%% removed)\n", added, left,
+           removed * 100.0);
+    printf("  recall %.1f%% → %.1f%%, median trigger %+.0f s, clean trace untouched: %s\n",
+           s[0].recall * 100.0, s[3].recall * 100.0, delay_s, rejected[1] == 0 ? "yes" : "NO");
+    printf("  ≥ %.0f%% removed, recall within %.0f%%, delay ≤ %.0f s: %s\n", FP_REMOVED_MIN * 100.0,
+           RECALL_TOL * 100.0, delay_max_s, ok ? "PASS" : "FAIL");
+    return ok;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "Usage: %s [--trace FILE]... [--hours H] [--seed N] [--spikes-per-day R] [--window N]\n",
+            argv0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *trace_paths[MAX_TRACES];
+    int n_paths = 0;
+    trace_synth_cfg_t synth = trace_synth_default();
+    synth.hours = 24.0 * 7;
+    bool   seed_set = false;
+    double per_day  = 24.0;
+    int    window   = CONFIG_LITTERBOX_SPIKE_FILTER_WINDOW;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc && n_paths < MAX_TRACES) {
+            trace_paths[n_paths++] = argv[++i];
+        } else if (strcmp(argv[i], "--hours") == 0 && i + 1 < argc) {
+            synth.hours = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            synth.seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+            seed_set = true;
+        } else if (strcmp(argv[i], "--spikes-per-day") == 0 && i + 1 < argc) {
+            per_day = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--window") == 0 && i + 1 < argc) {
+            window = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    spike_filter_t probe;
+    if (spike_filter_init(&probe, (uint8_t)window, SPIKE_FILTER_K_TENTHS, MIN_DEV_Q) != ESP_OK) {
+        fprintf(stderr, "--window must be odd, 3..%d\n", SPIKE_FILTER_MAX_WINDOW);
+        return 2;
+    }
+
+    bool ok = true;
+    int32_t *stream = test_stream(TIMING_SAMPLES);
+    if (!stream) {
+        return 1;
+    }
+    printf("== Reference check (k=%.1f, floor %d ppm) ==\n", SPIKE_FILTER_K_TENTHS / 10.0, SPIKE_FILTER_MIN_DEV_PPM);
+    ok &= check_reference(stream, CHECK_SAMPLES);
+    printf("== Per-sample cost ==\n");
+    bench_timing(stream, TIMING_SAMPLES);
+    free(stream);
+
+    /* Traces: the given ones, else one synthetic (--seed) or seeds 1–4 */
+    trace_t clean[MAX_TRACES], spiky[MAX_TRACES];
+    int n_traces = 0;
+    for (int i = 0; i < n_paths; i++) {
+        if (!trace_load_csv(&clean[n_traces], trace_paths[i]) || !replay_convert_raw(&clean[n_traces])) {
+            return 1;
+        }
+        if (!clean[n_traces].has_label) {
+            fprintf(stderr, "%s: no label column\n", trace_paths[i]);
+            return 1;
+        }
+        n_traces++;
+    }
+    for (uint32_t seed = 1; n_paths == 0 && seed <= (seed_set ? 1u : 4u); seed++) {
+        if (!seed_set) {
+            synth.seed = seed;
+        }
+        if (!trace_synthesize(&clean[n_traces++], &synth)) {
+            fprintf(stderr, "Failed to generate synthetic trace\n");
+            return 1;
+        }
+    }
+    size_t bursts = 0;
+    double hours = 0.0;
+    for (int i = 0; i < n_traces; i++) {
+        size_t b;
+        if (!inject_spikes(&clean[i], &spiky[i], per_day, (uint32_t)i + 1, &b)) {
+            return 1;
+        }
+        bursts += b;
+        hours  += clean[i].count * (TRACE_TICK_MS / 3600000.0);
+    }
+    printf("== Replay: %d trace(s), %.0f h, %zu injected bursts (%.0f/day), N=%d ==\n",
+           n_traces, hours, bursts, per_day, window);
+
+    static const event_detector_config_t threshold = EVENT_DETECTOR_CONFIG_DEFAULT();
+    event_detector_config_t cusum = threshold;
+    cusum.engine = EVENT_ENGINE_CUSUM;
+    ok &= replay_engine("threshold", &threshold, clean, spiky, n_traces, window);
+    ok &= replay_engine("CUSUM", &cusum, clean, spiky, n_traces, window);
+
+    for (int i = 0; i < n_traces; i++) {
+        trace_free(&clean[i]);
+        trace_free(&spiky[i]);
+    }
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,205 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * stage_stats_bench.c — Accuracy and cost of the per-stage cycle histograms
+ *
+ * 1. Accuracy: feeds synthetic cycle distributions shaped like the firmware
+ *    stages into stage_hist_t and compares p50/p90/p99/p99.9 with the exact
+ *    order statistics of the same samples (sorted copy). The distributions are:
+ *    narrow (ADC read), lognormal (ppm conversion), bimodal (detector idle vs
+ *    active), and a lock wait that is usually free but occasionally blocks for
+ *    a whole Zigbee stack iteration. Percentiles must be within 12.5 %
+ *    (half a bin); count/min/max/avg must be exact.
+ * 2. Cost: ns per stage_hist_add().
+ * 3. Host pipeline: times the real driver + detector per tick with the host
+ *    cycle counter, records them with stage_stats_record() and prints the
+ *    table the firmware logs (cycle → µs conversion assumes 160 MHz, so
+ *    the µs column is only meaningful on the device).
+ *
+ * Exits non-zero if any accuracy check fails.
+ *
+ * Usage: stage_stats_bench [--samples N] [--seed N]
+ */
+#include "air_sensor_driver.h"
+#include "bench_clock.h"
+#include "esp_adc/adc_oneshot.h"
+#include "esp_log.h"
+#include "event_detector.h"
+#include "stage_stats.h"
+#include "trace.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REL_TOL     0.125
+
+typedef enum { DIST_NARROW, DIST_LOGNORMAL, DIST_BIMODAL, DIST_LOCK_SPIKES, DIST_COUNT } dist_t;
+
+static const char *dist_name[DIST_COUNT] = { "narrow", "lognormal", "bimodal", "lock_spikes" };
+
+static volatile uint32_t s_sink;
+
+static uint32_t draw(dist_t d, uint64_t *rng)
+{
+    double x;
+    switch (d) {
+    case DIST_NARROW:       /* ~1.9k cycles ±3 % */
+        x = 1900.0 * (1.0 + 0.03 * trace_rng_normal(rng));
+        break;
+    case DIST_LOGNORMAL:    /* median ~6k, long right tail */
+        x = 6000.0 * exp(0.35 * trace_rng_normal(rng));
+        break;
+    case DIST_BIMODAL:      /* 80 % idle ~400, 20 % active ~1.5k */
+        x = trace_rng_uniform(rng) < 0.8 ? 400.0 + 40.0 * trace_rng_normal(rng)
+                                         : 1500.0 + 150.0 * trace_rng_normal(rng);
+        break;
+    default:                /* 98.5 % uncontended ~120, 1.5 % blocked 0.5–20 ms */
+        x = trace_rng_uniform(rng) < 0.985 ? 120.0 + 10.0 * trace_rng_normal(rng)
+                                           : 80000.0 + 3.12e6 * trace_rng_uniform(rng);
+        break;
+    }
+    return x < 16.0 ? 16u : (uint32_t)x;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* Same rank definition as stage_hist_percentile(): ceil(n·p) */
+static uint32_t exact_percentile(const uint32_t *sorted, size_t n, uint32_t permille)
+{
+    size_t rank = (size_t)(((uint64_t)n * permille + 999) / 1000);
+    return sorted[rank ? rank - 1 : 0];
+}
+
+static int check_accuracy(size_t n, uint64_t seed)
+{
+    static const uint32_t pm[] = { 500, 900, 990, 999 };
+    uint32_t *v = malloc(n * sizeof(*v));
+    static stage_hist_t h;
+    int fails = 0;
+
+    printf("%-12s %6s %10s %10s %8s\n", "dist", "pct", "exact", "hist", "err%");
+    for (int d = 0; d < DIST_COUNT; d++) {
+        uint64_t rng = seed + (uint64_t)d * 0x9E3779B97F4A7C15ULL;
+        uint64_t sum = 0;
+        stage_hist_reset(&h);
+        for (size_t i = 0; i < n; i++) {
+            v[i] = draw((dist_t)d, &rng);
+            sum += v[i];
+            stage_hist_add(&h, v[i]);
+        }
+        qsort(v, n, sizeof(*v), cmp_u32);
+
+        double worst = 0.0;
+        for (size_t k = 0; k < sizeof(pm) / sizeof(pm[0]); k++) {
+            uint32_t ex = exact_percentile(v, n, pm[k]);
+            uint32_t est = stage_hist_percentile(&h, pm[k]);
+            double err = fabs((double)est - ex) / ex;
+            worst = err > worst ? err : worst;
+            printf("%-12s %5.1f%% %10u %10u %7.2f%%\n", dist_name[d], pm[k] / 10.0, ex, est, err * 100.0);
+        }
+        stage_summary_t s;
+        stage_hist_summary(&h, &s);
+        bool exact_ok = s.count == n && s.min == v[0] && s.max == v[n - 1] && s.avg == (uint32_t)(sum / n);
+        if (worst > REL_TOL || !exact_ok) {
+            printf("FAIL %s: worst percentile error %.2f%%, count/min/max/avg %s\n",
+                   dist_name[d], worst * 100.0, exact_ok ? "exact" : "WRONG");
+            fails++;
+        }
+    }
+    free(v);
+    return fails;
+}
+
+static void measure_cost(size_t n, uint64_t seed)
+{
+    uint32_t *v = malloc(n * sizeof(*v));
+    static stage_hist_t h;
+    uint64_t rng = seed;
+    for (size_t i = 0; i < n; i++) {
+        v[i] = draw(DIST_LOGNORMAL, &rng);
+    }
+    stage_hist_reset(&h);
+    uint64_t t0 = bench_now_ns();
+    for (size_t i = 0; i < n; i++) {
+        stage_hist_add(&h, v[i]);
+    }
+    uint64_t ns = bench_now_ns() - t0;
+    s_sink += h.max;
+    printf("\nstage_hist_add: %.1f ns/sample (%zu samples), %zu B per stage, %zu B total\n",
+           (double)ns / n, n, sizeof(stage_hist_t), sizeof(stage_hist_t) * STAGE_COUNT);
+    free(v);
+}
+
+/* Real driver + detector timed per tick, the way main.c instruments them */
+static void host_pipeline(double hours, uint32_t seed)
+{
+    trace_t t;
+    trace_synth_cfg_t cfg = trace_synth_default();
+    cfg.seed  = seed;
+    cfg.hours = hours;
+    trace_init(&t, "synthetic");
+    if (!trace_synthesize(&t, &cfg)) {
+        return;
+    }
+
+    air_sensor_init();
+    event_detector_t det;
+    event_detector_init(&det);
+    stage_stats_reset();
+
+    for (size_t i = 0; i < t.count; i++) {
+        host_adc_set_raw(ADC_CHANNEL_0, trace_ppm_to_raw(t.samples[i].ppm));
+        air_sensor_data_t s;
+
+        uint64_t t0 = bench_cycles();
+        air_sensor_read(&s);
+        uint64_t t1 = bench_cycles();
+        event_detector_update(&det, s.nh3_ppm_f);
+        uint64_t t2 = bench_cycles();
+
+        stage_stats_record(STAGE_PPM_CONVERT, (uint32_t)(t1 - t0));
+        stage_stats_record(STAGE_DETECTOR, (uint32_t)(t2 - t1));
+        stage_stats_record(STAGE_TICK_TOTAL, (uint32_t)(t2 - t0));
+    }
+    printf("\nHost pipeline, %zu ticks (host cycles; µs column assumes %d MHz):\n",
+           t.count, CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+    fflush(stdout);
+    host_log_set_level(ESP_LOG_INFO);
+    stage_stats_log();
+    host_log_set_level(ESP_LOG_WARN);
+    trace_free(&t);
+}
+
+int main(int argc, char **argv)
+{
+    size_t samples = 1000000;
+    uint64_t seed = 7;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+            samples = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 0);
+        } else {
+            fprintf(stderr, "Usage: %s [--samples N] [--seed N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (samples < 1000) {
+        samples = 1000;
+    }
+
+    int fails = check_accuracy(samples, seed | 1);
+    measure_cost(samples, seed | 1);
+    host_pipeline(24.0, (uint32_t)seed);
+
+    printf("\n%s\n", fails ? "FAIL" : "PASS");
+    return fails ? 1 : 0;
+}
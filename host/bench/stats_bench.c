@@ -0,0 +1,352 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * stats_bench.c — Usage statistics against the event stream
+ *
+ * Replays labelled traces (default: four 7-day synthetic ones) through the
+ * Q15.16 detector and usage_stats as main.c wires them (IDLE baselines every
+ * sample, one usage_stats_event() per classification), keeps the events and
+ * baselines on the bench side, and checks:
+ *  - 24h:    attribute 0x0008, decoded from the wire, equals a recomputation
+ *            of the last 24 hours and of all kept days from the event list
+ *  - days:   attribute 0x0009, decoded, equals the per-day recomputation
+ *  - reboot: with a reboot (RAM lost, NVS kept) --reboot hours in, every
+ *            event is still counted and in the right histogram bin
+ *  - bounds: RAM and attribute sizes fixed, NVS writes per day within
+ *            24 rollovers + events + WRITES_SLACK
+ *
+ * Exits non-zero if any check fails.
+ *
+ * Usage: stats_bench [--trace FILE]... [--hours H] [--seed N] [--reboot H]
+ */
+#include "air_sensor_driver.h"
+#include "esp_log.h"
+#include "event_detector.h"
+#include "le_bytes.h"
+#include "nvs.h"
+#include "replay.h"
+#include "trace.h"
+#include "usage_stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_TRACES      16
+#define MAX_EVENTS      4096
+#define WRITES_SLACK    2
+#define TICK_S          (TRACE_TICK_MS / 1000)
+
+static const uint16_t k_edges[USAGE_STATS_HIST_BINS - 1] = USAGE_STATS_HIST_EDGES_DPPM;
+
+typedef struct {
+    uint32_t t_s;
+    uint8_t  type;
+    uint32_t duration_s;
+    uint16_t delta_dppm;
+} stat_event_t;
+
+/* What one run fed to usage_stats, for the offline recomputation */
+typedef struct {
+    stat_event_t ev[MAX_EVENTS];
+    size_t       n_ev;
+    uint16_t    *baseline;      /* Per tick, USAGE_STATS_NO_BASELINE if not IDLE */
+    size_t       n_ticks;
+} stat_log_t;
+
+/* Decoded attribute records */
+typedef struct {
+    uint8_t  hours;
+    uint16_t count[2], mean_s[2], base_min, base_max;
+    uint16_t hist[USAGE_STATS_HIST_BINS], hist_all[USAGE_STATS_HIST_BINS];
+} rec_24h_t;
+
+typedef struct {
+    uint8_t  count[2];
+    uint16_t mean_s[2], base_min, base_max;
+} rec_day_t;
+
+/* Same rounding as dppm_from_q() in main.c */
+static uint16_t dppm_from_q(int32_t ppm_q)
+{
+    int64_t dppm = ((int64_t)ppm_q * 10 + (1 << (EVENT_PPM_Q_SHIFT - 1))) >> EVENT_PPM_Q_SHIFT;
+    return (uint16_t)(dppm < 0 ? 0 : dppm >= 0xFFFF ? 0xFFFE : dppm);
+}
+
+static bool decode_24h(const uint8_t *p, size_t len, rec_24h_t *r)
+{
+    if (len != USAGE_STATS_24H_BYTES || p[0] != USAGE_STATS_FORMAT) {
+        return false;
+    }
+    r->hours = p[1];
+    for (int t = 0; t < 2; t++) {
+        r->count[t]  = le_get16(&p[2 + 2 * t]);
+        r->mean_s[t] = le_get16(&p[6 + 2 * t]);
+    }
+    r->base_min = le_get16(&p[10]);
+    r->base_max = le_get16(&p[12]);
+    for (int k = 0; k < USAGE_STATS_HIST_BINS; k++) {
+        r->hist[k]     = le_get16(&p[14 + 2 * k]);
+        r->hist_all[k] = le_get16(&p[24 + 2 * k]);
+    }
+    return true;
+}
+
+static size_t decode_days(const uint8_t *p, size_t len, rec_day_t *d)
+{
+    if (len < 2 || p[0] != USAGE_STATS_FORMAT || len != 2u + p[1] * USAGE_STATS_DAY_BYTES) {
+        return 0;
+    }
+    for (size_t i = 0; i < p[1]; i++) {
+        const uint8_t *q = &p[2 + i * USAGE_STATS_DAY_BYTES];
+        d[i] = (rec_day_t) { { q[0], q[1] }, { le_get16(&q[2]), le_get16(&q[4]) }, le_get16(&q[6]), le_get16(&q[8]) };
+    }
+    return p[1];
+}
+
+/* ── Offline recomputation ──────────────────────────────────────────── */
+
+typedef struct {
+    uint32_t count[2], duration_s[2], hist[USAGE_STATS_HIST_BINS];
+    uint16_t base_min, base_max;
+} ref_t;
+
+static int hist_bin(uint16_t delta)
+{
+    int bin = 0;
+    while (bin < USAGE_STATS_HIST_BINS - 1 && delta >= k_edges[bin]) {
+        bin++;
+    }
+    return bin;
+}
+
+/* Events and IDLE baselines with clock in [from_s, to_s) */
+static ref_t ref_window(const stat_log_t *log, uint32_t from_s, uint32_t to_s)
+{
+    ref_t r = { .base_min = USAGE_STATS_NO_BASELINE };
+    for (size_t i = 0; i < log->n_ev; i++) {
+        const stat_event_t *e = &log->ev[i];
+        if (e->t_s >= from_s && e->t_s < to_s) {
+            r.count[e->type - 1]++;
+            r.duration_s[e->type - 1] += e->duration_s;
+            r.hist[hist_bin(e->delta_dppm)]++;
+        }
+    }
+    for (size_t k = 0; k < log->n_ticks; k++) {
+        uint32_t t = (uint32_t)k * TICK_S;
+        uint16_t b = log->baseline[k];
+        if (t >= from_s && t < to_s && b != USAGE_STATS_NO_BASELINE) {
+            r.base_min = r.base_min == USAGE_STATS_NO_BASELINE || b < r.base_min ? b : r.base_min;
+            r.base_max = b > r.base_max ? b : r.base_max;
+        }
+    }
+    return r;
+}
+
+static uint16_t ref_mean(const ref_t *r, int t)
+{
+    return r->count[t] ? (uint16_t)(r->duration_s[t] / r->count[t]) : 0;
+}
+
+/* ── Replay ─────────────────────────────────────────────────────────── */
+
+/* Feed one trace as usage_stats_record() in main.c does; reboot_tick 0 = none */
+static void run(const trace_t *t, usage_stats_t *s, stat_log_t *log, size_t reboot_tick, uint32_t *nvs_writes)
+{
+    static const event_detector_config_t cfg = EVENT_DETECTOR_CONFIG_DEFAULT();
+    event_detector_t det;
+    event_detector_init_with_config(&det, &cfg);
+    host_nvs_erase_all();
+    usage_stats_open(s, USAGE_STATS_KEY);
+    uint32_t writes_before = host_nvs_write_count();
+
+    log->n_ev    = 0;
+    log->n_ticks = t->count;
+    free(log->baseline);
+    log->baseline = malloc(t->count * sizeof(*log->baseline));
+
+    uint8_t prev = LITTER_EVENT_NONE;
+    uint32_t boot_tick = 0;
+    for (size_t i = 0; i < t->count; i++) {
+        if (reboot_tick && i == reboot_tick) {
+            usage_stats_open(s, USAGE_STATS_KEY);    /* RAM state gone; the sample clock restarts */
+            boot_tick = (uint32_t)i;
+        }
+        uint16_t q6 = (uint16_t)(t->samples[i].ppm * (1 << AIR_SENSOR_PPM_Q_SHIFT) + 0.5f);
+        uint8_t event = (uint8_t)event_detector_update_q(&det, (int32_t)q6 << (EVENT_PPM_Q_SHIFT - AIR_SENSOR_PPM_Q_SHIFT));
+
+        uint16_t base = det.state == DETECTOR_IDLE ? dppm_from_q(det.baseline_q) : USAGE_STATS_NO_BASELINE;
+        log->baseline[i] = base;
+        usage_stats_sample(s, ((uint32_t)i - boot_tick) * TICK_S, base);
+
+        if (event != LITTER_EVENT_NONE && event != prev && log->n_ev < MAX_EVENTS) {
+            uint16_t peak = dppm_from_q(det.peak_q), b = dppm_from_q(det.baseline_q);
+            stat_event_t e = { (uint32_t)i * TICK_S, event, (uint32_t)det.event_ticks * TICK_S,
+                               peak > b ? (uint16_t)(peak - b) : 0 };
+            log->ev[log->n_ev++] = e;
+            usage_stats_event(s, e.type, e.duration_s, e.delta_dppm);
+        }
+        prev = event;
+    }
+    *nvs_writes = host_nvs_write_count() - writes_before;
+}
+
+/* 0x0008 and 0x0009 against the recomputation (no reboot: hours align with the trace clock) */
+static bool check_records(const usage_stats_t *s, const stat_log_t *log)
+{
+    uint8_t buf[USAGE_STATS_DAYS_MAX_BYTES];
+    rec_24h_t h;
+    rec_day_t days[USAGE_STATS_DAYS];
+    bool ok = decode_24h(buf, usage_stats_encode_24h(s, buf), &h);
+
+    uint32_t now_s  = (uint32_t)(log->n_ticks - 1) * TICK_S;
+    uint32_t hour   = now_s / USAGE_STATS_HOUR_S, day = hour / USAGE_STATS_HOURS;
+    uint32_t h_from = hour + 1 > USAGE_STATS_HOURS ? hour + 1 - USAGE_STATS_HOURS : 0;
+    uint32_t d_from = day + 1 > USAGE_STATS_DAYS ? day + 1 - USAGE_STATS_DAYS : 0;
+    ref_t r24  = ref_window(log, h_from * USAGE_STATS_HOUR_S, UINT32_MAX);
+    ref_t rall = ref_window(log, d_from * USAGE_STATS_HOURS * USAGE_STATS_HOUR_S, UINT32_MAX);
+
+    bool ok24 = ok && h.hours == hour + 1 - h_from && h.base_min == r24.base_min && h.base_max == r24.base_max;
+    for (int t = 0; t < 2; t++) {
+        ok24 &= h.count[t] == r24.count[t] && h.mean_s[t] == ref_mean(&r24, t);
+    }
+    for (int k = 0; k < USAGE_STATS_HIST_BINS; k++) {
+        ok24 &= h.hist[k] == r24.hist[k] && h.hist_all[k] == rall.hist[k];
+    }
+    printf("  24h:  %u h, urination %u (mean %u s), defecation %u (mean %u s), baseline %.1f–%.1f ppm%s\n",
+           h.hours, h.count[0], h.mean_s[0], h.count[1], h.mean_s[1], h.base_min / 10.0, h.base_max / 10.0,
+           ok24 ? "" : "  FAIL");
+    printf("        peak−baseline histogram 24h / all days:");
+    for (int k = 0; k < USAGE_STATS_HIST_BINS; k++) {
+        printf(" %u/%u", h.hist[k], h.hist_all[k]);
+    }
+    printf("\n");
+
+    size_t n = decode_days(buf, usage_stats_encode_days(s, buf), days);
+    bool okd = n == day + 1 - d_from;
+    for (size_t i = 0; okd && i < n; i++) {
+        uint32_t d = day - (uint32_t)i, day_s = USAGE_STATS_HOURS * USAGE_STATS_HOUR_S;
+        ref_t r = ref_window(log, d * day_s, (d + 1) * day_s);
+        okd &= days[i].base_min == r.base_min && days[i].base_max == r.base_max;
+        for (int t = 0; t < 2; t++) {
+            okd &= days[i].count[t] == (r.count[t] > UINT8_MAX ? UINT8_MAX : r.count[t])
+                && days[i].mean_s[t] == ref_mean(&r, t);
+        }
+    }
+    printf("  days: %zu, newest first:", n);
+    for (size_t i = 0; i < n; i++) {
+        printf(" %u+%u", days[i].count[0], days[i].count[1]);
+    }
+    printf("%s\n", okd ? "" : "  FAIL");
+    return ok24 && okd;
+}
+
+/* After a reboot the hours shift, but every event of the kept days must still be there */
+static bool check_reboot(const usage_stats_t *s, const stat_log_t *log)
+{
+    uint8_t buf[USAGE_STATS_DAYS_MAX_BYTES];
+    rec_24h_t h;
+    rec_day_t days[USAGE_STATS_DAYS];
+    size_t n = decode_days(buf, usage_stats_encode_days(s, buf), days);
+    bool ok = decode_24h(buf, usage_stats_encode_24h(s, buf), &h) && n > 0;
+
+    ref_t all = ref_window(log, 0, UINT32_MAX);
+    uint32_t counted = 0;
+    for (size_t i = 0; i < n; i++) {
+        counted += days[i].count[0] + days[i].count[1];
+    }
+    for (int k = 0; k < USAGE_STATS_HIST_BINS; k++) {
+        ok &= h.hist_all[k] == all.hist[k];
+    }
+    ok &= counted == all.count[0] + all.count[1] && n <= USAGE_STATS_DAYS;
+    printf("  reboot: %u/%u events counted over %zu day(s), histogram %s%s\n", counted,
+           all.count[0] + all.count[1], n, ok ? "intact" : "differs", ok ? "" : "  FAIL");
+    return ok;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "Usage: %s [--trace FILE]... [--hours H] [--seed N] [--reboot H]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *trace_paths[MAX_TRACES];
+    int n_paths = 0;
+    trace_synth_cfg_t synth = trace_synth_default();
+    synth.hours = 24.0 * 7;
+    double reboot_h = 80.5;
+    bool seed_set = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc && n_paths < MAX_TRACES) {
+            trace_paths[n_paths++] = argv[++i];
+        } else if (strcmp(argv[i], "--hours") == 0 && i + 1 < argc) {
+            synth.hours = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            synth.seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+            seed_set = true;
+        } else if (strcmp(argv[i], "--reboot") == 0 && i + 1 < argc) {
+            reboot_h = atof(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    host_log_set_level(ESP_LOG_WARN);
+
+    /* Traces: the given ones, else one synthetic (--seed) or seeds 1–4 */
+    trace_t traces[MAX_TRACES];
+    int n_traces = 0;
+    for (int i = 0; i < n_paths; i++) {
+        if (!trace_load_csv(&traces[n_traces], trace_paths[i]) || !replay_convert_raw(&traces[n_traces])) {
+            return 1;
+        }
+        n_traces++;
+    }
+    for (uint32_t seed = 1; n_paths == 0 && seed <= (seed_set ? 1u : 4u); seed++) {
+        if (!seed_set) {
+            synth.seed = seed;
+        }
+        if (!trace_synthesize(&traces[n_traces++], &synth)) {
+            fprintf(stderr, "Failed to generate synthetic trace\n");
+            return 1;
+        }
+    }
+
+    static usage_stats_t s;
+    static stat_log_t log;
+    bool ok = true;
+    for (int i = 0; i < n_traces; i++) {
+        uint32_t writes;
+        double days = traces[i].count * (double)TRACE_TICK_MS / 86400000.0;
+        printf("== Trace %d: %.1f days ==\n", i + 1, days);
+
+        run(&traces[i], &s, &log, 0, &writes);
+        ok &= check_records(&s, &log);
+        double per_day = writes / days, bound = USAGE_STATS_HOURS + log.n_ev / days + WRITES_SLACK;
+        bool w_ok = per_day <= bound;
+        printf("  nvs:  %.1f writes/day (%zu events, bound %.1f)%s\n", per_day, log.n_ev, bound,
+               w_ok ? "" : "  FAIL");
+        ok &= w_ok;
+
+        size_t reboot_tick = (size_t)(reboot_h * 3600000.0 / TRACE_TICK_MS);
+        if (reboot_tick > 0 && reboot_tick < traces[i].count) {
+            run(&traces[i], &s, &log, reboot_tick, &writes);
+            ok &= check_reboot(&s, &log);
+        }
+    }
+
+    bool size_ok = sizeof(usage_stats_t) <= 1024;
+    printf("bounds: usage_stats_t %zu B, attributes %d + %d B (%d B per day kept)%s\n", sizeof(usage_stats_t),
+           USAGE_STATS_24H_BYTES, USAGE_STATS_DAYS_MAX_BYTES, USAGE_STATS_DAY_BYTES, size_ok ? "" : "  FAIL");
+    ok &= size_ok;
+
+    free(log.baseline);
+    for (int i = 0; i < n_traces; i++) {
+        trace_free(&traces[i]);
+    }
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
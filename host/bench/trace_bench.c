@@ -0,0 +1,300 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * trace_bench.c — Per-tick observability cost: formatted logs vs binary frames
+ *
+ * Replays a trace through the float driver and detector, then times what the
+ * sample path spends producing per-tick output:
+ *  - text:   the per-tick lines at debug level (MQ135 raw/Vadc/Rs/ppm,
+ *            DETECTOR state) plus "Reported NH3=" every 5th tick (the fixed
+ *            report cadence this was measured against),
+ *            formatted with snprintf like esp_log's vprintf
+ *  - binary: trace_record_t → trace_ring_push(), and the drain copying the
+ *            frames out
+ * It reports ns and bytes per tick, plus UART time at 115200 baud. The host
+ * has an FPU, so the text column understates the ESP32-C6, where each %.Nf
+ * is a soft-float call chain.
+ *
+ * It then checks the round trip. The drained stream is expanded LF → CRLF
+ * the way the console does, text log lines are interleaved, and the result
+ * is decoded with frame_scan(). Every record must come back bit-exact. A
+ * ring overflow must also be reported in the next frame's dropped counter.
+ * Exits non-zero if either check fails.
+ *
+ * --save FILE writes the console stream, e.g. to try host/tools/trace_decode.
+ *
+ * Usage: trace_bench [--hours H] [--seed N] [--repeat N] [--save FILE]
+ */
+#include "air_sensor_driver.h"
+#include "bench_clock.h"
+#include "esp_adc/adc_oneshot.h"
+#include "event_detector.h"
+#include "frame_scan.h"
+#include "mq135_params.h"
+#include "trace.h"
+#include "trace_log.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REPORT_TICKS    5           /* Fixed 10 s NH3 report cadence */
+#define UART_BAUD       115200
+#define TEXT_LINE_MAX   192
+
+typedef struct {
+    air_sensor_data_t sensor;
+    event_detector_t  det;          /* Detector state after this tick */
+    litter_event_t    event;
+} tick_t;
+
+static volatile size_t s_sink;
+
+/* Same line shape as esp_log: "<L> (<ms>) <TAG>: <msg>\n" */
+static size_t text_tick(char *buf, size_t cap, const tick_t *t, uint32_t tick)
+{
+    const air_sensor_data_t *s = &t->sensor;
+    const event_detector_t  *d = &t->det;
+    unsigned long ms = (unsigned long)tick * TRACE_TICK_MS;
+    size_t n = 0;
+
+    float v_adc   = (s->raw_adc / 4095.0f) * MQ135_ADC_VREF;
+    float voltage = v_adc * MQ135_DIVIDER_RATIO;
+    float rs_kohm = MQ135_LOAD_RESISTANCE_KOHM * (MQ135_VCC - voltage) / voltage;
+    n += (size_t)snprintf(buf + n, cap - n,
+                          "D (%lu) MQ135: raw=%u Vadc=%.3f Aout=%.3f Rs=%.2fkΩ Rs/R0=%.2f NH3=%.1fppm%s\n",
+                          ms, (unsigned)s->raw_adc, (double)v_adc, (double)voltage, (double)rs_kohm,
+                          (double)(rs_kohm / MQ135_R0_KOHM), (double)s->nh3_ppm_f,
+                          s->is_warming_up ? " [WARMUP]" : "");
+
+    switch (d->state) {
+    case DETECTOR_IDLE:
+        n += (size_t)snprintf(buf + n, cap - n, "D (%lu) DETECTOR: state=IDLE  baseline=%.1f ppm  current=%.1f ppm\n",
+                              ms, (double)d->baseline_ppm, (double)s->nh3_ppm_f);
+        break;
+    case DETECTOR_ACTIVE:
+        n += (size_t)snprintf(buf + n, cap - n,
+                              "D (%lu) DETECTOR: state=ACTIVE  tick=%u  ppm=%.1f  peak=%.1f@tick%u  below=%u\n",
+                              ms, d->event_ticks, (double)s->nh3_ppm_f, (double)d->peak_ppm,
+                              d->peak_ticks, d->below_thresh_count);
+        break;
+    default:
+        n += (size_t)snprintf(buf + n, cap - n, "D (%lu) DETECTOR: state=COOLDOWN  %u/%u ticks\n",
+                              ms, d->cooldown_ticks, EVENT_COOLDOWN_TICKS);
+        break;
+    }
+
+    if (tick % REPORT_TICKS == REPORT_TICKS - 1) {
+        int32_t ppm_q  = EVENT_PPM_TO_Q(s->nh3_ppm_f);
+        int32_t base_q = event_detector_get_baseline_q(d);
+        n += (size_t)snprintf(buf + n, cap - n,
+                              "I (%lu) LITTERBOX: Reported NH3=%u ppm (%d.%02d ppm_q, baseline=%d.%02d, raw=%u)\n",
+                              ms, s->nh3_ppm, EVENT_PPM_Q_INT(ppm_q), EVENT_PPM_Q_HUND(ppm_q),
+                              EVENT_PPM_Q_INT(base_q), EVENT_PPM_Q_HUND(base_q), (unsigned)s->raw_adc);
+    }
+    return n;
+}
+
+/* Same fields as sensor_sample_timer_cb() */
+static trace_record_t record_of(const tick_t *t, uint32_t tick)
+{
+    return (trace_record_t) {
+        .tick       = tick,
+        .raw        = (uint16_t)t->sensor.raw_adc,
+        .ppm_q      = EVENT_PPM_TO_Q(t->sensor.nh3_ppm_f),
+        .baseline_q = event_detector_get_baseline_q(&t->det),
+        .state      = (uint8_t)t->det.state | (t->sensor.is_warming_up ? TRACE_FLAG_WARMUP : 0),
+        .event      = (uint8_t)t->event,
+    };
+}
+
+/* Drain everything queued into out (what trace_drain_task() hands to fwrite) */
+static size_t drain(trace_ring_t *ring, uint8_t *out)
+{
+    const uint8_t *data;
+    size_t n, bytes = 0;
+    while ((n = trace_ring_peek(ring, &data)) > 0) {
+        memcpy(out + bytes, data, n * TRACE_FRAME_BYTES);
+        bytes += n * TRACE_FRAME_BYTES;
+        trace_ring_consume(ring, n);
+    }
+    return bytes;
+}
+
+static bool records_equal(const trace_record_t *a, const trace_record_t *b)
+{
+    return a->tick == b->tick && a->raw == b->raw && a->ppm_q == b->ppm_q
+        && a->baseline_q == b->baseline_q && a->state == b->state
+        && a->event == b->event && a->dropped == b->dropped;
+}
+
+/* Console view of the binary stream: LF → CRLF, with a log line every `every` frames */
+static size_t console_stream(const uint8_t *bin, size_t n_frames, size_t every, uint8_t *out)
+{
+    static const char line[] = "I (123456) DETECTOR: Event END → URINATION  (peak=41.20ppm @ tick2, baseline=4.61ppm)\n";
+    size_t o = 0;
+    for (size_t f = 0; f < n_frames; f++) {
+        if (f % every == 0) {
+            for (const char *c = line; *c; c++) {
+                if (*c == '\n') {
+                    out[o++] = '\r';
+                }
+                out[o++] = (uint8_t)*c;
+            }
+        }
+        for (size_t k = 0; k < TRACE_FRAME_BYTES; k++) {
+            uint8_t b = bin[f * TRACE_FRAME_BYTES + k];
+            if (b == '\n') {
+                out[o++] = '\r';
+            }
+            out[o++] = b;
+        }
+    }
+    return o;
+}
+
+static bool check_overflow(void)
+{
+    static trace_ring_t ring;
+    static uint8_t out[(TRACE_RING_LEN + 1) * TRACE_FRAME_BYTES];
+    const size_t extra = 37;
+    trace_record_t rec = { .state = DETECTOR_IDLE };
+
+    trace_ring_init(&ring);
+    for (uint32_t i = 0; i < TRACE_RING_LEN + extra; i++) {
+        rec.tick = i;
+        trace_ring_push(&ring, &rec);
+    }
+    drain(&ring, out);
+    rec.tick = TRACE_RING_LEN + extra;
+    trace_ring_push(&ring, &rec);
+    size_t bytes = drain(&ring, out);
+
+    frame_scan_stats_t st;
+    size_t n = 0;
+    trace_record_t *got = frame_scan(out, bytes, &n, &st);
+    bool ok = got && n == 1 && got[0].dropped == extra && got[0].tick == TRACE_RING_LEN + extra;
+    printf("  overflow: %zu pushes into %d slots → next frame dropped=%u  %s\n",
+           TRACE_RING_LEN + extra, TRACE_RING_LEN, got ? got[0].dropped : 0, ok ? "ok" : "MISMATCH");
+    free(got);
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    int repeat = 20;
+    const char *save_path = NULL;
+    trace_synth_cfg_t synth = trace_synth_default();
+    synth.hours = 24.0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--hours") == 0 && i + 1 < argc) {
+            synth.hours = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            synth.seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--save") == 0 && i + 1 < argc) {
+            save_path = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--hours H] [--seed N] [--repeat N] [--save FILE]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    trace_t t;
+    if (!trace_synthesize(&t, &synth)) {
+        fprintf(stderr, "Failed to generate synthetic trace\n");
+        return 1;
+    }
+
+    /* Sensor + detector outputs per tick, computed once outside the timed loops */
+    size_t   n     = t.count;
+    tick_t  *ticks = calloc(n, sizeof(*ticks));
+    char    *text  = malloc(TEXT_LINE_MAX * 3);
+    uint8_t *bin   = malloc(n * TRACE_FRAME_BYTES);
+    uint8_t *wire  = malloc(n * TRACE_FRAME_BYTES * 2 + (n / 8 + 1) * TEXT_LINE_MAX);
+    trace_record_t *sent = malloc(n * sizeof(*sent));
+    if (!ticks || !text || !bin || !wire || !sent || air_sensor_init() != ESP_OK) {
+        return 1;
+    }
+    event_detector_t det;
+    event_detector_init(&det);
+    for (size_t i = 0; i < n; i++) {
+        host_adc_set_raw(ADC_CHANNEL_0, trace_ppm_to_raw(t.samples[i].ppm));
+        air_sensor_read(&ticks[i].sensor);
+        ticks[i].event = event_detector_update(&det, ticks[i].sensor.nh3_ppm_f);
+        ticks[i].det   = det;
+        sent[i]        = record_of(&ticks[i], (uint32_t)i);
+    }
+
+    /* Text: format every tick's lines */
+    size_t text_bytes = 0;
+    uint64_t t0 = bench_now_ns();
+    for (int r = 0; r < repeat; r++) {
+        for (size_t i = 0; i < n; i++) {
+            text_bytes += text_tick(text, TEXT_LINE_MAX * 3, &ticks[i], (uint32_t)i);
+        }
+    }
+    uint64_t text_ns = bench_now_ns() - t0;
+    s_sink += (size_t)text[0];
+
+    /* Binary: push one record per tick, drain every tick (firmware: every 1 s) */
+    static trace_ring_t ring;
+    size_t bin_bytes = 0;
+    t0 = bench_now_ns();
+    for (int r = 0; r < repeat; r++) {
+        trace_ring_init(&ring);
+        size_t off = 0;
+        for (size_t i = 0; i < n; i++) {
+            trace_record_t rec = record_of(&ticks[i], (uint32_t)i);
+            trace_ring_push(&ring, &rec);
+            off += drain(&ring, bin + off);
+        }
+        bin_bytes += off;
+    }
+    uint64_t bin_ns = bench_now_ns() - t0;
+
+    double calls = (double)n * repeat;
+    double text_b = text_bytes / calls, bin_b = bin_bytes / calls;
+    printf("== Per-tick output: %s, %zu ticks × %d ==\n", t.name, n, repeat);
+    printf("  %-8s %10s %12s %16s\n", "", "ns/tick", "bytes/tick", "UART ms/tick");
+    printf("  %-8s %10.1f %12.1f %16.3f\n", "text", text_ns / calls, text_b, text_b * 10e3 / UART_BAUD);
+    printf("  %-8s %10.1f %12.1f %16.3f\n", "binary", bin_ns / calls, bin_b, bin_b * 10e3 / UART_BAUD);
+    printf("  binary/text: %.1f%% CPU, %.1f%% bytes\n", 100.0 * bin_ns / text_ns, 100.0 * bin_b / text_b);
+
+    /* Round trip through a console-mangled stream */
+    size_t wire_len = console_stream(bin, n, 8, wire);
+    if (save_path) {
+        FILE *f = fopen(save_path, "wb");
+        if (!f || fwrite(wire, 1, wire_len, f) != wire_len) {
+            perror(save_path);
+        }
+        if (f) {
+            fclose(f);
+        }
+    }
+    frame_scan_stats_t st;
+    size_t got_n = 0;
+    trace_record_t *got = frame_scan(wire, wire_len, &got_n, &st);
+    size_t mismatches = (got_n == n) ? 0 : n;
+    for (size_t i = 0; got && i < got_n && i < n; i++) {
+        mismatches += !records_equal(&got[i], &sent[i]);
+    }
+    printf("== Round trip ==\n  %zu frames in %zu console bytes: decoded %zu (%s), %zu bad CRC, %zu mismatches\n",
+           n, wire_len, got_n, st.crlf ? "CRLF" : "LF", st.bad_crc, mismatches);
+    bool ok = mismatches == 0 && st.tick_gaps == 0;
+    ok &= check_overflow();
+    printf("%s\n", ok ? "PASS" : "FAIL");
+
+    free(got);
+    free(sent);
+    free(wire);
+    free(bin);
+    free(text);
+    free(ticks);
+    trace_free(&t);
+    return ok ? 0 : 1;
+}
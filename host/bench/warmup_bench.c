@@ -0,0 +1,284 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * warmup_bench.c — Cold-start replay: fixed 20 s warmup vs adaptive readiness
+ *
+ * Each run powers the sensor up at a random point of a synthetic trace and
+ * adds a heater transient: the reading climbs from ~0 as the heater comes up
+ * (time constant 2–6 s), overshoots by A ppm and settles with time
+ * constant τ, with A and τ drawn per run from --amp / --tau.
+ * The result is quantized to raw ADC codes with trace_ppm_to_raw() and
+ * then goes through air_sensor_read() with the ADC stub, so readiness
+ * comes from the real warmup estimator.
+ *
+ *  - legacy:   the pre-estimator firmware. A fixed 20 s warmup flag; the
+ *              detector is fed every reading, the baseline is seeded from
+ *              the first (cold) one and then follows a plain EMA.
+ *  - fixed:    held until the estimator reports warm like the current
+ *              firmware, but seeded from the first warm reading with the
+ *              plain EMA, to separate the baseline gain from the readiness
+ *              test.
+ *  - adaptive: the current firmware. The detector is held until the
+ *              estimator reports warm; while it reports settling, the
+ *              start-up baseline follows falling readings with
+ *              EVENT_SETTLE_GAIN, and then continues with the 1/n
+ *              variance-aware gain.
+ *
+ * Per run: time until ready, |heater offset| at that moment, time until the
+ * baseline is within VALID_TOL_PPM of a transient-free reference, the mean
+ * |baseline − (reference + offset)| over the first TRACK_MIN minutes (how
+ * well the baseline follows what the sensor reads when idle), false events
+ * and detected onsets in the first RUN_MIN minutes. Exits non-zero unless
+ * adaptive is ready sooner than legacy at the median, tracks better than
+ * fixed at the median and p90, is valid no later than fixed, raises no more
+ * false events than legacy and detects at least as many onsets as fixed.
+ *
+ * The baseline cannot be valid before the transient itself has decayed to
+ * within VALID_TOL_PPM, so that column mostly measures the sensor.
+ *
+ * Usage: warmup_bench [--runs N] [--seed N] [--amp LO:HI] [--tau LO:HI]
+ */
+#include "air_sensor_driver.h"
+#include "esp_adc/adc_oneshot.h"
+#include "esp_timer.h"
+#include "event_detector.h"
+#include "replay.h"
+#include "trace.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RUN_MIN             30
+#define RUN_TICKS           (RUN_MIN * 60000 / TRACE_TICK_MS)
+#define LEGACY_WARMUP_MS    20000
+#define VALID_TOL_PPM       0.5f
+#define TRACK_MIN           10
+#define TRACK_TICKS         (TRACK_MIN * 60000 / TRACE_TICK_MS)
+#define MIN_PPM             0.2f
+#define RISE_LO_S           2.0     /* Heater time constant: reading climbs from ~0 */
+#define RISE_HI_S           6.0
+#define ARMS                3
+
+typedef struct {
+    const char *name;
+    double     *ready_s;
+    double     *valid_s;
+    double     *bias_ppm;           /* |Heater offset| when declared ready */
+    double     *track_ppm;          /* Mean |baseline − idle reading| over TRACK_MIN */
+    size_t      n_valid;
+    uint32_t    false_events;
+    uint32_t    events, detected;
+} arm_t;
+
+typedef struct {
+    event_detector_config_t cfg;
+    event_detector_t        det;
+    replay_score_t          score;
+    long                    valid_tick;
+    double                  track_sum;
+    long                    track_n;
+} arm_run_t;
+
+static void arm_step(arm_run_t *a, bool feed, float ppm, uint8_t label,
+                     const event_detector_t *ref, double offset, long tick)
+{
+    detector_state_t before = a->det.state;
+    litter_event_t   out    = a->det.current_event;
+
+    if (feed) {
+        out = event_detector_update(&a->det, ppm);
+    }
+    replay_score_tick(&a->score, label, before == DETECTOR_IDLE && a->det.state == DETECTOR_ACTIVE, out);
+
+    if (a->valid_tick < 0 && a->det.initialized && a->det.state == DETECTOR_IDLE
+        && ref->state == DETECTOR_IDLE && ref->baseline_n == EVENT_BASELINE_STEADY
+        && fabsf(a->det.baseline_ppm - ref->baseline_ppm) <= VALID_TOL_PPM) {
+        a->valid_tick = tick;
+    }
+    if (tick < TRACK_TICKS && a->det.initialized && a->det.state == DETECTOR_IDLE
+        && ref->state == DETECTOR_IDLE) {
+        a->track_sum += fabs(a->det.baseline_ppm - (ref->baseline_ppm + offset));
+        a->track_n++;
+    }
+}
+
+static void arm_finish(arm_t *arm, arm_run_t *a, size_t run)
+{
+    replay_summary_t s;
+    replay_summarize(&a->score, TRACE_TICK_MS, &s);
+    arm->false_events += s.false_positives;
+    arm->events       += s.type[0].events;
+    arm->detected     += s.type[0].detected;
+    arm->track_ppm[run] = a->track_n ? a->track_sum / a->track_n : 0.0;
+    if (a->valid_tick >= 0) {
+        arm->valid_s[arm->n_valid++] = a->valid_tick * (TRACE_TICK_MS / 1000.0);
+    }
+    replay_score_free(&a->score);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(double *v, size_t n, double p)
+{
+    if (n == 0) {
+        return NAN;
+    }
+    qsort(v, n, sizeof(double), cmp_double);
+    return v[(size_t)(p * (n - 1) + 0.5)];
+}
+
+static bool parse_range(const char *s, double *lo, double *hi)
+{
+    return sscanf(s, "%lf:%lf", lo, hi) == 2 && *hi >= *lo;
+}
+
+int main(int argc, char **argv)
+{
+    size_t   runs  = 200;
+    uint32_t seed  = 7;
+    double   amp_lo = 0.0,  amp_hi = 40.0;
+    double   tau_lo = 20.0, tau_hi = 120.0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            runs = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--amp") == 0 && i + 1 < argc && parse_range(argv[i + 1], &amp_lo, &amp_hi)) {
+            i++;
+        } else if (strcmp(argv[i], "--tau") == 0 && i + 1 < argc && parse_range(argv[i + 1], &tau_lo, &tau_hi)) {
+            i++;
+        } else {
+            fprintf(stderr, "Usage: %s [--runs N] [--seed N] [--amp LO:HI] [--tau LO:HI]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (runs == 0) {
+        return 2;
+    }
+
+    trace_t t;
+    trace_synth_cfg_t synth = trace_synth_default();
+    synth.seed  = seed;
+    synth.hours = 24.0 * 7;
+    if (!trace_synthesize(&t, &synth) || t.count < (size_t)RUN_TICKS * 2) {
+        fprintf(stderr, "Failed to generate synthetic trace\n");
+        return 1;
+    }
+
+    arm_t arms[ARMS] = { { .name = "legacy" }, { .name = "fixed" }, { .name = "adaptive" } };
+    for (int k = 0; k < ARMS; k++) {
+        arms[k].ready_s = calloc(runs, sizeof(double));
+        arms[k].valid_s = calloc(runs, sizeof(double));
+        arms[k].bias_ppm = calloc(runs, sizeof(double));
+        arms[k].track_ppm = calloc(runs, sizeof(double));
+    }
+
+    const event_detector_config_t defaults = EVENT_DETECTOR_CONFIG_DEFAULT();
+    uint64_t rng = 0x5DEECE66DULL ^ seed;
+    for (size_t r = 0; r < runs; r++) {
+        size_t start = (size_t)(trace_rng_uniform(&rng) * (t.count - RUN_TICKS));
+        double amp   = amp_lo + trace_rng_uniform(&rng) * (amp_hi - amp_lo);
+        double tau   = tau_lo + trace_rng_uniform(&rng) * (tau_hi - tau_lo);
+        double rise  = RISE_LO_S + trace_rng_uniform(&rng) * (RISE_HI_S - RISE_LO_S);
+
+        /* Reference: same air, no transient, already warm */
+        event_detector_t ref;
+        event_detector_init(&ref);
+
+        arm_run_t legacy = { .cfg = defaults, .valid_tick = -1 };
+        arm_run_t fixed  = { .cfg = defaults, .valid_tick = -1 };
+        arm_run_t adapt  = { .cfg = defaults, .valid_tick = -1 };
+        legacy.cfg.adaptive_baseline = false;
+        fixed.cfg.adaptive_baseline  = false;
+        event_detector_init_with_config(&legacy.det, &legacy.cfg);
+        event_detector_init_with_config(&fixed.det, &fixed.cfg);
+        event_detector_init_with_config(&adapt.det, &adapt.cfg);
+        replay_score_init(&legacy.score);
+        replay_score_init(&fixed.score);
+        replay_score_init(&adapt.score);
+
+        host_timer_set_time_us(0);
+        air_sensor_init();
+        double ready_adaptive = NAN, bias_adaptive = 0.0;
+
+        for (long i = 0; i < RUN_TICKS; i++) {
+            const trace_sample_t *s = &t.samples[start + i];
+            double t_s = (i + 1) * (TRACE_TICK_MS / 1000.0);
+            air_sensor_data_t d;
+
+            event_detector_update(&ref, s->ppm);
+
+            host_timer_advance_us(TRACE_TICK_MS * 1000LL);
+            double heat   = 1.0 - exp(-t_s / rise);
+            double seen   = (s->ppm + amp * exp(-t_s / tau)) * heat;
+            double offset = seen - s->ppm;
+            host_adc_set_raw(ADC_CHANNEL_0, trace_ppm_to_raw(fmaxf((float)seen, MIN_PPM)));
+            air_sensor_read(&d);
+
+            if (t_s == LEGACY_WARMUP_MS / 1000.0) {
+                arms[0].bias_ppm[r] = fabs(offset);
+            }
+            if (isnan(ready_adaptive) && !d.is_warming_up) {
+                ready_adaptive = t_s;
+                bias_adaptive  = fabs(offset);
+            }
+            arm_step(&legacy, true, d.nh3_ppm_f, s->label, &ref, offset, i);
+            arm_step(&fixed, !d.is_warming_up, d.nh3_ppm_f, s->label, &ref, offset, i);
+            event_detector_set_settling(&adapt.det, d.is_settling);
+            arm_step(&adapt, !d.is_warming_up, d.nh3_ppm_f, s->label, &ref, offset, i);
+        }
+
+        arms[0].ready_s[r] = LEGACY_WARMUP_MS / 1000.0;
+        for (int k = 1; k < ARMS; k++) {
+            arms[k].ready_s[r]  = isnan(ready_adaptive) ? RUN_MIN * 60.0 : ready_adaptive;
+            arms[k].bias_ppm[r] = bias_adaptive;
+        }
+        arm_finish(&arms[0], &legacy, r);
+        arm_finish(&arms[1], &fixed, r);
+        arm_finish(&arms[2], &adapt, r);
+    }
+
+    printf("== Cold start: %zu runs × %d min, overshoot %.0f..%.0f ppm, τ %.0f..%.0f s ==\n",
+           runs, RUN_MIN, amp_lo, amp_hi, tau_lo, tau_hi);
+    printf("  %-9s %18s %22s %24s %20s %6s %11s\n", "", "ready med/p90 (s)", "offset at ready med/p90",
+           "baseline valid med/p90 (s)", "track err med/p90", "never", "false evts");
+    double ready_med[ARMS], valid_med[ARMS], valid_p90[ARMS], track_med[ARMS], track_p90[ARMS];
+    for (int k = 0; k < ARMS; k++) {
+        arm_t *a = &arms[k];
+        ready_med[k] = percentile(a->ready_s, runs, 0.5);
+        valid_med[k] = percentile(a->valid_s, a->n_valid, 0.5);
+        valid_p90[k] = percentile(a->valid_s, a->n_valid, 0.9);
+        track_med[k] = percentile(a->track_ppm, runs, 0.5);
+        track_p90[k] = percentile(a->track_ppm, runs, 0.9);
+        printf("  %-9s %8.0f / %-7.0f %11.2f / %-8.2f %13.0f / %-8.0f %9.2f / %-6.2f %6zu %11u\n",
+               a->name, ready_med[k], percentile(a->ready_s, runs, 0.9),
+               percentile(a->bias_ppm, runs, 0.5), percentile(a->bias_ppm, runs, 0.9),
+               valid_med[k], valid_p90[k], track_med[k], track_p90[k], runs - a->n_valid, a->false_events);
+    }
+    printf("  labelled onsets in window: %u (detected: legacy %u, fixed %u, adaptive %u)\n",
+           arms[0].events, arms[0].detected, arms[1].detected, arms[2].detected);
+
+    bool ok = ready_med[2] < ready_med[0]
+           && track_med[2] < track_med[1] && track_p90[2] < track_p90[1]
+           && valid_med[2] <= valid_med[1] && valid_p90[2] <= valid_p90[1]
+           && arms[2].false_events <= arms[0].false_events
+           && arms[2].detected >= arms[1].detected;
+    printf("%s\n", ok ? "PASS" : "FAIL");
+
+    for (int k = 0; k < ARMS; k++) {
+        free(arms[k].ready_s);
+        free(arms[k].valid_s);
+        free(arms[k].bias_ppm);
+        free(arms[k].track_ppm);
+    }
+    trace_free(&t);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,158 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * air_sensor_sim.c — Simulated sensor backend replaying CSV traces
+ */
+#include "air_sensor_sim.h"
+#include "esp_timer.h"
+#include "replay.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct {
+    trace_t *trace;
+    bool     owned;         /* Loaded here; freed by air_sensor_sim_reset() */
+} sim_channel_t;
+
+static sim_channel_t        s_ch[AIR_SENSOR_CHANNELS];
+static air_sensor_sim_cfg_t s_cfg = AIR_SENSOR_SIM_CFG_DEFAULT();
+static bool                 s_inited;
+static bool                 s_in_flight;
+static int64_t              s_ready_us;
+static size_t               s_row;          /* Rows handed out */
+static size_t               s_conv_row;     /* Row of the conversion in flight */
+
+/* A raw-only trace gets its ppm column here, without moving the clock the caller sees */
+static bool sim_prepare(trace_t *t)
+{
+    if (t->has_ppm) {
+        return true;
+    }
+    int64_t now_us = esp_timer_get_time();
+    bool ok = replay_convert_raw(t);
+    host_timer_set_time_us(now_us);
+    return ok;
+}
+
+bool air_sensor_sim_set_trace(int channel, trace_t *t)
+{
+    if (channel < 0 || channel >= AIR_SENSOR_CHANNELS || !t || !sim_prepare(t)) {
+        return false;
+    }
+    if (s_ch[channel].owned) {
+        trace_free(s_ch[channel].trace);
+        free(s_ch[channel].trace);
+    }
+    s_ch[channel] = (sim_channel_t){ .trace = t, .owned = false };
+    return true;
+}
+
+bool air_sensor_sim_load_csv(int channel, const char *path)
+{
+    trace_t *t = malloc(sizeof(*t));
+    if (!t) {
+        return false;
+    }
+    trace_init(t, path);
+    if (!trace_load_csv(t, path) || !air_sensor_sim_set_trace(channel, t)) {
+        trace_free(t);
+        free(t);
+        return false;
+    }
+    s_ch[channel].owned = true;
+    return true;
+}
+
+void air_sensor_sim_configure(const air_sensor_sim_cfg_t *cfg)
+{
+    s_cfg = *cfg;
+}
+
+void air_sensor_sim_reset(void)
+{
+    for (int ch = 0; ch < AIR_SENSOR_CHANNELS; ch++) {
+        if (s_ch[ch].owned) {
+            trace_free(s_ch[ch].trace);
+            free(s_ch[ch].trace);
+        }
+        s_ch[ch] = (sim_channel_t){0};
+    }
+    s_cfg       = (air_sensor_sim_cfg_t)AIR_SENSOR_SIM_CFG_DEFAULT();
+    s_inited    = false;
+    s_in_flight = false;
+}
+
+size_t air_sensor_sim_position(void)
+{
+    return s_row;
+}
+
+/* ── Backend ────────────────────────────────────────────────────────── */
+
+static esp_err_t sim_init(void)
+{
+    for (int ch = 0; ch < AIR_SENSOR_CHANNELS; ch++) {
+        if (!s_ch[ch].trace) {
+            fprintf(stderr, "air_sensor_sim: no trace on channel %d\n", ch);
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+    s_inited    = true;
+    s_in_flight = false;
+    s_row       = 0;
+    return ESP_OK;
+}
+
+static esp_err_t sim_start(void)
+{
+    if (!s_inited || s_in_flight) return ESP_ERR_INVALID_STATE;
+    s_in_flight = true;
+    s_ready_us  = esp_timer_get_time() + s_cfg.latency_us;
+    s_conv_row  = s_row++;
+    return ESP_OK;
+}
+
+static esp_err_t sim_poll(air_sensor_data_t *out)
+{
+    if (!out)         return ESP_ERR_INVALID_ARG;
+    if (!s_in_flight) return ESP_ERR_INVALID_STATE;
+    if (esp_timer_get_time() < s_ready_us) return ESP_ERR_NOT_FINISHED;
+    s_in_flight = false;
+
+    esp_err_t ret = ESP_OK;
+    for (int ch = 0; ch < AIR_SENSOR_CHANNELS; ch++) {
+        const trace_t *t = s_ch[ch].trace;
+        air_sensor_data_t *o = &out[ch];
+        size_t row = s_conv_row;
+        if (s_cfg.loop && t->count) {
+            row %= t->count;
+        }
+        o->is_warming_up = s_conv_row < s_cfg.warmup_rows;
+        o->is_settling   = false;
+        if (row >= t->count) {
+            *o = (air_sensor_data_t){ .is_warming_up = o->is_warming_up };
+            ret = ret != ESP_OK ? ret : ESP_ERR_NOT_FOUND;
+            continue;
+        }
+
+        /* Same quantization as the MQ-135 float path */
+        float ppm = t->samples[row].ppm;
+        if (ppm < 0.0f)    ppm = 0.0f;
+        if (ppm > 1000.0f) ppm = 1000.0f;
+        o->nh3_ppm   = (uint16_t)ppm;
+        o->nh3_ppm_f = ppm;
+        o->nh3_ppm_q = (uint16_t)(ppm * (1 << AIR_SENSOR_PPM_Q_SHIFT) + 0.5f);
+        o->raw_adc   = t->has_raw ? t->samples[row].raw_adc : 0;
+        o->is_valid  = true;
+    }
+    return ret;
+}
+
+const air_sensor_backend_t air_sensor_sim = {
+    .name  = "sim",
+    .init  = sim_init,
+    .start = sim_start,
+    .poll  = sim_poll,
+};
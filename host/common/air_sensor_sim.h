@@ -0,0 +1,64 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * air_sensor_sim.h — Simulated sensor backend replaying CSV traces
+ *
+ * air_sensor_sim plugs into air_sensor_select() like the hardware
+ * backends: every conversion hands out the next row of each channel's
+ * trace (trace.h), so the firmware's sample path can be driven from a
+ * capture or a synthetic trace without the ADC stub.
+ *
+ *  - ppm comes from the trace's ppm column; a raw-only trace is converted
+ *    once at load with the MQ-135 backend (replay_convert_raw()).
+ *  - raw_adc is the raw column (0 if absent).
+ *  - A conversion completes latency_us after start() on the esp_timer
+ *    clock, so asynchronous callers see ESP_ERR_NOT_FINISHED in between.
+ *  - Past the last row a channel reads invalid with ESP_ERR_NOT_FOUND,
+ *    unless the trace loops.
+ */
+#pragma once
+
+#include "air_sensor_driver.h"
+#include "trace.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    int64_t  latency_us;        /* start() → result; 0 = ready at the first poll */
+    uint32_t warmup_rows;       /* Rows reported with is_warming_up set */
+    bool     loop;              /* Restart a trace at its end */
+} air_sensor_sim_cfg_t;
+
+#define AIR_SENSOR_SIM_CFG_DEFAULT()    { .latency_us = 0, .warmup_rows = 0, .loop = false }
+
+extern const air_sensor_backend_t air_sensor_sim;
+
+/**
+ * @brief Replay a trace on a channel. The trace is borrowed: it must stay
+ *        alive and unchanged while the backend is in use.
+ *
+ * @return false if the trace has neither a ppm nor a raw column, or the
+ *         channel is out of range.
+ */
+bool air_sensor_sim_set_trace(int channel, trace_t *t);
+
+/**
+ * @brief Load a CSV trace (trace_load_csv()) and replay it on a channel.
+ *        The backend owns it until air_sensor_sim_reset().
+ */
+bool air_sensor_sim_load_csv(int channel, const char *path);
+
+void air_sensor_sim_configure(const air_sensor_sim_cfg_t *cfg);
+
+/**
+ * @brief Forget every trace (freeing the loaded ones) and the configuration.
+ */
+void air_sensor_sim_reset(void);
+
+/**
+ * @brief Rows handed out so far (the next row's index, before wrapping).
+ */
+size_t air_sensor_sim_position(void);
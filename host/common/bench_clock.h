@@ -0,0 +1,38 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * bench_clock.h — Monotonic wall clock and cycle counter for host benchmarks
+ *
+ * bench_cycles() reads the TSC on x86-64 (constant-rate on modern CPUs, so
+ * "cycles" are reference cycles) and the cycle CSR on RISC-V; elsewhere it
+ * returns 0 and callers fall back to nanoseconds.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+static inline uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint64_t bench_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__riscv) && __riscv_xlen == 64
+    uint64_t c;
+    __asm__ volatile ("rdcycle %0" : "=r"(c));
+    return c;
+#else
+    return 0;
+#endif
+}
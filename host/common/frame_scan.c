@@ -0,0 +1,97 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * frame_scan.c — Recover binary trace frames from a captured byte stream
+ */
+#include "frame_scan.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Copy one frame starting at p, optionally collapsing CRLF → LF.
+ * Returns bytes consumed, 0 if the buffer ends first. */
+static size_t gather(const uint8_t *p, const uint8_t *end, bool crlf, uint8_t frame[TRACE_FRAME_BYTES])
+{
+    const uint8_t *start = p;
+    for (size_t k = 0; k < TRACE_FRAME_BYTES; k++) {
+        if (crlf && p + 1 < end && p[0] == '\r' && p[1] == '\n') {
+            p++;
+        }
+        if (p >= end) {
+            return 0;
+        }
+        frame[k] = *p++;
+    }
+    return (size_t)(p - start);
+}
+
+static size_t scan_pass(const uint8_t *buf, size_t len, bool crlf, trace_record_t *out, frame_scan_stats_t *st)
+{
+    const uint8_t *end = buf + len;
+    bool have_prev = false;
+    uint32_t prev_tick = 0;
+    size_t n = 0;
+
+    memset(st, 0, sizeof(*st));
+    st->crlf = crlf;
+    for (const uint8_t *p = buf; p + 1 < end; ) {
+        if (p[0] != TRACE_SYNC0 || p[1] != TRACE_SYNC1) {
+            p++;
+            continue;
+        }
+
+        trace_record_t rec;
+        uint8_t frame[TRACE_FRAME_BYTES];
+        size_t used = gather(p, end, crlf, frame);
+        if (used == 0 || !trace_decode(frame, &rec)) {
+            st->bad_crc++;
+            p++;
+            continue;
+        }
+        p += used;
+
+        if (have_prev && rec.tick - prev_tick > 1u + rec.dropped) {
+            st->tick_gaps += rec.tick - prev_tick - 1u - rec.dropped;
+        }
+        have_prev = true;
+        prev_tick = rec.tick;
+        st->dropped += rec.dropped;
+        out[n++] = rec;         /* A frame is ≥ TRACE_FRAME_BYTES bytes, so cap suffices */
+    }
+    st->frames = n;
+    return n;
+}
+
+trace_record_t *frame_scan(const uint8_t *buf, size_t len, size_t *n, frame_scan_stats_t *st)
+{
+    size_t cap = len / TRACE_FRAME_BYTES + 1;
+    trace_record_t *out = malloc(cap * sizeof(*out));
+    trace_record_t *alt = malloc(cap * sizeof(*alt));
+    frame_scan_stats_t st_alt;
+
+    *n = 0;
+    memset(st, 0, sizeof(*st));
+    if (!out || !alt) {
+        free(out);
+        free(alt);
+        return NULL;
+    }
+
+    *n = scan_pass(buf, len, false, out, st);
+    size_t n_alt = scan_pass(buf, len, true, alt, &st_alt);
+    if (n_alt > *n) {
+        trace_record_t *tmp = out;
+        out = alt;
+        alt = tmp;
+        *n  = n_alt;
+        *st = st_alt;
+    }
+    free(alt);
+
+    if (*n == 0) {
+        free(out);
+        return NULL;
+    }
+    return out;
+}
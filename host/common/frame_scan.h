@@ -0,0 +1,35 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * frame_scan.h — Recover binary trace frames (main/trace_log.h) from a
+ *                captured serial byte stream
+ *
+ * The stream may interleave text log lines with frames, and the console
+ * may have expanded every LF to CRLF (ESP-IDF's default stdout line
+ * ending). The capture is scanned twice: once as-is, and once with every
+ * "\r\n" collapsed to "\n", which exactly undoes the expansion. The pass
+ * that yields more valid frames wins. Mixing the two per frame would let
+ * CRC-8 collisions (1 in 256) accept the wrong reading of a frame.
+ */
+#pragma once
+
+#include "trace_log.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    size_t   frames;        /* Decoded */
+    bool     crlf;          /* Stream had LF → CRLF expansion undone */
+    size_t   bad_crc;       /* Sync found, no valid frame */
+    uint64_t dropped;       /* Sum of the frames' dropped counters (ring overflow on the device) */
+    uint64_t tick_gaps;     /* Missing ticks not explained by dropped (lost on the link) */
+} frame_scan_stats_t;
+
+/**
+ * @brief Decode every frame in buf.
+ * @return Heap array of *n records (free() it), NULL if none or on OOM
+ */
+trace_record_t *frame_scan(const uint8_t *buf, size_t len, size_t *n, frame_scan_stats_t *st);
@@ -0,0 +1,165 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * history_reader.c — mmap a history partition dump and replay it as a trace
+ */
+#include "history_reader.h"
+#include "replay.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define PPM_CHECK_ABS   0.1     /* LUT vs float conversion differ by < 1/64 ppm plus rounding */
+#define PPM_CHECK_REL   0.01
+
+static esp_err_t image_read(void *ctx, uint32_t off, void *dst, size_t len)
+{
+    const history_image_t *img = ctx;
+    if ((size_t)off + len > img->len) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(dst, img->data + off, len);
+    return ESP_OK;
+}
+
+bool history_image_open(history_image_t *img, const char *path)
+{
+    memset(img, 0, sizeof(*img));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return false;
+    }
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 || sb.st_size < 2 * HISTORY_SECTOR_BYTES) {
+        fprintf(stderr, "%s: not a history dump (%lld bytes)\n", path, (long long)sb.st_size);
+        close(fd);
+        return false;
+    }
+    void *p = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        perror(path);
+        return false;
+    }
+    img->data = p;
+    img->len  = (size_t)sb.st_size;
+    img->flash = (history_flash_t) {
+        .ctx  = img,
+        .size = (uint32_t)(img->len - img->len % HISTORY_SECTOR_BYTES),
+        .read = image_read,
+    };
+    return true;
+}
+
+void history_image_close(history_image_t *img)
+{
+    if (img->data) {
+        munmap((void *)img->data, img->len);
+    }
+    memset(img, 0, sizeof(*img));
+}
+
+/* ── Trace loading ──────────────────────────────────────────────────── */
+
+typedef struct {
+    size_t  index;              /* Trace sample of a block's first sample */
+    int32_t ppm_q0;
+} block_ref_t;
+
+typedef struct {
+    trace_t     *t;
+    block_ref_t *refs;
+    size_t       n_refs, cap_refs;
+    size_t       held;
+    bool         ok;
+} load_ctx_t;
+
+static void load_block(void *arg, const history_block_info_t *info, const history_sample_t *samples)
+{
+    load_ctx_t *c = arg;
+    for (uint16_t i = 0; i < info->count && c->ok; i++) {
+        const history_sample_t *s = &samples[i];
+        if (s->state & (TRACE_FLAG_WARMUP | TRACE_FLAG_INVALID)) {
+            c->held++;
+            continue;
+        }
+        if (i == 0) {
+            if (c->n_refs == c->cap_refs) {
+                size_t cap = c->cap_refs ? c->cap_refs * 2 : 256;
+                block_ref_t *grown = realloc(c->refs, cap * sizeof(*grown));
+                if (!grown) {
+                    c->ok = false;
+                    return;
+                }
+                c->refs = grown;
+                c->cap_refs = cap;
+            }
+            c->refs[c->n_refs++] = (block_ref_t) { .index = c->t->count, .ppm_q0 = info->ppm_q0 };
+        }
+        /* Continuous time axis: the replay assumes one tick per sample across boots */
+        trace_sample_t ts = {
+            .t_ms    = (uint32_t)(c->t->count * TRACE_TICK_MS),
+            .raw_adc = s->raw,
+        };
+        c->ok = trace_push(c->t, &ts);
+    }
+}
+
+bool history_load_trace(trace_t *t, const char *path, history_load_stats_t *st)
+{
+    history_image_t img;
+    memset(st, 0, sizeof(*st));
+    trace_init(t, path);
+    if (!history_image_open(&img, path)) {
+        return false;
+    }
+
+    load_ctx_t c = { .t = t, .ok = true };
+    esp_err_t err = history_read(&img.flash, load_block, &c, &st->read);
+    history_image_close(&img);
+    st->held = c.held;
+    if (err != ESP_OK || !c.ok) {
+        fprintf(stderr, "%s: decoding failed (%s)\n", path, c.ok ? esp_err_to_name(err) : "out of memory");
+        free(c.refs);
+        return false;
+    }
+    t->has_raw = true;
+
+    if (!replay_convert_raw(t)) {
+        free(c.refs);
+        return false;
+    }
+    for (size_t i = 0; i < c.n_refs; i++) {
+        double stored = (double)c.refs[i].ppm_q0 / (1 << EVENT_PPM_Q_SHIFT);
+        double now    = t->samples[c.refs[i].index].ppm;
+        st->ppm_checked++;
+        if (fabs(stored - now) > PPM_CHECK_ABS + PPM_CHECK_REL * fabs(stored)) {
+            st->ppm_mismatch++;
+        }
+    }
+    free(c.refs);
+    return true;
+}
+
+void history_print_stats(FILE *f, const char *name, const history_load_stats_t *st)
+{
+    const history_read_stats_t *r = &st->read;
+    fprintf(f, "%s: %u sectors, %u blocks, %llu samples (%.1f days at %d ms), %u boot change(s)\n",
+            name, r->sectors, r->blocks, (unsigned long long)r->samples,
+            (double)r->samples * TRACE_TICK_MS / 86400000.0, TRACE_TICK_MS, r->boots);
+    fprintf(f, "%s: %u bytes used (%.2f bits/sample), %u bad block(s), %u torn sector(s), %zu held sample(s)\n",
+            name, r->bytes_used, r->samples ? r->bytes_used * 8.0 / (double)r->samples : 0.0,
+            r->bad_blocks, r->torn_sectors, st->held);
+    if (st->ppm_mismatch) {
+        fprintf(f, "%s: WARNING %zu of %zu blocks were logged with a different raw→ppm conversion "
+                "(R0 in mq135_params.h?)\n", name, st->ppm_mismatch, st->ppm_checked);
+    }
+}
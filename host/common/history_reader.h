@@ -0,0 +1,48 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * history_reader.h — Read a dumped "history" partition (main/history_log.h)
+ *
+ * The dump (history_dump.ps1 → history.bin) is memory-mapped and decoded
+ * in place through history_read(), oldest block first. history_load_trace()
+ * turns it into a raw-ADC trace for the replay tools: samples the firmware
+ * held back from the detector (warmup, failed reads) are left out, ppm is
+ * recomputed with the driver, and each block's stored first ppm is checked
+ * against that so a log written with a different R0 is flagged.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "history_log.h"
+#include "trace.h"
+
+typedef struct {
+    const uint8_t  *data;
+    size_t          len;
+    history_flash_t flash;      /* Read-only view over data */
+} history_image_t;
+
+typedef struct {
+    history_read_stats_t read;
+    size_t               held;              /* Warmup / invalid samples left out */
+    size_t               ppm_checked;       /* Blocks whose first ppm was compared */
+    size_t               ppm_mismatch;      /* ... and disagreed with this build's conversion */
+} history_load_stats_t;
+
+/**
+ * @brief Map a partition dump read-only. Prints why on failure.
+ */
+bool history_image_open(history_image_t *img, const char *path);
+void history_image_close(history_image_t *img);
+
+/**
+ * @brief Load a dump as a raw + ppm trace (no labels).
+ */
+bool history_load_trace(trace_t *t, const char *path, history_load_stats_t *st);
+
+void history_print_stats(FILE *f, const char *name, const history_load_stats_t *st);
@@ -0,0 +1,204 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * replay.c — Detector replay and label scoring
+ */
+#include "replay.h"
+#include "air_sensor_driver.h"
+#include "esp_adc/adc_oneshot.h"
+#include "esp_timer.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* ── Scoring ────────────────────────────────────────────────────────── */
+
+void replay_score_init(replay_score_t *r)
+{
+    memset(r, 0, sizeof(*r));
+    r->pending        = -1;
+    r->awaiting_class = -1;
+    r->last_out       = LITTER_EVENT_NONE;
+}
+
+void replay_score_free(replay_score_t *r)
+{
+    free(r->events);
+    r->events = NULL;
+}
+
+void replay_score_tick(replay_score_t *r, uint8_t label, bool triggered, litter_event_t out)
+{
+    size_t idx = r->ticks++;
+
+    if (label != LITTER_EVENT_NONE) {
+        if (r->n_events == r->capacity) {
+            size_t cap = r->capacity ? r->capacity * 2 : 64;
+            replay_event_t *p = realloc(r->events, cap * sizeof(*p));
+            if (!p) {
+                return;
+            }
+            r->events   = p;
+            r->capacity = cap;
+        }
+        r->events[r->n_events] = (replay_event_t){
+            .label = label, .onset = idx, .trigger = -1, .classified = -1,
+            .result = LITTER_EVENT_NONE,
+        };
+        r->pending = (long)r->n_events++;
+    }
+
+    if (r->pending >= 0 && idx - r->events[r->pending].onset > REPLAY_MATCH_WINDOW_TICKS) {
+        r->pending = -1;
+    }
+
+    if (triggered) {
+        if (r->pending >= 0) {
+            r->events[r->pending].trigger = (long)idx;
+            r->awaiting_class = r->pending;
+            r->pending = -1;
+            r->fp_open = false;
+        } else {
+            r->false_positives++;
+            r->awaiting_class = -1;
+            r->fp_open = true;
+        }
+    }
+
+    if (out != LITTER_EVENT_NONE && r->last_out == LITTER_EVENT_NONE) {
+        if (r->awaiting_class >= 0) {
+            r->events[r->awaiting_class].classified = (long)idx;
+            r->events[r->awaiting_class].result     = out;
+            r->awaiting_class = -1;
+        } else if (!r->fp_open) {
+            /* Classification with no observed trigger (engine without a
+             * separate ACTIVE edge) — still a detection nobody asked for */
+            r->false_positives++;
+        }
+        r->fp_open = false;
+    }
+    r->last_out = out;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void summarize_latency(double *v, size_t n, double *median, double *max)
+{
+    if (n == 0) {
+        *median = *max = 0.0;
+        return;
+    }
+    qsort(v, n, sizeof(*v), cmp_double);
+    *median = (n & 1) ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+    *max    = v[n - 1];
+}
+
+void replay_summarize(const replay_score_t *r, uint32_t tick_ms, replay_summary_t *out)
+{
+    double tick_s = tick_ms / 1000.0;
+    double *trig  = malloc((r->n_events + 1) * sizeof(double));
+    double *cls   = malloc((r->n_events + 1) * sizeof(double));
+    uint32_t detections = r->false_positives;
+
+    memset(out, 0, sizeof(*out));
+    out->false_positives = r->false_positives;
+    out->hours = r->ticks * tick_s / 3600.0;
+
+    for (int type = 0; type < 3; type++) {
+        replay_type_summary_t *ts = &out->type[type];
+        size_t nt = 0, nc = 0;
+
+        for (size_t i = 0; i < r->n_events; i++) {
+            const replay_event_t *e = &r->events[i];
+            if (type != 0 && e->label != type) {
+                continue;
+            }
+            ts->events++;
+            if (e->trigger >= 0) {
+                ts->detected++;
+                trig[nt++] = (e->trigger - (long)e->onset) * tick_s;
+            }
+            if (e->classified >= 0) {
+                cls[nc++] = (e->classified - (long)e->onset) * tick_s;
+                if (e->result == e->label) {
+                    ts->correct++;
+                }
+            }
+        }
+        summarize_latency(trig, nt, &ts->trigger_median_s, &ts->trigger_max_s);
+        summarize_latency(cls, nc, &ts->classify_median_s, &ts->classify_max_s);
+    }
+    free(trig);
+    free(cls);
+
+    detections += out->type[0].detected;
+    out->precision = detections ? (double)out->type[0].correct / detections : 0.0;
+    out->recall    = out->type[0].events ? (double)out->type[0].correct / out->type[0].events : 0.0;
+}
+
+void replay_print_summary(FILE *f, const char *title, const replay_summary_t *s)
+{
+    static const char *names[3] = { "ALL", "URINATION", "DEFECATION" };
+
+    fprintf(f, "== Detection: %s (%.1f h) ==\n", title, s->hours);
+    fprintf(f, "  %-10s %6s %8s %7s  %-20s %-20s\n",
+            "type", "events", "detected", "correct",
+            "trigger med/max (s)", "classify med/max (s)");
+    for (int type = 1; type < 3; type++) {
+        const replay_type_summary_t *ts = &s->type[type];
+        fprintf(f, "  %-10s %6u %8u %7u  %8.0f / %-9.0f %8.0f / %-9.0f\n",
+                names[type], ts->events, ts->detected, ts->correct,
+                ts->trigger_median_s, ts->trigger_max_s,
+                ts->classify_median_s, ts->classify_max_s);
+    }
+    fprintf(f, "  false positives=%u  precision=%.3f  recall=%.3f\n",
+            s->false_positives, s->precision, s->recall);
+}
+
+/* ── Scalar detector replay ─────────────────────────────────────────── */
+
+void replay_event_detector(const trace_t *t, replay_score_t *r)
+{
+    static const event_detector_config_t defaults = EVENT_DETECTOR_CONFIG_DEFAULT();
+    replay_event_detector_config(t, &defaults, r);
+}
+
+void replay_event_detector_config(const trace_t *t, const event_detector_config_t *cfg,
+                                  replay_score_t *r)
+{
+    event_detector_t det;
+    event_detector_init_with_config(&det, cfg);
+
+    for (size_t i = 0; i < t->count; i++) {
+        detector_state_t before = det.state;
+        litter_event_t   out    = event_detector_update(&det, t->samples[i].ppm);
+        bool triggered = (before == DETECTOR_IDLE && det.state == DETECTOR_ACTIVE);
+        replay_score_tick(r, t->samples[i].label, triggered, out);
+    }
+}
+
+bool replay_convert_raw(trace_t *t)
+{
+    if (!t->has_raw) {
+        return t->has_ppm;
+    }
+    if (air_sensor_mq135.init() != ESP_OK) {
+        return false;
+    }
+    for (size_t i = 0; i < t->count; i++) {
+        air_sensor_data_t data[AIR_SENSOR_CHANNELS] = {0};
+        host_adc_set_raw(ADC_CHANNEL_0, t->samples[i].raw_adc);
+        host_timer_advance_us(TRACE_TICK_MS * 1000LL);
+        if (air_sensor_backend_read(&air_sensor_mq135, data) != ESP_OK) {
+            return false;
+        }
+        t->samples[i].ppm = data[0].nh3_ppm_f;
+    }
+    t->has_ppm = true;
+    return true;
+}
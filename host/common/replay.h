@@ -0,0 +1,94 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * replay.h — Replay traces through a detector and score it against labels
+ *
+ * Scoring is engine-agnostic: the caller steps its detector and reports,
+ * per tick, whether the detector just left IDLE (trigger) and what event
+ * value it output. Each labelled onset is matched to the first trigger
+ * within REPLAY_MATCH_WINDOW_TICKS; unmatched triggers are false positives.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "event_detector.h"
+#include "trace.h"
+
+#define REPLAY_MATCH_WINDOW_TICKS   300     /* 10 min @ 2 s — onset → trigger */
+
+typedef struct {
+    uint8_t        label;       /* Ground-truth litter_event_t */
+    size_t         onset;       /* Sample index of labelled onset */
+    long           trigger;     /* Sample index of IDLE→ACTIVE, −1 if missed */
+    long           classified;  /* Sample index where output became non-NONE, −1 if never */
+    litter_event_t result;      /* Classification output */
+} replay_event_t;
+
+typedef struct {
+    replay_event_t *events;
+    size_t          n_events;
+    size_t          capacity;
+    long            pending;            /* Event awaiting trigger, −1 if none */
+    long            awaiting_class;     /* Triggered event awaiting classification */
+    bool            fp_open;            /* Current detection is a false positive */
+    litter_event_t  last_out;
+    uint32_t        false_positives;
+    size_t          ticks;
+} replay_score_t;
+
+typedef struct {
+    uint32_t events;
+    uint32_t detected;
+    uint32_t correct;               /* Detected and classified as the label */
+    double   trigger_median_s;      /* Onset → ACTIVE */
+    double   trigger_max_s;
+    double   classify_median_s;     /* Onset → event attribute set */
+    double   classify_max_s;
+} replay_type_summary_t;
+
+typedef struct {
+    replay_type_summary_t type[3];  /* Indexed by litter_event_t; [0] = all */
+    uint32_t false_positives;
+    double   precision;             /* correct / (detections) */
+    double   recall;                /* correct / labelled events */
+    double   hours;
+} replay_summary_t;
+
+void replay_score_init(replay_score_t *r);
+void replay_score_free(replay_score_t *r);
+
+/**
+ * @brief Feed one tick of detector output into the scorer.
+ *
+ * @param label      Ground-truth onset label at this tick (0 = none)
+ * @param triggered  Detector entered ACTIVE on this tick
+ * @param out        Event value returned by the detector this tick
+ */
+void replay_score_tick(replay_score_t *r, uint8_t label, bool triggered, litter_event_t out);
+
+void replay_summarize(const replay_score_t *r, uint32_t tick_ms, replay_summary_t *out);
+void replay_print_summary(FILE *f, const char *title, const replay_summary_t *s);
+
+/**
+ * @brief Run the scalar event_detector over a trace's ppm column.
+ */
+void replay_event_detector(const trace_t *t, replay_score_t *r);
+
+/**
+ * @brief Same, with runtime thresholds (cfg must not be NULL).
+ *        Thread-safe: touches only t (read-only), cfg and r.
+ */
+void replay_event_detector_config(const trace_t *t, const event_detector_config_t *cfg,
+                                  replay_score_t *r);
+
+/**
+ * @brief Fill the ppm column of a raw-only trace through the MQ-135 backend
+ *        (whatever backend is selected) with the ADC stub, so recorded raw
+ *        captures replay like live data. Advances the esp_timer clock by
+ *        one tick per sample.
+ */
+bool replay_convert_raw(trace_t *t);
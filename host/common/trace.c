@@ -0,0 +1,272 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * trace.c — CSV trace I/O and synthetic NH₃ trace generator
+ *
+ * Synthetic event shapes follow scripts/gen_nh3_event_pattern.py:
+ *  - Urination:  linear rise over ~0.5 min, then exp decay (τ ≈ 3.5 min)
+ *  - Defecation: linear rise over ~2.5 min, then exp decay (τ ≈ 5 min)
+ */
+#include "trace.h"
+#include "event_detector.h"
+#include "mq135_params.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* ── Container ──────────────────────────────────────────────────────── */
+
+void trace_init(trace_t *t, const char *name)
+{
+    memset(t, 0, sizeof(*t));
+    snprintf(t->name, sizeof(t->name), "%s", name ? name : "trace");
+}
+
+void trace_free(trace_t *t)
+{
+    free(t->samples);
+    t->samples  = NULL;
+    t->count    = 0;
+    t->capacity = 0;
+}
+
+bool trace_push(trace_t *t, const trace_sample_t *s)
+{
+    if (t->count == t->capacity) {
+        size_t cap = t->capacity ? t->capacity * 2 : 4096;
+        trace_sample_t *p = realloc(t->samples, cap * sizeof(*p));
+        if (!p) {
+            return false;
+        }
+        t->samples  = p;
+        t->capacity = cap;
+    }
+    t->samples[t->count++] = *s;
+    return true;
+}
+
+/* ── CSV ────────────────────────────────────────────────────────────── */
+
+enum { COL_T_MS, COL_RAW, COL_PPM, COL_LABEL, COL_COUNT };
+
+bool trace_load_csv(trace_t *t, const char *path)
+{
+    static const char *col_names[COL_COUNT] = { "t_ms", "raw_adc", "ppm", "label" };
+    int  col_of[16];
+    int  ncols = 0;
+    char line[256];
+    size_t lineno = 0;
+
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+
+    const char *base = strrchr(path, '/');
+    trace_init(t, base ? base + 1 : path);
+
+    /* Header */
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        if (line[0] == '#' || line[0] == '\n' || line[0] == '\r') {
+            continue;
+        }
+        for (char *tok = strtok(line, ",\r\n"); tok && ncols < 16; tok = strtok(NULL, ",\r\n")) {
+            col_of[ncols] = -1;
+            for (int c = 0; c < COL_COUNT; c++) {
+                if (strcmp(tok, col_names[c]) == 0) {
+                    col_of[ncols] = c;
+                }
+            }
+            t->has_raw   |= (col_of[ncols] == COL_RAW);
+            t->has_ppm   |= (col_of[ncols] == COL_PPM);
+            t->has_label |= (col_of[ncols] == COL_LABEL);
+            ncols++;
+        }
+        break;
+    }
+    if (!t->has_raw && !t->has_ppm) {
+        fprintf(stderr, "%s: header needs a raw_adc or ppm column\n", path);
+        fclose(f);
+        return false;
+    }
+
+    /* Rows */
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        if (line[0] == '#' || line[0] == '\n' || line[0] == '\r') {
+            continue;
+        }
+        trace_sample_t s = {
+            .t_ms = (uint32_t)(t->count * TRACE_TICK_MS),
+        };
+        char *cursor = line;
+        for (int i = 0; i < ncols && cursor; i++) {
+            char *end = NULL;
+            double v = strtod(cursor, &end);
+            if (end == cursor) {
+                fprintf(stderr, "%s:%zu: bad value in column %d\n", path, lineno, i + 1);
+                fclose(f);
+                return false;
+            }
+            switch (col_of[i]) {
+            case COL_T_MS:  s.t_ms    = (uint32_t)v; break;
+            case COL_RAW:   s.raw_adc = (uint16_t)v; break;
+            case COL_PPM:   s.ppm     = (float)v;    break;
+            case COL_LABEL: s.label   = (uint8_t)v;  break;
+            default: break;
+            }
+            cursor = strchr(end, ',');
+            if (cursor) {
+                cursor++;
+            }
+        }
+        if (!trace_push(t, &s)) {
+            fclose(f);
+            return false;
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+bool trace_save_csv(const trace_t *t, const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    fprintf(f, "t_ms,raw_adc,ppm,label\n");
+    for (size_t i = 0; i < t->count; i++) {
+        const trace_sample_t *s = &t->samples[i];
+        fprintf(f, "%u,%u,%.3f,%u\n", s->t_ms, s->raw_adc, (double)s->ppm, s->label);
+    }
+    return fclose(f) == 0;
+}
+
+/* ── Synthetic generator ────────────────────────────────────────────── */
+
+/* xorshift64* — deterministic across platforms, unlike rand() */
+static uint64_t rng_next(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+double trace_rng_uniform(uint64_t *state)
+{
+    return (double)(rng_next(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+double trace_rng_normal(uint64_t *state)
+{
+    double u1 = trace_rng_uniform(state);
+    double u2 = trace_rng_uniform(state);
+    if (u1 < 1e-300) {
+        u1 = 1e-300;
+    }
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+/* ── Sensor model ───────────────────────────────────────────────────── */
+
+uint16_t trace_ppm_to_raw(float ppm)
+{
+    if (ppm < 0.01f) {
+        ppm = 0.01f;
+    }
+    float rs   = MQ135_R0_KOHM * powf(ppm / MQ135_NH3_CURVE_A, 1.0f / MQ135_NH3_CURVE_B);
+    float aout = MQ135_VCC * MQ135_LOAD_RESISTANCE_KOHM / (rs + MQ135_LOAD_RESISTANCE_KOHM);
+    float raw  = aout / MQ135_DIVIDER_RATIO / MQ135_ADC_VREF * 4095.0f + 0.5f;
+    return (uint16_t)(raw > 4095.0f ? 4095.0f : raw);
+}
+
+trace_synth_cfg_t trace_synth_default(void)
+{
+    trace_synth_cfg_t cfg = {
+        .seed         = 42,
+        .hours        = 24.0,
+        .baseline_ppm = 4.6,    /* Measured clean-air baseline, 2026-02-24 */
+        .noise_ppm    = 0.3,
+        .drift_ppm    = 1.0,
+        .mean_gap_min = 90.0,
+    };
+    return cfg;
+}
+
+/* Event envelope (ppm above baseline) at `elapsed_min` after onset */
+static double event_envelope(double elapsed_min, double peak, double rise_min, double tau_min)
+{
+    if (elapsed_min < 0.0) {
+        return 0.0;
+    }
+    if (elapsed_min < rise_min) {
+        return peak * (elapsed_min / rise_min);
+    }
+    return peak * exp(-(elapsed_min - rise_min) / tau_min);
+}
+
+bool trace_synthesize(trace_t *t, const trace_synth_cfg_t *cfg)
+{
+    uint64_t rng = cfg->seed ? cfg->seed : 1;
+    size_t   n   = (size_t)(cfg->hours * 3600.0 * 1000.0 / TRACE_TICK_MS);
+
+    char name[64];
+    snprintf(name, sizeof(name), "synthetic(seed=%u,%.0fh)", cfg->seed, cfg->hours);
+    trace_init(t, name);
+    t->has_ppm   = true;
+    t->has_label = true;
+
+    /* Active event envelope; a new event is only scheduled once the previous
+     * one has decayed, so labels never overlap. */
+    double ev_onset_min = -1.0, ev_peak = 0.0, ev_rise = 1.0, ev_tau = 1.0;
+    double next_onset_min = 10.0 + trace_rng_uniform(&rng) * cfg->mean_gap_min;
+
+    for (size_t i = 0; i < n; i++) {
+        double t_min = (double)i * TRACE_TICK_MS / 60000.0;
+        trace_sample_t s = { .t_ms = (uint32_t)(i * TRACE_TICK_MS) };
+
+        if (t_min >= next_onset_min) {
+            bool urination = trace_rng_uniform(&rng) < 0.6;
+            ev_onset_min = t_min;
+            if (urination) {
+                ev_peak = 15.0 + trace_rng_uniform(&rng) * 25.0;
+                ev_rise = 0.3 + trace_rng_uniform(&rng) * 0.3;
+                ev_tau  = 2.5 + trace_rng_uniform(&rng) * 2.0;
+            } else {
+                ev_peak = 12.0 + trace_rng_uniform(&rng) * 8.0;
+                ev_rise = 2.0 + trace_rng_uniform(&rng) * 1.5;
+                ev_tau  = 4.0 + trace_rng_uniform(&rng) * 2.0;
+            }
+            s.label = urination ? LITTER_EVENT_URINATION : LITTER_EVENT_DEFECATION;
+            /* Envelope is < 0.1 ppm after rise + 6τ; leave a random gap after that */
+            next_onset_min = t_min + ev_rise + 6.0 * ev_tau
+                           - log(1.0 - trace_rng_uniform(&rng)) * cfg->mean_gap_min;
+        }
+
+        double drift = cfg->drift_ppm * sin(2.0 * M_PI * t_min / (24.0 * 60.0));
+        double ppm   = cfg->baseline_ppm + drift + cfg->noise_ppm * trace_rng_normal(&rng);
+        if (ev_onset_min >= 0.0) {
+            ppm += event_envelope(t_min - ev_onset_min, ev_peak, ev_rise, ev_tau);
+        }
+        s.ppm = (float)(ppm < 0.0 ? 0.0 : ppm);
+
+        if (!trace_push(t, &s)) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,85 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * trace.h — NH₃ sample traces for host-side replay
+ *
+ * A trace is a sequence of 2 s sensor ticks. Each sample carries the raw
+ * ADC value and/or the converted ppm, plus an optional ground-truth label
+ * that marks the tick at which a litter event started (litter_event_t
+ * value; 0 = no onset on this tick).
+ *
+ * CSV format (header required, columns in any order, '#' lines ignored):
+ *   t_ms,raw_adc,ppm,label
+ *   0,953,4.6,0
+ *   2000,951,4.7,0
+ * Either raw_adc or ppm may be omitted; label is optional.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TRACE_TICK_MS   2000    /* Matches SENSOR_SAMPLE_INTERVAL_MS */
+
+typedef struct {
+    uint32_t t_ms;
+    uint16_t raw_adc;
+    float    ppm;
+    uint8_t  label;     /* litter_event_t at event onset, else LITTER_EVENT_NONE */
+} trace_sample_t;
+
+typedef struct {
+    char            name[64];
+    trace_sample_t *samples;
+    size_t          count;
+    size_t          capacity;
+    bool            has_raw;
+    bool            has_ppm;
+    bool            has_label;
+} trace_t;
+
+/* Synthetic trace shape (defaults: see trace_synth_default()) */
+typedef struct {
+    uint32_t seed;
+    double   hours;              /* Trace length */
+    double   baseline_ppm;       /* Clean-air level */
+    double   noise_ppm;          /* Gaussian sample noise (1σ) */
+    double   drift_ppm;          /* Amplitude of slow diurnal baseline drift */
+    double   mean_gap_min;       /* Mean spacing between events */
+} trace_synth_cfg_t;
+
+void trace_init(trace_t *t, const char *name);
+void trace_free(trace_t *t);
+bool trace_push(trace_t *t, const trace_sample_t *s);
+
+/**
+ * @brief Load a CSV trace. Returns false (and prints why) on error.
+ */
+bool trace_load_csv(trace_t *t, const char *path);
+
+/**
+ * @brief Write a trace as CSV (same format trace_load_csv() reads).
+ */
+bool trace_save_csv(const trace_t *t, const char *path);
+
+trace_synth_cfg_t trace_synth_default(void);
+
+/**
+ * @brief Generate a labelled ppm trace with randomly spaced urination
+ *        (fast spike, exponential decay) and defecation (slow rise) events.
+ */
+bool trace_synthesize(trace_t *t, const trace_synth_cfg_t *cfg);
+
+/**
+ * @brief Inverse of the float driver's MQ-135 model (mq135_params.h): the
+ *        raw ADC code that reads back as `ppm`, for feeding a ppm trace
+ *        through air_sensor_read() with the ADC stub.
+ */
+uint16_t trace_ppm_to_raw(float ppm);
+
+/* Deterministic RNG used by the generators (xorshift64*; state must be non-zero) */
+double trace_rng_uniform(uint64_t *state);     /* [0, 1) */
+double trace_rng_normal(uint64_t *state);      /* N(0, 1) */
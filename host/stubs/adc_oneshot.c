@@ -0,0 +1,79 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Host stub — adc_oneshot driven by the replay harness.
+ */
+#include "esp_adc/adc_oneshot.h"
+#include <stddef.h>
+
+#define HOST_ADC_CHANNELS   7
+
+struct adc_oneshot_unit_ctx_t {
+    adc_unit_t unit_id;
+};
+
+static struct adc_oneshot_unit_ctx_t s_units[2];
+static int       s_raw[HOST_ADC_CHANNELS];
+static esp_err_t s_read_err = ESP_OK;
+static esp_err_t s_chan_err[HOST_ADC_CHANNELS];
+
+esp_err_t adc_oneshot_new_unit(const adc_oneshot_unit_init_cfg_t *init_config,
+                               adc_oneshot_unit_handle_t *ret_unit)
+{
+    if (!init_config || !ret_unit || init_config->unit_id > ADC_UNIT_2) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_units[init_config->unit_id].unit_id = init_config->unit_id;
+    *ret_unit = &s_units[init_config->unit_id];
+    return ESP_OK;
+}
+
+esp_err_t adc_oneshot_config_channel(adc_oneshot_unit_handle_t handle, adc_channel_t channel,
+                                     const adc_oneshot_chan_cfg_t *config)
+{
+    if (!handle || !config || channel >= HOST_ADC_CHANNELS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+esp_err_t adc_oneshot_read(adc_oneshot_unit_handle_t handle, adc_channel_t chan, int *out_raw)
+{
+    if (!handle || !out_raw || chan >= HOST_ADC_CHANNELS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_read_err != ESP_OK) {
+        return s_read_err;
+    }
+    if (s_chan_err[chan] != ESP_OK) {
+        return s_chan_err[chan];
+    }
+    *out_raw = s_raw[chan];
+    return ESP_OK;
+}
+
+esp_err_t adc_oneshot_del_unit(adc_oneshot_unit_handle_t handle)
+{
+    return handle ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+void host_adc_set_raw(adc_channel_t chan, int raw)
+{
+    if (chan < HOST_ADC_CHANNELS) {
+        s_raw[chan] = raw;
+    }
+}
+
+void host_adc_set_error(esp_err_t err)
+{
+    s_read_err = err;
+}
+
+void host_adc_set_chan_error(adc_channel_t chan, esp_err_t err)
+{
+    if (chan < HOST_ADC_CHANNELS) {
+        s_chan_err[chan] = err;
+    }
+}
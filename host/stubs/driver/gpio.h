@@ -0,0 +1,42 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Host stub — driver/gpio.h subset: output levels kept in memory.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HOST_GPIO_NUM   32
+
+typedef int gpio_num_t;
+
+typedef enum { GPIO_MODE_DISABLE = 0, GPIO_MODE_INPUT = 1, GPIO_MODE_OUTPUT = 2 } gpio_mode_t;
+typedef enum { GPIO_PULLUP_DISABLE = 0, GPIO_PULLUP_ENABLE = 1 } gpio_pullup_t;
+typedef enum { GPIO_PULLDOWN_DISABLE = 0, GPIO_PULLDOWN_ENABLE = 1 } gpio_pulldown_t;
+typedef enum { GPIO_INTR_DISABLE = 0 } gpio_int_type_t;
+
+typedef struct {
+    uint64_t        pin_bit_mask;
+    gpio_mode_t     mode;
+    gpio_pullup_t   pull_up_en;
+    gpio_pulldown_t pull_down_en;
+    gpio_int_type_t intr_type;
+} gpio_config_t;
+
+esp_err_t gpio_config(const gpio_config_t *cfg);
+esp_err_t gpio_set_level(gpio_num_t gpio, uint32_t level);
+
+/* Last level set on a pin; -1 if it was never configured as an output */
+int host_gpio_get_level(gpio_num_t gpio);
+
+#ifdef __cplusplus
+}
+#endif
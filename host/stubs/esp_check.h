@@ -0,0 +1,40 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Host stub — esp_check.h macros used by the LitterBox.v1 sources.
+ */
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "esp_err.h"
+#include "esp_log.h"
+
+#define ESP_RETURN_ON_ERROR(x, log_tag, format, ...)                        \
+    do {                                                                    \
+        esp_err_t err_rc_ = (x);                                            \
+        if (err_rc_ != ESP_OK) {                                            \
+            ESP_LOGE(log_tag, "%s(%d): " format, __func__, __LINE__, ##__VA_ARGS__); \
+            return err_rc_;                                                 \
+        }                                                                   \
+    } while (0)
+
+#define ESP_RETURN_ON_FALSE(a, err_code, log_tag, format, ...)              \
+    do {                                                                    \
+        if (!(a)) {                                                         \
+            ESP_LOGE(log_tag, "%s(%d): " format, __func__, __LINE__, ##__VA_ARGS__); \
+            return err_code;                                                \
+        }                                                                   \
+    } while (0)
+
+#define ESP_ERROR_CHECK(x)                                                  \
+    do {                                                                    \
+        esp_err_t err_rc_ = (x);                                            \
+        if (err_rc_ != ESP_OK) {                                            \
+            fprintf(stderr, "ESP_ERROR_CHECK failed: %s at %s:%d\n",       \
+                    esp_err_to_name(err_rc_), __FILE__, __LINE__);          \
+            abort();                                                        \
+        }                                                                   \
+    } while (0)
@@ -0,0 +1,24 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Host stub — esp_cpu.h cycle counter on the virtual esp_timer clock.
+ *
+ * Cycles advance only with esp_timer time, at CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+ * so STAGE_BEGIN()/STAGE_END() around code that runs in zero virtual time
+ * record 0 and a simulation stays deterministic.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_timer.h"
+
+#ifndef CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ
+#define CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ     160
+#endif
+
+static inline uint32_t esp_cpu_get_cycle_count(void)
+{
+    return (uint32_t)((uint64_t)esp_timer_get_time() * CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+}
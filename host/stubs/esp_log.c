@@ -0,0 +1,30 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Host stub — esp_log output to stderr, stamped with the virtual clock.
+ */
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <stdarg.h>
+#include <stdio.h>
+
+esp_log_level_t host_log_level = ESP_LOG_WARN;
+
+void host_log_set_level(esp_log_level_t level)
+{
+    host_log_level = level;
+}
+
+void host_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    static const char letters[] = "NEWIDV";
+    va_list args;
+
+    fprintf(stderr, "%c (%" PRId64 ") %s: ", letters[level], esp_timer_get_time() / 1000, tag);
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
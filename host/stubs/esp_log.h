@@ -0,0 +1,51 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Host stub — esp_log.h.
+ *
+ * Log calls are filtered by a runtime level (host_log_set_level()) before
+ * any argument is evaluated, so disabled levels cost one compare — close to
+ * the firmware, where ESP_LOGD is compiled out at the default log level.
+ */
+#pragma once
+
+#include <inttypes.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+extern esp_log_level_t host_log_level;
+
+void host_log_set_level(esp_log_level_t level);
+void host_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+#define HOST_LOG_AT(level, tag, format, ...)                              \
+    do {                                                                  \
+        if (host_log_level >= (level)) {                                  \
+            host_log_write((level), (tag), format, ##__VA_ARGS__);        \
+        }                                                                 \
+    } while (0)
+
+#define ESP_LOGE(tag, format, ...) HOST_LOG_AT(ESP_LOG_ERROR,   tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) HOST_LOG_AT(ESP_LOG_WARN,    tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) HOST_LOG_AT(ESP_LOG_INFO,    tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) HOST_LOG_AT(ESP_LOG_DEBUG,   tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) HOST_LOG_AT(ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
+
+#ifdef __cplusplus
+}
+#endif
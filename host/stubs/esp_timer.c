@@ -0,0 +1,25 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Host stub — virtual esp_timer clock.
+ */
+#include "esp_timer.h"
+
+static int64_t s_now_us = 0;
+
+int64_t esp_timer_get_time(void)
+{
+    return s_now_us;
+}
+
+void host_timer_set_time_us(int64_t now_us)
+{
+    s_now_us = now_us;
+}
+
+void host_timer_advance_us(int64_t delta_us)
+{
+    s_now_us += delta_us;
+}
@@ -0,0 +1,27 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Host stub — esp_timer.h backed by a virtual clock.
+ *
+ * Time only moves when the host harness calls host_timer_set_time_us() or
+ * host_timer_advance_us(), so replays are deterministic and run as fast as
+ * the CPU allows.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int64_t esp_timer_get_time(void);
+
+void host_timer_set_time_us(int64_t now_us);
+void host_timer_advance_us(int64_t delta_us);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,820 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Host stub — mocked Zigbee stack: data model, scheduler on the virtual
+ * clock, commissioning signals, ZCL buffers and a hub that acknowledges
+ * reports (esp_zigbee_core.h).
+ */
+#include "esp_zigbee_core.h"
+#include "ha/esp_zigbee_ha_standard.h"
+#include "zboss_api.h"
+#include "esp_timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HOST_ZB_BUFFERS     8       /* zb_buf_get_out() pool */
+#define HOST_ZB_BUF_BYTES   128     /* One unfragmented APS payload and then some */
+#define HOST_ZB_PARAM_BYTES 64      /* ZB_BUF_GET_PARAM() area */
+#define HOST_ZB_HUB_ADDR    0x0000  /* Coordinator */
+#define HOST_ZB_HUB_EP      1
+
+/* ── Data model ─────────────────────────────────────────────────────── */
+
+typedef struct {
+    uint16_t id;
+    uint8_t  type;
+    uint8_t  access;
+    uint8_t *value;
+    size_t   cap;       /* Storage: fixed by the type, or the initial length of a string */
+    uint32_t sets;
+} host_attr_t;
+
+struct esp_zb_attribute_list_s {
+    uint16_t     cluster_id;
+    host_attr_t *attrs;
+    size_t       n, cap;
+};
+
+typedef struct {
+    esp_zb_attribute_list_t *attrs;
+    uint8_t                  role;
+} host_cluster_t;
+
+struct esp_zb_cluster_list_s {
+    host_cluster_t *clusters;
+    size_t          n, cap;
+};
+
+typedef struct {
+    esp_zb_cluster_list_t   *clusters;
+    esp_zb_endpoint_config_t cfg;
+} host_ep_t;
+
+struct esp_zb_ep_list_s {
+    host_ep_t *eps;
+    size_t     n, cap;
+};
+
+/* ── Scheduler ──────────────────────────────────────────────────────── */
+
+typedef enum { EV_ALARM, EV_HOST, EV_SIGNAL, EV_ACK, EV_REJOIN } host_ev_kind_t;
+
+typedef struct {
+    int64_t           due_us;
+    uint64_t          seq;          /* Queueing order breaks ties */
+    host_ev_kind_t    kind;
+    esp_zb_callback_t cb;
+    uint8_t           param;
+    void            (*fn)(void *ctx);
+    void             *ctx;
+    uint32_t          signal;
+    esp_err_t         status;
+    esp_zb_zcl_cmd_default_resp_message_t ack;
+} host_ev_t;
+
+typedef struct {
+    bool       used;
+    uint8_t    data[HOST_ZB_BUF_BYTES];
+    size_t     off, len;
+    size_t     hdr_len;             /* ZCL header of a received command */
+    _Alignas(8) uint8_t param[HOST_ZB_PARAM_BYTES];
+} host_buf_t;
+
+static host_zb_cfg_t     s_cfg = HOST_ZB_CFG_DEFAULT();
+static host_zb_stats_t   s_stats;
+static esp_zb_ep_list_t *s_device;
+static esp_zb_core_action_callback_t     s_action_cb;
+static esp_zb_zcl_raw_command_callback_t s_raw_cb;
+static host_zb_frame_cb_t s_frame_cb;
+static void             *s_frame_ctx;
+
+static host_ev_t *s_queue;
+static size_t     s_queue_n, s_queue_cap;
+static uint64_t   s_queue_seq;
+
+static host_buf_t s_bufs[HOST_ZB_BUFFERS];
+static uint8_t    s_tsn;
+static uint8_t    s_hub_tsn;
+static uint32_t   s_lock_depth;
+static uint32_t   s_init_fail_left;
+static uint32_t   s_steer_fail_left;
+static bool       s_factory_new;
+static uint64_t   s_rng;
+
+static void *grow(void *p, size_t *cap, size_t n, size_t elem)
+{
+    if (n < *cap) {
+        return p;
+    }
+    *cap = *cap ? *cap * 2 : 8;
+    p = realloc(p, *cap * elem);
+    if (!p) {
+        fprintf(stderr, "esp_zigbee stub: out of memory\n");
+        abort();
+    }
+    return p;
+}
+
+static uint64_t fnv1a(uint64_t h, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    while (len--) {
+        h = (h ^ *p++) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/* xorshift64*: the loss pattern depends only on the seed and the frame order */
+static bool chance_permille(uint16_t permille)
+{
+    s_rng ^= s_rng >> 12;
+    s_rng ^= s_rng << 25;
+    s_rng ^= s_rng >> 27;
+    return (uint32_t)((s_rng * 0x2545F4914F6CDD1DULL) >> 32) % 1000 < permille;
+}
+
+static bool in_outage(int64_t t_us)
+{
+    return s_cfg.outage_us > 0 && t_us >= s_cfg.outage_at_us && t_us < s_cfg.outage_at_us + s_cfg.outage_us;
+}
+
+static host_ev_t *queue_add(int64_t due_us, host_ev_kind_t kind)
+{
+    s_queue = grow(s_queue, &s_queue_cap, s_queue_n, sizeof(*s_queue));
+    host_ev_t *ev = &s_queue[s_queue_n++];
+    *ev = (host_ev_t){ .due_us = due_us, .seq = s_queue_seq++, .kind = kind };
+    return ev;
+}
+
+static void queue_signal(int64_t due_us, esp_zb_app_signal_type_t signal, esp_err_t status)
+{
+    host_ev_t *ev = queue_add(due_us, EV_SIGNAL);
+    ev->signal = signal;
+    ev->status = status;
+}
+
+void host_zb_configure(const host_zb_cfg_t *cfg)
+{
+    s_cfg = *cfg;
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_stats.joined_us   = -1;
+    s_stats.frame_hash  = 0xcbf29ce484222325ULL;
+    s_stats.attr_hash   = 0xcbf29ce484222325ULL;
+    s_queue_n           = 0;
+    s_lock_depth        = 0;
+    s_init_fail_left    = cfg->init_failures;
+    s_steer_fail_left   = cfg->steering_failures;
+    s_factory_new       = cfg->factory_new;
+    s_rng               = cfg->seed ? cfg->seed : 1;
+    memset(s_bufs, 0, sizeof(s_bufs));
+    if (cfg->outage_us > 0) {
+        queue_add(cfg->outage_at_us + cfg->outage_us, EV_REJOIN);
+    }
+}
+
+const host_zb_stats_t *host_zb_stats(void)
+{
+    return &s_stats;
+}
+
+void host_zb_set_frame_hook(host_zb_frame_cb_t cb, void *ctx)
+{
+    s_frame_cb  = cb;
+    s_frame_ctx = ctx;
+}
+
+void host_zb_at(int64_t t_us, void (*fn)(void *ctx), void *ctx)
+{
+    host_ev_t *ev = queue_add(t_us, EV_HOST);
+    ev->fn  = fn;
+    ev->ctx = ctx;
+}
+
+/* ── Attribute lists ────────────────────────────────────────────────── */
+
+static size_t attr_type_size(uint8_t type, const uint8_t *value)
+{
+    switch (type) {
+    case ESP_ZB_ZCL_ATTR_TYPE_BOOL:
+    case ESP_ZB_ZCL_ATTR_TYPE_U8:
+        return 1;
+    case ESP_ZB_ZCL_ATTR_TYPE_U16:
+        return 2;
+    case ESP_ZB_ZCL_ATTR_TYPE_U32:
+        return 4;
+    case ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING:
+    case ESP_ZB_ZCL_ATTR_TYPE_CHAR_STRING:
+        return value ? 1u + value[0] : 1;
+    default:
+        return 0;
+    }
+}
+
+esp_zb_attribute_list_t *esp_zb_zcl_attr_list_create(uint16_t cluster_id)
+{
+    esp_zb_attribute_list_t *l = calloc(1, sizeof(*l));
+    if (l) {
+        l->cluster_id = cluster_id;
+    }
+    return l;
+}
+
+static host_attr_t *attr_find(esp_zb_attribute_list_t *l, uint16_t attr_id)
+{
+    for (size_t i = 0; i < l->n; i++) {
+        if (l->attrs[i].id == attr_id) {
+            return &l->attrs[i];
+        }
+    }
+    return NULL;
+}
+
+static esp_err_t attr_add(esp_zb_attribute_list_t *l, uint16_t attr_id, uint8_t type, uint8_t access, const void *value_p)
+{
+    size_t size = attr_type_size(type, value_p);
+    if (!l || !value_p || size == 0 || attr_find(l, attr_id)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    l->attrs = grow(l->attrs, &l->cap, l->n, sizeof(*l->attrs));
+    host_attr_t *a = &l->attrs[l->n++];
+    *a = (host_attr_t){ .id = attr_id, .type = type, .access = access, .value = malloc(size), .cap = size };
+    memcpy(a->value, value_p, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_zb_custom_cluster_add_custom_attr(esp_zb_attribute_list_t *attr_list, uint16_t attr_id, uint8_t attr_type,
+                                                uint8_t attr_access, void *value_p)
+{
+    return attr_add(attr_list, attr_id, attr_type, attr_access, value_p);
+}
+
+esp_zb_attribute_list_t *esp_zb_basic_cluster_create(esp_zb_basic_cluster_cfg_t *basic_cfg)
+{
+    esp_zb_attribute_list_t *l = esp_zb_zcl_attr_list_create(ESP_ZB_ZCL_CLUSTER_ID_BASIC);
+    attr_add(l, ESP_ZB_ZCL_ATTR_BASIC_ZCL_VERSION_ID, ESP_ZB_ZCL_ATTR_TYPE_U8, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY,
+             &basic_cfg->zcl_version);
+    attr_add(l, ESP_ZB_ZCL_ATTR_BASIC_POWER_SOURCE_ID, ESP_ZB_ZCL_ATTR_TYPE_U8, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY,
+             &basic_cfg->power_source);
+    return l;
+}
+
+esp_err_t esp_zb_basic_cluster_add_attr(esp_zb_attribute_list_t *attr_list, uint16_t attr_id, void *value_p)
+{
+    return attr_add(attr_list, attr_id, ESP_ZB_ZCL_ATTR_TYPE_CHAR_STRING, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, value_p);
+}
+
+esp_zb_attribute_list_t *esp_zb_identify_cluster_create(esp_zb_identify_cluster_cfg_t *identify_cfg)
+{
+    esp_zb_attribute_list_t *l = esp_zb_zcl_attr_list_create(ESP_ZB_ZCL_CLUSTER_ID_IDENTIFY);
+    attr_add(l, ESP_ZB_ZCL_ATTR_IDENTIFY_IDENTIFY_TIME_ID, ESP_ZB_ZCL_ATTR_TYPE_U16, ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE,
+             &identify_cfg->identify_time);
+    return l;
+}
+
+esp_zb_attribute_list_t *esp_zb_on_off_cluster_create(esp_zb_on_off_cluster_cfg_t *on_off_cfg)
+{
+    esp_zb_attribute_list_t *l = esp_zb_zcl_attr_list_create(ESP_ZB_ZCL_CLUSTER_ID_ON_OFF);
+    uint8_t on_off = on_off_cfg->on_off;
+    attr_add(l, ESP_ZB_ZCL_ATTR_ON_OFF_ON_OFF_ID, ESP_ZB_ZCL_ATTR_TYPE_BOOL,
+             ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &on_off);
+    return l;
+}
+
+esp_zb_cluster_list_t *esp_zb_zcl_cluster_list_create(void)
+{
+    return calloc(1, sizeof(esp_zb_cluster_list_t));
+}
+
+esp_err_t esp_zb_cluster_list_add_custom_cluster(esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list,
+                                                 uint8_t role_mask)
+{
+    if (!cluster_list || !attr_list) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (size_t i = 0; i < cluster_list->n; i++) {
+        const host_cluster_t *c = &cluster_list->clusters[i];
+        if (c->attrs->cluster_id == attr_list->cluster_id && c->role == role_mask) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    cluster_list->clusters = grow(cluster_list->clusters, &cluster_list->cap, cluster_list->n,
+                                  sizeof(*cluster_list->clusters));
+    cluster_list->clusters[cluster_list->n++] = (host_cluster_t){ .attrs = attr_list, .role = role_mask };
+    return ESP_OK;
+}
+
+esp_err_t esp_zb_cluster_list_add_basic_cluster(esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list,
+                                                uint8_t role_mask)
+{
+    return esp_zb_cluster_list_add_custom_cluster(cluster_list, attr_list, role_mask);
+}
+
+esp_err_t esp_zb_cluster_list_add_identify_cluster(esp_zb_cluster_list_t *cluster_list,
+                                                   esp_zb_attribute_list_t *attr_list, uint8_t role_mask)
+{
+    return esp_zb_cluster_list_add_custom_cluster(cluster_list, attr_list, role_mask);
+}
+
+esp_err_t esp_zb_cluster_list_add_on_off_cluster(esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list,
+                                                 uint8_t role_mask)
+{
+    return esp_zb_cluster_list_add_custom_cluster(cluster_list, attr_list, role_mask);
+}
+
+esp_zb_ep_list_t *esp_zb_ep_list_create(void)
+{
+    return calloc(1, sizeof(esp_zb_ep_list_t));
+}
+
+esp_err_t esp_zb_ep_list_add_ep(esp_zb_ep_list_t *ep_list, esp_zb_cluster_list_t *cluster_list,
+                                esp_zb_endpoint_config_t endpoint_config)
+{
+    if (!ep_list || !cluster_list) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    ep_list->eps = grow(ep_list->eps, &ep_list->cap, ep_list->n, sizeof(*ep_list->eps));
+    ep_list->eps[ep_list->n++] = (host_ep_t){ .clusters = cluster_list, .cfg = endpoint_config };
+    return ESP_OK;
+}
+
+esp_err_t esp_zb_device_register(esp_zb_ep_list_t *ep_list)
+{
+    if (!ep_list) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_device = ep_list;
+    return ESP_OK;
+}
+
+static host_attr_t *device_attr(uint8_t endpoint, uint16_t cluster_id, uint8_t role, uint16_t attr_id)
+{
+    if (!s_device) {
+        return NULL;
+    }
+    for (size_t e = 0; e < s_device->n; e++) {
+        const host_ep_t *ep = &s_device->eps[e];
+        if (ep->cfg.endpoint != endpoint) {
+            continue;
+        }
+        for (size_t c = 0; c < ep->clusters->n; c++) {
+            const host_cluster_t *cl = &ep->clusters->clusters[c];
+            if (cl->attrs->cluster_id == cluster_id && cl->role == role) {
+                return attr_find(cl->attrs, attr_id);
+            }
+        }
+    }
+    return NULL;
+}
+
+esp_zb_zcl_status_t esp_zb_zcl_set_attribute_val(uint8_t endpoint, uint16_t cluster_id, uint8_t cluster_role,
+                                                 uint16_t attr_id, void *value_p, bool check)
+{
+    host_attr_t *a = device_attr(endpoint, cluster_id, cluster_role, attr_id);
+    size_t size = a ? attr_type_size(a->type, value_p) : 0;
+    /* A string longer than its registered storage is refused, as on the device */
+    if (!a || !value_p || size > a->cap) {
+        s_stats.attr_set_errors++;
+        return a ? ESP_ZB_ZCL_STATUS_INVALID_TYPE : ESP_ZB_ZCL_STATUS_UNSUP_ATTRIB;
+    }
+    memcpy(a->value, value_p, size);
+    a->sets++;
+    s_stats.attr_sets++;
+
+    int64_t now_us = esp_timer_get_time();
+    uint64_t h = s_stats.attr_hash;
+    h = fnv1a(h, &now_us, sizeof(now_us));
+    h = fnv1a(h, &endpoint, sizeof(endpoint));
+    h = fnv1a(h, &cluster_id, sizeof(cluster_id));
+    h = fnv1a(h, &attr_id, sizeof(attr_id));
+    s_stats.attr_hash = fnv1a(h, value_p, size);
+    return ESP_ZB_ZCL_STATUS_SUCCESS;
+}
+
+bool host_zb_attr_get(uint8_t ep, uint16_t cluster_id, uint16_t attr_id, host_zb_attr_t *out)
+{
+    const host_attr_t *a = device_attr(ep, cluster_id, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, attr_id);
+    if (!a) {
+        return false;
+    }
+    *out = (host_zb_attr_t){ .type = a->type, .value = a->value, .size = attr_type_size(a->type, a->value),
+                             .sets = a->sets };
+    return true;
+}
+
+/* ── Stack, commissioning, scheduler ────────────────────────────────── */
+
+esp_err_t esp_zb_platform_config(esp_zb_platform_config_t *config)
+{
+    return config ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+void esp_zb_init(esp_zb_cfg_t *nwk_cfg)
+{
+}
+
+esp_err_t esp_zb_set_primary_network_channel_set(uint32_t channel_mask)
+{
+    return channel_mask & ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+void esp_zb_core_action_handler_register(esp_zb_core_action_callback_t cb)
+{
+    s_action_cb = cb;
+}
+
+void esp_zb_raw_command_handler_register(esp_zb_zcl_raw_command_callback_t cb)
+{
+    s_raw_cb = cb;
+}
+
+esp_err_t esp_zb_start(bool autostart)
+{
+    int64_t now_us = esp_timer_get_time();
+    if (autostart) {
+        return esp_zb_bdb_start_top_level_commissioning(ESP_ZB_BDB_MODE_INITIALIZATION);
+    }
+    queue_signal(now_us, ESP_ZB_ZDO_SIGNAL_SKIP_STARTUP, ESP_OK);
+    return ESP_OK;
+}
+
+esp_err_t esp_zb_bdb_start_top_level_commissioning(uint8_t mode_mask)
+{
+    int64_t now_us = esp_timer_get_time();
+    s_stats.commissioning++;
+    if (mode_mask & ESP_ZB_BDB_MODE_NETWORK_STEERING) {
+        bool fail = s_steer_fail_left > 0 || in_outage(now_us);
+        if (s_steer_fail_left > 0) {
+            s_steer_fail_left--;
+        }
+        queue_signal(now_us + (int64_t)s_cfg.steering_ms * 1000, ESP_ZB_BDB_SIGNAL_STEERING, fail ? ESP_FAIL : ESP_OK);
+    } else {
+        bool fail = s_init_fail_left > 0;
+        if (fail) {
+            s_init_fail_left--;
+        }
+        queue_signal(now_us, s_factory_new ? ESP_ZB_BDB_SIGNAL_DEVICE_FIRST_START : ESP_ZB_BDB_SIGNAL_DEVICE_REBOOT,
+                     fail ? ESP_FAIL : ESP_OK);
+    }
+    return ESP_OK;
+}
+
+bool esp_zb_bdb_is_factory_new(void)
+{
+    return s_factory_new;
+}
+
+const char *esp_zb_zdo_signal_to_string(esp_zb_app_signal_type_t signal)
+{
+    switch (signal) {
+    case ESP_ZB_ZDO_SIGNAL_DEFAULT_START:      return "ZDO_SIGNAL_DEFAULT_START";
+    case ESP_ZB_ZDO_SIGNAL_SKIP_STARTUP:       return "ZDO_SIGNAL_SKIP_STARTUP";
+    case ESP_ZB_ZDO_SIGNAL_DEVICE_ANNCE:       return "ZDO_SIGNAL_DEVICE_ANNCE";
+    case ESP_ZB_ZDO_SIGNAL_LEAVE:              return "ZDO_SIGNAL_LEAVE";
+    case ESP_ZB_ZDO_SIGNAL_ERROR:              return "ZDO_SIGNAL_ERROR";
+    case ESP_ZB_BDB_SIGNAL_DEVICE_FIRST_START: return "BDB_SIGNAL_DEVICE_FIRST_START";
+    case ESP_ZB_BDB_SIGNAL_DEVICE_REBOOT:      return "BDB_SIGNAL_DEVICE_REBOOT";
+    case ESP_ZB_BDB_SIGNAL_STEERING:           return "BDB_SIGNAL_STEERING";
+    case ESP_ZB_BDB_SIGNAL_FORMATION:          return "BDB_SIGNAL_FORMATION";
+    }
+    return "Unknown";
+}
+
+void esp_zb_scheduler_alarm(esp_zb_callback_t cb, uint8_t param, uint32_t time_ms)
+{
+    host_ev_t *ev = queue_add(esp_timer_get_time() + (int64_t)time_ms * 1000, EV_ALARM);
+    ev->cb    = cb;
+    ev->param = param;
+    s_stats.alarms++;
+}
+
+bool esp_zb_lock_acquire(TickType_t block_ticks)
+{
+    s_stats.lock_acquires++;
+    if (++s_lock_depth > s_stats.lock_depth_max) {
+        s_stats.lock_depth_max = s_lock_depth;
+    }
+    return true;
+}
+
+void esp_zb_lock_release(void)
+{
+    s_stats.lock_releases++;
+    if (s_lock_depth > 0) {
+        s_lock_depth--;
+    }
+}
+
+void esp_zb_get_extended_pan_id(esp_zb_ieee_addr_t ext_pan_id)
+{
+    static const esp_zb_ieee_addr_t ext = { 0x4c, 0x42, 0x48, 0x4f, 0x53, 0x54, 0x00, 0x01 };
+    memcpy(ext_pan_id, ext, sizeof(ext));
+}
+
+uint16_t esp_zb_get_pan_id(void)
+{
+    return 0x1a62;
+}
+
+uint8_t esp_zb_get_current_channel(void)
+{
+    return 15;
+}
+
+uint16_t esp_zb_get_short_address(void)
+{
+    return 0x4f2a;
+}
+
+static void deliver_signal(uint32_t signal, esp_err_t status)
+{
+    if (status == ESP_OK && (signal == ESP_ZB_BDB_SIGNAL_STEERING || signal == ESP_ZB_BDB_SIGNAL_DEVICE_REBOOT)) {
+        s_factory_new = false;
+        if (s_stats.joined_us < 0) {
+            s_stats.joined_us = esp_timer_get_time();
+        }
+    }
+    esp_zb_app_signal_t sig = { .p_app_signal = &signal, .esp_err_status = status };
+    s_stats.signals++;
+    esp_zb_app_signal_handler(&sig);
+}
+
+static void deliver_ack(const esp_zb_zcl_cmd_default_resp_message_t *ack)
+{
+    if (in_outage(esp_timer_get_time()) || chance_permille(s_cfg.loss_permille)) {
+        s_stats.acks_lost++;
+        return;
+    }
+    s_stats.acks++;
+    if (s_action_cb) {
+        s_action_cb(ESP_ZB_CORE_CMD_DEFAULT_RESP_CB_ID, ack);
+    }
+}
+
+void esp_zb_stack_main_loop(void)
+{
+    while (s_queue_n > 0) {
+        size_t next = 0;
+        for (size_t i = 1; i < s_queue_n; i++) {
+            const host_ev_t *a = &s_queue[i], *b = &s_queue[next];
+            if (a->due_us < b->due_us || (a->due_us == b->due_us && a->seq < b->seq)) {
+                next = i;
+            }
+        }
+        if (s_queue[next].due_us > s_cfg.run_us) {
+            break;
+        }
+        host_ev_t ev = s_queue[next];
+        s_queue[next] = s_queue[--s_queue_n];
+        if (ev.due_us > esp_timer_get_time()) {
+            host_timer_set_time_us(ev.due_us);
+        }
+
+        switch (ev.kind) {
+        case EV_ALARM:
+            s_stats.alarms_run++;
+            ev.cb(ev.param);
+            break;
+        case EV_HOST:
+            ev.fn(ev.ctx);
+            break;
+        case EV_SIGNAL:
+            deliver_signal(ev.signal, ev.status);
+            break;
+        case EV_ACK:
+            deliver_ack(&ev.ack);
+            break;
+        case EV_REJOIN:
+            /* Parent back: the stack rejoins and reports it like a steering */
+            deliver_signal(ESP_ZB_BDB_SIGNAL_STEERING, ESP_OK);
+            break;
+        }
+    }
+    host_timer_set_time_us(s_cfg.run_us);
+}
+
+/* ── Buffers and frames ─────────────────────────────────────────────── */
+
+static host_buf_t *buf_of(zb_bufid_t buf)
+{
+    if (buf == ZB_BUF_INVALID || buf > HOST_ZB_BUFFERS || !s_bufs[buf - 1].used) {
+        fprintf(stderr, "esp_zigbee stub: bad buffer %u\n", buf);
+        abort();
+    }
+    return &s_bufs[buf - 1];
+}
+
+zb_bufid_t zb_buf_get_out(void)
+{
+    for (int i = 0; i < HOST_ZB_BUFFERS; i++) {
+        if (!s_bufs[i].used) {
+            memset(&s_bufs[i], 0, sizeof(s_bufs[i]));
+            s_bufs[i].used = true;
+            return (zb_bufid_t)(i + 1);
+        }
+    }
+    s_stats.buf_exhausted++;
+    return ZB_BUF_INVALID;
+}
+
+static void buf_free(zb_bufid_t buf)
+{
+    buf_of(buf)->used = false;
+}
+
+void *zb_buf_begin(zb_bufid_t buf)
+{
+    host_buf_t *b = buf_of(buf);
+    return b->data + b->off;
+}
+
+zb_uint_t zb_buf_len(zb_bufid_t buf)
+{
+    return (zb_uint_t)buf_of(buf)->len;
+}
+
+void *zb_buf_initial_alloc(zb_bufid_t buf, zb_uint_t size)
+{
+    host_buf_t *b = buf_of(buf);
+    b->off = 0;
+    b->len = size;
+    return b->data;
+}
+
+void *zb_buf_get_tail(zb_bufid_t buf, zb_uint_t size)
+{
+    if (size > HOST_ZB_PARAM_BYTES) {
+        fprintf(stderr, "esp_zigbee stub: %u-byte buffer parameter\n", size);
+        abort();
+    }
+    return buf_of(buf)->param;
+}
+
+void zb_zcl_cut_header(zb_bufid_t buf)
+{
+    host_buf_t *b = buf_of(buf);
+    b->off += b->hdr_len;
+    b->len -= b->hdr_len;
+    b->hdr_len = 0;
+}
+
+zb_uint8_t zb_zcl_get_next_seq_num(void)
+{
+    return s_tsn++;
+}
+
+void zb_zcl_finish_packet(zb_bufid_t buf, zb_uint8_t *end)
+{
+    host_buf_t *b = buf_of(buf);
+    size_t len = (size_t)(end - (b->data + b->off));
+    if (end < b->data + b->off || len > sizeof(b->data) - b->off) {
+        fprintf(stderr, "esp_zigbee stub: %zu-byte frame overflows the buffer\n", len);
+        abort();
+    }
+    b->len = len;
+}
+
+void zb_zcl_send_command_short(zb_bufid_t buf, zb_uint16_t addr, zb_uint8_t addr_mode, zb_uint8_t dst_ep,
+                               zb_uint8_t ep, zb_uint16_t profile_id, zb_uint16_t cluster_id, zb_callback_t cb)
+{
+    host_buf_t *b = buf_of(buf);
+    int64_t now_us = esp_timer_get_time();
+    host_zb_frame_t f = {
+        .t_us       = now_us,
+        .dst_addr   = addr,
+        .src_ep     = ep,
+        .dst_ep     = dst_ep,
+        .profile_id = profile_id,
+        .cluster_id = cluster_id,
+        .data       = b->data + b->off,
+        .len        = b->len,
+        .lost       = in_outage(now_us) || chance_permille(s_cfg.loss_permille),
+    };
+
+    s_stats.frames++;
+    s_stats.frames_lost += f.lost;
+    uint64_t h = s_stats.frame_hash;
+    h = fnv1a(h, &now_us, sizeof(now_us));
+    h = fnv1a(h, &addr, sizeof(addr));
+    h = fnv1a(h, &ep, sizeof(ep));
+    h = fnv1a(h, &dst_ep, sizeof(dst_ep));
+    h = fnv1a(h, &cluster_id, sizeof(cluster_id));
+    s_stats.frame_hash = fnv1a(h, f.data, f.len);
+
+    /* Header: frame control, [manufacturer code], sequence number, command */
+    size_t hdr = (f.len && (f.data[0] & 0x04)) ? 5 : 3;
+    if (f.len >= hdr) {
+        uint8_t fc = f.data[0], tsn = f.data[hdr - 2], cmd = f.data[hdr - 1];
+        bool common = (fc & 0x03) == ZB_ZCL_FRAME_TYPE_COMMON;
+        if (common && cmd == 0x0A) {
+            s_stats.frames_report++;
+        }
+        /* The hub answers what asks for a Default Response */
+        if (!f.lost && addr == HOST_ZB_HUB_ADDR && !(fc & 0x10)) {
+            host_ev_t *ev = queue_add(now_us + (int64_t)s_cfg.ack_delay_ms * 1000, EV_ACK);
+            ev->ack = (esp_zb_zcl_cmd_default_resp_message_t){
+                .info = {
+                    .status       = ESP_ZB_ZCL_STATUS_SUCCESS,
+                    .header       = { .fc = 0x18, .tsn = tsn },
+                    .src_address  = HOST_ZB_HUB_ADDR,
+                    .src_endpoint = dst_ep,
+                    .dst_endpoint = ep,
+                    .cluster      = cluster_id,
+                    .profile      = profile_id,
+                },
+                .resp_to_cmd = cmd,
+                .status_code = ESP_ZB_ZCL_STATUS_SUCCESS,
+            };
+        }
+    }
+
+    if (s_frame_cb) {
+        s_frame_cb(&f, s_frame_ctx);
+    }
+    buf_free(buf);
+    if (cb) {
+        cb(buf);
+    }
+}
+
+void zb_zcl_send_default_resp(zb_bufid_t buf, zb_uint16_t addr, zb_uint8_t addr_mode, zb_uint8_t dst_ep,
+                              zb_uint8_t ep, zb_uint16_t profile_id, zb_uint16_t cluster_id, zb_uint8_t tsn,
+                              zb_uint8_t cmd_id, zb_uint8_t status)
+{
+    zb_uint8_t *p = ZB_ZCL_START_PACKET(buf);
+    ZB_ZCL_CONSTRUCT_GENERAL_COMMAND_RESP_FRAME_CONTROL_A(p, ZB_ZCL_FRAME_DIRECTION_TO_CLI, ZB_FALSE);
+    ZB_ZCL_CONSTRUCT_COMMAND_HEADER(p, tsn, ZB_ZCL_CMD_DEFAULT_RESP);
+    *p++ = cmd_id;
+    *p++ = status;
+    ZB_ZCL_FINISH_PACKET(buf, p);
+    zb_zcl_send_command_short(buf, addr, addr_mode, dst_ep, ep, profile_id, cluster_id, NULL);
+}
+
+/* ── Hub → device ───────────────────────────────────────────────────── */
+
+esp_err_t host_zb_hub_command(uint8_t dst_ep, uint16_t cluster_id, bool common, uint8_t cmd_id,
+                              const uint8_t *payload, size_t len)
+{
+    zb_bufid_t buf = zb_buf_get_out();
+    if (buf == ZB_BUF_INVALID) {
+        return ESP_ERR_NO_MEM;
+    }
+    host_buf_t *b = buf_of(buf);
+    uint8_t tsn = s_hub_tsn++;
+    if (3 + len > sizeof(b->data)) {
+        buf_free(buf);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    b->data[0] = ZB_ZCL_CONSTRUCT_FRAME_CONTROL(common ? ZB_ZCL_FRAME_TYPE_COMMON : ZB_ZCL_FRAME_TYPE_CLUSTER_SPECIFIC,
+                                               ZB_FALSE, ZB_ZCL_FRAME_DIRECTION_TO_SRV, ZB_FALSE);
+    b->data[1] = tsn;
+    b->data[2] = cmd_id;
+    memcpy(&b->data[3], payload, len);
+    b->len     = 3 + len;
+    b->hdr_len = 3;
+
+    zb_zcl_parsed_hdr_t *hdr = ZB_BUF_GET_PARAM(buf, zb_zcl_parsed_hdr_t);
+    *hdr = (zb_zcl_parsed_hdr_t){
+        .addr_data.common_data = {
+            .source.u.short_addr = HOST_ZB_HUB_ADDR,
+            .dst_addr            = esp_zb_get_short_address(),
+            .src_endpoint        = HOST_ZB_HUB_EP,
+            .dst_endpoint        = dst_ep,
+            .fc                  = b->data[0],
+        },
+        .cluster_id        = cluster_id,
+        .profile_id        = ESP_ZB_AF_HA_PROFILE_ID,
+        .cmd_id            = cmd_id,
+        .cmd_direction     = ZB_ZCL_FRAME_DIRECTION_TO_SRV,
+        .seq_number        = tsn,
+        .is_common_command = common,
+    };
+
+    s_stats.raw_cmds++;
+    if (s_raw_cb && s_raw_cb(buf)) {
+        return ESP_OK;      /* The handler answered in the same buffer */
+    }
+    s_stats.raw_cmds_unhandled++;
+    buf_free(buf);
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t host_zb_hub_write_attr(uint8_t dst_ep, uint16_t cluster_id, uint16_t attr_id, uint8_t type,
+                                 const void *value, uint16_t size)
+{
+    host_attr_t *a = device_attr(dst_ep, cluster_id, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, attr_id);
+    if (!a) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (a->type != type || size > a->cap) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memcpy(a->value, value, size);
+    esp_zb_zcl_set_attr_value_message_t msg = {
+        .info      = { .status = ESP_ZB_ZCL_STATUS_SUCCESS, .dst_endpoint = dst_ep, .cluster = cluster_id },
+        .attribute = { .id = attr_id, .data = { .type = type, .size = size, .value = a->value } },
+    };
+    return s_action_cb ? s_action_cb(ESP_ZB_CORE_SET_ATTR_VALUE_CB_ID, &msg) : ESP_OK;
+}
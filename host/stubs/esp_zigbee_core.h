@@ -0,0 +1,377 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Host stub — esp_zigbee_core.h subset backed by a mocked Zigbee stack.
+ *
+ * Enough of esp-zigbee-lib for main.c to build and run its own control
+ * flow on Linux (host/stubs/esp_zigbee.c):
+ *
+ *  - Endpoints, clusters and attributes are kept as registered. Every
+ *    esp_zb_zcl_set_attribute_val() is checked against them, stored and
+ *    counted; one on an attribute that was never registered is an error.
+ *  - esp_zb_scheduler_alarm() queues callbacks on the virtual esp_timer
+ *    clock. esp_zb_stack_main_loop() runs them in time order (ties in
+ *    queueing order) until host_zb_cfg_t.run_us, then returns.
+ *  - Commissioning raises the BDB signals the real stack would, after
+ *    failing the first init_failures / steering_failures attempts.
+ *  - Frames sent with ZB_ZCL_SEND_COMMAND_SHORT() (zboss_api.h) reach a hub
+ *    model that answers Report Attributes with a Default Response after
+ *    ack_delay_ms. A seeded share of frames is lost, and during an outage
+ *    everything is; a rejoin (STEERING signal) ends the outage.
+ *
+ * Callbacks run on the caller's stack and take no virtual time. The
+ * host_zb_* functions configure the mock, act as the hub and read back
+ * what the firmware did.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ── Stack and network ──────────────────────────────────────────────── */
+
+typedef uint8_t esp_zb_ieee_addr_t[8];
+typedef void (*esp_zb_callback_t)(uint8_t param);
+
+typedef enum {
+    ESP_ZB_DEVICE_TYPE_COORDINATOR = 0x00,
+    ESP_ZB_DEVICE_TYPE_ROUTER      = 0x01,
+    ESP_ZB_DEVICE_TYPE_ED          = 0x02,
+    ESP_ZB_DEVICE_TYPE_NONE        = 0x03,
+} esp_zb_nwk_device_type_t;
+
+typedef enum {
+    ESP_ZB_ED_AGING_TIMEOUT_10SEC = 0,
+    ESP_ZB_ED_AGING_TIMEOUT_2MIN,
+    ESP_ZB_ED_AGING_TIMEOUT_4MIN,
+    ESP_ZB_ED_AGING_TIMEOUT_8MIN,
+    ESP_ZB_ED_AGING_TIMEOUT_16MIN,
+    ESP_ZB_ED_AGING_TIMEOUT_32MIN,
+    ESP_ZB_ED_AGING_TIMEOUT_64MIN,
+} esp_zb_aging_timeout_t;
+
+typedef struct {
+    esp_zb_aging_timeout_t ed_timeout;
+    uint32_t               keep_alive;     /* ms */
+} esp_zb_zed_cfg_t;
+
+typedef struct {
+    uint8_t max_children;
+} esp_zb_zczr_cfg_t;
+
+typedef struct {
+    esp_zb_nwk_device_type_t esp_zb_role;
+    bool                     install_code_policy;
+    union {
+        esp_zb_zczr_cfg_t zczr_cfg;
+        esp_zb_zed_cfg_t  zed_cfg;
+    } nwk_cfg;
+} esp_zb_cfg_t;
+
+typedef enum { ZB_RADIO_MODE_NATIVE = 0, ZB_RADIO_MODE_UART_RCP } esp_zb_radio_mode_t;
+typedef enum { ZB_HOST_CONNECTION_MODE_NONE = 0, ZB_HOST_CONNECTION_MODE_RCP_UART } esp_zb_host_connection_mode_t;
+
+typedef struct { esp_zb_radio_mode_t radio_mode; } esp_zb_radio_config_t;
+typedef struct { esp_zb_host_connection_mode_t host_connection_mode; } esp_zb_host_config_t;
+
+typedef struct {
+    esp_zb_radio_config_t radio_config;
+    esp_zb_host_config_t  host_config;
+} esp_zb_platform_config_t;
+
+#define ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK    0x07FFF800U     /* Channels 11..26 */
+
+typedef enum {
+    ESP_ZB_BDB_MODE_INITIALIZATION    = 0x00,
+    ESP_ZB_BDB_MODE_TOUCHLINK_COMMISSIONING = 0x01,
+    ESP_ZB_BDB_MODE_NETWORK_STEERING  = 0x02,
+    ESP_ZB_BDB_MODE_NETWORK_FORMATION = 0x04,
+} esp_zb_bdb_commissioning_mode_t;
+
+typedef enum {
+    ESP_ZB_ZDO_SIGNAL_DEFAULT_START      = 0x00,
+    ESP_ZB_ZDO_SIGNAL_SKIP_STARTUP       = 0x01,
+    ESP_ZB_ZDO_SIGNAL_DEVICE_ANNCE       = 0x02,
+    ESP_ZB_ZDO_SIGNAL_LEAVE              = 0x03,
+    ESP_ZB_ZDO_SIGNAL_ERROR              = 0x04,
+    ESP_ZB_BDB_SIGNAL_DEVICE_FIRST_START = 0x05,
+    ESP_ZB_BDB_SIGNAL_DEVICE_REBOOT      = 0x06,
+    ESP_ZB_BDB_SIGNAL_STEERING           = 0x0A,
+    ESP_ZB_BDB_SIGNAL_FORMATION          = 0x0B,
+} esp_zb_app_signal_type_t;
+
+typedef struct {
+    uint32_t *p_app_signal;     /* esp_zb_app_signal_type_t */
+    esp_err_t esp_err_status;
+} esp_zb_app_signal_t;
+
+/* Defined by the application */
+void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_s);
+
+esp_err_t   esp_zb_platform_config(esp_zb_platform_config_t *config);
+void        esp_zb_init(esp_zb_cfg_t *nwk_cfg);
+esp_err_t   esp_zb_set_primary_network_channel_set(uint32_t channel_mask);
+esp_err_t   esp_zb_start(bool autostart);
+void        esp_zb_stack_main_loop(void);
+esp_err_t   esp_zb_bdb_start_top_level_commissioning(uint8_t mode_mask);
+bool        esp_zb_bdb_is_factory_new(void);
+const char *esp_zb_zdo_signal_to_string(esp_zb_app_signal_type_t signal);
+void        esp_zb_scheduler_alarm(esp_zb_callback_t cb, uint8_t param, uint32_t time_ms);
+bool        esp_zb_lock_acquire(TickType_t block_ticks);
+void        esp_zb_lock_release(void);
+
+void        esp_zb_get_extended_pan_id(esp_zb_ieee_addr_t ext_pan_id);
+uint16_t    esp_zb_get_pan_id(void);
+uint8_t     esp_zb_get_current_channel(void);
+uint16_t    esp_zb_get_short_address(void);
+
+/* ── ZCL data model ─────────────────────────────────────────────────── */
+
+#define ESP_ZB_AF_HA_PROFILE_ID                         0x0104
+#define ESP_ZB_HA_CUSTOM_ATTR_DEVICE_ID                 0xFFF2
+
+typedef enum {
+    ESP_ZB_ZCL_CLUSTER_SERVER_ROLE = 0x01,
+    ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE = 0x02,
+} esp_zb_zcl_cluster_role_t;
+
+#define ESP_ZB_ZCL_CLUSTER_ID_BASIC                     0x0000
+#define ESP_ZB_ZCL_CLUSTER_ID_IDENTIFY                  0x0003
+#define ESP_ZB_ZCL_CLUSTER_ID_ON_OFF                    0x0006
+
+#define ESP_ZB_ZCL_ATTR_BASIC_ZCL_VERSION_ID            0x0000
+#define ESP_ZB_ZCL_ATTR_BASIC_MANUFACTURER_NAME_ID      0x0004
+#define ESP_ZB_ZCL_ATTR_BASIC_MODEL_IDENTIFIER_ID       0x0005
+#define ESP_ZB_ZCL_ATTR_BASIC_POWER_SOURCE_ID           0x0007
+#define ESP_ZB_ZCL_ATTR_IDENTIFY_IDENTIFY_TIME_ID       0x0000
+#define ESP_ZB_ZCL_ATTR_ON_OFF_ON_OFF_ID                0x0000
+
+#define ESP_ZB_ZCL_BASIC_ZCL_VERSION_DEFAULT_VALUE      0x08
+#define ESP_ZB_ZCL_IDENTIFY_IDENTIFY_TIME_DEFAULT_VALUE 0x0000
+
+typedef enum {
+    ESP_ZB_ZCL_ATTR_TYPE_BOOL         = 0x10,
+    ESP_ZB_ZCL_ATTR_TYPE_U8           = 0x20,
+    ESP_ZB_ZCL_ATTR_TYPE_U16          = 0x21,
+    ESP_ZB_ZCL_ATTR_TYPE_U32          = 0x23,
+    ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING = 0x41,
+    ESP_ZB_ZCL_ATTR_TYPE_CHAR_STRING  = 0x42,
+} esp_zb_zcl_attr_type_t;
+
+typedef enum {
+    ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY  = 0x01,
+    ESP_ZB_ZCL_ATTR_ACCESS_WRITE_ONLY = 0x02,
+    ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE = 0x03,
+    ESP_ZB_ZCL_ATTR_ACCESS_REPORTING  = 0x04,
+} esp_zb_zcl_attr_access_t;
+
+typedef enum {
+    ESP_ZB_ZCL_STATUS_SUCCESS      = 0x00,
+    ESP_ZB_ZCL_STATUS_FAIL         = 0x01,
+    ESP_ZB_ZCL_STATUS_UNSUP_ATTRIB = 0x86,
+    ESP_ZB_ZCL_STATUS_INVALID_TYPE = 0x8D,
+} esp_zb_zcl_status_t;
+
+/* Opaque here: built and walked only by the stack */
+typedef struct esp_zb_attribute_list_s esp_zb_attribute_list_t;
+typedef struct esp_zb_cluster_list_s   esp_zb_cluster_list_t;
+typedef struct esp_zb_ep_list_s        esp_zb_ep_list_t;
+
+typedef struct {
+    uint8_t  endpoint;
+    uint16_t app_profile_id;
+    uint16_t app_device_id;
+    uint32_t app_device_version;
+} esp_zb_endpoint_config_t;
+
+esp_zb_attribute_list_t *esp_zb_zcl_attr_list_create(uint16_t cluster_id);
+esp_err_t esp_zb_custom_cluster_add_custom_attr(esp_zb_attribute_list_t *attr_list, uint16_t attr_id, uint8_t attr_type,
+                                                uint8_t attr_access, void *value_p);
+esp_zb_cluster_list_t *esp_zb_zcl_cluster_list_create(void);
+esp_err_t esp_zb_cluster_list_add_custom_cluster(esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list,
+                                                 uint8_t role_mask);
+esp_zb_ep_list_t *esp_zb_ep_list_create(void);
+esp_err_t esp_zb_ep_list_add_ep(esp_zb_ep_list_t *ep_list, esp_zb_cluster_list_t *cluster_list,
+                                esp_zb_endpoint_config_t endpoint_config);
+esp_err_t esp_zb_device_register(esp_zb_ep_list_t *ep_list);
+
+esp_zb_zcl_status_t esp_zb_zcl_set_attribute_val(uint8_t endpoint, uint16_t cluster_id, uint8_t cluster_role,
+                                                 uint16_t attr_id, void *value_p, bool check);
+
+/* ── Action callbacks ───────────────────────────────────────────────── */
+
+typedef enum {
+    ESP_ZB_CORE_SET_ATTR_VALUE_CB_ID   = 0x0000,
+    ESP_ZB_CORE_CMD_DEFAULT_RESP_CB_ID = 0x1005,
+} esp_zb_core_action_callback_id_t;
+
+typedef struct {
+    esp_zb_zcl_status_t status;
+    uint8_t             dst_endpoint;
+    uint16_t            cluster;
+} esp_zb_device_cb_common_info_t;
+
+typedef struct {
+    esp_zb_zcl_attr_type_t type;
+    uint16_t               size;
+    void                  *value;
+} esp_zb_zcl_attribute_data_t;
+
+typedef struct {
+    uint16_t                    id;
+    esp_zb_zcl_attribute_data_t data;
+} esp_zb_zcl_attribute_t;
+
+typedef struct {
+    esp_zb_device_cb_common_info_t info;
+    esp_zb_zcl_attribute_t         attribute;
+} esp_zb_zcl_set_attr_value_message_t;
+
+typedef struct {
+    uint8_t  fc;
+    uint16_t manuf_code;
+    uint8_t  tsn;
+    int8_t   rssi;
+} esp_zb_zcl_frame_header_t;
+
+typedef struct {
+    esp_zb_zcl_status_t       status;
+    esp_zb_zcl_frame_header_t header;
+    uint16_t                  src_address;      /* Short address */
+    uint16_t                  dst_address;
+    uint8_t                   src_endpoint;
+    uint8_t                   dst_endpoint;
+    uint16_t                  cluster;
+    uint16_t                  profile;
+} esp_zb_zcl_cmd_info_t;
+
+typedef struct {
+    esp_zb_zcl_cmd_info_t info;
+    uint8_t               resp_to_cmd;
+    esp_zb_zcl_status_t   status_code;
+} esp_zb_zcl_cmd_default_resp_message_t;
+
+typedef esp_err_t (*esp_zb_core_action_callback_t)(esp_zb_core_action_callback_id_t callback_id, const void *message);
+typedef bool (*esp_zb_zcl_raw_command_callback_t)(uint8_t bufid);
+
+void esp_zb_core_action_handler_register(esp_zb_core_action_callback_t cb);
+void esp_zb_raw_command_handler_register(esp_zb_zcl_raw_command_callback_t cb);
+
+/* ── Host control ───────────────────────────────────────────────────── */
+
+typedef struct {
+    int64_t  run_us;                /* esp_zb_stack_main_loop() returns at this esp_timer time */
+    bool     factory_new;           /* No saved network: steer after the first start */
+    uint32_t init_failures;         /* First start / reboot signals that fail before one succeeds */
+    uint32_t steering_failures;     /* Steering attempts that fail before the join */
+    uint32_t steering_ms;           /* Duration of one steering attempt */
+    uint32_t ack_delay_ms;          /* Hub's Default Response to a Report Attributes frame */
+    uint16_t loss_permille;         /* Frames lost in either direction, seeded */
+    uint64_t seed;
+    int64_t  outage_at_us;          /* Hub unreachable from here ... */
+    int64_t  outage_us;             /* ... for this long (0: never), then the device rejoins */
+} host_zb_cfg_t;
+
+#define HOST_ZB_CFG_DEFAULT() {                                         \
+        .run_us = 3600LL * 1000000, .factory_new = true,                \
+        .init_failures = 0, .steering_failures = 0, .steering_ms = 3000, \
+        .ack_delay_ms = 100, .loss_permille = 0, .seed = 1,             \
+        .outage_at_us = 0, .outage_us = 0 }
+
+typedef struct {
+    uint32_t signals;               /* esp_zb_app_signal_handler() calls */
+    uint32_t commissioning;         /* esp_zb_bdb_start_top_level_commissioning() calls */
+    int64_t  joined_us;             /* First successful steering or reboot, -1 if never */
+    uint32_t alarms;                /* esp_zb_scheduler_alarm() calls */
+    uint32_t alarms_run;
+    uint32_t lock_acquires;
+    uint32_t lock_releases;
+    uint32_t lock_depth_max;
+    uint32_t attr_sets;
+    uint32_t attr_set_errors;       /* Unregistered endpoint / cluster / attribute */
+    uint32_t frames;                /* Every ZB_ZCL_SEND_*: sent over the air */
+    uint32_t frames_report;         /* ... of them Report Attributes */
+    uint32_t frames_lost;           /* ... not received by the hub */
+    uint32_t acks;                  /* Default Responses delivered to the application */
+    uint32_t acks_lost;
+    uint32_t buf_exhausted;         /* zb_buf_get_out() found no free buffer */
+    uint32_t raw_cmds;              /* Hub commands offered to the raw handler ... */
+    uint32_t raw_cmds_unhandled;    /* ... and left to the stack */
+    uint64_t frame_hash;            /* FNV-1a over time, addressing and bytes of every frame */
+    uint64_t attr_hash;             /* ... over time, address and value of every attribute set */
+} host_zb_stats_t;
+
+/* Frame as sent by the device: ZCL header and payload */
+typedef struct {
+    int64_t        t_us;
+    uint16_t       dst_addr;
+    uint8_t        src_ep;
+    uint8_t        dst_ep;
+    uint16_t       profile_id;
+    uint16_t       cluster_id;
+    const uint8_t *data;
+    size_t         len;
+    bool           lost;            /* The hub will not see it */
+} host_zb_frame_t;
+
+typedef void (*host_zb_frame_cb_t)(const host_zb_frame_t *frame, void *ctx);
+
+/* Current value of a registered attribute */
+typedef struct {
+    uint8_t        type;
+    const uint8_t *value;           /* Octet strings: length byte first */
+    size_t         size;
+    uint32_t       sets;            /* esp_zb_zcl_set_attribute_val() calls on it */
+} host_zb_attr_t;
+
+/**
+ * @brief Configure the mock and clear its counters; call before esp_zb_init().
+ */
+void host_zb_configure(const host_zb_cfg_t *cfg);
+
+const host_zb_stats_t *host_zb_stats(void);
+
+/**
+ * @brief Call cb for every frame the device sends, lost ones included.
+ */
+void host_zb_set_frame_hook(host_zb_frame_cb_t cb, void *ctx);
+
+/**
+ * @brief Run fn(ctx) in the Zigbee task at esp_timer time t_us (hub actions).
+ */
+void host_zb_at(int64_t t_us, void (*fn)(void *ctx), void *ctx);
+
+/**
+ * @brief Hub → device ZCL command, offered to the raw command handler like
+ *        a received frame. The device's answer goes through the frame hook.
+ *
+ * @return ESP_ERR_NOT_SUPPORTED if the handler left it to the stack.
+ */
+esp_err_t host_zb_hub_command(uint8_t dst_ep, uint16_t cluster_id, bool common, uint8_t cmd_id,
+                              const uint8_t *payload, size_t len);
+
+/**
+ * @brief Hub writes an attribute: stored, then ESP_ZB_CORE_SET_ATTR_VALUE_CB_ID.
+ *
+ * @return ESP_ERR_NOT_FOUND if it is not registered, else the handler's result.
+ */
+esp_err_t host_zb_hub_write_attr(uint8_t dst_ep, uint16_t cluster_id, uint16_t attr_id, uint8_t type,
+                                 const void *value, uint16_t size);
+
+/**
+ * @brief Look up a server attribute. false if it is not registered.
+ */
+bool host_zb_attr_get(uint8_t ep, uint16_t cluster_id, uint16_t attr_id, host_zb_attr_t *out);
+
+#ifdef __cplusplus
+}
+#endif
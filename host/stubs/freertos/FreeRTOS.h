@@ -0,0 +1,24 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Host stub — freertos/FreeRTOS.h subset: tick and base types, conversions.
+ */
+#pragma once
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int32_t  BaseType_t;
+typedef uint32_t UBaseType_t;
+
+#define pdFALSE                 ((BaseType_t)0)
+#define pdTRUE                  ((BaseType_t)1)
+#define pdFAIL                  pdFALSE
+#define pdPASS                  pdTRUE
+#define portMAX_DELAY           ((TickType_t)0xFFFFFFFFUL)
+
+#define configTICK_RATE_HZ      100
+#define portTICK_PERIOD_MS      (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)((uint64_t)(ms) * configTICK_RATE_HZ / 1000))
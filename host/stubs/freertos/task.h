@@ -0,0 +1,31 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Host stub — freertos/task.h subset.
+ *
+ * There is no scheduler: vTaskDelay() moves the virtual esp_timer clock
+ * forward by the delay, so a task waiting on a backend completes on time
+ * without sleeping. xTaskCreate() runs the task function on the caller's
+ * stack until it returns, so a task is only usable if something it calls
+ * ends the run (host/stubs/esp_zigbee.c: esp_zb_stack_main_loop()).
+ */
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*TaskFunction_t)(void *arg);
+typedef void *TaskHandle_t;
+
+void vTaskDelay(TickType_t ticks);
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                       UBaseType_t priority, TaskHandle_t *created);
+
+#ifdef __cplusplus
+}
+#endif
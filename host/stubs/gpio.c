@@ -0,0 +1,42 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Host stub — GPIO output levels.
+ */
+#include "driver/gpio.h"
+#include <stdbool.h>
+
+static bool    s_output[HOST_GPIO_NUM];
+static uint8_t s_level[HOST_GPIO_NUM];
+
+esp_err_t gpio_config(const gpio_config_t *cfg)
+{
+    if (!cfg || (cfg->pin_bit_mask >> HOST_GPIO_NUM)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < HOST_GPIO_NUM; i++) {
+        if (cfg->pin_bit_mask & (1ULL << i)) {
+            s_output[i] = cfg->mode == GPIO_MODE_OUTPUT;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio, uint32_t level)
+{
+    if (gpio < 0 || gpio >= HOST_GPIO_NUM) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_level[gpio] = level ? 1 : 0;
+    return ESP_OK;
+}
+
+int host_gpio_get_level(gpio_num_t gpio)
+{
+    if (gpio < 0 || gpio >= HOST_GPIO_NUM || !s_output[gpio]) {
+        return -1;
+    }
+    return s_level[gpio];
+}
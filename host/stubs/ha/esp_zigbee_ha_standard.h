@@ -0,0 +1,46 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Host stub — ha/esp_zigbee_ha_standard.h subset: the standard clusters
+ * main.c creates, as plain attribute lists (host/stubs/esp_zigbee.c).
+ */
+#pragma once
+
+#include "esp_zigbee_core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint8_t zcl_version;
+    uint8_t power_source;
+} esp_zb_basic_cluster_cfg_t;
+
+typedef struct {
+    uint16_t identify_time;
+} esp_zb_identify_cluster_cfg_t;
+
+typedef struct {
+    bool on_off;
+} esp_zb_on_off_cluster_cfg_t;
+
+esp_zb_attribute_list_t *esp_zb_basic_cluster_create(esp_zb_basic_cluster_cfg_t *basic_cfg);
+esp_zb_attribute_list_t *esp_zb_identify_cluster_create(esp_zb_identify_cluster_cfg_t *identify_cfg);
+esp_zb_attribute_list_t *esp_zb_on_off_cluster_create(esp_zb_on_off_cluster_cfg_t *on_off_cfg);
+
+/* ZCL strings: length byte first */
+esp_err_t esp_zb_basic_cluster_add_attr(esp_zb_attribute_list_t *attr_list, uint16_t attr_id, void *value_p);
+
+esp_err_t esp_zb_cluster_list_add_basic_cluster(esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list,
+                                                uint8_t role_mask);
+esp_err_t esp_zb_cluster_list_add_identify_cluster(esp_zb_cluster_list_t *cluster_list,
+                                                   esp_zb_attribute_list_t *attr_list, uint8_t role_mask);
+esp_err_t esp_zb_cluster_list_add_on_off_cluster(esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list,
+                                                 uint8_t role_mask);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,133 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Host stub — in-memory NVS blobs.
+ */
+#include "nvs.h"
+#include "nvs_flash.h"
+#include <stdbool.h>
+#include <string.h>
+
+#define HOST_NVS_NAMESPACES 8
+#define HOST_NVS_ENTRIES    32
+#define HOST_NVS_BLOB_MAX   4000    /* Largest single-page blob on the device */
+#define HOST_NVS_NAME_MAX   16      /* NVS key/namespace limit incl. NUL */
+
+typedef struct {
+    bool     used;
+    uint32_t ns;
+    char     key[HOST_NVS_NAME_MAX];
+    uint8_t  data[HOST_NVS_BLOB_MAX];
+    size_t   length;
+} host_nvs_entry_t;
+
+static char             s_namespaces[HOST_NVS_NAMESPACES][HOST_NVS_NAME_MAX];
+static host_nvs_entry_t s_entries[HOST_NVS_ENTRIES];
+static uint32_t         s_writes;
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    if (!namespace_name || !out_handle || strlen(namespace_name) >= HOST_NVS_NAME_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (uint32_t i = 0; i < HOST_NVS_NAMESPACES; i++) {
+        if (s_namespaces[i][0] == '\0') {
+            strcpy(s_namespaces[i], namespace_name);
+        }
+        if (strcmp(s_namespaces[i], namespace_name) == 0) {
+            *out_handle = i + 1;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+}
+
+static host_nvs_entry_t *find_entry(nvs_handle_t handle, const char *key)
+{
+    for (int i = 0; i < HOST_NVS_ENTRIES; i++) {
+        if (s_entries[i].used && s_entries[i].ns == handle && strcmp(s_entries[i].key, key) == 0) {
+            return &s_entries[i];
+        }
+    }
+    return NULL;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    host_nvs_entry_t *e = find_entry(handle, key);
+    if (!e) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (!out_value) {
+        *length = e->length;
+        return ESP_OK;
+    }
+    if (*length < e->length) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    memcpy(out_value, e->data, e->length);
+    *length = e->length;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    if (!key || strlen(key) >= HOST_NVS_NAME_MAX || length > HOST_NVS_BLOB_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    host_nvs_entry_t *e = find_entry(handle, key);
+    for (int i = 0; !e && i < HOST_NVS_ENTRIES; i++) {
+        if (!s_entries[i].used) {
+            e = &s_entries[i];
+            e->used = true;
+            e->ns   = handle;
+            strcpy(e->key, key);
+        }
+    }
+    if (!e) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(e->data, value, length);
+    e->length = length;
+    s_writes++;
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    host_nvs_entry_t *e = find_entry(handle, key);
+    if (!e) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    e->used = false;
+    s_writes++;
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return ESP_OK;
+}
+
+void host_nvs_erase_all(void)
+{
+    memset(s_entries, 0, sizeof(s_entries));
+    memset(s_namespaces, 0, sizeof(s_namespaces));
+    s_writes = 0;
+}
+
+uint32_t host_nvs_write_count(void)
+{
+    return s_writes;
+}
+
+esp_err_t nvs_flash_init(void)
+{
+    return ESP_OK;
+}
@@ -0,0 +1,43 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Host stub — nvs.h blob subset, backed by a small in-memory table.
+ *
+ * The table survives "reboots" simulated by the harness (it is only cleared
+ * by host_nvs_erase_all()), and counts committed writes so tools can report
+ * flash wear.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NVS_KEY_NAME_MAX_SIZE   16      /* Including the terminating NUL */
+
+typedef uint32_t nvs_handle_t;
+
+typedef enum {
+    NVS_READONLY,
+    NVS_READWRITE,
+} nvs_open_mode_t;
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle);
+void      nvs_close(nvs_handle_t handle);
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length);
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length);
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key);
+esp_err_t nvs_commit(nvs_handle_t handle);
+
+void     host_nvs_erase_all(void);
+uint32_t host_nvs_write_count(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,21 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Host stub — nvs_flash.h: the in-memory NVS of nvs.h needs no partition.
+ */
+#pragma once
+
+#include "esp_err.h"
+#include "nvs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t nvs_flash_init(void);
+
+#ifdef __cplusplus
+}
+#endif
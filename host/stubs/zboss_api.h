@@ -0,0 +1,146 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Host stub — zboss_api.h subset: buffers and the ZCL frame macros main.c
+ * uses to build raw frames. Frames are built byte for byte as on the
+ * device (frame control, manufacturer code, sequence number, command);
+ * sending hands them to the mocked stack (host/stubs/esp_zigbee.c).
+ */
+#pragma once
+
+#include <string.h>
+#include "esp_zigbee_core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint8_t  zb_uint8_t;
+typedef uint16_t zb_uint16_t;
+typedef uint32_t zb_uint32_t;
+typedef uint32_t zb_uint_t;
+typedef uint8_t  zb_bool_t;
+typedef uint8_t  zb_bufid_t;
+typedef void (*zb_callback_t)(zb_uint8_t param);
+
+#define ZB_FALSE                            ((zb_bool_t)0)
+#define ZB_TRUE                             ((zb_bool_t)1)
+
+#define ZB_BUF_INVALID                      ((zb_bufid_t)0)
+#define ZB_APS_ADDR_MODE_16_ENDP_PRESENT    0x02
+#define ZB_AF_HA_PROFILE_ID                 0x0104
+
+/* ── Buffers ────────────────────────────────────────────────────────── */
+
+zb_bufid_t zb_buf_get_out(void);
+void      *zb_buf_begin(zb_bufid_t buf);
+zb_uint_t  zb_buf_len(zb_bufid_t buf);
+void      *zb_buf_initial_alloc(zb_bufid_t buf, zb_uint_t size);
+void      *zb_buf_get_tail(zb_bufid_t buf, zb_uint_t size);
+
+#define ZB_BUF_GET_PARAM(buf, type)         ((type *)zb_buf_get_tail((buf), sizeof(type)))
+
+/* ── Received command header ────────────────────────────────────────── */
+
+typedef struct {
+    union {
+        zb_uint16_t short_addr;
+        zb_uint8_t  ieee_addr[8];
+    } u;
+} zb_zcl_addr_t;
+
+typedef struct {
+    zb_zcl_addr_t source;
+    zb_uint16_t   dst_addr;
+    zb_uint8_t    src_endpoint;
+    zb_uint8_t    dst_endpoint;
+    zb_uint8_t    fc;
+} zb_zcl_addressing_t;
+
+typedef struct {
+    union {
+        zb_zcl_addressing_t common_data;
+    } addr_data;
+    zb_uint16_t cluster_id;
+    zb_uint16_t profile_id;
+    zb_uint8_t  cmd_id;
+    zb_uint8_t  cmd_direction;
+    zb_uint8_t  seq_number;
+    zb_bool_t   is_common_command;
+    zb_bool_t   disable_default_response;
+    zb_bool_t   is_manuf_specific;
+    zb_uint16_t manuf_specific;
+} zb_zcl_parsed_hdr_t;
+
+#define ZB_ZCL_PARSED_HDR_SHORT_DATA(header)    ((header)->addr_data.common_data)
+
+/* Drop the ZCL header of a received command, leaving its payload */
+void zb_zcl_cut_header(zb_bufid_t buf);
+#define ZB_ZCL_CUT_HEADER(buf)                  zb_zcl_cut_header(buf)
+
+/* ── Frame construction ─────────────────────────────────────────────── */
+
+#define ZB_ZCL_FRAME_TYPE_COMMON                0
+#define ZB_ZCL_FRAME_TYPE_CLUSTER_SPECIFIC      1
+#define ZB_ZCL_FRAME_DIRECTION_TO_SRV           0
+#define ZB_ZCL_FRAME_DIRECTION_TO_CLI           1
+#define ZB_ZCL_NOT_MANUFACTURER_SPECIFIC        ZB_FALSE
+#define ZB_ZCL_MANUFACTURER_SPECIFIC            ZB_TRUE
+#define ZB_ZCL_ENABLE_DEFAULT_RESPONSE          ZB_FALSE    /* The frame control bit disables it */
+#define ZB_ZCL_DISABLE_DEFAULT_RESPONSE         ZB_TRUE
+#define ZB_ZCL_CMD_DEFAULT_RESP                 0x0B
+
+#define ZB_ZCL_CONSTRUCT_FRAME_CONTROL(type, manuf, direction, disable_resp) \
+    ((zb_uint8_t)((type) | ((manuf) ? 0x04 : 0) | ((direction) ? 0x08 : 0) | ((disable_resp) ? 0x10 : 0)))
+
+#define ZB_ZCL_CONSTRUCT_GENERAL_COMMAND_REQ_FRAME_CONTROL_A(ptr, direction, is_manuf, def_resp) \
+    (*(ptr)++ = ZB_ZCL_CONSTRUCT_FRAME_CONTROL(ZB_ZCL_FRAME_TYPE_COMMON, is_manuf, direction, def_resp))
+#define ZB_ZCL_CONSTRUCT_GENERAL_COMMAND_RESP_FRAME_CONTROL_A(ptr, direction, is_manuf) \
+    (*(ptr)++ = ZB_ZCL_CONSTRUCT_FRAME_CONTROL(ZB_ZCL_FRAME_TYPE_COMMON, is_manuf, direction, ZB_TRUE))
+#define ZB_ZCL_CONSTRUCT_SPECIFIC_COMMAND_RES_FRAME_CONTROL_A(ptr, direction, is_manuf) \
+    (*(ptr)++ = ZB_ZCL_CONSTRUCT_FRAME_CONTROL(ZB_ZCL_FRAME_TYPE_CLUSTER_SPECIFIC, is_manuf, direction, ZB_TRUE))
+
+#define ZB_ZCL_CONSTRUCT_COMMAND_HEADER(ptr, tsn, cmd_id)   \
+    do {                                                    \
+        *(ptr)++ = (zb_uint8_t)(tsn);                       \
+        *(ptr)++ = (zb_uint8_t)(cmd_id);                    \
+    } while (0)
+
+#define ZB_ZCL_CONSTRUCT_COMMAND_HEADER_EXT(ptr, tsn, is_manuf, manuf_code, cmd_id) \
+    do {                                                    \
+        if (is_manuf) {                                     \
+            *(ptr)++ = (zb_uint8_t)(manuf_code);            \
+            *(ptr)++ = (zb_uint8_t)((manuf_code) >> 8);     \
+        }                                                   \
+        *(ptr)++ = (zb_uint8_t)(tsn);                       \
+        *(ptr)++ = (zb_uint8_t)(cmd_id);                    \
+    } while (0)
+
+#define ZB_ZCL_PACKET_PUT_DATA_N(ptr, data, n)  \
+    do {                                        \
+        memcpy((ptr), (data), (n));             \
+        (ptr) += (n);                           \
+    } while (0)
+
+zb_uint8_t zb_zcl_get_next_seq_num(void);
+void       zb_zcl_finish_packet(zb_bufid_t buf, zb_uint8_t *end);
+void       zb_zcl_send_command_short(zb_bufid_t buf, zb_uint16_t addr, zb_uint8_t addr_mode, zb_uint8_t dst_ep,
+                                     zb_uint8_t ep, zb_uint16_t profile_id, zb_uint16_t cluster_id, zb_callback_t cb);
+void       zb_zcl_send_default_resp(zb_bufid_t buf, zb_uint16_t addr, zb_uint8_t addr_mode, zb_uint8_t dst_ep,
+                                    zb_uint8_t ep, zb_uint16_t profile_id, zb_uint16_t cluster_id, zb_uint8_t tsn,
+                                    zb_uint8_t cmd_id, zb_uint8_t status);
+
+#define ZB_ZCL_GET_SEQ_NUM()                    zb_zcl_get_next_seq_num()
+#define ZB_ZCL_START_PACKET(buf)                ((zb_uint8_t *)zb_buf_initial_alloc((buf), 0))
+#define ZB_ZCL_FINISH_PACKET(buf, ptr)          zb_zcl_finish_packet((buf), (ptr))
+#define ZB_ZCL_SEND_COMMAND_SHORT(buf, addr, addr_mode, dst_ep, ep, profile_id, cluster_id, cb) \
+    zb_zcl_send_command_short((buf), (addr), (addr_mode), (dst_ep), (ep), (profile_id), (cluster_id), (cb))
+#define ZB_ZCL_SEND_DEFAULT_RESP(buf, addr, addr_mode, dst_ep, ep, profile_id, cluster_id, tsn, cmd_id, status) \
+    zb_zcl_send_default_resp((buf), (addr), (addr_mode), (dst_ep), (ep), (profile_id), (cluster_id), (tsn), \
+                             (cmd_id), (status))
+
+#ifdef __cplusplus
+}
+#endif
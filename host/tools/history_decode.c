@@ -0,0 +1,120 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * history_decode.c — Dumped history partition (CONFIG_LITTERBOX_HISTORY_LOG) → CSV
+ *
+ * Reads history.bin (history_dump.ps1) and writes one CSV row per logged
+ * sample, oldest first, with ppm recomputed from raw by the driver. The
+ * columns use the trace.h names, so the CSV loads into detector_bench /
+ * param_sweep (add a label column to score it):
+ *   t_ms,boot,tick,raw_adc,ppm,state,event,warmup,invalid
+ * t_ms counts rows (one tick each); boot and tick give the device's clock.
+ * Unlike detector_bench --history, warmup and invalid samples are kept.
+ *
+ * A summary (days covered, bits/sample, boots, damaged blocks) goes to stderr.
+ *
+ * Usage: history_decode DUMP [OUT.csv]
+ */
+#include "history_reader.h"
+#include "replay.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    history_sample_t s;
+    uint8_t          boot;
+} row_t;
+
+typedef struct {
+    row_t  *rows;
+    size_t  n, cap;
+    bool    ok;
+} rows_t;
+
+static void collect_block(void *arg, const history_block_info_t *info, const history_sample_t *samples)
+{
+    rows_t *r = arg;
+    if (r->n + info->count > r->cap) {
+        size_t cap = r->cap ? r->cap * 2 : 1 << 16;
+        row_t *grown = realloc(r->rows, cap * sizeof(*grown));
+        if (!grown) {
+            r->ok = false;
+            return;
+        }
+        r->rows = grown;
+        r->cap  = cap;
+    }
+    for (uint16_t i = 0; i < info->count; i++) {
+        r->rows[r->n++] = (row_t) { .s = samples[i], .boot = info->boot };
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2 || argc > 3 || argv[1][0] == '-') {
+        fprintf(stderr, "Usage: %s DUMP [OUT.csv]\n", argv[0]);
+        return 2;
+    }
+    const char *in_path = argv[1], *out_path = argc > 2 ? argv[2] : NULL;
+
+    history_image_t img;
+    if (!history_image_open(&img, in_path)) {
+        return 1;
+    }
+    rows_t rows = { .ok = true };
+    history_load_stats_t st = {0};
+    esp_err_t err = history_read(&img.flash, collect_block, &rows, &st.read);
+    history_image_close(&img);
+    if (err != ESP_OK || !rows.ok || rows.n == 0) {
+        fprintf(stderr, "%s: no history samples (%s)\n", in_path, rows.ok ? esp_err_to_name(err) : "out of memory");
+        free(rows.rows);
+        return 1;
+    }
+
+    /* ppm through the driver, as the firmware computed it */
+    trace_t t;
+    trace_init(&t, in_path);
+    for (size_t i = 0; i < rows.n; i++) {
+        trace_sample_t ts = { .t_ms = (uint32_t)(i * TRACE_TICK_MS), .raw_adc = rows.rows[i].s.raw };
+        if (!trace_push(&t, &ts)) {
+            free(rows.rows);
+            trace_free(&t);
+            return 1;
+        }
+    }
+    t.has_raw = true;
+    if (!replay_convert_raw(&t)) {
+        free(rows.rows);
+        trace_free(&t);
+        return 1;
+    }
+
+    FILE *out = out_path ? fopen(out_path, "w") : stdout;
+    if (!out) {
+        perror(out_path);
+        free(rows.rows);
+        trace_free(&t);
+        return 1;
+    }
+    fprintf(out, "t_ms,boot,tick,raw_adc,ppm,state,event,warmup,invalid\n");
+    for (size_t i = 0; i < rows.n; i++) {
+        const history_sample_t *s = &rows.rows[i].s;
+        bool invalid = s->state & TRACE_FLAG_INVALID;
+        st.held += (s->state & (TRACE_FLAG_WARMUP | TRACE_FLAG_INVALID)) ? 1 : 0;
+        fprintf(out, "%llu,%u,%u,%u,%.4f,%u,%u,%u,%u\n",
+                (unsigned long long)i * TRACE_TICK_MS, rows.rows[i].boot, s->tick, s->raw,
+                invalid ? 0.0 : (double)t.samples[i].ppm, s->state & TRACE_STATE_MASK, s->event,
+                (s->state & TRACE_FLAG_WARMUP) ? 1 : 0, invalid ? 1 : 0);
+    }
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    history_print_stats(stderr, in_path, &st);
+    free(rows.rows);
+    trace_free(&t);
+    return 0;
+}
@@ -0,0 +1,465 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * param_sweep.c — Parallel search over event detector thresholds
+ *
+ * Every configuration is replayed through event_detector_update() (with
+ * runtime thresholds) over all labelled traces and scored by replay.c.
+ * Configurations are independent: worker threads pull them from a shared
+ * atomic counter and write to their own result slot, and the traces are
+ * read-only, so throughput scales with cores.
+ *
+ * Parameters (name=value or name=lo:hi:step):
+ *   trigger      EVENT_TRIGGER_DELTA_PPM      hysteresis  EVENT_HYSTERESIS_PPM
+ *   alpha        BASELINE_ALPHA               urine_delta URINE_PEAK_DELTA_PPM
+ *   fast_peak    URINE_FAST_PEAK_TICKS        end         EVENT_END_TICKS
+ *   cooldown     EVENT_COOLDOWN_TICKS         engine      0 = threshold, 1 = CUSUM
+ *   cusum_drift  EVENT_CUSUM_DRIFT_PPM        cusum_limit EVENT_CUSUM_LIMIT_PPM
+ * Grid mode walks every step of every range; --random N samples N points
+ * uniformly from the same ranges.
+ *
+ * Usage: param_sweep [--trace FILE]... [--synth N] [--hours H] [--seed N]
+ *                    [--set name=lo:hi:step]... [--random N]
+ *                    [--threads N] [--rank f1|precision|recall|latency]
+ *                    [--top N] [--csv FILE]
+ */
+#include "bench_clock.h"
+#include "event_detector.h"
+#include "replay.h"
+#include "trace.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_TRACES      64
+#define MAX_CONFIGS     10000000u
+#define WORK_CHUNK      8           /* Configs claimed per atomic increment */
+
+/* ── Parameter space ────────────────────────────────────────────────── */
+
+enum {
+    P_TRIGGER, P_HYSTERESIS, P_ALPHA, P_URINE_DELTA, P_FAST_PEAK, P_END, P_COOLDOWN,
+    P_ENGINE, P_CUSUM_DRIFT, P_CUSUM_LIMIT,
+    P_COUNT
+};
+
+typedef struct {
+    const char *name;
+    double      lo, hi, step;
+    bool        integer;
+} sweep_param_t;
+
+/* Default search ranges, centred on the compiled-in defaults */
+static sweep_param_t s_params[P_COUNT] = {
+    [P_TRIGGER]     = { "trigger",     5.0,  20.0,  2.5,  false },
+    [P_HYSTERESIS]  = { "hysteresis",  1.0,   5.0,  1.0,  false },
+    [P_ALPHA]       = { "alpha",       0.01,  0.05, 0.02, false },
+    [P_URINE_DELTA] = { "urine_delta", 20.0, 40.0, 10.0,  false },
+    [P_FAST_PEAK]   = { "fast_peak",   3,    15,    3,    true  },
+    [P_END]         = { "end",         2,     6,    2,    true  },
+    [P_COOLDOWN]    = { "cooldown",    EVENT_COOLDOWN_TICKS, EVENT_COOLDOWN_TICKS, 1, true },
+    [P_ENGINE]      = { "engine",      EVENT_ENGINE_THRESHOLD, EVENT_ENGINE_THRESHOLD, 1, true },
+    [P_CUSUM_DRIFT] = { "cusum_drift", EVENT_CUSUM_DRIFT_PPM, EVENT_CUSUM_DRIFT_PPM, 1.0, false },
+    [P_CUSUM_LIMIT] = { "cusum_limit", EVENT_CUSUM_LIMIT_PPM, EVENT_CUSUM_LIMIT_PPM, 1.0, false },
+};
+
+static size_t param_steps(const sweep_param_t *p)
+{
+    if (p->step <= 0.0 || p->hi <= p->lo) {
+        return 1;
+    }
+    return (size_t)floor((p->hi - p->lo) / p->step + 1e-9) + 1;
+}
+
+static void config_from_values(const double v[P_COUNT], event_detector_config_t *cfg)
+{
+    *cfg = (event_detector_config_t)EVENT_DETECTOR_CONFIG_DEFAULT();
+    cfg->trigger_delta_ppm     = (float)v[P_TRIGGER];
+    cfg->hysteresis_ppm        = (float)v[P_HYSTERESIS];
+    cfg->baseline_alpha        = (float)v[P_ALPHA];
+    cfg->urine_peak_delta_ppm  = (float)v[P_URINE_DELTA];
+    cfg->urine_fast_peak_ticks = (uint16_t)lround(v[P_FAST_PEAK]);
+    cfg->end_ticks             = (uint8_t)lround(v[P_END]);
+    cfg->cooldown_ticks        = (uint8_t)lround(v[P_COOLDOWN]);
+    cfg->engine                = lround(v[P_ENGINE]) ? EVENT_ENGINE_CUSUM : EVENT_ENGINE_THRESHOLD;
+    cfg->cusum_drift_ppm       = (float)v[P_CUSUM_DRIFT];
+    cfg->cusum_limit_ppm       = (float)v[P_CUSUM_LIMIT];
+}
+
+static bool parse_set(const char *arg)
+{
+    const char *eq = strchr(arg, '=');
+    if (!eq) {
+        return false;
+    }
+    for (int i = 0; i < P_COUNT; i++) {
+        sweep_param_t *p = &s_params[i];
+        if (strlen(p->name) != (size_t)(eq - arg) || strncmp(arg, p->name, eq - arg) != 0) {
+            continue;
+        }
+        double lo, hi, step;
+        int n = sscanf(eq + 1, "%lf:%lf:%lf", &lo, &hi, &step);
+        if (n == 1) {
+            p->lo = p->hi = lo;
+            p->step = 1.0;
+        } else if (n == 3 && hi >= lo && step > 0.0) {
+            p->lo = lo;
+            p->hi = hi;
+            p->step = step;
+        } else {
+            return false;
+        }
+        return true;
+    }
+    return false;
+}
+
+static event_detector_config_t *build_grid(size_t *count)
+{
+    size_t total = 1;
+    for (int i = 0; i < P_COUNT; i++) {
+        total *= param_steps(&s_params[i]);
+        if (total > MAX_CONFIGS) {
+            fprintf(stderr, "Grid too large (> %u configs); narrow it or use --random\n", MAX_CONFIGS);
+            return NULL;
+        }
+    }
+
+    event_detector_config_t *cfgs = malloc(total * sizeof(*cfgs));
+    if (!cfgs) {
+        return NULL;
+    }
+    for (size_t k = 0; k < total; k++) {
+        double v[P_COUNT];
+        size_t rem = k;
+        for (int i = 0; i < P_COUNT; i++) {
+            size_t steps = param_steps(&s_params[i]);
+            v[i] = s_params[i].lo + (double)(rem % steps) * s_params[i].step;
+            rem /= steps;
+        }
+        config_from_values(v, &cfgs[k]);
+    }
+    *count = total;
+    return cfgs;
+}
+
+static event_detector_config_t *build_random(size_t n, uint32_t seed)
+{
+    uint64_t rng = 0x9E3779B97F4A7C15ULL ^ seed;
+    event_detector_config_t *cfgs = malloc(n * sizeof(*cfgs));
+    if (!cfgs) {
+        return NULL;
+    }
+    for (size_t k = 0; k < n; k++) {
+        double v[P_COUNT];
+        for (int i = 0; i < P_COUNT; i++) {
+            const sweep_param_t *p = &s_params[i];
+            v[i] = p->lo + trace_rng_uniform(&rng) * (p->hi - p->lo);
+        }
+        config_from_values(v, &cfgs[k]);
+    }
+    return cfgs;
+}
+
+/* ── Parallel evaluation ────────────────────────────────────────────── */
+
+typedef struct {
+    double   precision;
+    double   recall;
+    double   f1;
+    double   trigger_median_s;
+    double   classify_median_s;
+    uint32_t false_positives;
+} sweep_result_t;
+
+typedef struct {
+    const trace_t                 *traces;
+    int                            n_traces;
+    const event_detector_config_t *cfgs;
+    sweep_result_t                *results;
+    size_t                         n_cfgs;
+    atomic_size_t                  next;
+} sweep_job_t;
+
+static void evaluate(const sweep_job_t *job, size_t k)
+{
+    replay_score_t   score;
+    replay_summary_t s;
+    sweep_result_t  *res = &job->results[k];
+
+    /* One scorer across all traces; the detector restarts per trace */
+    replay_score_init(&score);
+    for (int t = 0; t < job->n_traces; t++) {
+        replay_event_detector_config(&job->traces[t], &job->cfgs[k], &score);
+    }
+    replay_summarize(&score, TRACE_TICK_MS, &s);
+    replay_score_free(&score);
+
+    res->precision         = s.precision;
+    res->recall            = s.recall;
+    res->f1                = (s.precision + s.recall > 0.0)
+                           ? 2.0 * s.precision * s.recall / (s.precision + s.recall) : 0.0;
+    res->trigger_median_s  = s.type[0].trigger_median_s;
+    res->classify_median_s = s.type[0].classify_median_s;
+    res->false_positives   = s.false_positives;
+}
+
+static void *worker(void *arg)
+{
+    sweep_job_t *job = arg;
+
+    for (;;) {
+        size_t start = atomic_fetch_add_explicit(&job->next, WORK_CHUNK, memory_order_relaxed);
+        if (start >= job->n_cfgs) {
+            break;
+        }
+        size_t end = start + WORK_CHUNK < job->n_cfgs ? start + WORK_CHUNK : job->n_cfgs;
+        for (size_t k = start; k < end; k++) {
+            evaluate(job, k);
+        }
+    }
+    return NULL;
+}
+
+/* ── Ranking / output ───────────────────────────────────────────────── */
+
+typedef enum { RANK_F1, RANK_PRECISION, RANK_RECALL, RANK_LATENCY } rank_key_t;
+
+static rank_key_t            s_rank;
+static const sweep_result_t *s_sort_results;
+
+/* Higher is better for the score keys; latency ranks lowest-first among
+ * configs that classify anything. Ties fall back to F1, then latency. */
+static int cmp_rank(const void *a, const void *b)
+{
+    const sweep_result_t *x = &s_sort_results[*(const size_t *)a];
+    const sweep_result_t *y = &s_sort_results[*(const size_t *)b];
+    double kx = 0.0, ky = 0.0;
+
+    switch (s_rank) {
+    case RANK_F1:        kx = x->f1;        ky = y->f1;        break;
+    case RANK_PRECISION: kx = x->precision; ky = y->precision; break;
+    case RANK_RECALL:    kx = x->recall;    ky = y->recall;    break;
+    case RANK_LATENCY:
+        kx = x->recall > 0.0 ? -x->classify_median_s : -INFINITY;
+        ky = y->recall > 0.0 ? -y->classify_median_s : -INFINITY;
+        break;
+    }
+    if (kx != ky) {
+        return kx < ky ? 1 : -1;
+    }
+    if (x->f1 != y->f1) {
+        return x->f1 < y->f1 ? 1 : -1;
+    }
+    if (x->classify_median_s != y->classify_median_s) {
+        return x->classify_median_s > y->classify_median_s ? 1 : -1;
+    }
+    return (*(const size_t *)a > *(const size_t *)b) - (*(const size_t *)a < *(const size_t *)b);
+}
+
+static void print_row(const char *tag, const event_detector_config_t *c, const sweep_result_t *r)
+{
+    printf("  %-8s %7.2f %6.2f %6.3f %6.1f %5u %4u %4u %-5s %5.2f %5.1f   %6.3f %6.3f %6.3f %5u %7.0f %7.0f\n",
+           tag, c->trigger_delta_ppm, c->hysteresis_ppm, c->baseline_alpha,
+           c->urine_peak_delta_ppm, c->urine_fast_peak_ticks, c->end_ticks, c->cooldown_ticks,
+           c->engine == EVENT_ENGINE_CUSUM ? "cusum" : "thr", c->cusum_drift_ppm, c->cusum_limit_ppm,
+           r->precision, r->recall, r->f1, r->false_positives,
+           r->trigger_median_s, r->classify_median_s);
+}
+
+static void print_header(void)
+{
+    printf("  %-8s %7s %6s %6s %6s %5s %4s %4s %-5s %5s %5s   %6s %6s %6s %5s %7s %7s\n",
+           "rank", "trigger", "hyst", "alpha", "u_dlt", "fastp", "end", "cool", "onset", "drift", "limit",
+           "prec", "recall", "F1", "FP", "trig_s", "class_s");
+}
+
+static bool write_csv(const char *path, const sweep_job_t *job, const size_t *order)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    fprintf(f, "trigger,hysteresis,alpha,urine_delta,fast_peak,end,cooldown,engine,cusum_drift,cusum_limit,"
+               "precision,recall,f1,false_positives,trigger_median_s,classify_median_s\n");
+    for (size_t i = 0; i < job->n_cfgs; i++) {
+        const event_detector_config_t *c = &job->cfgs[order[i]];
+        const sweep_result_t          *r = &job->results[order[i]];
+        fprintf(f, "%g,%g,%g,%g,%u,%u,%u,%d,%g,%g,%.4f,%.4f,%.4f,%u,%.1f,%.1f\n",
+                c->trigger_delta_ppm, c->hysteresis_ppm, c->baseline_alpha,
+                c->urine_peak_delta_ppm, c->urine_fast_peak_ticks, c->end_ticks, c->cooldown_ticks,
+                (int)c->engine, c->cusum_drift_ppm, c->cusum_limit_ppm,
+                r->precision, r->recall, r->f1, r->false_positives,
+                r->trigger_median_s, r->classify_median_s);
+    }
+    fclose(f);
+    return true;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [--trace FILE]... [--synth N] [--hours H] [--seed N]\n"
+            "          [--set name=lo:hi:step]... [--random N] [--threads N]\n"
+            "          [--rank f1|precision|recall|latency] [--top N] [--csv FILE]\n"
+            "  names: trigger hysteresis alpha urine_delta fast_peak end cooldown\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *trace_paths[MAX_TRACES];
+    const char *csv_path = NULL;
+    int    n_paths   = 0;
+    int    n_synth   = -1;
+    int    n_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    size_t n_random  = 0;
+    int    top       = 10;
+    trace_synth_cfg_t synth = trace_synth_default();
+
+    synth.hours = 168.0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc && n_paths < MAX_TRACES) {
+            trace_paths[n_paths++] = argv[++i];
+        } else if (strcmp(argv[i], "--synth") == 0 && i + 1 < argc) {
+            n_synth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--hours") == 0 && i + 1 < argc) {
+            synth.hours = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            synth.seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--set") == 0 && i + 1 < argc) {
+            if (!parse_set(argv[++i])) {
+                fprintf(stderr, "Bad --set '%s'\n", argv[i]);
+                return 2;
+            }
+        } else if (strcmp(argv[i], "--random") == 0 && i + 1 < argc) {
+            n_random = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            n_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rank") == 0 && i + 1 < argc) {
+            const char *k = argv[++i];
+            if      (strcmp(k, "f1") == 0)        s_rank = RANK_F1;
+            else if (strcmp(k, "precision") == 0) s_rank = RANK_PRECISION;
+            else if (strcmp(k, "recall") == 0)    s_rank = RANK_RECALL;
+            else if (strcmp(k, "latency") == 0)   s_rank = RANK_LATENCY;
+            else { usage(argv[0]); return 2; }
+        } else if (strcmp(argv[i], "--top") == 0 && i + 1 < argc) {
+            top = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+            csv_path = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (n_threads < 1) {
+        n_threads = 1;
+    }
+    if (n_synth < 0) {
+        n_synth = n_paths ? 0 : 1;
+    }
+    if (n_paths + n_synth > MAX_TRACES) {
+        fprintf(stderr, "At most %d traces\n", MAX_TRACES);
+        return 2;
+    }
+
+    /* Load everything up front; workers only read the traces */
+    trace_t traces[MAX_TRACES];
+    int     n_traces = 0;
+    size_t  ticks = 0;
+    for (int i = 0; i < n_paths; i++) {
+        trace_t *t = &traces[n_traces++];
+        if (!trace_load_csv(t, trace_paths[i]) || !replay_convert_raw(t)) {
+            return 1;
+        }
+        if (!t->has_label) {
+            fprintf(stderr, "%s: no label column — cannot score\n", t->name);
+            return 1;
+        }
+        ticks += t->count;
+    }
+    for (int i = 0; i < n_synth; i++) {
+        trace_t *t = &traces[n_traces++];
+        trace_synth_cfg_t c = synth;
+        c.seed = synth.seed + (uint32_t)i;
+        if (!trace_synthesize(t, &c)) {
+            fprintf(stderr, "Failed to generate synthetic trace\n");
+            return 1;
+        }
+        ticks += t->count;
+    }
+
+    sweep_job_t job = { .traces = traces, .n_traces = n_traces };
+    job.cfgs = n_random ? build_random(n_random, synth.seed) : build_grid(&job.n_cfgs);
+    if (n_random) {
+        job.n_cfgs = n_random;
+    }
+    job.results = calloc(job.n_cfgs ? job.n_cfgs : 1, sizeof(*job.results));
+    if (!job.cfgs || !job.results || job.n_cfgs == 0) {
+        return 1;
+    }
+    atomic_init(&job.next, 0);
+
+    printf("== Parameter sweep: %zu configs (%s) × %d traces (%.1f h), %d threads ==\n",
+           job.n_cfgs, n_random ? "random" : "grid", n_traces,
+           ticks * (TRACE_TICK_MS / 1000.0) / 3600.0, n_threads);
+
+    pthread_t *tid = calloc((size_t)n_threads, sizeof(*tid));
+    uint64_t t0 = bench_now_ns();
+    for (int i = 0; i < n_threads; i++) {
+        if (pthread_create(&tid[i], NULL, worker, &job) != 0) {
+            fprintf(stderr, "pthread_create failed\n");
+            return 1;
+        }
+    }
+    for (int i = 0; i < n_threads; i++) {
+        pthread_join(tid[i], NULL);
+    }
+    double dt = (bench_now_ns() - t0) / 1e9;
+    printf("  %.2f s  %.0f configs/s  %.1f M detector updates/s\n",
+           dt, job.n_cfgs / dt, (double)job.n_cfgs * ticks / dt / 1e6);
+
+    size_t *order = malloc(job.n_cfgs * sizeof(*order));
+    if (!order) {
+        return 1;
+    }
+    for (size_t i = 0; i < job.n_cfgs; i++) {
+        order[i] = i;
+    }
+    s_sort_results = job.results;
+    qsort(order, job.n_cfgs, sizeof(*order), cmp_rank);
+
+    /* Reference row: the compiled-in defaults on the same traces */
+    const event_detector_config_t defaults = EVENT_DETECTOR_CONFIG_DEFAULT();
+    sweep_job_t ref = { .traces = traces, .n_traces = n_traces, .cfgs = &defaults, .n_cfgs = 1 };
+    sweep_result_t ref_result;
+    ref.results = &ref_result;
+    evaluate(&ref, 0);
+
+    print_header();
+    for (int i = 0; i < top && (size_t)i < job.n_cfgs; i++) {
+        char tag[16];
+        snprintf(tag, sizeof(tag), "#%d", i + 1);
+        print_row(tag, &job.cfgs[order[i]], &job.results[order[i]]);
+    }
+    print_row("default", &defaults, &ref_result);
+
+    int rc = 0;
+    if (csv_path && !write_csv(csv_path, &job, order)) {
+        rc = 1;
+    }
+    for (int i = 0; i < n_traces; i++) {
+        trace_free(&traces[i]);
+    }
+    free(order);
+    free(tid);
+    free(job.results);
+    free((void *)job.cfgs);
+    return rc;
+}
@@ -0,0 +1,118 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * trace_decode.c — Captured serial bytes (CONFIG_LITTERBOX_BINARY_TRACE) → CSV
+ *
+ * Reads a raw console capture (python monitor.py --raw capture.bin) that
+ * contains text log lines mixed with binary trace frames, and writes one CSV
+ * row per frame. The CSV uses the trace.h column names, so it loads directly
+ * into detector_bench / param_sweep (add a label column to score it):
+ *   t_ms,tick,raw_adc,ppm,baseline,state,event,warmup,invalid,dropped
+ *
+ * A summary (frames, line-ending mode, bad CRCs, ring drops, link gaps)
+ * goes to stderr.
+ *
+ * Usage: trace_decode CAPTURE [OUT.csv] [--tick-ms N]
+ */
+#include "event_detector.h"
+#include "frame_scan.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint8_t *read_file(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+    size_t cap = 1 << 16, n = 0;
+    uint8_t *buf = malloc(cap);
+    size_t got;
+    while (buf && (got = fread(buf + n, 1, cap - n, f)) > 0) {
+        n += got;
+        if (n == cap) {
+            uint8_t *grown = realloc(buf, cap *= 2);
+            if (!grown) {
+                free(buf);
+            }
+            buf = grown;
+        }
+    }
+    fclose(f);
+    *len = n;
+    return buf;
+}
+
+static double q_to_ppm(int32_t q)
+{
+    return (double)q / (1 << EVENT_PPM_Q_SHIFT);
+}
+
+int main(int argc, char **argv)
+{
+    const char *in_path = NULL, *out_path = NULL;
+    unsigned tick_ms = TRACE_TICK_MS;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--tick-ms") == 0 && i + 1 < argc) {
+            tick_ms = (unsigned)strtoul(argv[++i], NULL, 0);
+        } else if (!in_path && argv[i][0] != '-') {
+            in_path = argv[i];
+        } else if (!out_path && argv[i][0] != '-') {
+            out_path = argv[i];
+        } else {
+            in_path = NULL;
+            break;
+        }
+    }
+    if (!in_path) {
+        fprintf(stderr, "Usage: %s CAPTURE [OUT.csv] [--tick-ms N]\n", argv[0]);
+        return 2;
+    }
+
+    size_t len = 0;
+    uint8_t *buf = read_file(in_path, &len);
+    if (!buf) {
+        return 1;
+    }
+
+    frame_scan_stats_t st;
+    size_t n = 0;
+    trace_record_t *rec = frame_scan(buf, len, &n, &st);
+    free(buf);
+    if (!rec) {
+        fprintf(stderr, "%s: no trace frames found (%zu bytes)\n", in_path, len);
+        return 1;
+    }
+
+    FILE *out = out_path ? fopen(out_path, "w") : stdout;
+    if (!out) {
+        perror(out_path);
+        free(rec);
+        return 1;
+    }
+    fprintf(out, "t_ms,tick,raw_adc,ppm,baseline,state,event,warmup,invalid,dropped\n");
+    for (size_t i = 0; i < n; i++) {
+        const trace_record_t *r = &rec[i];
+        fprintf(out, "%llu,%u,%u,%.4f,%.4f,%u,%u,%u,%u,%u\n",
+                (unsigned long long)r->tick * tick_ms, r->tick, r->raw,
+                q_to_ppm(r->ppm_q), q_to_ppm(r->baseline_q),
+                r->state & TRACE_STATE_MASK, r->event,
+                (r->state & TRACE_FLAG_WARMUP) ? 1 : 0, (r->state & TRACE_FLAG_INVALID) ? 1 : 0,
+                r->dropped);
+    }
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    fprintf(stderr, "%zu frames (%s line endings), %zu bad CRC, %llu dropped on device, %llu lost on link\n",
+            st.frames, st.crlf ? "CRLF" : "LF", st.bad_crc,
+            (unsigned long long)st.dropped, (unsigned long long)st.tick_gaps);
+    free(rec);
+    return 0;
+}
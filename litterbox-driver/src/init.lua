@@ -6,14 +6,74 @@ local capabilities = require "st.capabilities"
 local defaults = require "st.zigbee.defaults"
 local zcl_clusters = require "st.zigbee.zcl.clusters"
 local data_types = require "st.zigbee.data_types"
+local cluster_base = require "st.zigbee.cluster_base"
+local zcl_messages = require "st.zigbee.zcl"
+local messages = require "st.zigbee.messages"
+local generic_body = require "st.zigbee.generic_body"
+local zb_const = require "st.zigbee.constants"
 local OnOff = zcl_clusters.OnOff
 
 -- Custom NH₃ Concentration Measurement cluster (0xFC00, Manufacturer-Specific)
 -- Attr 0x0000: uint16 ppm  — NH₃ concentration
 -- Attr 0x0003: uint8       — event type (0=none, 1=urination, 2=defecation)
+-- Attr 0x0004: octet string — block of consecutive 2 s samples (firmware sample_block.h)
+-- Attr 0x0005: octet string — journaled events, resent until acknowledged (firmware event_journal.h)
+-- Attr 0x0006: octet string — latest event snippet info; the snippet itself is pulled with
+--              command 0x00 Get Snippet Fragment → 0x00 Snippet Fragment (firmware event_snippet.h)
+-- Attr 0x0007: uint16      — provisional event type while the event is on: low byte type,
+--              high byte confidence %; 0 once 0x0003 has the final type (or the onset was withdrawn)
+-- Attr 0x0008: octet string — usage statistics, last 24 h (firmware usage_stats.h)
+-- Attr 0x0009: octet string — usage statistics per day, newest first; both read-only,
+--              polled every STATS_POLL_INTERVAL_S
 local NH3_CLUSTER_ID          = 0xFC00
 local NH3_MEASURED_VALUE_ATTR = 0x0000
 local NH3_EVENT_TYPE_ATTR     = 0x0003
+local NH3_SAMPLE_BLOCK_ATTR   = 0x0004
+local SAMPLE_BLOCK_FORMAT     = 0x01
+local SAMPLE_BLOCK_INVALID    = 0xFFFF
+local SAMPLE_BLOCK_SEQ_FIELD  = "sample_block_seq"
+local NH3_EVENT_JOURNAL_ATTR  = 0x0005
+local EVENT_JOURNAL_ENTRY_BYTES = { [0x01] = 14, [0x02] = 22 }  -- By format byte; 0x02 adds the event features
+local EVENT_JOURNAL_SEEN_FIELD = "event_journal_seen"
+local EVENT_JOURNAL_SEEN_MAX  = 64    -- Remembered (boot, seq) keys; well above the firmware journal length
+local NH3_SNIPPET_INFO_ATTR   = 0x0006
+local SNIPPET_FORMAT          = 0x01
+local SNIPPET_FLAG_TRUNCATED  = 0x01
+local SNIPPET_INVALID         = 0xFFFF
+local SNIPPET_CMD_GET_FRAGMENT = 0x00
+local SNIPPET_CMD_FRAGMENT    = 0x00
+local SNIPPET_FETCH_FIELD     = "snippet_fetch"
+local SNIPPET_RETRY_S         = 3     -- Re-ask for a fragment after this long without an answer
+local SNIPPET_RETRIES         = 5
+local NH3_PROVISIONAL_ATTR    = 0x0007
+local PROVISIONAL_FIELD       = "provisional_event"
+local NH3_USAGE_24H_ATTR      = 0x0008
+local NH3_USAGE_DAYS_ATTR     = 0x0009
+local USAGE_STATS_FORMAT      = 0x01
+local USAGE_STATS_NO_BASELINE = 0xFFFF
+local STATS_POLL_INTERVAL_S   = 3600  -- The firmware refreshes both on each event and each hour
+
+-- Several sensors (firmware CONFIG_LITTERBOX_SENSOR_CHANNELS): endpoint 1, 2, 3
+-- each carry their own 0xFC00 cluster and show as components main, box2, box3.
+-- The profile is picked from the number of 0xFC00 endpoints; On/Off and the
+-- diagnostics stay on endpoint 1 (main), reporting configuration is device-wide.
+local COMPONENTS = { [1] = "main", [2] = "box2", [3] = "box3" }
+local PROFILES   = { [1] = "litterbox-v1", [2] = "litterbox-v1-2box", [3] = "litterbox-v1-3box" }
+
+-- Reporting of the cluster is configured by the firmware itself (Configure
+-- Reporting 0x06 → response 0x07, kept in device NVS). NH₃ intervals come
+-- from the device preferences; the event type is sent on every change.
+local CONFIGURE_REPORTING_RESPONSE = 0x07
+local EVENT_REPORT_MIN_S, EVENT_REPORT_MAX_S, EVENT_REPORT_CHANGE = 0, 0, 1
+
+-- Diagnostics cluster (0xFC01, firmware CONFIG_LITTERBOX_STAGE_STATS)
+-- Read-only uint32 per sample-path stage: attr = stage << 4 | kind
+-- Not reported; polled every DIAG_POLL_INTERVAL_S and written to the driver log.
+local DIAG_CLUSTER_ID      = 0xFC01
+local DIAG_POLL_INTERVAL_S = 3600
+local DIAG_STAGES = { [0] = "adc_read", "ppm_convert", "detector", "zb_lock_wait",
+                      "report_set", "report_send", "tick_total", "tick_jitter" }
+local DIAG_KINDS  = { [0] = "n", "min_us", "avg_us", "p99_us", "max_us" }
 
 -- Custom capabilities
 local nh3Measurement = capabilities["streetsmile37673.nh3measurement"]
@@ -22,11 +82,48 @@ local toiletEvent    = capabilities["streetsmile37673.toiletevent"]
 log.info(string.format("=== LITTERBOX v20 capabilities: nh3=%s, toilet=%s ===",
   tostring(nh3Measurement), tostring(toiletEvent)))
 
+local function endpoint_to_component(device, ep)
+  return COMPONENTS[ep] or "main"
+end
+
+local function component_to_endpoint(device, component_id)
+  for ep, id in pairs(COMPONENTS) do
+    if id == component_id then
+      return ep
+    end
+  end
+  return 1
+end
+
+-- Endpoints that carry the NH₃ cluster, in order
+local function nh3_endpoints(device)
+  local eps = {}
+  for _, ep in pairs(device.zigbee_endpoints or {}) do
+    for _, cluster in ipairs(ep.server_clusters or {}) do
+      if cluster == NH3_CLUSTER_ID then
+        table.insert(eps, ep.id)
+      end
+    end
+  end
+  table.sort(eps)
+  return eps
+end
+
+local function rx_endpoint(zb_rx)
+  return zb_rx.address_header.src_endpoint.value
+end
+
+-- Per-endpoint device field: endpoint 1 keeps the single-sensor name (and what is persisted under it)
+local function ep_field(name, ep)
+  return ep == 1 and name or string.format("%s_%d", name, ep)
+end
+
 -- NH₃ handler: uint16 ppm → nh3Measurement custom capability
 local function nh3_attr_handler(driver, device, value, zb_rx)
   local ppm = value.value  -- uint16, already in ppm
-  log.info(string.format("NH3: %d ppm (cluster 0x%04X)", ppm, NH3_CLUSTER_ID))
-  device:emit_event(nh3Measurement.ammoniaLevel({
+  local ep = rx_endpoint(zb_rx)
+  log.info(string.format("NH3[%s]: %d ppm (cluster 0x%04X)", endpoint_to_component(device, ep), ppm, NH3_CLUSTER_ID))
+  device:emit_event_for_endpoint(ep, nh3Measurement.ammoniaLevel({
     value = ppm,
     unit = "ppm"
   }))
@@ -36,41 +133,458 @@ end
 -- 0 = no event  → toiletEvent("none")
 -- 1 = urination → toiletEvent("urination")
 -- 2 = defecation → toiletEvent("defecation")
+-- A provisional type shown earlier (0x0007) is confirmed or corrected here.
+local EVENT_NAMES = { [0] = "none", [1] = "urination", [2] = "defecation" }
+
 local function event_type_attr_handler(driver, device, value, zb_rx)
   local event_type = value.value  -- uint8
-  local event_names = { [0] = "none", [1] = "urination", [2] = "defecation" }
-  local event_name = event_names[event_type] or "none"
-  log.info(string.format("EventType: %d → toiletEvent(%s)", event_type, event_name))
-  device:emit_event(toiletEvent.toiletEvent({ value = event_name }))
+  local event_name = EVENT_NAMES[event_type] or "none"
+  local ep = rx_endpoint(zb_rx)
+  local component = endpoint_to_component(device, ep)
+  local provisional = device:get_field(ep_field(PROVISIONAL_FIELD, ep))
+  if provisional and event_type ~= 0 then
+    log.info(string.format("EventType[%s]: provisional %s (%d%%) %s", component, EVENT_NAMES[provisional.type] or "?",
+      provisional.confidence, provisional.type == event_type and "confirmed" or "corrected"))
+    device:set_field(ep_field(PROVISIONAL_FIELD, ep), nil)
+  end
+  log.info(string.format("EventType[%s]: %d → toiletEvent(%s)", component, event_type, event_name))
+  device:emit_event_for_endpoint(ep, toiletEvent.toiletEvent({ value = event_name }, { data = { provisional = false } }))
+end
+
+-- Provisional event: uint16, low byte type, high byte confidence % → toiletEvent
+-- at once, marked provisional. 0 clears it: after the final type (already
+-- handled above, field gone) or for an onset the firmware withdrew.
+local function provisional_attr_handler(driver, device, value, zb_rx)
+  local event_type = value.value & 0xFF
+  local confidence = value.value >> 8
+  local ep = rx_endpoint(zb_rx)
+  local component = endpoint_to_component(device, ep)
+  local field = ep_field(PROVISIONAL_FIELD, ep)
+  if event_type == 0 then
+    local provisional = device:get_field(field)
+    if provisional then
+      log.info(string.format("Provisional[%s] %s withdrawn", component, EVENT_NAMES[provisional.type] or "?"))
+      device:set_field(field, nil)
+      device:emit_event_for_endpoint(ep, toiletEvent.toiletEvent({ value = "none" }, { data = { provisional = false } }))
+    end
+    return
+  end
+  local event_name = EVENT_NAMES[event_type]
+  if not event_name then
+    log.warn(string.format("Provisional[%s]: unknown event type %d", component, event_type))
+    return
+  end
+  device:set_field(field, { type = event_type, confidence = confidence })
+  log.info(string.format("Provisional[%s]: %s (%d%%) → toiletEvent(%s)", component, event_name, confidence, event_name))
+  device:emit_event_for_endpoint(ep, toiletEvent.toiletEvent({ value = event_name },
+    { data = { provisional = true, confidence = confidence } }))
+end
+
+-- Sample block: format u8, seq u8, base tick u32, interval u8 (100 ms), count u8,
+-- first value u16 (0.1 ppm), then count-1 zigzag varint deltas. nil if malformed.
+local function decode_sample_block(bytes)
+  if #bytes < 10 or bytes:byte(1) ~= SAMPLE_BLOCK_FORMAT then
+    return nil
+  end
+  local seq, base_tick, interval_ds, count, value = string.unpack("<I1I4I1I1I2", bytes, 2)
+  if count == 0 then
+    return nil
+  end
+  local values = { value }
+  local pos = 11
+  for i = 2, count do
+    local zz, shift = 0, 0
+    repeat
+      local b = bytes:byte(pos)
+      if b == nil or shift > 14 then
+        return nil
+      end
+      zz = zz | ((b & 0x7F) << shift)
+      pos, shift = pos + 1, shift + 7
+    until b & 0x80 == 0
+    value = value + ((zz >> 1) ~ -(zz & 1))
+    if value < 0 or value > 0xFFFF then
+      return nil
+    end
+    values[i] = value
+  end
+  if pos ~= #bytes + 1 then
+    return nil
+  end
+  return { seq = seq, base_tick = base_tick, interval_s = interval_ds / 10, values = values }
+end
+
+-- Sample block handler: every 2 s sample, for offline analysis (driver log)
+local function sample_block_attr_handler(driver, device, value, zb_rx)
+  local block = decode_sample_block(value.value)
+  if block == nil then
+    log.debug("Sample block: none yet or unreadable")
+    return
+  end
+  local ep = rx_endpoint(zb_rx)
+  local field = ep_field(SAMPLE_BLOCK_SEQ_FIELD, ep)
+  local expected = device:get_field(field)
+  if expected ~= nil and expected ~= block.seq then
+    log.warn(string.format("Sample block[%s]: %d block(s) lost", endpoint_to_component(device, ep),
+      (block.seq - expected) & 0xFF))
+  end
+  device:set_field(field, (block.seq + 1) & 0xFF)
+
+  local ppm = {}
+  for i, v in ipairs(block.values) do
+    ppm[i] = v == SAMPLE_BLOCK_INVALID and "x" or string.format("%.1f", v / 10)
+  end
+  log.info(string.format("SAMPLES %s seq=%d tick=%d dt=%.1fs ppm=%s", endpoint_to_component(device, ep),
+    block.seq, block.base_tick, block.interval_s, table.concat(ppm, ",")))
+end
+
+-- Event journal: format u8, count u8, boot u8, uptime u32 (s), then count entries of
+-- seq u16, type u8, boot u8, onset uptime u32 (s), duration u16 (s), peak u16, baseline u16 (0.1 ppm)
+-- and, from format 0x02, area u16 (ppm·s), max rise u16 (0.01 ppm/s), time to peak u16 (s),
+-- decay time constant u16 (s, 0 = not fitted). nil if malformed.
+local function decode_event_journal(bytes)
+  local size = #bytes >= 7 and EVENT_JOURNAL_ENTRY_BYTES[bytes:byte(1)]
+  if not size then
+    return nil
+  end
+  local count, boot, uptime = string.unpack("<I1I1I4", bytes, 2)
+  if count == 0 or #bytes ~= 7 + size * count then
+    return nil
+  end
+  local entries = {}
+  for i = 1, count do
+    local e = {}
+    local pos = 8 + size * (i - 1)
+    e.seq, e.type, e.boot, e.start_s, e.duration_s, e.peak, e.baseline =
+      string.unpack("<I2I1I1I4I2I2I2", bytes, pos)
+    if size >= 22 then
+      e.area, e.max_rise, e.time_to_peak_s, e.decay_tau_s = string.unpack("<I2I2I2I2", bytes, pos + 14)
+    end
+    entries[i] = e
+  end
+  return { boot = boot, uptime = uptime, entries = entries }
+end
+
+-- Event journal handler: every classified event exactly once, including those
+-- that happened while the hub was unreachable (driver log). Resent records are
+-- de-duplicated by (boot, seq); the firmware drops entries once this report is acked.
+local function event_journal_attr_handler(driver, device, value, zb_rx)
+  local journal = decode_event_journal(value.value)
+  if journal == nil then
+    log.debug("Event journal: none yet or unreadable")
+    return
+  end
+  local ep = rx_endpoint(zb_rx)
+  local field = ep_field(EVENT_JOURNAL_SEEN_FIELD, ep)
+  local seen = device:get_field(field) or {}
+  local seen_set = {}
+  for _, key in ipairs(seen) do
+    seen_set[key] = true
+  end
+  local names = { [1] = "urination", [2] = "defecation" }
+  local now = os.time()
+  for _, e in ipairs(journal.entries) do
+    local key = string.format("%d:%d", e.boot, e.seq)
+    if not seen_set[key] then
+      seen_set[key] = true
+      table.insert(seen, key)
+      -- Onsets from the current boot can be dated; earlier boots only by order
+      local when = "earlier boot"
+      if e.boot == journal.boot then
+        when = os.date("!%Y-%m-%dT%H:%M:%SZ", now - (journal.uptime - e.start_s))
+      end
+      local features = ""
+      if e.area ~= nil then
+        features = string.format(" area=%dppm*s rise=%.2fppm/s to_peak=%ds tau=%s",
+          e.area, e.max_rise / 100, e.time_to_peak_s, e.decay_tau_s > 0 and (e.decay_tau_s .. "s") or "-")
+      end
+      log.info(string.format("JOURNAL %s seq=%d type=%s onset=%s dur=%ds peak=%.1f baseline=%.1f%s",
+        endpoint_to_component(device, ep), e.seq, names[e.type] or tostring(e.type), when, e.duration_s, e.peak / 10, e.baseline / 10, features))
+    end
+  end
+  while #seen > EVENT_JOURNAL_SEEN_MAX do
+    table.remove(seen, 1)
+  end
+  device:set_field(field, seen, { persist = true })
+end
+
+-- Event snippet: format u8, flags u8, seq u16, trigger tick u32, interval u8 (100 ms),
+-- pre-trigger count u8, count u16, event u8, baseline u16, first value u16 (0.1 ppm),
+-- then count-1 zigzag varint deltas. nil if malformed.
+local function decode_snippet(bytes)
+  if #bytes < 17 or bytes:byte(1) ~= SNIPPET_FORMAT then
+    return nil
+  end
+  local flags, seq, trigger_tick, interval_ds, pre, count, event, baseline, value =
+    string.unpack("<I1I2I4I1I1I2I1I2I2", bytes, 2)
+  if count == 0 then
+    return nil
+  end
+  local values = { value }
+  local pos = 18
+  for i = 2, count do
+    local zz, shift = 0, 0
+    repeat
+      local b = bytes:byte(pos)
+      if b == nil or shift > 14 then
+        return nil
+      end
+      zz = zz | ((b & 0x7F) << shift)
+      pos, shift = pos + 1, shift + 7
+    until b & 0x80 == 0
+    value = value + ((zz >> 1) ~ -(zz & 1))
+    if value < 0 or value > 0xFFFF then
+      return nil
+    end
+    values[i] = value
+  end
+  if pos ~= #bytes + 1 then
+    return nil
+  end
+  return { seq = seq, truncated = flags & SNIPPET_FLAG_TRUNCATED ~= 0, trigger_tick = trigger_tick,
+           interval_s = interval_ds / 10, pre = pre, event = event, baseline = baseline, values = values }
+end
+
+-- Get Snippet Fragment: cluster-specific command to the endpoint, u16 seq, u16 offset
+local function request_snippet_fragment(device, ep, seq, offset)
+  local zclh = zcl_messages.ZclHeader({ cmd = data_types.ZCLCommandId(SNIPPET_CMD_GET_FRAGMENT) })
+  zclh.frame_ctrl:set_cluster_specific()
+  local addrh = messages.AddressHeader(zb_const.HUB.ADDR, zb_const.HUB.ENDPOINT, device:get_short_address(),
+    ep, zb_const.HA_PROFILE_ID, NH3_CLUSTER_ID)
+  local body = zcl_messages.ZclMessageBody({ zcl_header = zclh,
+    zcl_body = generic_body.GenericBody(string.pack("<I2I2", seq, offset)) })
+  device:send(messages.ZigbeeMessageTx({ address_header = addrh, body = body }))
+end
+
+-- Ask for the next fragment, and again if no answer arrives in time
+local function snippet_fetch_next(device, ep)
+  local field = ep_field(SNIPPET_FETCH_FIELD, ep)
+  local fetch = device:get_field(field)
+  if fetch == nil then
+    return
+  end
+  local offset = #fetch.data
+  request_snippet_fragment(device, ep, fetch.seq, offset)
+  device.thread:call_with_delay(SNIPPET_RETRY_S, function()
+    local f = device:get_field(field)
+    if f ~= nil and f.seq == fetch.seq and #f.data == offset then
+      f.tries = f.tries + 1
+      if f.tries > SNIPPET_RETRIES then
+        log.warn(string.format("Snippet %d: no answer, giving up at %d/%d bytes", f.seq, offset, f.len))
+        device:set_field(field, nil)
+        return
+      end
+      snippet_fetch_next(device, ep)
+    end
+  end)
+end
+
+-- Snippet info handler: a new event snippet is ready on the device; fetch it
+local function snippet_info_attr_handler(driver, device, value, zb_rx)
+  local bytes = value.value
+  if #bytes ~= 13 or bytes:byte(1) ~= SNIPPET_FORMAT then
+    log.debug("Snippet info: none yet or unreadable")
+    return
+  end
+  local _, seq, len = string.unpack("<I1I2I2", bytes, 2)
+  local ep = rx_endpoint(zb_rx)
+  device:set_field(ep_field(SNIPPET_FETCH_FIELD, ep), { seq = seq, len = len, data = "", tries = 0 })
+  snippet_fetch_next(device, ep)
+end
+
+-- Snippet Fragment: status u8, seq u16, offset u16, length u16, data
+local function snippet_fragment_handler(driver, device, zb_rx)
+  local bytes = zb_rx.body.zcl_body.body_bytes
+  local ep = rx_endpoint(zb_rx)
+  local field = ep_field(SNIPPET_FETCH_FIELD, ep)
+  local fetch = device:get_field(field)
+  if fetch == nil or #bytes < 7 then
+    return
+  end
+  local status, seq, offset, len = string.unpack("<I1I2I2I2", bytes)
+  if status ~= 0 or seq ~= fetch.seq or len ~= fetch.len then
+    log.warn(string.format("Snippet %d: no longer on the device (status 0x%02X)", fetch.seq, status))
+    device:set_field(field, nil)
+    return
+  end
+  if offset ~= #fetch.data then
+    return    -- Answer to an earlier retry
+  end
+  fetch.data = fetch.data .. bytes:sub(8)
+  fetch.tries = 0
+  if #fetch.data < fetch.len then
+    snippet_fetch_next(device, ep)
+    return
+  end
+  device:set_field(field, nil)
+
+  local snip = decode_snippet(fetch.data)
+  if snip == nil then
+    log.warn(string.format("Snippet %d: unreadable", fetch.seq))
+    return
+  end
+  local ppm = {}
+  for i, v in ipairs(snip.values) do
+    ppm[i] = v == SNIPPET_INVALID and "x" or string.format("%.1f", v / 10)
+  end
+  local names = { [0] = "none", [1] = "urination", [2] = "defecation" }
+  log.info(string.format("SNIPPET %s seq=%d event=%s trigger=%d dt=%.1fs pre=%d baseline=%.1f%s ppm=%s",
+    endpoint_to_component(device, ep), snip.seq, names[snip.event] or tostring(snip.event), snip.trigger_tick, snip.interval_s, snip.pre,
+    snip.baseline / 10, snip.truncated and " truncated" or "", table.concat(ppm, ",")))
+end
+
+-- Baseline range in 0.1 ppm → "min–max ppm", or "-" without an IDLE reading
+local function usage_baseline(min, max)
+  if min == USAGE_STATS_NO_BASELINE then
+    return "-"
+  end
+  return string.format("%.1f-%.1f", min / 10, max / 10)
+end
+
+-- Usage statistics, last 24 h: counts, mean durations, baseline range, peak−baseline histograms
+local function usage_24h_attr_handler(driver, device, value, zb_rx)
+  local bytes = value.value
+  if #bytes ~= 34 or bytes:byte(1) ~= USAGE_STATS_FORMAT then
+    log.debug("Usage statistics: none yet or unreadable")
+    return
+  end
+  local v = { string.unpack("<I1I2I2I2I2I2I2I2I2I2I2I2I2I2I2I2I2", bytes, 2) }
+  log.info(string.format("STATS %s 24h hours=%d urination=%d (%ds) defecation=%d (%ds) baseline=%s "
+    .. "hist=%d,%d,%d,%d,%d hist_all=%d,%d,%d,%d,%d",
+    endpoint_to_component(device, rx_endpoint(zb_rx)), v[1], v[2], v[4], v[3], v[5], usage_baseline(v[6], v[7]),
+    v[8], v[9], v[10], v[11], v[12], v[13], v[14], v[15], v[16], v[17]))
+end
+
+-- Usage statistics per day, newest (current) first: 10 bytes per day
+local function usage_days_attr_handler(driver, device, value, zb_rx)
+  local bytes = value.value
+  if #bytes < 2 or bytes:byte(1) ~= USAGE_STATS_FORMAT or #bytes ~= 2 + bytes:byte(2) * 10 then
+    log.debug("Usage statistics per day: none yet or unreadable")
+    return
+  end
+  for day = 0, bytes:byte(2) - 1 do
+    local uri, def, uri_s, def_s, min, max = string.unpack("<I1I1I2I2I2I2", bytes, 3 + day * 10)
+    log.info(string.format("STATS %s day -%d urination=%d (%ds) defecation=%d (%ds) baseline=%s",
+      endpoint_to_component(device, rx_endpoint(zb_rx)), day, uri, uri_s, def, def_s, usage_baseline(min, max)))
+  end
+end
+
+local function stats_poll(device)
+  for _, ep in ipairs(nh3_endpoints(device)) do
+    for _, attr in ipairs({ NH3_USAGE_24H_ATTR, NH3_USAGE_DAYS_ATTR }) do
+      device:send(cluster_base.read_attribute(device,
+        data_types.ClusterId(NH3_CLUSTER_ID), data_types.AttributeId(attr)):to_endpoint(ep))
+    end
+  end
+end
+
+-- Diagnostics handler: one stage statistic per attribute
+local function diag_attr_handler(driver, device, value, zb_rx)
+  local attr = zb_rx.body.zcl_body.attr_records[1].attr_id.value
+  log.info(string.format("DIAG %s %s=%d",
+    DIAG_STAGES[attr >> 4] or "?", DIAG_KINDS[attr & 0x0F] or "?", value.value))
+end
+
+local function diag_poll(device)
+  for stage = 0, #DIAG_STAGES do
+    for kind = 0, #DIAG_KINDS do
+      device:send(cluster_base.read_attribute(device,
+        data_types.ClusterId(DIAG_CLUSTER_ID), data_types.AttributeId((stage << 4) | kind)))
+    end
+  end
+end
+
+local diag_handlers = {}
+for stage = 0, #DIAG_STAGES do
+  for kind = 0, #DIAG_KINDS do
+    diag_handlers[(stage << 4) | kind] = diag_attr_handler
+  end
+end
+
+local function configure_reporting(device)
+  local prefs = device.preferences or {}
+  local min    = prefs.nh3ReportMin or 10
+  local max    = prefs.nh3ReportMax or 300
+  local change = prefs.nh3ReportChange or 2
+  local block  = prefs.sampleBlockPeriod or 110
+  log.info(string.format("Configure reporting: NH3 %d-%d s / %d ppm, sample block %d s", min, max, change, block))
+  device:send(cluster_base.configure_reporting(device, data_types.ClusterId(NH3_CLUSTER_ID),
+    data_types.AttributeId(NH3_MEASURED_VALUE_ATTR), data_types.Uint16.ID, min, max, change))
+  device:send(cluster_base.configure_reporting(device, data_types.ClusterId(NH3_CLUSTER_ID),
+    data_types.AttributeId(NH3_EVENT_TYPE_ATTR), data_types.Uint8.ID,
+    EVENT_REPORT_MIN_S, EVENT_REPORT_MAX_S, EVENT_REPORT_CHANGE))
+  -- Sample block: min interval = block period, max 0xFFFF = off (discrete type, no change field)
+  device:send(cluster_base.configure_reporting(device, data_types.ClusterId(NH3_CLUSTER_ID),
+    data_types.AttributeId(NH3_SAMPLE_BLOCK_ATTR), data_types.OctetString.ID,
+    block, block == 0 and 0xFFFF or 0, nil))
+end
+
+-- Configure Reporting Response: one SUCCESS byte, or a status per failed record
+local function configure_reporting_response_handler(driver, device, zb_rx)
+  log.info("Configure reporting response: " .. zb_rx.body.zcl_body:pretty_print())
+end
+
+-- Switch to the profile with one component per 0xFC00 endpoint
+local function update_profile(device)
+  local n = #nh3_endpoints(device)
+  local current = 0
+  while COMPONENTS[current + 1] ~= nil and device.profile.components[COMPONENTS[current + 1]] ~= nil do
+    current = current + 1
+  end
+  if PROFILES[n] == nil or n == current then
+    return
+  end
+  log.info(string.format("%d sensor endpoint(s) → profile %s", n, PROFILES[n]))
+  device:try_update_metadata({ profile = PROFILES[n] })
 end
 
 -- Lifecycle: device added
 local function device_added(driver, device)
   log.info("=== LITTERBOX v20 device_added ===")
-  device:emit_event(nh3Measurement.ammoniaLevel({ value = 0, unit = "ppm" }))
-  device:emit_event(toiletEvent.toiletEvent({ value = "none" }))
+  for _, ep in ipairs(nh3_endpoints(device)) do
+    device:emit_event_for_endpoint(ep, nh3Measurement.ammoniaLevel({ value = 0, unit = "ppm" }))
+    device:emit_event_for_endpoint(ep, toiletEvent.toiletEvent({ value = "none" }))
+  end
   device:emit_event(capabilities.switch.switch.off())
 end
 
 -- Lifecycle: device init
 local function device_init(driver, device)
   log.info("=== LITTERBOX v20 device_init ===")
+  device:set_endpoint_to_component_fn(endpoint_to_component)
+  device:set_component_to_endpoint_fn(component_to_endpoint)
+  update_profile(device)
   -- Emit initial state so the app doesn't show "-" after driver switch
   local ok, err = pcall(function()
-    device:emit_event(toiletEvent.toiletEvent({ value = "none" }))
+    for _, ep in ipairs(nh3_endpoints(device)) do
+      device:emit_event_for_endpoint(ep, toiletEvent.toiletEvent({ value = "none" }))
+    end
   end)
   if not ok then
     log.error("device_init toiletEvent emit failed: " .. tostring(err))
   end
+  device.thread:call_on_schedule(DIAG_POLL_INTERVAL_S, function() diag_poll(device) end, "diag_poll")
+  device.thread:call_on_schedule(STATS_POLL_INTERVAL_S, function() stats_poll(device) end, "stats_poll")
 end
 
 -- Lifecycle: doConfigure
 local function do_configure(driver, device)
   log.info("=== LITTERBOX v20 do_configure ===")
   device:configure()
+  configure_reporting(device)
   log.info("=== LITTERBOX v20 configure done ===")
 end
 
+-- Lifecycle: preferences changed
+local function info_changed(driver, device, event, args)
+  local old = args.old_st_store.preferences or {}
+  local new = device.preferences or {}
+  if old.nh3ReportMin ~= new.nh3ReportMin or old.nh3ReportMax ~= new.nh3ReportMax
+      or old.nh3ReportChange ~= new.nh3ReportChange or old.sampleBlockPeriod ~= new.sampleBlockPeriod then
+    configure_reporting(device)
+  end
+end
+
 local driver_template = {
   supported_capabilities = {
     nh3Measurement,
@@ -82,13 +596,31 @@ local driver_template = {
       [NH3_CLUSTER_ID] = {
         [NH3_MEASURED_VALUE_ATTR] = nh3_attr_handler,
         [NH3_EVENT_TYPE_ATTR]     = event_type_attr_handler,
+        [NH3_SAMPLE_BLOCK_ATTR]   = sample_block_attr_handler,
+        [NH3_EVENT_JOURNAL_ATTR]  = event_journal_attr_handler,
+        [NH3_SNIPPET_INFO_ATTR]   = snippet_info_attr_handler,
+        [NH3_PROVISIONAL_ATTR]    = provisional_attr_handler,
+        [NH3_USAGE_24H_ATTR]      = usage_24h_attr_handler,
+        [NH3_USAGE_DAYS_ATTR]     = usage_days_attr_handler,
+      },
+      [DIAG_CLUSTER_ID] = diag_handlers,
+    },
+    global = {
+      [NH3_CLUSTER_ID] = {
+        [CONFIGURE_REPORTING_RESPONSE] = configure_reporting_response_handler,
+      },
+    },
+    cluster = {
+      [NH3_CLUSTER_ID] = {
+        [SNIPPET_CMD_FRAGMENT] = snippet_fragment_handler,
       },
-    }
+    },
   },
   lifecycle_handlers = {
     added   = device_added,
     init    = device_init,
     doConfigure = do_configure,
+    infoChanged = info_changed,
   },
   health_check = false,
 }
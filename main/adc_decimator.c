@@ -0,0 +1,66 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * adc_decimator.c — CIC decimation filter implementation
+ */
+#include "adc_decimator.h"
+#include <string.h>
+
+esp_err_t adc_decimator_init(adc_decimator_t *d, uint8_t order, uint16_t ratio)
+{
+    if (!d || order < 1 || order > ADC_DECIM_MAX_ORDER || ratio < 1) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    /* Register growth: N·⌈log2 R⌉ bits on top of the input width */
+    unsigned log2_r = 0;
+    while ((1u << log2_r) < ratio) {
+        log2_r++;
+    }
+    if (ADC_DECIM_INPUT_BITS + order * log2_r > 32) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(d, 0, sizeof(*d));
+    d->order = order;
+    d->ratio = ratio;
+    d->gain  = 1;
+    for (uint8_t i = 0; i < order; i++) {
+        d->gain *= ratio;
+    }
+    d->primed = order - 1;
+    return ESP_OK;
+}
+
+bool adc_decimator_push(adc_decimator_t *d, uint16_t raw, uint16_t *out)
+{
+    /* Integrators run at the input rate */
+    uint32_t acc = raw;
+    for (uint8_t i = 0; i < d->order; i++) {
+        d->integ[i] += acc;
+        acc = d->integ[i];
+    }
+
+    if (++d->phase < d->ratio) {
+        return false;
+    }
+    d->phase = 0;
+
+    /* Combs run at the output rate */
+    for (uint8_t i = 0; i < d->order; i++) {
+        uint32_t prev = d->comb[i];
+        d->comb[i] = acc;
+        acc -= prev;
+    }
+
+    /* The first N−1 outputs span samples before the stream started */
+    if (d->primed) {
+        d->primed--;
+        return false;
+    }
+
+    *out = (uint16_t)((acc + d->gain / 2) / d->gain);
+    return true;
+}
@@ -0,0 +1,61 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * adc_decimator.h — CIC decimation filter for oversampled ADC streams
+ *
+ * N-stage cascaded integrator-comb filter, decimation ratio R, differential
+ * delay 1. Order 1 is a plain boxcar average of R samples; higher orders
+ * give steeper alias rejection at the cost of a longer (N·R − N + 1) span.
+ * Output is normalised by the DC gain R^N, so it stays in raw ADC codes.
+ *
+ * Integer-only, fixed memory, no platform dependencies: safe to call from
+ * the ADC conversion-done ISR and buildable on the host.
+ *
+ * Registers are uint32_t and rely on modular wrap-around, which CIC
+ * tolerates as long as 12 + N·⌈log2 R⌉ ≤ 32 (checked by init).
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ADC_DECIM_MAX_ORDER     3
+#define ADC_DECIM_INPUT_BITS    12
+
+typedef struct {
+    uint32_t integ[ADC_DECIM_MAX_ORDER];    /* Integrator stages (wrap-around) */
+    uint32_t comb[ADC_DECIM_MAX_ORDER];     /* Comb delay lines, one per stage */
+    uint32_t gain;                          /* R^N */
+    uint16_t ratio;                         /* R */
+    uint16_t phase;                         /* Samples since last output */
+    uint8_t  order;                         /* N */
+    uint8_t  primed;                        /* Start-up outputs still to discard (N−1) */
+} adc_decimator_t;
+
+/**
+ * @brief Initialize (or reset) a decimator.
+ *
+ * @param order  CIC order N, 1..ADC_DECIM_MAX_ORDER (1 = boxcar)
+ * @param ratio  Decimation ratio R, ≥ 1
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG if the registers could overflow
+ */
+esp_err_t adc_decimator_init(adc_decimator_t *d, uint8_t order, uint16_t ratio);
+
+/**
+ * @brief Push one raw sample.
+ *
+ * @param[out] out  Decimated sample (raw ADC code), written when true is returned
+ * @return true once every R samples, after the first N−1 start-up outputs
+ */
+bool adc_decimator_push(adc_decimator_t *d, uint16_t raw, uint16_t *out);
+
+#ifdef __cplusplus
+}
+#endif
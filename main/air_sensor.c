@@ -0,0 +1,88 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * LitterBox.v1 - Air Quality Sensor backend selection
+ *
+ * air_sensor_init() / _start() / _poll() go to one backend: the one picked
+ * in menuconfig, unless air_sensor_select() switched to another. The only
+ * state kept here is whether a conversion is in flight, so a switch never
+ * strands one.
+ */
+
+#include "air_sensor_driver.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "AIR_SENSOR";
+
+#if CONFIG_LITTERBOX_SENSOR_BACKEND_I2C_NH3
+#define AIR_SENSOR_DEFAULT_BACKEND  air_sensor_i2c_nh3
+#else
+#define AIR_SENSOR_DEFAULT_BACKEND  air_sensor_mq135
+#endif
+
+static const air_sensor_backend_t *s_backend = &AIR_SENSOR_DEFAULT_BACKEND;
+static bool                        s_in_flight = false;
+
+esp_err_t air_sensor_select(const air_sensor_backend_t *backend)
+{
+    ESP_RETURN_ON_FALSE(backend, ESP_ERR_INVALID_ARG, TAG, "No backend");
+    ESP_RETURN_ON_FALSE(!s_in_flight, ESP_ERR_INVALID_STATE, TAG,
+                        "%s conversion in flight", s_backend->name);
+    if (backend != s_backend) {
+        ESP_LOGI(TAG, "Sensor backend: %s → %s", s_backend->name, backend->name);
+        s_backend = backend;
+    }
+    return ESP_OK;
+}
+
+const air_sensor_backend_t *air_sensor_backend(void)
+{
+    return s_backend;
+}
+
+esp_err_t air_sensor_init(void)
+{
+    s_in_flight = false;
+    return s_backend->init();
+}
+
+esp_err_t air_sensor_start(void)
+{
+    esp_err_t err = s_backend->start();
+    s_in_flight |= err == ESP_OK;
+    return err;
+}
+
+esp_err_t air_sensor_poll(air_sensor_data_t *out)
+{
+    if (!out) return ESP_ERR_INVALID_ARG;
+    esp_err_t err = s_backend->poll(out);
+    if (err != ESP_ERR_NOT_FINISHED) {
+        s_in_flight = false;
+    }
+    return err;
+}
+
+esp_err_t air_sensor_backend_read(const air_sensor_backend_t *backend, air_sensor_data_t *out)
+{
+    if (!out) return ESP_ERR_INVALID_ARG;
+    esp_err_t err = backend->start();
+    if (err != ESP_OK) {
+        return err;
+    }
+    while ((err = backend->poll(out)) == ESP_ERR_NOT_FINISHED) {
+        vTaskDelay(1);
+    }
+    return err;
+}
+
+esp_err_t air_sensor_read(air_sensor_data_t *out)
+{
+    ESP_RETURN_ON_FALSE(!s_in_flight, ESP_ERR_INVALID_STATE, TAG, "Conversion in flight");
+    return air_sensor_backend_read(s_backend, out);
+}
@@ -5,8 +5,25 @@
  *
  * LitterBox.v1 - Air Quality Sensor Driver Interface
  *
- * Abstract interface for NH₃ concentration sensing.
- * Concrete implementation: air_sensor_driver_MQ135.c
+ * Abstract interface for NH₃ concentration sensing. The sensor itself is a
+ * backend (air_sensor_backend_t) chosen at build time
+ * (CONFIG_LITTERBOX_SENSOR_BACKEND_*) and switchable at runtime with
+ * air_sensor_select():
+ *   air_sensor_mq135    MQ-135 on the ADC (air_sensor_driver_MQ135.c)
+ *   air_sensor_i2c_nh3  electrochemical NH₃ cell on I2C, trial
+ *                       (air_sensor_driver_i2c_nh3.c, CONFIG_LITTERBOX_SENSOR_I2C_NH3)
+ *   air_sensor_sim      CSV trace replay, host builds only (host/common/air_sensor_sim.h)
+ *
+ * Reads are split so the sample tick never waits on a bus:
+ * air_sensor_start() begins a conversion of every channel and returns at
+ * once; air_sensor_poll() returns ESP_ERR_NOT_FINISHED until it is done,
+ * then the readings. The firmware polls the conversion started on the
+ * previous tick and then starts the next one. air_sensor_read() is the
+ * blocking start + poll for tools and tests.
+ *
+ * One board can carry up to AIR_SENSOR_MAX_CHANNELS sensors (one per litter
+ * box, CONFIG_LITTERBOX_SENSOR_CHANNELS). A conversion covers all of them;
+ * each channel has its own calibration and warmup state.
  */
 
 #pragma once
@@ -19,40 +36,115 @@
 extern "C" {
 #endif
 
-/* MQ-135 heater warmup time before readings are reliable */
-#define AIR_SENSOR_WARMUP_MS    20000
+/* Default for builds without sdkconfig (host); see Kconfig.projbuild */
+#ifndef CONFIG_LITTERBOX_SENSOR_CHANNELS
+#define CONFIG_LITTERBOX_SENSOR_CHANNELS    1
+#endif
+
+#define AIR_SENSOR_MAX_CHANNELS 3       /* A0–A2: the XIAO ESP32-C6 analog pins */
+#define AIR_SENSOR_CHANNELS     CONFIG_LITTERBOX_SENSOR_CHANNELS
+
+/* nh3_ppm_q fixed-point format: unsigned Q10.6 (1 LSB = 1/64 ppm) */
+#define AIR_SENSOR_PPM_Q_SHIFT  6
 
 /**
  * @brief Sensor reading result.
  *
  * Always check `is_valid` before using nh3_ppm.
  * During warmup `is_warming_up` is true — values are recorded but unreliable.
+ * Warmup ends when Rs has settled (warmup_estimator.h), not after a fixed time.
+ * `is_settling` follows while the heater overshoot decays; feed it to
+ * event_detector_set_settling().
  */
 typedef struct {
     uint16_t nh3_ppm;       /**< NH₃ concentration (ppm), 0–1000, integer (for Zigbee) */
-    float    nh3_ppm_f;     /**< NH₃ concentration (ppm), floating-point (for event detector) */
+    float    nh3_ppm_f;     /**< NH₃ concentration (ppm), floating-point (for event detector); 0 in fixed-point builds */
+    uint16_t nh3_ppm_q;     /**< NH₃ concentration (ppm), Q10.6 fixed-point (AIR_SENSOR_PPM_Q_SHIFT) */
     uint32_t raw_adc;       /**< Raw 12-bit ADC value (0–4095), for diagnostics */
     bool     is_warming_up; /**< True while sensor heater is warming up */
+    bool     is_settling;   /**< Warm, but the heater overshoot is still decaying */
     bool     is_valid;      /**< False on ADC read error; true otherwise */
 } air_sensor_data_t;
 
 /**
- * @brief Initialize the air quality sensor.
- *        Must be called once before air_sensor_read().
- *        Starts the internal warmup timer.
+ * @brief Sensor backend. Every entry is required; all run in the caller's
+ *        task, and only one conversion is in flight at a time.
+ */
+typedef struct {
+    const char *name;
+    /** Bring up the hardware and start the warmup estimate. */
+    esp_err_t (*init)(void);
+    /** Begin a conversion of every channel; must not wait for it.
+     *  ESP_ERR_INVALID_STATE if not initialized or one is still in flight. */
+    esp_err_t (*start)(void);
+    /** ESP_ERR_NOT_FINISHED while the conversion runs. Otherwise fills
+     *  out[0..AIR_SENSOR_CHANNELS-1] and returns as air_sensor_read() does;
+     *  ESP_ERR_INVALID_STATE if nothing was started. */
+    esp_err_t (*poll)(air_sensor_data_t *out);
+} air_sensor_backend_t;
+
+extern const air_sensor_backend_t air_sensor_mq135;
+#if CONFIG_LITTERBOX_SENSOR_I2C_NH3
+extern const air_sensor_backend_t air_sensor_i2c_nh3;
+#endif
+
+/**
+ * @brief Switch to another backend. Call air_sensor_init() afterwards.
+ *
+ * @return ESP_ERR_INVALID_STATE while a conversion of the current backend
+ *         is in flight (poll it to completion first).
+ */
+esp_err_t air_sensor_select(const air_sensor_backend_t *backend);
+
+/**
+ * @brief The backend air_sensor_init() / _start() / _poll() go to.
+ */
+const air_sensor_backend_t *air_sensor_backend(void);
+
+/**
+ * @brief Initialize the selected sensor backend.
+ *        Must be called once before air_sensor_start() / air_sensor_read().
+ *        Starts the warmup (heater settling) estimate.
  *
  * @return ESP_OK on success.
  */
 esp_err_t air_sensor_init(void);
 
 /**
- * @brief Read the current NH₃ concentration.
+ * @brief Begin a conversion of every channel without waiting for it.
+ *
+ * @return ESP_OK, ESP_ERR_INVALID_STATE if not initialized or a conversion
+ *         is still in flight, or the backend's bus error.
+ */
+esp_err_t air_sensor_start(void);
+
+/**
+ * @brief Collect the conversion begun by air_sensor_start(), if it is done.
  *
- * @param[out] out  Populated with sensor data. Never NULL.
- * @return ESP_OK on success, ESP_ERR_INVALID_STATE if not initialized.
+ * @param[out] out  AIR_SENSOR_CHANNELS readings, out[i] for channel i. Never
+ *                  NULL. Untouched while ESP_ERR_NOT_FINISHED.
+ * @return ESP_ERR_NOT_FINISHED while it runs, ESP_ERR_INVALID_STATE if none
+ *         was started, else as air_sensor_read().
+ */
+esp_err_t air_sensor_poll(air_sensor_data_t *out);
+
+/**
+ * @brief Read the current NH₃ concentration of every channel: start a
+ *        conversion and wait for it (a one-tick delay between polls).
+ *
+ * @param[out] out  AIR_SENSOR_CHANNELS readings, out[i] for channel i. Never NULL.
+ * @return ESP_OK if every channel was read, else the first channel's read
+ *         error (the other channels are still filled in; check is_valid),
+ *         ESP_ERR_INVALID_STATE if not initialized.
  */
 esp_err_t air_sensor_read(air_sensor_data_t *out);
 
+/**
+ * @brief air_sensor_read() on a given backend, bypassing the selection
+ *        (host tools comparing backends side by side).
+ */
+esp_err_t air_sensor_backend_read(const air_sensor_backend_t *backend, air_sensor_data_t *out);
+
 #ifdef __cplusplus
 }
 #endif
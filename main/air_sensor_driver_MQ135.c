@@ -3,11 +3,15 @@
  *
  * SPDX-License-Identifier: CC0-1.0
  *
- * LitterBox.v1 - MQ-135 Air Quality Sensor Driver
+ * LitterBox.v1 - MQ-135 Air Quality Sensor Driver (backend air_sensor_mq135)
  *
  * Reads NH₃ (ammonia) concentration via ESP32-C6 ADC and converts the
  * raw voltage to ppm using the MQ-135 sensitivity curve.
  *
+ * A SAR conversion takes microseconds and needs no bus, so start() only
+ * arms the scan and poll() performs it: the reading is as fresh as the
+ * poll, and the tick's poll-then-start order adds no delay.
+ *
  * ── Hardware wiring ──────────────────────────────────────────────────────
  *  MQ-135 AOUT → GPIO0 (XIAO ESP32-C6 A0 = ADC1_CHANNEL_0)
  *
@@ -43,50 +47,256 @@
  * ── NH₃ sensitivity curve ────────────────────────────────────────────────
  *  ppm = A × (Rs/R0)^B
  *  A = 102.2, B = −2.473   (empirical from MQ-135 datasheet + library)
+ *
+ * ── Fixed-point build (CONFIG_LITTERBOX_FIXED_POINT) ─────────────────────
+ *  The ESP32-C6 has no FPU, so the division + powf() chain below costs
+ *  thousands of soft-float cycles per sample. With the option enabled the
+ *  whole chain is replaced by one lookup in a 4096-entry table generated
+ *  from mq135_params.h by scripts/gen_mq135_lut.py at build time.
+ *  Constants (RL, VCC, divider, curve, R0) live in mq135_params.h.
+ *
+ * ── Continuous sampling (CONFIG_LITTERBOX_ADC_CONTINUOUS) ────────────────
+ *  Instead of one adc_oneshot_read() per tick, the ADC digital controller
+ *  samples GPIO0 continuously (default 1 kHz) into DMA frames. Each frame is
+ *  folded into a CIC decimator (adc_decimator.c) from the conversion-done
+ *  callback, so the CPU never polls the ADC; poll() just picks up the
+ *  latest decimated code. That code is corrected with the eFuse
+ *  curve-fitting calibration and mapped back onto the nominal
+ *  raw/4095 × 3.3 V scale, so the ppm model and lookup table are unchanged.
+ *
+ * ── Warmup ───────────────────────────────────────────────────────────────
+ *  is_warming_up is not a fixed timer: every reading also feeds an Rs
+ *  settling test (warmup_estimator.c). The sensor counts as warm at the
+ *  first window where Rs has nearly stopped drifting and its scatter is
+ *  small, or after WARMUP_MAX_MS. is_settling then stays set until the
+ *  heater overshoot has decayed, so the detector can track it.
+ *
+ * ── Several sensors (CONFIG_LITTERBOX_SENSOR_CHANNELS) ───────────────────
+ *  Channel i is XIAO Ai = GPIOi = ADC1_CHANNEL_i, each with its own divider
+ *  and its own R0 (CONFIG_LITTERBOX_MQ135_R0_CHi_OHM). poll() reads them
+ *  back to back in one scan; in continuous mode the digital
+ *  controller interleaves them in one pattern at N × the per-channel rate,
+ *  and a read only picks up the N latest decimated codes. The fixed-point
+ *  table is built for MQ135_R0_KOHM: since ppm ∝ R0^−B, another R0 is one
+ *  Q16 multiply by (R0 / MQ135_R0_KOHM)^−B, computed once at init. Per
+ *  channel a tick costs the same whatever N is.
  */
 
 #include "air_sensor_driver.h"
+#include "mq135_params.h"
 #include "esp_log.h"
 #include "esp_timer.h"
 #include "esp_check.h"
-#include "esp_adc/adc_oneshot.h"
+#include "stage_stats.h"
+#include "warmup_estimator.h"
 #include <math.h>
 
+#if CONFIG_LITTERBOX_ADC_CONTINUOUS
+#include "esp_adc/adc_continuous.h"
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "freertos/FreeRTOS.h"
+#include "adc_decimator.h"
+#else
+#include "esp_adc/adc_oneshot.h"
+#endif
+
+#if CONFIG_LITTERBOX_FIXED_POINT
+#include "mq135_lut.h"      /* Generated at build time from mq135_params.h */
+#endif
+
 static const char *TAG = "MQ135";
 
+/* Per-tick debug lines; with CONFIG_LITTERBOX_BINARY_TRACE the trace frame carries the same data */
+#if CONFIG_LITTERBOX_BINARY_TRACE
+#define TICK_LOGD(...)  do { } while (0)
+#else
+#define TICK_LOGD(...)  ESP_LOGD(TAG, __VA_ARGS__)
+#endif
+
 /* ── ADC configuration ──────────────────────────────────────────────── */
 #define MQ135_ADC_UNIT          ADC_UNIT_1
-#define MQ135_ADC_CHANNEL       ADC_CHANNEL_0   /* GPIO0 = XIAO A0 */
+#define MQ135_ADC_CHANNEL(ch)   ((adc_channel_t)(ADC_CHANNEL_0 + (ch)))    /* GPIOch = XIAO A<ch> */
 #define MQ135_ADC_ATTEN         ADC_ATTEN_DB_12 /* Input range 0 ~ 3.1 V */
 #define MQ135_ADC_BITWIDTH      ADC_BITWIDTH_12  /* 0 ~ 4095 */
 
-/* ── Electrical constants ───────────────────────────────────────────── */
-#define MQ135_LOAD_RESISTANCE_KOHM  10.0f   /* RL on module board (kΩ) */
-#define MQ135_VCC                   5.0f    /* Sensor supply voltage (V) — VBUS */
-#define MQ135_DIVIDER_RATIO         2.0f    /* AOUT voltage divider (100kΩ:100kΩ = ×2) */
-#define MQ135_ADC_VREF              3.3f    /* ESP32-C6 ADC reference voltage (V) */
+/* Raw code at AOUT = VCC (Rs = 0), for the Rs proxy; constant-folded */
+#define MQ135_RAW_AT_VCC        ((int32_t)(4095.0f * MQ135_VCC / (MQ135_DIVIDER_RATIO * MQ135_ADC_VREF)))
 
-/* ── NH₃ sensitivity curve ──────────────────────────────────────────── */
-#define MQ135_NH3_CURVE_A   102.2f
-#define MQ135_NH3_CURVE_B   (-2.473f)
+/* Per-channel R0 (Ω); defaults for builds without sdkconfig (host) or unused channels */
+#ifndef CONFIG_LITTERBOX_MQ135_R0_CH0_OHM
+#define CONFIG_LITTERBOX_MQ135_R0_CH0_OHM   ((int)(MQ135_R0_KOHM * 1000.0f + 0.5f))
+#endif
+#ifndef CONFIG_LITTERBOX_MQ135_R0_CH1_OHM
+#define CONFIG_LITTERBOX_MQ135_R0_CH1_OHM   CONFIG_LITTERBOX_MQ135_R0_CH0_OHM
+#endif
+#ifndef CONFIG_LITTERBOX_MQ135_R0_CH2_OHM
+#define CONFIG_LITTERBOX_MQ135_R0_CH2_OHM   CONFIG_LITTERBOX_MQ135_R0_CH0_OHM
+#endif
 
-/* ── R0: clean-air reference resistance (kΩ) ────────────────────────── */
-/* Calibrated 2026-02-23 @ 5 V + 100kΩ:100kΩ divider, window open (~30 min warmup):
- *   avg raw=953 (n=6), V_adc=0.768V, AOUT=1.536V, Rs=22.55kΩ, R0=Rs/3.6=6.3kΩ
- *   V_adc = raw/4095 × 3.3,  AOUT = V_adc × 2.0
- *   Rs = RL × (5.0 − AOUT) / AOUT,  R0 = Rs / 3.6 */
-#define MQ135_R0_KOHM       6.3f
+_Static_assert(AIR_SENSOR_CHANNELS >= 1 && AIR_SENSOR_CHANNELS <= AIR_SENSOR_MAX_CHANNELS,
+               "CONFIG_LITTERBOX_SENSOR_CHANNELS out of range");
 
-/* ── Output clamp ───────────────────────────────────────────────────── */
-#define MQ135_PPM_MAX       1000
+#if CONFIG_LITTERBOX_ADC_CONTINUOUS
+#define MQ135_ADC_FRAME_BYTES   (64 * SOC_ADC_DIGI_RESULT_BYTES)   /* DMA frame: 64 conversions */
+#define MQ135_ADC_VREF_MV       ((int)(MQ135_ADC_VREF * 1000.0f))
+#endif
 
 /* ── Module state ───────────────────────────────────────────────────── */
+static const int k_r0_ohm[AIR_SENSOR_MAX_CHANNELS] = {
+    CONFIG_LITTERBOX_MQ135_R0_CH0_OHM, CONFIG_LITTERBOX_MQ135_R0_CH1_OHM, CONFIG_LITTERBOX_MQ135_R0_CH2_OHM,
+};
+
+typedef struct {
+    warmup_estimator_t warmup;
+#if CONFIG_LITTERBOX_FIXED_POINT
+    uint32_t           lut_scale_q16;   /* (R0 / MQ135_R0_KOHM)^−B, Q16 */
+#else
+    float              r0_kohm;
+#endif
+#if CONFIG_LITTERBOX_ADC_CONTINUOUS
+    adc_decimator_t    decim;           /* ISR-owned once started */
+    adc_cali_handle_t  cali;
+    uint16_t           decim_raw;       /* Latest decimated code */
+    uint32_t           decim_count;     /* Decimated codes produced */
+#endif
+} mq135_channel_t;
+
+#if CONFIG_LITTERBOX_ADC_CONTINUOUS
+static adc_continuous_handle_t   s_adc_handle = NULL;
+static portMUX_TYPE              s_decim_lock = portMUX_INITIALIZER_UNLOCKED;
+#else
 static adc_oneshot_unit_handle_t s_adc_handle = NULL;
+#endif
+static mq135_channel_t           s_ch[AIR_SENSOR_CHANNELS];
 static int64_t                   s_init_time_us = 0;
+static bool                      s_armed = false;    /* start() called, poll() pending */
 
 /* ─────────────────────────────────────────────────────────────────────── */
 
-esp_err_t air_sensor_init(void)
+#if CONFIG_LITTERBOX_ADC_CONTINUOUS
+
+/* DMA frame complete (ISR context): fold the conversions into the decimator */
+static bool mq135_conv_done_cb(adc_continuous_handle_t handle,
+                               const adc_continuous_evt_data_t *edata, void *user_data)
+{
+    for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= edata->size; i += SOC_ADC_DIGI_RESULT_BYTES) {
+        const adc_digi_output_data_t *p = (const adc_digi_output_data_t *)&edata->conv_frame_buffer[i];
+        uint32_t ch = p->type2.channel - ADC_CHANNEL_0;
+        uint16_t decimated;
+        if (ch >= AIR_SENSOR_CHANNELS) {
+            continue;
+        }
+        if (adc_decimator_push(&s_ch[ch].decim, (uint16_t)p->type2.data, &decimated)) {
+            portENTER_CRITICAL_ISR(&s_decim_lock);
+            s_ch[ch].decim_raw = decimated;
+            s_ch[ch].decim_count++;
+            portEXIT_CRITICAL_ISR(&s_decim_lock);
+        }
+    }
+    return false;   /* No higher-priority task woken */
+}
+
+static esp_err_t mq135_adc_init(void)
+{
+    for (int ch = 0; ch < AIR_SENSOR_CHANNELS; ch++) {
+        ESP_RETURN_ON_ERROR(adc_decimator_init(&s_ch[ch].decim, CONFIG_LITTERBOX_ADC_DECIM_ORDER,
+                                               CONFIG_LITTERBOX_ADC_DECIM_RATIO),
+                            TAG, "Invalid CIC order/ratio");
+    }
+
+    adc_continuous_handle_cfg_t handle_cfg = {
+        .max_store_buf_size = MQ135_ADC_FRAME_BYTES,    /* Data is consumed in the callback */
+        .conv_frame_size    = MQ135_ADC_FRAME_BYTES,
+        .flags.flush_pool   = 1,
+    };
+    ESP_RETURN_ON_ERROR(adc_continuous_new_handle(&handle_cfg, &s_adc_handle),
+                        TAG, "ADC continuous init failed");
+
+    /* One pattern entry per channel, scanned in turn: each keeps the configured rate */
+    adc_digi_pattern_config_t pattern[AIR_SENSOR_CHANNELS];
+    for (int ch = 0; ch < AIR_SENSOR_CHANNELS; ch++) {
+        pattern[ch] = (adc_digi_pattern_config_t) {
+            .atten     = MQ135_ADC_ATTEN,
+            .channel   = MQ135_ADC_CHANNEL(ch),
+            .unit      = MQ135_ADC_UNIT,
+            .bit_width = MQ135_ADC_BITWIDTH,
+        };
+    }
+    adc_continuous_config_t dig_cfg = {
+        .pattern_num    = AIR_SENSOR_CHANNELS,
+        .adc_pattern    = pattern,
+        .sample_freq_hz = CONFIG_LITTERBOX_ADC_SAMPLE_FREQ_HZ * AIR_SENSOR_CHANNELS,
+        .conv_mode      = ADC_CONV_SINGLE_UNIT_1,
+        .format         = ADC_DIGI_OUTPUT_FORMAT_TYPE2,
+    };
+    ESP_RETURN_ON_ERROR(adc_continuous_config(s_adc_handle, &dig_cfg),
+                        TAG, "ADC continuous config failed");
+
+    adc_continuous_evt_cbs_t cbs = {
+        .on_conv_done = mq135_conv_done_cb,
+    };
+    ESP_RETURN_ON_ERROR(adc_continuous_register_event_callbacks(s_adc_handle, &cbs, NULL),
+                        TAG, "ADC callback registration failed");
+
+    bool calibrated = true;
+    for (int ch = 0; ch < AIR_SENSOR_CHANNELS; ch++) {
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+        adc_cali_curve_fitting_config_t cali_cfg = {
+            .unit_id  = MQ135_ADC_UNIT,
+            .chan     = MQ135_ADC_CHANNEL(ch),
+            .atten    = MQ135_ADC_ATTEN,
+            .bitwidth = MQ135_ADC_BITWIDTH,
+        };
+        if (adc_cali_create_scheme_curve_fitting(&cali_cfg, &s_ch[ch].cali) != ESP_OK) {
+            s_ch[ch].cali = NULL;
+        }
+#endif
+        calibrated &= s_ch[ch].cali != NULL;
+    }
+    if (!calibrated) {
+        ESP_LOGW(TAG, "eFuse ADC calibration unavailable — using nominal raw/4095 × Vref");
+    }
+
+    ESP_RETURN_ON_ERROR(adc_continuous_start(s_adc_handle), TAG, "ADC continuous start failed");
+    ESP_LOGI(TAG, "Continuous ADC: %d channel(s) × %d Hz, CIC order %d ÷%d (%d ms/output), calibration %s",
+             AIR_SENSOR_CHANNELS, CONFIG_LITTERBOX_ADC_SAMPLE_FREQ_HZ, CONFIG_LITTERBOX_ADC_DECIM_ORDER,
+             CONFIG_LITTERBOX_ADC_DECIM_RATIO,
+             CONFIG_LITTERBOX_ADC_DECIM_RATIO * 1000 / CONFIG_LITTERBOX_ADC_SAMPLE_FREQ_HZ,
+             calibrated ? "eFuse curve fitting" : "none");
+    return ESP_OK;
+}
+
+/* Latest decimated, calibrated code of a channel on the nominal 0–4095 scale */
+static esp_err_t mq135_sample_raw(int ch, int *raw)
+{
+    uint16_t decimated;
+    uint32_t count;
+
+    portENTER_CRITICAL(&s_decim_lock);
+    decimated = s_ch[ch].decim_raw;
+    count     = s_ch[ch].decim_count;
+    portEXIT_CRITICAL(&s_decim_lock);
+
+    if (count == 0) {
+        return ESP_ERR_TIMEOUT;     /* First decimation window not complete yet */
+    }
+    if (!s_ch[ch].cali) {
+        *raw = decimated;
+        return ESP_OK;
+    }
+
+    int mv = 0;
+    ESP_RETURN_ON_ERROR(adc_cali_raw_to_voltage(s_ch[ch].cali, decimated, &mv),
+                        TAG, "ADC calibration failed");
+    int code = (mv * 4095 + MQ135_ADC_VREF_MV / 2) / MQ135_ADC_VREF_MV;
+    *raw = code > 4095 ? 4095 : code;
+    return ESP_OK;
+}
+
+#else /* one-shot */
+
+static esp_err_t mq135_adc_init(void)
 {
     adc_oneshot_unit_init_cfg_t unit_cfg = {
         .unit_id = MQ135_ADC_UNIT,
@@ -98,35 +308,65 @@ esp_err_t air_sensor_init(void)
         .bitwidth = MQ135_ADC_BITWIDTH,
         .atten    = MQ135_ADC_ATTEN,
     };
-    ESP_RETURN_ON_ERROR(adc_oneshot_config_channel(s_adc_handle, MQ135_ADC_CHANNEL, &chan_cfg),
-                        TAG, "ADC channel config failed");
+    for (int ch = 0; ch < AIR_SENSOR_CHANNELS; ch++) {
+        ESP_RETURN_ON_ERROR(adc_oneshot_config_channel(s_adc_handle, MQ135_ADC_CHANNEL(ch), &chan_cfg),
+                            TAG, "ADC channel config failed");
+    }
+    return ESP_OK;
+}
+
+static esp_err_t mq135_sample_raw(int ch, int *raw)
+{
+    return adc_oneshot_read(s_adc_handle, MQ135_ADC_CHANNEL(ch), raw);
+}
+
+#endif /* CONFIG_LITTERBOX_ADC_CONTINUOUS */
+
+static esp_err_t mq135_init(void)
+{
+    ESP_RETURN_ON_ERROR(mq135_adc_init(), TAG, "ADC init failed");
 
     s_init_time_us = esp_timer_get_time();
-    ESP_LOGI(TAG, "MQ-135 initialized on GPIO0 (ADC1_CH0), VCC=%.1fV divider=%.1f R0=%.1f kΩ, warmup %d ms",
-             (double)MQ135_VCC, (double)MQ135_DIVIDER_RATIO, (double)MQ135_R0_KOHM, AIR_SENSOR_WARMUP_MS);
+    s_armed = false;
+    for (int ch = 0; ch < AIR_SENSOR_CHANNELS; ch++) {
+        float r0_kohm = k_r0_ohm[ch] / 1000.0f;
+        warmup_estimator_init(&s_ch[ch].warmup);
+#if CONFIG_LITTERBOX_FIXED_POINT
+        /* The only float math: once per channel, here */
+        s_ch[ch].lut_scale_q16 = (uint32_t)(powf(r0_kohm / MQ135_R0_KOHM, -MQ135_NH3_CURVE_B) * 65536.0f + 0.5f);
+#else
+        s_ch[ch].r0_kohm = r0_kohm;
+#endif
+        ESP_LOGI(TAG, "MQ-135 channel %d on GPIO%d (ADC1_CH%d), R0=%.2f kΩ", ch, ch, ch, (double)r0_kohm);
+    }
+    ESP_LOGI(TAG, "MQ-135 initialized: %d channel(s), VCC=%.1fV divider=%.1f, warmup ≤ %d ms",
+             AIR_SENSOR_CHANNELS, (double)MQ135_VCC, (double)MQ135_DIVIDER_RATIO, WARMUP_MAX_MS);
     return ESP_OK;
 }
 
-esp_err_t air_sensor_read(air_sensor_data_t *out)
+/* raw → ppm for one channel (is_valid, raw_adc and is_warming_up already set) */
+static void mq135_convert(int ch, int raw, air_sensor_data_t *out)
 {
-    if (!out)          return ESP_ERR_INVALID_ARG;
-    if (!s_adc_handle) return ESP_ERR_INVALID_STATE;
-
-    int64_t elapsed_ms = (esp_timer_get_time() - s_init_time_us) / 1000LL;
-    out->is_warming_up = (elapsed_ms < AIR_SENSOR_WARMUP_MS);
-
-    /* Read raw ADC */
-    int raw = 0;
-    esp_err_t ret = adc_oneshot_read(s_adc_handle, MQ135_ADC_CHANNEL, &raw);
-    if (ret != ESP_OK) {
-        out->is_valid = false;
-        out->nh3_ppm  = 0;
-        out->raw_adc  = 0;
-        ESP_LOGW(TAG, "ADC read error: %s", esp_err_to_name(ret));
-        return ret;
+#if CONFIG_LITTERBOX_FIXED_POINT
+    /* raw → ppm via precomputed table and the channel's R0 factor — integer only, no soft-float */
+    if (raw >= MQ135_LUT_SIZE) raw = MQ135_LUT_SIZE - 1;
+    const uint32_t max_q = (uint32_t)MQ135_PPM_MAX << AIR_SENSOR_PPM_Q_SHIFT;
+    uint32_t ppm_q = mq135_ppm_lut[raw];
+    /* A saturated entry stays at full scale: with R0 below MQ135_R0_KOHM
+     * (factor < 1) the table cannot tell how far above it the reading is */
+    if (ppm_q < max_q) {
+        ppm_q = (uint32_t)(((uint64_t)ppm_q * s_ch[ch].lut_scale_q16 + 0x8000) >> 16);
+        if (ppm_q > max_q) ppm_q = max_q;
     }
-    out->raw_adc = (uint32_t)raw;
+    out->nh3_ppm_q = (uint16_t)ppm_q;
+    out->nh3_ppm   = (uint16_t)(out->nh3_ppm_q >> AIR_SENSOR_PPM_Q_SHIFT);
+    out->nh3_ppm_f = 0.0f;
 
+    TICK_LOGD("ch%d raw=%"PRIu32" NH3=%u+%u/64ppm%s", ch,
+              out->raw_adc, out->nh3_ppm,
+              (unsigned)(out->nh3_ppm_q & ((1u << AIR_SENSOR_PPM_Q_SHIFT) - 1)),
+              out->is_warming_up ? " [WARMUP]" : "");
+#else
     /* raw → V_adc (what ADC sees after divider) */
     float v_adc = (raw / 4095.0f) * MQ135_ADC_VREF;
     if (v_adc < 0.001f) v_adc = 0.001f;    /* guard division by zero */
@@ -140,18 +380,91 @@ esp_err_t air_sensor_read(air_sensor_data_t *out)
     if (rs_kohm <= 0.0f) rs_kohm = 0.01f;
 
     /* Rs/R0 → NH₃ ppm */
-    float ratio = rs_kohm / MQ135_R0_KOHM;
+    float ratio = rs_kohm / s_ch[ch].r0_kohm;
     float ppm_f = MQ135_NH3_CURVE_A * powf(ratio, MQ135_NH3_CURVE_B);
     if (ppm_f < 0.0f)          ppm_f = 0.0f;
     if (ppm_f > MQ135_PPM_MAX) ppm_f = (float)MQ135_PPM_MAX;
 
     out->nh3_ppm   = (uint16_t)ppm_f;
     out->nh3_ppm_f = ppm_f;
-    out->is_valid  = true;
+    out->nh3_ppm_q = (uint16_t)(ppm_f * (1 << AIR_SENSOR_PPM_Q_SHIFT) + 0.5f);
 
-    ESP_LOGD(TAG, "raw=%"PRIu32" Vadc=%.3f Aout=%.3f Rs=%.2fkΩ Rs/R0=%.2f NH3=%.1fppm%s",
-             out->raw_adc, (double)v_adc, (double)voltage, (double)rs_kohm, (double)ratio, (double)ppm_f,
-             out->is_warming_up ? " [WARMUP]" : "");
+    TICK_LOGD("ch%d raw=%"PRIu32" Vadc=%.3f Aout=%.3f Rs=%.2fkΩ Rs/R0=%.2f NH3=%.1fppm%s", ch,
+              out->raw_adc, (double)v_adc, (double)voltage, (double)rs_kohm, (double)ratio, (double)ppm_f,
+              out->is_warming_up ? " [WARMUP]" : "");
+#endif
+}
 
+static esp_err_t mq135_start(void)
+{
+    if (!s_adc_handle || s_armed) return ESP_ERR_INVALID_STATE;
+    s_armed = true;
     return ESP_OK;
 }
+
+static esp_err_t mq135_poll(air_sensor_data_t *out)
+{
+    if (!out)     return ESP_ERR_INVALID_ARG;
+    if (!s_armed) return ESP_ERR_INVALID_STATE;
+    s_armed = false;
+
+    int64_t elapsed_ms = (esp_timer_get_time() - s_init_time_us) / 1000LL;
+
+    /* Read raw ADC: every channel in one scan */
+    int       raw[AIR_SENSOR_CHANNELS];
+    esp_err_t err[AIR_SENSOR_CHANNELS];
+    STAGE_BEGIN(t_adc);
+    for (int ch = 0; ch < AIR_SENSOR_CHANNELS; ch++) {
+        err[ch] = mq135_sample_raw(ch, &raw[ch]);
+    }
+    STAGE_END(STAGE_ADC_READ, t_adc);
+
+    esp_err_t ret = ESP_OK;
+    for (int ch = 0; ch < AIR_SENSOR_CHANNELS; ch++) {
+        air_sensor_data_t *o = &out[ch];
+        warmup_estimator_t *w = &s_ch[ch].warmup;
+        o->is_warming_up = !w->ready;
+        o->is_settling   = warmup_estimator_settling(w);
+        if (err[ch] != ESP_OK) {
+            o->is_valid  = false;
+            o->nh3_ppm   = 0;
+            o->nh3_ppm_q = 0;
+            o->raw_adc   = 0;
+            ESP_LOGW(TAG, "ADC read error on channel %d: %s", ch, esp_err_to_name(err[ch]));
+            ret = ret != ESP_OK ? ret : err[ch];
+            continue;
+        }
+        o->raw_adc  = (uint32_t)raw[ch];
+        o->is_valid = true;
+
+        if (!w->settled) {
+            bool was_warm = w->ready;
+            bool warm = warmup_estimator_push(w, warmup_rs_proxy_q12(raw[ch], MQ135_RAW_AT_VCC), elapsed_ms);
+            o->is_warming_up = !warm;
+            o->is_settling   = warmup_estimator_settling(w);
+            if (warm && !was_warm) {
+                ESP_LOGI(TAG, "Channel %d sensor warm after %lld ms", ch, (long long)elapsed_ms);
+            }
+            if (w->settled) {
+                ESP_LOGI(TAG, "Channel %d sensor settled after %lld ms", ch, (long long)elapsed_ms);
+            }
+        }
+    }
+
+    STAGE_BEGIN(t_conv);
+    for (int ch = 0; ch < AIR_SENSOR_CHANNELS; ch++) {
+        if (out[ch].is_valid) {
+            mq135_convert(ch, raw[ch], &out[ch]);
+        }
+    }
+    STAGE_END(STAGE_PPM_CONVERT, t_conv);
+
+    return ret;
+}
+
+const air_sensor_backend_t air_sensor_mq135 = {
+    .name  = "MQ-135",
+    .init  = mq135_init,
+    .start = mq135_start,
+    .poll  = mq135_poll,
+};
@@ -0,0 +1,318 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * LitterBox.v1 - I2C electrochemical NH₃ sensor (backend air_sensor_i2c_nh3, trial)
+ *
+ * For trialling a digital, factory-calibrated NH₃ cell next to the MQ-135:
+ * DFRobot SEN0469 (Gravity NH₃, 0–100 ppm) and other boards speaking its
+ * 9-byte frame protocol. Channel i is the board at
+ * CONFIG_LITTERBOX_I2C_NH3_ADDR + i (address switches on the board).
+ *
+ * ── Hardware wiring ──────────────────────────────────────────────────────
+ *  SDA → GPIO22 (XIAO D4), SCL → GPIO23 (XIAO D5), VCC 3.3 V, GND.
+ *  Internal pull-ups are enabled; add 4.7 kΩ externally for long leads.
+ *
+ * ── Protocol ─────────────────────────────────────────────────────────────
+ *  Host → sensor: register 0x00, then FF 01 <cmd> <arg> 00 00 00 00 <sum>
+ *  Sensor → host: FF <cmd> <b2> … <b7> <sum>, read after register 0x00
+ *  <sum> = two's complement of bytes 1..7. Init puts the board in passive
+ *  (query) mode (cmd 0x78, arg 0x04); a reading is cmd 0x86, answered with
+ *  concentration b2:b3, gas type b4 (0x02 = NH₃) and b5 decimal places.
+ *
+ * ── Non-blocking reads ───────────────────────────────────────────────────
+ *  The bus runs in asynchronous mode (trans_queue_depth > 0): transfers
+ *  are queued and complete in the background. start() queues the query
+ *  to every channel and arms a one-shot esp_timer for the conversion time;
+ *  the timer callback (esp_timer task) queues the reads; the transfer-done
+ *  callback (ISR) only counts completions. poll() returns
+ *  ESP_ERR_NOT_FINISHED until every channel's transfers are done, then
+ *  parses the frames — neither it nor start() ever waits on the bus.
+ *  Polled on the next 2 s tick, the reading is one tick old.
+ *
+ * ── Warmup ───────────────────────────────────────────────────────────────
+ *  The MQ-135 heater test (warmup_estimator.c) does not apply; the cell is
+ *  reported as warming up for I2C_NH3_WARMUP_MS after init.
+ */
+
+#include "air_sensor_driver.h"
+
+#if CONFIG_LITTERBOX_SENSOR_I2C_NH3
+
+#include "driver/i2c_master.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_check.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdatomic.h>
+
+static const char *TAG = "I2C_NH3";
+
+#define I2C_NH3_FRAME_BYTES     9
+#define I2C_NH3_REG_DATA        0x00
+#define I2C_NH3_CMD_MODE        0x78
+#define I2C_NH3_MODE_PASSIVE    0x04
+#define I2C_NH3_CMD_READ        0x86
+#define I2C_NH3_GAS_NH3         0x02
+#define I2C_NH3_SCL_HZ          100000
+#define I2C_NH3_XFER_TIMEOUT_MS 50          /* Per transfer, enforced by the driver */
+#define I2C_NH3_TIMEOUT_US      1000000LL   /* start() → poll() gives up on a channel */
+#define I2C_NH3_WARMUP_MS       180000      /* Conservative electrochemical settling after power-up */
+#define I2C_NH3_PPM_MAX         1000        /* Same ceiling as the MQ-135 path */
+
+typedef enum {
+    I2C_NH3_IDLE,
+    I2C_NH3_QUERY,      /* Queries queued, conversion timer armed */
+    I2C_NH3_READ,       /* Reads queued (or skipped) by the timer callback */
+} i2c_nh3_phase_t;
+
+typedef struct {
+    i2c_master_dev_handle_t dev;
+    atomic_uint             pending;    /* Queued transfers not completed yet (ISR decrements) */
+    atomic_bool             failed;     /* A transfer of this conversion was not ACKed */
+    esp_err_t               err;        /* Queueing error of this conversion */
+    uint8_t                 rx[I2C_NH3_FRAME_BYTES];
+} i2c_nh3_channel_t;
+
+static i2c_master_bus_handle_t s_bus = NULL;
+static esp_timer_handle_t      s_conv_timer = NULL;
+static i2c_nh3_channel_t       s_ch[AIR_SENSOR_CHANNELS];
+static atomic_int              s_phase = I2C_NH3_IDLE;
+static int64_t                 s_init_time_us = 0;
+static int64_t                 s_start_us = 0;
+static uint8_t                 s_cmd_read[1 + I2C_NH3_FRAME_BYTES];
+static const uint8_t           s_reg_data = I2C_NH3_REG_DATA;
+
+/* ─────────────────────────────────────────────────────────────────────── */
+
+static uint8_t i2c_nh3_checksum(const uint8_t *frame)
+{
+    uint8_t sum = 0;
+    for (int i = 1; i < I2C_NH3_FRAME_BYTES - 1; i++) {
+        sum += frame[i];
+    }
+    return (uint8_t)(~sum + 1);
+}
+
+/* Register byte + command frame */
+static void i2c_nh3_command(uint8_t out[1 + I2C_NH3_FRAME_BYTES], uint8_t cmd, uint8_t arg)
+{
+    uint8_t *f = &out[1];
+    out[0] = I2C_NH3_REG_DATA;
+    f[0] = 0xFF;
+    f[1] = 0x01;
+    f[2] = cmd;
+    f[3] = arg;
+    f[4] = f[5] = f[6] = f[7] = 0;
+    f[8] = i2c_nh3_checksum(f);
+}
+
+/* Transfer done (ISR context): count it, remember a NACK / timeout */
+static bool i2c_nh3_done_cb(i2c_master_dev_handle_t dev, const i2c_master_event_data_t *evt, void *arg)
+{
+    i2c_nh3_channel_t *c = arg;
+    if (evt->event != I2C_EVENT_DONE) {
+        atomic_store(&c->failed, true);
+    }
+    atomic_fetch_sub(&c->pending, 1);
+    return false;   /* No higher-priority task woken */
+}
+
+/* Queue one transfer; the done callback balances pending */
+static esp_err_t i2c_nh3_queue(i2c_nh3_channel_t *c, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len)
+{
+    atomic_fetch_add(&c->pending, 1);
+    esp_err_t err = rx ? i2c_master_transmit_receive(c->dev, tx, tx_len, rx, rx_len, I2C_NH3_XFER_TIMEOUT_MS)
+                       : i2c_master_transmit(c->dev, tx, tx_len, I2C_NH3_XFER_TIMEOUT_MS);
+    if (err != ESP_OK) {
+        atomic_fetch_sub(&c->pending, 1);
+    }
+    return err;
+}
+
+/* Conversion time over (esp_timer task): queue the reads */
+static void i2c_nh3_conv_timer_cb(void *arg)
+{
+    for (int ch = 0; ch < AIR_SENSOR_CHANNELS; ch++) {
+        i2c_nh3_channel_t *c = &s_ch[ch];
+        if (c->err == ESP_OK && !atomic_load(&c->failed)) {
+            c->err = i2c_nh3_queue(c, &s_reg_data, 1, c->rx, sizeof(c->rx));
+        }
+    }
+    atomic_store(&s_phase, I2C_NH3_READ);
+}
+
+/* Wait for a channel's queued transfers (init only) */
+static esp_err_t i2c_nh3_wait(i2c_nh3_channel_t *c)
+{
+    for (int ms = 0; atomic_load(&c->pending) != 0; ms += portTICK_PERIOD_MS) {
+        if (ms > 2 * I2C_NH3_XFER_TIMEOUT_MS) {
+            return ESP_ERR_TIMEOUT;
+        }
+        vTaskDelay(1);
+    }
+    return atomic_load(&c->failed) ? ESP_ERR_NOT_FOUND : ESP_OK;
+}
+
+static esp_err_t i2c_nh3_init(void)
+{
+    if (!s_bus) {
+        i2c_master_bus_config_t bus_cfg = {
+            .i2c_port          = -1,    /* Any free controller */
+            .sda_io_num        = CONFIG_LITTERBOX_I2C_NH3_SDA_GPIO,
+            .scl_io_num        = CONFIG_LITTERBOX_I2C_NH3_SCL_GPIO,
+            .clk_source        = I2C_CLK_SRC_DEFAULT,
+            .glitch_ignore_cnt = 7,
+            .trans_queue_depth = 2 * AIR_SENSOR_MAX_CHANNELS,  /* Asynchronous transfers */
+            .flags.enable_internal_pullup = true,
+        };
+        ESP_RETURN_ON_ERROR(i2c_new_master_bus(&bus_cfg, &s_bus), TAG, "I2C bus init failed");
+
+        for (int ch = 0; ch < AIR_SENSOR_CHANNELS; ch++) {
+            i2c_device_config_t dev_cfg = {
+                .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+                .device_address  = CONFIG_LITTERBOX_I2C_NH3_ADDR + ch,
+                .scl_speed_hz    = I2C_NH3_SCL_HZ,
+            };
+            ESP_RETURN_ON_ERROR(i2c_master_bus_add_device(s_bus, &dev_cfg, &s_ch[ch].dev), TAG, "I2C device add failed");
+            i2c_master_event_callbacks_t cbs = {
+                .on_trans_done = i2c_nh3_done_cb,
+            };
+            ESP_RETURN_ON_ERROR(i2c_master_register_event_callbacks(s_ch[ch].dev, &cbs, &s_ch[ch]),
+                                TAG, "I2C callback registration failed");
+        }
+
+        const esp_timer_create_args_t timer_args = {
+            .callback = i2c_nh3_conv_timer_cb,
+            .name     = "i2c_nh3_conv",
+        };
+        ESP_RETURN_ON_ERROR(esp_timer_create(&timer_args, &s_conv_timer), TAG, "Timer create failed");
+        i2c_nh3_command(s_cmd_read, I2C_NH3_CMD_READ, 0);
+    }
+
+    /* Passive mode: the board answers queries instead of streaming. Init
+     * may wait; a board that does not ACK fails init so the caller can
+     * fall back to another backend. */
+    uint8_t cmd_mode[1 + I2C_NH3_FRAME_BYTES];
+    i2c_nh3_command(cmd_mode, I2C_NH3_CMD_MODE, I2C_NH3_MODE_PASSIVE);
+    for (int ch = 0; ch < AIR_SENSOR_CHANNELS; ch++) {
+        i2c_nh3_channel_t *c = &s_ch[ch];
+        atomic_store(&c->failed, false);
+        ESP_RETURN_ON_ERROR(i2c_nh3_queue(c, cmd_mode, sizeof(cmd_mode), NULL, 0), TAG, "I2C queue failed");
+        ESP_RETURN_ON_ERROR(i2c_nh3_wait(c), TAG, "No NH3 sensor at 0x%02x",
+                            CONFIG_LITTERBOX_I2C_NH3_ADDR + ch);
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_LITTERBOX_I2C_NH3_CONVERSION_MS));
+        ESP_RETURN_ON_ERROR(i2c_nh3_queue(c, &s_reg_data, 1, c->rx, sizeof(c->rx)), TAG, "I2C queue failed");
+        ESP_RETURN_ON_ERROR(i2c_nh3_wait(c), TAG, "NH3 sensor at 0x%02x did not answer",
+                            CONFIG_LITTERBOX_I2C_NH3_ADDR + ch);
+        ESP_LOGI(TAG, "Channel %d: NH3 sensor at 0x%02x, passive mode", ch, CONFIG_LITTERBOX_I2C_NH3_ADDR + ch);
+    }
+
+    s_init_time_us = esp_timer_get_time();
+    atomic_store(&s_phase, I2C_NH3_IDLE);
+    ESP_LOGI(TAG, "I2C NH3 initialized: %d channel(s) on SDA=GPIO%d SCL=GPIO%d, conversion %d ms",
+             AIR_SENSOR_CHANNELS, CONFIG_LITTERBOX_I2C_NH3_SDA_GPIO, CONFIG_LITTERBOX_I2C_NH3_SCL_GPIO,
+             CONFIG_LITTERBOX_I2C_NH3_CONVERSION_MS);
+    return ESP_OK;
+}
+
+static esp_err_t i2c_nh3_start(void)
+{
+    if (!s_bus || atomic_load(&s_phase) != I2C_NH3_IDLE) return ESP_ERR_INVALID_STATE;
+
+    s_start_us = esp_timer_get_time();
+    for (int ch = 0; ch < AIR_SENSOR_CHANNELS; ch++) {
+        i2c_nh3_channel_t *c = &s_ch[ch];
+        atomic_store(&c->failed, false);
+        /* A channel still busy from a timed-out conversion sits this one out */
+        c->err = atomic_load(&c->pending) ? ESP_ERR_TIMEOUT
+               : i2c_nh3_queue(c, s_cmd_read, sizeof(s_cmd_read), NULL, 0);
+    }
+    atomic_store(&s_phase, I2C_NH3_QUERY);
+    return esp_timer_start_once(s_conv_timer, CONFIG_LITTERBOX_I2C_NH3_CONVERSION_MS * 1000ULL);
+}
+
+/* Concentration frame → reading (is_warming_up already set) */
+static esp_err_t i2c_nh3_parse(const uint8_t *f, air_sensor_data_t *out)
+{
+    static const uint16_t k_div[] = { 1, 10, 100 };
+
+    if (f[0] != 0xFF || f[1] != I2C_NH3_CMD_READ || f[8] != i2c_nh3_checksum(f)) {
+        return ESP_ERR_INVALID_CRC;
+    }
+    if (f[4] != I2C_NH3_GAS_NH3 || f[5] >= sizeof(k_div) / sizeof(k_div[0])) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    uint32_t counts = ((uint32_t)f[2] << 8) | f[3];
+    uint32_t div    = k_div[f[5]];
+    uint32_t ppm_q  = ((counts << AIR_SENSOR_PPM_Q_SHIFT) + div / 2) / div;
+    if (ppm_q > ((uint32_t)I2C_NH3_PPM_MAX << AIR_SENSOR_PPM_Q_SHIFT)) {
+        ppm_q = (uint32_t)I2C_NH3_PPM_MAX << AIR_SENSOR_PPM_Q_SHIFT;
+    }
+
+    out->raw_adc   = counts;
+    out->nh3_ppm_q = (uint16_t)ppm_q;
+    out->nh3_ppm   = (uint16_t)(ppm_q >> AIR_SENSOR_PPM_Q_SHIFT);
+#if CONFIG_LITTERBOX_FIXED_POINT
+    out->nh3_ppm_f = 0.0f;
+#else
+    out->nh3_ppm_f = (float)counts / div;
+#endif
+    return ESP_OK;
+}
+
+static esp_err_t i2c_nh3_poll(air_sensor_data_t *out)
+{
+    if (!out) return ESP_ERR_INVALID_ARG;
+    i2c_nh3_phase_t phase = atomic_load(&s_phase);
+    if (phase == I2C_NH3_IDLE) return ESP_ERR_INVALID_STATE;
+
+    int64_t now_us = esp_timer_get_time();
+    bool busy = phase == I2C_NH3_QUERY;
+    for (int ch = 0; ch < AIR_SENSOR_CHANNELS; ch++) {
+        busy |= atomic_load(&s_ch[ch].pending) != 0;
+    }
+    if (busy && now_us - s_start_us < I2C_NH3_TIMEOUT_US) {
+        return ESP_ERR_NOT_FINISHED;
+    }
+    if (phase == I2C_NH3_QUERY) {
+        /* The timer never ran (esp_timer task starved): no reads were queued */
+        esp_timer_stop(s_conv_timer);
+    }
+
+    bool warming = (now_us - s_init_time_us) / 1000 < I2C_NH3_WARMUP_MS;
+    esp_err_t ret = ESP_OK;
+    for (int ch = 0; ch < AIR_SENSOR_CHANNELS; ch++) {
+        i2c_nh3_channel_t *c = &s_ch[ch];
+        air_sensor_data_t *o = &out[ch];
+        esp_err_t err = c->err;
+        if (err == ESP_OK) {
+            err = phase == I2C_NH3_QUERY || atomic_load(&c->pending) ? ESP_ERR_TIMEOUT
+                : atomic_load(&c->failed)                             ? ESP_FAIL
+                : i2c_nh3_parse(c->rx, o);
+        }
+        o->is_warming_up = warming;
+        o->is_settling   = false;
+        o->is_valid      = err == ESP_OK;
+        if (err != ESP_OK) {
+            o->nh3_ppm   = 0;
+            o->nh3_ppm_q = 0;
+            o->raw_adc   = 0;
+            ESP_LOGW(TAG, "Read error on channel %d: %s", ch, esp_err_to_name(err));
+            ret = ret != ESP_OK ? ret : err;
+        }
+    }
+    atomic_store(&s_phase, I2C_NH3_IDLE);
+    return ret;
+}
+
+const air_sensor_backend_t air_sensor_i2c_nh3 = {
+    .name  = "I2C NH3",
+    .init  = i2c_nh3_init,
+    .start = i2c_nh3_start,
+    .poll  = i2c_nh3_poll,
+};
+
+#endif /* CONFIG_LITTERBOX_SENSOR_I2C_NH3 */
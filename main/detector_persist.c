@@ -0,0 +1,122 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * detector_persist.c — NVS snapshot of the event detector baseline
+ */
+#include "detector_persist.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "PERSIST";
+
+#define SAVE_DELTA_Q    (((int64_t)CONFIG_LITTERBOX_BASELINE_SAVE_DELTA_DPPM << EVENT_PPM_Q_SHIFT) / 10)
+#define RESTORE_TOL_Q   (((int64_t)CONFIG_LITTERBOX_BASELINE_RESTORE_TOL_DPPM << EVENT_PPM_Q_SHIFT) / 10)
+#define SAVE_MIN_US     ((int64_t)CONFIG_LITTERBOX_BASELINE_SAVE_MIN_S * 1000000)
+#define SAVE_MAX_US     ((int64_t)CONFIG_LITTERBOX_BASELINE_SAVE_MAX_MIN * 60 * 1000000)
+#define SNAPSHOT_V1_LEN 16      /* v2 + int64 save time */
+
+esp_err_t detector_persist_init(detector_persist_t *p, const char *key)
+{
+    detector_snapshot_t snap;
+    uint8_t buf[SNAPSHOT_V1_LEN];
+    size_t len = sizeof(buf);
+
+    memset(p, 0, sizeof(*p));
+    snprintf(p->key, sizeof(p->key), "%s", key);
+    ESP_RETURN_ON_ERROR(nvs_open(DETECTOR_PERSIST_NAMESPACE, NVS_READWRITE, &p->nvs), TAG, "nvs_open failed");
+    p->nvs_open     = true;
+    p->last_save_us = esp_timer_get_time();  /* First save no sooner than SAVE_MIN after boot */
+
+    esp_err_t err = nvs_get_blob(p->nvs, p->key, buf, &len);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        ESP_LOGI(TAG, "No baseline snapshot (%s) — cold start", p->key);
+        return ESP_OK;
+    }
+    /* A v1 snapshot is the v2 one followed by its save time */
+    bool readable = err == ESP_OK && len >= sizeof(snap)
+                 && ((buf[0] == DETECTOR_PERSIST_VERSION && len == sizeof(snap))
+                     || (buf[0] == 1 && len == SNAPSHOT_V1_LEN));
+    if (!readable) {
+        ESP_LOGW(TAG, "Ignoring unreadable baseline snapshot (%s, %u bytes)", esp_err_to_name(err), (unsigned)len);
+        return ESP_OK;
+    }
+    memcpy(&snap, buf, sizeof(snap));
+
+    p->snapshot = snap;
+    p->pending  = true;
+    ESP_LOGI(TAG, "Baseline snapshot %s %d.%02d ppm loaded, waiting for warmup", p->key,
+             EVENT_PPM_Q_INT(snap.baseline_q), EVENT_PPM_Q_HUND(snap.baseline_q));
+    return ESP_OK;
+}
+
+bool detector_persist_pending(const detector_persist_t *p)
+{
+    return p->pending;
+}
+
+bool detector_persist_restore(detector_persist_t *p, event_detector_t *det, int32_t ppm_q)
+{
+    if (!p->pending) {
+        return false;
+    }
+
+    int64_t diff = (int64_t)ppm_q - p->snapshot.baseline_q;
+    if (diff > RESTORE_TOL_Q && ++p->waited < DETECTOR_PERSIST_RESTORE_WAIT) {
+        return false;       /* Heater re-warm offset may still be decaying */
+    }
+    p->pending = false;
+    if (diff > RESTORE_TOL_Q || diff < -RESTORE_TOL_Q) {
+        ESP_LOGW(TAG, "Snapshot rejected: reading %d.%02d ppm vs saved baseline %d.%02d ppm — cold start",
+                 EVENT_PPM_Q_INT(ppm_q), EVENT_PPM_Q_HUND(ppm_q),
+                 EVENT_PPM_Q_INT(p->snapshot.baseline_q), EVENT_PPM_Q_HUND(p->snapshot.baseline_q));
+        return false;
+    }
+
+    event_detector_restore_baseline_q(det, p->snapshot.baseline_q, ppm_q);
+    p->saved   = true;
+    p->saved_q = p->snapshot.baseline_q;
+    return true;
+}
+
+void detector_persist_tick(detector_persist_t *p, const event_detector_t *det)
+{
+    if (!p->nvs_open || p->pending || !det->initialized || det->state != DETECTOR_IDLE) {
+        return;
+    }
+
+    int64_t now_us  = esp_timer_get_time();
+    int64_t since   = now_us - p->last_save_us;
+    int32_t base_q  = event_detector_get_baseline_q(det);
+    int64_t moved   = (int64_t)base_q - p->saved_q;
+    bool    changed = !p->saved || moved >= SAVE_DELTA_Q || moved <= -SAVE_DELTA_Q;
+
+    /* Significant change: rate-limited to one write per SAVE_MIN.
+     * Otherwise refresh every SAVE_MAX so drift below SAVE_DELTA lands too. */
+    if (!(changed && since >= SAVE_MIN_US) && since < SAVE_MAX_US) {
+        return;
+    }
+
+    detector_snapshot_t snap = {
+        .version    = DETECTOR_PERSIST_VERSION,
+        .baseline_q = base_q,
+    };
+    p->last_save_us = now_us;   /* Also on failure — don't retry every tick */
+
+    esp_err_t err = nvs_set_blob(p->nvs, p->key, &snap, sizeof(snap));
+    if (err == ESP_OK) {
+        err = nvs_commit(p->nvs);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Baseline snapshot write failed: %s", esp_err_to_name(err));
+        return;
+    }
+    p->saved   = true;
+    p->saved_q = base_q;
+    ESP_LOGD(TAG, "Baseline snapshot %s saved: %d.%02d ppm", p->key, EVENT_PPM_Q_INT(base_q), EVENT_PPM_Q_HUND(base_q));
+}
@@ -0,0 +1,113 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * detector_persist.h — Keep the learned NH₃ baseline across reboots
+ *
+ * A small snapshot (baseline in Q15.16 ppm) is kept in NVS. Writes are
+ * coalesced: at most one per MIN interval, and only when the baseline moved
+ * by SAVE_DELTA, plus a refresh every MAX interval. Only the IDLE baseline
+ * is kept, not the rest of the detector state: the baseline is frozen
+ * during events, and an event in progress at reboot is lost (the detector
+ * comes back IDLE).
+ *
+ * On boot the snapshot is loaded but not applied until the first settled
+ * (post-warmup) reading. It is applied only if a reading is within
+ * RESTORE_TOL of the saved baseline; otherwise the detector cold starts as
+ * before. A reading too high may still carry the heater's re-warm offset
+ * or the tail of an event that was under way at reboot, so up to
+ * DETECTOR_PERSIST_RESTORE_WAIT readings are tried (the detector stays
+ * held); one too low means the air is cleaner than the snapshot and
+ * rejects it at once. That plausibility check is the only staleness test:
+ * the device has no wall clock (nothing sets it), so the snapshot's age is
+ * unknown. RESTORE_TOL is half the trigger delta, so a snapshot the air
+ * has moved away from by an event's worth is never applied. Detection is
+ * then valid right after heater warmup, instead of after warmup plus the
+ * EMA's re-convergence.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "nvs.h"
+#include "event_detector.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Defaults for builds without sdkconfig (host); see Kconfig.projbuild */
+#ifndef CONFIG_LITTERBOX_BASELINE_SAVE_DELTA_DPPM
+#define CONFIG_LITTERBOX_BASELINE_SAVE_DELTA_DPPM   2       /* 0.2 ppm */
+#endif
+#ifndef CONFIG_LITTERBOX_BASELINE_SAVE_MIN_S
+#define CONFIG_LITTERBOX_BASELINE_SAVE_MIN_S        30
+#endif
+#ifndef CONFIG_LITTERBOX_BASELINE_SAVE_MAX_MIN
+#define CONFIG_LITTERBOX_BASELINE_SAVE_MAX_MIN      30
+#endif
+#ifndef CONFIG_LITTERBOX_BASELINE_RESTORE_TOL_DPPM
+#define CONFIG_LITTERBOX_BASELINE_RESTORE_TOL_DPPM  50      /* 5 ppm */
+#endif
+
+#define DETECTOR_PERSIST_NAMESPACE  "litterbox"
+#define DETECTOR_PERSIST_KEY        "det_snap"  /* Default key (sensor channel 0) */
+#define DETECTOR_PERSIST_RESTORE_WAIT   60  /* Settled readings (2 min) a restore may wait for agreement */
+#define DETECTOR_PERSIST_VERSION    2   /* v1 also carried an (always unset) save time */
+
+typedef struct {
+    uint8_t  version;           /* DETECTOR_PERSIST_VERSION */
+    uint8_t  reserved[3];
+    int32_t  baseline_q;        /* Q15.16 ppm */
+} detector_snapshot_t;
+
+/* One per detector; treat as opaque */
+typedef struct {
+    nvs_handle_t        nvs;
+    bool                nvs_open;
+    bool                pending;
+    uint8_t             waited;         /* Readings tried while pending */
+    bool                saved;          /* A snapshot from this boot is in NVS */
+    int32_t             saved_q;
+    int64_t             last_save_us;
+    detector_snapshot_t snapshot;
+    char                key[NVS_KEY_NAME_MAX_SIZE];
+} detector_persist_t;
+
+/**
+ * @brief Open the NVS namespace and load the last snapshot, if any.
+ *        Call after nvs_flash_init(), before the first sample.
+ * @param key  NVS key of this detector's snapshot (DETECTOR_PERSIST_KEY for a single sensor)
+ * @return ESP_OK (with or without a snapshot), or the nvs_open() error
+ */
+esp_err_t detector_persist_init(detector_persist_t *p, const char *key);
+
+/**
+ * @brief True while a loaded snapshot waits for a settled reading that
+ *        agrees with it. The caller should not feed the detector during that time.
+ */
+bool detector_persist_pending(const detector_persist_t *p);
+
+/**
+ * @brief Apply the pending snapshot if ppm_q agrees with it. Consumes it,
+ *        unless ppm_q is too high and fewer than DETECTOR_PERSIST_RESTORE_WAIT
+ *        readings were tried (still pending: hold the detector and call again).
+ *
+ * @param det    Detector set up by event_detector_init*()
+ * @param ppm_q  Post-warmup reading, Q15.16 ppm
+ * @return true if the baseline was restored; false if det should cold start,
+ *         or wait while detector_persist_pending()
+ */
+bool detector_persist_restore(detector_persist_t *p, event_detector_t *det, int32_t ppm_q);
+
+/**
+ * @brief Call once per tick after event_detector_update*(); writes a new
+ *        snapshot when the coalescing rules allow it.
+ */
+void detector_persist_tick(detector_persist_t *p, const event_detector_t *det);
+
+#ifdef __cplusplus
+}
+#endif
@@ -7,24 +7,179 @@
  */
 #include "event_detector.h"
 #include "esp_log.h"
+#include <math.h>
 #include <string.h>
 
 static const char *TAG = "DETECTOR";
 
+/* Per-tick debug lines; with CONFIG_LITTERBOX_BINARY_TRACE the trace frame carries the same data */
+#if CONFIG_LITTERBOX_BINARY_TRACE
+#define TICK_LOGD(...)  do { } while (0)
+#else
+#define TICK_LOGD(...)  ESP_LOGD(TAG, __VA_ARGS__)
+#endif
+
+static const event_detector_config_t s_default_config = EVENT_DETECTOR_CONFIG_DEFAULT();
+
 void event_detector_init(event_detector_t *ctx)
+{
+    event_detector_init_with_config(ctx, &s_default_config);
+}
+
+void event_detector_init_with_config(event_detector_t *ctx, const event_detector_config_t *cfg)
 {
     memset(ctx, 0, sizeof(*ctx));
+    ctx->cfg = cfg;
     ctx->state = DETECTOR_IDLE;
     ctx->current_event = LITTER_EVENT_NONE;
     ctx->initialized = false;
 }
 
+/* Start-up baseline: running mean (gain 1/n) until 1/n reaches alpha.
+ * Readings far outside the spread seen so far get only the alpha weight. */
+static void baseline_average(event_detector_t *ctx, const event_detector_config_t *cfg, float ppm)
+{
+    float d    = ppm - ctx->baseline_ppm;
+    float gain = 1.0f / (float)(ctx->baseline_n + 1);
+
+    if (ctx->baseline_n >= BASELINE_OUTLIER_MIN_N
+        && d * d > 9.0f * ctx->baseline_dev2 && fabsf(d) > cfg->hysteresis_ppm) {
+        gain = cfg->baseline_alpha;
+    } else {
+        ctx->baseline_dev2 += (d * d - ctx->baseline_dev2) / (float)ctx->baseline_n;
+    }
+    ctx->baseline_ppm += gain * d;
+
+    ctx->baseline_n++;
+    if (1.0f / (float)(ctx->baseline_n + 1) <= cfg->baseline_alpha) {
+        ctx->baseline_n = EVENT_BASELINE_STEADY;
+        ESP_LOGI(TAG, "Baseline converged: %.2f ppm", ctx->baseline_ppm);
+    }
+}
+
+/* Confidence (%) in a provisional type, integer-only so both back-ends agree:
+ * half from how far the peak sits from the thresholds that decided it, half
+ * from the decay since the peak. For a fall well short of the rise, an
+ * exponential with τ = EVENT_DECAY_TAU_TICKS drops by delta × since / τ, so
+ * the observed rate relative to that is fall × τ / (delta × since); faster
+ * speaks for urination. */
+static uint8_t provisional_confidence(litter_event_t type, bool fast_peak, int32_t delta_q, int32_t fall_q,
+                                      uint16_t since_peak, int32_t urine_delta_q)
+{
+    int32_t margin;
+    if (type == LITTER_EVENT_URINATION) {
+        margin = fast_peak ? 100 : (int32_t)((int64_t)(delta_q - urine_delta_q) * 200 / urine_delta_q);
+    } else {
+        margin = (int32_t)((int64_t)(urine_delta_q - delta_q) * 200 / urine_delta_q);
+    }
+    margin = margin < 0 ? 0 : margin > 100 ? 100 : margin;
+
+    int64_t expected = (int64_t)delta_q * since_peak;
+    int32_t agree = expected > 0
+                  ? (int32_t)(((int64_t)fall_q * EVENT_DECAY_TAU_TICKS - expected) * 100 / expected) : 0;
+    agree = agree < -100 ? -100 : agree > 100 ? 100 : agree;
+    if (type == LITTER_EVENT_DEFECATION) {
+        agree = -agree;
+    }
+    return (uint8_t)(50 + margin / 4 + agree / 4);
+}
+
+/* ── Event features ─────────────────────────────────────────────────────
+ * Integer-only and fed the same Q15.16 excess by both back-ends. */
+
+#define EVENT_DECAY_FIT_MIN       ((int32_t)(EVENT_DECAY_FIT_MIN_PPM * (1 << EVENT_DECAY_FIT_SHIFT)))
+
+/* Q15.16 → fit resolution */
+static int32_t fit_units(int32_t q)
+{
+    return q >> (EVENT_PPM_Q_SHIFT - EVENT_DECAY_FIT_SHIFT);
+}
+
+/* Onset tick: excess = ppm − baseline, rise = ppm − previous reading */
+static void features_start(event_feature_acc_t *a, int32_t excess_q, int32_t rise_q)
+{
+    *a = (event_feature_acc_t) {
+        .auc_q       = excess_q > 0 ? excess_q : 0,
+        .peak_excess = fit_units(excess_q),
+        .last_excess = fit_units(excess_q),
+        .max_rise_q  = rise_q,
+    };
+}
+
+static void features_tick(event_feature_acc_t *a, int32_t excess_q, int32_t rise_q, bool new_peak)
+{
+    int32_t x = fit_units(excess_q);
+    a->auc_q += excess_q > 0 ? excess_q : 0;
+    if (rise_q > a->max_rise_q) {
+        a->max_rise_q = rise_q;
+    }
+    if (new_peak) {
+        a->peak_excess  = x;
+        a->decay_sum    = 0;
+        a->decay_sum_sq = 0;
+        a->decay_n      = 0;
+    } else if (a->decay_n < UINT16_MAX) {
+        int64_t y = (int64_t)a->last_excess + x;
+        a->decay_sum    += y;
+        a->decay_sum_sq += y * y;
+        a->decay_n++;
+    }
+    a->last_excess = x;
+}
+
+static uint32_t sat_u32(int64_t v)
+{
+    return v < 0 ? 0 : v > UINT32_MAX ? UINT32_MAX : (uint32_t)v;
+}
+
+static uint16_t sat_u16(int64_t v)
+{
+    return v < 0 ? 0 : v > UINT16_MAX ? UINT16_MAX : (uint16_t)v;
+}
+
+/* Least-squares slope of Δx against the tick midpoint y/2 since the peak,
+ * τ = −1/slope; Σ(y/2)·Δx = (x_T² − x_0²)/2. 0 if too little fall to fit. */
+static uint16_t decay_tau(const event_feature_acc_t *a)
+{
+    int64_t n  = a->decay_n;
+    int64_t x0 = a->peak_excess, xt = a->last_excess;
+    if (n < 2 || x0 - xt < EVENT_DECAY_FIT_MIN) {
+        return 0;
+    }
+    int64_t sxx = n * a->decay_sum_sq - a->decay_sum * a->decay_sum;
+    int64_t sxd = 2 * n * (xt * xt - x0 * x0) - 2 * a->decay_sum * (xt - x0);
+    return sxd < 0 ? sat_u16(sxx / -sxd) : 0;
+}
+
+/* ACTIVE → COOLDOWN: running sums → features */
+static void features_finish(event_detector_t *ctx)
+{
+    const event_feature_acc_t *a = &ctx->feature_acc;
+    ctx->features = (event_features_t) {
+        .auc_dppm_ticks     = sat_u32((a->auc_q * 10) >> EVENT_PPM_Q_SHIFT),
+        .max_rise_cppm      = sat_u16(((int64_t)a->max_rise_q * 100) >> EVENT_PPM_Q_SHIFT),
+        .time_to_peak_ticks = (uint16_t)(ctx->peak_ticks - 1),
+        .decay_tau_ticks    = decay_tau(a),
+        .duration_ticks     = ctx->event_ticks,
+    };
+    const event_features_t *f = &ctx->features;
+    ESP_LOGI(TAG, "Event features: area=%lu.%lu ppm·ticks  max rise=%u.%02u ppm/tick  peak after %u ticks  "
+             "tau=%u ticks  duration=%u ticks",
+             (unsigned long)(f->auc_dppm_ticks / 10), (unsigned long)(f->auc_dppm_ticks % 10),
+             f->max_rise_cppm / 100, f->max_rise_cppm % 100, f->time_to_peak_ticks, f->decay_tau_ticks,
+             f->duration_ticks);
+}
+
 litter_event_t event_detector_update(event_detector_t *ctx, float ppm)
 {
+    const event_detector_config_t *cfg = ctx->cfg;
+
     /* First reading: initialise baseline, don't trigger */
     if (!ctx->initialized) {
         ctx->baseline_ppm = ppm;
+        ctx->baseline_n   = cfg->adaptive_baseline ? 1 : EVENT_BASELINE_STEADY;
         ctx->initialized = true;
+        ctx->prev_ppm    = ppm;
         ESP_LOGI(TAG, "Baseline initialised: %.1f ppm", ctx->baseline_ppm);
         return LITTER_EVENT_NONE;
     }
@@ -32,55 +187,118 @@ litter_event_t event_detector_update(event_detector_t *ctx, float ppm)
     switch (ctx->state) {
 
     /* ── IDLE ─────────────────────────────────────────────────────────────── */
-    case DETECTOR_IDLE:
-        /* Update baseline via EMA (only in IDLE — don't drift baseline during event) */
-        ctx->baseline_ppm = (1.0f - BASELINE_ALPHA) * ctx->baseline_ppm
-                          + BASELINE_ALPHA * ppm;
+    case DETECTOR_IDLE: {
+        /* Residual against the EMA before this reading moves it */
+        float residual = ppm - ctx->baseline_ppm;
 
-        ESP_LOGD(TAG, "state=IDLE  baseline=%.1f ppm  current=%.1f ppm",
-                 ctx->baseline_ppm, ppm);
+        /* Update baseline (only in IDLE — don't drift baseline during event) */
+        if (ctx->baseline_n != EVENT_BASELINE_STEADY && ctx->settling) {
+            ctx->baseline_ppm += (residual < 0.0f ? EVENT_SETTLE_GAIN : cfg->baseline_alpha) * residual;
+        } else if (ctx->baseline_n != EVENT_BASELINE_STEADY) {
+            baseline_average(ctx, cfg, ppm);
+        } else {
+            ctx->baseline_ppm = (1.0f - cfg->baseline_alpha) * ctx->baseline_ppm
+                              + cfg->baseline_alpha * ppm;
+        }
+
+        TICK_LOGD("state=IDLE  baseline=%.1f ppm  current=%.1f ppm",
+                  ctx->baseline_ppm, ppm);
+
+        bool crossed = ppm > ctx->baseline_ppm + cfg->trigger_delta_ppm;
+        bool onset   = crossed;
+        if (cfg->engine == EVENT_ENGINE_CUSUM && ctx->baseline_n == EVENT_BASELINE_STEADY) {
+            /* Armed once the residual is back inside the drift allowance, so
+             * the tail of the last event does not count as a new rise */
+            ctx->cusum_armed |= residual < cfg->cusum_drift_ppm;
+            if (ctx->cusum_armed) {
+                ctx->cusum = fmaxf(0.0f, ctx->cusum + residual - cfg->cusum_drift_ppm);
+                onset |= ctx->cusum > cfg->cusum_limit_ppm;
+            }
+        }
 
-        if (ppm > ctx->baseline_ppm + EVENT_TRIGGER_DELTA_PPM) {
+        if (onset) {
             ctx->state            = DETECTOR_ACTIVE;
             ctx->peak_ppm         = ppm;
             ctx->event_ticks      = 1;
             ctx->peak_ticks       = 1;
+            ctx->onset_ticks      = crossed ? 1 : 0;
             ctx->below_thresh_count = 0;
-            ESP_LOGI(TAG, "Event START: ppm=%.1f  baseline=%.1f  delta=%.1f",
-                     ppm, ctx->baseline_ppm, ppm - ctx->baseline_ppm);
+            ctx->provisional_peak_ticks = 0;
+            features_start(&ctx->feature_acc, EVENT_PPM_TO_Q(ppm - ctx->baseline_ppm),
+                           EVENT_PPM_TO_Q(ppm - ctx->prev_ppm));
+            ESP_LOGI(TAG, "Event START: ppm=%.1f  baseline=%.1f  delta=%.1f  cusum=%.1f",
+                     ppm, ctx->baseline_ppm, ppm - ctx->baseline_ppm, ctx->cusum);
+            ctx->cusum       = 0.0f;
+            ctx->cusum_armed = false;
         }
         break;
+    }
 
     /* ── ACTIVE ───────────────────────────────────────────────────────────── */
     case DETECTOR_ACTIVE:
         ctx->event_ticks++;
 
         /* Track peak */
-        if (ppm > ctx->peak_ppm) {
+        bool new_peak = ppm > ctx->peak_ppm;
+        if (new_peak) {
             ctx->peak_ppm   = ppm;
             ctx->peak_ticks = ctx->event_ticks;
         }
+        features_tick(&ctx->feature_acc, EVENT_PPM_TO_Q(ppm - ctx->baseline_ppm),
+                      EVENT_PPM_TO_Q(ppm - ctx->prev_ppm), new_peak);
+
+        if (ctx->onset_ticks == 0 && ppm > ctx->baseline_ppm + cfg->trigger_delta_ppm) {
+            ctx->onset_ticks = ctx->event_ticks;
+        }
 
-        /* Hysteresis: count consecutive ticks near baseline */
-        if (ppm < ctx->baseline_ppm + EVENT_HYSTERESIS_PPM) {
+        /* Hysteresis: count consecutive ticks near baseline, once the event
+         * has risen clear of it (always, for a threshold trigger) */
+        bool risen = ctx->onset_ticks || ctx->peak_ppm >= ctx->baseline_ppm + cfg->hysteresis_ppm;
+        if (risen && ppm < ctx->baseline_ppm + cfg->hysteresis_ppm) {
             ctx->below_thresh_count++;
         } else {
             ctx->below_thresh_count = 0;
         }
 
-        ESP_LOGD(TAG, "state=ACTIVE  tick=%u  ppm=%.1f  peak=%.1f@tick%u  below=%u",
-                 ctx->event_ticks, ppm, ctx->peak_ppm,
-                 ctx->peak_ticks, ctx->below_thresh_count);
+        TICK_LOGD("state=ACTIVE  tick=%u  ppm=%.1f  peak=%.1f@tick%u  below=%u",
+                  ctx->event_ticks, ppm, ctx->peak_ppm,
+                  ctx->peak_ticks, ctx->below_thresh_count);
 
-        /* End condition: stayed near baseline for EVENT_END_TICKS consecutive ticks */
-        if (ctx->below_thresh_count >= EVENT_END_TICKS) {
-            /* Classify: fast peak (≤ URINE_FAST_PEAK_TICKS) or high delta → URINATION */
-            bool fast_peak = (ctx->peak_ticks <= URINE_FAST_PEAK_TICKS);
-            bool high_peak = ((ctx->peak_ppm - ctx->baseline_ppm) > 30.0f);
+        /* CUSUM onset that never became an event: withdraw it */
+        if (!risen && ctx->event_ticks >= cfg->onset_confirm_ticks) {
+            ctx->state = DETECTOR_IDLE;
+            ctx->provisional_event = LITTER_EVENT_NONE;
+            ESP_LOGI(TAG, "Onset withdrawn: peak=%.1f ppm within %u ticks", ctx->peak_ppm, ctx->event_ticks);
+            break;
+        }
+
+        /* Classify: fast peak (≤ urine_fast_peak_ticks after the threshold
+         * crossing) or high delta → URINATION */
+        uint16_t rise_ticks = ctx->peak_ticks - (ctx->onset_ticks ? ctx->onset_ticks - 1 : 0);
+        bool fast_peak = (rise_ticks <= cfg->urine_fast_peak_ticks);
+        bool high_peak = ((ctx->peak_ppm - ctx->baseline_ppm) > cfg->urine_peak_delta_ppm);
+        litter_event_t type = (fast_peak || high_peak) ? LITTER_EVENT_URINATION : LITTER_EVENT_DEFECATION;
 
-            ctx->current_event = (fast_peak || high_peak)
-                                ? LITTER_EVENT_URINATION
-                                : LITTER_EVENT_DEFECATION;
+        /* Provisional type as soon as the peak is established */
+        float    delta = ctx->peak_ppm - ctx->baseline_ppm;
+        float    fall  = ctx->peak_ppm - ppm;
+        uint16_t since = ctx->event_ticks - ctx->peak_ticks;
+        if (risen && ctx->provisional_peak_ticks != ctx->peak_ticks && since >= EVENT_PROVISIONAL_MIN_TICKS
+            && fall >= EVENT_PROVISIONAL_DROP_PPM && fall >= delta / 8.0f) {
+            ctx->provisional_peak_ticks = ctx->peak_ticks;
+            ctx->provisional_event      = type;
+            ctx->provisional_confidence = provisional_confidence(type, fast_peak, EVENT_PPM_TO_Q(delta),
+                                                                 EVENT_PPM_TO_Q(fall), since,
+                                                                 EVENT_PPM_TO_Q(cfg->urine_peak_delta_ppm));
+            ESP_LOGI(TAG, "Event PROVISIONAL → %s (%u%%)  peak=%.1fppm @ tick%u, %.1f ppm down after %u ticks",
+                     type == LITTER_EVENT_URINATION ? "URINATION" : "DEFECATION", ctx->provisional_confidence,
+                     ctx->peak_ppm, ctx->peak_ticks, fall, since);
+        }
+
+        /* End condition: stayed near baseline for end_ticks consecutive ticks */
+        if (ctx->below_thresh_count >= cfg->end_ticks) {
+            ctx->current_event     = type;
+            ctx->provisional_event = LITTER_EVENT_NONE;
 
             ctx->state         = DETECTOR_COOLDOWN;
             ctx->cooldown_ticks = 0;
@@ -89,6 +307,7 @@ litter_event_t event_detector_update(event_detector_t *ctx, float ppm)
                      ctx->current_event == LITTER_EVENT_URINATION ? "URINATION" : "DEFECATION",
                      ctx->peak_ppm, ctx->peak_ticks,
                      ctx->baseline_ppm, ctx->peak_ppm - ctx->baseline_ppm);
+            features_finish(ctx);
         }
         break;
 
@@ -96,8 +315,183 @@ litter_event_t event_detector_update(event_detector_t *ctx, float ppm)
     case DETECTOR_COOLDOWN:
         ctx->cooldown_ticks++;
 
-        ESP_LOGD(TAG, "state=COOLDOWN  %u/%u ticks", ctx->cooldown_ticks, EVENT_COOLDOWN_TICKS);
+        TICK_LOGD("state=COOLDOWN  %u/%u ticks", ctx->cooldown_ticks, cfg->cooldown_ticks);
+
+        if (ctx->cooldown_ticks >= cfg->cooldown_ticks) {
+            ctx->state         = DETECTOR_IDLE;
+            ctx->current_event = LITTER_EVENT_NONE;
+            ESP_LOGI(TAG, "Cooldown complete — returning to IDLE");
+        }
+        break;
+    }
+
+    ctx->prev_ppm = ppm;
+    return ctx->current_event;
+}
+
+/* ── Fixed-point back-end ─────────────────────────────────────────────────
+ * Mirrors event_detector_update() transition for transition. Baseline and
+ * peak are Q15.16 ppm; the EMA product needs 64 bits (ppm ≤ 1000 → 2^26,
+ * × alpha 2^12), which RV32IMC does with mul/mulh — no soft-float calls.
+ * Logs print ppm as integer + hundredths so formatting stays integer too.
+ */
+
+#define EVENT_TRIGGER_DELTA_Q   EVENT_PPM_TO_Q(EVENT_TRIGGER_DELTA_PPM)
+#define EVENT_HYSTERESIS_Q      EVENT_PPM_TO_Q(EVENT_HYSTERESIS_PPM)
+#define URINE_PEAK_DELTA_Q      EVENT_PPM_TO_Q(URINE_PEAK_DELTA_PPM)
+#define EVENT_CUSUM_DRIFT_Q     EVENT_PPM_TO_Q(EVENT_CUSUM_DRIFT_PPM)
+#define EVENT_CUSUM_LIMIT_Q     EVENT_PPM_TO_Q(EVENT_CUSUM_LIMIT_PPM)
+#define EVENT_PROVISIONAL_DROP_Q EVENT_PPM_TO_Q(EVENT_PROVISIONAL_DROP_PPM)
 
+/* baseline_average() in Q15.16; squared deviations are Q31.32 in 64 bits.
+ * The divisions run only for the first ~20 ticks after start-up. */
+static void baseline_average_q(event_detector_t *ctx, int32_t ppm_q)
+{
+    int32_t d      = ppm_q - ctx->baseline_q;
+    int64_t d2     = (int64_t)d * d;
+    int32_t gain_q = (1 << EVENT_PPM_Q_SHIFT) / (ctx->baseline_n + 1);
+
+    if (ctx->baseline_n >= BASELINE_OUTLIER_MIN_N
+        && d2 > 9 * ctx->baseline_dev2_q && (d > EVENT_HYSTERESIS_Q || d < -EVENT_HYSTERESIS_Q)) {
+        gain_q = BASELINE_ALPHA_Q;
+    } else {
+        ctx->baseline_dev2_q += (d2 - ctx->baseline_dev2_q) / ctx->baseline_n;
+    }
+    ctx->baseline_q += (int32_t)(((int64_t)d * gain_q + (1 << (EVENT_PPM_Q_SHIFT - 1))) >> EVENT_PPM_Q_SHIFT);
+
+    ctx->baseline_n++;
+    if ((1 << EVENT_PPM_Q_SHIFT) / (ctx->baseline_n + 1) <= BASELINE_ALPHA_Q) {
+        ctx->baseline_n = EVENT_BASELINE_STEADY;
+        ESP_LOGI(TAG, "Baseline converged: %d.%02d ppm",
+                 EVENT_PPM_Q_INT(ctx->baseline_q), EVENT_PPM_Q_HUND(ctx->baseline_q));
+    }
+}
+
+litter_event_t event_detector_update_q(event_detector_t *ctx, int32_t ppm_q)
+{
+    if (!ctx->initialized) {
+        ctx->baseline_q  = ppm_q;
+        ctx->baseline_n  = ctx->cfg->adaptive_baseline ? 1 : EVENT_BASELINE_STEADY;
+        ctx->initialized = true;
+        ctx->prev_q      = ppm_q;
+        ESP_LOGI(TAG, "Baseline initialised: %d.%02d ppm", EVENT_PPM_Q_INT(ppm_q), EVENT_PPM_Q_HUND(ppm_q));
+        return LITTER_EVENT_NONE;
+    }
+
+    switch (ctx->state) {
+
+    case DETECTOR_IDLE: {
+        int32_t residual_q = ppm_q - ctx->baseline_q;
+
+        /* baseline += alpha × (ppm − baseline), rounded to nearest */
+        if (ctx->baseline_n != EVENT_BASELINE_STEADY && ctx->settling) {
+            int32_t gain_q = residual_q < 0 ? EVENT_SETTLE_GAIN_Q : BASELINE_ALPHA_Q;
+            ctx->baseline_q += (int32_t)(((int64_t)residual_q * gain_q
+                                          + (1 << (EVENT_PPM_Q_SHIFT - 1))) >> EVENT_PPM_Q_SHIFT);
+        } else if (ctx->baseline_n != EVENT_BASELINE_STEADY) {
+            baseline_average_q(ctx, ppm_q);
+        } else {
+            ctx->baseline_q += (int32_t)(((int64_t)(ppm_q - ctx->baseline_q) * BASELINE_ALPHA_Q
+                                          + (1 << (EVENT_PPM_Q_SHIFT - 1))) >> EVENT_PPM_Q_SHIFT);
+        }
+
+        bool crossed = ppm_q > ctx->baseline_q + EVENT_TRIGGER_DELTA_Q;
+        bool onset   = crossed;
+        if (ctx->cfg->engine == EVENT_ENGINE_CUSUM && ctx->baseline_n == EVENT_BASELINE_STEADY) {
+            ctx->cusum_armed |= residual_q < EVENT_CUSUM_DRIFT_Q;
+            if (ctx->cusum_armed) {
+                /* Limit + one tick's worst residual stays far inside int32 */
+                int32_t s = ctx->cusum_q + residual_q - EVENT_CUSUM_DRIFT_Q;
+                ctx->cusum_q = s > 0 ? s : 0;
+                onset |= ctx->cusum_q > EVENT_CUSUM_LIMIT_Q;
+            }
+        }
+
+        if (onset) {
+            ctx->state            = DETECTOR_ACTIVE;
+            ctx->peak_q           = ppm_q;
+            ctx->event_ticks      = 1;
+            ctx->peak_ticks       = 1;
+            ctx->onset_ticks      = crossed ? 1 : 0;
+            ctx->below_thresh_count = 0;
+            ctx->provisional_peak_ticks = 0;
+            features_start(&ctx->feature_acc, ppm_q - ctx->baseline_q, ppm_q - ctx->prev_q);
+            ESP_LOGI(TAG, "Event START: ppm=%d.%02d  baseline=%d.%02d  cusum=%d.%02d",
+                     EVENT_PPM_Q_INT(ppm_q), EVENT_PPM_Q_HUND(ppm_q),
+                     EVENT_PPM_Q_INT(ctx->baseline_q), EVENT_PPM_Q_HUND(ctx->baseline_q),
+                     EVENT_PPM_Q_INT(ctx->cusum_q), EVENT_PPM_Q_HUND(ctx->cusum_q));
+            ctx->cusum_q     = 0;
+            ctx->cusum_armed = false;
+        }
+        break;
+    }
+
+    case DETECTOR_ACTIVE:
+        ctx->event_ticks++;
+
+        bool new_peak = ppm_q > ctx->peak_q;
+        if (new_peak) {
+            ctx->peak_q     = ppm_q;
+            ctx->peak_ticks = ctx->event_ticks;
+        }
+        features_tick(&ctx->feature_acc, ppm_q - ctx->baseline_q, ppm_q - ctx->prev_q, new_peak);
+
+        if (ctx->onset_ticks == 0 && ppm_q > ctx->baseline_q + EVENT_TRIGGER_DELTA_Q) {
+            ctx->onset_ticks = ctx->event_ticks;
+        }
+
+        bool risen = ctx->onset_ticks || ctx->peak_q >= ctx->baseline_q + EVENT_HYSTERESIS_Q;
+        if (risen && ppm_q < ctx->baseline_q + EVENT_HYSTERESIS_Q) {
+            ctx->below_thresh_count++;
+        } else {
+            ctx->below_thresh_count = 0;
+        }
+
+        if (!risen && ctx->event_ticks >= EVENT_ONSET_CONFIRM_TICKS) {
+            ctx->state = DETECTOR_IDLE;
+            ctx->provisional_event = LITTER_EVENT_NONE;
+            ESP_LOGI(TAG, "Onset withdrawn: peak=%d.%02d ppm within %u ticks",
+                     EVENT_PPM_Q_INT(ctx->peak_q), EVENT_PPM_Q_HUND(ctx->peak_q), ctx->event_ticks);
+            break;
+        }
+
+        uint16_t rise_ticks = ctx->peak_ticks - (ctx->onset_ticks ? ctx->onset_ticks - 1 : 0);
+        bool fast_peak = (rise_ticks <= URINE_FAST_PEAK_TICKS);
+        bool high_peak = ((ctx->peak_q - ctx->baseline_q) > URINE_PEAK_DELTA_Q);
+        litter_event_t type = (fast_peak || high_peak) ? LITTER_EVENT_URINATION : LITTER_EVENT_DEFECATION;
+
+        int32_t  delta_q = ctx->peak_q - ctx->baseline_q;
+        int32_t  fall_q  = ctx->peak_q - ppm_q;
+        uint16_t since   = ctx->event_ticks - ctx->peak_ticks;
+        if (risen && ctx->provisional_peak_ticks != ctx->peak_ticks && since >= EVENT_PROVISIONAL_MIN_TICKS
+            && fall_q >= EVENT_PROVISIONAL_DROP_Q && fall_q >= delta_q / 8) {
+            ctx->provisional_peak_ticks = ctx->peak_ticks;
+            ctx->provisional_event      = type;
+            ctx->provisional_confidence = provisional_confidence(type, fast_peak, delta_q, fall_q, since,
+                                                                 URINE_PEAK_DELTA_Q);
+            ESP_LOGI(TAG, "Event PROVISIONAL → %s (%u%%)  peak=%d.%02dppm @ tick%u, down %d.%02d ppm after %u ticks",
+                     type == LITTER_EVENT_URINATION ? "URINATION" : "DEFECATION", ctx->provisional_confidence,
+                     EVENT_PPM_Q_INT(ctx->peak_q), EVENT_PPM_Q_HUND(ctx->peak_q), ctx->peak_ticks,
+                     EVENT_PPM_Q_INT(fall_q), EVENT_PPM_Q_HUND(fall_q), since);
+        }
+
+        if (ctx->below_thresh_count >= EVENT_END_TICKS) {
+            ctx->current_event     = type;
+            ctx->provisional_event = LITTER_EVENT_NONE;
+
+            ctx->state         = DETECTOR_COOLDOWN;
+            ctx->cooldown_ticks = 0;
+
+            ESP_LOGI(TAG, "Event END → %s  (peak=%d.%02dppm @ tick%u, baseline=%d.%02dppm)",
+                     ctx->current_event == LITTER_EVENT_URINATION ? "URINATION" : "DEFECATION",
+                     EVENT_PPM_Q_INT(ctx->peak_q), EVENT_PPM_Q_HUND(ctx->peak_q), ctx->peak_ticks,
+                     EVENT_PPM_Q_INT(ctx->baseline_q), EVENT_PPM_Q_HUND(ctx->baseline_q));
+            features_finish(ctx);
+        }
+        break;
+
+    case DETECTOR_COOLDOWN:
+        ctx->cooldown_ticks++;
         if (ctx->cooldown_ticks >= EVENT_COOLDOWN_TICKS) {
             ctx->state         = DETECTOR_IDLE;
             ctx->current_event = LITTER_EVENT_NONE;
@@ -106,10 +500,52 @@ litter_event_t event_detector_update(event_detector_t *ctx, float ppm)
         break;
     }
 
+    ctx->prev_q = ppm_q;
     return ctx->current_event;
 }
 
+void event_detector_set_settling(event_detector_t *ctx, bool settling)
+{
+    ctx->settling = settling;
+}
+
+void event_detector_restore_baseline_q(event_detector_t *ctx, int32_t baseline_q, int32_t ppm_q)
+{
+    event_detector_init_with_config(ctx, ctx->cfg);
+    ctx->baseline_q  = baseline_q;
+    ctx->prev_q      = ppm_q;
+#if !CONFIG_LITTERBOX_FIXED_POINT
+    ctx->baseline_ppm = (float)baseline_q / (1 << EVENT_PPM_Q_SHIFT);
+    ctx->prev_ppm     = (float)ppm_q / (1 << EVENT_PPM_Q_SHIFT);
+#endif
+    ctx->baseline_n  = EVENT_BASELINE_STEADY;
+    ctx->initialized = true;
+    ESP_LOGI(TAG, "Baseline restored: %d.%02d ppm", EVENT_PPM_Q_INT(baseline_q), EVENT_PPM_Q_HUND(baseline_q));
+}
+
 float event_detector_get_baseline(const event_detector_t *ctx)
 {
+#if CONFIG_LITTERBOX_FIXED_POINT
+    return (float)ctx->baseline_q / (1 << EVENT_PPM_Q_SHIFT);
+#else
     return ctx->baseline_ppm;
+#endif
+}
+
+int32_t event_detector_get_baseline_q(const event_detector_t *ctx)
+{
+#if CONFIG_LITTERBOX_FIXED_POINT
+    return ctx->baseline_q;
+#else
+    return EVENT_PPM_TO_Q(ctx->baseline_ppm);
+#endif
+}
+
+int32_t event_detector_get_peak_q(const event_detector_t *ctx)
+{
+#if CONFIG_LITTERBOX_FIXED_POINT
+    return ctx->peak_q;
+#else
+    return EVENT_PPM_TO_Q(ctx->peak_ppm);
+#endif
 }
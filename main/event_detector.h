@@ -6,15 +6,69 @@
  * event_detector.h — 3-state NH₃ event detector for LitterBox.v1
  *
  * State machine: IDLE → ACTIVE → COOLDOWN → IDLE
- *  - IDLE:     tracking baseline via EMA; transitions to ACTIVE on ppm spike
+ *  - IDLE:     tracking baseline; transitions to ACTIVE on ppm spike
  *  - ACTIVE:   tracking peak and duration; transitions to COOLDOWN when ppm
  *              drops back to baseline for EVENT_END_TICKS consecutive ticks
  *  - COOLDOWN: holds classified event type for EVENT_COOLDOWN_TICKS ticks,
  *              then returns to IDLE
  *
+ * Baseline: the first BASELINE_ALPHA⁻¹ readings are averaged with gain 1/n
+ * (a running mean rather than an EMA seeded from a single reading), after
+ * which it continues as an EMA with BASELINE_ALPHA. While averaging,
+ * a reading more than 3σ (of the readings so far) and EVENT_HYSTERESIS_PPM
+ * away only gets the steady-state weight, so an early onset cannot drag
+ * the baseline up. While the sensor reports its heater overshoot still
+ * decaying (event_detector_set_settling()), the average holds: readings
+ * below the baseline pull it down with EVENT_SETTLE_GAIN, so it follows the
+ * decay, and readings above it get only the steady-state weight.
+ *
  * Event classification (at ACTIVE→COOLDOWN transition):
  *  peak_ticks ≤ URINE_FAST_PEAK_TICKS  OR  peak_delta > 30 ppm  → URINATION
  *  otherwise                                                       → DEFECATION
+ *
+ * Onset engines (event_detector_config_t.engine; event_detector_init() takes
+ * CONFIG_LITTERBOX_DETECTOR_CUSUM):
+ *  - EVENT_ENGINE_THRESHOLD: IDLE → ACTIVE once ppm > baseline + TRIGGER_DELTA.
+ *  - EVENT_ENGINE_CUSUM:     also IDLE → ACTIVE once the one-sided CUSUM of
+ *    the EMA residual, S = max(0, S + (ppm − baseline) − CUSUM_DRIFT),
+ *    exceeds CUSUM_LIMIT (ppm·ticks), after start-up averaging. A sustained
+ *    rise of a few ppm fires within tens of seconds; noise below the drift
+ *    allowance never accumulates. An onset that has not risen
+ *    HYSTERESIS_PPM above baseline within ONSET_CONFIRM_TICKS is withdrawn
+ *    (ACTIVE → IDLE, no event). The fast-peak test counts from the tick the
+ *    threshold would have fired on, so both engines classify alike.
+ *
+ * Provisional classification (while ACTIVE): once the peak is established —
+ * EVENT_PROVISIONAL_MIN_TICKS without a new peak and a fall of at least an
+ * eighth of the rise (EVENT_PROVISIONAL_DROP_PPM minimum) — the rule above
+ * is applied early and provisional_event / provisional_confidence are set.
+ * Confidence (0–100 %) grows with the distance of the peak features from
+ * the rule's thresholds and with how well the decay since the peak agrees
+ * with the type (urination falls off faster than EVENT_DECAY_TAU_TICKS).
+ * A higher peak later re-evaluates it; the final classification at
+ * ACTIVE → COOLDOWN confirms or corrects it, and provisional_event returns
+ * to NONE when ACTIVE ends.
+ *
+ * Event features (for classifiers beyond the two-feature rule above): each
+ * ACTIVE tick updates running sums in event_feature_acc_t — area above the
+ * baseline, largest rise between consecutive readings, and least-squares
+ * sums of the readings since the peak — and ACTIVE → COOLDOWN turns them
+ * into event_features_t (area, max rise, time to peak, decay constant,
+ * duration). For a decay x = B + A·e^(−t/τ), dx/dt = −(x − B)/τ, so τ is
+ * −1 / the slope of the per-tick change against the level, whatever the
+ * baseline B (the detector's own baseline has already taken a step towards
+ * the event on the trigger tick). The fit needs n, Σx and Σx² of the tick
+ * midpoints; Σx·Δx telescopes to the first and last reading. Memory is the
+ * same whatever the event length; the last event's features stay readable
+ * until the next one ends.
+ *
+ * The float back-end reads its thresholds from an event_detector_config_t
+ * (defaults = the #defines below), so host tools can tune them at runtime.
+ *
+ * Two arithmetic back-ends drive the same state machine:
+ *  - event_detector_update()   — float ppm (default)
+ *  - event_detector_update_q() — Q15.16 fixed-point ppm, no soft-float calls;
+ *                                used when CONFIG_LITTERBOX_FIXED_POINT is set
  */
 #pragma once
 
@@ -28,9 +82,78 @@
 #define EVENT_COOLDOWN_TICKS       6     /* Post-event cooldown ticks (6 × 10s = 60s) */
 #define URINE_FAST_PEAK_TICKS      3     /* Peak within 3 ticks (30s) → URINATION */
 #define BASELINE_ALPHA             0.05f /* EMA coefficient (~200s time constant) */
+#define URINE_PEAK_DELTA_PPM      30.0f  /* Peak − baseline above this → URINATION */
+#define BASELINE_OUTLIER_MIN_N     3     /* Readings averaged before the 3σ test applies */
+#define EVENT_SETTLE_GAIN          0.5f  /* Start-up baseline gain on falling readings while settling */
+#define EVENT_CUSUM_DRIFT_PPM      1.0f  /* Residual allowance per tick (≈3σ of sensor noise) */
+#define EVENT_CUSUM_LIMIT_PPM      8.0f  /* Accumulated excess → ACTIVE (CUSUM engine) */
+#define EVENT_ONSET_CONFIRM_TICKS  30    /* CUSUM onset must reach HYSTERESIS_PPM within this */
+#define EVENT_PROVISIONAL_MIN_TICKS 3    /* Ticks without a new peak before it counts as established */
+#define EVENT_PROVISIONAL_DROP_PPM 1.0f  /* ... and at least this fall from it */
+#define EVENT_DECAY_TAU_TICKS      128   /* Decay time constant between urination and defecation (~4.3 min) */
+#define EVENT_DECAY_FIT_MIN_PPM    2.0f  /* Fall since the peak needed before τ is fitted */
+#define EVENT_DECAY_FIT_SHIFT      4     /* Fit resolution: 1/16 ppm keeps n·Σx² in 63 bits up to 1024 ppm */
+
+/* Defaults for builds without sdkconfig (host); see Kconfig.projbuild */
+#ifndef CONFIG_LITTERBOX_DETECTOR_CUSUM
+#define CONFIG_LITTERBOX_DETECTOR_CUSUM 0
+#endif
+
+#define EVENT_BASELINE_STEADY      UINT8_MAX  /* baseline_n once gain has decayed to alpha */
+
+/* ---------- Fixed-point format (event_detector_update_q) ---------- */
+#define EVENT_PPM_Q_SHIFT          16    /* Q15.16: 1 LSB = 1/65536 ppm */
+#define EVENT_PPM_TO_Q(ppm)        ((int32_t)((ppm) * (1 << EVENT_PPM_Q_SHIFT) + 0.5f))
+#define BASELINE_ALPHA_Q           EVENT_PPM_TO_Q(BASELINE_ALPHA)  /* = 3277 */
+#define EVENT_SETTLE_GAIN_Q        EVENT_PPM_TO_Q(EVENT_SETTLE_GAIN)
+/* Integer part / hundredths of a non-negative Q15.16 value, for "%d.%02d" logs */
+#define EVENT_PPM_Q_INT(q)         ((int)((q) >> EVENT_PPM_Q_SHIFT))
+#define EVENT_PPM_Q_HUND(q)        ((int)((((q) & ((1 << EVENT_PPM_Q_SHIFT) - 1)) * 100) >> EVENT_PPM_Q_SHIFT))
 
 /* ---------- Types ---------- */
 
+typedef enum {
+    EVENT_ENGINE_THRESHOLD = 0,     /* Absolute trigger delta only */
+    EVENT_ENGINE_CUSUM     = 1,     /* CUSUM change-point test, threshold as fallback */
+} event_detector_engine_t;
+
+#if CONFIG_LITTERBOX_DETECTOR_CUSUM
+#define EVENT_DETECTOR_ENGINE_DEFAULT   EVENT_ENGINE_CUSUM
+#else
+#define EVENT_DETECTOR_ENGINE_DEFAULT   EVENT_ENGINE_THRESHOLD
+#endif
+
+/* Runtime thresholds for event_detector_update(); see the #defines above */
+typedef struct {
+    float    trigger_delta_ppm;     /* EVENT_TRIGGER_DELTA_PPM */
+    float    hysteresis_ppm;        /* EVENT_HYSTERESIS_PPM */
+    float    baseline_alpha;        /* BASELINE_ALPHA */
+    float    urine_peak_delta_ppm;  /* URINE_PEAK_DELTA_PPM */
+    uint16_t urine_fast_peak_ticks; /* URINE_FAST_PEAK_TICKS */
+    uint8_t  end_ticks;             /* EVENT_END_TICKS */
+    uint8_t  cooldown_ticks;        /* EVENT_COOLDOWN_TICKS */
+    bool     adaptive_baseline;     /* 1/n start-up gain; false = plain EMA from the first reading */
+    event_detector_engine_t engine; /* EVENT_DETECTOR_ENGINE_DEFAULT */
+    float    cusum_drift_ppm;       /* EVENT_CUSUM_DRIFT_PPM */
+    float    cusum_limit_ppm;       /* EVENT_CUSUM_LIMIT_PPM */
+    uint16_t onset_confirm_ticks;   /* EVENT_ONSET_CONFIRM_TICKS */
+} event_detector_config_t;
+
+#define EVENT_DETECTOR_CONFIG_DEFAULT() {                 \
+    .trigger_delta_ppm     = EVENT_TRIGGER_DELTA_PPM,      \
+    .hysteresis_ppm        = EVENT_HYSTERESIS_PPM,         \
+    .baseline_alpha        = BASELINE_ALPHA,               \
+    .urine_peak_delta_ppm  = URINE_PEAK_DELTA_PPM,         \
+    .urine_fast_peak_ticks = URINE_FAST_PEAK_TICKS,        \
+    .end_ticks             = EVENT_END_TICKS,              \
+    .cooldown_ticks        = EVENT_COOLDOWN_TICKS,         \
+    .adaptive_baseline     = true,                         \
+    .engine                = EVENT_DETECTOR_ENGINE_DEFAULT, \
+    .cusum_drift_ppm       = EVENT_CUSUM_DRIFT_PPM,        \
+    .cusum_limit_ppm       = EVENT_CUSUM_LIMIT_PPM,        \
+    .onset_confirm_ticks   = EVENT_ONSET_CONFIRM_TICKS,    \
+}
+
 typedef enum {
     LITTER_EVENT_NONE       = 0,
     LITTER_EVENT_URINATION  = 1,
@@ -43,16 +166,54 @@ typedef enum {
     DETECTOR_COOLDOWN,
 } detector_state_t;
 
+/* Features of the last finished event; see "Event features" above */
 typedef struct {
+    uint32_t auc_dppm_ticks;        /* Area above the baseline while ACTIVE, 0.1 ppm·ticks */
+    uint16_t max_rise_cppm;         /* Largest rise between consecutive readings, 0.01 ppm/tick */
+    uint16_t time_to_peak_ticks;    /* Trigger tick → peak */
+    uint16_t decay_tau_ticks;       /* Decay time constant fitted after the peak, 0 = too little fall */
+    uint16_t duration_ticks;        /* ACTIVE ticks */
+} event_features_t;
+
+/* Running sums behind event_features_t, O(1) per ACTIVE tick */
+typedef struct {
+    int64_t  auc_q;                 /* Σ max(0, ppm − baseline), Q15.16 ppm·ticks */
+    int64_t  decay_sum;             /* Σ y since the peak, y = sum of two consecutive excesses, 1/16 ppm */
+    int64_t  decay_sum_sq;          /* Σ y² */
+    int32_t  peak_excess;           /* Excess at the peak, 1/16 ppm */
+    int32_t  last_excess;           /* ... on the previous tick */
+    int32_t  max_rise_q;            /* Q15.16 ppm/tick */
+    uint16_t decay_n;               /* Ticks since the peak */
+} event_feature_acc_t;
+
+typedef struct {
+    const event_detector_config_t *cfg;   /* Thresholds for the float back-end */
     float            baseline_ppm;
     detector_state_t state;
     litter_event_t   current_event;
     float            peak_ppm;
+    int32_t          baseline_q;      /* Fixed-point back-end: baseline, Q15.16 ppm */
+    int32_t          peak_q;          /* Fixed-point back-end: peak, Q15.16 ppm */
+    int64_t          baseline_dev2_q; /* Fixed-point back-end: baseline_dev2, Q31.32 ppm² */
+    float            baseline_dev2;   /* Mean squared deviation of readings while averaging */
+    float            cusum;           /* CUSUM engine: accumulated residual excess, ppm·ticks */
+    int32_t          cusum_q;         /* Fixed-point back-end: cusum, Q15.16 */
     uint16_t         event_ticks;     /* Ticks since ACTIVE started */
     uint16_t         peak_ticks;      /* Tick at which peak was reached */
+    uint16_t         onset_ticks;     /* Tick ppm first exceeded baseline + trigger delta, 0 = not yet */
+    uint16_t         provisional_peak_ticks; /* peak_ticks the provisional type was decided on, 0 = none */
+    litter_event_t   provisional_event;      /* Early classification while ACTIVE, NONE otherwise */
+    uint8_t          provisional_confidence; /* ... confidence in it, 0–100 % */
     uint8_t          below_thresh_count; /* Consecutive ticks near baseline */
     uint8_t          cooldown_ticks;  /* Ticks spent in COOLDOWN */
+    uint8_t          baseline_n;      /* Readings in the start-up average; EVENT_BASELINE_STEADY after */
     bool             initialized;     /* False until first ppm reading sets baseline */
+    bool             settling;        /* Sensor overshoot still decaying (event_detector_set_settling) */
+    bool             cusum_armed;     /* CUSUM engine: residual has been below the drift since the last onset */
+    float            prev_ppm;        /* Previous reading (max rise of the onset tick) */
+    int32_t          prev_q;          /* Fixed-point back-end: prev_ppm, Q15.16 */
+    event_feature_acc_t feature_acc;  /* Running sums of the current event */
+    event_features_t features;        /* Features of the current / last finished event */
 } event_detector_t;
 
 /* ---------- API ---------- */
@@ -63,6 +224,14 @@ typedef struct {
  */
 void event_detector_init(event_detector_t *ctx);
 
+/**
+ * @brief Like event_detector_init(), but with caller-supplied thresholds.
+ *        cfg must outlive the context. The fixed-point back-end
+ *        (event_detector_update_q) uses the compile-time thresholds and
+ *        only honours cfg->adaptive_baseline and cfg->engine.
+ */
+void event_detector_init_with_config(event_detector_t *ctx, const event_detector_config_t *cfg);
+
 /**
  * @brief Feed one ppm reading into the state machine.
  *
@@ -75,7 +244,50 @@ void event_detector_init(event_detector_t *ctx);
  */
 litter_event_t event_detector_update(event_detector_t *ctx, float ppm);
 
+/**
+ * @brief Fixed-point variant of event_detector_update().
+ *
+ * Same state machine and thresholds, with baseline EMA, peak tracking and
+ * hysteresis computed in Q15.16 integer math (baseline_q / peak_q). Do not
+ * mix with event_detector_update() on the same context.
+ *
+ * @param ctx    Detector context (must be initialized)
+ * @param ppm_q  Current NH₃ reading, Q15.16 ppm (EVENT_PPM_Q_SHIFT)
+ */
+litter_event_t event_detector_update_q(event_detector_t *ctx, int32_t ppm_q);
+
+/**
+ * @brief Tell the detector whether the sensor is still settling
+ *        (air_sensor_data_t.is_settling). Call before each update; it only
+ *        affects the start-up average (cfg->adaptive_baseline), see
+ *        "Baseline" above.
+ */
+void event_detector_set_settling(event_detector_t *ctx, bool settling);
+
+/**
+ * @brief Resume from a saved baseline instead of learning it from the first
+ *        reading. ctx must already be set up by event_detector_init*(); it
+ *        goes to IDLE, initialized, with this baseline
+ *        (Q15.16 ppm — the same value event_detector_get_baseline_q() returns).
+ *
+ * @param ppm_q  The reading the restore was accepted on (Q15.16); it becomes
+ *               the previous reading, as the first reading does on a cold start
+ */
+void event_detector_restore_baseline_q(event_detector_t *ctx, int32_t baseline_q, int32_t ppm_q);
+
 /**
  * @brief Return the current estimated baseline ppm.
  */
 float event_detector_get_baseline(const event_detector_t *ctx);
+
+/**
+ * @brief Return the current estimated baseline, Q15.16 ppm.
+ *        Integer-only in CONFIG_LITTERBOX_FIXED_POINT builds.
+ */
+int32_t event_detector_get_baseline_q(const event_detector_t *ctx);
+
+/**
+ * @brief Return the peak of the current (or last) event, Q15.16 ppm.
+ *        Integer-only in CONFIG_LITTERBOX_FIXED_POINT builds.
+ */
+int32_t event_detector_get_peak_q(const event_detector_t *ctx);
@@ -0,0 +1,167 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * event_detector_batch.c — SoA batch stepping of event detectors
+ */
+#include "event_detector_batch.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* The vectorized pass only knows the threshold trigger */
+_Static_assert(EVENT_DETECTOR_ENGINE_DEFAULT == EVENT_ENGINE_THRESHOLD, "batch stepping needs the threshold engine");
+
+esp_err_t event_detector_soa_init(event_detector_soa_t *ctx, size_t n)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->n                  = n;
+    ctx->baseline_ppm       = calloc(n, sizeof(float));
+    ctx->peak_ppm           = calloc(n, sizeof(float));
+    ctx->baseline_dev2      = calloc(n, sizeof(float));
+    ctx->prev_ppm           = calloc(n, sizeof(float));
+    ctx->feature_acc        = calloc(n, sizeof(event_feature_acc_t));
+    ctx->features           = calloc(n, sizeof(event_features_t));
+    ctx->event_ticks        = calloc(n, sizeof(uint16_t));
+    ctx->peak_ticks         = calloc(n, sizeof(uint16_t));
+    ctx->onset_ticks        = calloc(n, sizeof(uint16_t));
+    ctx->provisional_peak_ticks = calloc(n, sizeof(uint16_t));
+    ctx->provisional_event  = calloc(n, sizeof(uint8_t));
+    ctx->provisional_confidence = calloc(n, sizeof(uint8_t));
+    ctx->state              = calloc(n, sizeof(uint8_t));
+    ctx->current_event      = calloc(n, sizeof(uint8_t));
+    ctx->below_thresh_count = calloc(n, sizeof(uint8_t));
+    ctx->cooldown_ticks     = calloc(n, sizeof(uint8_t));
+    ctx->initialized        = calloc(n, sizeof(uint8_t));
+    ctx->baseline_n         = calloc(n, sizeof(uint8_t));
+    ctx->settling           = calloc(n, sizeof(uint8_t));
+    ctx->slow               = calloc(n, sizeof(uint8_t));
+
+    if (!ctx->baseline_ppm || !ctx->peak_ppm || !ctx->baseline_dev2
+        || !ctx->prev_ppm || !ctx->feature_acc || !ctx->features || !ctx->event_ticks
+        || !ctx->peak_ticks || !ctx->onset_ticks || !ctx->provisional_peak_ticks
+        || !ctx->provisional_event || !ctx->provisional_confidence || !ctx->state || !ctx->current_event || !ctx->below_thresh_count
+        || !ctx->cooldown_ticks || !ctx->initialized || !ctx->baseline_n || !ctx->settling || !ctx->slow) {
+        event_detector_soa_free(ctx);
+        return ESP_ERR_NO_MEM;
+    }
+
+    /* calloc() zeroes match event_detector_init(): IDLE, NONE, not initialised */
+    return ESP_OK;
+}
+
+void event_detector_soa_free(event_detector_soa_t *ctx)
+{
+    free(ctx->baseline_ppm);
+    free(ctx->peak_ppm);
+    free(ctx->baseline_dev2);
+    free(ctx->prev_ppm);
+    free(ctx->feature_acc);
+    free(ctx->features);
+    free(ctx->event_ticks);
+    free(ctx->peak_ticks);
+    free(ctx->onset_ticks);
+    free(ctx->provisional_peak_ticks);
+    free(ctx->provisional_event);
+    free(ctx->provisional_confidence);
+    free(ctx->state);
+    free(ctx->current_event);
+    free(ctx->below_thresh_count);
+    free(ctx->cooldown_ticks);
+    free(ctx->initialized);
+    free(ctx->baseline_n);
+    free(ctx->settling);
+    free(ctx->slow);
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+void event_detector_soa_get(const event_detector_soa_t *ctx, size_t i, event_detector_t *out)
+{
+    event_detector_init(out);
+    out->baseline_ppm       = ctx->baseline_ppm[i];
+    out->peak_ppm           = ctx->peak_ppm[i];
+    out->baseline_dev2      = ctx->baseline_dev2[i];
+    out->prev_ppm           = ctx->prev_ppm[i];
+    out->feature_acc        = ctx->feature_acc[i];
+    out->features           = ctx->features[i];
+    out->event_ticks        = ctx->event_ticks[i];
+    out->peak_ticks         = ctx->peak_ticks[i];
+    out->onset_ticks        = ctx->onset_ticks[i];
+    out->provisional_peak_ticks = ctx->provisional_peak_ticks[i];
+    out->provisional_event  = (litter_event_t)ctx->provisional_event[i];
+    out->provisional_confidence = ctx->provisional_confidence[i];
+    out->state              = (detector_state_t)ctx->state[i];
+    out->current_event      = (litter_event_t)ctx->current_event[i];
+    out->below_thresh_count = ctx->below_thresh_count[i];
+    out->cooldown_ticks     = ctx->cooldown_ticks[i];
+    out->initialized        = ctx->initialized[i];
+    out->baseline_n         = ctx->baseline_n[i];
+    out->settling           = ctx->settling[i];
+}
+
+void event_detector_soa_set(event_detector_soa_t *ctx, size_t i, const event_detector_t *in)
+{
+    ctx->baseline_ppm[i]       = in->baseline_ppm;
+    ctx->peak_ppm[i]           = in->peak_ppm;
+    ctx->baseline_dev2[i]      = in->baseline_dev2;
+    ctx->prev_ppm[i]           = in->prev_ppm;
+    ctx->feature_acc[i]        = in->feature_acc;
+    ctx->features[i]           = in->features;
+    ctx->event_ticks[i]        = in->event_ticks;
+    ctx->peak_ticks[i]         = in->peak_ticks;
+    ctx->onset_ticks[i]        = in->onset_ticks;
+    ctx->provisional_peak_ticks[i] = in->provisional_peak_ticks;
+    ctx->provisional_event[i]  = (uint8_t)in->provisional_event;
+    ctx->provisional_confidence[i] = in->provisional_confidence;
+    ctx->state[i]              = (uint8_t)in->state;
+    ctx->current_event[i]      = (uint8_t)in->current_event;
+    ctx->below_thresh_count[i] = in->below_thresh_count;
+    ctx->cooldown_ticks[i]     = in->cooldown_ticks;
+    ctx->initialized[i]        = in->initialized;
+    ctx->baseline_n[i]         = in->baseline_n;
+    ctx->settling[i]           = in->settling;
+}
+
+/* Pass 1 (vectorized): IDLE lanes past start-up averaging that stay IDLE. Same expression as
+ * event_detector_update(), so the EMA rounds identically. The "stay" test
+ * is written as <= so NaN readings also fall to the scalar path. Kept as a
+ * separate function so the restrict-qualified parameters let GCC vectorize. */
+static void batch_idle_pass(float *restrict baseline, float *restrict prev, uint8_t *restrict slow,
+                            uint8_t *restrict out, const float *restrict in,
+                            const uint8_t *restrict state,
+                            const uint8_t *restrict steady,
+                            const uint8_t *restrict event, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        float   b    = baseline[i];
+        float   nb   = (1.0f - BASELINE_ALPHA) * b + BASELINE_ALPHA * in[i];
+        uint8_t idle = (state[i] == DETECTOR_IDLE) & (steady[i] == EVENT_BASELINE_STEADY);
+        uint8_t stay = idle & (in[i] <= nb + EVENT_TRIGGER_DELTA_PPM);
+
+        baseline[i] = stay ? nb : b;
+        prev[i]     = stay ? in[i] : prev[i];
+        slow[i]     = stay ^ 1;
+        out[i]      = event[i];
+    }
+}
+
+void event_detector_update_batch(event_detector_soa_t *ctx, const float *ppm,
+                                 uint8_t *events_out, size_t n)
+{
+    uint8_t *slow = ctx->slow;
+    uint8_t *out  = events_out;
+    const float *in = ppm;
+
+    batch_idle_pass(ctx->baseline_ppm, ctx->prev_ppm, slow, out, in, ctx->state,
+                    ctx->baseline_n, ctx->current_event, n);
+
+    /* Pass 2 (scalar): everything else runs through the reference code */
+    for (size_t i = 0; i < n; i++) {
+        if (slow[i]) {
+            event_detector_t det;
+            event_detector_soa_get(ctx, i, &det);
+            out[i] = (uint8_t)event_detector_update(&det, in[i]);
+            event_detector_soa_set(ctx, i, &det);
+        }
+    }
+}
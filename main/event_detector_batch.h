@@ -0,0 +1,81 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * event_detector_batch.h — Step many event detectors per call (SoA layout)
+ *
+ * For backend replay of NH₃ histories from a fleet of units. Each field of
+ * event_detector_t is stored as its own contiguous array, so the common
+ * case — an IDLE detector whose sample does not trigger — is one
+ * branch-free pass (EMA + threshold compare) that the compiler vectorizes.
+ * Detectors that are uninitialised, still averaging their start-up
+ * baseline, ACTIVE, COOLDOWN or about to trigger
+ * are stepped by the scalar event_detector_update() itself, so results are
+ * bit-identical to driving N event_detector_t one by one. All lanes use the
+ * default thresholds (EVENT_DETECTOR_CONFIG_DEFAULT) and the threshold
+ * onset engine; there is no CUSUM lane state.
+ *
+ * Host/backend only — not part of the firmware component.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "event_detector.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    size_t    n;
+    float    *baseline_ppm;
+    float    *peak_ppm;
+    float    *baseline_dev2;
+    float    *prev_ppm;
+    event_feature_acc_t *feature_acc;
+    event_features_t    *features;
+    uint16_t *event_ticks;
+    uint16_t *peak_ticks;
+    uint16_t *onset_ticks;
+    uint16_t *provisional_peak_ticks;
+    uint8_t  *state;                /* detector_state_t */
+    uint8_t  *current_event;        /* litter_event_t */
+    uint8_t  *provisional_event;    /* litter_event_t */
+    uint8_t  *provisional_confidence;
+    uint8_t  *below_thresh_count;
+    uint8_t  *cooldown_ticks;
+    uint8_t  *initialized;
+    uint8_t  *baseline_n;
+    uint8_t  *settling;             /* Set directly, as event_detector_set_settling() would */
+    uint8_t  *slow;                 /* Scratch: lanes needing the scalar path this step */
+} event_detector_soa_t;
+
+/**
+ * @brief Allocate and initialise n detectors (equivalent to event_detector_init()).
+ * @return ESP_OK, ESP_ERR_NO_MEM
+ */
+esp_err_t event_detector_soa_init(event_detector_soa_t *ctx, size_t n);
+
+void event_detector_soa_free(event_detector_soa_t *ctx);
+
+/**
+ * @brief Feed one ppm reading to each of the first n detectors.
+ *
+ * @param ctx         Detector set (n ≤ ctx->n)
+ * @param ppm         ppm[i] is detector i's reading for this tick
+ * @param events_out  events_out[i] receives what event_detector_update() would return
+ * @param n           Number of detectors to step
+ */
+void event_detector_update_batch(event_detector_soa_t *ctx, const float *ppm,
+                                 uint8_t *events_out, size_t n);
+
+/* Copy one lane to/from an AoS context (used by the slow path and for checks) */
+void event_detector_soa_get(const event_detector_soa_t *ctx, size_t i, event_detector_t *out);
+void event_detector_soa_set(event_detector_soa_t *ctx, size_t i, const event_detector_t *in);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,220 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * event_journal.c — Event journal ring, NVS storage and record codec
+ */
+#include "event_journal.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "le_bytes.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "JOURNAL";
+
+/* NVS blob: header, then count entries oldest first */
+typedef struct {
+    uint8_t  version;
+    uint8_t  boot;          /* Boot number of the last save */
+    uint16_t next_seq;
+    uint16_t count;
+    uint16_t reserved;
+} journal_blob_hdr_t;
+
+typedef struct {
+    journal_blob_hdr_t    hdr;
+    event_journal_entry_t entry[EVENT_JOURNAL_LEN];
+} journal_blob_t;
+
+_Static_assert(sizeof(journal_blob_t) <= EVENT_JOURNAL_NVS_MAX, "journal blob exceeds its bound");
+
+/* Version 1 (before the event features): same header, 16-byte entries
+ * holding the first 14 bytes of event_journal_entry_t at the same offsets */
+#define JOURNAL_V1_VERSION      1
+#define JOURNAL_V1_ENTRY_SIZE   16
+#define JOURNAL_V1_FIELD_BYTES  14
+
+_Static_assert(offsetof(event_journal_entry_t, area_ppm_s) == JOURNAL_V1_FIELD_BYTES,
+               "v1 journal entries no longer prefix event_journal_entry_t");
+
+static journal_blob_t s_blob;       /* ~0.8 KB staging copy, kept off the Zigbee task stack */
+
+static event_journal_entry_t *at(event_journal_t *j, size_t i)
+{
+    return &j->entry[(j->head + i) % EVENT_JOURNAL_LEN];
+}
+
+/* ── NVS ────────────────────────────────────────────────────────────── */
+
+static void journal_save(event_journal_t *j)
+{
+    if (!j->nvs_open) {
+        return;
+    }
+    journal_blob_t *blob = &s_blob;
+    blob->hdr = (journal_blob_hdr_t) {
+        .version  = EVENT_JOURNAL_VERSION,
+        .boot     = j->boot,
+        .next_seq = j->next_seq,
+        .count    = j->count,
+        .reserved = 0,
+    };
+    for (size_t i = 0; i < j->count; i++) {
+        blob->entry[i] = *at(j, i);
+    }
+    size_t len = sizeof(blob->hdr) + j->count * sizeof(event_journal_entry_t);
+    esp_err_t err = nvs_set_blob(j->nvs, j->key, blob, len);
+    if (err == ESP_OK) {
+        err = nvs_commit(j->nvs);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Saving %u journal entries failed (%s) — kept in RAM only", j->count, esp_err_to_name(err));
+    }
+}
+
+esp_err_t event_journal_open(event_journal_t *j, const char *key)
+{
+    memset(j, 0, sizeof(*j));
+    snprintf(j->key, sizeof(j->key), "%s", key);
+    ESP_RETURN_ON_ERROR(nvs_open(EVENT_JOURNAL_NAMESPACE, NVS_READWRITE, &j->nvs), TAG, "nvs_open failed");
+    j->nvs_open = true;
+
+    journal_blob_t *blob = &s_blob;
+    size_t len = sizeof(*blob);
+    esp_err_t err = nvs_get_blob(j->nvs, j->key, blob, &len);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        return ESP_OK;
+    }
+    bool v1 = err == ESP_OK && len >= sizeof(blob->hdr) && blob->hdr.version == JOURNAL_V1_VERSION;
+    size_t entry_size = v1 ? JOURNAL_V1_ENTRY_SIZE : sizeof(event_journal_entry_t);
+    if (err != ESP_OK || len < sizeof(blob->hdr) || (!v1 && blob->hdr.version != EVENT_JOURNAL_VERSION)
+        || blob->hdr.count > EVENT_JOURNAL_LEN
+        || len != sizeof(blob->hdr) + blob->hdr.count * entry_size) {
+        ESP_LOGW(TAG, "Ignoring unreadable event journal (%s, %u bytes)", esp_err_to_name(err), (unsigned)len);
+        return ESP_OK;
+    }
+
+    if (v1) {
+        /* Keep undelivered entries (features unknown: 0) and the sequence
+         * numbers the hub de-duplicates on; rewritten as v2 on the next save */
+        const uint8_t *src = (const uint8_t *)blob->entry;
+        for (size_t i = 0; i < blob->hdr.count; i++) {
+            memset(&j->entry[i], 0, sizeof(j->entry[i]));
+            memcpy(&j->entry[i], src + i * JOURNAL_V1_ENTRY_SIZE, JOURNAL_V1_FIELD_BYTES);
+        }
+        ESP_LOGI(TAG, "Migrated %u journal entries from version 1", blob->hdr.count);
+    } else {
+        memcpy(j->entry, blob->entry, blob->hdr.count * sizeof(event_journal_entry_t));
+    }
+    j->count    = blob->hdr.count;
+    j->next_seq = blob->hdr.next_seq;
+    /* A boot without events saves nothing and so reuses this number; no entry carries it */
+    j->boot     = (uint8_t)(blob->hdr.boot + 1);
+    if (j->count) {
+        ESP_LOGI(TAG, "%u undelivered event(s) from earlier boots", j->count);
+    }
+    return ESP_OK;
+}
+
+/* ── Ring ───────────────────────────────────────────────────────────── */
+
+bool event_journal_append(event_journal_t *j, const event_journal_entry_t *e)
+{
+    bool fits = j->count < EVENT_JOURNAL_LEN;
+    if (!fits) {
+        j->head = (uint16_t)((j->head + 1) % EVENT_JOURNAL_LEN);
+        j->count--;
+        j->overwritten++;
+    }
+    event_journal_entry_t *slot = at(j, j->count);
+    *slot      = *e;
+    slot->seq  = j->next_seq++;
+    slot->boot = j->boot;
+    j->count++;
+    journal_save(j);
+    return fits;
+}
+
+void event_journal_commit(event_journal_t *j)
+{
+    if (!j->sending) {
+        return;
+    }
+    /* Match by sequence number: an overflow may have moved the head since */
+    while (j->count && (int16_t)(at(j, 0)->seq - j->sent_seq) <= 0) {
+        j->head = (uint16_t)((j->head + 1) % EVENT_JOURNAL_LEN);
+        j->count--;
+    }
+    j->sending = 0;
+    journal_save(j);
+}
+
+/* ── Record codec ───────────────────────────────────────────────────── */
+
+size_t event_journal_encode(event_journal_t *j, uint32_t now_s, uint8_t *out)
+{
+    size_t n = j->count < EVENT_JOURNAL_BURST ? j->count : EVENT_JOURNAL_BURST;
+    j->sending = (uint8_t)n;
+    if (n == 0) {
+        return 0;
+    }
+
+    uint8_t *p = out;
+    *p++ = EVENT_JOURNAL_FORMAT;
+    *p++ = (uint8_t)n;
+    *p++ = j->boot;
+    p = le_put32(p, now_s);
+    for (size_t i = 0; i < n; i++) {
+        const event_journal_entry_t *e = at(j, i);
+        p = le_put16(p, e->seq);
+        *p++ = e->type;
+        *p++ = e->boot;
+        p = le_put32(p, e->start_s);
+        p = le_put16(p, e->duration_s);
+        p = le_put16(p, e->peak_dppm);
+        p = le_put16(p, e->baseline_dppm);
+        p = le_put16(p, e->area_ppm_s);
+        p = le_put16(p, e->max_rise_cppm_s);
+        p = le_put16(p, e->time_to_peak_s);
+        p = le_put16(p, e->decay_tau_s);
+        j->sent_seq = e->seq;
+    }
+    return (size_t)(p - out);
+}
+
+int event_journal_decode(const uint8_t *p, size_t len, event_journal_hdr_t *hdr, event_journal_entry_t *entries,
+                         size_t cap)
+{
+    if (len < EVENT_JOURNAL_HEADER_BYTES || p[0] != EVENT_JOURNAL_FORMAT) {
+        return -1;
+    }
+    hdr->format   = p[0];
+    hdr->count    = p[1];
+    hdr->boot     = p[2];
+    hdr->uptime_s = le_get32(&p[3]);
+    if (hdr->count == 0 || hdr->count > cap
+        || len != EVENT_JOURNAL_HEADER_BYTES + (size_t)hdr->count * EVENT_JOURNAL_ENTRY_BYTES) {
+        return -1;
+    }
+
+    p += EVENT_JOURNAL_HEADER_BYTES;
+    for (size_t i = 0; i < hdr->count; i++, p += EVENT_JOURNAL_ENTRY_BYTES) {
+        entries[i] = (event_journal_entry_t) {
+            .seq             = le_get16(&p[0]),
+            .type            = p[2],
+            .boot            = p[3],
+            .start_s         = le_get32(&p[4]),
+            .duration_s      = le_get16(&p[8]),
+            .peak_dppm       = le_get16(&p[10]),
+            .baseline_dppm   = le_get16(&p[12]),
+            .area_ppm_s      = le_get16(&p[14]),
+            .max_rise_cppm_s = le_get16(&p[16]),
+            .time_to_peak_s  = le_get16(&p[18]),
+            .decay_tau_s     = le_get16(&p[20]),
+        };
+    }
+    return hdr->count;
+}
@@ -0,0 +1,151 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * event_journal.h — Store-and-forward journal of classified litter events
+ *
+ * Every URINATION / DEFECATION the detector classifies is appended here
+ * (type, onset uptime, duration, peak, baseline and the event features of
+ * event_detector.h) and kept in NVS until the
+ * hub acknowledges it, so an event that happens while the coordinator is
+ * unreachable — or just before a reboot — is delivered once the link is
+ * back instead of being reported once and lost.
+ *
+ * Entries go out oldest first, up to EVENT_JOURNAL_BURST per octet-string
+ * record (attribute 0xFC00/0x0005). Layout, little-endian:
+ *
+ *   0  u8   format (EVENT_JOURNAL_FORMAT)
+ *   1  u8   entry count n (1..EVENT_JOURNAL_BURST)
+ *   2  u8   boot number now
+ *   3  u32  uptime now, s (when the record was built)
+ *   7  n ×  entry:
+ *           u16 sequence number (+1 per event, wraps; the hub de-duplicates)
+ *           u8  event type (litter_event_t)
+ *           u8  boot number the event happened in
+ *           u32 onset uptime, s
+ *           u16 duration, s (ACTIVE phase)
+ *           u16 peak, 0.1 ppm
+ *           u16 baseline, 0.1 ppm
+ *           u16 area above the baseline, ppm·s (saturates)
+ *           u16 max rise, 0.01 ppm/s
+ *           u16 time to peak, s
+ *           u16 decay time constant, s (0 = not fitted)
+ *
+ * Onset time is uptime plus a boot number (low byte of a counter kept with
+ * the journal): the hub dates entries from the current boot against the
+ * record's "uptime now"; older ones only by order.
+ *
+ * Bounded: EVENT_JOURNAL_LEN entries in RAM and one NVS blob of at most
+ * EVENT_JOURNAL_NVS_MAX bytes, rewritten once per append and once per
+ * acknowledged record. When full, the oldest entry is overwritten.
+ *
+ * Not thread-safe: one owner (the Zigbee task). Platform-independent apart
+ * from NVS; host/bench/journal_bench.c runs it through outages.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "nvs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Default for builds without sdkconfig (host); see Kconfig.projbuild */
+#ifndef CONFIG_LITTERBOX_EVENT_JOURNAL_LEN
+#define CONFIG_LITTERBOX_EVENT_JOURNAL_LEN  32
+#endif
+
+#define EVENT_JOURNAL_LEN           CONFIG_LITTERBOX_EVENT_JOURNAL_LEN
+#define EVENT_JOURNAL_NAMESPACE     "litterbox"
+#define EVENT_JOURNAL_KEY           "ev_journal"    /* Default key (sensor channel 0) */
+#define EVENT_JOURNAL_VERSION       2
+#define EVENT_JOURNAL_FORMAT        0x02    /* 0x01: entries without the feature fields */
+#define EVENT_JOURNAL_BURST         3       /* Entries per record: 73 B, one report frame */
+#define EVENT_JOURNAL_HEADER_BYTES  7
+#define EVENT_JOURNAL_ENTRY_BYTES   22
+#define EVENT_JOURNAL_MAX_BYTES     (EVENT_JOURNAL_HEADER_BYTES + EVENT_JOURNAL_BURST * EVENT_JOURNAL_ENTRY_BYTES)
+
+typedef struct {
+    uint16_t seq;
+    uint8_t  type;              /* litter_event_t */
+    uint8_t  boot;
+    uint32_t start_s;           /* Uptime at onset */
+    uint16_t duration_s;
+    uint16_t peak_dppm;         /* 0.1 ppm */
+    uint16_t baseline_dppm;     /* 0.1 ppm */
+    uint16_t area_ppm_s;        /* Area above the baseline */
+    uint16_t max_rise_cppm_s;   /* 0.01 ppm/s */
+    uint16_t time_to_peak_s;
+    uint16_t decay_tau_s;       /* 0 = not fitted */
+} event_journal_entry_t;
+
+#define EVENT_JOURNAL_NVS_MAX       (8 + EVENT_JOURNAL_LEN * sizeof(event_journal_entry_t))
+
+typedef struct {
+    event_journal_entry_t entry[EVENT_JOURNAL_LEN];
+    uint16_t     head;          /* Oldest entry */
+    uint16_t     count;
+    uint16_t     next_seq;
+    uint8_t      boot;
+    uint8_t      sending;       /* Entries in the last record built, 0 if none */
+    uint16_t     sent_seq;      /* Sequence number of the last of them */
+    uint32_t     overwritten;   /* Entries lost to a full journal, this boot */
+    nvs_handle_t nvs;
+    bool         nvs_open;
+    char         key[NVS_KEY_NAME_MAX_SIZE];
+} event_journal_t;
+
+typedef struct {
+    uint8_t  format;
+    uint8_t  count;
+    uint8_t  boot;
+    uint32_t uptime_s;
+} event_journal_hdr_t;
+
+/**
+ * @brief Load the journal from NVS and start a new boot number.
+ *        Works without NVS (RAM only) if nvs_open() fails; that error is returned.
+ * @param key  NVS key of this journal (EVENT_JOURNAL_KEY for a single sensor)
+ * @return ESP_OK with or without saved entries, or the NVS error
+ */
+esp_err_t event_journal_open(event_journal_t *j, const char *key);
+
+/**
+ * @brief Append an event and save the journal.
+ * @param e  The event; seq and boot are assigned by the journal
+ * @return false if the journal was full and the oldest entry was dropped
+ */
+bool event_journal_append(event_journal_t *j, const event_journal_entry_t *e);
+
+/**
+ * @brief Build the record for the oldest (up to EVENT_JOURNAL_BURST) entries.
+ *
+ * They stay in the journal until event_journal_commit(). Building again
+ * before that starts over from the oldest entry.
+ *
+ * @param out  At least EVENT_JOURNAL_MAX_BYTES
+ * @return Record length, 0 if the journal is empty
+ */
+size_t event_journal_encode(event_journal_t *j, uint32_t now_s, uint8_t *out);
+
+/**
+ * @brief The last record built was acknowledged: drop its entries and save.
+ *        Entries already overwritten in the meantime are skipped.
+ */
+void event_journal_commit(event_journal_t *j);
+
+/**
+ * @brief Decode a record (hub side; benches).
+ * @return Entry count, or −1 if malformed or more than cap entries
+ */
+int event_journal_decode(const uint8_t *p, size_t len, event_journal_hdr_t *hdr, event_journal_entry_t *entries,
+                         size_t cap);
+
+#ifdef __cplusplus
+}
+#endif
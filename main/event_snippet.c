@@ -0,0 +1,253 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * event_snippet.c — Pre-trigger ring, snippet capture and fragment transfer
+ */
+#include "event_snippet.h"
+#include "event_detector.h"
+#include "le_bytes.h"
+#include "sample_block.h"
+#include <string.h>
+
+void event_snippet_init(event_snippet_t *s, uint32_t interval_ms)
+{
+    memset(s, 0, sizeof(*s));
+    uint32_t pre = (CONFIG_LITTERBOX_SNIPPET_PRE_S * 1000u + interval_ms - 1) / interval_ms;
+    s->pre_len     = (uint16_t)(pre > EVENT_SNIPPET_PRE_MAX ? EVENT_SNIPPET_PRE_MAX : pre);
+    s->interval_ds = (uint8_t)(interval_ms / 100);
+    s->capturing   = -1;
+    s->latest      = -1;
+}
+
+/* ── Capture ────────────────────────────────────────────────────────── */
+
+static void capture_put(event_snippet_t *s, uint16_t value)
+{
+    event_snippet_slot_t *slot = &s->slot[s->capturing];
+    if (slot->buf[1] & EVENT_SNIPPET_FLAG_TRUNCATED) {
+        return;
+    }
+    if (s->count == 0) {
+        le_put16(&slot->buf[15], value);
+        slot->len = EVENT_SNIPPET_HEADER_BYTES;
+    } else {
+        uint8_t enc[SAMPLE_DELTA_MAX_BYTES];
+        size_t  n = sample_delta_encode(s->last, value, enc);
+        if (slot->len + n > EVENT_SNIPPET_MAX_BYTES || s->count == UINT16_MAX) {
+            slot->buf[1] |= EVENT_SNIPPET_FLAG_TRUNCATED;
+            return;
+        }
+        memcpy(&slot->buf[slot->len], enc, n);
+        slot->len += (uint16_t)n;
+    }
+    s->count++;
+    s->last = value;
+}
+
+/* Trigger: freeze the ring (oldest first) into a free slot */
+static void capture_start(event_snippet_t *s, uint32_t tick, uint16_t baseline)
+{
+    int8_t idx = s->latest == 0 ? 1 : 0;    /* Never the latest finished one */
+    event_snippet_slot_t *slot = &s->slot[idx];
+    uint8_t *p = slot->buf;
+    *p++ = EVENT_SNIPPET_FORMAT;
+    *p++ = 0;
+    p = le_put16(p, s->next_seq++);
+    p = le_put32(p, tick);
+    *p++ = s->interval_ds;
+    *p++ = (uint8_t)s->pre_count;
+    p = le_put16(p, 0);                        /* Count and event: at the end */
+    *p++ = LITTER_EVENT_NONE;
+    le_put16(p, baseline);
+    slot->len  = 0;
+    slot->done = false;
+
+    s->capturing = idx;
+    s->count = 0;
+    uint16_t first = (uint16_t)((s->pre_head + s->pre_len - s->pre_count) % s->pre_len);
+    for (uint16_t i = 0; i < s->pre_count; i++) {
+        capture_put(s, s->pre[(first + i) % s->pre_len]);
+    }
+}
+
+static void capture_finish(event_snippet_t *s, uint8_t event)
+{
+    event_snippet_slot_t *slot = &s->slot[s->capturing];
+    le_put16(&slot->buf[10], s->count);
+    slot->buf[12] = event;
+    slot->done = true;
+    s->latest = s->capturing;
+    s->capturing = -1;
+    s->captured++;
+    s->truncated += (slot->buf[1] & EVENT_SNIPPET_FLAG_TRUNCATED) ? 1 : 0;
+}
+
+/* One tick into the ring and, during an event, the capture */
+static void sample_put(event_snippet_t *s, uint16_t value)
+{
+    if (s->capturing >= 0) {
+        capture_put(s, value);
+    }
+    s->pre[s->pre_head] = value;
+    s->pre_head = (uint16_t)((s->pre_head + 1) % s->pre_len);
+    if (s->pre_count < s->pre_len) {
+        s->pre_count++;
+    }
+}
+
+bool event_snippet_add(event_snippet_t *s, uint32_t tick, uint16_t value, uint8_t state, uint8_t event,
+                       uint16_t baseline)
+{
+    /* Samples that never arrived: INVALID, as far as they still matter */
+    if (s->started && tick != s->next_tick) {
+        uint32_t gap = tick - s->next_tick;
+        if (gap > 0x7FFFFFFF) {
+            gap = 0;                        /* Went backwards: treat as consecutive */
+        }
+        for (uint32_t i = 0; i < gap; i++) {
+            bool full = s->capturing < 0 || (s->slot[s->capturing].buf[1] & EVENT_SNIPPET_FLAG_TRUNCATED);
+            if (full && i >= s->pre_len) {
+                break;                      /* Ring already all INVALID, capture cannot grow */
+            }
+            sample_put(s, EVENT_SNIPPET_INVALID);
+        }
+    }
+    s->started   = true;
+    s->next_tick = tick + 1;
+
+    if (s->capturing < 0 && state == DETECTOR_ACTIVE) {
+        capture_start(s, tick, baseline);
+    }
+    sample_put(s, value);
+    if (s->capturing >= 0 && state != DETECTOR_ACTIVE) {
+        capture_finish(s, event);
+        return true;
+    }
+    return false;
+}
+
+/* ── Transfer ───────────────────────────────────────────────────────── */
+
+static const event_snippet_slot_t *find(const event_snippet_t *s, uint16_t seq)
+{
+    if (seq == EVENT_SNIPPET_SEQ_LATEST) {
+        return s->latest >= 0 ? &s->slot[s->latest] : NULL;
+    }
+    for (int i = 0; i < EVENT_SNIPPET_SLOTS; i++) {
+        if (s->slot[i].done && le_get16(&s->slot[i].buf[2]) == seq) {
+            return &s->slot[i];
+        }
+    }
+    return NULL;
+}
+
+bool event_snippet_latest(const event_snippet_t *s, event_snippet_info_t *info)
+{
+    const event_snippet_slot_t *slot = find(s, EVENT_SNIPPET_SEQ_LATEST);
+    if (!slot) {
+        return false;
+    }
+    *info = (event_snippet_info_t) {
+        .flags        = slot->buf[1],
+        .seq          = le_get16(&slot->buf[2]),
+        .len          = slot->len,
+        .event        = slot->buf[12],
+        .trigger_tick = le_get32(&slot->buf[4]),
+        .count        = le_get16(&slot->buf[10]),
+    };
+    return true;
+}
+
+size_t event_snippet_info_encode(const event_snippet_t *s, uint8_t *out)
+{
+    event_snippet_info_t info;
+    if (!event_snippet_latest(s, &info)) {
+        return 0;
+    }
+    uint8_t *p = out;
+    *p++ = EVENT_SNIPPET_FORMAT;
+    *p++ = info.flags;
+    p = le_put16(p, info.seq);
+    p = le_put16(p, info.len);
+    *p++ = info.event;
+    p = le_put32(p, info.trigger_tick);
+    p = le_put16(p, info.count);
+    return (size_t)(p - out);
+}
+
+size_t event_snippet_fragment(const event_snippet_t *s, const uint8_t *req, size_t req_len, uint8_t *out)
+{
+    if (req_len < 4) {
+        return 0;
+    }
+    uint16_t seq    = le_get16(&req[0]);
+    uint16_t offset = le_get16(&req[2]);
+    const event_snippet_slot_t *slot = find(s, seq);
+
+    uint8_t status = EVENT_SNIPPET_STATUS_OK;
+    uint16_t len = 0, n = 0;
+    if (!slot) {
+        status = EVENT_SNIPPET_STATUS_NOT_FOUND;
+    } else {
+        seq = le_get16(&slot->buf[2]);
+        len = slot->len;
+        if (offset > len) {
+            status = EVENT_SNIPPET_STATUS_INVALID;
+        } else {
+            n = (uint16_t)(len - offset < EVENT_SNIPPET_FRAGMENT_BYTES ? len - offset : EVENT_SNIPPET_FRAGMENT_BYTES);
+        }
+    }
+
+    uint8_t *p = out;
+    *p++ = status;
+    p = le_put16(p, seq);
+    p = le_put16(p, offset);
+    p = le_put16(p, len);
+    if (n) {
+        memcpy(p, &slot->buf[offset], n);
+        p += n;
+    }
+    return (size_t)(p - out);
+}
+
+/* ── Decoding ───────────────────────────────────────────────────────── */
+
+int event_snippet_decode(const uint8_t *p, size_t len, event_snippet_hdr_t *hdr, uint16_t *values, size_t cap)
+{
+    if (len < EVENT_SNIPPET_HEADER_BYTES || p[0] != EVENT_SNIPPET_FORMAT) {
+        return -1;
+    }
+    hdr->format       = p[0];
+    hdr->flags        = p[1];
+    hdr->seq          = le_get16(&p[2]);
+    hdr->trigger_tick = le_get32(&p[4]);
+    hdr->interval_ds  = p[8];
+    hdr->pre_count    = p[9];
+    hdr->count        = le_get16(&p[10]);
+    hdr->event        = p[12];
+    hdr->baseline     = le_get16(&p[13]);
+    if (hdr->count == 0 || hdr->count > cap) {
+        return -1;
+    }
+
+    return sample_delta_decode(&p[EVENT_SNIPPET_HEADER_BYTES], len - EVENT_SNIPPET_HEADER_BYTES, le_get16(&p[15]),
+                               values, hdr->count) ? hdr->count : -1;
+}
+
+bool event_snippet_info_decode(const uint8_t *p, size_t len, event_snippet_info_t *info)
+{
+    if (len != EVENT_SNIPPET_INFO_BYTES || p[0] != EVENT_SNIPPET_FORMAT) {
+        return false;
+    }
+    *info = (event_snippet_info_t) {
+        .flags        = p[1],
+        .seq          = le_get16(&p[2]),
+        .len          = le_get16(&p[4]),
+        .event        = p[6],
+        .trigger_tick = le_get32(&p[7]),
+        .count        = le_get16(&p[11]),
+    };
+    return true;
+}
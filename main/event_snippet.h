@@ -0,0 +1,198 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * event_snippet.h — Pre-trigger waveform capture of each detected event
+ *
+ * Every sample goes into a ring covering the last
+ * CONFIG_LITTERBOX_SNIPPET_PRE_S (60 s by default). When the detector leaves IDLE the ring is
+ * frozen into a snippet, and every sample after it is appended until the
+ * detector leaves ACTIVE (the first COOLDOWN sample, which carries the
+ * classification, is the last one). The finished snippet stays readable
+ * until a later event overwrites its slot, so the hub can look at the onset
+ * the detector triggered on and check the classification offline.
+ *
+ * Snippet layout, little-endian (values 0.1 ppm, EVENT_SNIPPET_INVALID for
+ * a failed read or a tick whose sample never arrived):
+ *
+ *   0  u8   format (EVENT_SNIPPET_FORMAT)
+ *   1  u8   flags (EVENT_SNIPPET_FLAG_*)
+ *   2  u16  snippet sequence number (+1 per event, wraps)
+ *   4  u32  trigger tick: sample index of the first ACTIVE sample
+ *   8  u8   sample interval, 100 ms units
+ *   9  u8   pre-trigger sample count p (values before the trigger tick)
+ *  10  u16  sample count n (p pre-trigger + n−p from the trigger on)
+ *  12  u8   event type (litter_event_t) the detector classified it as
+ *  13  u16  baseline at the trigger
+ *  15  u16  first value
+ *  17  ...  n−1 deltas, zigzag LEB128 varint (as sample_block.h)
+ *
+ * The hub learns of a finished snippet from the info record (attribute
+ * 0xFC00/0x0006, reported once):
+ *
+ *   0  u8   format (EVENT_SNIPPET_FORMAT)
+ *   1  u8   flags (EVENT_SNIPPET_FLAG_*)
+ *   2  u16  snippet sequence number
+ *   4  u16  snippet length, bytes
+ *   6  u8   event type
+ *   7  u32  trigger tick
+ *  11  u16  sample count
+ *
+ * and pulls it with Get Snippet Fragment (cluster command 0x00, client →
+ * server: u16 sequence number, 0xFFFF = latest; u16 byte offset), answered
+ * by Snippet Fragment (command 0x00, server → client: u8 ZCL status,
+ * u16 sequence number, u16 offset, u16 snippet length, then up to
+ * EVENT_SNIPPET_FRAGMENT_BYTES bytes). Any fragment can be asked for again.
+ *
+ * Bounded: the ring plus EVENT_SNIPPET_SLOTS buffers of
+ * EVENT_SNIPPET_MAX_BYTES, whatever the event length. Samples that do not
+ * fit are left out and the snippet is flagged EVENT_SNIPPET_FLAG_TRUNCATED;
+ * capture still follows the event to its end for the event type. The
+ * snippet being captured never overwrites the latest finished one, so a
+ * transfer in progress survives the next event's onset.
+ *
+ * Not thread-safe: one owner (the Zigbee task, where the sample queue and
+ * the fragment requests both arrive). Platform-independent;
+ * host/bench/snippet_bench.c captures a synthetic trace and fetches the
+ * snippets over a lossy link.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Defaults for builds without sdkconfig (host); see Kconfig.projbuild */
+#ifndef CONFIG_LITTERBOX_SNIPPET_PRE_S
+#define CONFIG_LITTERBOX_SNIPPET_PRE_S      60
+#endif
+#ifndef CONFIG_LITTERBOX_SNIPPET_BYTES
+#define CONFIG_LITTERBOX_SNIPPET_BYTES      1024
+#endif
+
+#define EVENT_SNIPPET_FORMAT            0x01
+#define EVENT_SNIPPET_FLAG_TRUNCATED    0x01    /* Ran out of room before the event ended */
+#define EVENT_SNIPPET_HEADER_BYTES      17
+#define EVENT_SNIPPET_INFO_BYTES        13
+#define EVENT_SNIPPET_MAX_BYTES         CONFIG_LITTERBOX_SNIPPET_BYTES
+#define EVENT_SNIPPET_SLOTS             2       /* Latest finished + the one being captured */
+#define EVENT_SNIPPET_INVALID           0xFFFF
+#define EVENT_SNIPPET_SEQ_LATEST        0xFFFF
+#define EVENT_SNIPPET_FRAGMENT_BYTES    64      /* Response payload ≤ 71 B: one unfragmented APS frame */
+#define EVENT_SNIPPET_FRAGMENT_HDR      7       /* status, seq, offset, length */
+
+/* Cluster-specific commands of 0xFC00 */
+#define EVENT_SNIPPET_CMD_GET_FRAGMENT  0x00    /* Client → server */
+#define EVENT_SNIPPET_CMD_FRAGMENT      0x00    /* Server → client */
+
+/* Snippet Fragment status (ZCL status codes) */
+#define EVENT_SNIPPET_STATUS_OK         0x00
+#define EVENT_SNIPPET_STATUS_NOT_FOUND  0x8B    /* Unknown or overwritten sequence number */
+#define EVENT_SNIPPET_STATUS_INVALID    0x87    /* Offset past the end */
+
+#define EVENT_SNIPPET_PRE_MAX           120     /* Ring capacity: 4 min at 2 s; PRE_S beyond it is cut */
+
+typedef struct {
+    uint8_t  buf[EVENT_SNIPPET_MAX_BYTES];
+    uint16_t len;               /* Bytes used, 0 = empty slot */
+    bool     done;              /* Finished and readable */
+} event_snippet_slot_t;
+
+typedef struct {
+    uint16_t pre[EVENT_SNIPPET_PRE_MAX];    /* Ring of the latest values */
+    uint16_t pre_len;           /* Ring size in use: CONFIG_LITTERBOX_SNIPPET_PRE_S of samples */
+    uint16_t pre_head;          /* Next write position */
+    uint16_t pre_count;         /* Values in the ring, ≤ pre_len */
+    uint32_t next_tick;         /* Tick expected next; a jump is filled with INVALID */
+    bool     started;           /* next_tick is meaningful */
+
+    event_snippet_slot_t slot[EVENT_SNIPPET_SLOTS];
+    int8_t   capturing;         /* Slot being filled, −1 if none */
+    int8_t   latest;            /* Slot of the latest finished snippet, −1 if none */
+    uint16_t count;             /* Samples in the capture */
+    uint16_t last;              /* Last value added (delta reference) */
+    uint16_t next_seq;
+    uint8_t  interval_ds;
+
+    uint32_t captured;          /* Snippets finished */
+    uint32_t truncated;         /* ... of which cut short */
+} event_snippet_t;
+
+typedef struct {
+    uint8_t  format;
+    uint8_t  flags;
+    uint16_t seq;
+    uint32_t trigger_tick;
+    uint8_t  interval_ds;
+    uint8_t  pre_count;
+    uint16_t count;
+    uint8_t  event;
+    uint16_t baseline;
+} event_snippet_hdr_t;
+
+typedef struct {
+    uint8_t  flags;
+    uint16_t seq;
+    uint16_t len;
+    uint8_t  event;
+    uint32_t trigger_tick;
+    uint16_t count;
+} event_snippet_info_t;
+
+void event_snippet_init(event_snippet_t *s, uint32_t interval_ms);
+
+/**
+ * @brief Feed one sample: into the pre-trigger ring, and into the capture
+ *        while an event is on.
+ *
+ * @param tick      Sample index; a jump since the last call adds INVALID values
+ * @param value     0.1 ppm, EVENT_SNIPPET_INVALID for a failed read
+ * @param state     detector_state_t after this sample
+ * @param event     litter_event_t after this sample
+ * @param baseline  Baseline after this sample, 0.1 ppm
+ * @return true if this sample finished a snippet (see event_snippet_latest())
+ */
+bool event_snippet_add(event_snippet_t *s, uint32_t tick, uint16_t value, uint8_t state, uint8_t event,
+                       uint16_t baseline);
+
+/**
+ * @brief Describe the latest finished snippet.
+ * @return false if none has finished yet
+ */
+bool event_snippet_latest(const event_snippet_t *s, event_snippet_info_t *info);
+
+/**
+ * @brief Build the info record for the latest finished snippet.
+ * @param out  At least EVENT_SNIPPET_INFO_BYTES
+ * @return Record length, 0 if none has finished yet
+ */
+size_t event_snippet_info_encode(const event_snippet_t *s, uint8_t *out);
+
+/**
+ * @brief Answer a Get Snippet Fragment request.
+ *
+ * @param req      Request payload (u16 seq, u16 offset)
+ * @param out      Response payload, at least EVENT_SNIPPET_FRAGMENT_HDR + EVENT_SNIPPET_FRAGMENT_BYTES
+ * @return Response length; 0 if the request is malformed (no response)
+ */
+size_t event_snippet_fragment(const event_snippet_t *s, const uint8_t *req, size_t req_len, uint8_t *out);
+
+/**
+ * @brief Decode a snippet (hub side; benches).
+ * @return Sample count, or −1 if malformed or more than cap samples
+ */
+int event_snippet_decode(const uint8_t *p, size_t len, event_snippet_hdr_t *hdr, uint16_t *values, size_t cap);
+
+/**
+ * @brief Decode an info record (hub side; benches).
+ */
+bool event_snippet_info_decode(const uint8_t *p, size_t len, event_snippet_info_t *info);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,603 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * history_log.c — Flash sample history: block codec, circular sector store, writer task
+ */
+#include "history_log.h"
+#include <stdlib.h>
+#include <string.h>
+#include "esp_check.h"
+#include "le_bytes.h"
+
+#if CONFIG_LITTERBOX_HISTORY_LOG
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#endif
+
+static const char *TAG = "HISTORY";
+
+/* CRC-16/CCITT-FALSE: polynomial 0x1021, init 0xFFFF (one block per ~17 min — bitwise is fine) */
+uint16_t history_crc16(const uint8_t *data, size_t len)
+{
+    uint16_t crc = 0xFFFF;
+    while (len--) {
+        crc ^= (uint16_t)(*data++ << 8);
+        for (int i = 0; i < 8; i++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+/* ── Adaptive Rice code ─────────────────────────────────────────────── */
+
+#define RICE_A_INIT     4
+#define RICE_N_INIT     1
+#define RICE_N_RESET    32      /* Halve A and N here: adapts to the last ~32 deltas */
+#define RICE_K_MAX      15
+#define SAMPLE_BITS_MAX (HISTORY_RICE_ESCAPE + HISTORY_RAW_BITS)
+#define PRED_SHIFT      3       /* Predict from the mean of ~8 samples: white noise costs ~0.4 bit less than a delta */
+
+static uint32_t zigzag(int32_t d)
+{
+    return ((uint32_t)d << 1) ^ (uint32_t)(d >> 31);
+}
+
+/* Near-lossless residual (JPEG-LS): index of e in steps of 2·tol+1, so the
+ * reconstruction pred + index·step is within tol of the sample */
+static int32_t quantize(int32_t e, unsigned tol)
+{
+    int32_t t = (int32_t)tol, step = 2 * t + 1;
+    return e >= 0 ? (e + t) / step : -((t - e) / step);
+}
+
+static int32_t clamp_raw(int32_t v)
+{
+    return v < 0 ? 0 : v > UINT16_MAX ? UINT16_MAX : v;
+}
+
+/* Prediction: exponential mean of the reconstructed samples, Q4 */
+static int32_t pred_value(int32_t pred_q4)
+{
+    return (pred_q4 + 8) >> 4;
+}
+
+static void pred_update(int32_t *pred_q4, int32_t raw)
+{
+    *pred_q4 += ((raw << 4) - *pred_q4) >> PRED_SHIFT;
+}
+
+static unsigned rice_k(uint32_t a, uint32_t n)
+{
+    unsigned k = 0;
+    while ((n << k) < a && k < RICE_K_MAX) {
+        k++;
+    }
+    return k;
+}
+
+static void rice_update(uint32_t *a, uint32_t *n, uint32_t u)
+{
+    *a += u;
+    if (++*n >= RICE_N_RESET) {
+        *a >>= 1;
+        *n >>= 1;
+    }
+}
+
+/* Append the low n bits of v (n ≤ 24), MSB first; buf is zeroed beforehand */
+static void bits_put(uint8_t *buf, uint32_t *pos, uint32_t v, unsigned n)
+{
+    while (n) {
+        unsigned room = 8 - (*pos & 7);
+        unsigned take = n < room ? n : room;
+        uint32_t chunk = (v >> (n - take)) & ((1u << take) - 1);
+        buf[*pos >> 3] |= (uint8_t)(chunk << (room - take));
+        *pos += take;
+        n -= take;
+    }
+}
+
+static bool bits_get(const uint8_t *buf, uint32_t end, uint32_t *pos, unsigned n, uint32_t *v)
+{
+    if (*pos + n > end) {
+        return false;
+    }
+    uint32_t out = 0;
+    for (unsigned i = 0; i < n; i++, (*pos)++) {
+        out = (out << 1) | ((buf[*pos >> 3] >> (7 - (*pos & 7))) & 1u);
+    }
+    *v = out;
+    return true;
+}
+
+/* ── Encoder ────────────────────────────────────────────────────────── */
+
+void history_enc_init(history_enc_t *e, uint8_t boot, uint8_t tolerance)
+{
+    memset(e, 0, sizeof(*e));
+    e->boot = boot;
+    e->tol  = tolerance > HISTORY_TOLERANCE_MAX ? HISTORY_TOLERANCE_MAX : tolerance;
+}
+
+/* Bits left for deltas once the header and c change entries are in */
+static uint32_t enc_bit_room(unsigned changes)
+{
+    return (HISTORY_BLOCK_MAX_BYTES - HISTORY_BLOCK_HDR_BYTES - 4u * changes) * 8u;
+}
+
+bool history_enc_flush(history_enc_t *e, history_block_t *out)
+{
+    if (e->count == 0) {
+        return false;
+    }
+    uint8_t *p = out->data;
+    size_t bytes = (e->bit_len + 7) / 8;
+    size_t len = HISTORY_BLOCK_HDR_BYTES + 4u * e->n_changes + bytes;
+
+    le_put32(&p[4], e->tick0);
+    le_put16(&p[8], e->count);
+    le_put16(&p[10], e->raw0);
+    le_put32(&p[12], (uint32_t)e->ppm_q0);
+    le_put32(&p[16], (uint32_t)e->baseline_q0);
+    p[20] = e->boot;
+    p[21] = e->state0;
+    p[22] = e->event0;
+    p[23] = e->tol;
+    p[24] = e->n_changes;
+    memcpy(&p[HISTORY_BLOCK_HDR_BYTES], e->change, 4u * e->n_changes);
+    memcpy(&p[HISTORY_BLOCK_HDR_BYTES + 4u * e->n_changes], e->bits, bytes);
+    le_put16(&p[0], (uint16_t)len);
+    le_put16(&p[2], history_crc16(&p[4], len - 4));
+    out->len = (uint16_t)len;
+
+    e->count = 0;
+    return true;
+}
+
+bool history_enc_add(history_enc_t *e, const trace_record_t *rec, history_block_t *out)
+{
+    bool valid   = !(rec->state & TRACE_FLAG_INVALID);
+    bool closed  = false;
+
+    if (e->count) {
+        bool change = rec->state != e->state || rec->event != e->event;
+        unsigned changes = e->n_changes + (change ? 1u : 0u);
+        if (e->count >= HISTORY_BLOCK_SAMPLES || rec->tick != e->next_tick
+            || changes > HISTORY_BLOCK_CHANGES || e->bit_len + SAMPLE_BITS_MAX > enc_bit_room(changes)) {
+            closed = history_enc_flush(e, out);
+        }
+    }
+
+    if (e->count == 0) {
+        memset(e->bits, 0, sizeof(e->bits));
+        e->bit_len     = 0;
+        e->n_changes   = 0;
+        e->tick0       = rec->tick;
+        e->raw0        = valid ? rec->raw : 0;
+        e->ppm_q0      = rec->ppm_q;
+        e->baseline_q0 = rec->baseline_q;
+        e->state0      = e->state = rec->state;
+        e->event0      = e->event = rec->event;
+        e->pred_q4     = (int32_t)e->raw0 << 4;
+        e->rice_a      = RICE_A_INIT;
+        e->rice_n      = RICE_N_INIT;
+        e->count       = 1;
+        e->next_tick   = rec->tick + 1;
+        return closed;
+    }
+
+    if (rec->state != e->state || rec->event != e->event) {
+        uint8_t *c = e->change[e->n_changes++];
+        le_put16(c, e->count);
+        c[2] = e->state = rec->state;
+        c[3] = e->event = rec->event;
+    }
+    if (valid) {
+        int32_t  pred = pred_value(e->pred_q4);
+        int32_t  qi   = quantize((int32_t)rec->raw - pred, e->tol);
+        uint32_t u    = zigzag(qi);
+        unsigned k    = rice_k(e->rice_a, e->rice_n);
+        uint32_t q    = u >> k;
+        int32_t  recon;
+        if (q < HISTORY_RICE_ESCAPE) {
+            bits_put(e->bits, &e->bit_len, ((1u << q) - 1) << 1, q + 1);     /* q ones, a zero */
+            bits_put(e->bits, &e->bit_len, u, k);
+            recon = clamp_raw(pred + qi * (2 * (int32_t)e->tol + 1));
+        } else {
+            bits_put(e->bits, &e->bit_len, (1u << HISTORY_RICE_ESCAPE) - 1, HISTORY_RICE_ESCAPE);
+            bits_put(e->bits, &e->bit_len, rec->raw, HISTORY_RAW_BITS);
+            recon = rec->raw;
+        }
+        rice_update(&e->rice_a, &e->rice_n, u);
+        pred_update(&e->pred_q4, recon);
+    }
+    e->count++;
+    e->next_tick = rec->tick + 1;
+    return closed;
+}
+
+int history_block_decode(const uint8_t *blk, size_t len, history_block_info_t *info, history_sample_t *samples)
+{
+    if (len < HISTORY_BLOCK_HDR_BYTES || len > HISTORY_BLOCK_MAX_BYTES) {
+        return -1;
+    }
+    uint16_t count = le_get16(&blk[8]);
+    uint8_t  tol = blk[23];
+    uint8_t  n_changes = blk[24];
+    size_t   changes_end = HISTORY_BLOCK_HDR_BYTES + 4u * n_changes;
+    if (count == 0 || count > HISTORY_BLOCK_SAMPLES || tol > HISTORY_TOLERANCE_MAX
+        || n_changes > HISTORY_BLOCK_CHANGES || changes_end > len) {
+        return -1;
+    }
+    info->tick0       = le_get32(&blk[4]);
+    info->count       = count;
+    info->ppm_q0      = (int32_t)le_get32(&blk[12]);
+    info->baseline_q0 = (int32_t)le_get32(&blk[16]);
+    info->boot        = blk[20];
+    info->tolerance   = tol;
+
+    const uint8_t *bits = &blk[changes_end];
+    uint32_t end = (uint32_t)(len - changes_end) * 8u;
+    uint32_t pos = 0;
+    uint32_t a = RICE_A_INIT, n = RICE_N_INIT;
+    int32_t  raw = le_get16(&blk[10]);
+    int32_t  pred_q4 = raw << 4;
+    uint8_t  state = blk[21], event = blk[22];
+    unsigned next_change = 0;
+
+    for (uint16_t i = 0; i < count; i++) {
+        if (i > 0 && next_change < n_changes && le_get16(&blk[HISTORY_BLOCK_HDR_BYTES + 4u * next_change]) == i) {
+            const uint8_t *c = &blk[HISTORY_BLOCK_HDR_BYTES + 4u * next_change++];
+            state = c[2];
+            event = c[3];
+        }
+        bool valid = !(state & TRACE_FLAG_INVALID);
+        if (i > 0 && valid) {
+            int32_t  pred = pred_value(pred_q4);
+            uint32_t q = 0, bit = 1, u;
+            while (q < HISTORY_RICE_ESCAPE && bits_get(bits, end, &pos, 1, &bit) && bit) {
+                q++;
+            }
+            if (q == HISTORY_RICE_ESCAPE) {
+                uint32_t v;
+                if (!bits_get(bits, end, &pos, HISTORY_RAW_BITS, &v)) {
+                    return -1;
+                }
+                raw = (int32_t)v;
+                u = zigzag(quantize(raw - pred, tol));
+            } else {
+                unsigned k = rice_k(a, n);
+                uint32_t low;
+                if (bit || !bits_get(bits, end, &pos, k, &low)) {
+                    return -1;      /* Ran out of bits */
+                }
+                u = (q << k) | low;
+                int32_t qi = (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+                raw = clamp_raw(pred + qi * (2 * (int32_t)tol + 1));
+            }
+            rice_update(&a, &n, u);
+            pred_update(&pred_q4, raw);
+        }
+        samples[i] = (history_sample_t) {
+            .tick  = info->tick0 + i,
+            .raw   = valid ? (uint16_t)raw : 0,
+            .state = state,
+            .event = event,
+        };
+    }
+    /* Change offsets must all have been consumed in order */
+    return next_change == n_changes ? count : -1;
+}
+
+/* ── Sector store ───────────────────────────────────────────────────── */
+
+typedef struct {
+    uint32_t seq;
+    uint8_t  boot;
+} sector_hdr_t;
+
+static bool sector_hdr_read(const history_flash_t *f, uint32_t sector, sector_hdr_t *hdr)
+{
+    uint8_t h[HISTORY_SECTOR_HDR_BYTES];
+    if (f->read(f->ctx, sector * HISTORY_SECTOR_BYTES, h, sizeof(h)) != ESP_OK
+        || le_get32(&h[0]) != HISTORY_MAGIC || h[8] != HISTORY_VERSION
+        || le_get16(&h[14]) != history_crc16(h, 14)) {
+        return false;
+    }
+    hdr->seq  = le_get32(&h[4]);
+    hdr->boot = h[10];
+    return true;
+}
+
+typedef enum {
+    BLOCK_OK,
+    BLOCK_END,          /* Erased length: nothing committed from here */
+    BLOCK_BAD_CRC,      /* Plausible length, corrupt contents */
+    BLOCK_TORN,         /* Implausible length: the chain cannot be followed */
+} block_read_t;
+
+static block_read_t block_read(const history_flash_t *f, uint32_t sector, uint32_t off, uint8_t *blk, uint16_t *len)
+{
+    uint32_t base = sector * HISTORY_SECTOR_BYTES;
+    if (off + 2 > HISTORY_SECTOR_BYTES || f->read(f->ctx, base + off, blk, 2) != ESP_OK) {
+        return BLOCK_TORN;
+    }
+    *len = le_get16(blk);
+    if (*len == HISTORY_LEN_ERASED) {
+        return BLOCK_END;
+    }
+    if (*len < HISTORY_BLOCK_HDR_BYTES || *len > HISTORY_BLOCK_MAX_BYTES || off + *len > HISTORY_SECTOR_BYTES
+        || f->read(f->ctx, base + off + 2, blk + 2, *len - 2u) != ESP_OK) {
+        return BLOCK_TORN;
+    }
+    return le_get16(&blk[2]) == history_crc16(&blk[4], *len - 4u) ? BLOCK_OK : BLOCK_BAD_CRC;
+}
+
+static bool range_erased(const history_flash_t *f, uint32_t off, uint32_t len)
+{
+    uint8_t buf[64];
+    while (len) {
+        uint32_t n = len < sizeof(buf) ? len : sizeof(buf);
+        if (f->read(f->ctx, off, buf, n) != ESP_OK) {
+            return false;
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            if (buf[i] != 0xFF) {
+                return false;
+            }
+        }
+        off += n;
+        len -= n;
+    }
+    return true;
+}
+
+static uint8_t s_scan_blk[HISTORY_BLOCK_MAX_BYTES];    /* Writer task / reader only */
+
+esp_err_t history_store_open(history_store_t *s, const history_flash_t *flash, uint8_t interval_ds)
+{
+    ESP_RETURN_ON_FALSE(flash->size % HISTORY_SECTOR_BYTES == 0 && flash->size >= 2 * HISTORY_SECTOR_BYTES,
+                        ESP_ERR_INVALID_SIZE, TAG, "History partition must be ≥ 2 whole sectors");
+    memset(s, 0, sizeof(*s));
+    s->flash       = *flash;
+    s->sectors     = flash->size / HISTORY_SECTOR_BYTES;
+    s->interval_ds = interval_ds;
+    s->sector      = s->sectors - 1;    /* First append opens sector 0 */
+
+    bool found = false;
+    sector_hdr_t newest = {0};
+    for (uint32_t i = 0; i < s->sectors; i++) {
+        sector_hdr_t h;
+        if (sector_hdr_read(flash, i, &h) && (!found || (int32_t)(h.seq - newest.seq) > 0)) {
+            newest = h;
+            s->sector = i;
+            found = true;
+        }
+    }
+    if (!found) {
+        return ESP_OK;
+    }
+
+    /* Walk the newest sector to its end; append there only if the rest is untouched */
+    s->seq = newest.seq;
+    uint8_t last_boot = newest.boot;
+    uint32_t off = HISTORY_SECTOR_HDR_BYTES;
+    uint16_t len;
+    block_read_t r;
+    while ((r = block_read(flash, s->sector, off, s_scan_blk, &len)) == BLOCK_OK) {
+        last_boot = s_scan_blk[20];
+        off += len;
+    }
+    uint32_t base = s->sector * HISTORY_SECTOR_BYTES;
+    if (r == BLOCK_END && range_erased(flash, base + off, HISTORY_SECTOR_BYTES - off)) {
+        s->offset = off;
+    }
+    s->boot = (uint8_t)(last_boot + 1);
+    return ESP_OK;
+}
+
+static esp_err_t store_next_sector(history_store_t *s)
+{
+    history_flash_t *f = &s->flash;
+    uint32_t sector = (s->sector + 1) % s->sectors;
+    uint32_t base = sector * HISTORY_SECTOR_BYTES;
+    uint8_t h[HISTORY_SECTOR_HDR_BYTES];
+
+    s->offset = 0;
+    ESP_RETURN_ON_ERROR(f->erase(f->ctx, base, HISTORY_SECTOR_BYTES), TAG, "Erasing sector %lu failed",
+                        (unsigned long)sector);
+    s->erases++;
+    s->sector = sector;
+    s->seq++;
+    memset(h, 0xFF, sizeof(h));
+    le_put32(&h[0], HISTORY_MAGIC);
+    le_put32(&h[4], s->seq);
+    h[8]  = HISTORY_VERSION;
+    h[9]  = s->interval_ds;
+    h[10] = s->boot;
+    le_put16(&h[14], history_crc16(h, 14));
+    ESP_RETURN_ON_ERROR(f->write(f->ctx, base, h, sizeof(h)), TAG, "Writing sector header failed");
+    s->offset = HISTORY_SECTOR_HDR_BYTES;
+    return ESP_OK;
+}
+
+esp_err_t history_store_append(history_store_t *s, const history_block_t *blk)
+{
+    if (s->offset == 0 || s->offset + blk->len > HISTORY_SECTOR_BYTES) {
+        ESP_RETURN_ON_ERROR(store_next_sector(s), TAG, "Opening next sector failed");
+    }
+    history_flash_t *f = &s->flash;
+    uint32_t at = s->sector * HISTORY_SECTOR_BYTES + s->offset;
+
+    /* Body first, length last: an interrupted write leaves the length erased */
+    s->offset += blk->len;
+    esp_err_t err = f->write(f->ctx, at + 2, &blk->data[2], blk->len - 2u);
+    if (err == ESP_OK) {
+        err = f->write(f->ctx, at, blk->data, 2);
+    }
+    if (err != ESP_OK) {
+        s->offset = 0;      /* Do not append after a half-written block */
+        return err;
+    }
+    s->blocks++;
+    return ESP_OK;
+}
+
+/* ── Reader ─────────────────────────────────────────────────────────── */
+
+typedef struct {
+    uint32_t seq;
+    uint32_t sector;
+} sector_ref_t;
+
+static int sector_ref_cmp(const void *a, const void *b)
+{
+    int32_t d = (int32_t)(((const sector_ref_t *)a)->seq - ((const sector_ref_t *)b)->seq);
+    return (d > 0) - (d < 0);
+}
+
+esp_err_t history_read(const history_flash_t *flash, history_block_cb_t cb, void *ctx, history_read_stats_t *st)
+{
+    ESP_RETURN_ON_FALSE(flash->size % HISTORY_SECTOR_BYTES == 0, ESP_ERR_INVALID_SIZE, TAG,
+                        "Image is not a whole number of sectors");
+    uint32_t sectors = flash->size / HISTORY_SECTOR_BYTES;
+    sector_ref_t *order = malloc(sectors * sizeof(*order) + 1);
+    history_sample_t *samples = malloc(HISTORY_BLOCK_SAMPLES * sizeof(*samples));
+    if (!order || !samples) {
+        free(order);
+        free(samples);
+        return ESP_ERR_NO_MEM;
+    }
+
+    memset(st, 0, sizeof(*st));
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < sectors; i++) {
+        sector_hdr_t h;
+        if (sector_hdr_read(flash, i, &h)) {
+            order[n++] = (sector_ref_t) { .seq = h.seq, .sector = i };
+        }
+    }
+    qsort(order, n, sizeof(*order), sector_ref_cmp);
+    st->sectors = n;
+
+    bool have_boot = false;
+    uint8_t boot = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t off = HISTORY_SECTOR_HDR_BYTES;
+        uint16_t len;
+        block_read_t r;
+        st->bytes_used += HISTORY_SECTOR_HDR_BYTES;
+        while ((r = block_read(flash, order[i].sector, off, s_scan_blk, &len)) != BLOCK_END) {
+            if (r == BLOCK_TORN) {
+                st->torn_sectors++;
+                break;
+            }
+            off += len;
+            st->bytes_used += len;
+            history_block_info_t info;
+            int count = r == BLOCK_OK ? history_block_decode(s_scan_blk, len, &info, samples) : -1;
+            if (count < 0) {
+                st->bad_blocks++;
+                continue;
+            }
+            info.sector_seq = order[i].seq;
+            if (have_boot && info.boot != boot) {
+                st->boots++;
+            }
+            have_boot = true;
+            boot = info.boot;
+            st->blocks++;
+            st->samples += (uint64_t)count;
+            cb(ctx, &info, samples);
+        }
+    }
+    free(order);
+    free(samples);
+    return ESP_OK;
+}
+
+/* ── Firmware: partition glue and writer task ───────────────────────── */
+
+#if CONFIG_LITTERBOX_HISTORY_LOG
+
+static history_store_t s_store;
+static history_enc_t   s_enc;       /* Sample path only */
+static history_block_t s_closed;    /* Sample path staging copy */
+static history_block_t s_pending;   /* Writer task copy */
+static QueueHandle_t   s_queue;
+static uint32_t        s_dropped;   /* Blocks lost to a full queue (sample path) */
+
+static esp_err_t part_read(void *ctx, uint32_t off, void *dst, size_t len)
+{
+    return esp_partition_read((const esp_partition_t *)ctx, off, dst, len);
+}
+
+static esp_err_t part_write(void *ctx, uint32_t off, const void *src, size_t len)
+{
+    return esp_partition_write((const esp_partition_t *)ctx, off, src, len);
+}
+
+static esp_err_t part_erase(void *ctx, uint32_t off, size_t len)
+{
+    return esp_partition_erase_range((const esp_partition_t *)ctx, off, len);
+}
+
+static void history_writer_task(void *arg)
+{
+    for (;;) {
+        if (xQueueReceive(s_queue, &s_pending, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        esp_err_t err = history_store_append(&s_store, &s_pending);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Block of %u bytes not written (%s)", s_pending.len, esp_err_to_name(err));
+        }
+    }
+}
+
+esp_err_t history_log_init(uint32_t interval_ms)
+{
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, HISTORY_PARTITION_SUBTYPE,
+                                                           HISTORY_PARTITION_LABEL);
+    ESP_RETURN_ON_FALSE(part, ESP_ERR_NOT_FOUND, TAG, "No \"%s\" partition", HISTORY_PARTITION_LABEL);
+
+    history_flash_t flash = {
+        .ctx   = (void *)part,
+        .size  = part->size - part->size % HISTORY_SECTOR_BYTES,
+        .read  = part_read,
+        .write = part_write,
+        .erase = part_erase,
+    };
+    ESP_RETURN_ON_ERROR(history_store_open(&s_store, &flash, (uint8_t)(interval_ms / 100)), TAG,
+                        "Opening history failed");
+    history_enc_init(&s_enc, s_store.boot, CONFIG_LITTERBOX_HISTORY_TOLERANCE);
+
+    s_queue = xQueueCreate(HISTORY_QUEUE_LEN, sizeof(history_block_t));
+    ESP_RETURN_ON_FALSE(s_queue, ESP_ERR_NO_MEM, TAG, "Failed to create block queue");
+    ESP_RETURN_ON_FALSE(xTaskCreate(history_writer_task, "history_wr", HISTORY_WRITER_STACK, NULL,
+                                    HISTORY_WRITER_PRIORITY, NULL) == pdPASS,
+                        ESP_ERR_NO_MEM, TAG, "Failed to create writer task");
+    ESP_LOGI(TAG, "History log: %lu KB at 0x%lx, boot %u, %s sector %lu (seq %lu)",
+             (unsigned long)(flash.size / 1024), (unsigned long)part->address, s_store.boot,
+             s_store.offset ? "continuing" : "after", (unsigned long)s_store.sector, (unsigned long)s_store.seq);
+    return ESP_OK;
+}
+
+void history_log_write(const trace_record_t *rec)
+{
+    if (!s_queue || !history_enc_add(&s_enc, rec, &s_closed)) {
+        return;
+    }
+    /* Never wait for flash here: the writer may be mid-erase */
+    if (xQueueSend(s_queue, &s_closed, 0) != pdTRUE && (++s_dropped & (s_dropped - 1)) == 0) {
+        ESP_LOGW(TAG, "%lu history block(s) dropped — writer behind", (unsigned long)s_dropped);
+    }
+}
+
+#endif /* CONFIG_LITTERBOX_HISTORY_LOG */
@@ -0,0 +1,252 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * history_log.h — Long-term raw sample history in flash (CONFIG_LITTERBOX_HISTORY_LOG)
+ *
+ * Every 2 s sample (raw ADC, detector state, event) is compressed into
+ * blocks and appended to the "history" data partition, a circular log of
+ * 4 KB sectors. Each sector is erased once per pass over the partition, so
+ * wear is spread evenly with no mapping table; at the default size a pass
+ * takes over a month. The partition is dumped over serial
+ * (history_dump.ps1) and decoded on the host (host/common/history_reader.h).
+ *
+ * Sector (HISTORY_SECTOR_BYTES, little-endian):
+ *   0  u32  HISTORY_MAGIC
+ *   4  u32  sequence number (+1 per sector opened; the highest is the newest)
+ *   8  u8   HISTORY_VERSION
+ *   9  u8   sample interval, 100 ms units
+ *  10  u8   boot number of the writer that opened it
+ *  11  u8[3] reserved (0xFF)
+ *  14  u16  CRC-16 over bytes 0..13
+ *  16  blocks, back to back, until a length of 0xFFFF (erased)
+ *
+ * Block (at most HISTORY_BLOCK_MAX_BYTES):
+ *   0  u16  length of the whole block (written last: 0xFFFF = not committed)
+ *   2  u16  CRC-16 over bytes 4..length−1
+ *   4  u32  tick of the first sample (sample index since boot)
+ *   8  u16  sample count n (consecutive ticks)
+ *  10  u16  raw ADC of the first sample (exact)
+ *  12  i32  ppm_q of the first sample, Q15.16 (calibration check, see below)
+ *  16  i32  detector baseline after the first sample, Q15.16
+ *  20  u8   boot number (+1 per boot, wraps)
+ *  21  u8   state of the first sample (trace_record_t.state: detector state | TRACE_FLAG_*)
+ *  22  u8   event of the first sample
+ *  23  u8   raw tolerance t (0 = lossless)
+ *  24  u8   change count c
+ *  25  c ×  { u16 sample offset, u8 state, u8 event } — state/event from that sample on
+ *      ...  raw of samples 1..n−1, adaptive Rice code (below), MSB first,
+ *           zero-padded to a byte
+ *
+ * Each raw value is predicted by the mean of the previous ~8 (decoded)
+ * values; the residual is quantized in steps of 2t+1 (JPEG-LS near-lossless,
+ * so every decoded raw is within t of the real one), zigzag-mapped and
+ * Rice-coded with k derived from the running mean magnitude
+ * (k = min{k : N·2^k ≥ A}), which follows an event's steep edges within a
+ * few samples. A quotient of HISTORY_RICE_ESCAPE or more is sent as the
+ * escape prefix plus the exact 16-bit raw value. Samples flagged
+ * TRACE_FLAG_INVALID carry no code (they decode as raw 0).
+ *
+ * Sizing: the MQ-135 baseline moves ~17 ADC codes (1σ) tick to tick, which
+ * costs ~7 bits per sample even losslessly coded. The default t = 3 codes
+ * (≈0.05 ppm at a 5 ppm baseline, a sixth of the sensor noise) brings it to
+ * ~4.2 bits, i.e. 30+ days in the 768 KB partition.
+ *
+ * ppm is not stored per sample: the driver's conversion is a fixed function
+ * of raw (LUT or float curve with the compiled-in R0). The block keeps the
+ * first sample's ppm so the reader can tell whether the log was written
+ * with the R0 it converts with.
+ *
+ * A block closes after HISTORY_BLOCK_SAMPLES samples (~17 min), on a tick
+ * gap, or when its changes or bits would overflow. A power cut loses the
+ * open block only. Committing the length last makes a torn write read as
+ * the end of the sector; the next boot then opens a new sector instead of
+ * appending after it.
+ *
+ * The encoder, sector store and reader are platform-independent and work
+ * through history_flash_t, so host/bench/history_bench.c runs them on a
+ * simulated NOR flash. history_log_init()/history_log_write() exist only in
+ * firmware builds with CONFIG_LITTERBOX_HISTORY_LOG: the sample path only
+ * encodes into RAM; a low-priority task does the flash erases and writes.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "trace_log.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Default for builds without sdkconfig (host); see Kconfig.projbuild */
+#ifndef CONFIG_LITTERBOX_HISTORY_TOLERANCE
+#define CONFIG_LITTERBOX_HISTORY_TOLERANCE  3
+#endif
+
+#define HISTORY_PARTITION_LABEL     "history"
+#define HISTORY_PARTITION_SUBTYPE   0x40        /* Custom data subtype (partitions.csv) */
+#define HISTORY_MAGIC               0x3148424Cu /* "LBH1" */
+#define HISTORY_VERSION             1
+#define HISTORY_SECTOR_BYTES        4096
+#define HISTORY_SECTOR_HDR_BYTES    16
+#define HISTORY_BLOCK_HDR_BYTES     25
+#define HISTORY_BLOCK_MAX_BYTES     512
+#define HISTORY_BLOCK_SAMPLES       512         /* ~17 min at 2 s */
+#define HISTORY_BLOCK_CHANGES       24
+#define HISTORY_RICE_ESCAPE         20          /* Unary prefix length that means "raw value follows" */
+#define HISTORY_RAW_BITS            16
+#define HISTORY_LEN_ERASED          0xFFFF
+#define HISTORY_TOLERANCE_MAX       15
+
+#define HISTORY_QUEUE_LEN           2           /* Closed blocks waiting for the writer */
+#define HISTORY_WRITER_STACK        3072
+#define HISTORY_WRITER_PRIORITY     1           /* Just above idle */
+
+/* Flash access (esp_partition_* in firmware; a file or RAM image on the host) */
+typedef struct {
+    void     *ctx;
+    uint32_t  size;             /* Bytes, a multiple of HISTORY_SECTOR_BYTES */
+    esp_err_t (*read)(void *ctx, uint32_t off, void *dst, size_t len);
+    esp_err_t (*write)(void *ctx, uint32_t off, const void *src, size_t len);
+    esp_err_t (*erase)(void *ctx, uint32_t off, size_t len);   /* Whole sectors */
+} history_flash_t;
+
+/* One closed block, ready to append */
+typedef struct {
+    uint8_t  data[HISTORY_BLOCK_MAX_BYTES];
+    uint16_t len;
+} history_block_t;
+
+/* Block being filled (sample path) */
+typedef struct {
+    uint8_t  bits[HISTORY_BLOCK_MAX_BYTES - HISTORY_BLOCK_HDR_BYTES];
+    uint32_t bit_len;
+    uint8_t  change[HISTORY_BLOCK_CHANGES][4];
+    uint8_t  n_changes;
+    uint16_t count;             /* 0 = no open block */
+    uint32_t tick0;
+    uint32_t next_tick;
+    uint16_t raw0;
+    int32_t  ppm_q0;
+    int32_t  baseline_q0;
+    uint8_t  state0, event0;
+    uint8_t  state, event;      /* Of the last sample added */
+    int32_t  pred_q4;           /* Predictor state (mean of reconstructed raw), Q4 */
+    uint8_t  tol;               /* Max |decoded − raw| */
+    uint32_t rice_a, rice_n;    /* Running |delta| sum and count */
+    uint8_t  boot;
+} history_enc_t;
+
+/* Sector store (writer side) */
+typedef struct {
+    history_flash_t flash;
+    uint32_t sectors;
+    uint32_t sector;            /* Sector being filled */
+    uint32_t offset;            /* Next block offset in it, 0 = none open */
+    uint32_t seq;               /* Its sequence number */
+    uint8_t  boot;              /* Boot number for new blocks */
+    uint8_t  interval_ds;
+    uint32_t erases;
+    uint32_t blocks;
+} history_store_t;
+
+/* Decoded block header, handed to the reader callback with its samples */
+typedef struct {
+    uint32_t tick0;
+    uint16_t count;
+    uint8_t  boot;
+    uint32_t sector_seq;
+    int32_t  ppm_q0;
+    int32_t  baseline_q0;
+    uint8_t  tolerance;
+} history_block_info_t;
+
+typedef struct {
+    uint32_t tick;
+    uint16_t raw;               /* 0 if TRACE_FLAG_INVALID */
+    uint8_t  state;             /* detector_state_t | TRACE_FLAG_* */
+    uint8_t  event;
+} history_sample_t;
+
+/* Called once per decoded block; samples[0..info->count) */
+typedef void (*history_block_cb_t)(void *ctx, const history_block_info_t *info, const history_sample_t *samples);
+
+typedef struct {
+    uint32_t sectors;           /* Sectors with a valid header */
+    uint32_t blocks;
+    uint32_t bad_blocks;        /* CRC or decode failures, skipped */
+    uint32_t torn_sectors;      /* Sectors whose block chain ended in garbage */
+    uint64_t samples;
+    uint32_t boots;             /* Boot number changes seen, oldest to newest */
+    uint32_t bytes_used;        /* Sector headers + committed blocks */
+} history_read_stats_t;
+
+uint16_t history_crc16(const uint8_t *data, size_t len);
+
+/* ── Encoder ── */
+
+/**
+ * @param tolerance  Max raw ADC error per sample, 0 = lossless (≤ HISTORY_TOLERANCE_MAX)
+ */
+void history_enc_init(history_enc_t *e, uint8_t boot, uint8_t tolerance);
+
+/**
+ * @brief Add one sample. If it does not fit the open block (full, tick gap,
+ *        too many changes), that block is closed into *out first.
+ * @return true if *out holds a closed block
+ */
+bool history_enc_add(history_enc_t *e, const trace_record_t *rec, history_block_t *out);
+
+/**
+ * @brief Close the open block, if any.
+ * @return true if *out holds a closed block
+ */
+bool history_enc_flush(history_enc_t *e, history_block_t *out);
+
+/**
+ * @brief Decode one block (length and CRC already checked by the caller or not).
+ * @param samples  At least HISTORY_BLOCK_SAMPLES entries
+ * @return Sample count, or −1 if malformed
+ */
+int history_block_decode(const uint8_t *blk, size_t len, history_block_info_t *info, history_sample_t *samples);
+
+/* ── Sector store ── */
+
+/**
+ * @brief Find the newest sector and the append position after it.
+ *        Continues in that sector if its tail is clean, else the next
+ *        append opens a new one. The boot number follows the newest block's.
+ */
+esp_err_t history_store_open(history_store_t *s, const history_flash_t *flash, uint8_t interval_ds);
+
+/**
+ * @brief Append a closed block, opening (erasing) the next sector if it does not fit.
+ */
+esp_err_t history_store_append(history_store_t *s, const history_block_t *blk);
+
+/* ── Reader ── */
+
+/**
+ * @brief Decode every committed block, oldest first.
+ */
+esp_err_t history_read(const history_flash_t *flash, history_block_cb_t cb, void *ctx, history_read_stats_t *st);
+
+/* ── Firmware ── */
+
+/**
+ * @brief Open the history partition and start the writer task.
+ */
+esp_err_t history_log_init(uint32_t interval_ms);
+
+/**
+ * @brief Record one sample (sample path; encodes into RAM, never waits for flash).
+ */
+void history_log_write(const trace_record_t *rec);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,37 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * le_bytes.h — Little-endian field access for the wire and storage formats
+ *
+ * ZCL payloads, the journal/snippet/usage records, trace frames and the
+ * flash history are all little-endian. The put helpers return the byte
+ * after the field, so a record can be written as a chain of calls.
+ * Byte-wise, so alignment and host byte order do not matter.
+ */
+#pragma once
+
+#include <stdint.h>
+
+static inline uint8_t *le_put16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    return p + 2;
+}
+
+static inline uint8_t *le_put32(uint8_t *p, uint32_t v)
+{
+    return le_put16(le_put16(p, (uint16_t)v), (uint16_t)(v >> 16));
+}
+
+static inline uint16_t le_get16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t le_get32(const uint8_t *p)
+{
+    return le_get16(p) | ((uint32_t)le_get16(p + 2) << 16);
+}
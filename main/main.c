@@ -7,15 +7,35 @@
  *
  * Based on ESP Zigbee HA_temperature_sensor example.
  * Clusters: Custom NH₃ Concentration (0xFC00) + On/Off (0x0006)
+ *           (+ Diagnostics 0xFC01 with CONFIG_LITTERBOX_STAGE_STATS)
  * Custom manufacturer-specific cluster reports NH₃ ppm as uint16 directly.
+ * One endpoint (1, 2, …) with its own 0xFC00 cluster per MQ-135 channel
+ * (CONFIG_LITTERBOX_SENSOR_CHANNELS); Diagnostics and On/Off on endpoint 1 only.
  */
 #include "main.h"
+#include "detector_persist.h"
+#include "event_journal.h"
+#include "event_snippet.h"
+#include "history_log.h"
+#include "report_mgr.h"
+#include "report_policy.h"
+#include "sample_block.h"
+#include "sample_queue.h"
+#include "spike_filter.h"
+#include "stage_stats.h"
+#include "trace_log.h"
+#include "usage_stats.h"
+#include "zcl_reporting.h"
 #include "esp_check.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "ha/esp_zigbee_ha_standard.h"
+#include "zboss_api.h"
+#include <stdio.h>
+#include <string.h>
 
 #if !defined ZB_ED_ROLE
 #error Define ZB_ED_ROLE in idf.py menuconfig to compile light (End Device) source code.
@@ -23,23 +43,221 @@
 
 static const char *TAG = "LITTERBOX";
 
-/* Event detection state — persists across timer callbacks */
-static event_detector_t g_detector;
-static litter_event_t   g_last_reported_event = LITTER_EVENT_NONE;
-static uint8_t          g_sample_tick = 0;  /* Counts 2s samples; report every SENSOR_REPORT_TICKS */
+/* Per sensor channel and its endpoint (CONFIG_LITTERBOX_SENSOR_CHANNELS) */
+typedef struct {
+    uint8_t             index;              /* Sensor channel, sample_msg_t.channel */
+    uint8_t             endpoint;           /* HA_LITTERBOX_ENDPOINT + index */
+
+    /* Event detection state — owned by the sampling context (sensor task, or Zigbee task without it) */
+    event_detector_t    detector;
+#if CONFIG_LITTERBOX_SPIKE_FILTER
+    spike_filter_t      spike_filter;
+#endif
+#if CONFIG_LITTERBOX_BASELINE_PERSIST
+    detector_persist_t  persist;
+#endif
+
+    /* Reporting state — Zigbee task */
+    litter_event_t      last_reported_event;
+    report_policy_t     nh3_policy;
+    report_policy_t     event_policy;
+    report_mgr_t        report_mgr;
+#if CONFIG_LITTERBOX_SAMPLE_BLOCK
+    sample_block_t      block;
+    uint8_t             block_attr[1 + SAMPLE_BLOCK_MAX_BYTES];     /* ZCL octet string: length + block */
+#endif
+#if CONFIG_LITTERBOX_EVENT_JOURNAL
+    event_journal_t     journal;
+    uint8_t             journal_attr[1 + EVENT_JOURNAL_MAX_BYTES];  /* ZCL octet string: length + record */
+    uint32_t            journal_retry_at_ms;    /* Record given up on by report_mgr: rebuilt after this */
+    uint8_t             journal_prev_event;     /* msg->event of the previous sample */
+#endif
+#if CONFIG_LITTERBOX_EVENT_SNIPPET
+    event_snippet_t     snippet;
+    uint8_t             snippet_attr[1 + EVENT_SNIPPET_INFO_BYTES]; /* ZCL octet string: length + info record */
+#endif
+#if CONFIG_LITTERBOX_PROVISIONAL_EVENT
+    uint16_t            provisional_val;        /* Last 0x0007 value: type | confidence << 8 */
+    uint8_t             provisional_type;       /* ... its type, kept for the confirmed/corrected log */
+#endif
+#if CONFIG_LITTERBOX_USAGE_STATS
+    usage_stats_t       usage_stats;
+    uint8_t             usage_24h_attr[1 + USAGE_STATS_24H_BYTES];  /* ZCL octet string: length + record */
+    uint8_t             usage_days_attr[1 + USAGE_STATS_DAYS_MAX_BYTES];
+    uint8_t             usage_prev_event;       /* msg->event of the previous sample */
+#endif
+} litterbox_channel_t;
+
+static litterbox_channel_t g_channels[AIR_SENSOR_CHANNELS];
+static uint32_t         g_sample_seq  = 0;  /* Sample ticks since sampling started (sample_msg_t.tick) */
+static int64_t          g_last_sample_us = 0;
+
+/* Reporting configuration of cluster 0xFC00, set by the hub (zcl_reporting.h) — Zigbee task */
+enum { REPORTING_NH3, REPORTING_EVENT, REPORTING_BLOCK };
+static zcl_report_attr_t g_reporting[] = {
+    [REPORTING_NH3]   = { NH3_ATTR_MEASURED_VALUE_ID, ZCL_TYPE_U16, true, CONFIG_LITTERBOX_REPORT_MIN_S,
+                          CONFIG_LITTERBOX_REPORT_MAX_S, CONFIG_LITTERBOX_REPORT_CHANGE_PPM },
+    [REPORTING_EVENT] = { NH3_ATTR_EVENT_TYPE_ID, ZCL_TYPE_U8, true, EVENT_REPORT_MIN_S,
+                          EVENT_REPORT_MAX_S, EVENT_REPORT_CHANGE },
+#if CONFIG_LITTERBOX_SAMPLE_BLOCK
+    /* min interval = block period; max 0xFFFF = off, any other max is ignored */
+    [REPORTING_BLOCK] = { NH3_ATTR_SAMPLE_BLOCK_ID, ZCL_TYPE_OCTET_STR, true, CONFIG_LITTERBOX_SAMPLE_BLOCK_S,
+                          0, 0 },
+#endif
+    { NH3_ATTR_MIN_MEASURED_VALUE_ID, ZCL_TYPE_U16, false, 0, 0, 0 },
+    { NH3_ATTR_MAX_MEASURED_VALUE_ID, ZCL_TYPE_U16, false, 0, 0, 0 },
+};
+#define REPORTING_NUM   (sizeof(g_reporting) / sizeof(g_reporting[0]))
+
+/* Reported attributes of cluster 0xFC00, coalesced into one frame per tick and endpoint (report_mgr.h) — Zigbee task */
+enum { RPT_ATTR_NH3, RPT_ATTR_EVENT, RPT_ATTR_BLOCK, RPT_ATTR_JOURNAL, RPT_ATTR_SNIPPET, RPT_ATTR_PROVISIONAL,
+       RPT_ATTR_NUM };
+static const report_mgr_attr_cfg_t g_report_attrs[RPT_ATTR_NUM] = {
+    [RPT_ATTR_NH3]     = { NH3_ATTR_MEASURED_VALUE_ID, ZCL_TYPE_U16,       false },
+    [RPT_ATTR_EVENT]   = { NH3_ATTR_EVENT_TYPE_ID,     ZCL_TYPE_U8,        true  },  /* Every transition, in order */
+    [RPT_ATTR_BLOCK]   = { NH3_ATTR_SAMPLE_BLOCK_ID,   ZCL_TYPE_OCTET_STR, false },
+    [RPT_ATTR_JOURNAL] = { NH3_ATTR_EVENT_JOURNAL_ID,  ZCL_TYPE_OCTET_STR, false },  /* Kept by event_journal until acked */
+    [RPT_ATTR_SNIPPET] = { NH3_ATTR_SNIPPET_INFO_ID,   ZCL_TYPE_OCTET_STR, false },  /* Snippet fetched on demand */
+    [RPT_ATTR_PROVISIONAL] = { NH3_ATTR_PROVISIONAL_EVENT_ID, ZCL_TYPE_U16,  true  },  /* Early type, then its clear */
+};
+#if CONFIG_LITTERBOX_SENSOR_TASK
+static sample_queue_t   g_sample_queue;
+#endif
+#if CONFIG_LITTERBOX_STAGE_STATS
+static uint32_t         g_diag_attr[STAGE_COUNT][DIAG_KIND_NUM];   /* Backing storage for 0xFC01 */
+#endif
+
+/********************* Reporting configuration *******************/
+
+/* Copy g_reporting into every channel's report policies. Their timing state
+ * is kept, so a new configuration takes effect from the last report. The
+ * configuration is one per device, whichever endpoint it was sent to. */
+static void reporting_apply(void)
+{
+    const zcl_report_attr_t *nh3 = &g_reporting[REPORTING_NH3];
+    const zcl_report_attr_t *evt = &g_reporting[REPORTING_EVENT];
+    for (int i = 0; i < AIR_SENSOR_CHANNELS; i++) {
+        litterbox_channel_t *ch = &g_channels[i];
+        ch->nh3_policy.cfg.min_interval_s    = nh3->min_interval_s;
+        ch->nh3_policy.cfg.max_interval_s    = nh3->max_interval_s;
+        ch->nh3_policy.cfg.reportable_change = nh3->reportable_change;
+        /* The hub configures the idle pair; the ACTIVE pair stays from Kconfig unless reporting is off */
+        ch->nh3_policy.cfg.active_max_interval_s = nh3->max_interval_s == ZCL_REPORT_MAX_OFF
+                                                 ? REPORT_POLICY_MAX_OFF : CONFIG_LITTERBOX_REPORT_ACTIVE_MAX_S;
+
+        ch->event_policy.cfg = (report_policy_cfg_t) {
+            .min_interval_s        = evt->min_interval_s,
+            .max_interval_s        = evt->max_interval_s,
+            .reportable_change     = evt->reportable_change,
+            .active_min_interval_s = evt->min_interval_s,   /* Event policy is always evaluated as idle */
+            .active_max_interval_s = evt->max_interval_s,
+        };
+    }
+}
+
+/* Channel served by a 0xFC00 endpoint, NULL if none */
+static litterbox_channel_t *channel_for_endpoint(uint8_t endpoint)
+{
+    unsigned i = (unsigned)(endpoint - HA_LITTERBOX_ENDPOINT);
+    return i < AIR_SENSOR_CHANNELS ? &g_channels[i] : NULL;
+}
 
 /********************* Deferred driver init **********************/
 
+#define CHANNEL_NVS_RECORDS (CONFIG_LITTERBOX_EVENT_JOURNAL || CONFIG_LITTERBOX_USAGE_STATS \
+                             || CONFIG_LITTERBOX_BASELINE_PERSIST)
+
+#if CHANNEL_NVS_RECORDS
+/* NVS key of a per-channel record: channel 0 keeps the single-sensor key, so
+ * its saved state carries over; the others append their number */
+static const char *channel_nvs_key(const char *base, int index, char key[NVS_KEY_NAME_MAX_SIZE])
+{
+    if (index == 0) {
+        return base;
+    }
+    snprintf(key, NVS_KEY_NAME_MAX_SIZE, "%s%d", base, index);
+    return key;
+}
+#endif
+
+/* Detector, reporting and record state of one channel (its attribute
+ * storage is registered by custom_litterbox_clusters_create()) */
+static void channel_init(litterbox_channel_t *ch, int index, const report_policy_cfg_t *report_cfg)
+{
+#if CHANNEL_NVS_RECORDS
+    char key[NVS_KEY_NAME_MAX_SIZE];
+#endif
+
+    ch->index    = (uint8_t)index;
+    ch->endpoint = (uint8_t)(HA_LITTERBOX_ENDPOINT + index);
+    event_detector_init(&ch->detector);
+#if CONFIG_LITTERBOX_SPIKE_FILTER
+    ESP_ERROR_CHECK(spike_filter_init(&ch->spike_filter, CONFIG_LITTERBOX_SPIKE_FILTER_WINDOW, SPIKE_FILTER_K_TENTHS,
+                                      (int32_t)SPIKE_FILTER_MIN_DEV_PPM << EVENT_PPM_Q_SHIFT));
+#endif
+    ch->last_reported_event = LITTER_EVENT_NONE;
+    report_policy_init(&ch->nh3_policy, report_cfg);
+    report_policy_init(&ch->event_policy, report_cfg);
+    report_mgr_init(&ch->report_mgr, g_report_attrs, RPT_ATTR_NUM);
+#if CONFIG_LITTERBOX_SAMPLE_BLOCK
+    sample_block_init(&ch->block, SENSOR_SAMPLE_INTERVAL_MS);
+#endif
+#if CONFIG_LITTERBOX_EVENT_JOURNAL
+    ch->journal_prev_event = LITTER_EVENT_NONE;
+    if (event_journal_open(&ch->journal, channel_nvs_key(EVENT_JOURNAL_KEY, index, key)) != ESP_OK) {
+        ESP_LOGW(TAG, "ep%u: event journal not persistent — undelivered events are lost on reboot", ch->endpoint);
+    }
+#endif
+#if CONFIG_LITTERBOX_EVENT_SNIPPET
+    event_snippet_init(&ch->snippet, SENSOR_SAMPLE_INTERVAL_MS);
+#endif
+#if CONFIG_LITTERBOX_USAGE_STATS
+    ch->usage_prev_event = LITTER_EVENT_NONE;
+    if (usage_stats_open(&ch->usage_stats, channel_nvs_key(USAGE_STATS_KEY, index, key)) != ESP_OK) {
+        ESP_LOGW(TAG, "ep%u: usage statistics not persistent — restart from zero on reboot", ch->endpoint);
+    }
+#endif
+#if CONFIG_LITTERBOX_BASELINE_PERSIST
+    if (detector_persist_init(&ch->persist, channel_nvs_key(DETECTOR_PERSIST_KEY, index, key)) != ESP_OK) {
+        ESP_LOGW(TAG, "ep%u: baseline persistence unavailable — cold start on every boot", ch->endpoint);
+    }
+#endif
+}
+
 static esp_err_t deferred_driver_init(void)
 {
     static bool is_inited = false;
     if (!is_inited) {
         light_driver_init(LIGHT_DEFAULT_OFF);
         esp_err_t ret = air_sensor_init();
+        if (ret != ESP_OK && air_sensor_backend() != &air_sensor_mq135) {
+            ESP_LOGW(TAG, "%s sensor init failed (%s) — falling back to MQ-135",
+                     air_sensor_backend()->name, esp_err_to_name(ret));
+            air_sensor_select(&air_sensor_mq135);
+            ret = air_sensor_init();
+        }
         if (ret != ESP_OK) {
             ESP_LOGW(TAG, "Air sensor init failed (%s) — will use fallback value", esp_err_to_name(ret));
         }
-        event_detector_init(&g_detector);
+        report_policy_cfg_t report_cfg = REPORT_POLICY_CFG_DEFAULT();
+        for (int i = 0; i < AIR_SENSOR_CHANNELS; i++) {
+            channel_init(&g_channels[i], i, &report_cfg);
+        }
+        ret = zcl_reporting_load(g_reporting, REPORTING_NUM);
+        if (ret != ESP_OK && ret != ESP_ERR_NVS_NOT_FOUND) {
+            ESP_LOGW(TAG, "Saved reporting configuration unavailable (%s) — using defaults", esp_err_to_name(ret));
+        }
+        reporting_apply();
+#if CONFIG_LITTERBOX_BINARY_TRACE
+        if (trace_log_init() != ESP_OK) {
+            ESP_LOGW(TAG, "Binary trace unavailable");
+        }
+#endif
+#if CONFIG_LITTERBOX_HISTORY_LOG
+        if (history_log_init(SENSOR_SAMPLE_INTERVAL_MS) != ESP_OK) {
+            ESP_LOGW(TAG, "Flash history log unavailable");
+        }
+#endif
         is_inited = true;
     }
     return is_inited ? ESP_OK : ESP_FAIL;
@@ -47,93 +265,612 @@ static esp_err_t deferred_driver_init(void)
 
 /********************* Sensor report timer ***********************/
 
-static void sensor_sample_timer_cb(uint8_t param)
+#if CONFIG_LITTERBOX_STAGE_STATS
+/* Copy stage summaries into the diagnostics cluster (caller holds the Zigbee lock) */
+static void stage_stats_publish(void)
 {
-    /* Read NH₃ concentration from MQ-135 sensor */
-    air_sensor_data_t sensor = {0};
-    uint16_t nh3_ppm = NH3_DEFAULT_PPM;
-    float ppm_f = 0.0f;
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        stage_summary_t s;
+        stage_stats_summary((stage_id_t)i, &s);
+        uint32_t val[DIAG_KIND_NUM] = {
+            [DIAG_KIND_COUNT]  = s.count,
+            [DIAG_KIND_MIN_US] = stage_cycles_to_us(s.min),
+            [DIAG_KIND_AVG_US] = stage_cycles_to_us(s.avg),
+            [DIAG_KIND_P99_US] = stage_cycles_to_us(s.p99),
+            [DIAG_KIND_MAX_US] = stage_cycles_to_us(s.max),
+        };
+        for (int k = 0; k < DIAG_KIND_NUM; k++) {
+            esp_zb_zcl_set_attribute_val(HA_LITTERBOX_ENDPOINT, DIAG_CUSTOM_CLUSTER_ID,
+                                         ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, DIAG_ATTR_ID(i, k), &val[k], false);
+        }
+    }
+}
+#endif
+
+#if CONFIG_LITTERBOX_SAMPLE_BLOCK || CONFIG_LITTERBOX_EVENT_JOURNAL || CONFIG_LITTERBOX_EVENT_SNIPPET \
+    || CONFIG_LITTERBOX_USAGE_STATS
+/* Q15.16 ppm → 0.1 ppm, rounded and clamped to 0..0xFFFE (0xFFFF marks a failed read) */
+static uint16_t dppm_from_q(int32_t ppm_q)
+{
+    int64_t dppm = ((int64_t)ppm_q * 10 + (1 << (EVENT_PPM_Q_SHIFT - 1))) >> EVENT_PPM_Q_SHIFT;
+    return (uint16_t)(dppm < 0 ? 0 : dppm >= 0xFFFF ? 0xFFFE : dppm);
+}
+#endif
+
+#if CONFIG_LITTERBOX_SAMPLE_BLOCK
+/* Hand the block being filled to the report manager and start the next one (caller holds the Zigbee lock) */
+static void sample_block_send(litterbox_channel_t *ch)
+{
+    ch->block_attr[0] = ch->block.len;
+    memcpy(&ch->block_attr[1], ch->block.buf, ch->block.len);
+    esp_zb_zcl_set_attribute_val(ch->endpoint, NH3_CUSTOM_CLUSTER_ID, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                 NH3_ATTR_SAMPLE_BLOCK_ID, ch->block_attr, false);
+    report_mgr_set(&ch->report_mgr, RPT_ATTR_BLOCK, ch->block_attr, 1u + ch->block.len);
+    sample_block_reset(&ch->block);
+}
+
+/* Append one sample; send the block once it spans the configured period,
+ * or early if the sample cannot join it (gap or full). With another report
+ * going out this tick (riding), a block due within the NH₃ min interval
+ * joins that frame now instead of costing one of its own. Returns true if
+ * a block was sent. */
+static bool sample_block_append(litterbox_channel_t *ch, const sample_msg_t *msg, bool riding)
+{
+    const zcl_report_attr_t *cfg = &g_reporting[REPORTING_BLOCK];
+    if (cfg->max_interval_s == ZCL_REPORT_MAX_OFF) {
+        if (ch->block.len) {
+            sample_block_reset(&ch->block);   /* Turned off: drop the partial block */
+        }
+        return false;
+    }
+
+    /* Failed reads are marked rather than skipped to keep ticks consecutive */
+    bool sent = false;
+    uint16_t value = (msg->flags & SAMPLE_FLAG_VALID) ? dppm_from_q(msg->ppm_q) : SAMPLE_BLOCK_INVALID;
+    if (!sample_block_add(&ch->block, msg->tick, value)) {
+        sample_block_send(ch);
+        sample_block_add(&ch->block, msg->tick, value);   /* Always fits an empty block */
+        sent = true;
+    }
+
+    uint32_t samples = cfg->min_interval_s * 1000u / SENSOR_SAMPLE_INTERVAL_MS;
+    if (samples > SAMPLE_BLOCK_MAX_SAMPLES) {
+        samples = SAMPLE_BLOCK_MAX_SAMPLES;
+    }
+    uint32_t hold = g_reporting[REPORTING_NH3].min_interval_s * 1000u / SENSOR_SAMPLE_INTERVAL_MS;
+    uint32_t early = samples - (hold < samples / 2 ? hold : samples / 2);
+    if (ch->block.count >= samples || (riding && ch->block.count >= early)) {
+        sample_block_send(ch);
+        sent = true;
+    }
+    return sent;
+}
+#endif
+
+#if CONFIG_LITTERBOX_EVENT_JOURNAL
+_Static_assert(1 + EVENT_JOURNAL_MAX_BYTES <= REPORT_MGR_VALUE_MAX, "journal record must fit one report frame");
+
+/* Ticks-based feature → journal field in seconds, saturated */
+static uint16_t journal_u16(uint64_t v)
+{
+    return v > UINT16_MAX ? UINT16_MAX : (uint16_t)v;
+}
 
-    if (air_sensor_read(&sensor) == ESP_OK && sensor.is_valid) {
-        nh3_ppm = sensor.nh3_ppm;
-        ppm_f   = sensor.nh3_ppm_f;
+/* Journal a newly classified event (first sample after the ACTIVE phase ends) */
+static void event_journal_record(litterbox_channel_t *ch, const sample_msg_t *msg)
+{
+    uint8_t prev = ch->journal_prev_event;
+    ch->journal_prev_event = msg->event;
+    if (msg->event == LITTER_EVENT_NONE || msg->event == prev) {
+        return;
+    }
+    uint32_t active_ms = (uint32_t)msg->event_ticks * SENSOR_SAMPLE_INTERVAL_MS;
+    const event_features_t *f = &msg->features;
+    event_journal_entry_t e = {
+        .type            = msg->event,
+        .start_s         = (uint32_t)((msg->t_us / 1000 - active_ms) / 1000),
+        .duration_s      = (uint16_t)(active_ms / 1000),
+        .peak_dppm       = dppm_from_q(msg->peak_q),
+        .baseline_dppm   = dppm_from_q(msg->baseline_q),
+        .area_ppm_s      = journal_u16((uint64_t)f->auc_dppm_ticks * SENSOR_SAMPLE_INTERVAL_MS / 10000),
+        .max_rise_cppm_s = journal_u16((uint64_t)f->max_rise_cppm * 1000 / SENSOR_SAMPLE_INTERVAL_MS),
+        .time_to_peak_s  = journal_u16((uint64_t)f->time_to_peak_ticks * SENSOR_SAMPLE_INTERVAL_MS / 1000),
+        .decay_tau_s     = journal_u16((uint64_t)f->decay_tau_ticks * SENSOR_SAMPLE_INTERVAL_MS / 1000),
+    };
+    if (!event_journal_append(&ch->journal, &e)) {
+        ESP_LOGW(TAG, "ep%u: event journal full — oldest undelivered event dropped", ch->endpoint);
+    }
+}
+
+/* Keep the oldest undelivered journal entries in flight until the hub
+ * acknowledges them, then move on to the next ones (caller holds the Zigbee lock) */
+static void event_journal_service(litterbox_channel_t *ch)
+{
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    switch (report_mgr_status(&ch->report_mgr, RPT_ATTR_JOURNAL)) {
+    case REPORT_MGR_PENDING:
+        return;
+    case REPORT_MGR_ACKED:
+        event_journal_commit(&ch->journal);   /* No-op once committed */
+        break;
+    case REPORT_MGR_DROPPED:
+        /* Hub unreachable: wait for a rejoin (reports_resume()) or the retry interval */
+        if (ch->journal.sending && (int32_t)(now_ms - ch->journal_retry_at_ms) < 0) {
+            return;
+        }
+        break;
+    case REPORT_MGR_IDLE:
+        break;
+    }
+
+    size_t len = event_journal_encode(&ch->journal, now_ms / 1000, &ch->journal_attr[1]);
+    if (len == 0) {
+        return;
+    }
+    ch->journal_attr[0] = (uint8_t)len;
+    esp_zb_zcl_set_attribute_val(ch->endpoint, NH3_CUSTOM_CLUSTER_ID, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                 NH3_ATTR_EVENT_JOURNAL_ID, ch->journal_attr, false);
+    report_mgr_set(&ch->report_mgr, RPT_ATTR_JOURNAL, ch->journal_attr, 1u + len);
+    ch->journal_retry_at_ms = now_ms + EVENT_JOURNAL_RETRY_MS;
+}
+#endif
+
+#if CONFIG_LITTERBOX_EVENT_SNIPPET
+/* Keep the waveform around each event; announce it once the event is
+ * classified. The hub pulls it with Get Snippet Fragment (zb_raw_cmd_handler). */
+static void event_snippet_record(litterbox_channel_t *ch, const sample_msg_t *msg)
+{
+    uint16_t value = (msg->flags & SAMPLE_FLAG_VALID) ? dppm_from_q(msg->ppm_q) : EVENT_SNIPPET_INVALID;
+    if (!event_snippet_add(&ch->snippet, msg->tick, value, msg->state, msg->event, dppm_from_q(msg->baseline_q))) {
+        return;
+    }
+    event_snippet_info_t info;
+    event_snippet_latest(&ch->snippet, &info);
+    size_t len = event_snippet_info_encode(&ch->snippet, &ch->snippet_attr[1]);
+    ch->snippet_attr[0] = (uint8_t)len;
+    esp_zb_zcl_set_attribute_val(ch->endpoint, NH3_CUSTOM_CLUSTER_ID, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                 NH3_ATTR_SNIPPET_INFO_ID, ch->snippet_attr, false);
+    report_mgr_set(&ch->report_mgr, RPT_ATTR_SNIPPET, ch->snippet_attr, 1u + len);
+    ESP_LOGI(TAG, "ep%u: event snippet %u: %u samples in %u bytes%s", ch->endpoint, info.seq, info.count, info.len,
+             (info.flags & EVENT_SNIPPET_FLAG_TRUNCATED) ? " (truncated)" : "");
+}
+#endif
+
+#if CONFIG_LITTERBOX_PROVISIONAL_EVENT
+/* Report the early classification once the peak is in, and its clear (0)
+ * when the event is classified or withdrawn; the final type follows on 0x0003 */
+static void provisional_event_record(litterbox_channel_t *ch, const sample_msg_t *msg)
+{
+    static const char *event_names[] = {"NONE", "URINATION", "DEFECATION"};
+    uint16_t val = msg->provisional == LITTER_EVENT_NONE ? 0 : (uint16_t)(msg->provisional | (msg->confidence << 8));
+    if (val == ch->provisional_val) {
+        return;
+    }
+    ch->provisional_val = val;
+    esp_zb_zcl_set_attribute_val(ch->endpoint, NH3_CUSTOM_CLUSTER_ID, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                 NH3_ATTR_PROVISIONAL_EVENT_ID, &val, false);
+    if (!report_mgr_set(&ch->report_mgr, RPT_ATTR_PROVISIONAL, (uint8_t[]){ (uint8_t)val, (uint8_t)(val >> 8) }, 2)) {
+        ESP_LOGW(TAG, "ep%u: provisional report queue full — hub unreachable?", ch->endpoint);
+    }
+    if (val) {
+        ESP_LOGI(TAG, "ep%u: provisional event → %s (%u%%)", ch->endpoint, event_names[msg->provisional], msg->confidence);
+    } else if (msg->state != DETECTOR_COOLDOWN) {
+        ESP_LOGI(TAG, "ep%u: provisional %s withdrawn", ch->endpoint, event_names[ch->provisional_type]);
     } else {
-        ESP_LOGW(TAG, "Sensor read failed — reporting fallback: %u ppm", nh3_ppm);
+        ESP_LOGI(TAG, "ep%u: provisional %s %s as %s", ch->endpoint, event_names[ch->provisional_type],
+                 msg->event == ch->provisional_type ? "confirmed" : "corrected", event_names[msg->event]);
     }
+    ch->provisional_type = msg->provisional;
+}
+#endif
 
-    /* Determine whether this tick should also send a Zigbee NH₃ ppm report */
-    g_sample_tick++;
-    bool do_report = (g_sample_tick >= SENSOR_REPORT_TICKS);
-    if (do_report) {
-        g_sample_tick = 0;
-        if (sensor.is_valid && sensor.is_warming_up) {
-            ESP_LOGI(TAG, "Sensor warming up (raw=%"PRIu32"), NH3=%.1f ppm (unreliable)",
-                     sensor.raw_adc, (double)ppm_f);
+#if CONFIG_LITTERBOX_USAGE_STATS
+_Static_assert(1 + USAGE_STATS_DAYS_MAX_BYTES <= REPORT_MGR_VALUE_MAX, "per-day record must fit one unfragmented read response");
+
+/* Feed one sample to the usage statistics and refresh 0x0008 / 0x0009 on
+ * the first sample, each classified event and each hour rollover */
+static void usage_stats_record(litterbox_channel_t *ch, const sample_msg_t *msg)
+{
+    bool refresh = !ch->usage_stats.clock_started;
+    bool idle = msg->state == DETECTOR_IDLE && (msg->flags & SAMPLE_FLAG_VALID) && !(msg->flags & SAMPLE_FLAG_WARMUP);
+    uint16_t baseline = idle ? dppm_from_q(msg->baseline_q) : USAGE_STATS_NO_BASELINE;
+    refresh |= usage_stats_sample(&ch->usage_stats, (uint32_t)((uint64_t)msg->tick * SENSOR_SAMPLE_INTERVAL_MS / 1000),
+                                  baseline);
+
+    uint8_t prev = ch->usage_prev_event;
+    ch->usage_prev_event = msg->event;
+    if (msg->event != LITTER_EVENT_NONE && msg->event != prev) {
+        uint16_t peak = dppm_from_q(msg->peak_q);
+        uint16_t base = dppm_from_q(msg->baseline_q);
+        usage_stats_event(&ch->usage_stats, msg->event,
+                          (uint32_t)msg->event_ticks * SENSOR_SAMPLE_INTERVAL_MS / 1000,
+                          peak > base ? (uint16_t)(peak - base) : 0);
+        refresh = true;
+    }
+    if (!refresh) {
+        return;
+    }
+    ch->usage_24h_attr[0] = (uint8_t)usage_stats_encode_24h(&ch->usage_stats, &ch->usage_24h_attr[1]);
+    esp_zb_zcl_set_attribute_val(ch->endpoint, NH3_CUSTOM_CLUSTER_ID, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                 NH3_ATTR_USAGE_24H_ID, ch->usage_24h_attr, false);
+    ch->usage_days_attr[0] = (uint8_t)usage_stats_encode_days(&ch->usage_stats, &ch->usage_days_attr[1]);
+    esp_zb_zcl_set_attribute_val(ch->endpoint, NH3_CUSTOM_CLUSTER_ID, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                 NH3_ATTR_USAGE_DAYS_ID, ch->usage_days_attr, false);
+}
+#endif
+
+/* Back on the network: send what waited for the link now rather than at
+ * the end of its backoff (Zigbee task) */
+static void reports_resume(void)
+{
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    for (int i = 0; i < AIR_SENSOR_CHANNELS; i++) {
+        litterbox_channel_t *ch = &g_channels[i];
+        report_mgr_resume(&ch->report_mgr, now_ms);
+#if CONFIG_LITTERBOX_EVENT_JOURNAL
+        ch->journal_retry_at_ms = now_ms;
+        if (ch->journal.count) {
+            ESP_LOGI(TAG, "Rejoined — ep%u sending %u journaled event(s)", ch->endpoint, ch->journal.count);
         }
+#endif
     }
+}
 
-    /* Run event detection state machine with float ppm (outside lock — pure computation) */
-    litter_event_t new_event = event_detector_update(&g_detector, ppm_f);
-    bool event_changed = (new_event != g_last_reported_event);
+/* Send what the channel's report manager has due as one Report Attributes
+ * frame from its endpoint to the coordinator, default response enabled
+ * (caller holds the Zigbee lock) */
+static void report_flush(litterbox_channel_t *ch)
+{
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    report_mgr_poll(&ch->report_mgr, now_ms);
+
+    uint8_t payload[REPORT_MGR_FRAME_MAX];
+    uint8_t tsn = ZB_ZCL_GET_SEQ_NUM();
+    size_t len = report_mgr_flush(&ch->report_mgr, now_ms, tsn, payload, sizeof(payload));
+    if (len == 0) {
+        return;
+    }
+    zb_bufid_t buf = zb_buf_get_out();
+    if (buf == ZB_BUF_INVALID) {
+        return;     /* Counts as lost: retried after the ack timeout */
+    }
+    zb_uint8_t *cmd_ptr = ZB_ZCL_START_PACKET(buf);
+    ZB_ZCL_CONSTRUCT_GENERAL_COMMAND_REQ_FRAME_CONTROL_A(cmd_ptr, ZB_ZCL_FRAME_DIRECTION_TO_CLI,
+                                                         ZB_ZCL_NOT_MANUFACTURER_SPECIFIC, ZB_ZCL_ENABLE_DEFAULT_RESPONSE);
+    ZB_ZCL_CONSTRUCT_COMMAND_HEADER(cmd_ptr, tsn, ZCL_CMD_REPORT_ATTRIBUTES);
+    ZB_ZCL_PACKET_PUT_DATA_N(cmd_ptr, payload, len);
+    ZB_ZCL_FINISH_PACKET(buf, cmd_ptr);
+    ZB_ZCL_SEND_COMMAND_SHORT(buf, 0x0000, ZB_APS_ADDR_MODE_16_ENDP_PRESENT, 1, ch->endpoint,
+                              ZB_AF_HA_PROFILE_ID, NH3_CUSTOM_CLUSTER_ID, NULL);
+}
+
+/* Filter and detect on one channel's reading and fill its message */
+static void channel_sample(litterbox_channel_t *ch, air_sensor_data_t *sensor, uint32_t tick, int64_t now_us,
+                           sample_msg_t *msg)
+{
+    uint16_t nh3_ppm = NH3_DEFAULT_PPM;
+    int32_t  ppm_q   = 0;   /* Q15.16 ppm (EVENT_PPM_Q_SHIFT) — integer-only logging */
 
+    if (sensor->is_valid) {
+        nh3_ppm = sensor->nh3_ppm;
+        ppm_q   = (int32_t)sensor->nh3_ppm_q << (EVENT_PPM_Q_SHIFT - AIR_SENSOR_PPM_Q_SHIFT);
+#if CONFIG_LITTERBOX_SPIKE_FILTER
+        /* A lone absurd reading (current spike, v_adc at its floor) must not
+         * start an event or become its peak: the window median stands in.
+         * Warm-up readings go through too, so the window is full once the
+         * detector starts. */
+        int32_t raw_q = ppm_q;
+        if (spike_filter_push(&ch->spike_filter, raw_q, &ppm_q)) {
+            sensor->nh3_ppm_f = (float)ppm_q / (1 << EVENT_PPM_Q_SHIFT);
+            nh3_ppm = (uint16_t)(ppm_q >> EVENT_PPM_Q_SHIFT);
+            ESP_LOGW(TAG, "ep%u: spike rejected: %d.%02d ppm → %d.%02d ppm (raw=%"PRIu32", %"PRIu32" so far)",
+                     ch->endpoint, EVENT_PPM_Q_INT(raw_q), EVENT_PPM_Q_HUND(raw_q),
+                     EVENT_PPM_Q_INT(ppm_q), EVENT_PPM_Q_HUND(ppm_q), sensor->raw_adc, ch->spike_filter.rejected);
+        }
+#endif
+    } else {
+        ESP_LOGW(TAG, "ep%u: sensor read failed — reporting fallback: %u ppm", ch->endpoint, nh3_ppm);
+    }
+
+    /* Run event detection state machine (pure computation, no Zigbee access) */
+    event_detector_t *det = &ch->detector;
+    litter_event_t new_event = det->current_event;
+    /* Never seed or step the detector with readings from a heater that is
+     * still warming up (or a failed read) — that was the source of false
+     * events right after power-up. Once warm, the detector runs, and its
+     * start-up baseline follows the overshoot while it decays. */
+    bool hold = !sensor->is_valid || sensor->is_warming_up;
+#if CONFIG_LITTERBOX_BASELINE_PERSIST
+    /* Saved baseline waiting: restore on a settled reading that agrees (or fall back to cold start) */
+    if (!hold && detector_persist_pending(&ch->persist)) {
+        detector_persist_restore(&ch->persist, det, ppm_q);
+        hold = detector_persist_pending(&ch->persist);
+    }
+#endif
+    if (!hold) {
+        STAGE_BEGIN(t_det);
+        event_detector_set_settling(det, sensor->is_settling);
+#if CONFIG_LITTERBOX_FIXED_POINT
+        new_event = event_detector_update_q(det, ppm_q);
+#else
+        new_event = event_detector_update(det, sensor->nh3_ppm_f);
+#endif
+        STAGE_END(STAGE_DETECTOR, t_det);
+#if CONFIG_LITTERBOX_BASELINE_PERSIST
+        detector_persist_tick(&ch->persist, det);
+#endif
+    }
+
+    *msg = (sample_msg_t){
+        .tick       = tick,
+        .t_us       = now_us,
+        .raw_adc    = sensor->raw_adc,
+        .ppm_q      = ppm_q,
+        .baseline_q = event_detector_get_baseline_q(det),
+        .peak_q     = event_detector_get_peak_q(det),
+        .event_ticks = det->event_ticks,
+        .nh3_ppm    = nh3_ppm,
+        .event      = (uint8_t)new_event,
+        .state      = (uint8_t)det->state,
+        .flags      = (sensor->is_valid ? SAMPLE_FLAG_VALID : 0)
+                    | (sensor->is_warming_up ? SAMPLE_FLAG_WARMUP : 0),
+        .provisional = (uint8_t)det->provisional_event,
+        .confidence = det->provisional_confidence,
+        .channel    = ch->index,
+        .features   = det->features,
+    };
+}
+
+/* Read, detect, trace, log: one 2 s tick of the sampling side, one message per channel */
+static void sensor_sample(sample_msg_t msgs[AIR_SENSOR_CHANNELS])
+{
+    /* Period error against the nominal interval (0 for the first sample) */
+    int64_t now_us = esp_timer_get_time();
+    if (g_last_sample_us != 0) {
+        int64_t err_us = now_us - g_last_sample_us - (int64_t)SENSOR_SAMPLE_INTERVAL_MS * 1000;
+        STAGE_RECORD_US(STAGE_TICK_JITTER, (uint64_t)(err_us < 0 ? -err_us : err_us));
+    }
+    g_last_sample_us = now_us;
+
+    /* Collect the conversion started on the previous tick, then start the
+     * next one: no tick waits on the sensor bus (air_sensor_driver.h). A
+     * failed channel comes back with is_valid cleared while the others are
+     * still read; nothing started (init failed) leaves every channel invalid. */
+    air_sensor_data_t sensor[AIR_SENSOR_CHANNELS] = {0};
+    uint32_t tick = g_sample_seq++;
+    if (air_sensor_poll(sensor) == ESP_ERR_NOT_FINISHED) {
+        ESP_LOGW(TAG, "%s conversion still running — no reading on tick %"PRIu32, air_sensor_backend()->name, tick);
+    } else {
+        (void)air_sensor_start();
+    }
+    for (int i = 0; i < AIR_SENSOR_CHANNELS; i++) {
+        channel_sample(&g_channels[i], &sensor[i], tick, now_us, &msgs[i]);
+    }
+
+#if CONFIG_LITTERBOX_BINARY_TRACE || CONFIG_LITTERBOX_HISTORY_LOG
+    /* The trace and the flash history follow channel 0 (their formats carry one sensor) */
+    const sample_msg_t *m = &msgs[0];
+    trace_record_t rec = {
+        .tick       = m->tick,
+        .raw        = (uint16_t)m->raw_adc,
+        .ppm_q      = m->ppm_q,
+        .baseline_q = m->baseline_q,
+        .state      = m->state
+                    | ((m->flags & SAMPLE_FLAG_WARMUP) ? TRACE_FLAG_WARMUP : 0)
+                    | ((m->flags & SAMPLE_FLAG_VALID) ? 0 : TRACE_FLAG_INVALID),
+        .event      = m->event,
+    };
+#endif
+#if CONFIG_LITTERBOX_BINARY_TRACE
+    /* One 20-byte frame per tick instead of the formatted log lines */
+    trace_log_write(&rec);
+#endif
+#if CONFIG_LITTERBOX_HISTORY_LOG
+    history_log_write(&rec);
+#endif
+}
+
+/* Attribute updates and reports for one sample, on its channel's endpoint (Zigbee task) */
+static void sensor_report(const sample_msg_t *msg)
+{
+    litterbox_channel_t *ch = &g_channels[msg->channel];
+    uint16_t nh3_ppm = msg->nh3_ppm;
+    litter_event_t new_event = (litter_event_t)msg->event;
+
+    /* NH₃ ppm report on change / heartbeat, faster during an event. The
+     * clock is the sample index so a dropped message does not shift it. */
+    uint32_t now_ms = msg->tick * SENSOR_SAMPLE_INTERVAL_MS;
+    bool do_report = report_policy_update(&ch->nh3_policy, now_ms, nh3_ppm, msg->state == DETECTOR_ACTIVE);
+    /* Event type: every change by default, per the hub's Configure Reporting otherwise */
+    bool do_event = report_policy_update(&ch->event_policy, now_ms, (uint16_t)new_event, false);
+    bool event_changed = do_event && (new_event != ch->last_reported_event);
+
+#if !CONFIG_LITTERBOX_BINARY_TRACE
+    if ((msg->tick + 1) % SENSOR_STATUS_LOG_TICKS == 0 && (msg->flags & SAMPLE_FLAG_VALID) && (msg->flags & SAMPLE_FLAG_WARMUP)) {
+        ESP_LOGI(TAG, "ep%u: sensor warming up (raw=%"PRIu32"), NH3=%d.%02d ppm (unreliable)",
+                 ch->endpoint, msg->raw_adc, EVENT_PPM_Q_INT(msg->ppm_q), EVENT_PPM_Q_HUND(msg->ppm_q));
+    }
+#endif
+
+    STAGE_BEGIN(t_lock);
     esp_zb_lock_acquire(portMAX_DELAY);
+    STAGE_END(STAGE_ZB_LOCK_WAIT, t_lock);
 
-    /* --- NH₃ ppm Report (custom cluster 0xFC00, attr 0x0000) — every SENSOR_REPORT_TICKS ticks --- */
+    /* Attribute values for reads, and dirty marks for the report manager */
+    STAGE_BEGIN(t_set);
+    /* --- NH₃ ppm (custom cluster 0xFC00, attr 0x0000) — per the channel's nh3_policy --- */
     if (do_report) {
         esp_zb_zcl_set_attribute_val(
-            HA_LITTERBOX_ENDPOINT,
+            ch->endpoint,
             NH3_CUSTOM_CLUSTER_ID,
             ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
             NH3_ATTR_MEASURED_VALUE_ID,
             &nh3_ppm, false);
-
-        esp_zb_zcl_report_attr_cmd_t nh3_report = {0};
-        nh3_report.address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT;
-        nh3_report.attributeID = NH3_ATTR_MEASURED_VALUE_ID;
-        nh3_report.direction = ESP_ZB_ZCL_CMD_DIRECTION_TO_CLI;
-        nh3_report.clusterID = NH3_CUSTOM_CLUSTER_ID;
-        nh3_report.zcl_basic_cmd.src_endpoint = HA_LITTERBOX_ENDPOINT;
-        nh3_report.zcl_basic_cmd.dst_addr_u.addr_short = 0x0000;
-        nh3_report.zcl_basic_cmd.dst_endpoint = 1;
-        esp_zb_zcl_report_attr_cmd_req(&nh3_report);
+        report_mgr_set(&ch->report_mgr, RPT_ATTR_NH3, (uint8_t[]){ (uint8_t)nh3_ppm, (uint8_t)(nh3_ppm >> 8) }, 2);
     }
 
-    /* --- Event Type Report (attr 0x0003) — only when event changes --- */
-    if (event_changed) {
+    /* --- Event Type (attr 0x0003) — per its event_policy --- */
+    if (do_event) {
         uint8_t event_val = (uint8_t)new_event;
         esp_zb_zcl_set_attribute_val(
-            HA_LITTERBOX_ENDPOINT,
+            ch->endpoint,
             NH3_CUSTOM_CLUSTER_ID,
             ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
             NH3_ATTR_EVENT_TYPE_ID,
             &event_val, false);
+        if (!report_mgr_set(&ch->report_mgr, RPT_ATTR_EVENT, &event_val, 1)) {
+            ESP_LOGW(TAG, "ep%u: event report queue full — hub unreachable?", ch->endpoint);
+        }
+    }
+
+#if CONFIG_LITTERBOX_SAMPLE_BLOCK
+    /* --- Sample Block (attr 0x0004) — every sample, one record per block --- */
+    if (sample_block_append(ch, msg, do_report || do_event) && !do_report
+        && g_reporting[REPORTING_NH3].max_interval_s != ZCL_REPORT_MAX_OFF) {
+        /* The block's frame carries the current NH₃ value as well: 5 bytes
+         * instead of a frame of its own at the next change or heartbeat */
+        esp_zb_zcl_set_attribute_val(ch->endpoint, NH3_CUSTOM_CLUSTER_ID, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                     NH3_ATTR_MEASURED_VALUE_ID, &nh3_ppm, false);
+        report_mgr_set(&ch->report_mgr, RPT_ATTR_NH3, (uint8_t[]){ (uint8_t)nh3_ppm, (uint8_t)(nh3_ppm >> 8) }, 2);
+        report_policy_mark_sent(&ch->nh3_policy, now_ms, nh3_ppm);
+    }
+#endif
+#if CONFIG_LITTERBOX_EVENT_JOURNAL
+    /* --- Event Journal (attr 0x0005) — classified events until acknowledged --- */
+    event_journal_record(ch, msg);
+    event_journal_service(ch);
+#endif
+#if CONFIG_LITTERBOX_EVENT_SNIPPET
+    /* --- Event Snippet Info (attr 0x0006) — once per finished snippet --- */
+    event_snippet_record(ch, msg);
+#endif
+#if CONFIG_LITTERBOX_PROVISIONAL_EVENT
+    /* --- Provisional Event (attr 0x0007) — early type while ACTIVE, cleared at the end --- */
+    provisional_event_record(ch, msg);
+#endif
+#if CONFIG_LITTERBOX_USAGE_STATS
+    /* --- Usage Statistics (attrs 0x0008, 0x0009) — read-only, refreshed per event and hour --- */
+    usage_stats_record(ch, msg);
+#endif
+    STAGE_END(STAGE_REPORT_SET, t_set);
 
-        esp_zb_zcl_report_attr_cmd_t event_report = {0};
-        event_report.address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT;
-        event_report.attributeID = NH3_ATTR_EVENT_TYPE_ID;
-        event_report.direction = ESP_ZB_ZCL_CMD_DIRECTION_TO_CLI;
-        event_report.clusterID = NH3_CUSTOM_CLUSTER_ID;
-        event_report.zcl_basic_cmd.src_endpoint = HA_LITTERBOX_ENDPOINT;
-        event_report.zcl_basic_cmd.dst_addr_u.addr_short = 0x0000;
-        event_report.zcl_basic_cmd.dst_endpoint = 1;
-        esp_zb_zcl_report_attr_cmd_req(&event_report);
+    /* --- One Report Attributes frame for everything due, incl. retries --- */
+    STAGE_BEGIN(t_send);
+    report_flush(ch);
+    STAGE_END(STAGE_REPORT_SEND, t_send);
+
+#if CONFIG_LITTERBOX_STAGE_STATS
+    if (msg->channel == 0 && (msg->tick + 1) % STAGE_STATS_PUBLISH_TICKS == 0) {
+        stage_stats_publish();
     }
+#endif
 
     esp_zb_lock_release();
 
+#if !CONFIG_LITTERBOX_BINARY_TRACE
     if (do_report) {
-        ESP_LOGI(TAG, "Reported NH3=%u ppm (%.1f ppm_f, baseline=%.1f, raw=%"PRIu32")",
-                 nh3_ppm, (double)ppm_f, event_detector_get_baseline(&g_detector), sensor.raw_adc);
+        ESP_LOGI(TAG, "ep%u: reported NH3=%u ppm (%d.%02d ppm_q, baseline=%d.%02d, raw=%"PRIu32")",
+                 ch->endpoint, nh3_ppm, EVENT_PPM_Q_INT(msg->ppm_q), EVENT_PPM_Q_HUND(msg->ppm_q),
+                 EVENT_PPM_Q_INT(msg->baseline_q), EVENT_PPM_Q_HUND(msg->baseline_q), msg->raw_adc);
     }
+#endif
 
+    if (do_event) {
+        ch->last_reported_event = new_event;
+    }
     if (event_changed) {
-        g_last_reported_event = new_event;
         static const char *event_names[] = {"NONE", "URINATION", "DEFECATION"};
-        ESP_LOGI(TAG, "Event type changed → %s (%u)", event_names[new_event], (unsigned)new_event);
+        ESP_LOGI(TAG, "ep%u: event type changed → %s (%u)", ch->endpoint, event_names[new_event], (unsigned)new_event);
     }
 
-    /* Re-schedule at sample interval (2 s) */
+    if ((msg->tick + 1) % REPORT_STATS_LOG_TICKS == 0) {
+        const report_mgr_stats_t *st = &ch->report_mgr.stats;
+        ESP_LOGI(TAG, "ep%u reports: %"PRIu32" frames / %"PRIu32" attrs, %"PRIu32" acked (max %"PRIu32" ms), "
+                 "%"PRIu32" lost, %"PRIu32" resent, %"PRIu32" dropped",
+                 ch->endpoint, st->frames, st->attrs, st->acked, st->ack_ms_max, st->timeouts, st->retries, st->dropped);
+    }
+
+#if CONFIG_LITTERBOX_STAGE_STATS && CONFIG_LITTERBOX_STAGE_STATS_LOG_MIN > 0
+    if (msg->channel == 0
+        && (msg->tick + 1) % (CONFIG_LITTERBOX_STAGE_STATS_LOG_MIN * 60000 / SENSOR_SAMPLE_INTERVAL_MS) == 0) {
+        stage_stats_log();
+    }
+#endif
+}
+
+#if CONFIG_LITTERBOX_SENSOR_TASK
+/* Fixed-rate sampling, independent of how busy the Zigbee stack is */
+static void sensor_task(void *arg)
+{
+    TickType_t last_wake = xTaskGetTickCount();
+    for (;;) {
+        xTaskDelayUntil(&last_wake, pdMS_TO_TICKS(SENSOR_SAMPLE_INTERVAL_MS));
+        STAGE_BEGIN(t_tick);
+        sample_msg_t msgs[AIR_SENSOR_CHANNELS];
+        sensor_sample(msgs);
+        for (int i = 0; i < AIR_SENSOR_CHANNELS; i++) {
+            sample_queue_push(&g_sample_queue, &msgs[i]);
+        }
+        STAGE_END(STAGE_TICK_TOTAL, t_tick);
+    }
+}
+
+/* Zigbee side: report everything the sensor task queued since the last poll */
+static void sensor_queue_poll_cb(uint8_t param)
+{
+    sample_msg_t msg;
+    while (sample_queue_pop(&g_sample_queue, &msg)) {
+        if (msg.dropped) {
+            ESP_LOGW(TAG, "Zigbee task fell behind — %"PRIu32" sample message(s) not reported", msg.dropped);
+        }
+        sensor_report(&msg);
+    }
+    esp_zb_scheduler_alarm((esp_zb_callback_t)sensor_queue_poll_cb, 0, SAMPLE_QUEUE_POLL_MS);
+}
+#else
+static void sensor_sample_timer_cb(uint8_t param)
+{
+    STAGE_BEGIN(t_tick);
+    sample_msg_t msgs[AIR_SENSOR_CHANNELS];
+    sensor_sample(msgs);
+    for (int i = 0; i < AIR_SENSOR_CHANNELS; i++) {
+        sensor_report(&msgs[i]);
+    }
+    STAGE_END(STAGE_TICK_TOTAL, t_tick);
+
+    /* Re-schedule at sample interval (2 s) — measured from the end of this
+     * callback, so the period stretches by the callback and any stack backlog */
+    esp_zb_scheduler_alarm((esp_zb_callback_t)sensor_sample_timer_cb, 0, SENSOR_SAMPLE_INTERVAL_MS);
+}
+#endif
+
+/* Start sampling once the device is on a network (Zigbee task context) */
+static void sensor_sampling_start(void)
+{
+    static bool started = false;
+    if (started) {
+        return;
+    }
+    started = true;
+    (void)air_sensor_start();     /* Collected by the first tick */
+#if CONFIG_LITTERBOX_SENSOR_TASK
+    sample_queue_init(&g_sample_queue);
+    if (xTaskCreate(sensor_task, "sensor", SENSOR_TASK_STACK, NULL,
+                    CONFIG_LITTERBOX_SENSOR_TASK_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create sensor task");
+        started = false;
+        return;
+    }
+    esp_zb_scheduler_alarm((esp_zb_callback_t)sensor_queue_poll_cb, 0, SAMPLE_QUEUE_POLL_MS);
+    const char *mode = "sensor task";
+#else
     esp_zb_scheduler_alarm((esp_zb_callback_t)sensor_sample_timer_cb, 0, SENSOR_SAMPLE_INTERVAL_MS);
+    const char *mode = "Zigbee scheduler";
+#endif
+    const report_policy_cfg_t *cfg = &g_channels[0].nh3_policy.cfg;
+    ESP_LOGI(TAG, "Sensor sampling started (%s × %d channel(s), sample: %d ms, %s; NH3 report: %u-%u s / ±%u ppm, "
+             "active %u-%u s)", air_sensor_backend()->name, AIR_SENSOR_CHANNELS, SENSOR_SAMPLE_INTERVAL_MS, mode, cfg->min_interval_s,
+             cfg->max_interval_s, cfg->reportable_change, cfg->active_min_interval_s, cfg->active_max_interval_s);
 }
 
 /********************* Zigbee signal handler **********************/
@@ -156,14 +893,17 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
     case ESP_ZB_BDB_SIGNAL_DEVICE_FIRST_START:
     case ESP_ZB_BDB_SIGNAL_DEVICE_REBOOT:
         if (err_status == ESP_OK) {
-            ESP_LOGI(TAG, "Deferred driver initialization %s", deferred_driver_init() ? "failed" : "successful");
+            /* Not inside ESP_LOGI: below the INFO log level its arguments are compiled out */
+            esp_err_t init_err = deferred_driver_init();
+            ESP_LOGI(TAG, "Deferred driver initialization %s", init_err ? "failed" : "successful");
             ESP_LOGI(TAG, "Device started up in%s factory-reset mode", esp_zb_bdb_is_factory_new() ? "" : " non");
             if (esp_zb_bdb_is_factory_new()) {
                 ESP_LOGI(TAG, "Start network steering");
                 esp_zb_bdb_start_top_level_commissioning(ESP_ZB_BDB_MODE_NETWORK_STEERING);
             } else {
                 ESP_LOGI(TAG, "Device rebooted, already on network - starting reports");
-                esp_zb_scheduler_alarm((esp_zb_callback_t)sensor_sample_timer_cb, 0, SENSOR_SAMPLE_INTERVAL_MS);
+                sensor_sampling_start();
+                reports_resume();
             }
         } else {
             ESP_LOGW(TAG, "%s failed with status: %s, retrying", esp_zb_zdo_signal_to_string(sig_type),
@@ -181,9 +921,8 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
                      extended_pan_id[3], extended_pan_id[2], extended_pan_id[1], extended_pan_id[0],
                      esp_zb_get_pan_id(), esp_zb_get_current_channel(), esp_zb_get_short_address());
             /* Start sensor reporting NOW (after joining network) */
-            esp_zb_scheduler_alarm((esp_zb_callback_t)sensor_sample_timer_cb, 0, SENSOR_SAMPLE_INTERVAL_MS);
-            ESP_LOGI(TAG, "Sensor sample timer started (sample: %d ms, report: %d ms)",
-                     SENSOR_SAMPLE_INTERVAL_MS, SENSOR_REPORT_INTERVAL_MS);
+            sensor_sampling_start();
+            reports_resume();
         } else {
             ESP_LOGI(TAG, "Network steering was not successful (status: %s)", esp_err_to_name(err_status));
             esp_zb_scheduler_alarm((esp_zb_callback_t)bdb_start_top_level_commissioning_cb, ESP_ZB_BDB_MODE_NETWORK_STEERING, 1000);
@@ -228,7 +967,14 @@ static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id,
         break;
     case ESP_ZB_CORE_CMD_DEFAULT_RESP_CB_ID: {
         const esp_zb_zcl_cmd_default_resp_message_t *resp = (const esp_zb_zcl_cmd_default_resp_message_t *)message;
-        if (resp) {
+        litterbox_channel_t *ch = resp ? channel_for_endpoint(resp->info.dst_endpoint) : NULL;
+        if (ch && resp->info.cluster == NH3_CUSTOM_CLUSTER_ID && resp->resp_to_cmd == ZCL_CMD_REPORT_ATTRIBUTES) {
+            /* Acknowledgement of a report_flush() frame from that endpoint */
+            uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+            if (!report_mgr_ack(&ch->report_mgr, now_ms, resp->info.header.tsn, resp->status_code)) {
+                ESP_LOGD(TAG, "Late or unknown report ack (tsn %u)", resp->info.header.tsn);
+            }
+        } else if (resp) {
             ESP_LOGI(TAG, "Default Response: status=0x%02x, cmd_id=0x%02x, cluster=0x%04x, src_ep=%d, dst_ep=%d",
                      resp->status_code, resp->resp_to_cmd,
                      resp->info.cluster, resp->info.src_endpoint, resp->info.dst_endpoint);
@@ -242,10 +988,119 @@ static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id,
     return ret;
 }
 
+#if CONFIG_LITTERBOX_EVENT_SNIPPET
+/* Get Snippet Fragment (0xFC00 command 0x00) → Snippet Fragment from RAM;
+ * the request only copies out of the finished snippet, so sampling and
+ * capture carry on between fragments (event_snippet.h) */
+static bool snippet_fragment_cmd(litterbox_channel_t *ch, uint8_t bufid, zb_zcl_parsed_hdr_t *hdr)
+{
+    /* The response reuses bufid, so take everything needed from the request first */
+    zb_uint16_t src_addr    = ZB_ZCL_PARSED_HDR_SHORT_DATA(hdr).source.u.short_addr;
+    zb_uint8_t  src_ep      = ZB_ZCL_PARSED_HDR_SHORT_DATA(hdr).src_endpoint;
+    zb_uint8_t  dst_ep      = ZB_ZCL_PARSED_HDR_SHORT_DATA(hdr).dst_endpoint;
+    zb_uint16_t profile_id  = hdr->profile_id;
+    zb_uint8_t  seq         = hdr->seq_number;
+    zb_uint8_t  cmd_id      = hdr->cmd_id;
+    zb_bool_t   is_manuf    = hdr->is_manuf_specific;
+    zb_uint16_t manuf_code  = hdr->manuf_specific;
+
+    ZB_ZCL_CUT_HEADER(bufid);
+    uint8_t resp[EVENT_SNIPPET_FRAGMENT_HDR + EVENT_SNIPPET_FRAGMENT_BYTES];
+    size_t resp_len = event_snippet_fragment(&ch->snippet, zb_buf_begin(bufid), zb_buf_len(bufid), resp);
+    if (resp_len == 0) {
+        ZB_ZCL_SEND_DEFAULT_RESP(bufid, src_addr, ZB_APS_ADDR_MODE_16_ENDP_PRESENT, src_ep, dst_ep, profile_id,
+                                 NH3_CUSTOM_CLUSTER_ID, seq, cmd_id, ZCL_STATUS_MALFORMED_COMMAND);
+        return true;
+    }
+
+    zb_uint8_t *cmd_ptr = ZB_ZCL_START_PACKET(bufid);
+    ZB_ZCL_CONSTRUCT_SPECIFIC_COMMAND_RES_FRAME_CONTROL_A(cmd_ptr, ZB_ZCL_FRAME_DIRECTION_TO_CLI, is_manuf);
+    ZB_ZCL_CONSTRUCT_COMMAND_HEADER_EXT(cmd_ptr, seq, is_manuf, manuf_code, EVENT_SNIPPET_CMD_FRAGMENT);
+    ZB_ZCL_PACKET_PUT_DATA_N(cmd_ptr, resp, resp_len);
+    ZB_ZCL_FINISH_PACKET(bufid, cmd_ptr);
+    ZB_ZCL_SEND_COMMAND_SHORT(bufid, src_addr, ZB_APS_ADDR_MODE_16_ENDP_PRESENT, src_ep, dst_ep,
+                              profile_id, NH3_CUSTOM_CLUSTER_ID, NULL);
+    return true;
+}
+#endif
+
+/* Configure Reporting / Read Reporting Configuration for cluster 0xFC00.
+ * The stack's reporting engine does not handle this cluster (see
+ * esp_zb_task()), so answer these two global commands here, and the
+ * snippet transfer command; everything else goes to the stack. */
+static bool zb_raw_cmd_handler(uint8_t bufid)
+{
+    zb_zcl_parsed_hdr_t *hdr = ZB_BUF_GET_PARAM(bufid, zb_zcl_parsed_hdr_t);
+    if (hdr->cluster_id != NH3_CUSTOM_CLUSTER_ID) {
+        return false;
+    }
+#if CONFIG_LITTERBOX_EVENT_SNIPPET
+    litterbox_channel_t *ch = channel_for_endpoint(ZB_ZCL_PARSED_HDR_SHORT_DATA(hdr).dst_endpoint);
+    if (ch && !hdr->is_common_command && hdr->cmd_id == EVENT_SNIPPET_CMD_GET_FRAGMENT) {
+        return snippet_fragment_cmd(ch, bufid, hdr);
+    }
+#endif
+    if (!hdr->is_common_command
+        || (hdr->cmd_id != ZCL_CMD_CONFIGURE_REPORTING && hdr->cmd_id != ZCL_CMD_READ_REPORTING_CONFIG)) {
+        return false;
+    }
+
+    /* The response reuses bufid, so take everything needed from the request first */
+    zb_uint16_t src_addr    = ZB_ZCL_PARSED_HDR_SHORT_DATA(hdr).source.u.short_addr;
+    zb_uint8_t  src_ep      = ZB_ZCL_PARSED_HDR_SHORT_DATA(hdr).src_endpoint;
+    zb_uint8_t  dst_ep      = ZB_ZCL_PARSED_HDR_SHORT_DATA(hdr).dst_endpoint;
+    zb_uint16_t profile_id  = hdr->profile_id;
+    zb_uint8_t  seq         = hdr->seq_number;
+    zb_bool_t   is_manuf    = hdr->is_manuf_specific;
+    zb_uint16_t manuf_code  = hdr->manuf_specific;
+    bool        configure   = hdr->cmd_id == ZCL_CMD_CONFIGURE_REPORTING;
+
+    ZB_ZCL_CUT_HEADER(bufid);
+    const uint8_t *payload = zb_buf_begin(bufid);
+    size_t payload_len = zb_buf_len(bufid);
+
+    uint8_t resp[ZCL_REPORTING_RESP_MAX];
+    size_t resp_len;
+    bool changed = false;
+    if (configure) {
+        resp_len = zcl_reporting_configure(g_reporting, REPORTING_NUM, payload, payload_len,
+                                           resp, sizeof(resp), &changed);
+    } else {
+        resp_len = zcl_reporting_read_config(g_reporting, REPORTING_NUM, payload, payload_len,
+                                             resp, sizeof(resp));
+    }
+
+    zb_uint8_t *cmd_ptr = ZB_ZCL_START_PACKET(bufid);
+    ZB_ZCL_CONSTRUCT_GENERAL_COMMAND_RESP_FRAME_CONTROL_A(cmd_ptr, ZB_ZCL_FRAME_DIRECTION_TO_CLI, is_manuf);
+    ZB_ZCL_CONSTRUCT_COMMAND_HEADER_EXT(cmd_ptr, seq, is_manuf, manuf_code,
+        configure ? ZCL_CMD_CONFIGURE_REPORTING_RESP : ZCL_CMD_READ_REPORTING_CONFIG_RESP);
+    ZB_ZCL_PACKET_PUT_DATA_N(cmd_ptr, resp, resp_len);
+    ZB_ZCL_FINISH_PACKET(bufid, cmd_ptr);
+    ZB_ZCL_SEND_COMMAND_SHORT(bufid, src_addr, ZB_APS_ADDR_MODE_16_ENDP_PRESENT, src_ep, dst_ep,
+                              profile_id, NH3_CUSTOM_CLUSTER_ID, NULL);
+
+    if (changed) {
+        reporting_apply();
+        esp_err_t err = zcl_reporting_save(g_reporting, REPORTING_NUM);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Reporting configuration not saved (%s) — reverts on reboot", esp_err_to_name(err));
+        }
+        ESP_LOGI(TAG, "Reporting configured by 0x%04x: NH3 %u-%u s / ±%u ppm, event %u-%u s",
+                 src_addr, g_reporting[REPORTING_NH3].min_interval_s, g_reporting[REPORTING_NH3].max_interval_s,
+                 g_reporting[REPORTING_NH3].reportable_change, g_reporting[REPORTING_EVENT].min_interval_s,
+                 g_reporting[REPORTING_EVENT].max_interval_s);
+    }
+    return true;
+}
+
 /********************* Cluster creation **************************/
 
-static esp_zb_cluster_list_t *custom_litterbox_clusters_create(void)
+/* Clusters of the endpoint of sensor channel index; Diagnostics and On/Off
+ * (the device's, not a channel's) only on the first */
+static esp_zb_cluster_list_t *custom_litterbox_clusters_create(int index)
 {
+    litterbox_channel_t *ch = &g_channels[index];
+
     esp_zb_cluster_list_t *cluster_list = esp_zb_zcl_cluster_list_create();
 
     /* Basic Cluster with manufacturer info */
@@ -284,8 +1139,69 @@ static esp_zb_cluster_list_t *custom_litterbox_clusters_create(void)
         NH3_ATTR_EVENT_TYPE_ID, ESP_ZB_ZCL_ATTR_TYPE_U8,
         ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING,
         &nh3_event_type));
+#if CONFIG_LITTERBOX_SAMPLE_BLOCK
+    /* The stack sizes string storage from the initial length byte, so start at
+     * full size; format byte 0 tells the hub no block has been sent yet */
+    ch->block_attr[0] = SAMPLE_BLOCK_MAX_BYTES;
+    ESP_ERROR_CHECK(esp_zb_custom_cluster_add_custom_attr(nh3_cluster,
+        NH3_ATTR_SAMPLE_BLOCK_ID, ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING,
+        ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING,
+        ch->block_attr));
+#endif
+#if CONFIG_LITTERBOX_EVENT_JOURNAL
+    ch->journal_attr[0] = EVENT_JOURNAL_MAX_BYTES;    /* Full size, format byte 0: nothing journaled yet */
+    ESP_ERROR_CHECK(esp_zb_custom_cluster_add_custom_attr(nh3_cluster,
+        NH3_ATTR_EVENT_JOURNAL_ID, ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING,
+        ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING,
+        ch->journal_attr));
+#endif
+#if CONFIG_LITTERBOX_EVENT_SNIPPET
+    ch->snippet_attr[0] = EVENT_SNIPPET_INFO_BYTES;   /* Full size, format byte 0: no snippet yet */
+    ESP_ERROR_CHECK(esp_zb_custom_cluster_add_custom_attr(nh3_cluster,
+        NH3_ATTR_SNIPPET_INFO_ID, ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING,
+        ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING,
+        ch->snippet_attr));
+#endif
+#if CONFIG_LITTERBOX_PROVISIONAL_EVENT
+    uint16_t nh3_provisional = 0;
+    ESP_ERROR_CHECK(esp_zb_custom_cluster_add_custom_attr(nh3_cluster,
+        NH3_ATTR_PROVISIONAL_EVENT_ID, ESP_ZB_ZCL_ATTR_TYPE_U16,
+        ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING,
+        &nh3_provisional));
+#endif
+#if CONFIG_LITTERBOX_USAGE_STATS
+    /* Read on demand, not reported: full size, format byte 0 until the first refresh */
+    ch->usage_24h_attr[0] = USAGE_STATS_24H_BYTES;
+    ESP_ERROR_CHECK(esp_zb_custom_cluster_add_custom_attr(nh3_cluster,
+        NH3_ATTR_USAGE_24H_ID, ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING,
+        ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY,
+        ch->usage_24h_attr));
+    ch->usage_days_attr[0] = USAGE_STATS_DAYS_MAX_BYTES;
+    ESP_ERROR_CHECK(esp_zb_custom_cluster_add_custom_attr(nh3_cluster,
+        NH3_ATTR_USAGE_DAYS_ID, ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING,
+        ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY,
+        ch->usage_days_attr));
+#endif
     ESP_ERROR_CHECK(esp_zb_cluster_list_add_custom_cluster(cluster_list, nh3_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
 
+    if (index > 0) {
+        return cluster_list;
+    }
+
+#if CONFIG_LITTERBOX_STAGE_STATS
+    /* Diagnostics Cluster (0xFC01): per-stage timing, read on demand by the hub */
+    esp_zb_attribute_list_t *diag_cluster = esp_zb_zcl_attr_list_create(DIAG_CUSTOM_CLUSTER_ID);
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        for (int k = 0; k < DIAG_KIND_NUM; k++) {
+            ESP_ERROR_CHECK(esp_zb_custom_cluster_add_custom_attr(diag_cluster,
+                DIAG_ATTR_ID(i, k), ESP_ZB_ZCL_ATTR_TYPE_U32,
+                ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY,
+                &g_diag_attr[i][k]));
+        }
+    }
+    ESP_ERROR_CHECK(esp_zb_cluster_list_add_custom_cluster(cluster_list, diag_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
+#endif
+
     /* On/Off Cluster (for LED control) */
     esp_zb_on_off_cluster_cfg_t on_off_cfg = { .on_off = false };
     ESP_ERROR_CHECK(esp_zb_cluster_list_add_on_off_cluster(cluster_list, esp_zb_on_off_cluster_create(&on_off_cfg), ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
@@ -293,16 +1209,19 @@ static esp_zb_cluster_list_t *custom_litterbox_clusters_create(void)
     return cluster_list;
 }
 
-static esp_zb_ep_list_t *custom_litterbox_ep_create(uint8_t endpoint_id)
+/* One endpoint per sensor channel, numbered from first_endpoint */
+static esp_zb_ep_list_t *custom_litterbox_ep_create(uint8_t first_endpoint)
 {
     esp_zb_ep_list_t *ep_list = esp_zb_ep_list_create();
-    esp_zb_endpoint_config_t endpoint_config = {
-        .endpoint = endpoint_id,
-        .app_profile_id = ESP_ZB_AF_HA_PROFILE_ID,
-        .app_device_id = ESP_ZB_HA_CUSTOM_ATTR_DEVICE_ID,
-        .app_device_version = 0
-    };
-    esp_zb_ep_list_add_ep(ep_list, custom_litterbox_clusters_create(), endpoint_config);
+    for (int i = 0; i < AIR_SENSOR_CHANNELS; i++) {
+        esp_zb_endpoint_config_t endpoint_config = {
+            .endpoint = (uint8_t)(first_endpoint + i),
+            .app_profile_id = ESP_ZB_AF_HA_PROFILE_ID,
+            .app_device_id = ESP_ZB_HA_CUSTOM_ATTR_DEVICE_ID,
+            .app_device_version = 0
+        };
+        esp_zb_ep_list_add_ep(ep_list, custom_litterbox_clusters_create(i), endpoint_config);
+    }
     return ep_list;
 }
 
@@ -314,7 +1233,7 @@ static void esp_zb_task(void *pvParameters)
     esp_zb_cfg_t zb_nwk_cfg = ESP_ZB_ZED_CONFIG();
     esp_zb_init(&zb_nwk_cfg);
 
-    /* Create customized LitterBox endpoint */
+    /* Create customized LitterBox endpoints (one per sensor channel) */
     esp_zb_ep_list_t *esp_zb_litterbox_ep = custom_litterbox_ep_create(HA_LITTERBOX_ENDPOINT);
 
     /* Register the device */
@@ -322,11 +1241,14 @@ static void esp_zb_task(void *pvParameters)
 
     /* Note: esp_zb_zcl_update_reporting_info() is NOT used for the custom NH₃ cluster
      * (0xFC00) because the ZCL stack's internal reporting mechanism does not support
-     * manufacturer-specific clusters and will crash. Instead, reports are sent manually
-     * via esp_zb_zcl_report_attr_cmd_req() in sensor_report_timer_cb(). */
+     * manufacturer-specific clusters and will crash. Instead, reports are coalesced by
+     * report_mgr and sent as raw Report Attributes frames from report_flush(), and the
+     * hub's Configure Reporting for the cluster is answered by zb_raw_cmd_handler()
+     * (zcl_reporting.h). */
 
     /* Register action handler */
     esp_zb_core_action_handler_register(zb_action_handler);
+    esp_zb_raw_command_handler_register(zb_raw_cmd_handler);
 
     esp_zb_set_primary_network_channel_set(ESP_ZB_PRIMARY_CHANNEL_MASK);
     ESP_ERROR_CHECK(esp_zb_start(false));
@@ -19,7 +19,7 @@
 #define INSTALLCODE_POLICY_ENABLE       false   /* enable the install code policy for security */
 #define ED_AGING_TIMEOUT                ESP_ZB_ED_AGING_TIMEOUT_64MIN
 #define ED_KEEP_ALIVE                   3000    /* 3000 millisecond */
-#define HA_LITTERBOX_ENDPOINT           1       /* LitterBox device endpoint (must be 1 for SmartThings) */
+#define HA_LITTERBOX_ENDPOINT           1       /* First LitterBox endpoint, sensor channel 0 (must be 1 for SmartThings) */
 #define ESP_ZB_PRIMARY_CHANNEL_MASK     ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK  /* Zigbee primary channel mask */
 
 /* Basic manufacturer information (ZCL string format: length byte + string) */
@@ -35,14 +35,42 @@
 #define NH3_ATTR_MIN_MEASURED_VALUE_ID  0x0001  /* Min measurable: uint16, ppm */
 #define NH3_ATTR_MAX_MEASURED_VALUE_ID  0x0002  /* Max measurable: uint16, ppm */
 #define NH3_ATTR_EVENT_TYPE_ID          0x0003  /* Event type: uint8 (0=none, 1=urination, 2=defecation) */
+#define NH3_ATTR_SAMPLE_BLOCK_ID        0x0004  /* Sample block: octet string (sample_block.h), CONFIG_LITTERBOX_SAMPLE_BLOCK */
+#define NH3_ATTR_EVENT_JOURNAL_ID       0x0005  /* Event journal: octet string (event_journal.h), CONFIG_LITTERBOX_EVENT_JOURNAL */
+#define NH3_ATTR_SNIPPET_INFO_ID        0x0006  /* Latest event snippet: octet string (event_snippet.h), CONFIG_LITTERBOX_EVENT_SNIPPET */
+#define NH3_ATTR_PROVISIONAL_EVENT_ID   0x0007  /* Provisional event: uint16, low byte type (0=none), high byte confidence %, CONFIG_LITTERBOX_PROVISIONAL_EVENT */
+#define NH3_ATTR_USAGE_24H_ID           0x0008  /* Usage statistics, last 24 h: octet string (usage_stats.h), CONFIG_LITTERBOX_USAGE_STATS */
+#define NH3_ATTR_USAGE_DAYS_ID          0x0009  /* Usage statistics per day: octet string (usage_stats.h), CONFIG_LITTERBOX_USAGE_STATS */
 #define NH3_DEFAULT_PPM                 0       /* Fallback when sensor read fails */
 #define NH3_MIN_PPM                     0
 #define NH3_MAX_PPM                     1000
+/* Event type reporting defaults (overridable by Configure Reporting, zcl_reporting.h):
+ * every change at once, no heartbeat */
+#define EVENT_REPORT_MIN_S              0
+#define EVENT_REPORT_MAX_S              0
+#define EVENT_REPORT_CHANGE             1
+
+/* Diagnostics Cluster (Manufacturer-Specific, 0xFC01) — CONFIG_LITTERBOX_STAGE_STATS
+ * Read-only uint32 per stage (stage_stats.h) and statistic: attr = stage << 4 | kind,
+ * e.g. 0x0023 = detector p99 (µs). Refreshed every STAGE_STATS_PUBLISH_TICKS; not reported.
+ */
+#define DIAG_CUSTOM_CLUSTER_ID          0xFC01
+#define DIAG_KIND_COUNT                 0       /* Samples since boot */
+#define DIAG_KIND_MIN_US                1
+#define DIAG_KIND_AVG_US                2
+#define DIAG_KIND_P99_US                3
+#define DIAG_KIND_MAX_US                4
+#define DIAG_KIND_NUM                   5
+#define DIAG_ATTR_ID(stage, kind)       ((uint16_t)(((stage) << 4) | (kind)))
 
 /* Sensor timing */
 #define SENSOR_SAMPLE_INTERVAL_MS       2000    /* ADC read + event detection: 2 seconds */
-#define SENSOR_REPORT_INTERVAL_MS       10000   /* Zigbee NH₃ ppm report: 10 seconds */
-#define SENSOR_REPORT_TICKS             (SENSOR_REPORT_INTERVAL_MS / SENSOR_SAMPLE_INTERVAL_MS) /* = 5 */
+#define SENSOR_STATUS_LOG_INTERVAL_MS   10000   /* "Sensor warming up" notice: 10 seconds */
+#define SENSOR_STATUS_LOG_TICKS         (SENSOR_STATUS_LOG_INTERVAL_MS / SENSOR_SAMPLE_INTERVAL_MS) /* = 5 */
+/* NH₃ ppm report timing: report_policy.h (CONFIG_LITTERBOX_REPORT_*), hub overrides: zcl_reporting.h */
+#define REPORT_STATS_LOG_TICKS          (3600000 / SENSOR_SAMPLE_INTERVAL_MS)   /* report_mgr counters: hourly */
+#define EVENT_JOURNAL_RETRY_MS          600000  /* Journal record given up on without a rejoin: try again after 10 min */
+#define SENSOR_TASK_STACK               4096    /* CONFIG_LITTERBOX_SENSOR_TASK: driver + detector + NVS */
 
 #define ESP_ZB_ZED_CONFIG()                                         \
     {                                                               \
@@ -0,0 +1,34 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * LitterBox.v1 - MQ-135 model constants
+ *
+ * Shared by air_sensor_driver_MQ135.c and scripts/gen_mq135_lut.py, which
+ * parses the MQ135_* defines below to build the raw-ADC → ppm lookup table
+ * (CONFIG_LITTERBOX_FIXED_POINT). Keep one plain numeric literal per define.
+ * See air_sensor_driver_MQ135.c for the electrical model and calibration.
+ */
+
+#pragma once
+
+/* ── Electrical constants ───────────────────────────────────────────── */
+#define MQ135_LOAD_RESISTANCE_KOHM  10.0f   /* RL on module board (kΩ) */
+#define MQ135_VCC                   5.0f    /* Sensor supply voltage (V) — VBUS */
+#define MQ135_DIVIDER_RATIO         2.0f    /* AOUT voltage divider (100kΩ:100kΩ = ×2) */
+#define MQ135_ADC_VREF              3.3f    /* ESP32-C6 ADC reference voltage (V) */
+
+/* ── NH₃ sensitivity curve ──────────────────────────────────────────── */
+#define MQ135_NH3_CURVE_A   102.2f
+#define MQ135_NH3_CURVE_B   (-2.473f)
+
+/* ── R0: clean-air reference resistance (kΩ) ────────────────────────── */
+/* Calibrated 2026-02-23 @ 5 V + 100kΩ:100kΩ divider, window open (~30 min warmup):
+ *   avg raw=953 (n=6), V_adc=0.768V, AOUT=1.536V, Rs=22.55kΩ, R0=Rs/3.6=6.3kΩ
+ *   V_adc = raw/4095 × 3.3,  AOUT = V_adc × 2.0
+ *   Rs = RL × (5.0 − AOUT) / AOUT,  R0 = Rs / 3.6 */
+#define MQ135_R0_KOHM       6.3f
+
+/* ── Output clamp ───────────────────────────────────────────────────── */
+#define MQ135_PPM_MAX       1000
@@ -0,0 +1,207 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * report_mgr.c — Dirty-set coalescing, ack tracking and retry backoff
+ */
+#include "report_mgr.h"
+#include <string.h>
+
+#define ZCL_STATUS_SUCCESS  0x00
+
+void report_mgr_init(report_mgr_t *m, const report_mgr_attr_cfg_t *cfg, size_t n_attrs)
+{
+    memset(m, 0, sizeof(*m));
+    m->cfg     = cfg;
+    m->n_attrs = n_attrs < REPORT_MGR_MAX_ATTRS ? n_attrs : REPORT_MGR_MAX_ATTRS;
+    for (size_t i = 0; i < m->n_attrs; i++) {
+        m->attr[i].owner = -1;
+    }
+}
+
+bool report_mgr_set(report_mgr_t *m, size_t idx, const void *value, size_t len)
+{
+    if (idx >= m->n_attrs) {
+        return false;
+    }
+    report_mgr_attr_t *a = &m->attr[idx];
+
+    if (m->cfg[idx].queued) {
+        if (len > REPORT_MGR_QUEUED_VALUE_MAX || a->queue_count == REPORT_MGR_QUEUE_LEN) {
+            m->stats.dropped++;
+            return false;
+        }
+        memcpy(a->queue[a->queue_count], value, len);
+        a->len = (uint8_t)len;
+        if (a->queue_count++ == 0) {
+            a->dirty = true;    /* Otherwise it goes out once the head is acknowledged */
+        }
+        return true;
+    }
+
+    if (len > REPORT_MGR_VALUE_MAX) {
+        return false;
+    }
+    memcpy(a->value, value, len);
+    a->len      = (uint8_t)len;
+    a->dirty    = true;
+    a->outcome  = REPORT_MGR_IDLE;
+    a->owner    = -1;       /* Any in-flight copy is stale now; its fate no longer matters */
+    a->attempts = 0;
+    return true;
+}
+
+static uint32_t backoff_ms(uint8_t attempts)
+{
+    uint32_t ms = REPORT_MGR_BACKOFF_BASE_MS;
+    for (uint8_t i = 1; i < attempts && ms < REPORT_MGR_BACKOFF_MAX_MS; i++) {
+        ms <<= 1;
+    }
+    return ms < REPORT_MGR_BACKOFF_MAX_MS ? ms : REPORT_MGR_BACKOFF_MAX_MS;
+}
+
+void report_mgr_poll(report_mgr_t *m, uint32_t now_ms)
+{
+    for (int f = 0; f < REPORT_MGR_INFLIGHT; f++) {
+        report_mgr_frame_t *fr = &m->frame[f];
+        if (!fr->used || now_ms - fr->sent_ms < REPORT_MGR_ACK_TIMEOUT_MS) {
+            continue;
+        }
+        m->stats.timeouts++;
+        for (size_t i = 0; i < m->n_attrs; i++) {
+            report_mgr_attr_t *a = &m->attr[i];
+            if (!(fr->mask & (1u << i)) || a->owner != f) {
+                continue;
+            }
+            a->owner = -1;
+            a->attempts++;
+            if (!m->cfg[i].queued && a->attempts > REPORT_MGR_RETRY_MAX) {
+                m->stats.dropped++;
+                a->attempts = 0;
+                a->outcome  = REPORT_MGR_DROPPED;
+                continue;
+            }
+            a->dirty = true;
+            a->retry_at_ms = now_ms + backoff_ms(a->attempts);
+            m->stats.retries++;
+        }
+        fr->used = false;
+    }
+}
+
+static const uint8_t *attr_value(const report_mgr_t *m, size_t i)
+{
+    return m->cfg[i].queued ? m->attr[i].queue[0] : m->attr[i].value;
+}
+
+size_t report_mgr_flush(report_mgr_t *m, uint32_t now_ms, uint8_t tsn, uint8_t *out, size_t cap)
+{
+    int f = -1;
+    for (int k = 0; k < REPORT_MGR_INFLIGHT; k++) {
+        if (!m->frame[k].used) {
+            f = k;
+            break;
+        }
+    }
+    if (f < 0) {
+        return 0;
+    }
+    if (cap > REPORT_MGR_FRAME_MAX) {
+        cap = REPORT_MGR_FRAME_MAX;
+    }
+
+    size_t len = 0;
+    uint32_t mask = 0;
+    for (size_t i = 0; i < m->n_attrs; i++) {
+        report_mgr_attr_t *a = &m->attr[i];
+        bool backing_off = a->attempts && (int32_t)(now_ms - a->retry_at_ms) < 0;
+        if (!a->dirty || backing_off || (m->cfg[i].queued && a->owner >= 0)) {
+            continue;
+        }
+        size_t rec = 3 + a->len;        /* attr id, type, value */
+        if (len + rec > cap) {
+            continue;                   /* Next flush; a smaller one behind it may still fit */
+        }
+        out[len]     = (uint8_t)m->cfg[i].attr_id;
+        out[len + 1] = (uint8_t)(m->cfg[i].attr_id >> 8);
+        out[len + 2] = m->cfg[i].type;
+        memcpy(&out[len + 3], attr_value(m, i), a->len);
+        len += rec;
+
+        mask |= 1u << i;
+        a->dirty = false;
+        a->owner = (int8_t)f;
+    }
+
+    if (len) {
+        m->frame[f] = (report_mgr_frame_t) { .used = true, .tsn = tsn, .sent_ms = now_ms, .mask = mask };
+        m->stats.frames++;
+        m->stats.attrs += (uint32_t)__builtin_popcount(mask);
+    }
+    return len;
+}
+
+bool report_mgr_ack(report_mgr_t *m, uint32_t now_ms, uint8_t tsn, uint8_t status)
+{
+    for (int f = 0; f < REPORT_MGR_INFLIGHT; f++) {
+        report_mgr_frame_t *fr = &m->frame[f];
+        if (!fr->used || fr->tsn != tsn) {
+            continue;
+        }
+        uint32_t ack_ms = now_ms - fr->sent_ms;
+        m->stats.ack_ms_max = ack_ms > m->stats.ack_ms_max ? ack_ms : m->stats.ack_ms_max;
+        m->stats.acked++;
+        /* A non-SUCCESS status means the hub got the frame and refused it; resending will not help */
+        m->stats.rejected += status != ZCL_STATUS_SUCCESS;
+
+        for (size_t i = 0; i < m->n_attrs; i++) {
+            report_mgr_attr_t *a = &m->attr[i];
+            if (!(fr->mask & (1u << i)) || a->owner != f) {
+                continue;
+            }
+            a->owner = -1;
+            a->attempts = 0;
+            a->outcome = REPORT_MGR_ACKED;
+            if (m->cfg[i].queued) {
+                memmove(a->queue[0], a->queue[1], (size_t)(a->queue_count - 1) * REPORT_MGR_QUEUED_VALUE_MAX);
+                a->queue_count--;
+                a->dirty = a->queue_count > 0;
+            }
+        }
+        fr->used = false;
+        return true;
+    }
+    return false;
+}
+
+report_mgr_status_t report_mgr_status(const report_mgr_t *m, size_t idx)
+{
+    if (idx >= m->n_attrs) {
+        return REPORT_MGR_IDLE;
+    }
+    const report_mgr_attr_t *a = &m->attr[idx];
+    if (a->dirty || a->owner >= 0) {
+        return REPORT_MGR_PENDING;
+    }
+    return (report_mgr_status_t)a->outcome;
+}
+
+void report_mgr_resume(report_mgr_t *m, uint32_t now_ms)
+{
+    for (size_t i = 0; i < m->n_attrs; i++) {
+        if (m->attr[i].attempts) {
+            m->attr[i].retry_at_ms = now_ms;
+        }
+    }
+}
+
+bool report_mgr_idle(const report_mgr_t *m)
+{
+    for (size_t i = 0; i < m->n_attrs; i++) {
+        if (m->attr[i].dirty || m->attr[i].owner >= 0) {
+            return false;
+        }
+    }
+    return true;
+}
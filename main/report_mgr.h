@@ -0,0 +1,159 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * report_mgr.h — Coalesced, acknowledged attribute reports for cluster 0xFC00
+ *
+ * Producers (sensor_report() in main.c) only mark an attribute dirty with
+ * its new value. One flush per tick packs every dirty attribute into a
+ * single ZCL Report Attributes (0x0A) payload, so a tick that reports NH₃,
+ * an event change and a sample block costs one frame and one send under
+ * the Zigbee lock instead of three. Left alone those rarely fall on the
+ * same tick, so main.c lines sample blocks up with NH₃ reports
+ * (sample_block_append()).
+ *
+ * Frames are sent with the default response enabled; the hub's Default
+ * Response, matched by ZCL sequence number (report_mgr_ack()), is the
+ * acknowledgement. A frame without one after REPORT_MGR_ACK_TIMEOUT_MS is
+ * lost: its attributes become dirty again and are resent after an
+ * exponential backoff (REPORT_MGR_BACKOFF_*), coalesced with whatever else
+ * is pending.
+ *
+ * Two delivery classes:
+ *  - latest value (ppm, sample block): a newer value replaces a pending or
+ *    in-flight one; retried up to REPORT_MGR_RETRY_MAX times, then dropped
+ *    (the next change or heartbeat carries the state anyway).
+ *  - queued (event type): every value set is delivered, in order — each is
+ *    retried until acknowledged and the next one is only sent after that,
+ *    so a short NONE → URINATION → NONE is never collapsed to NONE.
+ *
+ * Time is the caller's monotonic millisecond clock. Platform-independent;
+ * host/bench/report_mgr_bench.c runs it against a lossy link.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define REPORT_MGR_MAX_ATTRS        8
+#define REPORT_MGR_VALUE_MAX        77      /* Largest attribute value incl. string length byte: one per frame */
+#define REPORT_MGR_QUEUE_LEN        4       /* Queued-class values waiting for delivery */
+#define REPORT_MGR_QUEUED_VALUE_MAX 2       /* Queued-class attributes are small (≤ uint16) */
+#define REPORT_MGR_INFLIGHT         4       /* Unacknowledged frames */
+#define REPORT_MGR_FRAME_MAX        80      /* Report payload budget: one unfragmented APS frame */
+#define REPORT_MGR_ACK_TIMEOUT_MS   4000    /* End device: the response waits for the next parent poll */
+#define REPORT_MGR_BACKOFF_BASE_MS  2000    /* Delay before the first retry, doubled per attempt */
+#define REPORT_MGR_BACKOFF_MAX_MS   60000
+#define REPORT_MGR_RETRY_MAX        3       /* Latest-value class only */
+
+#define ZCL_CMD_REPORT_ATTRIBUTES   0x0A
+#define ZCL_CMD_DEFAULT_RESPONSE    0x0B
+
+typedef struct {
+    uint16_t attr_id;
+    uint8_t  type;          /* ZCL type (zcl_reporting.h); octet string values carry their length byte */
+    bool     queued;        /* Deliver every value in order (see above) */
+} report_mgr_attr_cfg_t;
+
+typedef struct {
+    uint32_t frames;        /* Report frames built (incl. retries) */
+    uint32_t attrs;         /* Attribute records in them */
+    uint32_t acked;         /* Frames acknowledged */
+    uint32_t rejected;      /* Acknowledged with a non-SUCCESS status (not retried) */
+    uint32_t timeouts;      /* Frames presumed lost */
+    uint32_t retries;       /* Attribute records resent after a timeout */
+    uint32_t dropped;       /* Values given up on (latest-value class), or queue overflow */
+    uint32_t ack_ms_max;    /* Slowest acknowledgement */
+} report_mgr_stats_t;
+
+typedef enum {
+    REPORT_MGR_IDLE,        /* Never set */
+    REPORT_MGR_PENDING,     /* Dirty or in flight */
+    REPORT_MGR_ACKED,       /* Last value acknowledged (SUCCESS or rejected) */
+    REPORT_MGR_DROPPED,     /* Last value given up on (latest-value class) */
+} report_mgr_status_t;
+
+typedef struct {
+    uint8_t  value[REPORT_MGR_VALUE_MAX];   /* Latest value (latest-value class) */
+    uint8_t  len;
+    uint8_t  queue[REPORT_MGR_QUEUE_LEN][REPORT_MGR_QUEUED_VALUE_MAX];  /* Queued class, head first */
+    uint8_t  queue_count;
+    bool     dirty;         /* Needs to go out in the next flush */
+    int8_t   owner;         /* In-flight frame carrying the current value, −1 if none */
+    uint8_t  attempts;      /* Timeouts of the current value */
+    uint8_t  outcome;       /* REPORT_MGR_ACKED / DROPPED once settled, else REPORT_MGR_IDLE */
+    uint32_t retry_at_ms;   /* Backoff: not sent before this */
+} report_mgr_attr_t;
+
+typedef struct {
+    bool     used;
+    uint8_t  tsn;
+    uint32_t sent_ms;
+    uint32_t mask;          /* Attributes this frame carries (bit = index) */
+} report_mgr_frame_t;
+
+typedef struct {
+    const report_mgr_attr_cfg_t *cfg;
+    size_t              n_attrs;
+    report_mgr_attr_t   attr[REPORT_MGR_MAX_ATTRS];
+    report_mgr_frame_t  frame[REPORT_MGR_INFLIGHT];
+    report_mgr_stats_t  stats;
+} report_mgr_t;
+
+void report_mgr_init(report_mgr_t *m, const report_mgr_attr_cfg_t *cfg, size_t n_attrs);
+
+/**
+ * @brief Mark attribute idx dirty with a new value (len bytes, as it goes on air).
+ * @return false if the value does not fit, or the queue of a queued attribute is full
+ */
+bool report_mgr_set(report_mgr_t *m, size_t idx, const void *value, size_t len);
+
+/**
+ * @brief Expire unacknowledged frames and schedule their retries. Call before report_mgr_flush().
+ */
+void report_mgr_poll(report_mgr_t *m, uint32_t now_ms);
+
+/**
+ * @brief Build one Report Attributes payload from the dirty attributes due now.
+ *
+ * The caller sends it with ZCL sequence number tsn and the default response
+ * enabled. Attributes that do not fit stay dirty for the next flush.
+ *
+ * @return Payload length, 0 if nothing is due or all frame slots are in flight
+ */
+size_t report_mgr_flush(report_mgr_t *m, uint32_t now_ms, uint8_t tsn, uint8_t *out, size_t cap);
+
+/**
+ * @brief Feed a Default Response to a Report Attributes frame.
+ * @return true if tsn matched an in-flight frame
+ */
+bool report_mgr_ack(report_mgr_t *m, uint32_t now_ms, uint8_t tsn, uint8_t status);
+
+/**
+ * @brief Where the last value set for attribute idx is.
+ *
+ * Lets an owner that must not lose a value (event_journal.h) keep it until
+ * REPORT_MGR_ACKED and set it again after REPORT_MGR_DROPPED.
+ */
+report_mgr_status_t report_mgr_status(const report_mgr_t *m, size_t idx);
+
+/**
+ * @brief The link is back (rejoin): retry everything backing off now
+ *        instead of at the end of its backoff.
+ */
+void report_mgr_resume(report_mgr_t *m, uint32_t now_ms);
+
+/**
+ * @brief True if nothing is dirty or in flight.
+ */
+bool report_mgr_idle(const report_mgr_t *m);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,51 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * report_policy.c — Deadband / min-max interval NH₃ reporting
+ */
+#include "report_policy.h"
+
+void report_policy_init(report_policy_t *p, const report_policy_cfg_t *cfg)
+{
+    p->cfg         = *cfg;
+    p->last_ms     = 0;
+    p->last_value  = 0;
+    p->last_active = false;
+    p->reported    = false;
+}
+
+bool report_policy_update(report_policy_t *p, uint32_t now_ms, uint16_t value, bool active)
+{
+    bool phase_changed = (active != p->last_active);
+    p->last_active = active;
+
+    uint16_t max_s = active ? p->cfg.active_max_interval_s : p->cfg.max_interval_s;
+    bool send;
+    if (max_s == REPORT_POLICY_MAX_OFF) {
+        send = false;
+    } else if (!p->reported || phase_changed) {
+        send = true;
+    } else {
+        uint32_t min_ms  = 1000u * (active ? p->cfg.active_min_interval_s : p->cfg.min_interval_s);
+        uint32_t max_ms  = 1000u * max_s;
+        uint32_t elapsed = now_ms - p->last_ms;
+        uint16_t delta   = value > p->last_value ? value - p->last_value : p->last_value - value;
+        bool changed     = p->cfg.reportable_change ? delta >= p->cfg.reportable_change : delta != 0;
+
+        send = (elapsed >= min_ms && changed) || (max_ms != 0 && elapsed >= max_ms);
+    }
+
+    if (send) {
+        report_policy_mark_sent(p, now_ms, value);
+    }
+    return send;
+}
+
+void report_policy_mark_sent(report_policy_t *p, uint32_t now_ms, uint16_t value)
+{
+    p->last_ms    = now_ms;
+    p->last_value = value;
+    p->reported   = true;
+}
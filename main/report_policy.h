@@ -0,0 +1,91 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * report_policy.h — When to send an NH₃ ppm report
+ *
+ * ZCL-style reporting: an attribute is reported when it moved by at least
+ * the reportable change and min_interval has passed since the last report,
+ * or when max_interval has passed regardless (heartbeat). While the
+ * detector is ACTIVE a second, faster interval pair applies, and every
+ * transition into or out of ACTIVE is reported at once. A flat baseline then
+ * costs one frame per max_interval instead of one every 10 s,
+ * and an event is followed tick by tick.
+ *
+ * Time is the caller's millisecond clock (sample index × interval in
+ * main.c, so dropped samples do not shift it). Only differences are used,
+ * so it may wrap. Platform-independent.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Defaults for builds without sdkconfig (host); see Kconfig.projbuild */
+#ifndef CONFIG_LITTERBOX_REPORT_MIN_S
+#define CONFIG_LITTERBOX_REPORT_MIN_S           10
+#endif
+#ifndef CONFIG_LITTERBOX_REPORT_MAX_S
+#define CONFIG_LITTERBOX_REPORT_MAX_S           300
+#endif
+#ifndef CONFIG_LITTERBOX_REPORT_CHANGE_PPM
+#define CONFIG_LITTERBOX_REPORT_CHANGE_PPM      2
+#endif
+#ifndef CONFIG_LITTERBOX_REPORT_ACTIVE_MIN_S
+#define CONFIG_LITTERBOX_REPORT_ACTIVE_MIN_S    2
+#endif
+#ifndef CONFIG_LITTERBOX_REPORT_ACTIVE_MAX_S
+#define CONFIG_LITTERBOX_REPORT_ACTIVE_MAX_S    10
+#endif
+
+#define REPORT_POLICY_MAX_OFF   0xFFFF  /* max_interval_s: never report in that phase (ZCL convention) */
+
+typedef struct {
+    uint16_t min_interval_s;        /* Idle: no report sooner than this after the last one */
+    uint16_t max_interval_s;        /* Idle: heartbeat, report at least this often (0 = no heartbeat) */
+    uint16_t reportable_change;     /* ppm; 0 = any change */
+    uint16_t active_min_interval_s; /* Same pair while the detector is ACTIVE */
+    uint16_t active_max_interval_s;
+} report_policy_cfg_t;
+
+#define REPORT_POLICY_CFG_DEFAULT() {                               \
+    .min_interval_s        = CONFIG_LITTERBOX_REPORT_MIN_S,         \
+    .max_interval_s        = CONFIG_LITTERBOX_REPORT_MAX_S,         \
+    .reportable_change     = CONFIG_LITTERBOX_REPORT_CHANGE_PPM,    \
+    .active_min_interval_s = CONFIG_LITTERBOX_REPORT_ACTIVE_MIN_S,  \
+    .active_max_interval_s = CONFIG_LITTERBOX_REPORT_ACTIVE_MAX_S,  \
+}
+
+typedef struct {
+    report_policy_cfg_t cfg;
+    uint32_t last_ms;       /* Time of the last report */
+    uint16_t last_value;    /* Value sent in the last report */
+    bool     last_active;   /* Detector phase at the last evaluation */
+    bool     reported;      /* False until the first report */
+} report_policy_t;
+
+void report_policy_init(report_policy_t *p, const report_policy_cfg_t *cfg);
+
+/**
+ * @brief Decide whether to report value now; if so, records it as sent.
+ *
+ * @param now_ms  Monotonic milliseconds
+ * @param value   Attribute value (ppm)
+ * @param active  Detector is in DETECTOR_ACTIVE
+ */
+bool report_policy_update(report_policy_t *p, uint32_t now_ms, uint16_t value, bool active);
+
+/**
+ * @brief Record value as sent outside the policy (it rode along in another
+ *        attribute's frame); min/max intervals and the change restart from now.
+ */
+void report_policy_mark_sent(report_policy_t *p, uint32_t now_ms, uint16_t value);
+
+#ifdef __cplusplus
+}
+#endif
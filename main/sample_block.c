@@ -0,0 +1,116 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * sample_block.c — Delta-encoded sample block encoder / decoder
+ */
+#include "sample_block.h"
+#include "le_bytes.h"
+#include <string.h>
+
+void sample_block_init(sample_block_t *b, uint32_t interval_ms)
+{
+    memset(b, 0, sizeof(*b));
+    b->interval_ds = (uint8_t)(interval_ms / 100);
+}
+
+void sample_block_reset(sample_block_t *b)
+{
+    b->len   = 0;
+    b->count = 0;
+    b->seq++;
+}
+
+bool sample_block_add(sample_block_t *b, uint32_t tick, uint16_t value)
+{
+    if (b->len == 0) {
+        uint8_t *p = b->buf;
+        p[0] = SAMPLE_BLOCK_FORMAT;
+        p[1] = b->seq;
+        le_put32(&p[2], tick);
+        p[6] = b->interval_ds;
+        p[7] = 1;
+        le_put16(&p[8], value);
+        b->len   = SAMPLE_BLOCK_HEADER_BYTES;
+        b->count = 1;
+        b->last  = value;
+        return true;
+    }
+
+    if (tick != le_get32(&b->buf[2]) + b->count || b->count == UINT8_MAX) {
+        return false;
+    }
+
+    uint8_t enc[SAMPLE_DELTA_MAX_BYTES];
+    size_t  n = sample_delta_encode(b->last, value, enc);
+    if (b->len + n > SAMPLE_BLOCK_MAX_BYTES) {
+        return false;
+    }
+    memcpy(&b->buf[b->len], enc, n);
+    b->len += (uint8_t)n;
+    b->count++;
+    b->buf[7] = b->count;
+    b->last = value;
+    return true;
+}
+
+int sample_block_decode(const uint8_t *p, size_t len, sample_block_hdr_t *hdr, uint16_t *values, size_t cap)
+{
+    if (len < SAMPLE_BLOCK_HEADER_BYTES || p[0] != SAMPLE_BLOCK_FORMAT) {
+        return -1;
+    }
+    hdr->format      = p[0];
+    hdr->seq         = p[1];
+    hdr->base_tick   = le_get32(&p[2]);
+    hdr->interval_ds = p[6];
+    hdr->count       = p[7];
+    if (hdr->count == 0 || hdr->count > cap) {
+        return -1;
+    }
+
+    uint16_t first = le_get16(&p[8]);
+    return sample_delta_decode(&p[SAMPLE_BLOCK_HEADER_BYTES], len - SAMPLE_BLOCK_HEADER_BYTES, first, values,
+                               hdr->count) ? hdr->count : -1;
+}
+
+/* ── Delta codec ────────────────────────────────────────────────────── */
+
+size_t sample_delta_encode(uint16_t prev, uint16_t value, uint8_t *out)
+{
+    int32_t  delta = (int32_t)value - (int32_t)prev;
+    uint32_t zz    = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+    size_t   n = 0;
+    do {
+        uint8_t byte = zz & 0x7F;
+        zz >>= 7;
+        out[n++] = byte | (zz ? 0x80 : 0);
+    } while (zz);
+    return n;
+}
+
+bool sample_delta_decode(const uint8_t *p, size_t len, uint16_t first, uint16_t *values, size_t count)
+{
+    int32_t value = first;
+    values[0] = first;
+    size_t pos = 0;
+    for (size_t i = 1; i < count; i++) {
+        uint32_t zz = 0;
+        for (int shift = 0;; shift += 7) {
+            if (pos >= len || shift > 14) {
+                return false;   /* Truncated, or longer than any 16-bit delta */
+            }
+            uint8_t byte = p[pos++];
+            zz |= (uint32_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                break;
+            }
+        }
+        value += (int32_t)(zz >> 1) ^ -(int32_t)(zz & 1);
+        if (value < 0 || value > UINT16_MAX) {
+            return false;
+        }
+        values[i] = (uint16_t)value;
+    }
+    return pos == len;
+}
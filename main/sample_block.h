@@ -0,0 +1,105 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * sample_block.h — Delta-encoded block of consecutive NH₃ samples
+ *
+ * Packs the per-tick ppm of several 2 s samples into one octet-string
+ * attribute (0xFC00/0x0004), so the hub gets every sample for the radio cost
+ * of one report. Layout, little-endian:
+ *
+ *   0  u8   format (SAMPLE_BLOCK_FORMAT)
+ *   1  u8   sequence number (+1 per block, wraps; gaps = lost blocks)
+ *   2  u32  base tick: sample index of the first sample since sampling started
+ *   6  u8   sample interval, 100 ms units
+ *   7  u8   sample count n
+ *   8  u16  first value
+ *  10  ...  n−1 deltas, zigzag LEB128 varint (1 byte for |Δ| ≤ 63)
+ *
+ * Values are 0.1 ppm; SAMPLE_BLOCK_INVALID marks a failed read. Samples in a
+ * block are always consecutive ticks — a gap (dropped queue message) closes
+ * the block. The block is at most SAMPLE_BLOCK_MAX_BYTES, so it fits one
+ * unfragmented report frame whatever the deltas.
+ *
+ * Platform-independent; the Edge driver (init.lua) has the matching decoder
+ * and host/bench/sample_block_bench.c round-trips both directions.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Default for builds without sdkconfig (host); see Kconfig.projbuild */
+#ifndef CONFIG_LITTERBOX_SAMPLE_BLOCK_S
+#define CONFIG_LITTERBOX_SAMPLE_BLOCK_S     110
+#endif
+
+#define SAMPLE_BLOCK_FORMAT         0x01
+#define SAMPLE_BLOCK_HEADER_BYTES   10
+#define SAMPLE_BLOCK_MAX_BYTES      64      /* + ZCL report overhead, well under one APS frame */
+#define SAMPLE_BLOCK_MAX_SAMPLES    (1 + SAMPLE_BLOCK_MAX_BYTES - SAMPLE_BLOCK_HEADER_BYTES)   /* All 1-byte deltas */
+#define SAMPLE_BLOCK_INVALID        0xFFFF
+#define SAMPLE_DELTA_MAX_BYTES      3       /* Zigzag varint of any 16-bit delta */
+
+typedef struct {
+    uint8_t  buf[SAMPLE_BLOCK_MAX_BYTES];
+    uint8_t  len;           /* Bytes used in buf (0 = empty block) */
+    uint8_t  count;
+    uint8_t  seq;           /* Of the block being filled */
+    uint8_t  interval_ds;
+    uint16_t last;          /* Last value added (delta reference) */
+} sample_block_t;
+
+typedef struct {
+    uint8_t  format;
+    uint8_t  seq;
+    uint32_t base_tick;
+    uint8_t  interval_ds;
+    uint8_t  count;
+} sample_block_hdr_t;
+
+void sample_block_init(sample_block_t *b, uint32_t interval_ms);
+
+/**
+ * @brief Append the sample taken at tick.
+ *
+ * @return false if it does not belong in this block (full, or tick is not
+ *         the next one); the caller sends the block, resets it and adds again.
+ */
+bool sample_block_add(sample_block_t *b, uint32_t tick, uint16_t value);
+
+/**
+ * @brief Start the next block (sequence number + 1).
+ */
+void sample_block_reset(sample_block_t *b);
+
+/**
+ * @brief Decode a block into values.
+ * @return Sample count, or −1 if the block is malformed or has more than cap samples
+ */
+int sample_block_decode(const uint8_t *p, size_t len, sample_block_hdr_t *hdr, uint16_t *values, size_t cap);
+
+/* The delta codec on its own, shared with the event snippet (event_snippet.h) */
+
+/**
+ * @brief Write value − prev as a zigzag LEB128 varint.
+ * @return Bytes written to out (1..SAMPLE_DELTA_MAX_BYTES)
+ */
+size_t sample_delta_encode(uint16_t prev, uint16_t value, uint8_t *out);
+
+/**
+ * @brief Rebuild count values from the first one and the count − 1 deltas in p.
+ * @return false if the deltas are truncated, overlong, leave the 16-bit
+ *         range or do not end exactly at len
+ */
+bool sample_delta_decode(const uint8_t *p, size_t len, uint16_t first, uint16_t *values, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,52 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * sample_queue.c — Lock-free SPSC queue between the sensor and Zigbee tasks
+ */
+#include "sample_queue.h"
+#include <string.h>
+
+void sample_queue_init(sample_queue_t *q)
+{
+    memset(q->msgs, 0, sizeof(q->msgs));
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    q->dropped = 0;
+}
+
+bool sample_queue_push(sample_queue_t *q, const sample_msg_t *msg)
+{
+    uint32_t head = (uint32_t)atomic_load_explicit(&q->head, memory_order_relaxed);
+    uint32_t tail = (uint32_t)atomic_load_explicit(&q->tail, memory_order_acquire);
+
+    if (head - tail >= SAMPLE_QUEUE_LEN) {
+        q->dropped++;
+        return false;
+    }
+
+    sample_msg_t *slot = &q->msgs[head & (SAMPLE_QUEUE_LEN - 1)];
+    *slot = *msg;
+    slot->dropped = q->dropped;
+    q->dropped = 0;
+
+    /* Publish the message before the new head */
+    atomic_store_explicit(&q->head, head + 1, memory_order_release);
+    return true;
+}
+
+bool sample_queue_pop(sample_queue_t *q, sample_msg_t *out)
+{
+    uint32_t tail = (uint32_t)atomic_load_explicit(&q->tail, memory_order_relaxed);
+    uint32_t head = (uint32_t)atomic_load_explicit(&q->head, memory_order_acquire);
+
+    if (head == tail) {
+        return false;
+    }
+    *out = q->msgs[tail & (SAMPLE_QUEUE_LEN - 1)];
+
+    /* Slot may be reused by the producer only after the copy */
+    atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+    return true;
+}
@@ -0,0 +1,90 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * sample_queue.h — Sensor task → Zigbee task hand-off (CONFIG_LITTERBOX_SENSOR_TASK)
+ *
+ * The sensor task samples, runs the detector and pushes one sample_msg_t per
+ * 2 s tick. The Zigbee task polls the queue from a scheduler alarm and does
+ * the attribute updates and reports. Lock-free single-producer /
+ * single-consumer ring: the producer never blocks. If the Zigbee side stalls
+ * for longer than SAMPLE_QUEUE_LEN ticks, new samples are dropped and the
+ * count is carried in the next message that fits.
+ *
+ * With several sensor channels each tick pushes one message per channel
+ * (channel 0 first), so the ring grows with the channel count to keep the
+ * same 32 s of slack.
+ *
+ * Each message carries the detector's current event rather than a
+ * transition, so a dropped message never hides an event change: the consumer
+ * compares against what it last reported.
+ *
+ * Platform-independent (host/bench/queue_bench.c stresses it with threads).
+ */
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "event_detector.h"
+#include "air_sensor_driver.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Messages, power of two: 16 ticks (32 s at 2 s) of every channel */
+#if AIR_SENSOR_CHANNELS == 1
+#define SAMPLE_QUEUE_LEN        16
+#elif AIR_SENSOR_CHANNELS == 2
+#define SAMPLE_QUEUE_LEN        32
+#else
+#define SAMPLE_QUEUE_LEN        64
+#endif
+#define SAMPLE_QUEUE_POLL_MS    100     /* Zigbee-side poll period */
+
+#define SAMPLE_FLAG_VALID       0x01    /* Sensor read succeeded */
+#define SAMPLE_FLAG_WARMUP      0x02    /* Heater not settled (detector held) */
+
+typedef struct {
+    uint32_t tick;          /* Sample index since sampling started */
+    uint32_t dropped;       /* Messages lost to a full queue just before this one (filled in by push) */
+    int64_t  t_us;          /* esp_timer time of the ADC read */
+    uint32_t raw_adc;
+    int32_t  ppm_q;         /* Q15.16 ppm (EVENT_PPM_Q_SHIFT) */
+    int32_t  baseline_q;    /* Detector baseline after this sample, Q15.16 */
+    int32_t  peak_q;        /* Peak of the current / last event, Q15.16 */
+    uint16_t event_ticks;   /* Length of its ACTIVE phase, ticks */
+    uint16_t nh3_ppm;       /* Value to report (fallback if the read failed) */
+    uint8_t  event;         /* litter_event_t after this sample */
+    uint8_t  state;         /* detector_state_t after this sample */
+    uint8_t  flags;         /* SAMPLE_FLAG_* */
+    uint8_t  provisional;   /* Provisional litter_event_t while ACTIVE, NONE otherwise */
+    uint8_t  confidence;    /* ... its confidence, 0–100 % */
+    uint8_t  channel;       /* Sensor channel, 0 .. AIR_SENSOR_CHANNELS − 1 */
+    event_features_t features;  /* Of the current / last finished event */
+} sample_msg_t;
+
+typedef struct {
+    sample_msg_t         msgs[SAMPLE_QUEUE_LEN];
+    atomic_uint_fast32_t head;      /* Messages pushed (producer only) */
+    atomic_uint_fast32_t tail;      /* Messages popped (consumer only) */
+    uint32_t             dropped;   /* Since the last successful push (producer only) */
+} sample_queue_t;
+
+void sample_queue_init(sample_queue_t *q);
+
+/**
+ * @brief Producer side. Never blocks; returns false (and counts a drop) if full.
+ */
+bool sample_queue_push(sample_queue_t *q, const sample_msg_t *msg);
+
+/**
+ * @brief Consumer side. Returns false if empty.
+ */
+bool sample_queue_pop(sample_queue_t *q, sample_msg_t *out);
+
+#ifdef __cplusplus
+}
+#endif
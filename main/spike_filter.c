@@ -0,0 +1,90 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * spike_filter.c — Streaming Hampel filter implementation
+ */
+#include "spike_filter.h"
+#include <string.h>
+
+esp_err_t spike_filter_init(spike_filter_t *f, uint8_t window, uint8_t k_tenths, int32_t min_dev_q)
+{
+    if (!f || window < 3 || window > SPIKE_FILTER_MAX_WINDOW || !(window & 1) || min_dev_q < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(f, 0, sizeof(*f));
+    f->window    = window;
+    f->k_tenths  = k_tenths;
+    f->min_dev_q = min_dev_q;
+    return ESP_OK;
+}
+
+/* Put v at sorted[i] and move it into order (the rest is already sorted) */
+static void resort(int32_t *s, int n, int i, int32_t v)
+{
+    while (i > 0 && s[i - 1] > v) {
+        s[i] = s[i - 1];
+        i--;
+    }
+    while (i < n - 1 && s[i + 1] < v) {
+        s[i] = s[i + 1];
+        i++;
+    }
+    s[i] = v;
+}
+
+bool spike_filter_push(spike_filter_t *f, int32_t ppm_q, int32_t *out)
+{
+    *out = ppm_q;
+    int n = f->window;
+
+    if (f->count < n) {
+        /* Filling: append, nothing to compare against yet */
+        f->ring[(f->head + f->count) % n] = ppm_q;
+        f->count++;
+        resort(f->sorted, f->count, f->count - 1, ppm_q);
+        return false;
+    }
+
+    /* Full: the newest reading takes the oldest one's place in both orders */
+    int32_t old = f->ring[f->head];
+    f->ring[f->head] = ppm_q;
+    f->head = (uint8_t)((f->head + 1) % n);
+    int i = 0;
+    while (f->sorted[i] != old) {
+        i++;
+    }
+    resort(f->sorted, n, i, ppm_q);
+
+    /* Median, then MAD: the (N−1)/2-th smallest |x − median|, merged outward */
+    const int32_t *s = f->sorted;
+    int     mid = n / 2;
+    int32_t med = s[mid];
+    int32_t mad = 0;
+    int l = mid - 1, r = mid + 1;
+    for (int k = 0; k < mid; k++) {
+        int32_t dl = l >= 0 ? med - s[l] : INT32_MAX;
+        int32_t dr = r < n ? s[r] - med : INT32_MAX;
+        if (dl <= dr) {
+            mad = dl;
+            l--;
+        } else {
+            mad = dr;
+            r++;
+        }
+    }
+
+    /* k · 1.4826 · MAD, k in tenths */
+    int64_t thr = (int64_t)mad * f->k_tenths * 14826 / 100000;
+    if (thr < f->min_dev_q) {
+        thr = f->min_dev_q;
+    }
+    int64_t dev = (int64_t)ppm_q - med;
+    if (dev > thr || -dev > thr) {
+        *out = med;
+        f->rejected++;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,88 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * spike_filter.h — Streaming Hampel filter between air_sensor_read() and the detector
+ *
+ * A single bad reading (a heater current spike, or v_adc clamped to its
+ * 0.001 V floor) converts to an absurd ppm value that would start a false
+ * ACTIVE or become the peak an event is classified on. The filter keeps
+ * the last N readings (N odd) and replaces the newest by the window median
+ * when it lies further from it than
+ *
+ *   max(k · 1.4826 · MAD, min_dev)
+ *
+ * (MAD = median absolute deviation from the median; 1.4826 · MAD estimates
+ * σ for Gaussian noise). Bursts of up to (N−1)/2 readings are removed; a
+ * real step is passed through once (N+1)/2 readings agree, i.e. onsets are
+ * delayed by at most (N−1)/2 ticks and only when they jump by more than
+ * the threshold in a single tick. The window keeps the unfiltered readings
+ * so a genuine level change is never locked out.
+ *
+ * The window is held both in arrival order and sorted; a push moves at most
+ * N−1 entries in each and the MAD is a merge outward from the median, so a
+ * sample costs O(N) with N ≤ SPIKE_FILTER_MAX_WINDOW — constant per tick,
+ * fixed memory, no allocation.
+ *
+ * Values are Q15.16 ppm (EVENT_PPM_Q_SHIFT), integer-only, so both
+ * detector back-ends see the same decisions. Until the window has filled
+ * readings pass unchanged. Not thread-safe: one owner (the sampling
+ * context). host/bench/spike_bench.c measures the per-sample cost and the
+ * false triggers removed on traces with injected spikes.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Defaults for builds without sdkconfig (host); see Kconfig.projbuild */
+#ifndef CONFIG_LITTERBOX_SPIKE_FILTER
+#define CONFIG_LITTERBOX_SPIKE_FILTER           1
+#endif
+#ifndef CONFIG_LITTERBOX_SPIKE_FILTER_WINDOW
+#define CONFIG_LITTERBOX_SPIKE_FILTER_WINDOW    5
+#endif
+
+#define SPIKE_FILTER_MAX_WINDOW     9
+#define SPIKE_FILTER_K_TENTHS       30      /* k = 3.0 */
+#define SPIKE_FILTER_MIN_DEV_PPM    10      /* Floor: steep event rises pass; smaller spikes cannot trigger alone */
+
+typedef struct {
+    int32_t  ring[SPIKE_FILTER_MAX_WINDOW];     /* Readings in arrival order */
+    int32_t  sorted[SPIKE_FILTER_MAX_WINDOW];   /* Same readings, ascending */
+    int32_t  min_dev_q;
+    uint8_t  window;            /* N */
+    uint8_t  k_tenths;
+    uint8_t  head;              /* Oldest reading in ring */
+    uint8_t  count;             /* Readings held, ≤ window */
+    uint32_t rejected;          /* Readings replaced since init */
+} spike_filter_t;
+
+/**
+ * @brief Initialize (or reset) a filter.
+ *
+ * @param window     N, odd, 3..SPIKE_FILTER_MAX_WINDOW
+ * @param k_tenths   Threshold in tenths of the MAD-estimated σ (30 = 3σ)
+ * @param min_dev_q  Threshold floor, Q15.16 ppm
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG for an even or out-of-range window
+ */
+esp_err_t spike_filter_init(spike_filter_t *f, uint8_t window, uint8_t k_tenths, int32_t min_dev_q);
+
+/**
+ * @brief Push one reading.
+ *
+ * @param ppm_q      Reading, Q15.16 ppm
+ * @param[out] out   Value for the detector: ppm_q, or the window median if rejected
+ * @return true if the reading was rejected as a spike
+ */
+bool spike_filter_push(spike_filter_t *f, int32_t ppm_q, int32_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,132 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * stage_stats.c — Per-stage cycle histograms
+ */
+#include "stage_stats.h"
+#include "esp_log.h"
+#include <inttypes.h>
+#include <string.h>
+
+static const char *TAG = "STATS";
+
+#define SUB_MASK    ((1u << STAGE_HIST_SUB_BITS) - 1)
+
+/* ── Histogram ──────────────────────────────────────────────────────── */
+
+static unsigned bucket_of(uint32_t v)
+{
+    if (v < (1u << STAGE_HIST_MIN_OCTAVE)) {
+        return 0;
+    }
+    unsigned octave = 31u - (unsigned)__builtin_clz(v);
+    unsigned b = ((octave - STAGE_HIST_MIN_OCTAVE) << STAGE_HIST_SUB_BITS)
+               | ((v >> (octave - STAGE_HIST_SUB_BITS)) & SUB_MASK);
+    return b < STAGE_HIST_BUCKETS ? b : STAGE_HIST_BUCKETS - 1;
+}
+
+/* Midpoint of bucket b */
+static uint32_t bucket_mid(unsigned b)
+{
+    unsigned shift = (b >> STAGE_HIST_SUB_BITS) + STAGE_HIST_MIN_OCTAVE - STAGE_HIST_SUB_BITS;
+    uint32_t lower = ((1u << STAGE_HIST_SUB_BITS) | (b & SUB_MASK)) << shift;
+    return lower + ((1u << shift) >> 1);
+}
+
+void stage_hist_reset(stage_hist_t *h)
+{
+    memset(h, 0, sizeof(*h));
+}
+
+void stage_hist_add(stage_hist_t *h, uint32_t cycles)
+{
+    h->count++;
+    h->sum += cycles;
+    if (h->count == 1 || cycles < h->min) {
+        h->min = cycles;
+    }
+    if (cycles > h->max) {
+        h->max = cycles;
+    }
+    h->hist[bucket_of(cycles)]++;
+}
+
+uint32_t stage_hist_percentile(const stage_hist_t *h, uint32_t permille)
+{
+    if (h->count == 0) {
+        return 0;
+    }
+    /* Smallest value with at least ceil(count·p) samples at or below it */
+    uint64_t rank = ((uint64_t)h->count * permille + 999) / 1000;
+    uint64_t seen = 0;
+    uint32_t v = h->max;
+    for (unsigned b = 0; b < STAGE_HIST_BUCKETS; b++) {
+        seen += h->hist[b];
+        if (seen >= rank && h->hist[b]) {
+            v = bucket_mid(b);
+            break;
+        }
+    }
+    if (v < h->min) {
+        v = h->min;
+    }
+    if (v > h->max) {
+        v = h->max;
+    }
+    return v;
+}
+
+void stage_hist_summary(const stage_hist_t *h, stage_summary_t *out)
+{
+    out->count = h->count;
+    out->min   = h->min;
+    out->max   = h->max;
+    out->avg   = h->count ? (uint32_t)(h->sum / h->count) : 0;
+    out->p99   = stage_hist_percentile(h, 990);
+}
+
+/* ── Per-stage table ────────────────────────────────────────────────── */
+
+static stage_hist_t s_stages[STAGE_COUNT];
+
+const char *stage_name(stage_id_t stage)
+{
+    static const char *names[STAGE_COUNT] = {
+        "adc_read", "ppm_convert", "detector", "zb_lock_wait", "report_set", "report_send", "tick_total", "tick_jitter",
+    };
+    return stage < STAGE_COUNT ? names[stage] : "?";
+}
+
+void stage_stats_reset(void)
+{
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        stage_hist_reset(&s_stages[i]);
+    }
+}
+
+void stage_stats_record(stage_id_t stage, uint32_t cycles)
+{
+    if (stage < STAGE_COUNT) {
+        stage_hist_add(&s_stages[stage], cycles);
+    }
+}
+
+void stage_stats_summary(stage_id_t stage, stage_summary_t *out)
+{
+    stage_hist_summary(&s_stages[stage], out);
+}
+
+void stage_stats_log(void)
+{
+    ESP_LOGI(TAG, "%-12s %8s %8s %8s %8s %8s  (µs @ %d MHz)", "stage", "n", "min", "avg", "p99", "max",
+             CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        stage_summary_t s;
+        stage_stats_summary((stage_id_t)i, &s);
+        ESP_LOGI(TAG, "%-12s %8"PRIu32" %8"PRIu32" %8"PRIu32" %8"PRIu32" %8"PRIu32,
+                 stage_name((stage_id_t)i), s.count, stage_cycles_to_us(s.min), stage_cycles_to_us(s.avg),
+                 stage_cycles_to_us(s.p99), stage_cycles_to_us(s.max));
+    }
+}
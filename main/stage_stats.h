@@ -0,0 +1,126 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * stage_stats.h — Per-stage cycle histograms for the 2 s sample path
+ *
+ * Each instrumented stage keeps count/min/max/sum and a log-linear histogram
+ * of CPU cycles. There are 2^STAGE_HIST_SUB_BITS bins per power of two, so a
+ * percentile read from the histogram is within ±1/2^(SUB_BITS+1) (12.5 %)
+ * of the exact value. Recording is O(1), integer-only, and needs no lock:
+ * each stage has a single writer task. Readers (periodic log, diagnostics
+ * cluster) may see a summary that is one sample out of date.
+ *
+ * Statistics accumulate from boot. They are exposed:
+ *  - on serial: stage_stats_log() every CONFIG_LITTERBOX_STAGE_STATS_LOG_MIN
+ *  - over Zigbee: read-only attributes of the diagnostics cluster (0xFC01,
+ *    see main.h), refreshed every STAGE_STATS_PUBLISH_TICKS
+ *
+ * Durations that are not cycle-counted (tick jitter, from esp_timer) are
+ * stored as cycle equivalents so every stage reads back in µs the same way.
+ *
+ * STAGE_BEGIN()/STAGE_END()/STAGE_RECORD_US() compile to nothing without
+ * CONFIG_LITTERBOX_STAGE_STATS. The histogram code itself is
+ * platform-independent (host/bench/stage_stats_bench.c).
+ */
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ
+#define CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ     160     /* Host builds: ESP32-C6 default */
+#endif
+#ifndef CONFIG_LITTERBOX_STAGE_STATS_LOG_MIN
+#define CONFIG_LITTERBOX_STAGE_STATS_LOG_MIN 10
+#endif
+
+#define STAGE_HIST_SUB_BITS         2       /* 4 bins per octave */
+#define STAGE_HIST_MIN_OCTAVE       4       /* First bin starts at 16 cycles */
+#define STAGE_HIST_OCTAVES          24      /* Up to 2^28 cycles (~1.7 s @ 160 MHz); beyond → last bin */
+#define STAGE_HIST_BUCKETS          (STAGE_HIST_OCTAVES << STAGE_HIST_SUB_BITS)
+
+#define STAGE_STATS_PUBLISH_TICKS   30      /* Diagnostics attributes refresh: 60 s @ 2 s */
+
+typedef enum {
+    STAGE_ADC_READ = 0,     /* mq135_sample_raw(): oneshot read or latest decimated code */
+    STAGE_PPM_CONVERT,      /* raw → ppm (powf chain or LUT) */
+    STAGE_DETECTOR,         /* event_detector_update*() */
+    STAGE_ZB_LOCK_WAIT,     /* esp_zb_lock_acquire() */
+    STAGE_REPORT_SET,       /* Attribute updates + report_mgr_set() for the tick */
+    STAGE_REPORT_SEND,      /* report_flush(): retries, frame build, send */
+    STAGE_TICK_TOTAL,       /* Sampling side of one tick (sensor task, or whole callback without it) */
+    STAGE_TICK_JITTER,      /* |sample period − SENSOR_SAMPLE_INTERVAL_MS|, recorded as cycles */
+    STAGE_COUNT
+} stage_id_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t hist[STAGE_HIST_BUCKETS];
+} stage_hist_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t avg;
+    uint32_t p99;
+    uint32_t max;
+} stage_summary_t;
+
+/* ── Histogram (platform-independent) ──────────────────────────────── */
+
+void stage_hist_reset(stage_hist_t *h);
+void stage_hist_add(stage_hist_t *h, uint32_t cycles);
+
+/**
+ * @brief Percentile estimate (permille: 500 = median, 990 = p99), clamped to [min, max].
+ */
+uint32_t stage_hist_percentile(const stage_hist_t *h, uint32_t permille);
+
+void stage_hist_summary(const stage_hist_t *h, stage_summary_t *out);
+
+/* ── Per-stage table ────────────────────────────────────────────────── */
+
+const char *stage_name(stage_id_t stage);
+void stage_stats_reset(void);
+void stage_stats_record(stage_id_t stage, uint32_t cycles);
+void stage_stats_summary(stage_id_t stage, stage_summary_t *out);
+
+/**
+ * @brief One ESP_LOGI line per stage: n, min/avg/p99/max in µs.
+ */
+void stage_stats_log(void);
+
+static inline uint32_t stage_cycles_to_us(uint32_t cycles)
+{
+    return (cycles + CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ / 2) / CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+}
+
+/* Saturates at ~26 s @ 160 MHz */
+static inline uint32_t stage_us_to_cycles(uint64_t us)
+{
+    uint64_t c = us * CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+    return c > UINT32_MAX ? UINT32_MAX : (uint32_t)c;
+}
+
+#if CONFIG_LITTERBOX_STAGE_STATS
+#include "esp_cpu.h"
+#define STAGE_BEGIN(t0)         uint32_t t0 = esp_cpu_get_cycle_count()
+#define STAGE_END(stage, t0)    stage_stats_record((stage), esp_cpu_get_cycle_count() - (t0))
+#define STAGE_RECORD_US(stage, us)  stage_stats_record((stage), stage_us_to_cycles(us))
+#else
+#define STAGE_BEGIN(t0)         do { } while (0)
+#define STAGE_END(stage, t0)    do { } while (0)
+#define STAGE_RECORD_US(stage, us)  do { (void)(us); } while (0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
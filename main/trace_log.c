@@ -0,0 +1,174 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * trace_log.c — Binary per-tick trace: frame codec, SPSC ring, drain task
+ */
+#include "trace_log.h"
+#include "le_bytes.h"
+#include <string.h>
+
+#if CONFIG_LITTERBOX_BINARY_TRACE
+#include <stdio.h>
+#include "esp_check.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#endif
+
+/* ── Frame codec ────────────────────────────────────────────────────── */
+
+/* CRC-8, polynomial 0x07, init 0 */
+static const uint8_t s_crc8_table[256] = {
+    0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D,
+    0x70, 0x77, 0x7E, 0x79, 0x6C, 0x6B, 0x62, 0x65, 0x48, 0x4F, 0x46, 0x41, 0x54, 0x53, 0x5A, 0x5D,
+    0xE0, 0xE7, 0xEE, 0xE9, 0xFC, 0xFB, 0xF2, 0xF5, 0xD8, 0xDF, 0xD6, 0xD1, 0xC4, 0xC3, 0xCA, 0xCD,
+    0x90, 0x97, 0x9E, 0x99, 0x8C, 0x8B, 0x82, 0x85, 0xA8, 0xAF, 0xA6, 0xA1, 0xB4, 0xB3, 0xBA, 0xBD,
+    0xC7, 0xC0, 0xC9, 0xCE, 0xDB, 0xDC, 0xD5, 0xD2, 0xFF, 0xF8, 0xF1, 0xF6, 0xE3, 0xE4, 0xED, 0xEA,
+    0xB7, 0xB0, 0xB9, 0xBE, 0xAB, 0xAC, 0xA5, 0xA2, 0x8F, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9D, 0x9A,
+    0x27, 0x20, 0x29, 0x2E, 0x3B, 0x3C, 0x35, 0x32, 0x1F, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0D, 0x0A,
+    0x57, 0x50, 0x59, 0x5E, 0x4B, 0x4C, 0x45, 0x42, 0x6F, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7D, 0x7A,
+    0x89, 0x8E, 0x87, 0x80, 0x95, 0x92, 0x9B, 0x9C, 0xB1, 0xB6, 0xBF, 0xB8, 0xAD, 0xAA, 0xA3, 0xA4,
+    0xF9, 0xFE, 0xF7, 0xF0, 0xE5, 0xE2, 0xEB, 0xEC, 0xC1, 0xC6, 0xCF, 0xC8, 0xDD, 0xDA, 0xD3, 0xD4,
+    0x69, 0x6E, 0x67, 0x60, 0x75, 0x72, 0x7B, 0x7C, 0x51, 0x56, 0x5F, 0x58, 0x4D, 0x4A, 0x43, 0x44,
+    0x19, 0x1E, 0x17, 0x10, 0x05, 0x02, 0x0B, 0x0C, 0x21, 0x26, 0x2F, 0x28, 0x3D, 0x3A, 0x33, 0x34,
+    0x4E, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5C, 0x5B, 0x76, 0x71, 0x78, 0x7F, 0x6A, 0x6D, 0x64, 0x63,
+    0x3E, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2C, 0x2B, 0x06, 0x01, 0x08, 0x0F, 0x1A, 0x1D, 0x14, 0x13,
+    0xAE, 0xA9, 0xA0, 0xA7, 0xB2, 0xB5, 0xBC, 0xBB, 0x96, 0x91, 0x98, 0x9F, 0x8A, 0x8D, 0x84, 0x83,
+    0xDE, 0xD9, 0xD0, 0xD7, 0xC2, 0xC5, 0xCC, 0xCB, 0xE6, 0xE1, 0xE8, 0xEF, 0xFA, 0xFD, 0xF4, 0xF3,
+};
+
+uint8_t trace_crc8(const uint8_t *data, size_t len)
+{
+    uint8_t crc = 0;
+    while (len--) {
+        crc = s_crc8_table[crc ^ *data++];
+    }
+    return crc;
+}
+
+void trace_encode(const trace_record_t *rec, uint8_t frame[TRACE_FRAME_BYTES])
+{
+    frame[0] = TRACE_SYNC0;
+    frame[1] = TRACE_SYNC1;
+    le_put32(&frame[2], rec->tick);
+    le_put16(&frame[6], rec->raw);
+    le_put32(&frame[8], (uint32_t)rec->ppm_q);
+    le_put32(&frame[12], (uint32_t)rec->baseline_q);
+    frame[16] = rec->state;
+    frame[17] = rec->event;
+    frame[18] = rec->dropped;
+    frame[19] = trace_crc8(&frame[2], TRACE_FRAME_BYTES - 3);
+}
+
+bool trace_decode(const uint8_t frame[TRACE_FRAME_BYTES], trace_record_t *rec)
+{
+    if (frame[0] != TRACE_SYNC0 || frame[1] != TRACE_SYNC1
+        || frame[19] != trace_crc8(&frame[2], TRACE_FRAME_BYTES - 3)) {
+        return false;
+    }
+    rec->tick       = le_get32(&frame[2]);
+    rec->raw        = le_get16(&frame[6]);
+    rec->ppm_q      = (int32_t)le_get32(&frame[8]);
+    rec->baseline_q = (int32_t)le_get32(&frame[12]);
+    rec->state      = frame[16];
+    rec->event      = frame[17];
+    rec->dropped    = frame[18];
+    return true;
+}
+
+/* ── SPSC ring ──────────────────────────────────────────────────────── */
+
+void trace_ring_init(trace_ring_t *r)
+{
+    memset(r->frames, 0, sizeof(r->frames));
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    r->dropped = 0;
+}
+
+bool trace_ring_push(trace_ring_t *r, const trace_record_t *rec)
+{
+    uint32_t head = (uint32_t)atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint32_t tail = (uint32_t)atomic_load_explicit(&r->tail, memory_order_acquire);
+
+    if (head - tail >= TRACE_RING_LEN) {
+        r->dropped++;
+        return false;
+    }
+
+    trace_record_t stamped = *rec;
+    stamped.dropped = (uint8_t)(r->dropped > UINT8_MAX ? UINT8_MAX : r->dropped);
+    trace_encode(&stamped, r->frames[head & (TRACE_RING_LEN - 1)]);
+    r->dropped = 0;
+
+    /* Publish the frame bytes before the new head */
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+    return true;
+}
+
+size_t trace_ring_peek(trace_ring_t *r, const uint8_t **data)
+{
+    uint32_t tail = (uint32_t)atomic_load_explicit(&r->tail, memory_order_relaxed);
+    uint32_t head = (uint32_t)atomic_load_explicit(&r->head, memory_order_acquire);
+    uint32_t idx  = tail & (TRACE_RING_LEN - 1);
+    uint32_t n    = head - tail;
+
+    if (n > TRACE_RING_LEN - idx) {
+        n = TRACE_RING_LEN - idx;   /* Up to the wrap; the rest on the next call */
+    }
+    *data = r->frames[idx];
+    return n;
+}
+
+void trace_ring_consume(trace_ring_t *r, size_t n)
+{
+    uint32_t tail = (uint32_t)atomic_load_explicit(&r->tail, memory_order_relaxed);
+    /* Slots are free for the producer only after the consumer is done reading */
+    atomic_store_explicit(&r->tail, tail + (uint32_t)n, memory_order_release);
+}
+
+/* ── Firmware: drain task ───────────────────────────────────────────── */
+
+#if CONFIG_LITTERBOX_BINARY_TRACE
+
+static const char *TAG = "TRACE";
+static trace_ring_t s_ring;
+
+static void trace_drain_task(void *arg)
+{
+    for (;;) {
+        vTaskDelay(pdMS_TO_TICKS(TRACE_DRAIN_PERIOD_MS));
+
+        const uint8_t *data;
+        size_t n;
+        bool wrote = false;
+        while ((n = trace_ring_peek(&s_ring, &data)) > 0) {
+            /* One fwrite per run keeps frames whole between log lines */
+            fwrite(data, TRACE_FRAME_BYTES, n, stdout);
+            trace_ring_consume(&s_ring, n);
+            wrote = true;
+        }
+        if (wrote) {
+            fflush(stdout);
+        }
+    }
+}
+
+esp_err_t trace_log_init(void)
+{
+    trace_ring_init(&s_ring);
+    ESP_RETURN_ON_FALSE(xTaskCreate(trace_drain_task, "trace_drain", TRACE_DRAIN_STACK, NULL,
+                                    TRACE_DRAIN_PRIORITY, NULL) == pdPASS,
+                        ESP_ERR_NO_MEM, TAG, "Failed to create drain task");
+    ESP_LOGI(TAG, "Binary trace on console: %d-byte frames, %d-frame ring", TRACE_FRAME_BYTES, TRACE_RING_LEN);
+    return ESP_OK;
+}
+
+void trace_log_write(const trace_record_t *rec)
+{
+    trace_ring_push(&s_ring, rec);
+}
+
+#endif /* CONFIG_LITTERBOX_BINARY_TRACE */
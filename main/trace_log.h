@@ -0,0 +1,112 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * trace_log.h — Binary per-tick trace (CONFIG_LITTERBOX_BINARY_TRACE)
+ *
+ * One fixed-size frame per 2 s sample replaces the formatted per-tick log
+ * lines. The sample callback encodes the frame (integer only) into a
+ * lock-free single-producer/single-consumer ring. A low-priority task drains
+ * the ring to the console in batches, so no vfprintf or UART wait runs in
+ * the Zigbee task.
+ *
+ * Frame (TRACE_FRAME_BYTES, little-endian):
+ *   0  u8   TRACE_SYNC0
+ *   1  u8   TRACE_SYNC1
+ *   2  u32  tick        sample count since boot
+ *   6  u16  raw         ADC code (0 if the read failed)
+ *   8  i32  ppm_q       Q15.16 ppm
+ *  12  i32  baseline_q  Q15.16 ppm
+ *  16  u8   state       detector_state_t (low nibble) | TRACE_FLAG_* (high nibble)
+ *  17  u8   event       litter_event_t
+ *  18  u8   dropped     frames lost to a full ring just before this one (saturating)
+ *  19  u8   crc         CRC-8 (poly 0x07) over bytes 2..18
+ *
+ * Frames share the console with text logs. host/tools/trace_decode finds
+ * them by sync bytes and CRC, and undoes the console's LF → CRLF expansion.
+ *
+ * The record/ring part is platform-independent (host tools link it);
+ * trace_log_init()/trace_log_write() exist only in firmware builds with
+ * CONFIG_LITTERBOX_BINARY_TRACE.
+ */
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TRACE_SYNC0             0xA5
+#define TRACE_SYNC1             0x5A
+#define TRACE_FRAME_BYTES       20
+#define TRACE_RING_LEN          64      /* Frames, power of two (128 s at 2 s) */
+#define TRACE_DRAIN_PERIOD_MS   1000
+#define TRACE_DRAIN_STACK       3072
+#define TRACE_DRAIN_PRIORITY    1       /* Just above idle */
+
+#define TRACE_STATE_MASK        0x0F
+#define TRACE_FLAG_WARMUP       0x10    /* Sensor still warming up (detector held) */
+#define TRACE_FLAG_INVALID      0x20    /* Sensor read failed */
+
+typedef struct {
+    uint32_t tick;
+    uint16_t raw;
+    int32_t  ppm_q;
+    int32_t  baseline_q;
+    uint8_t  state;         /* detector_state_t | TRACE_FLAG_* */
+    uint8_t  event;
+    uint8_t  dropped;       /* Filled in by trace_ring_push() */
+} trace_record_t;
+
+typedef struct {
+    uint8_t          frames[TRACE_RING_LEN][TRACE_FRAME_BYTES];
+    atomic_uint_fast32_t head;      /* Frames pushed (producer only) */
+    atomic_uint_fast32_t tail;      /* Frames consumed (consumer only) */
+    uint32_t         dropped;       /* Since the last successful push (producer only) */
+} trace_ring_t;
+
+uint8_t trace_crc8(const uint8_t *data, size_t len);
+
+void trace_encode(const trace_record_t *rec, uint8_t frame[TRACE_FRAME_BYTES]);
+
+/**
+ * @brief Decode one frame. Returns false on bad sync or CRC.
+ */
+bool trace_decode(const uint8_t frame[TRACE_FRAME_BYTES], trace_record_t *rec);
+
+void trace_ring_init(trace_ring_t *r);
+
+/**
+ * @brief Producer side: encode rec into the next free slot.
+ *        Never blocks; if the ring is full the frame is counted as dropped
+ *        and reported in the next frame that fits.
+ */
+bool trace_ring_push(trace_ring_t *r, const trace_record_t *rec);
+
+/**
+ * @brief Consumer side: contiguous run of queued frames starting at *data.
+ * @return Number of frames (0 if empty); release them with trace_ring_consume()
+ */
+size_t trace_ring_peek(trace_ring_t *r, const uint8_t **data);
+
+void trace_ring_consume(trace_ring_t *r, size_t n);
+
+/**
+ * @brief Start the drain task. Call once before the first trace_log_write().
+ */
+esp_err_t trace_log_init(void);
+
+/**
+ * @brief Queue one record (sample callback context; lock-free, never blocks).
+ */
+void trace_log_write(const trace_record_t *rec);
+
+#ifdef __cplusplus
+}
+#endif
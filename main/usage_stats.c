@@ -0,0 +1,267 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * usage_stats.c — Hour / day rings, NVS storage and attribute records
+ */
+#include "usage_stats.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "le_bytes.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "USAGE";
+
+static const uint16_t k_hist_edges[USAGE_STATS_HIST_BINS - 1] = USAGE_STATS_HIST_EDGES_DPPM;
+
+/* NVS blob: the rings and where the current hour / day stand */
+typedef struct {
+    uint8_t        version;
+    uint8_t        hour_head;
+    uint8_t        day_head;
+    uint8_t        hours_used;
+    uint8_t        days_used;
+    uint8_t        hour_of_day;
+    uint16_t       hour_s;
+    usage_bucket_t hour[USAGE_STATS_HOURS];
+    usage_bucket_t day[USAGE_STATS_DAYS];
+} stats_blob_t;
+
+static stats_blob_t s_blob;         /* ~0.9 KB staging copy, kept off the Zigbee task stack */
+
+static void bucket_clear(usage_bucket_t *b)
+{
+    memset(b, 0, sizeof(*b));
+    b->baseline_min_dppm = USAGE_STATS_NO_BASELINE;
+}
+
+static void bucket_baseline(usage_bucket_t *b, uint16_t dppm)
+{
+    if (b->baseline_min_dppm == USAGE_STATS_NO_BASELINE || dppm < b->baseline_min_dppm) {
+        b->baseline_min_dppm = dppm;
+    }
+    if (dppm > b->baseline_max_dppm) {
+        b->baseline_max_dppm = dppm;
+    }
+}
+
+static uint16_t add_u16(uint16_t a, uint32_t b)
+{
+    return (uint16_t)(a + b > UINT16_MAX ? UINT16_MAX : a + b);
+}
+
+/* Fold b into acc (counts saturate) */
+static void bucket_add(usage_bucket_t *acc, const usage_bucket_t *b)
+{
+    for (int t = 0; t < 2; t++) {
+        acc->count[t] = add_u16(acc->count[t], b->count[t]);
+        acc->duration_s[t] += b->duration_s[t];
+    }
+    for (int k = 0; k < USAGE_STATS_HIST_BINS; k++) {
+        acc->hist[k] = add_u16(acc->hist[k], b->hist[k]);
+    }
+    if (b->baseline_min_dppm != USAGE_STATS_NO_BASELINE) {
+        bucket_baseline(acc, b->baseline_min_dppm);
+        bucket_baseline(acc, b->baseline_max_dppm);
+    }
+}
+
+/* ── NVS ────────────────────────────────────────────────────────────── */
+
+static void stats_save(usage_stats_t *s)
+{
+    if (!s->nvs_open) {
+        return;
+    }
+    stats_blob_t *blob = &s_blob;
+    blob->version     = USAGE_STATS_VERSION;
+    blob->hour_head   = s->hour_head;
+    blob->day_head    = s->day_head;
+    blob->hours_used  = s->hours_used;
+    blob->days_used   = s->days_used;
+    blob->hour_of_day = s->hour_of_day;
+    blob->hour_s      = s->hour_s;
+    memcpy(blob->hour, s->hour, sizeof(blob->hour));
+    memcpy(blob->day, s->day, sizeof(blob->day));
+    esp_err_t err = nvs_set_blob(s->nvs, s->key, blob, sizeof(*blob));
+    if (err == ESP_OK) {
+        err = nvs_commit(s->nvs);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Saving usage statistics failed (%s) — kept in RAM only", esp_err_to_name(err));
+    }
+}
+
+esp_err_t usage_stats_open(usage_stats_t *s, const char *key)
+{
+    memset(s, 0, sizeof(*s));
+    snprintf(s->key, sizeof(s->key), "%s", key);
+    for (int i = 0; i < USAGE_STATS_HOURS; i++) {
+        bucket_clear(&s->hour[i]);
+    }
+    for (int i = 0; i < USAGE_STATS_DAYS; i++) {
+        bucket_clear(&s->day[i]);
+    }
+    s->hours_used = 1;
+    s->days_used  = 1;
+    ESP_RETURN_ON_ERROR(nvs_open(USAGE_STATS_NAMESPACE, NVS_READWRITE, &s->nvs), TAG, "nvs_open failed");
+    s->nvs_open = true;
+
+    stats_blob_t *blob = &s_blob;
+    size_t len = sizeof(*blob);
+    esp_err_t err = nvs_get_blob(s->nvs, s->key, blob, &len);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        return ESP_OK;
+    }
+    /* A different USAGE_STATS_DAYS changes the size: start over rather than misread */
+    if (err != ESP_OK || len != sizeof(*blob) || blob->version != USAGE_STATS_VERSION
+        || blob->hour_head >= USAGE_STATS_HOURS || blob->day_head >= USAGE_STATS_DAYS
+        || blob->hours_used == 0 || blob->hours_used > USAGE_STATS_HOURS
+        || blob->days_used == 0 || blob->days_used > USAGE_STATS_DAYS
+        || blob->hour_of_day >= USAGE_STATS_HOURS || blob->hour_s >= USAGE_STATS_HOUR_S) {
+        ESP_LOGW(TAG, "Ignoring unreadable usage statistics (%s, %u bytes)", esp_err_to_name(err), (unsigned)len);
+        return ESP_OK;
+    }
+
+    s->hour_head   = blob->hour_head;
+    s->day_head    = blob->day_head;
+    s->hours_used  = blob->hours_used;
+    s->days_used   = blob->days_used;
+    s->hour_of_day = blob->hour_of_day;
+    s->hour_s      = blob->hour_s;
+    memcpy(s->hour, blob->hour, sizeof(s->hour));
+    memcpy(s->day, blob->day, sizeof(s->day));
+    ESP_LOGI(TAG, "Usage statistics restored: %u h, %u day(s)", s->hours_used, s->days_used);
+    return ESP_OK;
+}
+
+/* ── Rings ──────────────────────────────────────────────────────────── */
+
+static void hour_rollover(usage_stats_t *s)
+{
+    s->hour_head = (uint8_t)((s->hour_head + 1) % USAGE_STATS_HOURS);
+    bucket_clear(&s->hour[s->hour_head]);
+    if (s->hours_used < USAGE_STATS_HOURS) {
+        s->hours_used++;
+    }
+    if (++s->hour_of_day == USAGE_STATS_HOURS) {
+        s->hour_of_day = 0;
+        s->day_head = (uint8_t)((s->day_head + 1) % USAGE_STATS_DAYS);
+        bucket_clear(&s->day[s->day_head]);
+        if (s->days_used < USAGE_STATS_DAYS) {
+            s->days_used++;
+        }
+    }
+}
+
+bool usage_stats_sample(usage_stats_t *s, uint32_t now_s, uint16_t baseline_dppm)
+{
+    bool rolled = false;
+    if (s->clock_started) {
+        uint32_t elapsed = s->hour_s + (now_s - s->last_s);
+        while (elapsed >= USAGE_STATS_HOUR_S) {
+            elapsed -= USAGE_STATS_HOUR_S;
+            hour_rollover(s);
+            rolled = true;
+        }
+        s->hour_s = (uint16_t)elapsed;
+    }
+    s->last_s        = now_s;
+    s->clock_started = true;
+
+    if (baseline_dppm != USAGE_STATS_NO_BASELINE) {
+        bucket_baseline(&s->hour[s->hour_head], baseline_dppm);
+        bucket_baseline(&s->day[s->day_head], baseline_dppm);
+    }
+    if (rolled) {
+        stats_save(s);
+    }
+    return rolled;
+}
+
+void usage_stats_event(usage_stats_t *s, uint8_t type, uint32_t duration_s, uint16_t peak_delta_dppm)
+{
+    if (type != 1 && type != 2) {
+        return;
+    }
+    int bin = 0;
+    while (bin < USAGE_STATS_HIST_BINS - 1 && peak_delta_dppm >= k_hist_edges[bin]) {
+        bin++;
+    }
+    usage_bucket_t *b[2] = { &s->hour[s->hour_head], &s->day[s->day_head] };
+    for (int i = 0; i < 2; i++) {
+        b[i]->count[type - 1] = add_u16(b[i]->count[type - 1], 1);
+        b[i]->duration_s[type - 1] += duration_s;
+        b[i]->hist[bin] = add_u16(b[i]->hist[bin], 1);
+    }
+    stats_save(s);
+}
+
+void usage_stats_sum_hours(const usage_stats_t *s, size_t hours, usage_bucket_t *out)
+{
+    bucket_clear(out);
+    if (hours > s->hours_used) {
+        hours = s->hours_used;
+    }
+    for (size_t i = 0; i < hours; i++) {
+        bucket_add(out, &s->hour[(s->hour_head + USAGE_STATS_HOURS - i) % USAGE_STATS_HOURS]);
+    }
+}
+
+/* ── Attribute records ──────────────────────────────────────────────── */
+
+static uint16_t mean_s(const usage_bucket_t *b, int t)
+{
+    uint32_t mean = b->count[t] ? b->duration_s[t] / b->count[t] : 0;
+    return (uint16_t)(mean > UINT16_MAX ? UINT16_MAX : mean);
+}
+
+size_t usage_stats_encode_24h(const usage_stats_t *s, uint8_t *out)
+{
+    usage_bucket_t h, all;
+    usage_stats_sum_hours(s, USAGE_STATS_HOURS, &h);
+    bucket_clear(&all);
+    for (size_t i = 0; i < s->days_used; i++) {
+        bucket_add(&all, &s->day[(s->day_head + USAGE_STATS_DAYS - i) % USAGE_STATS_DAYS]);
+    }
+
+    uint8_t *p = out;
+    *p++ = USAGE_STATS_FORMAT;
+    *p++ = s->hours_used;
+    for (int t = 0; t < 2; t++) {
+        p = le_put16(p, h.count[t]);
+    }
+    for (int t = 0; t < 2; t++) {
+        p = le_put16(p, mean_s(&h, t));
+    }
+    p = le_put16(p, h.baseline_min_dppm);
+    p = le_put16(p, h.baseline_max_dppm);
+    for (int k = 0; k < USAGE_STATS_HIST_BINS; k++) {
+        p = le_put16(p, h.hist[k]);
+    }
+    for (int k = 0; k < USAGE_STATS_HIST_BINS; k++) {
+        p = le_put16(p, all.hist[k]);
+    }
+    return (size_t)(p - out);
+}
+
+size_t usage_stats_encode_days(const usage_stats_t *s, uint8_t *out)
+{
+    uint8_t *p = out;
+    *p++ = USAGE_STATS_FORMAT;
+    *p++ = s->days_used;
+    for (size_t i = 0; i < s->days_used; i++) {
+        const usage_bucket_t *d = &s->day[(s->day_head + USAGE_STATS_DAYS - i) % USAGE_STATS_DAYS];
+        for (int t = 0; t < 2; t++) {
+            *p++ = (uint8_t)(d->count[t] > UINT8_MAX ? UINT8_MAX : d->count[t]);
+        }
+        for (int t = 0; t < 2; t++) {
+            p = le_put16(p, mean_s(d, t));
+        }
+        p = le_put16(p, d->baseline_min_dppm);
+        p = le_put16(p, d->baseline_max_dppm);
+    }
+    return (size_t)(p - out);
+}
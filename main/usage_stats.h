@@ -0,0 +1,146 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * usage_stats.h — Rolling hourly / daily usage statistics for the hub
+ *
+ * The hub alerts on daily counts (e.g. more urinations than usual), which
+ * it would otherwise have to rebuild from the stream of event reports. This
+ * module keeps them on the device: every classified event and every IDLE
+ * baseline goes into the current hour and the current day bucket
+ *
+ *   count and summed ACTIVE duration per type, a histogram of peak − baseline
+ *   (USAGE_STATS_HIST_EDGES_DPPM), min / max IDLE baseline
+ *
+ * held in two rings: the last USAGE_STATS_HOURS hours and the last
+ * USAGE_STATS_DAYS days (current ones included). Two read-only octet-string
+ * attributes on 0xFC00 expose them, so a dashboard does one read:
+ *
+ *   0x0008 last 24 h, little-endian:
+ *     0  u8      format (USAGE_STATS_FORMAT)
+ *     1  u8      hours covered (1..24, incl. the current one)
+ *     2  2 × u16 count: urination, defecation
+ *     6  2 × u16 mean duration, s: urination, defecation (0 = no event)
+ *    10  u16     baseline min, 0.1 ppm (0xFFFF = no IDLE reading)
+ *    12  u16     baseline max, 0.1 ppm
+ *    14  5 × u16 peak − baseline histogram, last 24 h
+ *    24  5 × u16 ... over all days kept
+ *
+ *   0x0009 per day, newest (current) first:
+ *     0  u8      format
+ *     1  u8      day count n (1..USAGE_STATS_DAYS)
+ *     2  n ×     count u8 × 2 (saturating), mean duration u16 × 2 (s),
+ *                baseline min u16, baseline max u16 (0.1 ppm)
+ *
+ * Hours and days are counted on the sample clock, not the calendar (the
+ * device has no RTC): a day is 24 hours of uptime, and time the device was
+ * off is not counted. The whole state is one NVS blob (< 1 KB), written on
+ * each event and on each hour rollover — about 35 writes a day — so a
+ * reboot loses at most the IDLE baseline range of the current hour.
+ *
+ * Not thread-safe: one owner (the Zigbee task). Platform-independent apart
+ * from NVS; host/bench/stats_bench.c checks it against the event stream.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "nvs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Default for builds without sdkconfig (host); see Kconfig.projbuild */
+#ifndef CONFIG_LITTERBOX_USAGE_STATS_DAYS
+#define CONFIG_LITTERBOX_USAGE_STATS_DAYS   7
+#endif
+
+#define USAGE_STATS_HOURS           24
+#define USAGE_STATS_DAYS            CONFIG_LITTERBOX_USAGE_STATS_DAYS
+#define USAGE_STATS_HOUR_S          3600
+#define USAGE_STATS_HIST_BINS       5
+#define USAGE_STATS_HIST_EDGES_DPPM { 100, 200, 300, 450 }   /* Bin k: below edge k; last bin: above all */
+#define USAGE_STATS_NAMESPACE       "litterbox"
+#define USAGE_STATS_KEY             "usage_stats"   /* Default key (sensor channel 0) */
+#define USAGE_STATS_VERSION         1
+#define USAGE_STATS_FORMAT          0x01
+#define USAGE_STATS_24H_BYTES       34
+#define USAGE_STATS_DAY_BYTES       10
+#define USAGE_STATS_DAYS_MAX_BYTES  (2 + USAGE_STATS_DAYS * USAGE_STATS_DAY_BYTES)
+#define USAGE_STATS_NO_BASELINE     0xFFFF
+
+typedef struct {
+    uint16_t count[2];                      /* URINATION, DEFECATION */
+    uint32_t duration_s[2];                 /* Summed ACTIVE duration per type */
+    uint16_t hist[USAGE_STATS_HIST_BINS];   /* Peak − baseline, both types */
+    uint16_t baseline_min_dppm;             /* USAGE_STATS_NO_BASELINE if no IDLE reading */
+    uint16_t baseline_max_dppm;
+} usage_bucket_t;
+
+typedef struct {
+    usage_bucket_t hour[USAGE_STATS_HOURS];
+    usage_bucket_t day[USAGE_STATS_DAYS];
+    uint8_t      hour_head;     /* Current hour */
+    uint8_t      day_head;      /* Current day */
+    uint8_t      hours_used;    /* Buckets in use, incl. the current one */
+    uint8_t      days_used;
+    uint8_t      hour_of_day;   /* Completed hours of the current day */
+    uint16_t     hour_s;        /* Seconds into the current hour */
+    uint32_t     last_s;        /* Clock of the previous sample, this boot */
+    bool         clock_started;
+    nvs_handle_t nvs;
+    bool         nvs_open;
+    char         key[NVS_KEY_NAME_MAX_SIZE];
+} usage_stats_t;
+
+/**
+ * @brief Load the statistics from NVS (continuing the saved current hour).
+ *        Works without NVS (RAM only) if nvs_open() fails; that error is returned.
+ * @param key  NVS key of these statistics (USAGE_STATS_KEY for a single sensor)
+ * @return ESP_OK with or without saved statistics, or the NVS error
+ */
+esp_err_t usage_stats_open(usage_stats_t *s, const char *key);
+
+/**
+ * @brief Advance the clock to now_s and, if given, record an IDLE baseline.
+ *        Called for every sample; rolls hours and days over and saves then.
+ *
+ * @param now_s          Sample clock, s (monotonic within a boot)
+ * @param baseline_dppm  IDLE baseline in 0.1 ppm, or USAGE_STATS_NO_BASELINE
+ * @return true if an hour rolled over (attributes need refreshing)
+ */
+bool usage_stats_sample(usage_stats_t *s, uint32_t now_s, uint16_t baseline_dppm);
+
+/**
+ * @brief Count a classified event in the current hour and day, and save.
+ *
+ * @param type             litter_event_t (URINATION or DEFECATION; others ignored)
+ * @param duration_s       ACTIVE duration
+ * @param peak_delta_dppm  Peak − baseline, 0.1 ppm
+ */
+void usage_stats_event(usage_stats_t *s, uint8_t type, uint32_t duration_s, uint16_t peak_delta_dppm);
+
+/**
+ * @brief Sum of the last `hours` hour buckets (current included).
+ */
+void usage_stats_sum_hours(const usage_stats_t *s, size_t hours, usage_bucket_t *out);
+
+/**
+ * @brief Attribute 0x0008 record. @param out At least USAGE_STATS_24H_BYTES
+ * @return Record length
+ */
+size_t usage_stats_encode_24h(const usage_stats_t *s, uint8_t *out);
+
+/**
+ * @brief Attribute 0x0009 record. @param out At least USAGE_STATS_DAYS_MAX_BYTES
+ * @return Record length
+ */
+size_t usage_stats_encode_days(const usage_stats_t *s, uint8_t *out);
+
+#ifdef __cplusplus
+}
+#endif
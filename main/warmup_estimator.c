@@ -0,0 +1,94 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * warmup_estimator.c — Rs slope/variance settling test
+ */
+#include "warmup_estimator.h"
+#include <string.h>
+
+void warmup_estimator_init(warmup_estimator_t *w)
+{
+    memset(w, 0, sizeof(*w));
+}
+
+int32_t warmup_rs_proxy_q12(int32_t raw, int32_t k_raw)
+{
+    if (raw < WARMUP_RAW_MIN) {
+        raw = WARMUP_RAW_MIN;
+    }
+    if (raw >= k_raw) {
+        return 0;           /* AOUT at/above VCC: Rs ≈ 0 */
+    }
+    return ((k_raw - raw) << 12) / raw;
+}
+
+/* Drift within drift_pct and spread within WARMUP_CV_PCT of the window mean */
+static bool window_flat(const warmup_estimator_t *w, int drift_pct)
+{
+    /* Oldest → newest, centred abscissa x = 2i − (W − 1) keeps it integer */
+    int64_t sum = 0, sxy = 0, sxx = 0;
+    for (int i = 0; i < WARMUP_WINDOW; i++) {
+        int64_t y = w->rs[(w->head + i) % WARMUP_WINDOW];
+        int64_t x = 2 * i - (WARMUP_WINDOW - 1);
+        sum += y;
+        sxy += x * y;
+        sxx += x * x;
+    }
+    if (sum <= 0) {
+        return false;
+    }
+
+    /* slope per reading = 2·sxy / sxx; drift over the window = slope·(W − 1).
+     * |drift| ≤ drift% · mean  ⇔  |2·sxy·(W − 1)·100·W| ≤ drift·sum·sxx */
+    int64_t lhs = 2 * sxy * (WARMUP_WINDOW - 1) * 100 * WARMUP_WINDOW;
+    if (lhs < 0) {
+        lhs = -lhs;
+    }
+    if (lhs > (int64_t)drift_pct * sum * sxx) {
+        return false;
+    }
+
+    /* ss = W²·Σ(y − mean)² = W³·σ², so
+     * σ ≤ CV% · mean  ⇔  ss·100² ≤ CV²·sum²·W */
+    int64_t ss = 0;
+    for (int i = 0; i < WARMUP_WINDOW; i++) {
+        int64_t d = (int64_t)w->rs[i] * WARMUP_WINDOW - sum;
+        ss += d * d;
+    }
+    return ss * 10000 <= (int64_t)WARMUP_CV_PCT * WARMUP_CV_PCT * sum * sum * WARMUP_WINDOW;
+}
+
+bool warmup_estimator_push(warmup_estimator_t *w, int32_t rs_q12, int64_t elapsed_ms)
+{
+    if (w->settled) {
+        return true;
+    }
+
+    w->rs[w->head] = rs_q12;
+    w->head = (uint8_t)((w->head + 1) % WARMUP_WINDOW);
+    if (w->count < WARMUP_WINDOW) {
+        w->count++;
+    }
+
+    if (elapsed_ms >= WARMUP_MAX_MS) {
+        w->ready   = true;
+        w->settled = true;
+        return true;
+    }
+    if (w->count < WARMUP_WINDOW) {
+        return false;
+    }
+
+    /* Ready at the first flat window, even one at the overshoot's peak;
+     * the overshoot decay that follows is reported as settling */
+    if (!w->ready) {
+        w->ready = window_flat(w, WARMUP_DRIFT_PCT);
+    }
+    if (w->ready) {
+        w->flat    = window_flat(w, WARMUP_SETTLED_PCT) ? w->flat + 1 : 0;
+        w->settled = w->flat >= WARMUP_SETTLED_HOLD;
+    }
+    return w->ready;
+}
@@ -0,0 +1,82 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * warmup_estimator.h — Decide when the MQ-135 heater has settled
+ *
+ * Replaces a fixed warmup timer. Each reading is reduced to an Rs proxy,
+ * (K − raw) / raw in Q12, where K is the raw code at AOUT = VCC.
+ * Rs = RL·(VCC − V)/V, so the proxy is Rs/RL. Over the last
+ * WARMUP_WINDOW readings, the sensor is declared warm once both hold:
+ *  - the least-squares drift across the window is within
+ *    WARMUP_DRIFT_PCT of the window mean;
+ *  - the standard deviation is within WARMUP_CV_PCT of the mean.
+ * Both tests are relative to Rs, so they do not depend on the ppm level.
+ * Readiness is never declared before the window has filled, and always
+ * after WARMUP_MAX_MS.
+ *
+ * Warm is not settled: a window at the heater's overshoot peak passes,
+ * and the overshoot then decays over minutes (Rs rises about 0.4 % per 1 %
+ * of ppm). The estimator keeps running after readiness and reports the
+ * sensor as settling until WARMUP_SETTLED_HOLD windows in a row drift by
+ * no more than WARMUP_SETTLED_PCT (latched; also forced at WARMUP_MAX_MS).
+ * One window is not enough there, since the peak window fits a flat line. The event
+ * detector uses that to let its start-up baseline follow the decay
+ * (event_detector_set_settling()) instead of holding detection back.
+ *
+ * Integer-only (one division per reading), no platform dependencies.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WARMUP_WINDOW       6       /* Readings (12 s @ 2 s) */
+#define WARMUP_DRIFT_PCT    8       /* |slope| × (window − 1) ≤ this % of mean → ready */
+#define WARMUP_SETTLED_PCT  1       /* ... ≤ this % → settled */
+#define WARMUP_SETTLED_HOLD 3       /* ... for this many windows in a row */
+#define WARMUP_CV_PCT       5       /* σ ≤ this % of mean */
+#define WARMUP_MAX_MS       300000  /* Give up waiting (re-warm takes 3–5 min, docs/MQ-135.md) */
+#define WARMUP_RAW_MIN      16      /* Clamp: proxy → ∞ as raw → 0 */
+
+typedef struct {
+    int32_t  rs[WARMUP_WINDOW];     /* Rs proxy ring, Q12 */
+    uint8_t  head;
+    uint8_t  count;
+    uint8_t  flat;                  /* Consecutive windows within WARMUP_SETTLED_PCT */
+    bool     ready;                 /* Latched */
+    bool     settled;               /* Latched; implies ready */
+} warmup_estimator_t;
+
+void warmup_estimator_init(warmup_estimator_t *w);
+
+/**
+ * @brief Rs/RL proxy for a raw code, Q12 (k_raw = raw code at AOUT = VCC).
+ */
+int32_t warmup_rs_proxy_q12(int32_t raw, int32_t k_raw);
+
+/**
+ * @brief Add one reading.
+ *
+ * @param rs_q12      Rs proxy from warmup_rs_proxy_q12()
+ * @param elapsed_ms  Time since the heater was powered
+ * @return true once the sensor is warm (stays true until the next init)
+ */
+bool warmup_estimator_push(warmup_estimator_t *w, int32_t rs_q12, int64_t elapsed_ms);
+
+/**
+ * @brief Warm, but Rs is still drifting (the heater overshoot decaying).
+ */
+static inline bool warmup_estimator_settling(const warmup_estimator_t *w)
+{
+    return w->ready && !w->settled;
+}
+
+#ifdef __cplusplus
+}
+#endif
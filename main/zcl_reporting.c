@@ -0,0 +1,240 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * zcl_reporting.c — Reporting configuration codec and NVS storage
+ */
+#include "zcl_reporting.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "le_bytes.h"
+#include "nvs.h"
+#include <string.h>
+
+static const char *TAG = "ZCL_RPT";
+
+#define ZCL_REPORTING_MAX_ATTRS     8
+
+typedef struct {
+    uint8_t  version;
+    uint8_t  count;
+    struct {
+        uint16_t attr_id;
+        uint16_t min_interval_s;
+        uint16_t max_interval_s;
+        uint16_t reportable_change;
+    } attr[ZCL_REPORTING_MAX_ATTRS];
+} zcl_reporting_blob_t;
+
+/* ── Field sizes ────────────────────────────────────────────────────── */
+
+/* Size of the reportable change field: analog types carry one of their own
+ * size, discrete types none. −1: type not used by the cluster. */
+static int change_size(uint8_t type)
+{
+    switch (type) {
+    case ZCL_TYPE_U8:        return 1;
+    case ZCL_TYPE_U16:       return 2;
+    case ZCL_TYPE_OCTET_STR: return 0;
+    default:                 return -1;
+    }
+}
+
+static zcl_report_attr_t *find_attr(zcl_report_attr_t *attrs, size_t n, uint16_t attr_id)
+{
+    for (size_t i = 0; i < n; i++) {
+        if (attrs[i].attr_id == attr_id) {
+            return &attrs[i];
+        }
+    }
+    return NULL;
+}
+
+/* ── Configure Reporting ────────────────────────────────────────────── */
+
+size_t zcl_reporting_configure(zcl_report_attr_t *attrs, size_t n_attrs,
+                               const uint8_t *in, size_t in_len,
+                               uint8_t *out, size_t out_cap, bool *changed)
+{
+    size_t pos = 0, out_len = 0;
+    *changed = false;
+
+    while (pos < in_len) {
+        /* direction(1) attr(2), then type(1) min(2) max(2) change(type) for direction 0,
+         * or timeout(2) for direction 1 */
+        if (in_len - pos < 3) {
+            goto malformed;
+        }
+        uint8_t  dir     = in[pos];
+        uint16_t attr_id = le_get16(&in[pos + 1]);
+        pos += 3;
+
+        uint8_t status = ZCL_STATUS_SUCCESS;
+        if (dir != ZCL_REPORT_DIRECTION_REPORTED) {
+            if (in_len - pos < 2) {
+                goto malformed;
+            }
+            pos += 2;
+            status = ZCL_STATUS_UNSUPPORTED_ATTRIBUTE;
+        } else {
+            if (in_len - pos < 5) {
+                goto malformed;
+            }
+            uint8_t  type = in[pos];
+            uint16_t min  = le_get16(&in[pos + 1]);
+            uint16_t max  = le_get16(&in[pos + 3]);
+            pos += 5;
+
+            int csize = change_size(type);
+            if (csize < 0) {
+                /* Unknown type: the record length is unknown, so nothing after it can be parsed */
+                status = ZCL_STATUS_INVALID_DATA_TYPE;
+                pos = in_len;
+            } else if (in_len - pos < (size_t)csize) {
+                goto malformed;
+            }
+
+            if (status == ZCL_STATUS_SUCCESS) {
+                uint16_t change = csize == 0 ? 0 : csize == 1 ? in[pos] : le_get16(&in[pos]);
+                pos += (size_t)csize;
+
+                zcl_report_attr_t *a = find_attr(attrs, n_attrs, attr_id);
+                if (!a) {
+                    status = ZCL_STATUS_UNSUPPORTED_ATTRIBUTE;
+                } else if (!a->reportable) {
+                    status = ZCL_STATUS_UNREPORTABLE_ATTRIBUTE;
+                } else if (type != a->type) {
+                    status = ZCL_STATUS_INVALID_DATA_TYPE;
+                } else if (max != ZCL_REPORT_MAX_OFF && max != 0 && min > max) {
+                    status = ZCL_STATUS_INVALID_VALUE;
+                } else {
+                    if (a->min_interval_s != min || a->max_interval_s != max || a->reportable_change != change) {
+                        *changed = true;
+                    }
+                    a->min_interval_s    = min;
+                    a->max_interval_s    = max;
+                    a->reportable_change = change;
+                }
+            }
+        }
+
+        if (status != ZCL_STATUS_SUCCESS && out_len + 4 <= out_cap) {
+            out[out_len++] = status;
+            out[out_len++] = dir;
+            le_put16(&out[out_len], attr_id);
+            out_len += 2;
+        }
+    }
+
+    if (out_len == 0 && out_cap > 0) {
+        out[out_len++] = ZCL_STATUS_SUCCESS;    /* All records succeeded: single status byte */
+    }
+    return out_len;
+
+malformed:
+    /* Records before the truncated one have been applied and reported; end with MALFORMED */
+    if (out_len + 1 <= out_cap) {
+        out[out_len++] = ZCL_STATUS_MALFORMED_COMMAND;
+    }
+    return out_len;
+}
+
+/* ── Read Reporting Configuration ───────────────────────────────────── */
+
+size_t zcl_reporting_read_config(const zcl_report_attr_t *attrs, size_t n_attrs,
+                                 const uint8_t *in, size_t in_len,
+                                 uint8_t *out, size_t out_cap)
+{
+    size_t out_len = 0;
+
+    for (size_t pos = 0; pos + 3 <= in_len; pos += 3) {
+        uint8_t  dir     = in[pos];
+        uint16_t attr_id = le_get16(&in[pos + 1]);
+        const zcl_report_attr_t *a = find_attr((zcl_report_attr_t *)attrs, n_attrs, attr_id);
+
+        uint8_t status = ZCL_STATUS_SUCCESS;
+        if (dir != ZCL_REPORT_DIRECTION_REPORTED || !a) {
+            status = ZCL_STATUS_UNSUPPORTED_ATTRIBUTE;
+        } else if (!a->reportable) {
+            status = ZCL_STATUS_UNREPORTABLE_ATTRIBUTE;
+        }
+
+        size_t need = 4 + (status == ZCL_STATUS_SUCCESS ? 5 + (size_t)change_size(a->type) : 0);
+        if (out_len + need > out_cap) {
+            break;
+        }
+        uint8_t *p = &out[out_len];
+        *p++ = status;
+        *p++ = dir;
+        p = le_put16(p, attr_id);
+        if (status == ZCL_STATUS_SUCCESS) {
+            *p++ = a->type;
+            p = le_put16(p, a->min_interval_s);
+            p = le_put16(p, a->max_interval_s);
+            if (change_size(a->type) == 1) {
+                *p++ = (uint8_t)a->reportable_change;
+            } else if (change_size(a->type) == 2) {
+                p = le_put16(p, a->reportable_change);
+            }
+        }
+        out_len = (size_t)(p - out);
+    }
+    return out_len;
+}
+
+/* ── NVS ────────────────────────────────────────────────────────────── */
+
+esp_err_t zcl_reporting_load(zcl_report_attr_t *attrs, size_t n_attrs)
+{
+    nvs_handle_t nvs;
+    zcl_reporting_blob_t blob;
+    size_t len = sizeof(blob);
+
+    ESP_RETURN_ON_ERROR(nvs_open(ZCL_REPORTING_NVS_NAMESPACE, NVS_READWRITE, &nvs), TAG, "nvs_open failed");
+    esp_err_t err = nvs_get_blob(nvs, ZCL_REPORTING_NVS_KEY, &blob, &len);
+    nvs_close(nvs);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (len != sizeof(blob) || blob.version != ZCL_REPORTING_NVS_VERSION || blob.count > ZCL_REPORTING_MAX_ATTRS) {
+        ESP_LOGW(TAG, "Ignoring unreadable reporting configuration (%u bytes)", (unsigned)len);
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    /* Match by attribute ID so adding or removing an attribute keeps the others */
+    for (size_t i = 0; i < blob.count; i++) {
+        zcl_report_attr_t *a = find_attr(attrs, n_attrs, blob.attr[i].attr_id);
+        if (a && a->reportable) {
+            a->min_interval_s    = blob.attr[i].min_interval_s;
+            a->max_interval_s    = blob.attr[i].max_interval_s;
+            a->reportable_change = blob.attr[i].reportable_change;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t zcl_reporting_save(const zcl_report_attr_t *attrs, size_t n_attrs)
+{
+    ESP_RETURN_ON_FALSE(n_attrs <= ZCL_REPORTING_MAX_ATTRS, ESP_ERR_INVALID_SIZE, TAG, "Too many attributes");
+
+    zcl_reporting_blob_t blob;
+    memset(&blob, 0, sizeof(blob));
+    blob.version = ZCL_REPORTING_NVS_VERSION;
+    blob.count   = (uint8_t)n_attrs;
+    for (size_t i = 0; i < n_attrs; i++) {
+        blob.attr[i].attr_id           = attrs[i].attr_id;
+        blob.attr[i].min_interval_s    = attrs[i].min_interval_s;
+        blob.attr[i].max_interval_s    = attrs[i].max_interval_s;
+        blob.attr[i].reportable_change = attrs[i].reportable_change;
+    }
+
+    nvs_handle_t nvs;
+    ESP_RETURN_ON_ERROR(nvs_open(ZCL_REPORTING_NVS_NAMESPACE, NVS_READWRITE, &nvs), TAG, "nvs_open failed");
+    esp_err_t err = nvs_set_blob(nvs, ZCL_REPORTING_NVS_KEY, &blob, sizeof(blob));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return err;
+}
@@ -0,0 +1,100 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Reasty
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * zcl_reporting.h — Configure Reporting / Read Reporting Configuration for 0xFC00
+ *
+ * The stack's own reporting engine cannot be used for the manufacturer-
+ * specific NH₃ cluster (see esp_zb_task()), so main.c intercepts these two
+ * ZCL global commands for the cluster and answers them here:
+ *
+ *   0x06 Configure Reporting        → 0x07 Configure Reporting Response
+ *   0x08 Read Reporting Config      → 0x09 Read Reporting Config Response
+ *
+ * Payloads are the ZCL record lists (no ZCL header), little-endian. Only
+ * direction 0x00 (attribute reported by this server) is supported. Records
+ * are applied independently; a Configure Reporting Response lists only the
+ * failed records, or is a single SUCCESS byte. Max interval 0xFFFF turns
+ * reporting of that attribute off, 0 disables the periodic (heartbeat)
+ * report.
+ *
+ * The table is stored in NVS so hub settings survive reboots. The codec is
+ * platform-independent (host/bench/reporting_bench.c).
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ZCL global commands */
+#define ZCL_CMD_CONFIGURE_REPORTING         0x06
+#define ZCL_CMD_CONFIGURE_REPORTING_RESP    0x07
+#define ZCL_CMD_READ_REPORTING_CONFIG       0x08
+#define ZCL_CMD_READ_REPORTING_CONFIG_RESP  0x09
+
+/* ZCL status codes */
+#define ZCL_STATUS_SUCCESS                  0x00
+#define ZCL_STATUS_MALFORMED_COMMAND        0x80
+#define ZCL_STATUS_UNSUPPORTED_ATTRIBUTE    0x86
+#define ZCL_STATUS_INVALID_VALUE            0x87
+#define ZCL_STATUS_UNREPORTABLE_ATTRIBUTE   0x8C
+#define ZCL_STATUS_INVALID_DATA_TYPE        0x8D
+
+/* ZCL data types used by the cluster */
+#define ZCL_TYPE_U8                         0x20
+#define ZCL_TYPE_U16                        0x21
+#define ZCL_TYPE_OCTET_STR                  0x41    /* Discrete: no reportable change field */
+
+#define ZCL_REPORT_DIRECTION_REPORTED       0x00
+#define ZCL_REPORT_MAX_OFF                  0xFFFF
+#define ZCL_REPORTING_RESP_MAX              64      /* Response payload bytes (fits one APS frame) */
+
+#define ZCL_REPORTING_NVS_NAMESPACE         "litterbox"
+#define ZCL_REPORTING_NVS_KEY               "rpt_cfg"
+#define ZCL_REPORTING_NVS_VERSION           1
+
+typedef struct {
+    uint16_t attr_id;
+    uint8_t  type;              /* ZCL_TYPE_* */
+    bool     reportable;        /* False: exists, but Configure Reporting → UNREPORTABLE_ATTRIBUTE */
+    uint16_t min_interval_s;
+    uint16_t max_interval_s;    /* ZCL_REPORT_MAX_OFF = not reported, 0 = no heartbeat */
+    uint16_t reportable_change; /* Unused for discrete types */
+} zcl_report_attr_t;
+
+/**
+ * @brief Apply a Configure Reporting payload to attrs and build the response payload.
+ *
+ * @param changed  Set to true if any attribute's configuration changed
+ * @return Response payload length (≥ 1)
+ */
+size_t zcl_reporting_configure(zcl_report_attr_t *attrs, size_t n_attrs,
+                               const uint8_t *in, size_t in_len,
+                               uint8_t *out, size_t out_cap, bool *changed);
+
+/**
+ * @brief Build a Read Reporting Configuration Response payload.
+ * @return Response payload length (0 if the request had no complete record)
+ */
+size_t zcl_reporting_read_config(const zcl_report_attr_t *attrs, size_t n_attrs,
+                                 const uint8_t *in, size_t in_len,
+                                 uint8_t *out, size_t out_cap);
+
+/**
+ * @brief Overwrite the intervals/changes of attrs with the NVS copy, if one matches.
+ * @return ESP_OK if loaded, ESP_ERR_NVS_NOT_FOUND if none saved, or another error
+ */
+esp_err_t zcl_reporting_load(zcl_report_attr_t *attrs, size_t n_attrs);
+
+esp_err_t zcl_reporting_save(const zcl_report_attr_t *attrs, size_t n_attrs);
+
+#ifdef __cplusplus
+}
+#endif
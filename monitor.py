@@ -1,6 +1,11 @@
 import serial
+import sys
 import time
 
+# python monitor.py --raw capture.bin : also save every received byte
+# (binary trace frames included) for host/tools/trace_decode
+raw = open(sys.argv[2], 'wb') if len(sys.argv) > 2 and sys.argv[1] == '--raw' else None
+
 s = serial.Serial('COM3', 115200, timeout=1)
 
 # Reset device via DTR/RTS toggle
@@ -14,9 +19,14 @@ s.dtr = False
 start = time.time()
 try:
     while time.time() - start < 90:
-        line = s.readline().decode('utf-8', 'replace').rstrip()
+        data = s.readline()
+        if raw:
+            raw.write(data)
+        line = data.decode('utf-8', 'replace').rstrip()
         if line:
             print(line, flush=True)
 finally:
     s.close()
+    if raw:
+        raw.close()
     print("--- Monitor ended ---")
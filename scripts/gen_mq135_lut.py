@@ -0,0 +1,85 @@
+"""
+MQ-135 raw ADC → NH₃ ppm 룩업 테이블 생성기 (CONFIG_LITTERBOX_FIXED_POINT).
+
+main/mq135_params.h의 MQ135_* 상수를 읽어, air_sensor_read()의 float 경로와
+동일한 수식·클램프로 4096개 엔트리(12-bit ADC 전 범위) 테이블을 만든다.
+값은 unsigned Q10.6 (1 LSB = 1/64 ppm, 최대 1000 ppm = 64000 < 65536).
+
+빌드 시 main/CMakeLists.txt와 host/CMakeLists.txt가 자동 실행한다:
+    python scripts/gen_mq135_lut.py main/mq135_params.h build/mq135_lut.h
+"""
+
+import re
+import sys
+
+PPM_Q_SHIFT = 6
+ADC_STEPS = 4096
+
+DEFINE = re.compile(r"#define\s+MQ135_(\w+)\s+\(?\s*(-?[0-9.]+)f?\s*\)?")
+
+
+def load_params(path):
+    params = {}
+    with open(path, encoding="utf-8") as f:
+        for line in f:
+            m = DEFINE.match(line.strip())
+            if m:
+                params[m.group(1)] = float(m.group(2))
+    return params
+
+
+def raw_to_ppm(raw, p):
+    """Mirror of the float path in air_sensor_driver_MQ135.c."""
+    v_adc = (raw / 4095.0) * p["ADC_VREF"]
+    if v_adc < 0.001:
+        v_adc = 0.001
+    voltage = v_adc * p["DIVIDER_RATIO"]
+    if voltage >= p["VCC"]:
+        voltage = p["VCC"] - 0.01
+    rs_kohm = p["LOAD_RESISTANCE_KOHM"] * (p["VCC"] - voltage) / voltage
+    if rs_kohm <= 0.0:
+        rs_kohm = 0.01
+    ratio = rs_kohm / p["R0_KOHM"]
+    ppm = p["NH3_CURVE_A"] * ratio ** p["NH3_CURVE_B"]
+    return min(max(ppm, 0.0), p["PPM_MAX"])
+
+
+def main():
+    if len(sys.argv) != 3:
+        print(__doc__)
+        sys.exit(2)
+
+    params = load_params(sys.argv[1])
+    required = ["LOAD_RESISTANCE_KOHM", "VCC", "DIVIDER_RATIO", "ADC_VREF",
+                "NH3_CURVE_A", "NH3_CURVE_B", "R0_KOHM", "PPM_MAX"]
+    missing = [k for k in required if k not in params]
+    if missing:
+        sys.exit(f"{sys.argv[1]}: missing MQ135_{', MQ135_'.join(missing)}")
+
+    scale = 1 << PPM_Q_SHIFT
+    table = [min(round(raw_to_ppm(raw, params) * scale), 0xFFFF) for raw in range(ADC_STEPS)]
+
+    lines = [
+        "/* Generated by scripts/gen_mq135_lut.py from mq135_params.h — do not edit. */",
+        "#pragma once",
+        "",
+        "#include <stdint.h>",
+        "",
+        f"#define MQ135_LUT_SIZE      {ADC_STEPS}",
+        f"#define MQ135_LUT_Q_SHIFT   {PPM_Q_SHIFT}",
+        "",
+        f"/* R0={params['R0_KOHM']:g} kΩ, RL={params['LOAD_RESISTANCE_KOHM']:g} kΩ, "
+        f"VCC={params['VCC']:g} V, divider={params['DIVIDER_RATIO']:g}, "
+        f"curve A={params['NH3_CURVE_A']:g} B={params['NH3_CURVE_B']:g} */",
+        "static const uint16_t mq135_ppm_lut[MQ135_LUT_SIZE] = {",
+    ]
+    for i in range(0, ADC_STEPS, 12):
+        lines.append("    " + " ".join(f"{v:5d}," for v in table[i:i + 12]))
+    lines.append("};")
+
+    with open(sys.argv[2], "w", encoding="utf-8") as out:
+        out.write("\n".join(lines) + "\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,49 @@
+"""
+monitor.py 시리얼 로그 → 호스트 리플레이용 CSV 트레이스 변환.
+
+MQ135 디버그 로그(2초 주기, raw=...)가 있으면 그것을, 없으면
+"Reported NH3=..." 보고 로그(10초 주기)의 raw 값을 사용한다.
+
+사용법:
+    python monitor.py > capture.log
+    python scripts/log_to_trace.py capture.log capture.csv
+    host/build/detector_bench --trace capture.csv
+
+CONFIG_LITTERBOX_BINARY_TRACE 빌드는 이 텍스트 로그 대신 바이너리 프레임을 내보내므로
+host/tools/trace_decode 를 사용한다.
+
+라벨(label 열)은 0으로 채워진다. 실제 배뇨/배변 시점을 알고 있으면
+해당 행의 label을 1(소변) 또는 2(대변)로 수정하면 감지 지연이 측정된다.
+"""
+
+import re
+import sys
+
+# "D (12345) MQ135: raw=953 Vadc=..."  /  "I (12345) LITTERBOX: Reported NH3=4 ppm (... raw=953)"
+RAW_DEBUG = re.compile(r"\((\d+)\) MQ135: raw=(\d+)")
+RAW_REPORT = re.compile(r"\((\d+)\) LITTERBOX: Reported NH3=.*raw=(\d+)\)")
+
+
+def main():
+    if len(sys.argv) != 3:
+        print(__doc__)
+        sys.exit(2)
+
+    with open(sys.argv[1], encoding="utf-8", errors="replace") as f:
+        lines = f.readlines()
+
+    rows = [m.groups() for m in map(RAW_DEBUG.search, lines) if m]
+    if not rows:
+        rows = [m.groups() for m in map(RAW_REPORT.search, lines) if m]
+    if not rows:
+        sys.exit("raw ADC 로그를 찾지 못함 (MQ135 raw= 또는 Reported NH3= 라인 필요)")
+
+    with open(sys.argv[2], "w", encoding="utf-8") as out:
+        out.write("t_ms,raw_adc,label\n")
+        for t_ms, raw in rows:
+            out.write(f"{t_ms},{raw},0\n")
+    print(f"{len(rows)} samples → {sys.argv[2]}")
+
+
+if __name__ == "__main__":
+    main()